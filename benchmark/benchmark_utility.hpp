@@ -0,0 +1,157 @@
+#pragma once
+#include<algorithm>
+#include<chrono>
+#include<cstdint>
+#include<limits>
+#include<ostream>
+#include<string>
+#include<string_view>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+// x`}[NŋʂɎgvJSONo
+
+// prepare͌vɊ܂߂Ȃ
+// repeat̂ԑ1̕bԂ
+template<typename Prepare, typename F>
+inline double measure_best(int repeat, Prepare&& prepare, F&& f)
+{
+	double best = std::numeric_limits<double>::max();
+	for (int i = 0; i < std::max(repeat, 1); i++)
+	{
+		prepare();
+		auto const start = std::chrono::steady_clock::now();
+		f();
+		auto const end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double>(end - start).count());
+	}
+	return best;
+}
+
+template<typename F>
+inline double measure_best(int repeat, F&& f)
+{
+	return measure_best(repeat, [] {}, std::forward<F>(f));
+}
+
+// œKŌvZȂ悤Ɍʂ܂Ƃ߂ďo͂
+struct Checksum
+{
+	double value{};
+
+	template<typename T>
+	void add(T const& v) noexcept
+	{
+		value += static_cast<double>(v);
+	}
+};
+
+// CfgtJSONo
+// L[Ȃarray̗vfƂď
+class JsonWriter
+{
+	std::ostream& out;
+
+	// lXgƂɍŏ̗vfǂ
+	std::vector<bool> firstElement{};
+
+	void beginValue(std::string_view key);
+	void writeString(std::string_view str);
+
+public:
+	JsonWriter(std::ostream& out);
+	virtual ~JsonWriter() = default;
+	JsonWriter(JsonWriter const&) = delete;
+	JsonWriter& operator=(JsonWriter const&) = delete;
+
+	void beginObject(std::string_view key = {});
+	void endObject();
+	void beginArray(std::string_view key = {});
+	void endArray();
+
+	// boolAlA
+	template<typename T>
+	void value(std::string_view key, T const& v);
+};
+
+
+//
+// ȉA
+//
+
+
+inline JsonWriter::JsonWriter(std::ostream& out)
+	: out{ out }
+{
+}
+
+inline void JsonWriter::beginValue(std::string_view key)
+{
+	if (!firstElement.empty())
+	{
+		if (!firstElement.back())
+			out << ",";
+		firstElement.back() = false;
+		out << "\n" << std::string(firstElement.size() * 2, ' ');
+	}
+
+	if (!key.empty())
+	{
+		writeString(key);
+		out << ": ";
+	}
+}
+
+inline void JsonWriter::writeString(std::string_view str)
+{
+	out << '"';
+	for (auto c : str)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\';
+		out << c;
+	}
+	out << '"';
+}
+
+inline void JsonWriter::beginObject(std::string_view key)
+{
+	beginValue(key);
+	out << "{";
+	firstElement.push_back(true);
+}
+
+inline void JsonWriter::endObject()
+{
+	firstElement.pop_back();
+	out << "\n" << std::string(firstElement.size() * 2, ' ') << "}";
+	if (firstElement.empty())
+		out << "\n";
+}
+
+inline void JsonWriter::beginArray(std::string_view key)
+{
+	beginValue(key);
+	out << "[";
+	firstElement.push_back(true);
+}
+
+inline void JsonWriter::endArray()
+{
+	firstElement.pop_back();
+	out << "\n" << std::string(firstElement.size() * 2, ' ') << "]";
+}
+
+template<typename T>
+inline void JsonWriter::value(std::string_view key, T const& v)
+{
+	beginValue(key);
+
+	if constexpr (std::is_same_v<T, bool>)
+		out << (v ? "true" : "false");
+	else if constexpr (std::is_arithmetic_v<T>)
+		out << v;
+	else
+		writeString(v);
+}
@@ -0,0 +1,319 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/ParallelBroadphase.hpp"
+#include"../src/Scene.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cstdlib>
+#include<iostream>
+#include<memory>
+#include<string_view>
+#include<utility>
+#include<vector>
+
+// btDbvtBroadphase::benchmarkƓ̔ŁAu[htF[YAABB̍XVƃyATv
+// btDbvtBroadphasesetAabb1Ăԕ@ƁAParallelDbvtBroadphasesetAabbsׂ
+
+struct BroadphaseBenchmarkOption
+{
+	// 0ȂbtDbvtBroadphase::benchmarkƓS
+	std::size_t objectNum = 0;
+	// 1ɓ
+	int updatePercent = 100;
+	int iterations = 0;
+	int threadNum = 0;
+};
+
+// btBroadphaseBenchmark::ExperimentƓ
+struct BroadphaseExperiment
+{
+	char const* name;
+	int objectNum;
+	int updatePercent;
+	int iterations;
+	btScalar speed;
+	btScalar amplitude;
+};
+
+constexpr BroadphaseExperiment BROADPHASE_EXPERIMENTS[] = {
+	{ "1024o.10%", 1024, 10, 2000, btScalar(0.005), btScalar(100) },
+	{ "8192o.10%", 8192, 10, 500, btScalar(0.005), btScalar(100) },
+	{ "20000o.100%", 20000, 100, 100, btScalar(0.005), btScalar(100) },
+	{ "50000o.100%", 50000, 100, 40, btScalar(0.005), btScalar(100) },
+};
+
+inline void print_broadphase_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark broadphase [options]\n"
+		"  --objects <n>      run one experiment with n boxes instead of the default set\n"
+		"  --update <percent> boxes moved per iteration with --objects (default 100)\n"
+		"  --iterations <n>   iterations with --objects (default 100)\n"
+		"  --threads <n>      threads for the parallel broadphase (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_broadphase_benchmark_option(int argc, char** argv, BroadphaseBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--objects")
+			option.objectNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--update")
+			option.updatePercent = std::atoi(value);
+		else if (name == "--iterations")
+			option.iterations = std::atoi(value);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.updatePercent < 1 || option.updatePercent > 100 || option.iterations < 0 || option.threadNum < 0) {
+		std::cerr << "invalid --update, --iterations or --threads\n";
+		return false;
+	}
+
+	return true;
+}
+
+// btBroadphaseBenchmark::ObjectƓ
+struct BroadphaseBenchmarkObject
+{
+	btVector3 center{};
+	btVector3 extents{};
+	btBroadphaseProxy* proxy = nullptr;
+	btScalar time{};
+
+	void move(btScalar speed, btScalar amplitude)
+	{
+		time += speed;
+		center[0] = btCos(time * btScalar(2.17)) * amplitude + btSin(time) * amplitude / 2;
+		center[1] = btCos(time * btScalar(1.38)) * amplitude + btSin(time) * amplitude;
+		center[2] = btSin(time * btScalar(0.777)) * amplitude;
+	}
+};
+
+enum class BroadphaseMode
+{
+	// btDbvtBroadphase̊AsetAabb̒ŃyAT
+	Bullet,
+	// btDbvtBroadphasecalculateOverlappingPairŝƂɂ܂Ƃ߂ĒT
+	BulletDeferred,
+	Parallel,
+};
+
+struct BroadphaseResult
+{
+	double updateTime{};
+	double pairTime{};
+	int pairNum{};
+	// ŌɏdȂĂ̂ɃLbVɂȂyA
+	std::size_t missingPairNum{};
+	// LbV̒̃yȀ
+	std::vector<std::pair<int, int>> pairs{};
+	ParallelBroadphaseCounter counter{};
+};
+
+// xŕׂďdȂĂyA𐔂ALbVɂȂ̂𐔂
+inline std::size_t count_missing_pairs(std::vector<BroadphaseBenchmarkObject> const& objects, btOverlappingPairCache* pairCache)
+{
+	std::vector<std::size_t> order(objects.size());
+	for (std::size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&](auto a, auto b) {
+		return objects[a].center.x() - objects[a].extents.x() < objects[b].center.x() - objects[b].extents.x();
+	});
+
+	std::size_t missing = 0;
+	for (std::size_t i = 0; i < order.size(); i++)
+	{
+		auto const& a = objects[order[i]];
+		auto const aMin = a.center - a.extents;
+		auto const aMax = a.center + a.extents;
+		for (std::size_t j = i + 1; j < order.size(); j++)
+		{
+			auto const& b = objects[order[j]];
+			auto const bMin = b.center - b.extents;
+			auto const bMax = b.center + b.extents;
+			if (bMin.x() > aMax.x())
+				break;
+			if (TestAabbAgainstAabb2(aMin, aMax, bMin, bMax) && !pairCache->findPair(a.proxy, b.proxy))
+				missing++;
+		}
+	}
+	return missing;
+}
+
+inline BroadphaseResult run_broadphase_experiment(BroadphaseExperiment const& experiment, BroadphaseMode mode)
+{
+	std::unique_ptr<btDbvtBroadphase> broadphase{};
+	ParallelDbvtBroadphase* parallel = nullptr;
+	if (mode == BroadphaseMode::Parallel) {
+		auto p = std::make_unique<ParallelDbvtBroadphase>();
+		parallel = p.get();
+		broadphase = std::move(p);
+	}
+	else {
+		broadphase = std::make_unique<btDbvtBroadphase>();
+		broadphase->m_deferedcollide = mode == BroadphaseMode::BulletDeferred;
+	}
+
+	// btDbvtBroadphase::benchmarkƓŒu
+	std::srand(180673);
+	auto const unitRand = [] { return (std::rand() % (16384 + 1)) / btScalar(16384); };
+
+	std::vector<BroadphaseBenchmarkObject> objects(static_cast<std::size_t>(experiment.objectNum));
+	for (auto& object : objects)
+	{
+		object.center = btVector3(unitRand() * 50, unitRand() * 50, unitRand() * 50);
+		object.extents = btVector3(unitRand() * 2 + 2, unitRand() * 2 + 2, unitRand() * 2 + 2);
+		object.time = unitRand() * 2000;
+		object.proxy = broadphase->createProxy(object.center - object.extents, object.center + object.extents, 0, &object, 1, 1, nullptr);
+	}
+
+	std::vector<BroadphaseAabb> aabbs{};
+	aabbs.reserve(objects.size());
+	auto const update = [&](std::size_t num) {
+		if (parallel)
+		{
+			aabbs.clear();
+			for (std::size_t i = 0; i < num; i++) {
+				objects[i].move(experiment.speed, experiment.amplitude);
+				aabbs.push_back({ objects[i].proxy, objects[i].center - objects[i].extents, objects[i].center + objects[i].extents });
+			}
+			parallel->setAabbs(aabbs);
+		}
+		else
+		{
+			for (std::size_t i = 0; i < num; i++) {
+				objects[i].move(experiment.speed, experiment.amplitude);
+				broadphase->setAabb(objects[i].proxy, objects[i].center - objects[i].extents, objects[i].center + objects[i].extents, nullptr);
+			}
+		}
+	};
+
+	// ŏɑS
+	update(objects.size());
+	broadphase->calculateOverlappingPairs(nullptr);
+
+	auto const updateNum = objects.size() * static_cast<std::size_t>(experiment.updatePercent) / 100;
+	BroadphaseResult result{};
+	for (int i = 0; i < experiment.iterations; i++)
+	{
+		auto const start = std::chrono::steady_clock::now();
+		update(updateNum);
+		auto const middle = std::chrono::steady_clock::now();
+		broadphase->calculateOverlappingPairs(nullptr);
+		auto const end = std::chrono::steady_clock::now();
+
+		result.updateTime += std::chrono::duration<double>(middle - start).count();
+		result.pairTime += std::chrono::duration<double>(end - middle).count();
+	}
+	result.updateTime /= std::max(experiment.iterations, 1);
+	result.pairTime /= std::max(experiment.iterations, 1);
+
+	auto const pairCache = broadphase->getOverlappingPairCache();
+	result.pairNum = pairCache->getNumOverlappingPairs();
+	result.missingPairNum = count_missing_pairs(objects, pairCache);
+	for (int i = 0; i < result.pairNum; i++) {
+		auto const& pair = pairCache->getOverlappingPairArray()[i];
+		result.pairs.push_back({ pair.m_pProxy0->getUid(), pair.m_pProxy1->getUid() });
+	}
+	if (parallel)
+		result.counter = parallel->getCounter();
+
+	for (auto& object : objects)
+		broadphase->destroyProxy(object.proxy, nullptr);
+
+	return result;
+}
+
+inline void write_broadphase_result(JsonWriter& json, std::string_view key, BroadphaseResult const& result)
+{
+	json.beginObject(key);
+	json.value("update_us", result.updateTime * 1e6);
+	json.value("pairs_us", result.pairTime * 1e6);
+	json.value("total_us", (result.updateTime + result.pairTime) * 1e6);
+	json.value("pairs", result.pairNum);
+	json.value("missing_pairs", result.missingPairNum);
+	json.endObject();
+}
+
+inline int run_broadphase_benchmark(int argc, char** argv)
+{
+	BroadphaseBenchmarkOption option{};
+	if (!parse_broadphase_benchmark_option(argc, argv, option)) {
+		print_broadphase_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the broadphase benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+
+	std::vector<BroadphaseExperiment> experiments{};
+	if (option.objectNum > 0)
+		experiments.push_back({ "custom", static_cast<int>(option.objectNum), option.updatePercent, option.iterations > 0 ? option.iterations : 100, btScalar(0.005), btScalar(100) });
+	else
+		experiments.assign(std::begin(BROADPHASE_EXPERIMENTS), std::end(BROADPHASE_EXPERIMENTS));
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "broadphase");
+	json.value("threads", threadNum);
+
+	bool correct = true;
+	json.beginArray("experiments");
+	for (auto const& experiment : experiments)
+	{
+		scheduler->setNumThreads(1);
+		auto const bullet = run_broadphase_experiment(experiment, BroadphaseMode::Bullet);
+		auto const deferred = run_broadphase_experiment(experiment, BroadphaseMode::BulletDeferred);
+		auto const serial = run_broadphase_experiment(experiment, BroadphaseMode::Parallel);
+		scheduler->setNumThreads(threadNum);
+		auto const parallel = run_broadphase_experiment(experiment, BroadphaseMode::Parallel);
+
+		// XbhςĂLbṼyAɂȂ
+		auto const deterministic = serial.pairs == parallel.pairs;
+		correct = correct && deterministic && bullet.missingPairNum == 0 && parallel.missingPairNum == 0;
+
+		json.beginObject();
+		json.value("name", experiment.name);
+		json.value("objects", experiment.objectNum);
+		json.value("update_percent", experiment.updatePercent);
+		json.value("iterations", experiment.iterations);
+		write_broadphase_result(json, "bullet", bullet);
+		write_broadphase_result(json, "bullet_deferred", deferred);
+		write_broadphase_result(json, "parallel_1thread", serial);
+		write_broadphase_result(json, "parallel", parallel);
+		json.value("refit_ratio", static_cast<double>(parallel.counter.refitNum) / static_cast<double>(std::max<std::uint64_t>(parallel.counter.refitNum + parallel.counter.reinsertNum, 1)));
+		json.value("speedup", (bullet.updateTime + bullet.pairTime) / (parallel.updateTime + parallel.pairTime));
+		json.value("deterministic", deterministic);
+		json.endObject();
+	}
+	json.endArray();
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
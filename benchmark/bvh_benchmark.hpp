@@ -0,0 +1,545 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/SahOptimizedBvh.hpp"
+#include"../src/mesh_cache.hpp"
+#include"../src/obj_loader.hpp"
+#include"../src/Scene.hpp"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include<algorithm>
+#include<array>
+#include<cmath>
+#include<cstdint>
+#include<cstdlib>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<memory>
+#include<random>
+#include<string>
+#include<string_view>
+#include<vector>
+
+// enʂɍׂ̉uAOp`̖x΂bVŁA
+// btOptimizedBvh::build̖؂SahOptimizedBvh̖؂ׂ
+// 鎞ԁAǂݍގ(蒼ABulletserializeInPlaceA}bvLbV)A
+// CÃLXgAAABB̏dȂ̃NG̎Ԃ𑪂AqbgƏdȂOp`̐𒲂ׂ
+
+struct BvhBenchmarkOption
+{
+	int repeat = 3;
+	// nʂ̈ӂ̃Z̐
+	int gridSize = 256;
+	// ̐ƁA1̊̌ox̕
+	int rockNum = 96;
+	int rockSegments = 32;
+	int rayNum = 65536;
+	int castNum = 2048;
+	int boxNum = 16384;
+	SahBvhConfig config{};
+	int threadNum = 0;
+};
+
+inline void print_bvh_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark bvh [options]\n"
+		"  --repeat <n>         run n times and report the fastest (default 3)\n"
+		"  --grid <n>           cells on each side of the ground (default 256)\n"
+		"  --rocks <n>          finely tessellated rocks clustered on the ground (default 96)\n"
+		"  --rock-segments <n>  longitude segments of a rock (default 32)\n"
+		"  --rays <n>           closest-hit rays (default 65536)\n"
+		"  --casts <n>          closest-hit box casts (default 2048)\n"
+		"  --boxes <n>          AABB overlap queries (default 16384)\n"
+		"  --task <n>           triangles per subtree task (default 4096)\n"
+		"  --threads <n>        largest thread count to try (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_bvh_benchmark_option(int argc, char** argv, BvhBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--grid")
+			option.gridSize = std::atoi(value);
+		else if (name == "--rocks")
+			option.rockNum = std::atoi(value);
+		else if (name == "--rock-segments")
+			option.rockSegments = std::atoi(value);
+		else if (name == "--rays")
+			option.rayNum = std::atoi(value);
+		else if (name == "--casts")
+			option.castNum = std::atoi(value);
+		else if (name == "--boxes")
+			option.boxNum = std::atoi(value);
+		else if (name == "--task")
+			option.config.taskPrimitiveNum = std::atoi(value);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.gridSize < 1 || option.rockNum < 0 || option.rockSegments < 4 ||
+		option.rayNum < 1 || option.castNum < 1 || option.boxNum < 1 || option.config.taskPrimitiveNum < 1) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+constexpr float BVH_BENCHMARK_GROUND_SIZE = 512.f;
+
+inline float bvh_benchmark_ground_height(float x, float z)
+{
+	return 3.f * std::sin(x * 0.031f) * std::cos(z * 0.027f) + std::sin(x * 0.11f + z * 0.07f);
+}
+
+// nʂ͍LOp`A͂̒ɏW߂ׂOp`
+inline ObjMesh make_bvh_benchmark_mesh(BvhBenchmarkOption const& option)
+{
+	ObjMesh mesh{};
+	auto const addVertex = [&](float x, float y, float z) {
+		mesh.vertices.push_back({ x, y, z, 0.f, 1.f, 0.f });
+		return static_cast<std::uint32_t>(mesh.vertices.size() - 1);
+	};
+
+	auto const half = BVH_BENCHMARK_GROUND_SIZE * 0.5f;
+	auto const cell = BVH_BENCHMARK_GROUND_SIZE / static_cast<float>(option.gridSize);
+	auto const first = static_cast<std::uint32_t>(mesh.vertices.size());
+	for (int z = 0; z <= option.gridSize; z++)
+	{
+		for (int x = 0; x <= option.gridSize; x++)
+		{
+			auto const px = -half + cell * static_cast<float>(x);
+			auto const pz = -half + cell * static_cast<float>(z);
+			addVertex(px, bvh_benchmark_ground_height(px, pz), pz);
+		}
+	}
+	auto const gridIndex = [&](int x, int z) { return first + static_cast<std::uint32_t>(z * (option.gridSize + 1) + x); };
+	for (int z = 0; z < option.gridSize; z++)
+	{
+		for (int x = 0; x < option.gridSize; x++)
+		{
+			auto const a = gridIndex(x, z), b = gridIndex(x + 1, z), c = gridIndex(x + 1, z + 1), d = gridIndex(x, z + 1);
+			mesh.indices.insert(mesh.indices.end(), { a, c, b, a, d, c });
+		}
+	}
+
+	std::mt19937 engine{ 1 };
+	std::uniform_real_distribution<float> townDistribution{ -half * 0.8f, half * 0.8f };
+	std::normal_distribution<float> spreadDistribution{ 0.f, 12.f };
+	std::uniform_real_distribution<float> radiusDistribution{ 0.5f, 4.f };
+
+	constexpr int TOWN_NUM = 6;
+	std::array<std::array<float, 2>, TOWN_NUM> towns{};
+	for (auto& town : towns)
+		town = { townDistribution(engine), townDistribution(engine) };
+
+	constexpr float PI = 3.14159265358979323846f;
+	auto const rings = option.rockSegments / 2;
+	for (int r = 0; r < option.rockNum; r++)
+	{
+		auto const& town = towns[r % TOWN_NUM];
+		auto const cx = std::clamp(town[0] + spreadDistribution(engine), -half, half);
+		auto const cz = std::clamp(town[1] + spreadDistribution(engine), -half, half);
+		auto const radius = radiusDistribution(engine);
+		auto const cy = bvh_benchmark_ground_height(cx, cz) + radius * 0.5f;
+
+		auto const base = static_cast<std::uint32_t>(mesh.vertices.size());
+		for (int ring = 0; ring <= rings; ring++)
+		{
+			auto const theta = PI * static_cast<float>(ring) / static_cast<float>(rings);
+			for (int s = 0; s <= option.rockSegments; s++)
+			{
+				auto const phi = 2.f * PI * static_cast<float>(s) / static_cast<float>(option.rockSegments);
+				// łڂɂ
+				auto const bump = radius * (1.f + 0.08f * std::sin(5.f * phi) * std::sin(3.f * theta));
+				addVertex(cx + bump * std::sin(theta) * std::cos(phi), cy + bump * std::cos(theta), cz + bump * std::sin(theta) * std::sin(phi));
+			}
+		}
+		auto const rockIndex = [&](int ring, int s) { return base + static_cast<std::uint32_t>(ring * (option.rockSegments + 1) + s); };
+		for (int ring = 0; ring < rings; ring++)
+		{
+			for (int s = 0; s < option.rockSegments; s++)
+			{
+				auto const a = rockIndex(ring, s), b = rockIndex(ring + 1, s), c = rockIndex(ring + 1, s + 1), d = rockIndex(ring, s + 1);
+				mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+			}
+		}
+	}
+
+	return mesh;
+}
+
+// ̖ʐςŊSAH̃RXgAm[hǂRXgƎOp`𒲂ׂRXg͂ǂ1Ƃ
+inline double compute_bvh_sah_cost(btQuantizedBvh& bvh)
+{
+	auto const& nodes = bvh.getQuantizedNodeArray();
+	if (nodes.size() == 0)
+		return 0;
+
+	auto const halfArea = [&](btQuantizedBvhNode const& node) {
+		auto const extent = bvh.unQuantize(node.m_quantizedAabbMax) - bvh.unQuantize(node.m_quantizedAabbMin);
+		return static_cast<double>(extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+	};
+
+	// btOptimizedBvh::build͗t̐2{mۂ̂ŁAm[h͍̐̃GXP[vCfbNX狁߂
+	auto const nodeNum = nodes[0].isLeafNode() ? 1 : nodes[0].getEscapeIndex();
+	double cost{};
+	for (int i = 0; i < nodeNum; i++)
+		cost += halfArea(nodes[i]);
+	return cost / halfArea(nodes[0]);
+}
+
+struct BvhBenchmarkRayCallback : public btTriangleRaycastCallback
+{
+	using btTriangleRaycastCallback::btTriangleRaycastCallback;
+	btScalar reportHit(btVector3 const&, btScalar hitFraction, int, int) override { return hitFraction; }
+};
+
+struct BvhBenchmarkCastCallback : public btTriangleConvexcastCallback
+{
+	using btTriangleConvexcastCallback::btTriangleConvexcastCallback;
+	btScalar reportHit(btVector3 const&, btVector3 const&, btScalar hitFraction, int, int) override { return hitFraction; }
+};
+
+struct BvhBenchmarkOverlapCallback : public btNodeOverlapCallback
+{
+	int count = 0;
+	void processNode(int, int) override { count++; }
+};
+
+struct BvhBenchmarkQueries
+{
+	std::vector<std::array<btVector3, 2>> rays{};
+	std::vector<std::array<btVector3, 2>> casts{};
+	std::vector<std::array<btVector3, 2>> boxes{};
+};
+
+// C͔^ォAnʂꂷɐɌÃLXg͐^ォAAABB͒̋߂ɑu
+inline BvhBenchmarkQueries make_bvh_benchmark_queries(BvhBenchmarkOption const& option)
+{
+	BvhBenchmarkQueries queries{};
+
+	auto const half = btScalar(BVH_BENCHMARK_GROUND_SIZE * 0.5f);
+	std::mt19937 engine{ 2 };
+	std::uniform_real_distribution<btScalar> position{ -half, half };
+	std::uniform_real_distribution<btScalar> angle{ 0, btScalar(6.283185307179586) };
+	std::uniform_real_distribution<btScalar> height{ 0, 8 };
+	std::uniform_real_distribution<btScalar> size{ btScalar(0.5), 6 };
+
+	for (int i = 0; i < option.rayNum; i++)
+	{
+		btVector3 const from{ position(engine), i % 2 == 0 ? btScalar(100) : height(engine), position(engine) };
+		auto const a = angle(engine);
+		auto const to = i % 2 == 0 ? btVector3{ from.x(), -100, from.z() } : from + btVector3{ std::cos(a), 0, std::sin(a) } * btScalar(120);
+		queries.rays.push_back({ from, to });
+	}
+
+	for (int i = 0; i < option.castNum; i++)
+	{
+		btVector3 const from{ position(engine), 60, position(engine) };
+		queries.casts.push_back({ from, btVector3{ from.x(), -60, from.z() } });
+	}
+
+	for (int i = 0; i < option.boxNum; i++)
+	{
+		btVector3 const center{ position(engine), height(engine), position(engine) };
+		btVector3 const extent{ size(engine), size(engine), size(engine) };
+		queries.boxes.push_back({ center - extent, center + extent });
+	}
+
+	return queries;
+}
+
+struct BvhBenchmarkQueryResult
+{
+	double rayTime{};
+	double castTime{};
+	double boxTime{};
+	std::vector<btScalar> rayFractions{};
+	std::vector<btScalar> castFractions{};
+	std::vector<int> boxCounts{};
+};
+
+inline BvhBenchmarkQueryResult run_bvh_benchmark_queries(int repeat, btBvhTriangleMeshShape& shape, BvhBenchmarkQueries const& queries)
+{
+	BvhBenchmarkQueryResult result{};
+	result.rayFractions.resize(queries.rays.size());
+	result.castFractions.resize(queries.casts.size());
+	result.boxCounts.resize(queries.boxes.size());
+
+	result.rayTime = measure_best(repeat, [&] {
+		for (std::size_t i = 0; i < queries.rays.size(); i++)
+		{
+			auto const& [from, to] = queries.rays[i];
+			BvhBenchmarkRayCallback callback{ from, to };
+			shape.performRaycast(&callback, from, to);
+			result.rayFractions[i] = callback.m_hitFraction;
+		}
+	});
+
+	btBoxShape const box{ btVector3{ 1, btScalar(0.5), 1 } };
+	btVector3 boxMin{}, boxMax{};
+	box.getAabb(btTransform::getIdentity(), boxMin, boxMax);
+	result.castTime = measure_best(repeat, [&] {
+		for (std::size_t i = 0; i < queries.casts.size(); i++)
+		{
+			auto const& [from, to] = queries.casts[i];
+			btTransform const fromTransform{ btQuaternion::getIdentity(), from };
+			btTransform const toTransform{ btQuaternion::getIdentity(), to };
+			BvhBenchmarkCastCallback callback{ &box, fromTransform, toTransform, btTransform::getIdentity(), 0 };
+			shape.performConvexcast(&callback, from, to, boxMin, boxMax);
+			result.castFractions[i] = callback.m_hitFraction;
+		}
+	});
+
+	auto const bvh = shape.getOptimizedBvh();
+	result.boxTime = measure_best(repeat, [&] {
+		for (std::size_t i = 0; i < queries.boxes.size(); i++)
+		{
+			BvhBenchmarkOverlapCallback callback{};
+			bvh->reportAabbOverlappingNodex(&callback, queries.boxes[i][0], queries.boxes[i][1]);
+			result.boxCounts[i] = callback.count;
+		}
+	});
+
+	return result;
+}
+
+inline void write_bvh_benchmark_query_result(JsonWriter& json, std::string_view key, BvhBenchmarkQueryResult const& result)
+{
+	json.beginObject(key);
+	json.value("ray_us", result.rayTime * 1e6 / static_cast<double>(result.rayFractions.size()));
+	json.value("cast_us", result.castTime * 1e6 / static_cast<double>(result.castFractions.size()));
+	json.value("aabb_us", result.boxTime * 1e6 / static_cast<double>(result.boxCounts.size()));
+	json.endObject();
+}
+
+// m[ĥׂŁA؂XbhɂȂƁALbVǂ񂾖؂킩
+inline bool same_bvh_nodes(SahOptimizedBvh const& a, SahOptimizedBvh const& b)
+{
+	return a.getNodeNum() == b.getNodeNum() &&
+		a.getSubtreeHeaderNum() == b.getSubtreeHeaderNum() &&
+		std::memcmp(a.getNodes(), b.getNodes(), sizeof(btQuantizedBvhNode) * static_cast<std::size_t>(a.getNodeNum())) == 0 &&
+		std::memcmp(a.getSubtreeHeaders(), b.getSubtreeHeaders(), sizeof(btBvhSubtreeInfo) * static_cast<std::size_t>(a.getSubtreeHeaderNum())) == 0;
+}
+
+inline int run_bvh_benchmark(int argc, char** argv)
+{
+	BvhBenchmarkOption option{};
+	if (!parse_bvh_benchmark_option(argc, argv, option)) {
+		print_bvh_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the bvh benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+
+	// 1{Xɑ₵AŌ͎w肵Xbh
+	std::vector<int> threadCounts{};
+	for (int t = 1; t < threadNum; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(threadNum);
+
+	auto const mesh = make_bvh_benchmark_mesh(option);
+	auto const queries = make_bvh_benchmark_queries(option);
+
+	// LbṼbVƓCAEg̒_̂܂ܓn
+	btIndexedMesh part{};
+	part.m_numTriangles = static_cast<int>(mesh.indices.size() / 3);
+	part.m_triangleIndexBase = reinterpret_cast<unsigned char const*>(mesh.indices.data());
+	part.m_triangleIndexStride = 3 * sizeof(std::uint32_t);
+	part.m_numVertices = static_cast<int>(mesh.vertices.size());
+	part.m_vertexBase = reinterpret_cast<unsigned char const*>(mesh.vertices.data());
+	part.m_vertexStride = sizeof(std::array<float, 6>);
+	part.m_indexType = PHY_INTEGER;
+	part.m_vertexType = PHY_FLOAT;
+
+	std::array<float, 3> boundsMin{}, boundsMax{};
+	compute_mesh_bounds(mesh.vertices, boundsMin, boundsMax);
+	btVector3 const aabbMin{ boundsMin[0], boundsMin[1], boundsMin[2] };
+	btVector3 const aabbMax{ boundsMax[0], boundsMax[1], boundsMax[2] };
+
+	btTriangleIndexVertexArray meshInterface{};
+	meshInterface.addIndexedMesh(part, PHY_INTEGER);
+	meshInterface.setPremadeAabb(aabbMin, aabbMax);
+
+	auto const meshHash = hash_mesh_source({ reinterpret_cast<char const*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(std::array<float, 6>) }) ^
+		(hash_mesh_source({ reinterpret_cast<char const*>(mesh.indices.data()), mesh.indices.size() * sizeof(std::uint32_t) }) << 1);
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "bvh");
+	json.value("repeat", option.repeat);
+	json.value("triangles", mesh.indices.size() / 3);
+	json.value("ground_triangles", 2 * option.gridSize * option.gridSize);
+	json.value("task_triangles", option.config.taskPrimitiveNum);
+	json.value("threads", threadNum);
+
+	// 鎞
+	json.beginObject("build_ms");
+
+	scheduler->setNumThreads(1);
+	std::unique_ptr<btOptimizedBvh> bulletBvh{};
+	json.value("bullet", 1e3 * measure_best(option.repeat, [&] {
+		bulletBvh = std::make_unique<btOptimizedBvh>();
+		bulletBvh->build(&meshInterface, true, aabbMin, aabbMax);
+	}));
+
+	std::unique_ptr<SahOptimizedBvh> sahBvh{};
+	std::unique_ptr<SahOptimizedBvh> firstBvh{};
+	auto deterministic = true;
+	for (auto const threads : threadCounts)
+	{
+		scheduler->setNumThreads(threads);
+		json.value("sah_threads_" + std::to_string(threads), 1e3 * measure_best(option.repeat, [&] {
+			sahBvh = std::make_unique<SahOptimizedBvh>();
+			sahBvh->buildSah(&meshInterface, aabbMin, aabbMax, option.config);
+		}));
+
+		if (!firstBvh)
+			firstBvh = std::move(sahBvh);
+		else
+			deterministic = deterministic && same_bvh_nodes(*firstBvh, *sahBvh);
+	}
+	sahBvh = std::move(firstBvh);
+	scheduler->setNumThreads(threadNum);
+	json.endObject();
+
+	json.beginObject("tree");
+	json.value("nodes", sahBvh->getNodeNum());
+	json.value("subtrees_bullet", bulletBvh->getSubtreeInfoArray().size());
+	json.value("subtrees_sah", sahBvh->getSubtreeHeaderNum());
+	json.value("sah_cost_bullet", compute_bvh_sah_cost(*bulletBvh));
+	json.value("sah_cost_sah", compute_bvh_sah_cost(*sahBvh));
+	json.endObject();
+
+	// ǂݍގԁAǂy[WLbVɍڂt@Cǂ
+	// Bulleť`̓obt@ɓǂdeSerializeInPlaceŃ|C^𒼂ALbV̓}bv邾
+	auto const cacheFileName = (std::filesystem::temp_directory_path() / ("practice-bullet-benchmark" + std::string{ BVH_CACHE_EXTENSION })).string();
+	auto const bulletFileName = (std::filesystem::temp_directory_path() / "practice-bullet-benchmark.bvh").string();
+
+	auto const writeTime = measure_best(option.repeat, [&] {
+		write_bvh_cache(cacheFileName.c_str(), *sahBvh, meshHash);
+	});
+
+	auto const bulletFileSize = bulletBvh->calculateSerializeBufferSize();
+	{
+		std::unique_ptr<void, decltype(&btAlignedFreeInternal)> buffer{ btAlignedAlloc(bulletFileSize, 16), &btAlignedFreeInternal };
+		bulletBvh->serializeInPlace(buffer.get(), bulletFileSize, false);
+		std::ofstream out{ bulletFileName, std::ios::binary | std::ios::trunc };
+		out.write(static_cast<char const*>(buffer.get()), bulletFileSize);
+	}
+
+	json.beginObject("load_ms");
+
+	std::unique_ptr<btBvhTriangleMeshShape> rebuiltShape{};
+	auto const rebuildTime = measure_best(option.repeat, [&] {
+		rebuiltShape = std::make_unique<btBvhTriangleMeshShape>(&meshInterface, true, true);
+	});
+	json.value("rebuild", rebuildTime * 1e3);
+
+	std::unique_ptr<void, decltype(&btAlignedFreeInternal)> bulletBuffer{ nullptr, &btAlignedFreeInternal };
+	std::unique_ptr<btBvhTriangleMeshShape> bulletShape{};
+	json.value("bullet_serialized", 1e3 * measure_best(option.repeat, [&] {
+		bulletShape.reset();
+		bulletBuffer.reset(btAlignedAlloc(bulletFileSize, 16));
+		std::ifstream in{ bulletFileName, std::ios::binary };
+		in.read(static_cast<char*>(bulletBuffer.get()), bulletFileSize);
+		auto const bvh = btOptimizedBvh::deSerializeInPlace(bulletBuffer.get(), bulletFileSize, false);
+		bulletShape = std::make_unique<btBvhTriangleMeshShape>(&meshInterface, true, false);
+		bulletShape->setOptimizedBvh(bvh);
+	}));
+
+	std::unique_ptr<SahOptimizedBvh> mappedBvh{};
+	std::unique_ptr<btBvhTriangleMeshShape> mappedShape{};
+	auto const mappedTime = measure_best(option.repeat, [&] {
+		mappedShape.reset();
+		mappedBvh = open_bvh_cache(cacheFileName.c_str(), meshHash);
+		mappedShape = std::make_unique<btBvhTriangleMeshShape>(&meshInterface, true, false);
+		if (mappedBvh)
+			mappedShape->setOptimizedBvh(mappedBvh.get());
+	});
+	json.value("mapped", mappedTime * 1e3);
+	json.value("mapped_speedup_over_rebuild", rebuildTime / mappedTime);
+	json.endObject();
+
+	json.value("cache_write_ms", writeTime * 1e3);
+	json.value("cache_bytes", std::filesystem::file_size(cacheFileName));
+	json.value("bullet_serialized_bytes", bulletFileSize);
+
+	auto const mappedValid = mappedBvh && mappedBvh->isMapped() && same_bvh_nodes(*sahBvh, *mappedBvh);
+	// nbVႤbVɂ͎gȂ
+	auto const rejectsOtherMesh = !open_bvh_cache(cacheFileName.c_str(), meshHash + 1);
+
+	// NG̎ԁABullet̖؂͍蒼
+	btBvhTriangleMeshShape sahShape{ &meshInterface, true, false };
+	sahShape.setOptimizedBvh(sahBvh.get());
+
+	auto const bulletResult = run_bvh_benchmark_queries(option.repeat, *rebuiltShape, queries);
+	auto const sahResult = run_bvh_benchmark_queries(option.repeat, sahShape, queries);
+	BvhBenchmarkQueryResult mappedResult{};
+	if (mappedValid)
+		mappedResult = run_bvh_benchmark_queries(option.repeat, *mappedShape, queries);
+
+	json.beginObject("query");
+	write_bvh_benchmark_query_result(json, "bullet", bulletResult);
+	write_bvh_benchmark_query_result(json, "sah", sahResult);
+	if (mappedValid)
+		write_bvh_benchmark_query_result(json, "mapped", mappedResult);
+	json.value("ray_speedup", bulletResult.rayTime / sahResult.rayTime);
+	json.value("cast_speedup", bulletResult.castTime / sahResult.castTime);
+	json.value("aabb_speedup", bulletResult.boxTime / sahResult.boxTime);
+	json.endObject();
+
+	// t̗ʎqAABB͓Ȃ̂ŁAł߂qbgƏdȂt͖̐؂ɂȂ
+	auto const sameResult = [](BvhBenchmarkQueryResult const& a, BvhBenchmarkQueryResult const& b) {
+		return a.rayFractions == b.rayFractions && a.castFractions == b.castFractions && a.boxCounts == b.boxCounts;
+	};
+	auto const rayHits = std::count_if(sahResult.rayFractions.begin(), sahResult.rayFractions.end(), [](btScalar f) { return f < btScalar(1); });
+	auto const sameAsBullet = sameResult(bulletResult, sahResult);
+	auto const mappedSame = mappedValid && sameResult(sahResult, mappedResult);
+
+	json.value("ray_hits", rayHits);
+	json.value("deterministic", deterministic);
+	json.value("same_hits_as_bullet", sameAsBullet);
+	json.value("mapped_valid", mappedValid);
+	json.value("mapped_same_hits", mappedSame);
+	json.value("rejects_other_mesh", rejectsOtherMesh);
+
+	auto const correct = deterministic && sameAsBullet && mappedValid && mappedSame && rejectsOtherMesh && rayHits > 0;
+	json.value("correct", correct);
+	json.endObject();
+
+	bulletShape.reset();
+	mappedShape.reset();
+	mappedBvh.reset();
+	std::filesystem::remove(cacheFileName);
+	std::filesystem::remove(bulletFileName);
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,388 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/BatchedCompoundShape.hpp"
+#include<algorithm>
+#include<cmath>
+#include<cstdlib>
+#include<iostream>
+#include<iterator>
+#include<memory>
+#include<string_view>
+#include<tuple>
+#include<vector>
+
+// ̎q`ŁAq1updateChildTransformœ̂ƁABatchedCompoundShapeł܂Ƃ߂ēׂ̂
+// SĂ̎q𓮂ꍇƈꕔꍇ̍XV̎ԂƁA
+// q̈ꕔƂꂫ̕`ǂ̏Փ˂AbtCompoundCompoundCollisionAlgorithmƔׂĐڐG𒲂ׂ
+
+struct CompoundBenchmarkOption
+{
+	int repeat = 3;
+	// 0Ȃ̑傫S
+	int childNum = 0;
+	// ꕔƂ́A̐Ƃ1̎q𓮂
+	int animatedEvery = 16;
+	int frameNum = 60;
+};
+
+constexpr int COMPOUND_BENCHMARK_CHILD_NUMS[] = { 1000, 4000, 10000 };
+
+inline void print_compound_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark compound [options]\n"
+		"  --repeat <n>    run n times and report the fastest (default 3)\n"
+		"  --children <n>  children of each compound (default 1000, 4000 and 10000)\n"
+		"  --animated <n>  move every n-th child when only some children move (default 16)\n"
+		"  --frames <n>    collision frames per run (default 60)\n";
+}
+
+// sfalse
+inline bool parse_compound_benchmark_option(int argc, char** argv, CompoundBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--children")
+			option.childNum = std::atoi(value);
+		else if (name == "--animated")
+			option.animatedEvery = std::atoi(value);
+		else if (name == "--frames")
+			option.frameNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.childNum < 0 || option.animatedEvery < 1 || option.frameNum < 1) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// qsidê̗̊iq1ׂ
+inline std::vector<btTransform> make_compound_benchmark_layout(int childNum)
+{
+	auto const side = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(childNum))));
+	std::vector<btTransform> transforms{};
+	transforms.reserve(childNum);
+	for (int i = 0; i < childNum; i++)
+	{
+		btVector3 const position{ btScalar(i % side), btScalar(i / side % side), btScalar(i / (side * side)) };
+		transforms.push_back(btTransform{ btQuaternion::getIdentity(), position });
+	}
+	return transforms;
+}
+
+// q̈ʒű߂ŗh炷AphaseႦΑSĂ̎q̕ϊς
+inline btTransform animate_compound_benchmark_child(btTransform const& base, int childIndex, int phase)
+{
+	auto const t = btScalar(0.37) * btScalar(phase) + btScalar(0.11) * btScalar(childIndex);
+	btQuaternion const rotation{ btVector3{ 0, 1, 0 }, btScalar(0.2) * std::sin(t) };
+	btVector3 const offset{ btScalar(0.05) * std::sin(t * 2), btScalar(0.05) * std::cos(t * 3), 0 };
+	return btTransform{ rotation * base.getRotation(), base.getOrigin() + offset };
+}
+
+// tAABBqAABBƓŁAm[hqAABB傤Ǎ킹̂ŁA[JAABBƓ
+inline bool is_tight_compound_tree(btCompoundShape const& shape)
+{
+	auto const tree = shape.getDynamicAabbTree();
+	if (!tree || !tree->m_root)
+		return false;
+
+	auto tight = true;
+	std::vector<btDbvtNode const*> nodes{ tree->m_root };
+	while (!nodes.empty())
+	{
+		auto const node = nodes.back();
+		nodes.pop_back();
+		btDbvtVolume expected{};
+		if (node->isleaf()) {
+			btVector3 aabbMin{}, aabbMax{};
+			shape.getChildShape(node->dataAsInt)->getAabb(shape.getChildTransform(node->dataAsInt), aabbMin, aabbMax);
+			expected = btDbvtVolume::FromMM(aabbMin, aabbMax);
+		}
+		else {
+			Merge(node->childs[0]->volume, node->childs[1]->volume, expected);
+			nodes.push_back(node->childs[0]);
+			nodes.push_back(node->childs[1]);
+		}
+		tight = tight && !NotEqual(expected, node->volume);
+	}
+
+	// btCompoundShape::getAabb̓[JAABBbtTransformAabbƓvZōL
+	btVector3 aabbMin{}, aabbMax{}, rootMin{}, rootMax{};
+	shape.getAabb(btTransform::getIdentity(), aabbMin, aabbMax);
+	btTransformAabb(tree->m_root->volume.Mins(), tree->m_root->volume.Maxs(), shape.getMargin(), btTransform::getIdentity(), rootMin, rootMax);
+	return tight && aabbMin == rootMin && aabbMax == rootMax;
+}
+
+// ̕`ƁAɈʂ߂荞񂾂ꂫ̋̕`u[h
+// batchedȂ痼̌`BatchedCompoundShapeɂBatchedCompoundCollisionConfigurationg
+struct CompoundBenchmarkWorld
+{
+	std::unique_ptr<btDefaultCollisionConfiguration> configuration{};
+	std::unique_ptr<btCollisionDispatcher> dispatcher{};
+	std::unique_ptr<btDbvtBroadphase> broadphase{};
+	std::unique_ptr<btCollisionWorld> world{};
+	btBoxShape brick{ btVector3{ btScalar(0.45), btScalar(0.45), btScalar(0.45) } };
+	btSphereShape stone{ btScalar(0.45) };
+	std::unique_ptr<btCompoundShape> building{};
+	std::unique_ptr<btCompoundShape> debris{};
+	btCollisionObject buildingObject{};
+	btCollisionObject debrisObject{};
+	BatchedCompoundShape* batchedBuilding = nullptr;
+	std::vector<btTransform> layout{};
+	std::vector<int> animatedIndices{};
+	std::vector<btTransform> animatedTransforms{};
+
+	CompoundBenchmarkWorld(bool batched, int childNum, int animatedEvery)
+	{
+		if (batched)
+			configuration = std::make_unique<BatchedCompoundCollisionConfiguration>();
+		else
+			configuration = std::make_unique<btDefaultCollisionConfiguration>();
+		dispatcher = std::make_unique<btCollisionDispatcher>(configuration.get());
+		broadphase = std::make_unique<btDbvtBroadphase>();
+		world = std::make_unique<btCollisionWorld>(dispatcher.get(), broadphase.get(), configuration.get());
+
+		if (batched) {
+			auto shape = std::make_unique<BatchedCompoundShape>(true, childNum);
+			batchedBuilding = shape.get();
+			building = std::move(shape);
+			debris = std::make_unique<BatchedCompoundShape>(true, childNum);
+		}
+		else {
+			building = std::make_unique<btCompoundShape>(true, childNum);
+			debris = std::make_unique<btCompoundShape>(true, childNum);
+		}
+
+		layout = make_compound_benchmark_layout(childNum);
+		for (auto const& transform : layout)
+		{
+			building->addChildShape(transform, &brick);
+			debris->addChildShape(transform, &stone);
+		}
+		for (int i = 0; i < childNum; i += animatedEvery)
+			animatedIndices.push_back(i);
+		animatedTransforms.resize(animatedIndices.size());
+
+		// ꂫx = 0̑wx = side - 1̑wɂ߂荞܂AyAz͔炵1̋4̔ɐG悤ɂ
+		auto const side = btScalar(std::ceil(std::cbrt(static_cast<double>(childNum))));
+		buildingObject.setCollisionShape(building.get());
+		debrisObject.setCollisionShape(debris.get());
+		debrisObject.setWorldTransform(btTransform{ btQuaternion::getIdentity(), btVector3{ side - btScalar(0.3), btScalar(0.5), btScalar(0.5) } });
+		world->addCollisionObject(&buildingObject);
+		world->addCollisionObject(&debrisObject);
+	}
+
+	~CompoundBenchmarkWorld()
+	{
+		world->removeCollisionObject(&debrisObject);
+		world->removeCollisionObject(&buildingObject);
+	}
+	CompoundBenchmarkWorld(CompoundBenchmarkWorld const&) = delete;
+	CompoundBenchmarkWorld& operator=(CompoundBenchmarkWorld const&) = delete;
+
+	// ̈ꕔ̎q𓮂ĂՓ˂𒲂ׂ
+	void step(int phase, bool animate)
+	{
+		if (animate) {
+			for (std::size_t i = 0; i < animatedIndices.size(); i++)
+				animatedTransforms[i] = animate_compound_benchmark_child(layout[animatedIndices[i]], animatedIndices[i], phase);
+
+			if (batchedBuilding) {
+				batchedBuilding->updateChildTransforms(animatedIndices, animatedTransforms);
+			}
+			else {
+				for (std::size_t i = 0; i < animatedIndices.size(); i++)
+					building->updateChildTransform(animatedIndices[i], animatedTransforms[i], false);
+				building->recalculateLocalAabb();
+			}
+		}
+		world->performDiscreteCollisionDetection();
+	}
+
+	// q̔ԍƋŕׂڐG_
+	std::vector<std::tuple<int, int, btScalar>> getContacts() const
+	{
+		std::vector<std::tuple<int, int, btScalar>> contacts{};
+		for (int i = 0; i < dispatcher->getNumManifolds(); i++)
+		{
+			auto const manifold = dispatcher->getManifoldByIndexInternal(i);
+			for (int j = 0; j < manifold->getNumContacts(); j++)
+			{
+				auto const& point = manifold->getContactPoint(j);
+				contacts.push_back({ point.m_index0, point.m_index1, point.getDistance() });
+			}
+		}
+		std::sort(contacts.begin(), contacts.end());
+		return contacts;
+	}
+};
+
+inline int run_compound_benchmark(int argc, char** argv)
+{
+	CompoundBenchmarkOption option{};
+	if (!parse_compound_benchmark_option(argc, argv, option)) {
+		print_compound_benchmark_usage();
+		return 1;
+	}
+
+	std::vector<int> childNums{};
+	if (option.childNum > 0)
+		childNums.push_back(option.childNum);
+	else
+		childNums.assign(std::begin(COMPOUND_BENCHMARK_CHILD_NUMS), std::end(COMPOUND_BENCHMARK_CHILD_NUMS));
+
+	auto const perFrame = [&](double seconds) { return seconds * 1e3 / static_cast<double>(option.frameNum); };
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "compound");
+	json.value("repeat", option.repeat);
+	json.value("animated_every", option.animatedEvery);
+	json.value("frames", option.frameNum);
+
+	auto correct = true;
+	json.beginArray("compounds");
+	for (auto const childNum : childNums)
+	{
+		json.beginObject();
+		json.value("children", childNum);
+
+		btBoxShape brick{ btVector3{ btScalar(0.45), btScalar(0.45), btScalar(0.45) } };
+		auto const layout = make_compound_benchmark_layout(childNum);
+		btCompoundShape bulletShape{ true, childNum };
+		BatchedCompoundShape batchedShape{ true, childNum };
+		for (auto const& transform : layout)
+		{
+			bulletShape.addChildShape(transform, &brick);
+			batchedShape.addChildShape(transform, &brick);
+		}
+
+		// ႤϊɂȂ悤2̒u݂Ɏg
+		std::vector<btTransform> allTransforms[2]{};
+		std::vector<int> someIndices{};
+		std::vector<btTransform> someTransforms[2]{};
+		for (int phase = 0; phase < 2; phase++)
+		{
+			for (int i = 0; i < childNum; i++)
+				allTransforms[phase].push_back(animate_compound_benchmark_child(layout[i], i, phase));
+			for (int i = 0; i < childNum; i += option.animatedEvery)
+				someTransforms[phase].push_back(allTransforms[phase][i]);
+		}
+		for (int i = 0; i < childNum; i += option.animatedEvery)
+			someIndices.push_back(i);
+
+		auto const updateBulletEach = [&](std::vector<int> const* indices, std::vector<btTransform> const& transforms, bool recalculateEach) {
+			for (std::size_t i = 0; i < transforms.size(); i++)
+				bulletShape.updateChildTransform(indices ? (*indices)[i] : static_cast<int>(i), transforms[i], recalculateEach);
+			if (!recalculateEach)
+				bulletShape.recalculateLocalAabb();
+		};
+
+		// q𓮂ԁAbullet_each͎qƂrecalculateLocalAabbĂԊ̎gAbullet_recalculate_once͍Ō1񂾂Ă
+		int phase = 0;
+		json.beginObject("update_all_ms");
+		auto const bulletEachAll = measure_best(option.repeat, [&] { updateBulletEach(nullptr, allTransforms[phase ^= 1], true); });
+		auto const bulletOnceAll = measure_best(option.repeat, [&] { updateBulletEach(nullptr, allTransforms[phase ^= 1], false); });
+		auto const batchedAll = measure_best(option.repeat, [&] { batchedShape.updateChildTransforms(allTransforms[phase ^= 1]); });
+		json.value("bullet_each", bulletEachAll * 1e3);
+		json.value("bullet_recalculate_once", bulletOnceAll * 1e3);
+		json.value("batched", batchedAll * 1e3);
+		json.value("speedup_over_each", bulletEachAll / batchedAll);
+		json.value("speedup_over_once", bulletOnceAll / batchedAll);
+		json.endObject();
+
+		json.beginObject("update_some_ms");
+		auto const bulletEachSome = measure_best(option.repeat, [&] { updateBulletEach(&someIndices, someTransforms[phase ^= 1], true); });
+		auto const bulletOnceSome = measure_best(option.repeat, [&] { updateBulletEach(&someIndices, someTransforms[phase ^= 1], false); });
+		auto const batchedSome = measure_best(option.repeat, [&] { batchedShape.updateChildTransforms(someIndices, someTransforms[phase ^= 1]); });
+		json.value("moved", someIndices.size());
+		json.value("bullet_each", bulletEachSome * 1e3);
+		json.value("bullet_recalculate_once", bulletOnceSome * 1e3);
+		json.value("batched", batchedSome * 1e3);
+		json.value("speedup_over_each", bulletEachSome / batchedSome);
+		json.value("speedup_over_once", bulletOnceSome / batchedSome);
+		json.endObject();
+
+		// uɂĂA؂ƃ[JAABBׂ
+		updateBulletEach(nullptr, allTransforms[0], false);
+		batchedShape.updateChildTransforms(allTransforms[0]);
+		updateBulletEach(&someIndices, someTransforms[1], false);
+		batchedShape.updateChildTransforms(someIndices, someTransforms[1]);
+		btVector3 bulletMin{}, bulletMax{}, batchedMin{}, batchedMax{};
+		bulletShape.getAabb(btTransform::getIdentity(), bulletMin, bulletMax);
+		batchedShape.getAabb(btTransform::getIdentity(), batchedMin, batchedMax);
+		auto const sameAabb = bulletMin == batchedMin && bulletMax == batchedMax;
+		auto const tightTree = is_tight_compound_tree(batchedShape) && is_tight_compound_tree(bulletShape);
+
+		// Ƃꂫ̏ՓˁA1t[ׂĐڐGׂĂ玞Ԃ𑪂
+		CompoundBenchmarkWorld bulletWorld{ false, childNum, option.animatedEvery };
+		CompoundBenchmarkWorld batchedWorld{ true, childNum, option.animatedEvery };
+		auto sameContacts = true;
+		std::size_t contactNum{};
+		for (int frame = 0; frame < option.frameNum; frame++)
+		{
+			// O͎~߂܂܁A㔼͈ꕔ̎q𓮂
+			auto const animate = frame >= option.frameNum / 2;
+			bulletWorld.step(frame, animate);
+			batchedWorld.step(frame, animate);
+			auto const contacts = bulletWorld.getContacts();
+			sameContacts = sameContacts && contacts == batchedWorld.getContacts();
+			contactNum = std::max(contactNum, contacts.size());
+		}
+
+		auto const measureWorld = [&](CompoundBenchmarkWorld& world, bool animate) {
+			int frame = 0;
+			return measure_best(option.repeat, [&] {
+				for (int i = 0; i < option.frameNum; i++)
+					world.step(frame++, animate);
+			});
+		};
+		json.beginObject("collision_ms_per_frame");
+		auto const bulletStill = measureWorld(bulletWorld, false);
+		auto const batchedStill = measureWorld(batchedWorld, false);
+		auto const bulletAnimated = measureWorld(bulletWorld, true);
+		auto const batchedAnimated = measureWorld(batchedWorld, true);
+		json.value("child_pairs", bulletWorld.dispatcher->getNumManifolds());
+		json.value("bullet_still", perFrame(bulletStill));
+		json.value("batched_still", perFrame(batchedStill));
+		json.value("bullet_animated", perFrame(bulletAnimated));
+		json.value("batched_animated", perFrame(batchedAnimated));
+		json.value("still_speedup", bulletStill / batchedStill);
+		json.value("animated_speedup", bulletAnimated / batchedAnimated);
+		json.endObject();
+
+		json.value("contacts", contactNum);
+		json.value("same_aabb", sameAabb);
+		json.value("tight_tree", tightTree);
+		json.value("same_contacts", sameContacts);
+		json.endObject();
+
+		correct = correct && sameAabb && tightTree && sameContacts && contactNum > 0;
+	}
+	json.endArray();
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,566 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/DeformableKrylovSolver.hpp"
+#include"../src/Scene.hpp"
+#include"../external/bullet3/src/BulletSoftBody/btConjugateGradient.h"
+#include<algorithm>
+#include<array>
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+#include<iostream>
+#include<memory>
+#include<string>
+#include<string_view>
+#include<tuple>
+#include<utility>
+#include<vector>
+
+// ΂˂̕zƃlItbN̂̎lʑ̖̂_ރIC[Ői߁A
+// btDeformableBodySolverƓAoS̐ߓ_ɗvf1XbhőŁAbtConjugateGradientŉꍇƁA
+// DeformableKrylovSolverXbhςĉꍇŔׂ
+// DeformableKrylovSolveřʂXbhɂ炸rbgPʂœƁAAoS̑ƈʒuقړ𒲂ׂ
+
+struct DeformableBenchmarkOption
+{
+	int repeat = 3;
+	std::size_t stepNum = 10;
+	btScalar tolerance = btScalar(1e-5);
+	int maxIterations = 200;
+	int grainSize = 256;
+	int threadNum = 0;
+};
+
+// z̈ӂ̐ߓ_̐
+constexpr int DEFORMABLE_BENCHMARK_CLOTH_SIZES[] = { 32, 64, 128 };
+// _̒fʂ̈ӂ̗̂̐A͂4{
+constexpr int DEFORMABLE_BENCHMARK_BEAM_SIZES[] = { 3, 6, 10 };
+
+inline void print_deformable_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark deformable [options]\n"
+		"  --repeat <n>          simulate n times and report the fastest (default 3)\n"
+		"  --steps <n>           steps per simulation (default 10)\n"
+		"  --tolerance <x>       relative residual to stop at (default 1e-5)\n"
+		"  --max-iterations <n>  iteration limit per solve (default 200)\n"
+		"  --grain <n>           nodes or elements per task (default 256)\n"
+		"  --threads <n>         largest thread count to try (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_deformable_benchmark_option(int argc, char** argv, DeformableBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--tolerance")
+			option.tolerance = static_cast<btScalar>(std::atof(value));
+		else if (name == "--max-iterations")
+			option.maxIterations = std::atoi(value);
+		else if (name == "--grain")
+			option.grainSize = std::atoi(value);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.stepNum < 1 || !(option.tolerance > 0) || option.maxIterations < 1 || option.grainSize < 1 || option.threadNum < 0) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// ̉ɓ̂邽߂̌`
+struct DeformableBenchmarkMesh
+{
+	std::string kind{};
+	int size{};
+	DeformableMaterial material{};
+	std::vector<btVector3> positions{};
+	// 0Ȃ瓮Ȃ
+	std::vector<btScalar> masses{};
+	std::vector<std::pair<int, int>> springs{};
+	std::vector<std::array<int, 4>> tetras{};
+};
+
+// size̕z\AfAȂ̂΂˂łȂA2̊pŒ肷
+inline DeformableBenchmarkMesh make_deformable_benchmark_cloth(int size)
+{
+	DeformableBenchmarkMesh mesh{ .kind = "cloth", .size = size };
+	mesh.material.springStiffness = 20;
+	mesh.material.springDamping = btScalar(0.01);
+
+	auto const spacing = btScalar(0.05);
+	auto const index = [&](int x, int y) { return y * size + x; };
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			mesh.positions.emplace_back(x * spacing, 10, y * spacing);
+			mesh.masses.push_back(btScalar(0.01));
+		}
+	}
+	mesh.masses[index(0, 0)] = 0;
+	mesh.masses[index(size - 1, 0)] = 0;
+
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			if (x + 1 < size) mesh.springs.push_back({ index(x, y), index(x + 1, y) });
+			if (y + 1 < size) mesh.springs.push_back({ index(x, y), index(x, y + 1) });
+			if (x + 1 < size && y + 1 < size)
+			{
+				mesh.springs.push_back({ index(x, y), index(x + 1, y + 1) });
+				mesh.springs.push_back({ index(x + 1, y), index(x, y + 1) });
+			}
+			if (x + 2 < size) mesh.springs.push_back({ index(x, y), index(x + 2, y) });
+			if (y + 2 < size) mesh.springs.push_back({ index(x, y), index(x, y + 2) });
+		}
+	}
+	return mesh;
+}
+
+// fʂ̈sizeA4 * sizê̗6̎lʑ̂ɕ_Ax = 0̖ʂŒ肷
+inline DeformableBenchmarkMesh make_deformable_benchmark_beam(int size)
+{
+	DeformableBenchmarkMesh mesh{ .kind = "beam", .size = size };
+	mesh.material.mu = 2000;
+	mesh.material.lambda = 8000;
+	mesh.material.neoHookeanDamping = btScalar(0.01);
+
+	auto const nx = 4 * size + 1;
+	auto const ny = size + 1;
+	auto const nz = size + 1;
+	auto const spacing = btScalar(0.1);
+	auto const index = [&](int x, int y, int z) { return (z * ny + y) * nx + x; };
+	for (int z = 0; z < nz; z++)
+	{
+		for (int y = 0; y < ny; y++)
+		{
+			for (int x = 0; x < nx; x++)
+				mesh.positions.emplace_back(x * spacing, 10 + y * spacing, z * spacing);
+		}
+	}
+
+	// ΊpL6ɕ̂ŁÂׂ̗Ɩʂ낤
+	constexpr int ORDERS[6][3] = { {0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0} };
+	for (int z = 0; z + 1 < nz; z++)
+	{
+		for (int y = 0; y + 1 < ny; y++)
+		{
+			for (int x = 0; x + 1 < nx; x++)
+			{
+				for (auto const& order : ORDERS)
+				{
+					std::array<int, 4> tetra{};
+					int corner[3] = { x, y, z };
+					tetra[0] = index(corner[0], corner[1], corner[2]);
+					for (int k = 0; k < 3; k++)
+					{
+						corner[order[k]]++;
+						tetra[k + 1] = index(corner[0], corner[1], corner[2]);
+					}
+					mesh.tetras.push_back(tetra);
+				}
+			}
+		}
+	}
+
+	// x1000Ŏlʑ̂̎ʂ4̐ߓ_ɕ
+	mesh.masses.assign(mesh.positions.size(), 0);
+	auto const tetraMass = 1000 * spacing * spacing * spacing / 6;
+	for (auto const& tetra : mesh.tetras)
+	{
+		for (auto const node : tetra)
+			mesh.masses[node] += tetraMass / 4;
+	}
+	for (int z = 0; z < nz; z++)
+	{
+		for (int y = 0; y < ny; y++)
+			mesh.masses[index(0, y, z)] = 0;
+	}
+	return mesh;
+}
+
+inline void build_deformable_benchmark_body(DeformableBenchmarkMesh const& mesh, SoaDeformableBody& body)
+{
+	for (std::size_t i = 0; i < mesh.positions.size(); i++)
+		body.appendNode(mesh.positions[i], mesh.masses[i]);
+	for (auto const& [a, b] : mesh.springs)
+		body.appendSpring(a, b);
+	for (auto const& t : mesh.tetras)
+		body.appendTetra(t[0], t[1], t[2], t[3]);
+}
+
+// btDeformableBodySolverƓAbtVector3̔zɗvfƂɑbtConjugateGradientŉrp̕ό`
+// btDeformableBackwardEulerObjectivȇɁAbtConjugateGradientgmultiplyAprojectAprecondition
+class AosDeformableReference
+{
+	using TVStack = btAlignedObjectArray<btVector3>;
+
+	struct Node
+	{
+		btVector3 x{ 0,0,0 };
+		btVector3 v{ 0,0,0 };
+		btScalar mass{};
+		btScalar im{};
+	};
+	struct Spring
+	{
+		int n[2]{};
+		btScalar rl{};
+	};
+	struct Tetra
+	{
+		int n[4]{};
+		btMatrix3x3 dmInverse{};
+		btScalar volume{};
+		NeoHookeanScratch scratch{};
+	};
+
+	DeformableMaterial material{};
+	btVector3 gravity{ 0, btScalar(-9.8), 0 };
+	btScalar tolerance{};
+	int maxIterations{};
+	std::vector<Node> nodes{};
+	std::vector<Spring> springs{};
+	std::vector<Tetra> tetras{};
+	// Ăstep̎
+	btScalar h{};
+	int lastIterations{};
+
+	btMatrix3x3 edgeMatrix(Tetra const& t, TVStack const& x) const
+	{
+		return tetra_edge_matrix(x[t.n[0]], x[t.n[1]], x[t.n[2]], x[t.n[3]]) * t.dmInverse;
+	}
+
+public:
+	// ap = A * pAȂߓ_btConjugateGradientproject0ɂ
+	void multiply(TVStack const& p, TVStack& ap) const
+	{
+		for (int i = 0; i < ap.size(); i++)
+			ap[i] = p[i] * nodes[i].mass;
+		for (auto const& s : springs)
+		{
+			auto const d = nodes[s.n[1]].x - nodes[s.n[0]].x;
+			auto const delta = p[s.n[1]] - p[s.n[0]];
+			auto const df = h * h * spring_elastic_differential(d, s.rl, material.springStiffness, delta) + (h * material.springDamping) * delta;
+			ap[s.n[0]] -= df;
+			ap[s.n[1]] += df;
+		}
+		for (auto const& t : tetras)
+		{
+			auto const dF = edgeMatrix(t, p);
+			auto const dP = neo_hookean_piola_differential(t.scratch, dF, material.mu, material.lambda) * (h * h) +
+				neo_hookean_damping_piola(dF, material.neoHookeanDamping * material.mu, material.neoHookeanDamping * material.lambda) * h;
+			auto const df = tetra_nodal_forces(dP, t.dmInverse, t.volume);
+			ap[t.n[0]] += df.getColumn(0) + df.getColumn(1) + df.getColumn(2);
+			for (int k = 0; k < 3; k++)
+				ap[t.n[k + 1]] -= df.getColumn(k);
+		}
+	}
+
+	// Ȃߓ_0ɂ
+	void project(TVStack& r) const
+	{
+		for (int i = 0; i < r.size(); i++)
+		{
+			if (nodes[i].im == 0)
+				r[i].setZero();
+		}
+	}
+
+	// btDeformableBackwardEulerObjective̊Ɠʂ̋t
+	void precondition(TVStack const& r, TVStack& z) const
+	{
+		for (int i = 0; i < r.size(); i++)
+			z[i] = r[i] * nodes[i].im;
+	}
+
+	AosDeformableReference(DeformableBenchmarkMesh const& mesh, btScalar tolerance, int maxIterations)
+		: material{ mesh.material }, tolerance{ tolerance }, maxIterations{ maxIterations }
+	{
+		for (std::size_t i = 0; i < mesh.positions.size(); i++)
+		{
+			auto& node = nodes.emplace_back();
+			node.x = mesh.positions[i];
+			node.mass = mesh.masses[i];
+			node.im = node.mass > 0 ? 1 / node.mass : 0;
+		}
+		for (auto const& [a, b] : mesh.springs)
+			springs.push_back({ { a, b }, nodes[a].x.distance(nodes[b].x) });
+		for (auto const& n : mesh.tetras)
+		{
+			auto& t = tetras.emplace_back();
+			std::copy(n.begin(), n.end(), t.n);
+			auto dm = tetra_edge_matrix(nodes[t.n[0]].x, nodes[t.n[1]].x, nodes[t.n[2]].x, nodes[t.n[3]].x);
+			if (dm.determinant() < 0)
+			{
+				std::swap(t.n[2], t.n[3]);
+				dm = tetra_edge_matrix(nodes[t.n[0]].x, nodes[t.n[1]].x, nodes[t.n[2]].x, nodes[t.n[3]].x);
+			}
+			t.dmInverse = dm.inverse();
+			t.volume = dm.determinant() / 6;
+		}
+	}
+
+	void step(btScalar h)
+	{
+		this->h = h;
+		auto const n = static_cast<int>(nodes.size());
+		TVStack x{};
+		TVStack v{};
+		x.resize(n, btVector3(0, 0, 0));
+		v.resize(n, btVector3(0, 0, 0));
+		for (int i = 0; i < n; i++)
+		{
+			x[i] = nodes[i].x;
+			v[i] = nodes[i].v;
+		}
+		for (auto& t : tetras)
+			t.scratch = make_neo_hookean_scratch(edgeMatrix(t, x));
+
+		// E
+		TVStack b{};
+		b.resize(n, btVector3(0, 0, 0));
+		for (int i = 0; i < n; i++)
+			b[i] = gravity * (h * nodes[i].mass);
+		for (auto const& s : springs)
+		{
+			auto const d = x[s.n[1]] - x[s.n[0]];
+			auto const w = v[s.n[1]] - v[s.n[0]];
+			auto const f = h * spring_force(d, w, s.rl, material.springStiffness, material.springDamping) +
+				(h * h) * spring_elastic_differential(d, s.rl, material.springStiffness, w);
+			b[s.n[0]] += f;
+			b[s.n[1]] -= f;
+		}
+		for (auto const& t : tetras)
+		{
+			auto const dFv = edgeMatrix(t, v);
+			auto const P = (neo_hookean_piola(t.scratch, material.mu, material.lambda) +
+				neo_hookean_damping_piola(dFv, material.neoHookeanDamping * material.mu, material.neoHookeanDamping * material.lambda)) * h +
+				neo_hookean_piola_differential(t.scratch, dFv, material.mu, material.lambda) * (h * h);
+			auto const f = tetra_nodal_forces(P, t.dmInverse, t.volume);
+			b[t.n[0]] -= f.getColumn(0) + f.getColumn(1) + f.getColumn(2);
+			for (int k = 0; k < 3; k++)
+				b[t.n[k + 1]] += f.getColumn(k);
+		}
+		project(b);
+
+		// btDeformableBodySolverƓAstepƂɍƗp̔zmۂĉ
+		// btConjugateGradient͑OcrEM^-1 rŎ~߂̂ŁAΎc2n
+		TVStack dv{};
+		dv.resize(n, btVector3(0, 0, 0));
+		btConjugateGradient<AosDeformableReference> cg{ maxIterations };
+		cg.setTolerance(tolerance * tolerance);
+		lastIterations = cg.solve(*this, dv, b);
+
+		for (int i = 0; i < n; i++)
+		{
+			nodes[i].v += dv[i];
+			nodes[i].x += nodes[i].v * h;
+		}
+	}
+
+	btVector3 getPosition(int node) const { return nodes[node].x; }
+	int getLastIterations() const noexcept { return lastIterations; }
+};
+
+inline int run_deformable_benchmark(int argc, char** argv)
+{
+	DeformableBenchmarkOption option{};
+	if (!parse_deformable_benchmark_option(argc, argv, option)) {
+		print_deformable_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the deformable benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+
+	// 1{Xɑ₵AŌ͎w肵Xbh
+	std::vector<int> threadCounts{};
+	for (int t = 1; t < threadNum; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(threadNum);
+
+	std::vector<DeformableBenchmarkMesh> meshes{};
+	for (auto const size : DEFORMABLE_BENCHMARK_CLOTH_SIZES)
+		meshes.push_back(make_deformable_benchmark_cloth(size));
+	for (auto const size : DEFORMABLE_BENCHMARK_BEAM_SIZES)
+		meshes.push_back(make_deformable_benchmark_beam(size));
+
+	DeformableKrylovConfig const config{
+		.tolerance = option.tolerance,
+		.maxIterations = option.maxIterations,
+		.grainSize = option.grainSize,
+	};
+	auto const dt = btScalar(1. / 60.);
+	auto const stepNum = static_cast<double>(option.stepNum);
+	auto const perStep = [&](double seconds) { return seconds * 1e3 / stepNum; };
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "deformable");
+	json.value("repeat", option.repeat);
+	json.value("steps", option.stepNum);
+	json.value("tolerance", option.tolerance);
+	json.value("max_iterations", option.maxIterations);
+	json.value("grain", option.grainSize);
+	json.value("threads", threadNum);
+
+	auto correct = true;
+	json.beginArray("meshes");
+	for (auto const& mesh : meshes)
+	{
+		scheduler->setNumThreads(1);
+		std::unique_ptr<AosDeformableReference> reference{};
+		int aosIterations{};
+		auto const aosTime = measure_best(option.repeat, [&] {
+			reference = std::make_unique<AosDeformableReference>(mesh, option.tolerance, option.maxIterations);
+			aosIterations = 0;
+		}, [&] {
+			for (std::size_t i = 0; i < option.stepNum; i++)
+			{
+				reference->step(dt);
+				aosIterations += reference->getLastIterations();
+			}
+		});
+
+		json.beginObject();
+		json.value("kind", mesh.kind);
+		json.value("size", mesh.size);
+		json.value("nodes", mesh.positions.size());
+		json.value("springs", mesh.springs.size());
+		json.value("tetras", mesh.tetras.size());
+
+		std::array<std::vector<btScalar>, 3> firstPositions{};
+		auto deterministic = true;
+		auto converged = true;
+		btScalar maxDifference{};
+		btScalar maxResidual{};
+		int soaIterations{};
+		std::size_t reallocationNum{};
+		double singleThreadTime{};
+
+		// XbhƂCGAŌɍő̃XbhCR
+		auto const run = [&](DeformableKrylovMethod method, int threads) {
+			scheduler->setNumThreads(threads);
+			auto methodConfig = config;
+			methodConfig.method = method;
+			std::unique_ptr<SoaDeformableBody> body{};
+			std::unique_ptr<DeformableKrylovSolver> solver{};
+			int iterations{};
+			auto const time = measure_best(option.repeat, [&] {
+				body = std::make_unique<SoaDeformableBody>(mesh.material);
+				build_deformable_benchmark_body(mesh, *body);
+				solver = std::make_unique<DeformableKrylovSolver>(methodConfig);
+				iterations = 0;
+			}, [&] {
+				for (std::size_t i = 0; i < option.stepNum; i++)
+				{
+					solver->step(*body, dt);
+					iterations += solver->getStats().iterations;
+					converged = converged && solver->getStats().converged;
+					maxResidual = std::max(maxResidual, solver->getStats().residual);
+				}
+			});
+			return std::make_tuple(time, iterations, std::move(body), solver->getReallocationNum());
+		};
+
+		json.beginObject("ms_per_step");
+		json.value("btcg_serial", perStep(aosTime));
+		for (auto const threads : threadCounts)
+		{
+			auto const [time, iterations, body, reallocations] = run(DeformableKrylovMethod::ConjugateGradient, threads);
+			json.value("cg_threads_" + std::to_string(threads), perStep(time));
+			if (threads == 1)
+			{
+				singleThreadTime = time;
+				soaIterations = iterations;
+				reallocationNum = reallocations;
+			}
+
+			if (firstPositions[0].empty())
+			{
+				for (int axis = 0; axis < 3; axis++)
+					firstPositions[axis].assign(body->getPositions(axis).begin(), body->getPositions(axis).end());
+				for (int i = 0; i < body->getNodeNum(); i++)
+					maxDifference = std::max(maxDifference, body->getPosition(i).distance(reference->getPosition(i)));
+			}
+			else
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					auto const positions = body->getPositions(axis);
+					deterministic = deterministic && std::memcmp(positions.data(), firstPositions[axis].data(), positions.size() * sizeof(btScalar)) == 0;
+				}
+			}
+		}
+		auto const [crTime, crIterations, crBody, crReallocations] = run(DeformableKrylovMethod::ConjugateResidual, threadNum);
+		json.value("cr_threads_" + std::to_string(threadNum), perStep(crTime));
+		json.endObject();
+
+		json.beginObject("iterations_per_solve");
+		json.value("btcg", aosIterations / stepNum);
+		json.value("cg", soaIterations / stepNum);
+		json.value("cr", crIterations / stepNum);
+		json.endObject();
+		json.beginObject("iterations_per_second");
+		json.value("btcg", aosIterations / aosTime);
+		json.value("cg_threads_1", soaIterations / singleThreadTime);
+		json.value("cr_threads_" + std::to_string(threadNum), crIterations / crTime);
+		json.endObject();
+
+		btScalar crDifference{};
+		for (int i = 0; i < crBody->getNodeNum(); i++)
+			crDifference = std::max(crDifference, crBody->getPosition(i).distance(reference->getPosition(i)));
+
+		json.value("speedup_cg_serial", aosTime / singleThreadTime);
+		json.value("reallocations", reallocationNum);
+		json.value("max_residual", maxResidual);
+		json.value("converged", converged);
+		json.value("max_difference_cg_from_btcg", maxDifference);
+		json.value("max_difference_cr_from_btcg", crDifference);
+		json.value("deterministic", deterministic);
+		json.endObject();
+
+		// ~߂ƑႤȂ̂ŁAc͈̔͂œʒuɂȂ
+		auto const limit = btScalar(1e-3);
+		correct = correct && deterministic && converged && reallocationNum == 1 &&
+			maxDifference <= limit && crDifference <= limit;
+	}
+	json.endArray();
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
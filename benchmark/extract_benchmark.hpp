@@ -0,0 +1,338 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/RenderExtractor.hpp"
+#include"../src/Scene.hpp"
+#include<array>
+#include<cstdlib>
+#include<iostream>
+#include<string_view>
+#include<vector>
+
+// `f[^̎oAȑObtIDebugDrawoR@Ɣׂ
+// SȂꍇƁAς̂ꍇƁAQĂ鍄̂𒲂ׂȂꍇv
+
+struct ExtractBenchmarkOption
+{
+	int repeat = 20;
+	std::size_t chainNum = 1000;
+	// v̑Oɐi߂Xebv
+	std::size_t warmupStepNum = 60;
+
+	bool multithread = false;
+	int threadNum = 0;
+	int grainSize = 64;
+};
+
+// ȑODebugDrawƓ1z֐Ŏ󂯎vectorɐς
+// XMMATRIX̑write_render_transformœs
+struct CollectingDebugDraw : public btIDebugDraw
+{
+	std::array<std::vector<std::array<float, 16>>, RENDER_SHAPE_TYPE_NUM> transforms{};
+	std::array<std::vector<std::array<float, 3>>, RENDER_SHAPE_TYPE_NUM> colors{};
+
+	int debugMode = DBG_DrawWireframe | DBG_DrawConstraints;
+
+	void clear()
+	{
+		for (auto& t : transforms)
+			t.clear();
+		for (auto& c : colors)
+			c.clear();
+	}
+
+	void push(RenderShapeType type, std::array<float, 9> const& local, btTransform const& transform, btVector3 const& color)
+	{
+		auto const i = static_cast<std::size_t>(type);
+		write_render_transform(local, transform, transforms[i].emplace_back());
+		colors[i].push_back({ static_cast<float>(color.x()), static_cast<float>(color.y()), static_cast<float>(color.z()) });
+	}
+
+	void drawSphere(btScalar radius, btTransform const& transform, btVector3 const& color) override
+	{
+		btSphereShape const shape{ radius };
+		RenderShapeType type{};
+		std::array<float, 9> local{};
+		compute_render_local_matrix(&shape, type, local);
+		push(type, local, transform, color);
+	}
+
+	void drawBox(btVector3 const& bbMin, btVector3 const& bbMax, btTransform const& transform, btVector3 const& color) override
+	{
+		auto const size = bbMax - bbMin;
+		push(RenderShapeType::Box, {
+			static_cast<float>(size.x()), 0.f, 0.f,
+			0.f, static_cast<float>(size.y()), 0.f,
+			0.f, 0.f, static_cast<float>(size.z()),
+		}, transform, color);
+	}
+
+	void drawCapsule(btScalar radius, btScalar halfHeight, int, btTransform const& transform, btVector3 const& color) override
+	{
+		// upAxis͍̃JvZƓy
+		auto const height = (1.f + static_cast<float>(halfHeight)) / 2.f;
+		push(RenderShapeType::Capsule, {
+			static_cast<float>(radius), 0.f, 0.f,
+			0.f, height, 0.f,
+			0.f, 0.f, static_cast<float>(radius),
+		}, transform, color);
+	}
+
+	void drawLine(btVector3 const&, btVector3 const&, btVector3 const&) override {}
+	void drawContactPoint(btVector3 const&, btVector3 const&, btScalar, int, btVector3 const&) override {}
+	void reportErrorWarning(char const*) override {}
+	void draw3dText(btVector3 const&, char const*) override {}
+
+	void setDebugMode(int mode) override
+	{
+		debugMode = mode;
+	}
+
+	int getDebugMode() const override
+	{
+		return debugMode;
+	}
+};
+
+// ȑODebugDraw::drawWorldAInterpolatedMotionState͕̍̂ԂdebugDrawObjectɓn
+inline void draw_world_interpolated(btCollisionWorld* world)
+{
+	for (int i = 0; i < world->getNumCollisionObjects(); i++)
+	{
+		btCollisionObject* obj = world->getCollisionObjectArray()[i];
+		if (obj->getCollisionFlags() & btCollisionObject::CF_DISABLE_VISUALIZE_OBJECT)
+			continue;
+
+		btTransform transform = obj->getWorldTransform();
+		if (auto body = btRigidBody::upcast(obj); body && !body->isStaticOrKinematicObject())
+		{
+			if (auto motionState = dynamic_cast<InterpolatedMotionState*>(body->getMotionState()))
+				transform = motionState->getRenderTransform();
+		}
+
+		world->debugDrawObject(transform, obj->getCollisionShape(), get_render_color(obj));
+	}
+}
+
+inline void print_extract_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark extract [options]\n"
+		"  --repeat <n>      measure n times and report the fastest (default 20)\n"
+		"  --chains <n>      number of chains in the scene (default 1000)\n"
+		"  --warmup <n>      steps before measuring (default 60)\n"
+		"  --mt              use the multithreaded world and extract in parallel\n"
+		"  --threads <n>     number of threads for --mt (default all cores)\n"
+		"  --grain <n>       bodies per extraction task (default 64)\n";
+}
+
+// sfalse
+inline bool parse_extract_benchmark_option(int argc, char** argv, ExtractBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		// lȂIvV
+		if (name == "--mt") {
+			option.multithread = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--chains")
+			option.chainNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--warmup")
+			option.warmupStepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else if (name == "--grain")
+			option.grainSize = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.chainNum < 1 || option.threadNum < 0 || option.grainSize < 1) {
+		std::cerr << "invalid --repeat, --chains, --threads or --grain\n";
+		return false;
+	}
+
+	return true;
+}
+
+inline int run_extract_benchmark(int argc, char** argv)
+{
+	ExtractBenchmarkOption option{};
+	if (!parse_extract_benchmark_option(argc, argv, option)) {
+		print_extract_benchmark_usage();
+		return 1;
+	}
+
+	FixedStepper stepper{ { .maxSubStepsPerFrame = 1 } };
+	Scene scene{ {
+		.chainNum = option.chainNum,
+		.stepper = &stepper,
+		.multithread = option.multithread,
+		.threadNum = option.threadNum,
+	} };
+	auto const world = scene.getDynamicsWorld();
+	auto const fixedTimeStep = stepper.getConfig().fixedTimeStep;
+
+	for (std::size_t i = 0; i < option.warmupStepNum; i++)
+		stepper.update(world, fixedTimeStep);
+
+	CollectingDebugDraw debugDraw{};
+	world->setDebugDrawer(&debugDraw);
+
+	RenderExtractor extractor{};
+	extractor.setGrainSize(option.grainSize);
+	extractor.rebuild(world);
+
+	std::array<std::vector<std::array<float, 16>>, RENDER_SHAPE_TYPE_NUM> transforms{};
+	std::array<std::vector<std::array<float, 3>>, RENDER_SHAPE_TYPE_NUM> colors{};
+	std::size_t instanceNum = 0;
+	for (auto type : { RenderShapeType::Box, RenderShapeType::Sphere, RenderShapeType::Capsule })
+	{
+		auto const i = static_cast<std::size_t>(type);
+		transforms[i].resize(extractor.getInstanceNum(type));
+		colors[i].resize(extractor.getInstanceNum(type));
+		extractor.setOutput(type, { transforms[i].data(), colors[i].data(), transforms[i].size() });
+		instanceNum += transforms[i].size();
+	}
+
+	Checksum checksum{};
+
+	auto const debugDrawTime = measure_best(option.repeat, [&] {
+		debugDraw.clear();
+		draw_world_interpolated(world);
+	});
+	checksum.add(debugDraw.transforms[static_cast<std::size_t>(RenderShapeType::Capsule)].size());
+
+	std::size_t fullWrittenNum{};
+	auto const fullTime = measure_best(option.repeat, [&] { extractor.invalidate(); }, [&] {
+		fullWrittenNum = extractor.extract();
+	});
+
+	// p̂܂2ڂĂԂƉȂ
+	std::size_t unchangedWrittenNum{};
+	auto const unchangedTime = measure_best(option.repeat, [&] {
+		unchangedWrittenNum = extractor.extract();
+	});
+
+	// 1Xebvi߂ĕԂ̓rɂ
+	// Xebv͌vɊ܂߂Ȃ
+	std::size_t steppedWrittenNum{};
+	auto const steppedTime = measure_best(option.repeat, [&] { stepper.update(world, fixedTimeStep * btScalar(1.5)); }, [&] {
+		steppedWrittenNum = extractor.extract();
+	});
+
+	// ȑO̕@Ɠ̂Ă邩
+	auto const isSameAsDebugDraw = [&] {
+		debugDraw.clear();
+		draw_world_interpolated(world);
+		bool same = true;
+		for (std::size_t i = 0; i < RENDER_SHAPE_TYPE_NUM; i++)
+			same = same && debugDraw.colors[i] == colors[i] && debugDraw.transforms[i] == transforms[i];
+		return same;
+	};
+	extractor.invalidate();
+	extractor.extract();
+	bool sameAsDebugDraw = isSameAsDebugDraw();
+
+	// ׂĂ̍QAQ͈̂x璲ׂȂ
+	for (int i = 0; i < world->getNumCollisionObjects(); i++)
+	{
+		auto const obj = world->getCollisionObjectArray()[i];
+		if (!obj->isStaticObject())
+			obj->forceActivationState(ISLAND_SLEEPING);
+	}
+	stepper.update(world, fixedTimeStep);
+	extractor.extract();
+	sameAsDebugDraw = sameAsDebugDraw && isSameAsDebugDraw();
+
+	std::size_t sleepingWrittenNum{};
+	auto const sleepingTime = measure_best(option.repeat, [&] { stepper.update(world, fixedTimeStep * btScalar(1.5)); }, [&] {
+		sleepingWrittenNum = extractor.extract();
+	});
+	auto const sleepingActiveNum = extractor.getActiveNum();
+	auto const sleepingDebugDrawTime = measure_best(option.repeat, [&] {
+		debugDraw.clear();
+		draw_world_interpolated(world);
+	});
+
+	// NăXebvi߂ƁAinvalidateȂĂȂ
+	for (int i = 0; i < world->getNumCollisionObjects(); i++)
+	{
+		auto const obj = world->getCollisionObjectArray()[i];
+		if (!obj->isStaticObject())
+			obj->activate(true);
+	}
+	stepper.update(world, fixedTimeStep * btScalar(1.5));
+	auto const wokenWrittenNum = extractor.extract();
+	sameAsDebugDraw = sameAsDebugDraw && isSameAsDebugDraw();
+	for (auto const& t : transforms)
+	{
+		for (auto const& m : t)
+			checksum.add(m[13]);
+	}
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "extract");
+	json.value("repeat", option.repeat);
+	json.value("chains", option.chainNum);
+	json.value("threads", scene.getThreadNum());
+	json.value("grain", option.grainSize);
+	json.value("rigid_bodies", world->getNumCollisionObjects());
+	json.value("constraints", world->getNumConstraints());
+	json.value("instances", instanceNum);
+
+	json.beginObject("debug_draw");
+	json.value("ms", debugDrawTime * 1e3);
+	json.endObject();
+
+	json.beginObject("extract_full");
+	json.value("ms", fullTime * 1e3);
+	json.value("written", fullWrittenNum);
+	json.value("speedup", debugDrawTime / fullTime);
+	json.endObject();
+
+	json.beginObject("extract_unchanged");
+	json.value("ms", unchangedTime * 1e3);
+	json.value("written", unchangedWrittenNum);
+	json.endObject();
+
+	json.beginObject("extract_after_step");
+	json.value("ms", steppedTime * 1e3);
+	json.value("written", steppedWrittenNum);
+	json.endObject();
+
+	// ׂĐQĂ郏[hŃXebvi߂
+	json.beginObject("extract_sleeping");
+	json.value("ms", sleepingTime * 1e3);
+	json.value("written", sleepingWrittenNum);
+	json.value("active", sleepingActiveNum);
+	json.value("debug_draw_ms", sleepingDebugDrawTime * 1e3);
+	json.value("speedup", sleepingDebugDrawTime / sleepingTime);
+	json.endObject();
+
+	json.value("written_after_wake", wokenWrittenNum);
+
+	json.value("same_as_debug_draw", sameAsDebugDraw);
+	json.value("checksum", checksum.value);
+	json.endObject();
+
+	return sameAsDebugDraw ? 0 : 1;
+}
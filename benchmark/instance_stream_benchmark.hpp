@@ -0,0 +1,160 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/InstanceStream.hpp"
+#include<array>
+#include<cstdlib>
+#include<cstring>
+#include<iostream>
+#include<string_view>
+#include<vector>
+
+// NullInstanceStreamBackendInstanceStream̋lߍ݂ƃOobt@v
+// GPUĂ̂ŁAgƃobt@̐؂ւm߂
+
+struct InstanceStreamBenchmarkOption
+{
+	int repeat = 20;
+	std::size_t instanceNum = 100000;
+	std::size_t frameNum = 3;
+	std::size_t initialCapacity = 256;
+};
+
+inline void print_instance_stream_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark instances [options]\n"
+		"  --repeat <n>      measure n times and report the fastest (default 20)\n"
+		"  --instances <n>   instances written per frame (default 100000)\n"
+		"  --frames <n>      number of buffers in the ring (default 3)\n"
+		"  --initial <n>     initial capacity of each buffer (default 256)\n";
+}
+
+// sfalse
+inline bool parse_instance_stream_benchmark_option(int argc, char** argv, InstanceStreamBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--instances")
+			option.instanceNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--frames")
+			option.frameNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--initial")
+			option.initialCapacity = std::strtoull(value, nullptr, 10);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.frameNum < 1 || option.initialCapacity < 1) {
+		std::cerr << "invalid --repeat, --frames or --initial\n";
+		return false;
+	}
+
+	return true;
+}
+
+inline int run_instance_stream_benchmark(int argc, char** argv)
+{
+	InstanceStreamBenchmarkOption option{};
+	if (!parse_instance_stream_benchmark_option(argc, argv, option)) {
+		print_instance_stream_benchmark_usage();
+		return 1;
+	}
+
+	std::vector<std::array<float, 16>> transforms(option.instanceNum);
+	std::vector<std::array<float, 3>> colors(option.instanceNum);
+	for (std::size_t i = 0; i < option.instanceNum; i++)
+	{
+		for (std::size_t j = 0; j < 16; j++)
+			transforms[i][j] = static_cast<float>(i * 16 + j);
+		colors[i] = { static_cast<float>(i), 0.5f, 1.f };
+	}
+
+	auto backendPtr = std::make_unique<NullInstanceStreamBackend>();
+	auto const& backend = *backendPtr;
+	InstanceStream stream{ std::move(backendPtr), option.frameNum, option.initialCapacity };
+
+	// ŏ1Ŋeobt@傫Ȃ
+	auto const growTime = measure_best(1, [&] {
+		for (std::size_t i = 0; i < option.frameNum; i++)
+			stream.write(transforms, colors);
+	});
+	auto const grownResizeNum = stream.getCounter().resizeNum;
+
+	auto const writeTime = measure_best(option.repeat, [&] {
+		stream.write(transforms, colors);
+	});
+
+	// ׂ邽߂ɓoCgmemcpy
+	std::vector<InstanceData> source(option.instanceNum);
+	std::vector<InstanceData> destination(option.instanceNum);
+	auto const memcpyTime = measure_best(option.repeat, [&] {
+		std::memcpy(destination.data(), source.data(), sizeof(InstanceData) * source.size());
+	});
+
+	// O2āA񎟂̃obt@ɐĂ邩
+	bool correct = stream.getCounter().resizeNum == grownResizeNum;
+	for (std::size_t f = 0; f < option.frameNum * 2; f++)
+	{
+		auto const previousIndex = stream.getFrameIndex();
+		stream.write(transforms, colors);
+
+		auto const index = stream.getFrameIndex();
+		auto const data = backend.getData(index);
+		correct = correct && index == (previousIndex + 1) % option.frameNum && data == stream.getData();
+		correct = correct && backend.getCapacity(index) >= option.instanceNum && stream.getInstanceNum() == option.instanceNum;
+		for (std::size_t i = 0; correct && i < option.instanceNum; i++)
+			correct = data[i].transform == transforms[i] && data[i].color == colors[i];
+	}
+
+	// Ȃt[ł͍蒼Ȃ
+	stream.write(std::span{ transforms }.first(option.instanceNum / 2), std::span{ colors }.first(option.instanceNum / 2));
+	correct = correct && stream.getInstanceNum() == option.instanceNum / 2 && stream.getCounter().resizeNum == grownResizeNum;
+
+	auto const bytes = static_cast<double>(sizeof(InstanceData) * option.instanceNum);
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "instances");
+	json.value("repeat", option.repeat);
+	json.value("instances", option.instanceNum);
+	json.value("frames", option.frameNum);
+	json.value("initial_capacity", option.initialCapacity);
+	json.value("instance_bytes", sizeof(InstanceData));
+
+	json.beginObject("first_round");
+	json.value("ms", growTime * 1e3);
+	json.value("resizes", grownResizeNum);
+	json.endObject();
+
+	json.beginObject("write");
+	json.value("ms", writeTime * 1e3);
+	json.value("ns_per_instance", writeTime * 1e9 / static_cast<double>(std::max<std::size_t>(option.instanceNum, 1)));
+	json.value("gb_per_sec", bytes / writeTime * 1e-9);
+	json.endObject();
+
+	json.beginObject("memcpy");
+	json.value("ms", memcpyTime * 1e3);
+	json.value("gb_per_sec", bytes / memcpyTime * 1e-9);
+	json.endObject();
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
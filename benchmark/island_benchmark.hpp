@@ -0,0 +1,473 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/IncrementalIslandManager.hpp"
+#include"../src/Scene.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cstdlib>
+#include<iostream>
+#include<limits>
+#include<memory>
+#include<numeric>
+#include<string_view>
+#include<type_traits>
+#include<unordered_map>
+#include<vector>
+
+// QĂ锠ׁ̒AꕔNĂ郏[hŃACȟvZׂ
+// Bullet͖XebvS̃IuWFNgƃyAunion-find蒼AIncrementalIslandManager͋NĂACh
+// ACh̎ԂcalculateSimulationIslandsƁAsolveConstraintssolveGroup
+
+struct IslandBenchmarkOption
+{
+	int repeat = 3;
+	std::size_t stepNum = 240;
+	// cɕׂ鐔ƍ
+	std::size_t stackNum = 64;
+	std::size_t stackHeight = 8;
+	// ̐̒Ƃ1AQȂɂ
+	std::size_t awakeInterval = 16;
+	// ̃XebvƂɐQĂ钌1NA0ȂNȂ
+	std::size_t wakeInterval = 10;
+	int threadNum = 0;
+};
+
+inline void print_island_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark islands [options]\n"
+		"  --repeat <n>   simulate n times and report the fastest (default 3)\n"
+		"  --steps <n>    steps per simulation (default 240)\n"
+		"  --stacks <n>   stacks per side (default 64)\n"
+		"  --height <n>   boxes per stack (default 8)\n"
+		"  --awake <n>    one stack in n never sleeps (default 16)\n"
+		"  --wake <n>     wake a sleeping stack every n steps, 0 to disable (default 10)\n"
+		"  --threads <n>  threads for the multithreaded world (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_island_benchmark_option(int argc, char** argv, IslandBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--stacks")
+			option.stackNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--height")
+			option.stackHeight = std::strtoull(value, nullptr, 10);
+		else if (name == "--awake")
+			option.awakeInterval = std::strtoull(value, nullptr, 10);
+		else if (name == "--wake")
+			option.wakeInterval = std::strtoull(value, nullptr, 10);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.stepNum < 1 || option.stackNum < 1 || option.stackHeight < 1 || option.awakeInterval < 1 || option.threadNum < 0) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// solveGroupɂԂ𐔂
+template<class Solver>
+class SolveGroupTimedSolver : public Solver
+{
+public:
+	double solveTime{};
+
+	btScalar solveGroup(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifold, int numManifolds,
+		btTypedConstraint** constraints, int numConstraints, btContactSolverInfo const& info, btIDebugDraw* debugDrawer, btDispatcher* dispatcher) override
+	{
+		auto const start = std::chrono::steady_clock::now();
+		auto const result = Solver::solveGroup(bodies, numBodies, manifold, numManifolds, constraints, numConstraints, info, debugDrawer, dispatcher);
+		solveTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return result;
+	}
+};
+
+// ACȟvZsolveConstraintsɂԂ𐔂
+template<class World>
+class IslandTimedWorld : public World
+{
+public:
+	double islandTime{};
+	double solveTime{};
+
+	using World::World;
+
+	void solveConstraints(btContactSolverInfo& solverInfo) override
+	{
+		auto const start = std::chrono::steady_clock::now();
+		World::solveConstraints(solverInfo);
+		solveTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+protected:
+	void calculateSimulationIslands() override
+	{
+		auto const start = std::chrono::steady_clock::now();
+		World::calculateSimulationIslands();
+		islandTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+};
+
+enum class IslandWorldType
+{
+	Serial,
+	Multithread,
+};
+
+struct IslandResult
+{
+	// 1Xebv
+	double islandTime{};
+	double stepTime{};
+	double awakeBodyNum{};
+	std::vector<btVector3> positions{};
+	bool correct = true;
+};
+
+// dȂĂyAƍSō蒼AChƁA[h̃AChm߂
+// NĂ{fB̂ACh͑SNĂāAACh^OŁÃAChƃ^OdȂȂ
+bool check_islands(btDiscreteDynamicsWorld* world);
+
+// {fBɍS𑫂[hŁA{fBOđĂS邩m߂
+template<bool Incremental>
+bool check_constraint_readd();
+
+template<bool Incremental>
+IslandResult run_islands(IslandWorldType type, IslandBenchmarkOption const& option);
+
+//
+// ȉA
+//
+
+inline bool check_islands(btDiscreteDynamicsWorld* world)
+{
+	auto const& objects = world->getCollisionObjectArray();
+	std::vector<int> parents(static_cast<std::size_t>(objects.size()));
+	std::iota(parents.begin(), parents.end(), 0);
+	auto const find = [&](int i) {
+		while (parents[i] != i)
+			i = parents[i] = parents[parents[i]];
+		return i;
+	};
+	auto const unite = [&](btCollisionObject const* object0, btCollisionObject const* object1) {
+		if (object0->isStaticOrKinematicObject() || object1->isStaticOrKinematicObject())
+			return;
+		parents[find(object0->getWorldArrayIndex())] = find(object1->getWorldArrayIndex());
+	};
+
+	auto const pairCache = world->getPairCache();
+	for (int i = 0; i < pairCache->getNumOverlappingPairs(); i++)
+	{
+		auto const& pair = pairCache->getOverlappingPairArrayPtr()[i];
+		auto const object0 = static_cast<btCollisionObject const*>(pair.m_pProxy0->m_clientObject);
+		auto const object1 = static_cast<btCollisionObject const*>(pair.m_pProxy1->m_clientObject);
+		if (object0->mergesSimulationIslands() && object1->mergesSimulationIslands())
+			unite(object0, object1);
+	}
+	for (int i = 0; i < world->getNumConstraints(); i++)
+	{
+		auto const constraint = world->getConstraint(i);
+		if (constraint->isEnabled())
+			unite(&constraint->getRigidBodyA(), &constraint->getRigidBodyB());
+	}
+
+	// NĂ{fB̂鍪Ƃ̃^O
+	std::unordered_map<int, int> tags{};
+	for (int i = 0; i < objects.size(); i++)
+		if (!objects[i]->isStaticOrKinematicObject() && objects[i]->isActive())
+			tags.emplace(find(i), objects[i]->getIslandTag());
+
+	std::unordered_map<int, int> roots{};
+	for (auto const& [root, tag] : tags)
+		if (!roots.emplace(tag, root).second)
+			return false;
+
+	for (int i = 0; i < objects.size(); i++)
+	{
+		if (objects[i]->isStaticOrKinematicObject())
+			continue;
+		auto const tag = tags.find(find(i));
+		if (tag == tags.end())
+			continue;
+		if (objects[i]->getActivationState() == ISLAND_SLEEPING || objects[i]->getIslandTag() != tag->second)
+			return false;
+	}
+	return true;
+}
+
+template<bool Incremental>
+inline bool check_constraint_readd()
+{
+	btDefaultCollisionConfiguration collisionConfiguration{};
+	btCollisionDispatcher dispatcher{ &collisionConfiguration };
+	btDbvtBroadphase broadphase{};
+	btSequentialImpulseConstraintSolver solver{};
+	using World = std::conditional_t<Incremental, IncrementalIslandWorld<btDiscreteDynamicsWorld>, btDiscreteDynamicsWorld>;
+	World world{ &dispatcher, &broadphase, &solver, &collisionConfiguration };
+	world.setGravity(btVector3(0, -10, 0));
+
+	btBoxShape boxShape{ btVector3(0.25, 0.25, 0.25) };
+	btVector3 inertia(0, 0, 0);
+	boxShape.calculateLocalInertia(1., inertia);
+	auto const makeBody = [&](btVector3 const& position) {
+		btRigidBody::btRigidBodyConstructionInfo info{ 1., nullptr, &boxShape, inertia };
+		info.m_startWorldTransform.setOrigin(position);
+		auto body = std::make_unique<btRigidBody>(info);
+		body->setActivationState(DISABLE_DEACTIVATION);
+		return body;
+	};
+
+	// (0, 10, 0)2̔ɐL΂Ē݂邵AUq̂悤ɐU点
+	auto const upper = makeBody(btVector3(1, 10, 0));
+	auto const lower = makeBody(btVector3(2, 10, 0));
+	btPoint2PointConstraint hinge{ *upper, btVector3(-1, 0, 0) };
+	btPoint2PointConstraint link{ *upper, *lower, btVector3(0.5, 0, 0), btVector3(-0.5, 0, 0) };
+
+	// S̓_ĂȂΉĂAΑ傫
+	auto const solved = [](btPoint2PointConstraint const& constraint) {
+		auto const pivotA = constraint.getRigidBodyA().getCenterOfMassTransform() * constraint.getPivotInA();
+		auto const pivotB = constraint.getRigidBodyB().getCenterOfMassTransform() * constraint.getPivotInB();
+		return (pivotA - pivotB).length() < btScalar(0.05);
+	};
+
+	auto correct = true;
+	auto const step = [&](int stepNum) {
+		for (int i = 0; i < stepNum; i++)
+		{
+			world.stepSimulation(btScalar(1. / 60.), 0);
+			correct = correct && check_islands(&world);
+		}
+		correct = correct && solved(hinge) && solved(link);
+	};
+
+	world.addConstraint(&hinge);
+	world.addConstraint(&link);
+	world.addRigidBody(upper.get());
+	world.addRigidBody(lower.get());
+	step(30);
+
+	// ̔OƗ̍S̕ӂȂȂ
+	world.removeRigidBody(upper.get());
+	world.addRigidBody(upper.get());
+	step(60);
+
+	world.removeConstraint(&link);
+	world.removeConstraint(&hinge);
+	world.removeRigidBody(lower.get());
+	world.removeRigidBody(upper.get());
+	return correct;
+}
+
+template<bool Incremental>
+inline IslandResult run_islands(IslandWorldType type, IslandBenchmarkOption const& option)
+{
+	IslandResult result{};
+	result.islandTime = std::numeric_limits<double>::max();
+	result.stepTime = std::numeric_limits<double>::max();
+
+	for (int r = 0; r < option.repeat; r++)
+	{
+		btDefaultCollisionConfiguration collisionConfiguration{};
+		btCollisionDispatcher dispatcher{ &collisionConfiguration };
+		btDbvtBroadphase broadphase{};
+
+		// solveConstraintssolveGroup̍𑪂̂ŁAACh͏ɉ
+		std::unique_ptr<btConstraintSolverPoolMt> solverPool{};
+		std::unique_ptr<btConstraintSolver> solver{};
+		std::unique_ptr<btDiscreteDynamicsWorld> world{};
+		double const* islandTime{};
+		double const* solveTime{};
+		double const* solveGroupTime{};
+
+		auto const setup = [&](auto* timedWorld, auto* timedSolver) {
+			islandTime = &timedWorld->islandTime;
+			solveTime = &timedWorld->solveTime;
+			solveGroupTime = &timedSolver->solveTime;
+			world.reset(timedWorld);
+		};
+
+		if (type == IslandWorldType::Serial)
+		{
+			using World = std::conditional_t<Incremental, IncrementalIslandWorld<btDiscreteDynamicsWorld>, btDiscreteDynamicsWorld>;
+			auto const timedSolver = new SolveGroupTimedSolver<btSequentialImpulseConstraintSolver>();
+			solver.reset(timedSolver);
+			setup(new IslandTimedWorld<World>(&dispatcher, &broadphase, timedSolver, &collisionConfiguration), timedSolver);
+		}
+		else
+		{
+			btConstraintSolver* solvers[BT_MAX_THREAD_COUNT];
+			for (unsigned i = 0; i < BT_MAX_THREAD_COUNT; i++)
+				solvers[i] = new btSequentialImpulseConstraintSolver();
+			solverPool = std::make_unique<btConstraintSolverPoolMt>(solvers, BT_MAX_THREAD_COUNT);
+
+			// serialIslandDispatchsolverMtŉ
+			using World = std::conditional_t<Incremental, IncrementalIslandWorld<btDiscreteDynamicsWorldMt>, btDiscreteDynamicsWorldMt>;
+			auto const timedSolver = new SolveGroupTimedSolver<btSequentialImpulseConstraintSolverMt>();
+			solver.reset(timedSolver);
+			setup(new IslandTimedWorld<World>(&dispatcher, &broadphase, solverPool.get(), timedSolver, &collisionConfiguration), timedSolver);
+			static_cast<btSimulationIslandManagerMt*>(world->getSimulationIslandManager())->setIslandDispatchFunction(btSimulationIslandManagerMt::serialIslandDispatch);
+		}
+
+		world->setGravity(btVector3(0, -10, 0));
+		world->setForceUpdateAllAabbs(false);
+
+		btBoxShape groundShape{ btVector3(btScalar(option.stackNum) + 10, 1, btScalar(option.stackNum) + 10) };
+		btBoxShape boxShape{ btVector3(0.5, 0.5, 0.5) };
+		std::vector<std::unique_ptr<btRigidBody>> bodies{};
+		std::vector<std::vector<btRigidBody*>> sleepingStacks{};
+
+		auto const addBody = [&](btCollisionShape* shape, btScalar mass, btVector3 const& position, int activationState) {
+			btVector3 inertia(0, 0, 0);
+			if (mass != btScalar(0.))
+				shape->calculateLocalInertia(mass, inertia);
+			btRigidBody::btRigidBodyConstructionInfo info{ mass, nullptr, shape, inertia };
+			info.m_startWorldTransform.setOrigin(position);
+			info.m_friction = 0.6;
+			auto& body = bodies.emplace_back(std::make_unique<btRigidBody>(info));
+			// Q܂ܑ
+			body->forceActivationState(activationState);
+			world->addRigidBody(body.get());
+			return body.get();
+		};
+
+		addBody(&groundShape, 0., btVector3(0, -1, 0), ACTIVE_TAG);
+
+		auto const offset = (static_cast<btScalar>(option.stackNum) - 1) * btScalar(0.75);
+		for (std::size_t s = 0; s < option.stackNum * option.stackNum; s++)
+		{
+			auto const awake = s % option.awakeInterval == 0;
+			if (!awake)
+				sleepingStacks.emplace_back();
+			for (std::size_t y = 0; y < option.stackHeight; y++)
+			{
+				auto const position = btVector3(static_cast<btScalar>(s % option.stackNum) * btScalar(1.5) - offset, btScalar(0.5) + static_cast<btScalar>(y),
+					static_cast<btScalar>(s / option.stackNum) * btScalar(1.5) - offset);
+				auto const body = addBody(&boxShape, 1., position, awake ? DISABLE_DEACTIVATION : ISLAND_SLEEPING);
+				if (!awake)
+					sleepingStacks.back().push_back(body);
+			}
+		}
+
+		double stepTime{};
+		std::size_t awakeBodyNum{};
+		for (std::size_t i = 0; i < option.stepNum; i++)
+		{
+			// ԉ̔N΁AȂĂ钌ŜN
+			if (option.wakeInterval > 0 && i % option.wakeInterval == 0 && !sleepingStacks.empty())
+				sleepingStacks[(i / option.wakeInterval * 7) % sleepingStacks.size()].front()->activate(true);
+
+			auto const start = std::chrono::steady_clock::now();
+			world->stepSimulation(btScalar(1. / 60.), 0);
+			stepTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			for (auto const& body : bodies)
+				awakeBodyNum += body->isActive() && !body->isStaticObject() ? 1 : 0;
+			result.correct = result.correct && check_islands(world.get());
+		}
+
+		auto const islandStepTime = (*islandTime + *solveTime - *solveGroupTime) / static_cast<double>(option.stepNum);
+		result.islandTime = std::min(result.islandTime, islandStepTime);
+		result.stepTime = std::min(result.stepTime, stepTime / static_cast<double>(option.stepNum));
+		result.awakeBodyNum = static_cast<double>(awakeBodyNum) / static_cast<double>(option.stepNum);
+
+		result.positions.clear();
+		for (auto const& body : bodies)
+			result.positions.push_back(body->getWorldTransform().getOrigin());
+
+		for (auto const& body : bodies)
+			world->removeRigidBody(body.get());
+	}
+
+	return result;
+}
+
+inline int run_island_benchmark(int argc, char** argv)
+{
+	IslandBenchmarkOption option{};
+	if (!parse_island_benchmark_option(argc, argv, option)) {
+		print_island_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the island benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+	scheduler->setNumThreads(threadNum);
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "islands");
+	json.value("repeat", option.repeat);
+	json.value("steps", option.stepNum);
+	json.value("bodies", option.stackNum * option.stackNum * option.stackHeight);
+	json.value("threads", threadNum);
+
+	auto correct = true;
+	for (auto const type : { IslandWorldType::Serial, IslandWorldType::Multithread })
+	{
+		auto const bullet = run_islands<false>(type, option);
+		auto const incremental = run_islands<true>(type, option);
+
+		// }jtH[hႤ̂ŋNĂ钌͏AڐGΔő傫
+		btScalar maxPositionError = 0.;
+		for (std::size_t i = 0; i < bullet.positions.size(); i++)
+			maxPositionError = std::max(maxPositionError, (bullet.positions[i] - incremental.positions[i]).length());
+		auto const typeCorrect = bullet.correct && incremental.correct && maxPositionError < btScalar(0.1);
+		correct = correct && typeCorrect;
+
+		json.beginObject(type == IslandWorldType::Serial ? "serial" : "multithread");
+		json.beginObject("awake_bodies_per_step");
+		json.value("bullet", bullet.awakeBodyNum);
+		json.value("incremental", incremental.awakeBodyNum);
+		json.endObject();
+		json.beginObject("island_ms_per_step");
+		json.value("bullet", bullet.islandTime);
+		json.value("incremental", incremental.islandTime);
+		json.endObject();
+		json.beginObject("step_ms");
+		json.value("bullet", bullet.stepTime);
+		json.value("incremental", incremental.stepTime);
+		json.endObject();
+		json.value("max_position_error", maxPositionError);
+		json.value("correct", typeCorrect);
+		json.endObject();
+	}
+
+	auto const constraintReadd = check_constraint_readd<false>() && check_constraint_readd<true>();
+	correct = correct && constraintReadd;
+	json.value("constraint_readd", constraintReadd);
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#include"broadphase_benchmark.hpp"
+#include"bvh_benchmark.hpp"
+#include"compound_benchmark.hpp"
+#include"deformable_benchmark.hpp"
+#include"extract_benchmark.hpp"
+#include"instance_stream_benchmark.hpp"
+#include"island_benchmark.hpp"
+#include"manifold_benchmark.hpp"
+#include"multibody_benchmark.hpp"
+#include"narrowphase_benchmark.hpp"
+#include"obj_loader_benchmark.hpp"
+#include"pair_cache_benchmark.hpp"
+#include"profiler_benchmark.hpp"
+#include"ray_query_benchmark.hpp"
+#include"recorder_benchmark.hpp"
+#include"simd_benchmark.hpp"
+#include"slab_benchmark.hpp"
+#include"snapshot_benchmark.hpp"
+#include"softbody_benchmark.hpp"
+#include"solver_benchmark.hpp"
+#include"terrain_benchmark.hpp"
+#include<algorithm>
+#include<iostream>
+#include<string>
+#include<string_view>
+
+// ʂ̏̃}CNx`}[N
+// ʂJSONŕWo͂ɏ
+
+struct Benchmark
+{
+	std::string_view name;
+	std::string_view description;
+	int (*run)(int argc, char** argv);
+};
+
+constexpr Benchmark BENCHMARKS[] = {
+	{ "simd", "vector math, GJK and constraint solver rows", run_simd_benchmark },
+	{ "obj", "OBJ loader against the previous regex loader", run_obj_loader_benchmark },
+	{ "extract", "render data extraction against btIDebugDraw", run_extract_benchmark },
+	{ "instances", "instance streaming into ring buffers with the null backend", run_instance_stream_benchmark },
+	{ "narrowphase", "capsule-box collision against GJK/EPA", run_narrowphase_benchmark },
+	{ "profiler", "BT_PROFILE scope cost with the profiler disabled and enabled", run_profiler_benchmark },
+	{ "broadphase", "parallel AABB update and pair search against btDbvtBroadphase", run_broadphase_benchmark },
+	{ "paircache", "open-addressing pair cache against btHashedOverlappingPairCache", run_pair_cache_benchmark },
+	{ "raycast", "batched ray queries against btCollisionWorld::rayTest", run_ray_query_benchmark },
+	{ "solver", "SoA batched contact solver against btSequentialImpulseConstraintSolverMt", run_solver_benchmark },
+	{ "islands", "incremental simulation islands against per-step union-find", run_island_benchmark },
+	{ "slab", "growable slab allocator against the fixed pools with heap fallback", run_slab_benchmark },
+	{ "manifold", "hot/cold split contact storage against btPersistentManifold", run_manifold_benchmark },
+	{ "snapshot", "world snapshot and restore against btDefaultSerializer", run_snapshot_benchmark },
+	{ "recorder", "streaming step recorder overhead and memory-mapped replay seeks", run_recorder_benchmark },
+	{ "terrain", "heightfield min/max pyramid against btHeightfieldTerrainShape queries", run_terrain_benchmark },
+	{ "softbody", "SoA cloth with graph-coloured parallel links against AoS soft body nodes", run_soft_body_benchmark },
+	{ "deformable", "implicit mass-spring and Neo-Hookean solve with parallel SoA Krylov iterations against btConjugateGradient", run_deformable_benchmark },
+	{ "multibody", "capsule chains as Featherstone multibodies in a parallel world against rigid bodies and 6DoF constraints", run_multi_body_benchmark },
+	{ "bvh", "parallel binned-SAH triangle mesh BVH and memory-mapped cache against btOptimizedBvh", run_bvh_benchmark },
+	{ "compound", "batched child refit and compound pairs that skip unmoved children against per-child updateChildTransform", run_compound_benchmark },
+};
+
+inline void print_usage()
+{
+	std::cerr << "usage: benchmark <name> [options]\n";
+	for (auto const& b : BENCHMARKS)
+		std::cerr << "  " << b.name << std::string(std::max<std::size_t>(12 - b.name.size(), 1), ' ') << b.description << "\n";
+	std::cerr << "run \"benchmark <name> --help\" for the options of each benchmark\n";
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		print_usage();
+		return 1;
+	}
+
+	std::string_view const name{ argv[1] };
+	for (auto const& b : BENCHMARKS)
+	{
+		if (b.name == name)
+			return b.run(argc - 2, argv + 2);
+	}
+
+	std::cerr << "unknown benchmark " << name << "\n";
+	print_usage();
+	return 1;
+}
@@ -0,0 +1,456 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/CompactManifoldStore.hpp"
+#include"../src/Scene.hpp"
+#include<algorithm>
+#include<cstdlib>
+#include<iostream>
+#include<memory>
+#include<string_view>
+#include<vector>
+
+// btPersistentManifoldCompactManifoldStoreŁAڐG_1̃refreshContactPointsAS鑬ׂ
+// CompactManifoldStore̓[h̃}jtH[h̎ʂȂ̂ŁAassignwriteTo܂߂XebvŜłׂ
+// ̒Ԃ󂯂ĕׁAe̔nʂ4_Őڂ̂ŁA10_ɂȂ
+// ŌvẐŁAXV_ƍS̍s͈v
+
+struct ManifoldBenchmarkOption
+{
+	int repeat = 5;
+	// cɕׂ鐔ƍ
+	std::size_t stackNum = 50;
+	std::size_t stackHeight = 10;
+	// ڐG邽߂ɐi߂Xebv
+	std::size_t settleStepNum = 2;
+	int threadNum = 0;
+};
+
+inline void print_manifold_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark manifold [options]\n"
+		"  --repeat <n>   run n times and report the fastest (default 5)\n"
+		"  --stacks <n>   stacks per side (default 50)\n"
+		"  --height <n>   boxes per stack (default 10)\n"
+		"  --settle <n>   steps before measuring (default 2)\n"
+		"  --threads <n>  threads for refreshContactPoints (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_manifold_benchmark_option(int argc, char** argv, ManifoldBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--stacks")
+			option.stackNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--height")
+			option.stackHeight = std::strtoull(value, nullptr, 10);
+		else if (name == "--settle")
+			option.settleStepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.stackNum < 1 || option.stackHeight < 1 || option.settleStepNum < 1 || option.threadNum < 0) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// S镔Ăׂ悤ɂ
+class ManifoldBenchmarkSolver : public CompactContactSolver
+{
+public:
+	void prepare(btCollisionObject** bodies, int numBodies, btContactSolverInfo const& infoGlobal)
+	{
+		clearRows();
+		m_fixedBodyId = -1;
+		convertBodies(bodies, numBodies, infoGlobal);
+	}
+
+	// solveGroup̑OɋɂĂ
+	void clearRows()
+	{
+		m_tmpSolverContactConstraintPool.resizeNoInitialize(0);
+		m_tmpSolverContactFrictionConstraintPool.resizeNoInitialize(0);
+		m_tmpSolverContactRollingFrictionConstraintPool.resizeNoInitialize(0);
+		m_tmpSolverBodyPool.resizeNoInitialize(0);
+	}
+
+	void convertManifolds(btPersistentManifold** manifoldPtr, int numManifolds, btContactSolverInfo const& infoGlobal)
+	{
+		btSequentialImpulseConstraintSolver::convertContacts(manifoldPtr, numManifolds, infoGlobal);
+	}
+
+	void convertStore(CompactManifoldStore& store, btContactSolverInfo const& infoGlobal)
+	{
+		convertCompactContacts(store, nullptr, store.getManifoldNum(), infoGlobal);
+	}
+
+	std::vector<btSolverConstraint> copyContactRows() const
+	{
+		return { &m_tmpSolverContactConstraintPool[0], &m_tmpSolverContactConstraintPool[0] + m_tmpSolverContactConstraintPool.size() };
+	}
+
+	std::vector<btSolverConstraint> copyFrictionRows() const
+	{
+		return { &m_tmpSolverContactFrictionConstraintPool[0], &m_tmpSolverContactFrictionConstraintPool[0] + m_tmpSolverContactFrictionConstraintPool.size() };
+	}
+};
+
+// ׂ̒[h
+struct ManifoldWorld
+{
+	btDefaultCollisionConfiguration collisionConfiguration{};
+	btCollisionDispatcher dispatcher{ &collisionConfiguration };
+	btDbvtBroadphase broadphase{};
+	btSequentialImpulseConstraintSolver solver{};
+	btDiscreteDynamicsWorld world{ &dispatcher, &broadphase, &solver, &collisionConfiguration };
+	btBoxShape groundShape{ btVector3(1, 1, 1) };
+	btBoxShape boxShape{ btVector3(0.5, 0.5, 0.5) };
+	std::vector<std::unique_ptr<btRigidBody>> bodies{};
+
+	ManifoldWorld(ManifoldBenchmarkOption const& option);
+	virtual ~ManifoldWorld();
+	ManifoldWorld(ManifoldWorld const&) = delete;
+	ManifoldWorld& operator=(ManifoldWorld const&) = delete;
+};
+
+// \o[鍄̂̏
+struct ManifoldBodyState
+{
+	btTransform transform{};
+	btVector3 linearVelocity{};
+	btVector3 angularVelocity{};
+};
+
+bool same_vector3(btVector3 const& a, btVector3 const& b) noexcept;
+bool same_vector3(btScalar const (&a)[3], btVector3 const& b) noexcept;
+// m_originalContactPointȊO
+bool same_solver_row(btSolverConstraint const& a, btSolverConstraint const& b) noexcept;
+// XV̓_
+bool same_contact_point(CompactManifoldStore const& store, int manifold, int index, btManifoldPoint const& point) noexcept;
+
+//
+// ȉA
+//
+
+inline ManifoldWorld::ManifoldWorld(ManifoldBenchmarkOption const& option)
+	: groundShape{ btVector3(btScalar(option.stackNum) + 10, 1, btScalar(option.stackNum) + 10) }
+{
+	world.setGravity(btVector3(0, -10, 0));
+
+	auto const addBody = [&](btCollisionShape* shape, btScalar mass, btVector3 const& position) {
+		btVector3 inertia(0, 0, 0);
+		if (mass != btScalar(0.))
+			shape->calculateLocalInertia(mass, inertia);
+		btRigidBody::btRigidBodyConstructionInfo info{ mass, nullptr, shape, inertia };
+		info.m_startWorldTransform.setOrigin(position);
+		auto& body = bodies.emplace_back(std::make_unique<btRigidBody>(info));
+		if (mass != btScalar(0.))
+			body->setActivationState(DISABLE_DEACTIVATION);
+		world.addRigidBody(body.get());
+	};
+
+	addBody(&groundShape, 0., btVector3(0, -1, 0));
+
+	// ׂ̒ƂAABBdȂȂ̂ŁA}jtH[h͏㉺̔̊ԂɂłȂ
+	auto const offset = (static_cast<btScalar>(option.stackNum) - 1) * btScalar(0.75);
+	for (std::size_t x = 0; x < option.stackNum; x++)
+		for (std::size_t z = 0; z < option.stackNum; z++)
+			for (std::size_t y = 0; y < option.stackHeight; y++)
+				addBody(&boxShape, 1., btVector3(static_cast<btScalar>(x) * btScalar(1.5) - offset, btScalar(0.5) + static_cast<btScalar>(y),
+					static_cast<btScalar>(z) * btScalar(1.5) - offset));
+
+	for (std::size_t i = 0; i < option.settleStepNum; i++)
+		world.stepSimulation(btScalar(1. / 60.), 0);
+}
+
+inline ManifoldWorld::~ManifoldWorld()
+{
+	for (auto const& body : bodies)
+		world.removeRigidBody(body.get());
+}
+
+inline bool same_vector3(btVector3 const& a, btVector3 const& b) noexcept
+{
+	return a.getX() == b.getX() && a.getY() == b.getY() && a.getZ() == b.getZ();
+}
+
+inline bool same_vector3(btScalar const (&a)[3], btVector3 const& b) noexcept
+{
+	return same_vector3(compact_load(a), b);
+}
+
+inline bool same_solver_row(btSolverConstraint const& a, btSolverConstraint const& b) noexcept
+{
+	return same_vector3(a.m_relpos1CrossNormal, b.m_relpos1CrossNormal) && same_vector3(a.m_contactNormal1, b.m_contactNormal1) &&
+		same_vector3(a.m_relpos2CrossNormal, b.m_relpos2CrossNormal) && same_vector3(a.m_contactNormal2, b.m_contactNormal2) &&
+		same_vector3(a.m_angularComponentA, b.m_angularComponentA) && same_vector3(a.m_angularComponentB, b.m_angularComponentB) &&
+		a.m_appliedPushImpulse == b.m_appliedPushImpulse && a.m_appliedImpulse == b.m_appliedImpulse && a.m_friction == b.m_friction &&
+		a.m_jacDiagABInv == b.m_jacDiagABInv && a.m_rhs == b.m_rhs && a.m_cfm == b.m_cfm && a.m_lowerLimit == b.m_lowerLimit &&
+		a.m_upperLimit == b.m_upperLimit && a.m_rhsPenetration == b.m_rhsPenetration && a.m_frictionIndex == b.m_frictionIndex &&
+		a.m_solverBodyIdA == b.m_solverBodyIdA && a.m_solverBodyIdB == b.m_solverBodyIdB;
+}
+
+inline bool same_contact_point(CompactManifoldStore const& store, int manifold, int index, btManifoldPoint const& point) noexcept
+{
+	auto const& hot = store.getContactPoint(manifold, index);
+	auto const& cold = store.getColdContactPoint(manifold, index);
+	return same_vector3(hot.localPointA, point.m_localPointA) && same_vector3(hot.localPointB, point.m_localPointB) &&
+		same_vector3(hot.positionWorldOnA, point.m_positionWorldOnA) && same_vector3(hot.positionWorldOnB, point.m_positionWorldOnB) &&
+		same_vector3(hot.normalWorldOnB, point.m_normalWorldOnB) && hot.distance == point.m_distance1 &&
+		hot.appliedImpulse == point.m_appliedImpulse && hot.lifeTime == point.m_lifeTime &&
+		(hot.flags & ~COMPACT_CONTACT_FLAG_ROLLING_FRICTION) == point.m_contactPointFlags &&
+		same_vector3(cold.lateralFrictionDir1, point.m_lateralFrictionDir1) && same_vector3(cold.lateralFrictionDir2, point.m_lateralFrictionDir2) &&
+		cold.appliedImpulseLateral1 == point.m_appliedImpulseLateral1 && cold.appliedImpulseLateral2 == point.m_appliedImpulseLateral2;
+}
+
+inline int run_manifold_benchmark(int argc, char** argv)
+{
+	ManifoldBenchmarkOption option{};
+	if (!parse_manifold_benchmark_option(argc, argv, option)) {
+		print_manifold_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the manifold benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+	scheduler->setNumThreads(threadNum);
+
+	ManifoldWorld scene{ option };
+	auto const manifoldNum = scene.dispatcher.getNumManifolds();
+	auto const manifoldPtr = scene.dispatcher.getInternalManifoldPointer();
+
+	CompactManifoldStore store{};
+	store.assign(manifoldPtr, manifoldNum);
+	auto const contactNum = store.getContactNum();
+	auto const perContact = [&](double seconds) {
+		return seconds * 1e9 / static_cast<double>(std::max<std::size_t>(contactNum, 1));
+	};
+
+	// Bullet̑}jtH[hƂbtParallelForŕ
+	auto const refreshBullet = [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			auto const manifold = manifoldPtr[i];
+			if (manifold->getNumContacts() == 0)
+				continue;
+			manifold->refreshContactPoints(manifold->getBody0()->getWorldTransform(), manifold->getBody1()->getWorldTransform());
+		}
+	};
+	struct RefreshBody : public btIParallelForBody
+	{
+		decltype(refreshBullet) const& f;
+		RefreshBody(decltype(refreshBullet) const& f) : f(f) {}
+		void forLoop(int begin, int end) const override { f(begin, end); }
+	};
+	auto const refreshBulletTime = measure_best(option.repeat, [&] { btParallelFor(0, manifoldNum, 64, RefreshBody{ refreshBullet }); });
+	auto const refreshCompactTime = measure_best(option.repeat, [&] { store.refreshContactPoints(); });
+
+	// 񐔂XV̂ŁA_̐lɂȂ
+	auto refreshCorrect = true;
+	for (int i = 0; i < manifoldNum; i++)
+	{
+		refreshCorrect = refreshCorrect && store.getNumContacts(i) == manifoldPtr[i]->getNumContacts();
+		for (int j = 0; refreshCorrect && j < store.getNumContacts(i); j++)
+			refreshCorrect = same_contact_point(store, i, j, manifoldPtr[i]->getContactPoint(j));
+	}
+
+	auto& collisionObjects = scene.world.getCollisionObjectArray();
+	auto const& infoGlobal = scene.world.getSolverInfo();
+	ManifoldBenchmarkSolver solver{};
+	auto const prepare = [&] { solver.prepare(&collisionObjects[0], collisionObjects.size(), infoGlobal); };
+
+	auto const convertBulletTime = measure_best(option.repeat, prepare, [&] { solver.convertManifolds(manifoldPtr, manifoldNum, infoGlobal); });
+	auto const bulletContactRows = solver.copyContactRows();
+	auto const bulletFrictionRows = solver.copyFrictionRows();
+	auto const convertCompactTime = measure_best(option.repeat, prepare, [&] { solver.convertStore(store, infoGlobal); });
+	auto const compactContactRows = solver.copyContactRows();
+	auto const compactFrictionRows = solver.copyFrictionRows();
+	solver.clearRows();
+
+	auto convertCorrect = bulletContactRows.size() == compactContactRows.size() && bulletFrictionRows.size() == compactFrictionRows.size();
+	for (std::size_t i = 0; convertCorrect && i < bulletContactRows.size(); i++)
+		convertCorrect = same_solver_row(bulletContactRows[i], compactContactRows[i]);
+	for (std::size_t i = 0; convertCorrect && i < bulletFrictionRows.size(); i++)
+		convertCorrect = same_solver_row(bulletFrictionRows[i], compactFrictionRows[i]);
+
+	// SĂ͐ς߂܂ŁAԂ瓯񐔉Ĕׂ
+	std::vector<btCollisionObject*> dynamicBodies{};
+	std::vector<ManifoldBodyState> initialStates{};
+	for (auto const& body : scene.bodies)
+	{
+		if (body->isStaticOrKinematicObject())
+			continue;
+		dynamicBodies.push_back(body.get());
+		initialStates.push_back({ body->getWorldTransform(), body->getLinearVelocity(), body->getAngularVelocity() });
+	}
+	auto const restore = [&] {
+		for (std::size_t i = 0; i < dynamicBodies.size(); i++)
+		{
+			auto const body = btRigidBody::upcast(dynamicBodies[i]);
+			body->setWorldTransform(initialStates[i].transform);
+			body->setLinearVelocity(initialStates[i].linearVelocity);
+			body->setAngularVelocity(initialStates[i].angularVelocity);
+		}
+	};
+	auto const recordStates = [&] {
+		std::vector<ManifoldBodyState> states{};
+		for (auto const object : dynamicBodies)
+		{
+			auto const body = btRigidBody::upcast(object);
+			states.push_back({ body->getWorldTransform(), body->getLinearVelocity(), body->getAngularVelocity() });
+		}
+		return states;
+	};
+	auto const bodyNum = static_cast<int>(dynamicBodies.size());
+
+	auto const solveBulletTime = measure_best(option.repeat, restore, [&] {
+		solver.solveGroup(dynamicBodies.data(), bodyNum, manifoldPtr, manifoldNum, nullptr, 0, infoGlobal, nullptr, nullptr);
+	});
+	auto const bulletStates = recordStates();
+	auto const solveCompactTime = measure_best(option.repeat, restore, [&] {
+		solver.solveCompactGroup(dynamicBodies.data(), bodyNum, store, nullptr, manifoldNum, nullptr, 0, infoGlobal, nullptr);
+	});
+	auto const compactStates = recordStates();
+
+	auto solveCorrect = true;
+	for (std::size_t i = 0; solveCorrect && i < bulletStates.size(); i++)
+		solveCorrect = same_vector3(bulletStates[i].transform.getOrigin(), compactStates[i].transform.getOrigin()) &&
+			same_vector3(bulletStates[i].linearVelocity, compactStates[i].linearVelocity) &&
+			same_vector3(bulletStates[i].angularVelocity, compactStates[i].angularVelocity);
+	for (int i = 0; solveCorrect && i < manifoldNum; i++)
+		for (int j = 0; solveCorrect && j < store.getNumContacts(i); j++)
+			solveCorrect = same_contact_point(store, i, j, manifoldPtr[i]->getContactPoint(j));
+
+	// ʂԂ
+	auto const assignTime = measure_best(option.repeat, [&] { store.assign(manifoldPtr, manifoldNum); });
+	auto const writeTime = measure_best(option.repeat, [&] { store.writeTo(manifoldPtr, manifoldNum); });
+
+	// iǨォI܂ŁACompactManifoldStore̓[h̃}jtH[hʂď߂Ƃ܂ő
+	std::vector<btPersistentManifold> initialManifolds{};
+	initialManifolds.reserve(static_cast<std::size_t>(manifoldNum));
+	for (int i = 0; i < manifoldNum; i++)
+		initialManifolds.push_back(*manifoldPtr[i]);
+	auto const restoreStep = [&] {
+		restore();
+		for (int i = 0; i < manifoldNum; i++)
+			*manifoldPtr[i] = initialManifolds[i];
+	};
+
+	auto const stepBulletTime = measure_best(option.repeat, restoreStep, [&] {
+		btParallelFor(0, manifoldNum, 64, RefreshBody{ refreshBullet });
+		solver.solveGroup(dynamicBodies.data(), bodyNum, manifoldPtr, manifoldNum, nullptr, 0, infoGlobal, nullptr, nullptr);
+	});
+	auto const bulletStepStates = recordStates();
+	std::vector<btPersistentManifold> bulletStepManifolds{};
+	bulletStepManifolds.reserve(static_cast<std::size_t>(manifoldNum));
+	for (int i = 0; i < manifoldNum; i++)
+		bulletStepManifolds.push_back(*manifoldPtr[i]);
+
+	auto const stepCompactTime = measure_best(option.repeat, restoreStep, [&] {
+		store.assign(manifoldPtr, manifoldNum);
+		store.refreshContactPoints();
+		solver.solveCompactGroup(dynamicBodies.data(), bodyNum, store, nullptr, manifoldNum, nullptr, 0, infoGlobal, nullptr);
+		store.writeTo(manifoldPtr, manifoldNum);
+	});
+	auto const compactStepStates = recordStates();
+
+	// ߂[h̃}jtH[hBulletŉ̂Ɠ
+	auto stepCorrect = true;
+	for (std::size_t i = 0; stepCorrect && i < bulletStepStates.size(); i++)
+		stepCorrect = same_vector3(bulletStepStates[i].transform.getOrigin(), compactStepStates[i].transform.getOrigin()) &&
+			same_vector3(bulletStepStates[i].linearVelocity, compactStepStates[i].linearVelocity) &&
+			same_vector3(bulletStepStates[i].angularVelocity, compactStepStates[i].angularVelocity);
+	for (int i = 0; stepCorrect && i < manifoldNum; i++)
+	{
+		auto const& expected = bulletStepManifolds[static_cast<std::size_t>(i)];
+		stepCorrect = manifoldPtr[i]->getNumContacts() == expected.getNumContacts();
+		for (int j = 0; stepCorrect && j < expected.getNumContacts(); j++)
+			stepCorrect = same_contact_point(store, i, j, expected.getContactPoint(j));
+	}
+	restoreStep();
+
+	auto const correct = refreshCorrect && convertCorrect && solveCorrect && stepCorrect;
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "manifold");
+	json.value("repeat", option.repeat);
+	json.value("threads", threadNum);
+	json.value("bodies", scene.bodies.size() - 1);
+	json.value("manifolds", manifoldNum);
+	json.value("contacts", contactNum);
+
+	json.beginObject("bytes_per_contact");
+	json.value("bullet", static_cast<double>(sizeof(btPersistentManifold)) * manifoldNum / static_cast<double>(contactNum));
+	json.value("compact_hot", static_cast<double>(store.getHotBytes()) / static_cast<double>(contactNum));
+	json.value("compact_cold", static_cast<double>(store.getColdBytes()) / static_cast<double>(contactNum));
+	json.value("compact", static_cast<double>(store.getHotBytes() + store.getColdBytes()) / static_cast<double>(contactNum));
+	json.endObject();
+	json.beginObject("point_bytes");
+	json.value("bullet", sizeof(btManifoldPoint));
+	json.value("compact_hot", sizeof(CompactContactPoint));
+	json.value("compact_cold", sizeof(CompactContactPointCold));
+	json.endObject();
+
+	json.beginObject("refresh_ns_per_contact");
+	json.value("bullet", perContact(refreshBulletTime));
+	json.value("compact", perContact(refreshCompactTime));
+	json.endObject();
+	json.beginObject("convert_ns_per_contact");
+	json.value("bullet", perContact(convertBulletTime));
+	json.value("compact", perContact(convertCompactTime));
+	json.endObject();
+	json.beginObject("solve_ms");
+	json.value("bullet", solveBulletTime * 1e3);
+	json.value("compact", solveCompactTime * 1e3);
+	json.endObject();
+	json.beginObject("copy_ns_per_contact");
+	json.value("assign", perContact(assignTime));
+	json.value("write_to", perContact(writeTime));
+	json.endObject();
+	// refreshContactPointsI܂ŁAcompactassignwriteTo܂
+	json.beginObject("step_ms");
+	json.value("bullet", stepBulletTime * 1e3);
+	json.value("compact", stepCompactTime * 1e3);
+	json.value("speedup", stepBulletTime / stepCompactTime);
+	json.endObject();
+
+	json.value("contact_rows", compactContactRows.size());
+	json.value("friction_rows", compactFrictionRows.size());
+	json.value("refresh_correct", refreshCorrect);
+	json.value("convert_correct", convertCorrect);
+	json.value("solve_correct", solveCorrect);
+	json.value("step_correct", stepCorrect);
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,422 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/MultiBodyWorldMt.hpp"
+#include"../src/Scene.hpp"
+#include"../external/bullet3/src/BulletDynamics/Featherstone/btMultiBodyJointLimitConstraint.h"
+#include<algorithm>
+#include<cmath>
+#include<cstdlib>
+#include<iostream>
+#include<memory>
+#include<string>
+#include<string_view>
+#include<vector>
+
+// nʂɓ͂JvZ݂̍邵A
+// main.cpp̍Ɠ̂btGeneric6DofSpringConstraintłȂ[hƁAbtMultiBodẙ֐߂łȂ[hŔׂ
+// ǂ1Xbh̃[hƕ̃[h𑪂AMultiBodyDynamicsWorldMťʂXbhɂ炸𒲂ׂ
+// ֐߂͍̖ʓŋȂ]ŁA}1.5WAŎ~܂
+
+struct MultiBodyBenchmarkOption
+{
+	int repeat = 3;
+	std::size_t stepNum = 240;
+	int chainNum = 256;
+	int linkNum = 8;
+	int grainSize = 4;
+	int threadNum = 0;
+};
+
+inline void print_multi_body_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark multibody [options]\n"
+		"  --repeat <n>   simulate n times and report the fastest (default 3)\n"
+		"  --steps <n>    steps per simulation (default 240)\n"
+		"  --chains <n>   number of chains (default 256)\n"
+		"  --links <n>    capsules per chain (default 8)\n"
+		"  --grain <n>    multibodies per task (default 4)\n"
+		"  --threads <n>  largest thread count to try (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_multi_body_benchmark_option(int argc, char** argv, MultiBodyBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--chains")
+			option.chainNum = std::atoi(value);
+		else if (name == "--links")
+			option.linkNum = std::atoi(value);
+		else if (name == "--grain")
+			option.grainSize = std::atoi(value);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.stepNum < 1 || option.chainNum < 1 || option.linkNum < 1 || option.grainSize < 1 || option.threadNum < 0) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+enum class MultiBodyWorldType
+{
+	// btDiscreteDynamicsWorld
+	RigidSerial,
+	// btDiscreteDynamicsWorldMt
+	RigidMultithread,
+	// btMultiBodyDynamicsWorld
+	MultiBodySerial,
+	// MultiBodyDynamicsWorldMt
+	MultiBodyMultithread,
+};
+
+// ׂ[hƁA̒g܂Ƃ߂Ď
+class MultiBodyBenchmarkScene
+{
+	// ֐߂̗̓_AanullptrȂlocalA̓[hW
+	struct JointPivot
+	{
+		btCollisionObject const* a = nullptr;
+		btVector3 localA{ 0,0,0 };
+		btCollisionObject const* b = nullptr;
+		btVector3 localB{ 0,0,0 };
+	};
+
+	btDefaultCollisionConfiguration collisionConfiguration{};
+	std::unique_ptr<btCollisionDispatcher> dispatcher{};
+	btDbvtBroadphase broadphase{};
+	std::unique_ptr<btConstraintSolverPoolMt> solverPool{};
+	std::unique_ptr<btConstraintSolver> solver{};
+
+	btBoxShape groundShape{ btVector3(200, 1, 200) };
+	// 1̃JvZ
+	btCapsuleShapeX linkShape{ btScalar(0.2), btScalar(0.6) };
+	// ݂̂̍邷_
+	btEmptyShape anchorShape{};
+
+	std::vector<std::unique_ptr<btRigidBody>> bodies{};
+	std::vector<std::unique_ptr<btTypedConstraint>> constraints{};
+	std::vector<std::unique_ptr<btMultiBody>> multiBodies{};
+	std::vector<std::unique_ptr<btMultiBodyLinkCollider>> colliders{};
+	std::vector<std::unique_ptr<btMultiBodyConstraint>> limits{};
+
+	// ̏Ȁ̃N
+	std::vector<btCollisionObject const*> links{};
+	std::vector<JointPivot> pivots{};
+
+	// gɔj
+	std::unique_ptr<btDiscreteDynamicsWorld> world{};
+
+	void addRigidChain(btVector3 const& anchor, int linkNum);
+	void addMultiBodyChain(btVector3 const& anchor, int linkNum);
+
+public:
+	MultiBodyBenchmarkScene(MultiBodyWorldType type, MultiBodyBenchmarkOption const& option);
+	virtual ~MultiBodyBenchmarkScene() = default;
+	MultiBodyBenchmarkScene(MultiBodyBenchmarkScene const&) = delete;
+	MultiBodyBenchmarkScene& operator=(MultiBodyBenchmarkScene const&) = delete;
+
+	void step() { world->stepSimulation(btScalar(1. / 60.), 0); }
+
+	int getLinkNum() const noexcept { return static_cast<int>(links.size()); }
+	btVector3 getLinkPosition(int i) const { return links[i]->getWorldTransform().getOrigin(); }
+	// ֐߂̗̓_̈ԑ傫
+	btScalar getMaxJointGap() const;
+	// MultiBodyDynamicsWorldMtłȂ0
+	int getIslandNum() const;
+};
+
+//
+// ȉA
+//
+
+inline MultiBodyBenchmarkScene::MultiBodyBenchmarkScene(MultiBodyWorldType type, MultiBodyBenchmarkOption const& option)
+{
+	auto const multithread = type == MultiBodyWorldType::RigidMultithread || type == MultiBodyWorldType::MultiBodyMultithread;
+	if (multithread)
+		dispatcher = std::make_unique<btCollisionDispatcherMt>(&collisionConfiguration, 40);
+	else
+		dispatcher = std::make_unique<btCollisionDispatcher>(&collisionConfiguration);
+
+	switch (type)
+	{
+	case MultiBodyWorldType::RigidSerial:
+		solver = std::make_unique<btSequentialImpulseConstraintSolver>();
+		world = std::make_unique<btDiscreteDynamicsWorld>(dispatcher.get(), &broadphase, solver.get(), &collisionConfiguration);
+		break;
+	case MultiBodyWorldType::RigidMultithread:
+	{
+		btConstraintSolver* solvers[BT_MAX_THREAD_COUNT];
+		for (unsigned i = 0; i < BT_MAX_THREAD_COUNT; i++)
+			solvers[i] = new btSequentialImpulseConstraintSolver();
+		solverPool = std::make_unique<btConstraintSolverPoolMt>(solvers, BT_MAX_THREAD_COUNT);
+		solver = std::make_unique<btSequentialImpulseConstraintSolverMt>();
+		world = std::make_unique<btDiscreteDynamicsWorldMt>(dispatcher.get(), &broadphase, solverPool.get(), solver.get(), &collisionConfiguration);
+		break;
+	}
+	case MultiBodyWorldType::MultiBodySerial:
+	{
+		auto const multiBodySolver = new btMultiBodyConstraintSolver();
+		solver.reset(multiBodySolver);
+		world = std::make_unique<btMultiBodyDynamicsWorld>(dispatcher.get(), &broadphase, multiBodySolver, &collisionConfiguration);
+		break;
+	}
+	case MultiBodyWorldType::MultiBodyMultithread:
+	{
+		auto const multiBodySolver = new btMultiBodyConstraintSolver();
+		solver.reset(multiBodySolver);
+		auto worldMt = std::make_unique<MultiBodyDynamicsWorldMt>(dispatcher.get(), &broadphase, multiBodySolver, &collisionConfiguration);
+		worldMt->setGrainSize(option.grainSize);
+		world = std::move(worldMt);
+		break;
+	}
+	}
+	world->setGravity(btVector3(0, -10, 0));
+
+	{
+		btRigidBody::btRigidBodyConstructionInfo info{ 0, nullptr, &groundShape };
+		info.m_startWorldTransform.setOrigin(btVector3(0, -1, 0));
+		info.m_friction = 0.6;
+		auto& ground = bodies.emplace_back(std::make_unique<btRigidBody>(info));
+		world->addRigidBody(ground.get());
+	}
+
+	// ͉ɐL΂`UꗎāA悪nʂ
+	auto const gridWidth = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(option.chainNum))));
+	for (int i = 0; i < option.chainNum; i++)
+	{
+		btVector3 const anchor{ btScalar(i % gridWidth) * (option.linkNum + 2), btScalar(option.linkNum) * btScalar(0.6), btScalar(i / gridWidth) * btScalar(1.5) };
+		if (type == MultiBodyWorldType::RigidSerial || type == MultiBodyWorldType::RigidMultithread)
+			addRigidChain(anchor, option.linkNum);
+		else
+			addMultiBodyChain(anchor, option.linkNum);
+	}
+}
+
+inline void MultiBodyBenchmarkScene::addRigidChain(btVector3 const& anchor, int linkNum)
+{
+	btRigidBody* parent{};
+	{
+		btRigidBody::btRigidBodyConstructionInfo info{ 0, nullptr, &anchorShape };
+		info.m_startWorldTransform.setOrigin(anchor);
+		parent = bodies.emplace_back(std::make_unique<btRigidBody>(info)).get();
+		parent->setCollisionFlags(parent->getCollisionFlags() | btCollisionObject::CF_NO_CONTACT_RESPONSE);
+		world->addRigidBody(parent);
+	}
+
+	btVector3 inertia{ 0,0,0 };
+	linkShape.calculateLocalInertia(1, inertia);
+	for (int i = 0; i < linkNum; i++)
+	{
+		btRigidBody::btRigidBodyConstructionInfo info{ 1, nullptr, &linkShape, inertia };
+		info.m_startWorldTransform.setOrigin(anchor + btVector3(btScalar(i) + btScalar(0.5), 0, 0));
+		info.m_friction = 0.6;
+		auto const body = bodies.emplace_back(std::make_unique<btRigidBody>(info)).get();
+		body->setActivationState(DISABLE_DEACTIVATION);
+		world->addRigidBody(body);
+
+		// ֐߂zɂ
+		btTransform frameInA{ btMatrix3x3::getIdentity(), i == 0 ? btVector3(0, 0, 0) : btVector3(btScalar(0.5), 0, 0) };
+		btTransform frameInB{ btMatrix3x3::getIdentity(), btVector3(btScalar(-0.5), 0, 0) };
+		auto constraint = std::make_unique<btGeneric6DofSpringConstraint>(*parent, *body, frameInA, frameInB, true);
+		constraint->setLinearLowerLimit(btVector3(0, 0, 0));
+		constraint->setLinearUpperLimit(btVector3(0, 0, 0));
+		constraint->setAngularLowerLimit(btVector3(0, 0, btScalar(-1.5)));
+		constraint->setAngularUpperLimit(btVector3(0, 0, btScalar(1.5)));
+		world->addConstraint(constraint.get(), true);
+		constraints.push_back(std::move(constraint));
+
+		pivots.push_back({ i == 0 ? nullptr : parent, i == 0 ? anchor : frameInA.getOrigin(), body, frameInB.getOrigin() });
+		links.push_back(body);
+		parent = body;
+	}
+}
+
+inline void MultiBodyBenchmarkScene::addMultiBodyChain(btVector3 const& anchor, int linkNum)
+{
+	auto const multiBody = multiBodies.emplace_back(std::make_unique<btMultiBody>(linkNum, 0, btVector3(0, 0, 0), true, false)).get();
+	multiBody->setBasePos(anchor);
+	multiBody->setWorldToBaseRot(btQuaternion::getIdentity());
+	multiBody->setHasSelfCollision(true);
+	multiBody->setLinearDamping(0);
+	multiBody->setAngularDamping(0);
+
+	btVector3 inertia{ 0,0,0 };
+	linkShape.calculateLocalInertia(1, inertia);
+	for (int i = 0; i < linkNum; i++)
+	{
+		// ̂̍ƓA֐߂zɂ
+		auto const parentComToPivot = i == 0 ? btVector3(0, 0, 0) : btVector3(btScalar(0.5), 0, 0);
+		multiBody->setupRevolute(i, 1, inertia, i - 1, btQuaternion::getIdentity(), btVector3(0, 0, 1), parentComToPivot, btVector3(btScalar(0.5), 0, 0), true);
+	}
+	multiBody->finalizeMultiDof();
+	static_cast<btMultiBodyDynamicsWorld*>(world.get())->addMultiBody(multiBody);
+
+	for (int i = 0; i < linkNum; i++)
+	{
+		auto const collider = colliders.emplace_back(std::make_unique<btMultiBodyLinkCollider>(multiBody, i)).get();
+		collider->setCollisionShape(&linkShape);
+		collider->setWorldTransform(btTransform{ btMatrix3x3::getIdentity(), anchor + btVector3(btScalar(i) + btScalar(0.5), 0, 0) });
+		collider->setFriction(btScalar(0.6));
+		collider->setActivationState(DISABLE_DEACTIVATION);
+		world->addCollisionObject(collider, btBroadphaseProxy::DefaultFilter, btBroadphaseProxy::AllFilter);
+		multiBody->getLink(i).m_collider = collider;
+
+		auto limit = std::make_unique<btMultiBodyJointLimitConstraint>(multiBody, i, btScalar(-1.5), btScalar(1.5));
+		static_cast<btMultiBodyDynamicsWorld*>(world.get())->addMultiBodyConstraint(limit.get());
+		limits.push_back(std::move(limit));
+
+		pivots.push_back({ i == 0 ? nullptr : links.back(), i == 0 ? anchor : btVector3(btScalar(0.5), 0, 0), collider, btVector3(btScalar(-0.5), 0, 0) });
+		links.push_back(collider);
+	}
+}
+
+inline btScalar MultiBodyBenchmarkScene::getMaxJointGap() const
+{
+	btScalar gap = 0;
+	for (auto const& pivot : pivots)
+	{
+		auto const a = pivot.a ? pivot.a->getWorldTransform() * pivot.localA : pivot.localA;
+		auto const b = pivot.b->getWorldTransform() * pivot.localB;
+		gap = std::max(gap, a.distance(b));
+	}
+	return gap;
+}
+
+inline int MultiBodyBenchmarkScene::getIslandNum() const
+{
+	auto const worldMt = dynamic_cast<MultiBodyDynamicsWorldMt const*>(world.get());
+	return worldMt ? worldMt->getIslandNum() : 0;
+}
+
+inline int run_multi_body_benchmark(int argc, char** argv)
+{
+	MultiBodyBenchmarkOption option{};
+	if (!parse_multi_body_benchmark_option(argc, argv, option)) {
+		print_multi_body_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the multibody benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+
+	// 1{Xɑ₵AŌ͎w肵Xbh
+	std::vector<int> threadCounts{};
+	for (int t = 1; t < threadNum; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(threadNum);
+
+	auto const perStep = [&](double seconds) { return seconds * 1e3 / static_cast<double>(option.stepNum); };
+
+	std::unique_ptr<MultiBodyBenchmarkScene> scene{};
+	auto const measure = [&](MultiBodyWorldType type) {
+		return measure_best(option.repeat, [&] {
+			scene.reset();
+			scene = std::make_unique<MultiBodyBenchmarkScene>(type, option);
+		}, [&] {
+			for (std::size_t i = 0; i < option.stepNum; i++)
+				scene->step();
+		});
+	};
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "multibody");
+	json.value("repeat", option.repeat);
+	json.value("steps", option.stepNum);
+	json.value("chains", option.chainNum);
+	json.value("links", option.linkNum);
+	json.value("grain", option.grainSize);
+	json.value("threads", threadNum);
+
+	json.beginObject("ms_per_step");
+
+	scheduler->setNumThreads(1);
+	json.value("rigid_serial", perStep(measure(MultiBodyWorldType::RigidSerial)));
+	auto const rigidGap = scene->getMaxJointGap();
+	for (auto const threads : threadCounts)
+	{
+		scheduler->setNumThreads(threads);
+		json.value("rigid_threads_" + std::to_string(threads), perStep(measure(MultiBodyWorldType::RigidMultithread)));
+	}
+
+	scheduler->setNumThreads(1);
+	json.value("multibody_serial", perStep(measure(MultiBodyWorldType::MultiBodySerial)));
+	std::vector<btVector3> serialPositions(static_cast<std::size_t>(scene->getLinkNum()));
+	for (int i = 0; i < scene->getLinkNum(); i++)
+		serialPositions[i] = scene->getLinkPosition(i);
+
+	std::vector<btVector3> firstPositions{};
+	auto deterministic = true;
+	btScalar maxDifference{};
+	btScalar multiBodyGap{};
+	int islandNum{};
+	for (auto const threads : threadCounts)
+	{
+		scheduler->setNumThreads(threads);
+		json.value("multibody_threads_" + std::to_string(threads), perStep(measure(MultiBodyWorldType::MultiBodyMultithread)));
+
+		if (firstPositions.empty())
+		{
+			for (int i = 0; i < scene->getLinkNum(); i++)
+			{
+				firstPositions.push_back(scene->getLinkPosition(i));
+				maxDifference = std::max(maxDifference, firstPositions.back().distance(serialPositions[i]));
+			}
+			multiBodyGap = scene->getMaxJointGap();
+			islandNum = scene->getIslandNum();
+		}
+		else
+		{
+			for (int i = 0; i < scene->getLinkNum(); i++)
+			{
+				auto const position = scene->getLinkPosition(i);
+				for (int axis = 0; axis < 3; axis++)
+					deterministic = deterministic && position[axis] == firstPositions[i][axis];
+			}
+		}
+	}
+	json.endObject();
+
+	json.value("islands", islandNum);
+	json.value("max_joint_gap_rigid", rigidGap);
+	json.value("max_joint_gap_multibody", multiBodyGap);
+	json.value("max_difference_from_serial", maxDifference);
+	json.value("deterministic", deterministic);
+
+	// ֐߂̍Wŉ̂ō͐؂ȂAACh𕪂ĉĂ1Xbh̃[hƓɂȂ
+	auto const correct = deterministic && islandNum >= option.chainNum && multiBodyGap <= btScalar(1e-6) && maxDifference <= btScalar(1e-6);
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,391 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"simd_benchmark.hpp"
+#include"../src/CapsuleBoxCollisionAlgorithm.hpp"
+#include<algorithm>
+#include<cmath>
+#include<cstdlib>
+#include<iostream>
+#include<limits>
+#include<memory>
+#include<random>
+#include<string_view>
+#include<vector>
+
+// JvZƔ̃i[tF[YACapsuleBoxCollisionAlgorithmGJKAEPAŔׂ
+// yA̎ԂƁAnʂɐQJvZv
+
+struct NarrowphaseBenchmarkOption
+{
+	int repeat = 20;
+	std::size_t pairNum = 2000;
+	// nʂɗƂJvZ̐ƃXebv
+	std::size_t restingNum = 64;
+	std::size_t stepNum = 600;
+};
+
+inline void print_narrowphase_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark narrowphase [options]\n"
+		"  --repeat <n>    measure n times and report the fastest (default 20)\n"
+		"  --pairs <n>     capsule-box pairs with random poses (default 2000)\n"
+		"  --resting <n>   capsules dropped onto the ground for the stability test (default 64)\n"
+		"  --steps <n>     steps of the stability test (default 600)\n";
+}
+
+// sfalse
+inline bool parse_narrowphase_benchmark_option(int argc, char** argv, NarrowphaseBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--pairs")
+			option.pairNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--resting")
+			option.restingNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.pairNum < 1 || option.restingNum < 1 || option.stepNum < 60) {
+		std::cerr << "invalid --repeat, --pairs, --resting or --steps (at least 60)\n";
+		return false;
+	}
+
+	return true;
+}
+
+struct CapsuleBoxPose
+{
+	btScalar radius{};
+	btScalar halfHeight{};
+	btTransform capsuleTransform{};
+
+	btVector3 halfExtent{};
+	btTransform boxTransform{};
+};
+
+// ̋߂ɃJvZu
+// S͖ʁAӁA_̏OŁA͂΂΂Ȃ̂Ő󂢐ڐG[߂荞݂܂ō
+inline std::vector<CapsuleBoxPose> make_capsule_box_poses(std::size_t pairNum)
+{
+	std::mt19937 engine{ 3 };
+	std::uniform_real_distribution<double> unit{ 0., 1. };
+
+	std::vector<CapsuleBoxPose> poses(pairNum);
+	for (std::size_t i = 0; i < pairNum; i++)
+	{
+		auto& pose = poses[i];
+		pose.radius = btScalar(0.2 + unit(engine) * 0.8);
+		pose.halfHeight = btScalar(0.2 + unit(engine) * 1.8);
+		pose.halfExtent = btVector3(btScalar(0.5 + unit(engine) * 2.5), btScalar(0.5 + unit(engine) * 2.5), btScalar(0.5 + unit(engine) * 2.5));
+
+		// yAǂdȂȂ悤ɕׂ
+		pose.boxTransform = btTransform{ random_rotation(engine), btVector3(btScalar(i) * 20, 0, 0) };
+
+		auto const direction = random_vector(engine, 1.).normalized();
+		btVector3 local{};
+		for (int j = 0; j < 3; j++)
+			local[j] = std::clamp(direction[j] * 10, -pose.halfExtent[j], pose.halfExtent[j]);
+		local += direction * (pose.radius * btScalar(0.8 + unit(engine) * 0.3));
+
+		pose.capsuleTransform = btTransform{ random_rotation(engine), pose.boxTransform * local };
+	}
+	return poses;
+}
+
+// Փˌõ[h
+struct NarrowphaseWorld
+{
+	std::unique_ptr<btDefaultCollisionConfiguration> configuration{};
+	std::unique_ptr<btCollisionDispatcher> dispatcher{};
+	std::unique_ptr<btBroadphaseInterface> broadphase{};
+	std::unique_ptr<btCollisionWorld> world{};
+
+	std::vector<std::unique_ptr<btCollisionShape>> shapes{};
+	std::vector<std::unique_ptr<btCollisionObject>> objects{};
+
+	NarrowphaseWorld(bool analytic, std::vector<CapsuleBoxPose> const& poses)
+	{
+		if (analytic)
+			configuration = std::make_unique<CapsuleBoxCollisionConfiguration>();
+		else
+			configuration = std::make_unique<btDefaultCollisionConfiguration>();
+		dispatcher = std::make_unique<btCollisionDispatcher>(configuration.get());
+		broadphase = std::make_unique<btDbvtBroadphase>();
+		world = std::make_unique<btCollisionWorld>(dispatcher.get(), broadphase.get(), configuration.get());
+
+		for (std::size_t i = 0; i < poses.size(); i++)
+		{
+			auto const& pose = poses[i];
+			add(std::make_unique<btCapsuleShape>(pose.radius, pose.halfHeight * 2), pose.capsuleTransform, static_cast<int>(i));
+			add(std::make_unique<btBoxShape>(pose.halfExtent), pose.boxTransform, static_cast<int>(i));
+		}
+
+		// u[htF[ỸyAĂ
+		world->performDiscreteCollisionDetection();
+	}
+
+	~NarrowphaseWorld()
+	{
+		for (auto& object : objects)
+			world->removeCollisionObject(object.get());
+	}
+
+	NarrowphaseWorld(NarrowphaseWorld const&) = delete;
+	NarrowphaseWorld& operator=(NarrowphaseWorld const&) = delete;
+
+	void add(std::unique_ptr<btCollisionShape>&& shape, btTransform const& transform, int pairIndex)
+	{
+		auto& object = objects.emplace_back(std::make_unique<btCollisionObject>());
+		object->setCollisionShape(shape.get());
+		object->setWorldTransform(transform);
+		object->setUserIndex(pairIndex);
+		world->addCollisionObject(object.get());
+		shapes.push_back(std::move(shape));
+	}
+
+	// i[tF[Y
+	void dispatch()
+	{
+		dispatcher->dispatchAllCollisionPairs(broadphase->getOverlappingPairCache(), world->getDispatchInfo(), dispatcher.get());
+	}
+
+	// yAƂ̐ڐG_̐ƈԏ
+	void getContacts(std::vector<int>& contactNums, std::vector<btScalar>& distances) const
+	{
+		for (int i = 0; i < dispatcher->getNumManifolds(); i++)
+		{
+			auto const manifold = dispatcher->getManifoldByIndexInternal(i);
+			auto const pairIndex = static_cast<std::size_t>(manifold->getBody0()->getUserIndex());
+			contactNums[pairIndex] = manifold->getNumContacts();
+			for (int j = 0; j < manifold->getNumContacts(); j++)
+				distances[pairIndex] = std::min(distances[pairIndex], manifold->getContactPoint(j).getDistance());
+		}
+	}
+};
+
+struct RestingResult
+{
+	double stepTime{};
+	// n̍ő
+	double maxLinearVelocity{};
+	double maxAngularVelocity{};
+	double maxHeightDrift{};
+	// Ō̃Xebṽ}jtH[h
+	double meanContactNum{};
+	// ܂ł̃Xebv̕ρAŌ܂ŖȂstepNumŐ
+	double meanSleepStep{};
+	std::size_t sleepingNum{};
+};
+
+// nʂɃJvZXĐQėƂ
+inline RestingResult run_resting(bool analytic, NarrowphaseBenchmarkOption const& option)
+{
+	// 0.1Ē˂܂
+	constexpr std::size_t LANDING_STEP_NUM = 30;
+
+	std::unique_ptr<btDefaultCollisionConfiguration> configuration{};
+	if (analytic)
+		configuration = std::make_unique<CapsuleBoxCollisionConfiguration>();
+	else
+		configuration = std::make_unique<btDefaultCollisionConfiguration>();
+	btCollisionDispatcher dispatcher{ configuration.get() };
+	btDbvtBroadphase broadphase{};
+	btSequentialImpulseConstraintSolver solver{};
+	btDiscreteDynamicsWorld world{ &dispatcher, &broadphase, &solver, configuration.get() };
+	world.setGravity(btVector3(0, -9.8, 0));
+
+	auto const width = btScalar(option.restingNum) * 5 + 10;
+	btBoxShape groundShape{ btVector3(width, 1, 10) };
+	btRigidBody ground{ 0., nullptr, &groundShape };
+	ground.setWorldTransform(btTransform{ btQuaternion::getIdentity(), btVector3(width - 5, -1, 0) });
+	world.addRigidBody(&ground);
+
+	btCapsuleShape capsuleShape{ 0.5, 2. };
+	btVector3 inertia{};
+	capsuleShape.calculateLocalInertia(1., inertia);
+
+	std::vector<std::unique_ptr<btRigidBody>> capsules{};
+	for (std::size_t i = 0; i < option.restingNum; i++)
+	{
+		// |ɂāAXƌς
+		auto const tilt = btScalar((static_cast<int>(i % 5) - 2) * 0.03);
+		auto const yaw = btScalar(static_cast<double>(i) * 0.7);
+		btQuaternion const rotation = btQuaternion{ btVector3(0, 1, 0), yaw } * btQuaternion{ btVector3(0, 0, 1), SIMD_HALF_PI + tilt };
+
+		auto& capsule = capsules.emplace_back(std::make_unique<btRigidBody>(1., nullptr, &capsuleShape, inertia));
+		capsule->setWorldTransform(btTransform{ rotation, btVector3(btScalar(i) * 5, btScalar(0.5 + 0.1 + std::abs(tilt)), 0) });
+		world.addRigidBody(capsule.get());
+	}
+
+	RestingResult result{};
+	std::vector<btScalar> minHeights(capsules.size(), std::numeric_limits<btScalar>::max());
+	std::vector<btScalar> maxHeights(capsules.size(), std::numeric_limits<btScalar>::lowest());
+	std::vector<std::size_t> sleepSteps(capsules.size(), option.stepNum);
+
+	result.stepTime = measure_best(1, [&] {
+		for (std::size_t step = 0; step < option.stepNum; step++)
+		{
+			world.stepSimulation(btScalar(1. / 60.), 0);
+
+			if (step < LANDING_STEP_NUM)
+				continue;
+
+			for (std::size_t i = 0; i < capsules.size(); i++)
+			{
+				auto const& capsule = *capsules[i];
+				if (capsule.getActivationState() == ISLAND_SLEEPING)
+					sleepSteps[i] = std::min(sleepSteps[i], step);
+				auto const height = capsule.getWorldTransform().getOrigin().y();
+				minHeights[i] = std::min(minHeights[i], height);
+				maxHeights[i] = std::max(maxHeights[i], height);
+				result.maxLinearVelocity = std::max(result.maxLinearVelocity, static_cast<double>(capsule.getLinearVelocity().length()));
+				result.maxAngularVelocity = std::max(result.maxAngularVelocity, static_cast<double>(capsule.getAngularVelocity().length()));
+			}
+		}
+	}) / static_cast<double>(option.stepNum);
+
+	for (std::size_t i = 0; i < capsules.size(); i++)
+	{
+		result.maxHeightDrift = std::max(result.maxHeightDrift, static_cast<double>(maxHeights[i] - minHeights[i]));
+		result.meanSleepStep += static_cast<double>(sleepSteps[i]) / static_cast<double>(capsules.size());
+		if (capsules[i]->getActivationState() == ISLAND_SLEEPING)
+			result.sleepingNum++;
+	}
+
+	std::size_t contactNum = 0;
+	for (int i = 0; i < dispatcher.getNumManifolds(); i++)
+		contactNum += static_cast<std::size_t>(dispatcher.getManifoldByIndexInternal(i)->getNumContacts());
+	result.meanContactNum = static_cast<double>(contactNum) / std::max(dispatcher.getNumManifolds(), 1);
+
+	for (auto& capsule : capsules)
+		world.removeRigidBody(capsule.get());
+	world.removeRigidBody(&ground);
+
+	return result;
+}
+
+inline void write_resting_result(JsonWriter& json, std::string_view key, RestingResult const& result)
+{
+	json.beginObject(key);
+	json.value("step_ms", result.stepTime * 1e3);
+	json.value("max_linear_velocity", result.maxLinearVelocity);
+	json.value("max_angular_velocity", result.maxAngularVelocity);
+	json.value("max_height_drift", result.maxHeightDrift);
+	json.value("contacts_per_manifold", result.meanContactNum);
+	json.value("mean_sleep_step", result.meanSleepStep);
+	json.value("sleeping", result.sleepingNum);
+	json.endObject();
+}
+
+inline int run_narrowphase_benchmark(int argc, char** argv)
+{
+	NarrowphaseBenchmarkOption option{};
+	if (!parse_narrowphase_benchmark_option(argc, argv, option)) {
+		print_narrowphase_benchmark_usage();
+		return 1;
+	}
+
+	auto const poses = make_capsule_box_poses(option.pairNum);
+
+	NarrowphaseWorld analyticWorld{ true, poses };
+	NarrowphaseWorld gjkWorld{ false, poses };
+
+	// ŏ1ōꂽڐGׂ
+	std::vector<int> analyticContactNums(poses.size());
+	std::vector<int> gjkContactNums(poses.size());
+	std::vector<btScalar> analyticDistances(poses.size(), std::numeric_limits<btScalar>::max());
+	std::vector<btScalar> gjkDistances(poses.size(), std::numeric_limits<btScalar>::max());
+	analyticWorld.getContacts(analyticContactNums, analyticDistances);
+	gjkWorld.getContacts(gjkContactNums, gjkDistances);
+
+	std::size_t analyticContactPairNum = 0;
+	std::size_t analyticContactNum = 0;
+	std::size_t gjkContactPairNum = 0;
+	std::size_t gjkContactNum = 0;
+	std::size_t mismatchNum = 0;
+	// 󂢐ڐG͈v͂A[߂荞݂EPAߎȂ̂ŔŌ
+	double maxDistanceDifference = 0.;
+	double maxDeepRelativeDifference = 0.;
+	for (std::size_t i = 0; i < poses.size(); i++)
+	{
+		auto const analyticHit = analyticContactNums[i] > 0;
+		auto const gjkHit = gjkContactNums[i] > 0;
+		analyticContactPairNum += analyticHit ? 1 : 0;
+		analyticContactNum += static_cast<std::size_t>(analyticContactNums[i]);
+		gjkContactPairNum += gjkHit ? 1 : 0;
+		gjkContactNum += static_cast<std::size_t>(gjkContactNums[i]);
+
+		auto const difference = static_cast<double>(std::abs(analyticDistances[i] - gjkDistances[i]));
+		if (analyticHit && gjkHit && gjkDistances[i] > -0.1)
+			maxDistanceDifference = std::max(maxDistanceDifference, difference);
+		else if (analyticHit && gjkHit)
+			maxDeepRelativeDifference = std::max(maxDeepRelativeDifference, difference / static_cast<double>(-gjkDistances[i]));
+		// ڐG鋗̋ڂɂ̂͐Ȃ
+		else if ((analyticHit && analyticDistances[i] < -0.01) || (gjkHit && gjkDistances[i] < -0.01))
+			mismatchNum++;
+	}
+
+	auto const pairNum = std::max(analyticWorld.broadphase->getOverlappingPairCache()->getNumOverlappingPairs(), 1);
+	auto const analyticTime = measure_best(option.repeat, [&] { analyticWorld.dispatch(); });
+	auto const gjkTime = measure_best(option.repeat, [&] { gjkWorld.dispatch(); });
+
+	auto const analyticResting = run_resting(true, option);
+	auto const gjkResting = run_resting(false, option);
+
+	auto const correct = mismatchNum == 0 && maxDistanceDifference < 1e-3;
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "narrowphase");
+	json.value("repeat", option.repeat);
+	json.value("pairs", option.pairNum);
+	json.value("broadphase_pairs", pairNum);
+
+	json.beginObject("first_call");
+	json.value("analytic_touching_pairs", analyticContactPairNum);
+	json.value("analytic_contacts_per_pair", static_cast<double>(analyticContactNum) / static_cast<double>(std::max<std::size_t>(analyticContactPairNum, 1)));
+	json.value("gjk_touching_pairs", gjkContactPairNum);
+	json.value("gjk_contacts_per_pair", static_cast<double>(gjkContactNum) / static_cast<double>(std::max<std::size_t>(gjkContactPairNum, 1)));
+	json.value("max_distance_difference", maxDistanceDifference);
+	json.value("max_deep_relative_difference", maxDeepRelativeDifference);
+	json.value("mismatched_pairs", mismatchNum);
+	json.endObject();
+
+	json.beginObject("dispatch");
+	json.value("analytic_ns_per_pair", analyticTime * 1e9 / pairNum);
+	json.value("gjk_ns_per_pair", gjkTime * 1e9 / pairNum);
+	json.value("speedup", gjkTime / analyticTime);
+	json.endObject();
+
+	json.beginObject("resting");
+	json.value("capsules", option.restingNum);
+	json.value("steps", option.stepNum);
+	write_resting_result(json, "analytic", analyticResting);
+	write_resting_result(json, "gjk", gjkResting);
+	json.endObject();
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,349 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/mesh_cache.hpp"
+#include"../src/obj_loader.hpp"
+#include<array>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<limits>
+#include<regex>
+#include<string>
+#include<string_view>
+#include<vector>
+
+// ȑOregexgload_objƃ}bvparse_obj̓ǂݍݎԂƃׂ
+// bṼLbVǂ񂾂Ƃ̎Ԃv
+// --input΋OBJ𐶐Ďg
+
+struct ObjLoaderBenchmarkOption
+{
+	int repeat = 3;
+	std::vector<std::string> inputFileNames{};
+
+	// 鋅̕
+	int segments = 256;
+	// 鋅̖ʂlp`ɂAregex͓̎ǂ߂Ȃ̂ŌvȂ
+	bool quads = false;
+
+	bool skipRegex = false;
+};
+
+// rpɎcȑOload_obj
+// position, normal
+inline std::vector<std::array<float, 6>> load_obj_regex(std::istream& in)
+{
+	const std::regex commentout{ "(.*)#(.*)" };
+	const std::regex position{ "v\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)" };
+	const std::regex normal{ "vn\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)" };
+	const std::regex face{ "f\\s(\\d+)//(\\d+)\\s(\\d+)//(\\d+)\\s(\\d+)//(\\d+)" };
+	const std::regex face2{ "f\\s(\\d+)/(\\d+)/(\\d+)\\s(\\d+)/(\\d+)/(\\d+)\\s(\\d+)/(\\d+)/(\\d+)" };
+
+	std::vector<std::array<float, 3>> position_data{};
+	std::vector<std::array<float, 3>> normal_data{};
+
+	std::vector<std::array<float, 6>> result{};
+
+	std::string buffer{};
+	std::smatch match{};
+
+	while (std::getline(in, buffer))
+	{
+		// RgAEg
+		if (std::regex_match(buffer, match, commentout))
+		{
+			buffer = match[1].str();
+		}
+
+		if (std::regex_match(buffer, match, position))
+		{
+			position_data.push_back({ std::stof(match[1].str()), std::stof(match[2].str()), std::stof(match[3].str()) });
+		}
+		else if (std::regex_match(buffer, match, normal))
+		{
+			normal_data.push_back({ std::stof(match[1].str()), std::stof(match[2].str()), std::stof(match[3].str()) });
+		}
+		else if (std::regex_match(buffer, match, face))
+		{
+			auto const& position1 = position_data[std::stoi(match[1].str()) - 1];
+			auto const& normal1 = normal_data[std::stoi(match[2].str()) - 1];
+			auto const& position2 = position_data[std::stoi(match[3].str()) - 1];
+			auto const& normal2 = normal_data[std::stoi(match[4].str()) - 1];
+			auto const& position3 = position_data[std::stoi(match[5].str()) - 1];
+			auto const& normal3 = normal_data[std::stoi(match[6].str()) - 1];
+
+			result.push_back({
+				position1[0], position1[1], position1[2],
+				normal1[0], normal1[1], normal1[2],
+				});
+
+			result.push_back({
+				position2[0], position2[1], position2[2],
+				normal2[0], normal2[1], normal2[2],
+				});
+
+			result.push_back({
+				position3[0], position3[1], position3[2],
+				normal3[0], normal3[1], normal3[2],
+				});
+		}
+		else if (std::regex_match(buffer, match, face2))
+		{
+			auto const& position1 = position_data[std::stoi(match[1].str()) - 1];
+			auto const& normal1 = normal_data[std::stoi(match[3].str()) - 1];
+			auto const& position2 = position_data[std::stoi(match[4].str()) - 1];
+			auto const& normal2 = normal_data[std::stoi(match[6].str()) - 1];
+			auto const& position3 = position_data[std::stoi(match[7].str()) - 1];
+			auto const& normal3 = normal_data[std::stoi(match[9].str()) - 1];
+
+			result.push_back({
+				position1[0], position1[1], position1[2],
+				normal1[0], normal1[1], normal1[2],
+				});
+
+			result.push_back({
+				position2[0], position2[1], position2[2],
+				normal2[0], normal2[1], normal2[2],
+				});
+
+			result.push_back({
+				position3[0], position3[1], position3[2],
+				normal3[0], normal3[1], normal3[2],
+				});
+		}
+	}
+
+	return result;
+}
+
+// ܓxoxŕPʋ
+inline void write_sphere_obj(std::ostream& out, int segments, bool quads)
+{
+	constexpr double PI = 3.14159265358979323846;
+	auto const rings = segments / 2;
+
+	out << "# generated by benchmark obj\n";
+
+	// Ԓ͎̂Op`2̖ʂ̍sŁAint12Ƌ؂154
+	char line[160];
+	for (int r = 0; r <= rings; r++)
+	{
+		auto const theta = PI * r / rings;
+		for (int s = 0; s <= segments; s++)
+		{
+			auto const phi = 2. * PI * s / segments;
+			auto const x = std::sin(theta) * std::cos(phi);
+			auto const y = std::cos(theta);
+			auto const z = std::sin(theta) * std::sin(phi);
+			std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\n", x, y, z, x, y, z);
+			out << line;
+		}
+	}
+
+	auto index = [&](int r, int s) { return r * (segments + 1) + s + 1; };
+	for (int r = 0; r < rings; r++)
+	{
+		for (int s = 0; s < segments; s++)
+		{
+			auto const a = index(r, s), b = index(r + 1, s), c = index(r + 1, s + 1), d = index(r, s + 1);
+			if (quads)
+				std::snprintf(line, sizeof(line), "f %d//%d %d//%d %d//%d %d//%d\n", a, a, b, b, c, c, d, d);
+			else
+				std::snprintf(line, sizeof(line), "f %d//%d %d//%d %d//%d\nf %d//%d %d//%d %d//%d\n", a, a, b, b, c, c, a, a, c, c, d, d);
+			out << line;
+		}
+	}
+}
+
+inline void print_obj_loader_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark obj [options]\n"
+		"  --repeat <n>      measure n times and report the fastest (default 3)\n"
+		"  --input <file>    OBJ file to load, can be given more than once\n"
+		"  --segments <n>    segments of the generated sphere without --input (default 256)\n"
+		"  --quads           generate quads instead of triangles (the regex loader is skipped)\n"
+		"  --skip-regex      do not measure the previous regex loader\n";
+}
+
+// sfalse
+inline bool parse_obj_loader_benchmark_option(int argc, char** argv, ObjLoaderBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		// lȂIvV
+		if (name == "--quads") {
+			option.quads = true;
+			continue;
+		}
+		if (name == "--skip-regex") {
+			option.skipRegex = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--input")
+			option.inputFileNames.push_back(value);
+		else if (name == "--segments")
+			option.segments = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.segments < 4) {
+		std::cerr << "invalid --repeat or --segments\n";
+		return false;
+	}
+
+	return true;
+}
+
+// \łȂ傫̍WA傫΍őlɁA0Ɋۂ߂邩m߂
+inline bool check_obj_out_of_range_numbers()
+{
+	auto const mesh = parse_obj("v 1e400 -1e400 1e-400\nv 0 1 0\nv 0 0 1\nf 1 2 3\n");
+	auto const& position = mesh.vertices.at(mesh.indices.at(0));
+	return position[0] == std::numeric_limits<float>::max() && position[1] == -std::numeric_limits<float>::max() && position[2] == 0.f;
+}
+
+// vĂ珑ôŁAǂ߂Ȃt@CłJSON͉Ȃ
+inline void run_obj_loader_benchmark_file(ObjLoaderBenchmarkOption const& option, std::string const& fileName, bool skipRegex, JsonWriter& json)
+{
+	auto const fileBytes = static_cast<std::uint64_t>(std::filesystem::file_size(fileName));
+
+	ObjMesh mesh{};
+	auto const mmapTime = measure_best(option.repeat, [&] {
+		mesh = load_obj(fileName.c_str());
+	});
+	auto const mmapBytes = mesh.vertices.size() * sizeof(decltype(mesh.vertices)::value_type) + mesh.indices.size() * sizeof(std::uint32_t);
+
+	// ׂ̗͂ɏȂ悤ɈꎞfBNgɃLbV
+	// v̂load_meshƓAnbV̌vZƃLbṼ}bv
+	auto const cacheFileName = (std::filesystem::temp_directory_path() / "practice-bullet-benchmark.meshcache").string();
+	{
+		MappedFile source{ fileName.c_str() };
+		write_mesh_cache(cacheFileName.c_str(), mesh, source.getSize(), hash_mesh_source(source.getView()));
+	}
+	std::size_t cachedIndexNum{};
+	auto const cacheTime = measure_best(option.repeat, [&] {
+		MappedFile source{ fileName.c_str() };
+		auto const cache = open_mesh_cache(cacheFileName.c_str(), source.getSize(), hash_mesh_source(source.getView()));
+		cachedIndexNum = cache ? cache->getIndices().size() : 0;
+	});
+	std::filesystem::remove(cacheFileName);
+
+	std::vector<std::array<float, 6>> vertexData{};
+	double regexTime{};
+	if (!skipRegex)
+	{
+		regexTime = measure_best(option.repeat, [&] {
+			std::ifstream file{ fileName };
+			vertexData = load_obj_regex(file);
+		});
+	}
+	auto const regexBytes = vertexData.size() * sizeof(decltype(vertexData)::value_type);
+
+	json.beginObject();
+	json.value("file", fileName);
+	json.value("file_bytes", fileBytes);
+
+	json.beginObject("mmap");
+	json.value("load_ms", mmapTime * 1e3);
+	json.value("vertices", mesh.vertices.size());
+	json.value("indices", mesh.indices.size());
+	json.value("triangles", mesh.indices.size() / 3);
+	json.value("output_bytes", mmapBytes);
+	json.endObject();
+
+	json.beginObject("cache");
+	json.value("load_ms", cacheTime * 1e3);
+	json.value("valid", cachedIndexNum == mesh.indices.size());
+	json.value("speedup_over_mmap", mmapTime / cacheTime);
+	json.endObject();
+
+	if (!skipRegex)
+	{
+		json.beginObject("regex");
+		json.value("load_ms", regexTime * 1e3);
+		json.value("vertices", vertexData.size());
+		json.value("triangles", vertexData.size() / 3);
+		json.value("output_bytes", regexBytes);
+		json.endObject();
+
+		// Op`̃t@CȂ瓯̎Op`ɂȂ͂
+		json.value("same_triangle_num", vertexData.size() == mesh.indices.size());
+		json.value("speedup", regexTime / mmapTime);
+		json.value("memory_ratio", static_cast<double>(regexBytes) / static_cast<double>(mmapBytes));
+	}
+
+	json.endObject();
+}
+
+inline int run_obj_loader_benchmark(int argc, char** argv)
+{
+	ObjLoaderBenchmarkOption option{};
+	if (!parse_obj_loader_benchmark_option(argc, argv, option)) {
+		print_obj_loader_benchmark_usage();
+		return 1;
+	}
+
+	// ͂Έꎞt@Cɋo
+	std::filesystem::path generatedFileName{};
+	if (option.inputFileNames.empty())
+	{
+		generatedFileName = std::filesystem::temp_directory_path() / "practice-bullet-benchmark-sphere.obj";
+		std::ofstream file{ generatedFileName };
+		write_sphere_obj(file, option.segments, option.quads);
+		option.inputFileNames.push_back(generatedFileName.string());
+	}
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "obj");
+	json.value("repeat", option.repeat);
+	if (!generatedFileName.empty()) {
+		json.value("generated_segments", option.segments);
+		json.value("generated_quads", option.quads);
+	}
+
+	auto const outOfRangeCorrect = check_obj_out_of_range_numbers();
+	json.value("out_of_range_numbers", outOfRangeCorrect);
+	int result = outOfRangeCorrect ? 0 : 1;
+
+	json.beginArray("files");
+	for (auto const& fileName : option.inputFileNames)
+	{
+		try {
+			run_obj_loader_benchmark_file(option, fileName, option.skipRegex || (option.quads && !generatedFileName.empty()), json);
+		}
+		catch (std::exception const& e) {
+			std::cerr << e.what() << "\n";
+			result = 1;
+		}
+	}
+	json.endArray();
+	json.endObject();
+
+	if (!generatedFileName.empty())
+		std::filesystem::remove(generatedFileName);
+
+	return result;
+}
@@ -0,0 +1,316 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/OpenAddressingPairCache.hpp"
+#include"../src/Scene.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cstdlib>
+#include<functional>
+#include<iostream>
+#include<memory>
+#include<random>
+#include<string_view>
+#include<utility>
+#include<vector>
+
+// ɐςݏdȂƂ̂悤ɃyȂLbVŁAbtHashedOverlappingPairCacheOpenAddressingPairCacheׂ
+
+struct PairCacheBenchmarkOption
+{
+	int repeat = 5;
+	std::size_t proxyNum = 20000;
+	// 1̃vLV߂̃vLVƍyA̐
+	std::size_t neighborNum = 16;
+	// churn1t[ɓւyÅ
+	int churnPercent = 10;
+	int frameNum = 20;
+	int threadNum = 0;
+};
+
+inline void print_pair_cache_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark paircache [options]\n"
+		"  --repeat <n>     measure n times and report the fastest (default 5)\n"
+		"  --proxies <n>    number of proxies (default 20000)\n"
+		"  --neighbors <n>  pairs per proxy (default 16)\n"
+		"  --churn <percent> pairs removed and added again per frame (default 10)\n"
+		"  --frames <n>     frames in the churn measurement (default 20)\n"
+		"  --threads <n>    threads for the batched insert (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_pair_cache_benchmark_option(int argc, char** argv, PairCacheBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--proxies")
+			option.proxyNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--neighbors")
+			option.neighborNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--churn")
+			option.churnPercent = std::atoi(value);
+		else if (name == "--frames")
+			option.frameNum = std::atoi(value);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.proxyNum < 2 || option.neighborNum < 1 ||
+		option.churnPercent < 1 || option.churnPercent > 100 || option.frameNum < 1 || option.threadNum < 0) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+enum class PairCacheMode
+{
+	Hashed,
+	// OpenAddressingPairCache1
+	Open,
+	// OpenAddressingPairCacheɂ܂Ƃ߂
+	OpenBatch,
+};
+
+struct PairCacheResult
+{
+	double insertTime{};
+	// 1̒ǉňԒx́A\傫Ƃɏo
+	double maxInsertTime{};
+	double findHitTime{};
+	double findMissTime{};
+	double removeTime{};
+	double churnTime{};
+	int pairNum{};
+	// churňAz̑S̃yAwĂ邩
+	bool consistent = true;
+	std::vector<std::pair<int, int>> pairs{};
+};
+
+inline std::unique_ptr<btOverlappingPairCache> make_pair_cache(PairCacheMode mode)
+{
+	if (mode == PairCacheMode::Hashed)
+		return std::make_unique<btHashedOverlappingPairCache>();
+	return std::make_unique<OpenAddressingPairCache>();
+}
+
+inline void add_pairs(btOverlappingPairCache& cache, PairCacheMode mode, std::span<OpenAddressingPairCache::ProxyPair const> pairs)
+{
+	if (mode == PairCacheMode::OpenBatch)
+		static_cast<OpenAddressingPairCache&>(cache).addOverlappingPairs(pairs);
+	else
+		for (auto const& [proxy0, proxy1] : pairs)
+			cache.addOverlappingPair(proxy0, proxy1);
+}
+
+inline void remove_pairs(btOverlappingPairCache& cache, PairCacheMode mode, std::span<OpenAddressingPairCache::ProxyPair const> pairs)
+{
+	if (mode == PairCacheMode::OpenBatch)
+		static_cast<OpenAddressingPairCache&>(cache).removeOverlappingPairs(pairs, nullptr);
+	else
+		for (auto const& [proxy0, proxy1] : pairs)
+			cache.removeOverlappingPair(proxy0, proxy1, nullptr);
+}
+
+inline PairCacheResult run_pair_cache(PairCacheMode mode, PairCacheBenchmarkOption const& option,
+	std::vector<OpenAddressingPairCache::ProxyPair> const& pairs, std::vector<OpenAddressingPairCache::ProxyPair> const& missPairs)
+{
+	PairCacheResult result{};
+	std::unique_ptr<btOverlappingPairCache> cache{};
+
+	result.insertTime = measure_best(option.repeat, [&] { cache = make_pair_cache(mode); }, [&] {
+		add_pairs(*cache, mode, pairs);
+	});
+
+	// ܂Ƃ߂đƂ1̒ǉȂ̂ŁA1ő
+	if (mode != PairCacheMode::OpenBatch)
+	{
+		cache = make_pair_cache(mode);
+		for (auto const& [proxy0, proxy1] : pairs)
+		{
+			auto const start = std::chrono::steady_clock::now();
+			cache->addOverlappingPair(proxy0, proxy1);
+			auto const end = std::chrono::steady_clock::now();
+			result.maxInsertTime = std::max(result.maxInsertTime, std::chrono::duration<double>(end - start).count());
+		}
+	}
+	result.pairNum = cache->getNumOverlappingPairs();
+
+	std::size_t foundNum = 0;
+	result.findHitTime = measure_best(option.repeat, [&] {
+		for (auto const& [proxy0, proxy1] : pairs)
+			foundNum += cache->findPair(proxy0, proxy1) != nullptr;
+	});
+	result.findMissTime = measure_best(option.repeat, [&] {
+		for (auto const& [proxy0, proxy1] : missPairs)
+			foundNum += cache->findPair(proxy0, proxy1) != nullptr;
+	});
+	if (foundNum != pairs.size() * static_cast<std::size_t>(option.repeat))
+		result.consistent = false;
+
+	result.removeTime = measure_best(option.repeat, [&] {
+		cache = make_pair_cache(mode);
+		add_pairs(*cache, mode, pairs);
+	}, [&] {
+		remove_pairs(*cache, mode, pairs);
+	});
+	if (cache->getNumOverlappingPairs() != 0)
+		result.consistent = false;
+
+	// u[htF[Ŷ悤ɖt[ꕔ̃yAāA܂
+	auto const churnNum = pairs.size() * static_cast<std::size_t>(option.churnPercent) / 100;
+	result.churnTime = measure_best(option.repeat, [&] {
+		cache = make_pair_cache(mode);
+		add_pairs(*cache, mode, pairs);
+	}, [&] {
+		for (int frame = 0; frame < option.frameNum; frame++)
+		{
+			auto const begin = (static_cast<std::size_t>(frame) * churnNum) % (pairs.size() - churnNum + 1);
+			std::span<OpenAddressingPairCache::ProxyPair const> const churn{ pairs.data() + begin, churnNum };
+			remove_pairs(*cache, mode, churn);
+			add_pairs(*cache, mode, churn);
+		}
+	});
+	result.churnTime /= option.frameNum;
+
+	auto const& pairArray = cache->getOverlappingPairArray();
+	for (int i = 0; i < pairArray.size(); i++)
+	{
+		auto const& pair = pairArray[i];
+		if (cache->findPair(pair.m_pProxy0, pair.m_pProxy1) != &pairArray[i])
+			result.consistent = false;
+		result.pairs.push_back({ pair.m_pProxy0->getUid(), pair.m_pProxy1->getUid() });
+	}
+	if (pairArray.size() != result.pairNum)
+		result.consistent = false;
+
+	return result;
+}
+
+inline void write_pair_cache_result(JsonWriter& json, std::string_view key, PairCacheResult const& result, std::size_t pairNum)
+{
+	auto const num = static_cast<double>(pairNum);
+
+	json.beginObject(key);
+	json.value("insert_ns", result.insertTime * 1e9 / num);
+	if (result.maxInsertTime > 0.)
+		json.value("max_insert_us", result.maxInsertTime * 1e6);
+	json.value("find_hit_ns", result.findHitTime * 1e9 / num);
+	json.value("find_miss_ns", result.findMissTime * 1e9 / num);
+	json.value("remove_ns", result.removeTime * 1e9 / num);
+	json.value("churn_frame_us", result.churnTime * 1e6);
+	json.value("pairs", result.pairNum);
+	json.value("consistent", result.consistent);
+	json.endObject();
+}
+
+inline int run_pair_cache_benchmark(int argc, char** argv)
+{
+	PairCacheBenchmarkOption option{};
+	if (!parse_pair_cache_benchmark_option(argc, argv, option)) {
+		print_pair_cache_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the paircache benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+
+	std::vector<btBroadphaseProxy> proxies(option.proxyNum);
+	for (std::size_t i = 0; i < proxies.size(); i++)
+	{
+		proxies[i].m_uniqueId = static_cast<int>(i) + 1;
+		proxies[i].m_collisionFilterGroup = btBroadphaseProxy::DefaultFilter;
+		proxies[i].m_collisionFilterMask = btBroadphaseProxy::AllFilter;
+	}
+
+	// ߂̃vLVǂŃyAAԂ͂΂΂ɂ
+	std::mt19937 engine{ 1 };
+	std::vector<OpenAddressingPairCache::ProxyPair> pairs{};
+	std::vector<OpenAddressingPairCache::ProxyPair> missPairs{};
+	for (std::size_t i = 0; i < proxies.size(); i++)
+	{
+		for (std::size_t n = 0; n < option.neighborNum; n++)
+		{
+			auto const j = (i + 1 + engine() % (option.neighborNum * 4)) % proxies.size();
+			if (i != j)
+				pairs.push_back(engine() % 2 ? std::pair{ &proxies[i], &proxies[j] } : std::pair{ &proxies[j], &proxies[i] });
+		}
+	}
+	std::shuffle(pairs.begin(), pairs.end(), engine);
+
+	// dyAő
+	{
+		OpenAddressingPairCache unique{};
+		for (auto const& [proxy0, proxy1] : pairs)
+			unique.addOverlappingPair(proxy0, proxy1);
+		pairs.clear();
+		for (int i = 0; i < unique.getNumOverlappingPairs(); i++)
+			pairs.push_back({ unique.getOverlappingPairArray()[i].m_pProxy0, unique.getOverlappingPairArray()[i].m_pProxy1 });
+		std::shuffle(pairs.begin(), pairs.end(), engine);
+
+		while (missPairs.size() < pairs.size())
+		{
+			auto& proxy0 = proxies[engine() % proxies.size()];
+			auto& proxy1 = proxies[engine() % proxies.size()];
+			if (&proxy0 != &proxy1 && !unique.findPair(&proxy0, &proxy1))
+				missPairs.push_back({ &proxy0, &proxy1 });
+		}
+	}
+
+	scheduler->setNumThreads(1);
+	auto const hashed = run_pair_cache(PairCacheMode::Hashed, option, pairs, missPairs);
+	auto const open = run_pair_cache(PairCacheMode::Open, option, pairs, missPairs);
+	auto const serialBatch = run_pair_cache(PairCacheMode::OpenBatch, option, pairs, missPairs);
+	scheduler->setNumThreads(threadNum);
+	auto const batch = run_pair_cache(PairCacheMode::OpenBatch, option, pairs, missPairs);
+
+	// ܂Ƃ߂đƂ̏̓XbhɂȂ
+	auto const deterministic = serialBatch.pairs == batch.pairs;
+	auto const correct = deterministic && hashed.consistent && open.consistent && serialBatch.consistent && batch.consistent &&
+		hashed.pairNum == open.pairNum && open.pairNum == batch.pairNum;
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "paircache");
+	json.value("repeat", option.repeat);
+	json.value("proxies", option.proxyNum);
+	json.value("pairs", pairs.size());
+	json.value("churn_percent", option.churnPercent);
+	json.value("threads", threadNum);
+
+	write_pair_cache_result(json, "hashed", hashed, pairs.size());
+	write_pair_cache_result(json, "open", open, pairs.size());
+	write_pair_cache_result(json, "open_batch_1thread", serialBatch, pairs.size());
+	write_pair_cache_result(json, "open_batch", batch, pairs.size());
+
+	json.value("deterministic", deterministic);
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
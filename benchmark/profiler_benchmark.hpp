@@ -0,0 +1,158 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/Profiler.hpp"
+#include<LinearMath/btQuickprof.h>
+#include<cstdlib>
+#include<iostream>
+#include<string_view>
+#include<vector>
+
+// BT_PROFILE1Ԃ̃RXgAvt@ĈƂƗL̂ƂŔׂ
+// ̂ƂBullet̋̊֐|C^ĂԂɂȂĂ͂
+
+struct ProfilerBenchmarkOption
+{
+	int repeat = 10;
+	std::size_t scopeNum = 1000000;
+	// L̂ƂÃXR[vƂcollect
+	std::size_t collectInterval = 4096;
+};
+
+inline void print_profiler_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark profiler [options]\n"
+		"  --repeat <n>     measure n times and report the fastest (default 10)\n"
+		"  --scopes <n>     BT_PROFILE scopes per measurement (default 1000000)\n"
+		"  --collect <n>    collect events every n scopes while enabled (default 4096)\n";
+}
+
+// sfalse
+inline bool parse_profiler_benchmark_option(int argc, char** argv, ProfilerBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--scopes")
+			option.scopeNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--collect")
+			option.collectInterval = std::strtoull(value, nullptr, 10);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.scopeNum < 1 || option.collectInterval < 1 || option.collectInterval >= PROFILER_THREAD_EVENT_NUM) {
+		std::cerr << "invalid --repeat, --scopes or --collect\n";
+		return false;
+	}
+
+	return true;
+}
+
+// CCȂ悤ɂāABT_PROFILÊBullet̊֐Ɠ`ɂ
+#if defined(_MSC_VER)
+__declspec(noinline)
+#else
+__attribute__((noinline))
+#endif
+inline void profiler_benchmark_work(Checksum& checksum, std::size_t i, bool profile)
+{
+	if (profile) {
+		BT_PROFILE("profiler_benchmark_work");
+		checksum.add(i);
+	}
+	else {
+		checksum.add(i);
+	}
+}
+
+inline int run_profiler_benchmark(int argc, char** argv)
+{
+	ProfilerBenchmarkOption option{};
+	if (!parse_profiler_benchmark_option(argc, argv, option)) {
+		print_profiler_benchmark_usage();
+		return 1;
+	}
+
+	auto& profiler = get_profiler();
+	profiler.setThreadName("main");
+	std::vector<ProfileEvent> events{};
+	events.reserve(option.collectInterval);
+
+	Checksum checksum{};
+
+	auto const baselineTime = measure_best(option.repeat, [&] {
+		for (std::size_t i = 0; i < option.scopeNum; i++)
+			profiler_benchmark_work(checksum, i, false);
+	});
+
+	// LɂOɕtĂ֐́AɂƖ߂
+	auto const previousEnterZone = btGetCurrentEnterProfileZoneFunc();
+	auto const previousLeaveZone = btGetCurrentLeaveProfileZoneFunc();
+	profiler.setEnabled(false);
+	auto const disabledTime = measure_best(option.repeat, [&] {
+		for (std::size_t i = 0; i < option.scopeNum; i++)
+			profiler_benchmark_work(checksum, i, true);
+	});
+
+	// collect̎Ԃ܂߂
+	profiler.setEnabled(true);
+	std::size_t collectedNum = 0;
+	auto const enabledTime = measure_best(option.repeat, [&] {
+		for (std::size_t i = 0; i < option.scopeNum; i++)
+		{
+			profiler_benchmark_work(checksum, i, true);
+			if ((i + 1) % option.collectInterval == 0) {
+				events.clear();
+				collectedNum += profiler.collect(events);
+			}
+		}
+		events.clear();
+		collectedNum += profiler.collect(events);
+	});
+	profiler.setEnabled(false);
+
+	auto const droppedNum = profiler.getDroppedEventNum();
+	auto const hooksRestored = btGetCurrentEnterProfileZoneFunc() == previousEnterZone && btGetCurrentLeaveProfileZoneFunc() == previousLeaveZone;
+	auto const correct = droppedNum == 0 && collectedNum == option.scopeNum * static_cast<std::size_t>(option.repeat) && hooksRestored;
+
+	auto const scopeNum = static_cast<double>(option.scopeNum);
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "profiler");
+	json.value("repeat", option.repeat);
+	json.value("scopes", option.scopeNum);
+	json.value("collect_interval", option.collectInterval);
+
+	json.beginObject("ns_per_scope");
+	json.value("baseline", baselineTime * 1e9 / scopeNum);
+	json.value("disabled", disabledTime * 1e9 / scopeNum);
+	json.value("enabled", enabledTime * 1e9 / scopeNum);
+	json.endObject();
+
+	json.value("disabled_overhead_ns", (disabledTime - baselineTime) * 1e9 / scopeNum);
+	json.value("enabled_overhead_ns", (enabledTime - baselineTime) * 1e9 / scopeNum);
+	json.value("dropped_events", droppedNum);
+	json.value("checksum", checksum.value);
+	json.value("hooks_restored", hooksRestored);
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/BatchRayQuery.hpp"
+#include"../src/Scene.hpp"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include<algorithm>
+#include<cstdlib>
+#include<iostream>
+#include<memory>
+#include<random>
+#include<string_view>
+#include<vector>
+
+// ̃V[ɃC𓊂āABatchRayQuerybtCollisionWorld::rayTest1{Ăԕ@ׂ
+// _ɏoZT[̃CƁA΂΂̃C2ʂv
+// ͓IɓĂȂ`̌oHʂ悤ɁAV[ɉ~Ƌ𑫂
+
+struct RayQueryBenchmarkOption
+{
+	int repeat = 10;
+	std::size_t chainNum = 1000;
+	std::size_t warmupStepNum = 60;
+	std::size_t rayNum = 65536;
+	// V[ɑƉ~̐
+	std::size_t extraObjectNum = 200;
+	int threadNum = 0;
+	int grainSize = 16;
+};
+
+inline void print_ray_query_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark raycast [options]\n"
+		"  --repeat <n>      measure n times and report the fastest (default 10)\n"
+		"  --chains <n>      number of chains in the scene (default 1000)\n"
+		"  --warmup <n>      steps before measuring (default 60)\n"
+		"  --rays <n>        number of rays per batch (default 65536)\n"
+		"  --extra <n>       spheres and cylinders added to the scene (default 200)\n"
+		"  --threads <n>     threads for the parallel batch (default all cores)\n"
+		"  --grain <n>       packets per task (default 16)\n";
+}
+
+// sfalse
+inline bool parse_ray_query_benchmark_option(int argc, char** argv, RayQueryBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--chains")
+			option.chainNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--warmup")
+			option.warmupStepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--rays")
+			option.rayNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--extra")
+			option.extraObjectNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else if (name == "--grain")
+			option.grainSize = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.chainNum < 1 || option.rayNum < 1 || option.threadNum < 0 || option.grainSize < 1) {
+		std::cerr << "invalid --repeat, --chains, --rays, --threads or --grain\n";
+		return false;
+	}
+
+	return true;
+}
+
+struct RayQueryComparison
+{
+	// ǂ炩瓖̂ŔׂȂC
+	std::size_t insideNum{};
+	// ႤC
+	std::size_t mismatchNum{};
+	// ɓƂ̃qbgʒű̍ő
+	btScalar maxDistanceError{};
+};
+
+inline RayQueryComparison compare_ray_hits(std::vector<RayQuery> const& queries, std::vector<RayQueryHit> const& expected, std::vector<RayQueryHit> const& actual)
+{
+	RayQueryComparison result{};
+	for (std::size_t i = 0; i < expected.size(); i++)
+	{
+		// 瓖Ƃ̌ʂ́AGJKł̓}[W`̒ǂŕς
+		if (expected[i].hitFraction == btScalar(0.) || actual[i].hitFraction == btScalar(0.)) {
+			result.insideNum++;
+			continue;
+		}
+		if (expected[i].collisionObject != actual[i].collisionObject) {
+			result.mismatchNum++;
+			continue;
+		}
+		auto const length = (queries[i].to - queries[i].from).length();
+		result.maxDistanceError = std::max(result.maxDistanceError, std::abs(expected[i].hitFraction - actual[i].hitFraction) * length);
+	}
+	return result;
+}
+
+// useGjkȂkF_UseGjkConvexCastRaytestœʌ`ɓĂ
+// btSubsimplexConvexCast̓JvZ̕\ʂ傫邱Ƃ̂ŁA킹ɂ͂g
+inline void bullet_ray_test(btCollisionWorld* world, std::vector<RayQuery> const& queries, std::vector<RayQueryHit>& hits, bool useGjk)
+{
+	for (std::size_t i = 0; i < queries.size(); i++)
+	{
+		btCollisionWorld::ClosestRayResultCallback callback{ queries[i].from, queries[i].to };
+		if (useGjk)
+			callback.m_flags |= btTriangleRaycastCallback::kF_UseGjkConvexCastRaytest;
+		callback.m_collisionFilterGroup = queries[i].collisionFilterGroup;
+		callback.m_collisionFilterMask = queries[i].collisionFilterMask;
+		world->rayTest(queries[i].from, queries[i].to, callback);
+		hits[i] = RayQueryHit{ callback.m_collisionObject, callback.m_closestHitFraction, callback.m_hitNormalWorld, callback.m_hitPointWorld };
+	}
+}
+
+inline int run_ray_query_benchmark(int argc, char** argv)
+{
+	RayQueryBenchmarkOption option{};
+	if (!parse_ray_query_benchmark_option(argc, argv, option)) {
+		print_ray_query_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the raycast benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+
+	Scene scene{ { .chainNum = option.chainNum } };
+	auto const world = scene.getDynamicsWorld();
+	for (std::size_t i = 0; i < option.warmupStepNum; i++)
+		world->stepSimulation(btScalar(1.) / 60, 1, btScalar(1.) / 60);
+
+	// ͈̂
+	btVector3 boundsMin{ BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT };
+	btVector3 boundsMax{ -BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT };
+	for (std::size_t i = 0; i < scene.getChainNum(); i++)
+	{
+		auto const& chain = scene.getChain(i);
+		for (auto const body : { chain.fixBox, chain.body1, chain.body2, chain.body3 })
+		{
+			boundsMin.setMin(body->getWorldTransform().getOrigin());
+			boundsMax.setMax(body->getWorldTransform().getOrigin());
+		}
+	}
+	boundsMin -= btVector3(5, 5, 5);
+	boundsMax += btVector3(5, 5, 5);
+
+	std::mt19937 engine{ 1 };
+	auto const randomPoint = [&] {
+		std::uniform_real_distribution<btScalar> x{ boundsMin.x(), boundsMax.x() };
+		std::uniform_real_distribution<btScalar> y{ boundsMin.y(), boundsMax.y() };
+		std::uniform_real_distribution<btScalar> z{ boundsMin.z(), boundsMax.z() };
+		return btVector3(x(engine), y(engine), z(engine));
+	};
+
+	// ̊ԂɕA͋Ŏc͉~
+	btSphereShape sphereShape{ btScalar(1.5) };
+	btCylinderShape cylinderShape{ btVector3(1, 2, 1) };
+	std::vector<std::unique_ptr<btCollisionObject>> extraObjects{};
+	for (std::size_t i = 0; i < option.extraObjectNum; i++)
+	{
+		auto& object = extraObjects.emplace_back(std::make_unique<btCollisionObject>());
+		object->setCollisionShape(i % 2 ? static_cast<btCollisionShape*>(&cylinderShape) : &sphereShape);
+		object->getWorldTransform().setOrigin(randomPoint());
+		world->addCollisionObject(object.get());
+	}
+	world->updateAabbs();
+
+	// ZT[8{_~ɁA50
+	std::vector<RayQuery> sensorRays(option.rayNum);
+	for (std::size_t i = 0; i < sensorRays.size(); i += RayPacket::PACKET_SIZE)
+	{
+		auto const from = randomPoint();
+		auto const forward = (randomPoint() - from).safeNormalize();
+		for (std::size_t j = i; j < std::min(i + RayPacket::PACKET_SIZE, sensorRays.size()); j++)
+		{
+			std::uniform_real_distribution<btScalar> spread{ -0.2, 0.2 };
+			auto const dir = (forward + btVector3(spread(engine), spread(engine), spread(engine))).safeNormalize();
+			sensorRays[j] = { from, from + dir * 50 };
+		}
+	}
+
+	std::vector<RayQuery> randomRays(option.rayNum);
+	for (auto& ray : randomRays)
+		ray = { randomPoint(), randomPoint() };
+
+	BatchRayQuery query{ world };
+	query.setGrainSize(option.grainSize);
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "raycast");
+	json.value("repeat", option.repeat);
+	json.value("chains", option.chainNum);
+	json.value("collision_objects", world->getNumCollisionObjects());
+	json.value("rays", option.rayNum);
+	json.value("threads", threadNum);
+
+	bool correct = true;
+	for (auto const& [name, rays] : { std::pair{ "sensor", &sensorRays }, std::pair{ "random", &randomRays } })
+	{
+		std::vector<RayQueryHit> bulletHits(rays->size());
+		std::vector<RayQueryHit> gjkHits(rays->size());
+		std::vector<RayQueryHit> serialHits(rays->size());
+		std::vector<RayQueryHit> parallelHits(rays->size());
+
+		auto const bulletTime = measure_best(option.repeat, [&] { bullet_ray_test(world, *rays, bulletHits, false); });
+		auto const gjkTime = measure_best(option.repeat, [&] { bullet_ray_test(world, *rays, gjkHits, true); });
+		scheduler->setNumThreads(1);
+		auto const serialTime = measure_best(option.repeat, [&] { query.rayTest(*rays, serialHits); });
+		scheduler->setNumThreads(threadNum);
+		auto const parallelTime = measure_best(option.repeat, [&] { query.rayTest(*rays, parallelHits); });
+
+		auto const hitNum = std::count_if(gjkHits.begin(), gjkHits.end(), [](auto const& hit) { return hit.collisionObject != nullptr; });
+		auto const comparison = compare_ray_hits(*rays, gjkHits, serialHits);
+		auto const deterministic = compare_ray_hits(*rays, serialHits, parallelHits).mismatchNum == 0;
+		// GJK͂ӂ߂郌C\ʂ1e-3炢OłĂAȂJvZɓɓ郌Cւ邱Ƃ
+		// ̕ӂGJKł̓}[W̕ۂȂA΂߂ɓقǈʒu
+		auto const consistent = comparison.mismatchNum * 200 <= rays->size() && comparison.maxDistanceError < btScalar(0.5);
+		correct = correct && consistent && deterministic;
+
+		auto const rayNum = static_cast<double>(rays->size());
+		json.beginObject(name);
+		json.value("hits", hitNum);
+		json.value("bullet_ns", bulletTime * 1e9 / rayNum);
+		json.value("bullet_gjk_ns", gjkTime * 1e9 / rayNum);
+		json.value("batch_1thread_ns", serialTime * 1e9 / rayNum);
+		json.value("batch_ns", parallelTime * 1e9 / rayNum);
+		json.value("speedup_1thread", bulletTime / serialTime);
+		json.value("speedup", bulletTime / parallelTime);
+		json.value("started_inside", comparison.insideNum);
+		json.value("mismatches", comparison.mismatchNum);
+		json.value("max_distance_error", comparison.maxDistanceError);
+		json.value("deterministic", deterministic);
+		json.endObject();
+	}
+
+	json.value("correct", correct);
+	json.endObject();
+
+	for (auto& object : extraObjects)
+		world->removeCollisionObject(object.get());
+
+	return correct ? 0 : 1;
+}
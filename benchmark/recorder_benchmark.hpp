@@ -0,0 +1,303 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"snapshot_benchmark.hpp"
+#include"../src/Scene.hpp"
+#include"../src/SimulationRecorder.hpp"
+#include"../src/WorldSnapshot.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cstdlib>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<random>
+#include<stdexcept>
+#include<string>
+#include<string_view>
+#include<vector>
+
+// SimulationRecorderŋL^Ȃi߂ƂɁAL^ȂƂXebvǂꂾxȂ邩𑪂
+// t[ׂ邽߂ɁAWorldSnapshotterŋL^n߂t[ɖ߂ĂL^Ȃi߂
+// L^t@CĐāADȃt[ւ̃V[N̎ԂƁAL^Ƃ̏Ԃƈv邩ׂ
+
+struct RecorderBenchmarkOption
+{
+	// 1Ń{fB4Ȃ̂ŁA1
+	std::size_t chainNum = 2500;
+	btScalar chainSpacing = 6.;
+	std::size_t warmupStepNum = 60;
+	std::size_t stepNum = 300;
+	SimulationRecorderConfig recorder{};
+	std::size_t seekNum = 200;
+	std::string fileName{};
+};
+
+inline void print_recorder_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark recorder [options]\n"
+		"  --chains <n>             number of chains, 4 bodies each (default 2500)\n"
+		"  --spacing <m>            distance between chains (default 6)\n"
+		"  --warmup <n>             steps before recording (default 60)\n"
+		"  --steps <n>              recorded steps (default 300)\n"
+		"  --keyframe <n>           steps between keyframes (default 60)\n"
+		"  --queue <n>              frames handed to the writer thread before dropping (default 8)\n"
+		"  --batch <n>              captured bodies that wake the writer thread (default 16384)\n"
+		"  --seeks <n>              random seeks in the replay (default 200)\n"
+		"  --file <path>            recording file (default: a file in the temp directory, removed afterwards)\n";
+}
+
+// sfalse
+inline bool parse_recorder_benchmark_option(int argc, char** argv, RecorderBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--chains")
+			option.chainNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--spacing")
+			option.chainSpacing = static_cast<btScalar>(std::atof(value));
+		else if (name == "--warmup")
+			option.warmupStepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--keyframe")
+			option.recorder.keyframeInterval = static_cast<std::uint32_t>(std::strtoul(value, nullptr, 10));
+		else if (name == "--queue")
+			option.recorder.queueCapacity = std::strtoull(value, nullptr, 10);
+		else if (name == "--batch")
+			option.recorder.writeBatchBodyNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--seeks")
+			option.seekNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--file")
+			option.fileName = value;
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.chainNum < 1 || !(option.chainSpacing > 0) || option.stepNum < 1 || option.recorder.keyframeInterval < 1 || option.recorder.queueCapacity < 1) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+inline int run_recorder_benchmark(int argc, char** argv)
+{
+	RecorderBenchmarkOption option{};
+	if (!parse_recorder_benchmark_option(argc, argv, option)) {
+		print_recorder_benchmark_usage();
+		return 1;
+	}
+
+	auto const removeFile = option.fileName.empty();
+	auto const fileName = removeFile ? (std::filesystem::temp_directory_path() / "practice-bullet-benchmark.pbrec").string() : option.fileName;
+
+	Scene scene{ {
+		.chainNum = option.chainNum,
+		.chainSpacing = option.chainSpacing,
+	} };
+	auto const world = scene.getDynamicsWorld();
+
+	std::size_t frame = 0;
+	auto const step = [&] {
+		drive_fix_boxes(scene, frame);
+		world->stepSimulation(btScalar(1. / 60.), 0);
+		frame++;
+	};
+	for (std::size_t i = 0; i < option.warmupStepNum; i++)
+		step();
+
+	WorldSnapshotter snapshotter{ world };
+	WorldSnapshot snapshot{};
+	if (!snapshotter.capture(snapshot)) {
+		std::cerr << "the scene cannot be captured\n";
+		return 1;
+	}
+	auto const startFrame = frame;
+
+	// L^Ȃ
+	auto const baselineStart = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < option.stepNum; i++)
+		step();
+	auto const baselineTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - baselineStart).count();
+
+	// t[L^Ȃi߂
+	snapshotter.restore(snapshot);
+	frame = startFrame;
+
+	// ׂ邽߂ɁÂĂȂt[̏ԂĂ
+	struct Reference
+	{
+		std::uint64_t frame{};
+		std::vector<RecordedBodyState> states{};
+	};
+	std::vector<Reference> references{};
+	auto const referenceInterval = std::max<std::size_t>(option.stepNum / 8, 1);
+
+	double recordCallTime{};
+	double recordedTime{};
+	double closeTime{};
+	SimulationRecorderCounter counter{};
+	auto closed = false;
+	{
+		SimulationRecorder recorder{ world, fileName.c_str(), option.recorder };
+
+		auto const recordedStart = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < option.stepNum; i++)
+		{
+			step();
+
+			auto const recordStart = std::chrono::steady_clock::now();
+			auto const recorded = recorder.record();
+			recordCallTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - recordStart).count();
+
+			if (recorded && (i % referenceInterval == 0 || i + 1 == option.stepNum))
+			{
+				auto& reference = references.emplace_back(Reference{ .frame = i });
+				auto const& objects = world->getCollisionObjectArray();
+				for (int j = 0; j < objects.size(); j++)
+				{
+					if (auto const body = btRigidBody::upcast(objects[j]))
+						reference.states.push_back(make_recorded_body_state(body));
+				}
+			}
+		}
+		recordedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - recordedStart).count();
+
+		auto const closeStart = std::chrono::steady_clock::now();
+		closed = recorder.close();
+		closeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - closeStart).count();
+		counter = recorder.getCounter();
+	}
+
+	SimulationReplay replay{ fileName.c_str() };
+	auto correct = closed && replay.isComplete() && replay.getFrameNum() == option.stepNum;
+
+	// 납߂悤ɃV[NāAL[t[ǂ݂Ȃʂ
+	for (auto it = references.rbegin(); it != references.rend(); ++it)
+	{
+		correct = correct && replay.seek(it->frame) && replay.getStates().size() == it->states.size() &&
+			std::memcmp(replay.getStates().data(), it->states.data(), it->states.size() * sizeof(RecordedBodyState)) == 0;
+	}
+
+	std::mt19937_64 random{ 1 };
+	std::uniform_int_distribution<std::uint64_t> distribution{ 0, replay.getFrameNum() - 1 };
+	double seekTime{};
+	double maxSeekTime{};
+	for (std::size_t i = 0; i < option.seekNum; i++)
+	{
+		auto const target = distribution(random);
+		auto const start = std::chrono::steady_clock::now();
+		correct = replay.seek(target) && correct;
+		auto const time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		seekTime += time;
+		maxSeekTime = std::max(maxSeekTime, time);
+	}
+
+	// ̃t[֐i߂̂1ubNǂނ
+	replay.seek(0);
+	auto const sequentialStart = std::chrono::steady_clock::now();
+	for (std::uint64_t f = 1; f < replay.getFrameNum(); f++)
+		correct = replay.seek(f) && correct;
+	auto const sequentialTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - sequentialStart).count();
+
+	std::array<std::vector<std::array<float, 16>>, RENDER_SHAPE_TYPE_NUM> transforms{};
+	std::array<std::vector<std::array<float, 3>>, RENDER_SHAPE_TYPE_NUM> colors{};
+	for (auto type : { RenderShapeType::Box, RenderShapeType::Sphere, RenderShapeType::Capsule })
+	{
+		auto const i = static_cast<std::size_t>(type);
+		transforms[i].resize(replay.getInstanceNum(type));
+		colors[i].resize(replay.getInstanceNum(type));
+		replay.setOutput(type, { transforms[i].data(), colors[i].data(), transforms[i].size() });
+	}
+	std::size_t extractedNum{};
+	auto const extractTime = measure_best(5, [&] { extractedNum = replay.extract(); });
+
+	auto const fileSize = std::filesystem::file_size(fileName);
+
+	// Ō̃t[̍t@C̊OɌʂ͊JȂ
+	auto brokenIndexRejected = false;
+	{
+		auto const brokenFileName = fileName + ".broken";
+		std::filesystem::copy_file(fileName, brokenFileName, std::filesystem::copy_options::overwrite_existing);
+		{
+			std::fstream broken{ brokenFileName, std::ios::in | std::ios::out | std::ios::binary };
+			RecordingFooter footer{};
+			broken.seekg(-static_cast<std::streamoff>(sizeof(RecordingFooter)), std::ios::end);
+			broken.read(reinterpret_cast<char*>(&footer), sizeof(footer));
+			auto const entryOffset = static_cast<std::streamoff>(footer.indexOffset + (footer.frameNum - 1) * sizeof(RecordingIndexEntry));
+			RecordingIndexEntry entry{};
+			broken.seekg(entryOffset);
+			broken.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+			entry.offset = fileSize;
+			broken.seekp(entryOffset);
+			broken.write(reinterpret_cast<char const*>(&entry), sizeof(entry));
+		}
+		try {
+			SimulationReplay const brokenReplay{ brokenFileName.c_str() };
+		}
+		catch (std::runtime_error const&) {
+			brokenIndexRejected = true;
+		}
+		std::filesystem::remove(brokenFileName);
+	}
+	correct = correct && brokenIndexRejected;
+
+	if (removeFile)
+		std::filesystem::remove(fileName);
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "recorder");
+	json.value("bodies", replay.getBodyNum());
+	json.value("steps", option.stepNum);
+	json.value("keyframe_interval", option.recorder.keyframeInterval);
+	json.value("queue_capacity", option.recorder.queueCapacity);
+	json.value("write_batch_bodies", option.recorder.writeBatchBodyNum);
+
+	json.beginObject("ms");
+	json.value("step", baselineTime * 1e3 / static_cast<double>(option.stepNum));
+	json.value("step_recorded", recordedTime * 1e3 / static_cast<double>(option.stepNum));
+	json.value("record_call", recordCallTime * 1e3 / static_cast<double>(option.stepNum));
+	json.value("close", closeTime * 1e3);
+	json.value("seek_mean", seekTime * 1e3 / static_cast<double>(std::max<std::size_t>(option.seekNum, 1)));
+	json.value("seek_max", maxSeekTime * 1e3);
+	json.value("seek_next_frame", sequentialTime * 1e3 / static_cast<double>(std::max<std::uint64_t>(replay.getFrameNum() - 1, 1)));
+	json.value("extract", extractTime * 1e3);
+	json.endObject();
+
+	// recorďĂяoƁA݃XbhƎ荇܂߂S
+	json.value("record_call_percent", recordCallTime / baselineTime * 100.);
+	json.value("overhead_percent", (recordedTime - baselineTime) / baselineTime * 100.);
+
+	json.value("file_bytes", fileSize);
+	json.value("bytes_per_frame", static_cast<double>(fileSize) / static_cast<double>(option.stepNum));
+	json.value("keyframe_bytes", replay.getBodyNum() * sizeof(RecordedBodyState));
+	json.value("captured_bodies_per_frame", static_cast<double>(counter.capturedBodyNum) / static_cast<double>(option.stepNum));
+	json.value("keyframes", counter.keyframeNum);
+	json.value("dropped_frames", counter.droppedFrameNum);
+	json.value("write_batches", counter.writeBatchNum);
+	json.value("extracted_instances", extractedNum);
+	json.value("broken_index_rejected", brokenIndexRejected);
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,409 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btPointCollector.h"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+#include"../external/bullet3/src/LinearMath/btCpuFeatureUtility.h"
+#include<cstdlib>
+#include<cstring>
+#include<iostream>
+#include<random>
+#include<string_view>
+
+// xNgZAGJKAS\o1s̏xv
+// XJ[SIMD̔rPRACTICE_BULLET_SIMDς2̃rhœR}hsčs
+
+struct SimdBenchmarkOption
+{
+	int repeat = 5;
+	int iterations = 100;
+
+	std::size_t vectorNum = 4096;
+	std::size_t gjkPairNum = 1024;
+	std::size_t solverBodyNum = 256;
+	std::size_t solverRowNum = 8192;
+};
+
+inline void print_simd_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark simd [options]\n"
+		"  --repeat <n>        measure n times and report the fastest (default 5)\n"
+		"  --iterations <n>    passes over the data per measurement (default 100)\n"
+		"  --vectors <n>       number of vectors for the vector math (default 4096)\n"
+		"  --gjk-pairs <n>     number of shape pairs for GJK (default 1024)\n"
+		"  --solver-bodies <n> number of solver bodies (default 256)\n"
+		"  --solver-rows <n>   number of constraint rows (default 8192)\n";
+}
+
+// sfalse
+inline bool parse_simd_benchmark_option(int argc, char** argv, SimdBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--iterations")
+			option.iterations = std::atoi(value);
+		else if (name == "--vectors")
+			option.vectorNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--gjk-pairs")
+			option.gjkPairNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--solver-bodies")
+			option.solverBodyNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--solver-rows")
+			option.solverRowNum = std::strtoull(value, nullptr, 10);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.iterations < 1 || option.vectorNum < 1 || option.gjkPairNum < 1 ||
+		option.solverBodyNum < 2 || option.solverRowNum < 1) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+inline btVector3 random_vector(std::mt19937& engine, btScalar range)
+{
+	std::uniform_real_distribution<double> dist{ -range, range };
+	return btVector3(btScalar(dist(engine)), btScalar(dist(engine)), btScalar(dist(engine)));
+}
+
+inline btQuaternion random_rotation(std::mt19937& engine)
+{
+	std::normal_distribution<double> dist{};
+	btQuaternion q(btScalar(dist(engine)), btScalar(dist(engine)), btScalar(dist(engine)), btScalar(dist(engine)));
+	return q.normalize();
+}
+
+// rh̐ݒƎsĂCPŰ@\
+inline void write_simd_build_info(JsonWriter& json)
+{
+	json.beginObject("build");
+	json.value("precision", sizeof(btScalar) == sizeof(double) ? "double" : "float");
+#ifdef BT_USE_SSE
+	json.value("bt_use_sse", true);
+#else
+	json.value("bt_use_sse", false);
+#endif
+#ifdef BT_ALLOW_SSE4
+	json.value("bt_allow_sse4", true);
+#else
+	json.value("bt_allow_sse4", false);
+#endif
+#if defined(__AVX2__)
+	json.value("compiled_isa", "AVX2");
+#elif defined(__SSE4_1__)
+	json.value("compiled_isa", "SSE4.1");
+#elif defined(__SSE2__) || defined(_M_X64)
+	json.value("compiled_isa", "SSE2");
+#else
+	json.value("compiled_isa", "none");
+#endif
+	json.endObject();
+
+	auto const features = btCpuFeatureUtility::getCpuFeatures();
+	json.beginObject("cpu_features");
+	json.value("sse4_1", (features & btCpuFeatureUtility::CPU_FEATURE_SSE4_1) != 0);
+	json.value("fma3", (features & btCpuFeatureUtility::CPU_FEATURE_FMA3) != 0);
+	json.value("avx2", (features & btCpuFeatureUtility::CPU_FEATURE_AVX2) != 0);
+	json.endObject();
+}
+
+inline void run_vector_math_benchmark(SimdBenchmarkOption const& option, JsonWriter& json, Checksum& checksum)
+{
+	std::mt19937 engine{ 1 };
+
+	auto const n = static_cast<int>(option.vectorNum);
+	btAlignedObjectArray<btVector3> a{}, b{}, c{};
+	btAlignedObjectArray<btQuaternion> q{};
+	btAlignedObjectArray<btTransform> t{};
+	btAlignedObjectArray<btMatrix3x3> m{};
+	a.resize(n, btVector3(0, 0, 0));
+	b.resize(n, btVector3(0, 0, 0));
+	c.resize(n, btVector3(0, 0, 0));
+	q.resize(n, btQuaternion::getIdentity());
+	t.resize(n, btTransform::getIdentity());
+	m.resize(n, btMatrix3x3::getIdentity());
+	for (int i = 0; i < n; i++)
+	{
+		a[i] = random_vector(engine, 1.);
+		b[i] = random_vector(engine, 1.);
+		q[i] = random_rotation(engine);
+		t[i] = btTransform{ q[i], random_vector(engine, 10.) };
+		m[i] = t[i].getBasis();
+	}
+
+	auto const opNum = static_cast<double>(n) * option.iterations;
+
+	json.beginObject("vector_math_ns_per_op");
+
+	auto measure = [&](char const* name, auto&& f) {
+		auto const time = measure_best(option.repeat, [&] {
+			for (int it = 0; it < option.iterations; it++)
+				f();
+		});
+		json.value(name, time / opNum * 1e9);
+		for (int i = 0; i < n; i++)
+			checksum.add(c[i].x() + c[i].y() + c[i].z());
+	};
+
+	btScalar dotSum{};
+	measure("dot", [&] {
+		for (int i = 0; i < n; i++)
+			dotSum += a[i].dot(b[i]);
+	});
+	checksum.add(dotSum);
+
+	measure("cross", [&] {
+		for (int i = 0; i < n; i++)
+			c[i] = a[i].cross(b[i]);
+	});
+
+	measure("normalize", [&] {
+		for (int i = 0; i < n; i++)
+			c[i] = (a[i] + b[i]).normalized();
+	});
+
+	measure("quat_rotate", [&] {
+		for (int i = 0; i < n; i++)
+			c[i] = quatRotate(q[i], a[i]);
+	});
+
+	measure("transform", [&] {
+		for (int i = 0; i < n; i++)
+			c[i] = t[i] * a[i];
+	});
+
+	measure("matrix_multiply", [&] {
+		for (int i = 0; i < n; i++)
+			c[i] = (m[i] * m[(i + 1) % n])[0];
+	});
+
+	json.endObject();
+}
+
+inline void run_gjk_benchmark(SimdBenchmarkOption const& option, JsonWriter& json, Checksum& checksum)
+{
+	std::mt19937 engine{ 2 };
+
+	btBoxShape box{ btVector3(1., 1., 1.) };
+	btCapsuleShape capsule{ 0.5, 1. };
+
+	btConvexHullShape hull{};
+	for (int i = 0; i < 32; i++)
+		hull.addPoint(random_vector(engine, 1.), false);
+	hull.recalcLocalAabb();
+
+	// 炢dȂ͈͂ɒu
+	auto const n = static_cast<int>(option.gjkPairNum);
+	btAlignedObjectArray<btTransform> transformA{}, transformB{};
+	transformA.resize(n);
+	transformB.resize(n);
+	for (int i = 0; i < n; i++)
+	{
+		transformA[i] = btTransform{ random_rotation(engine), random_vector(engine, 1.5) };
+		transformB[i] = btTransform{ random_rotation(engine), random_vector(engine, 1.5) };
+	}
+
+	auto const queryNum = static_cast<double>(n) * option.iterations;
+
+	json.beginObject("gjk_ns_per_query");
+
+	auto measure = [&](char const* name, btConvexShape const* shapeA, btConvexShape const* shapeB) {
+		btVoronoiSimplexSolver simplexSolver{};
+		btGjkEpaPenetrationDepthSolver penetrationSolver{};
+		btGjkPairDetector detector{ shapeA, shapeB, &simplexSolver, &penetrationSolver };
+
+		btScalar distanceSum{};
+		auto const time = measure_best(option.repeat, [&] {
+			for (int it = 0; it < option.iterations; it++)
+			{
+				for (int i = 0; i < n; i++)
+				{
+					btGjkPairDetector::ClosestPointInput input{};
+					input.m_transformA = transformA[i];
+					input.m_transformB = transformB[i];
+
+					btPointCollector result{};
+					detector.getClosestPoints(input, result, nullptr);
+					distanceSum += result.m_distance;
+				}
+			}
+		});
+
+		json.value(name, time / queryNum * 1e9);
+		checksum.add(distanceSum);
+	};
+
+	measure("box_capsule", &box, &capsule);
+	measure("hull_hull", &hull, &hull);
+
+	json.endObject();
+}
+
+inline void run_solver_row_benchmark(SimdBenchmarkOption const& option, JsonWriter& json, Checksum& checksum)
+{
+	std::mt19937 engine{ 3 };
+	std::uniform_real_distribution<double> unit{ 0., 1. };
+
+	auto const bodyNum = static_cast<int>(option.solverBodyNum);
+	auto const rowNum = static_cast<int>(option.solverRowNum);
+
+	// btSolverBody͊̃RXgN^ŏȂ̂ŁA0Ŗ߂̂n
+	btSolverBody zeroBody;
+	std::memset(static_cast<void*>(&zeroBody), 0, sizeof(zeroBody));
+	btAlignedObjectArray<btSolverBody> bodies{};
+	bodies.resize(bodyNum, zeroBody);
+	for (int i = 0; i < bodyNum; i++)
+	{
+		auto& body = bodies[i];
+		body.m_worldTransform.setIdentity();
+		body.m_angularFactor.setValue(1., 1., 1.);
+		body.m_linearFactor.setValue(1., 1., 1.);
+		auto const invMass = btScalar(0.5 + unit(engine));
+		body.m_invMass.setValue(invMass, invMass, invMass);
+		body.m_deltaLinearVelocity.setZero();
+		body.m_deltaAngularVelocity.setZero();
+		body.m_pushVelocity.setZero();
+		body.m_turnVelocity.setZero();
+		body.m_linearVelocity.setZero();
+		body.m_angularVelocity.setZero();
+		body.m_externalForceImpulse.setZero();
+		body.m_externalTorqueImpulse.setZero();
+		body.m_originalBody = nullptr;
+	}
+
+	// ڐGƖC𔼕Ae\̋t͒PʍsƂ݂Ȃ
+	btAlignedObjectArray<btSolverConstraint> rows{};
+	rows.resize(rowNum);
+	for (int i = 0; i < rowNum; i++)
+	{
+		auto& row = rows[i];
+		row.m_solverBodyIdA = static_cast<int>(engine() % bodyNum);
+		row.m_solverBodyIdB = (row.m_solverBodyIdA + 1 + static_cast<int>(engine() % (bodyNum - 1))) % bodyNum;
+
+		auto const normal = random_vector(engine, 1.).normalized();
+		row.m_contactNormal1 = normal;
+		row.m_contactNormal2 = -normal;
+		row.m_relpos1CrossNormal = random_vector(engine, 1.).cross(normal);
+		row.m_relpos2CrossNormal = random_vector(engine, 1.).cross(-normal);
+		row.m_angularComponentA = row.m_relpos1CrossNormal;
+		row.m_angularComponentB = row.m_relpos2CrossNormal;
+
+		auto const& bodyA = bodies[row.m_solverBodyIdA];
+		auto const& bodyB = bodies[row.m_solverBodyIdB];
+		row.m_jacDiagABInv = btScalar(1.) / (bodyA.m_invMass.x() + bodyB.m_invMass.x() +
+			row.m_relpos1CrossNormal.length2() + row.m_relpos2CrossNormal.length2());
+
+		row.m_rhs = btScalar(unit(engine));
+		row.m_cfm = 0.;
+		row.m_friction = 0.5;
+		if (i % 2 == 0) {
+			row.m_lowerLimit = 0.;
+			row.m_upperLimit = 1e10;
+		}
+		else {
+			row.m_lowerLimit = -row.m_friction;
+			row.m_upperLimit = row.m_friction;
+		}
+	}
+
+	auto reset = [&] {
+		for (int i = 0; i < bodyNum; i++) {
+			bodies[i].m_deltaLinearVelocity.setZero();
+			bodies[i].m_deltaAngularVelocity.setZero();
+		}
+		for (int i = 0; i < rowNum; i++)
+			rows[i].m_appliedImpulse = 0.;
+	};
+
+	auto const solveNum = static_cast<double>(rowNum) * option.iterations;
+
+	auto measure = [&](char const* name, btSingleConstraintRowSolver rowSolver) {
+		btScalar impulseSum{};
+		auto const time = measure_best(option.repeat, reset, [&] {
+			for (int it = 0; it < option.iterations; it++)
+				for (int i = 0; i < rowNum; i++)
+					impulseSum += rowSolver(bodies[rows[i].m_solverBodyIdA], bodies[rows[i].m_solverBodyIdB], rows[i]);
+		});
+
+		json.value(name, time / solveNum * 1e9);
+		checksum.add(impulseSum);
+	};
+
+	btSequentialImpulseConstraintSolver solver{};
+	auto const features = btCpuFeatureUtility::getCpuFeatures();
+	(void)features;
+
+	json.beginObject("solver_row_ns_per_row");
+
+	json.beginObject("generic");
+	measure("scalar", solver.getScalarConstraintRowSolverGeneric());
+#ifdef USE_SIMD
+	measure("sse2", solver.getSSE2ConstraintRowSolverGeneric());
+#ifdef BT_ALLOW_SSE4
+	if ((features & btCpuFeatureUtility::CPU_FEATURE_SSE4_1) && (features & btCpuFeatureUtility::CPU_FEATURE_FMA3))
+		measure("sse4_1_fma3", solver.getSSE4_1ConstraintRowSolverGeneric());
+#endif
+#endif
+	json.endObject();
+
+	json.beginObject("lower_limit");
+	measure("scalar", solver.getScalarConstraintRowSolverLowerLimit());
+#ifdef USE_SIMD
+	measure("sse2", solver.getSSE2ConstraintRowSolverLowerLimit());
+#ifdef BT_ALLOW_SSE4
+	if ((features & btCpuFeatureUtility::CPU_FEATURE_SSE4_1) && (features & btCpuFeatureUtility::CPU_FEATURE_FMA3))
+		measure("sse4_1_fma3", solver.getSSE4_1ConstraintRowSolverLowerLimit());
+#endif
+#endif
+	json.endObject();
+
+	json.endObject();
+}
+
+inline int run_simd_benchmark(int argc, char** argv)
+{
+	SimdBenchmarkOption option{};
+	if (!parse_simd_benchmark_option(argc, argv, option)) {
+		print_simd_benchmark_usage();
+		return 1;
+	}
+
+	Checksum checksum{};
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "simd");
+	write_simd_build_info(json);
+	json.value("repeat", option.repeat);
+	json.value("iterations", option.iterations);
+
+	run_vector_math_benchmark(option, json, checksum);
+	run_gjk_benchmark(option, json, checksum);
+	run_solver_row_benchmark(option, json, checksum);
+
+	json.value("checksum", checksum.value);
+	json.endObject();
+
+	return 0;
+}
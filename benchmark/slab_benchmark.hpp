@@ -0,0 +1,417 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/Scene.hpp"
+#include"../src/SlabAllocator.hpp"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+#include<cstdlib>
+#include<iostream>
+#include<limits>
+#include<memory>
+#include<string_view>
+#include<type_traits>
+#include<vector>
+
+// btDefaultCollisionConfiguration4096̃v[btAlignedAllocւ̃tH[obNASlabAllocatorƔׂ
+// churn͓傫̊mۂƉSXbhŌJԂApile̓v[Ɏ܂Ȃ̔ς񂾃[hi߂
+// q[vĂ񂾉񐔂btAlignedAllocSetCustomŐ
+
+struct SlabBenchmarkOption
+{
+	int repeat = 3;
+	// churnŐĂvf̐ƁA1̌vł̉Ɗmۂ̑g̐
+	std::size_t liveNum = 16384;
+	std::size_t operationNum = 1 << 20;
+	// pile̔cƍɕׂ鐔
+	std::size_t pileSide = 48;
+	std::size_t pileHeight = 3;
+	std::size_t stepNum = 120;
+	int threadNum = 0;
+};
+
+inline void print_slab_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark slab [options]\n"
+		"  --repeat <n>      run n times and report the fastest (default 3)\n"
+		"  --live <n>        live elements in the churn test (default 16384)\n"
+		"  --operations <n>  free and allocate pairs per churn run (default 1048576)\n"
+		"  --side <n>        boxes per side of the pile (default 48)\n"
+		"  --height <n>      layers of the pile (default 3)\n"
+		"  --steps <n>       steps per pile simulation (default 120)\n"
+		"  --threads <n>     threads (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_slab_benchmark_option(int argc, char** argv, SlabBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--live")
+			option.liveNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--operations")
+			option.operationNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--side")
+			option.pileSide = std::strtoull(value, nullptr, 10);
+		else if (name == "--height")
+			option.pileHeight = std::strtoull(value, nullptr, 10);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.liveNum < 1 || option.operationNum < 1 || option.pileSide < 1 || option.pileHeight < 1 ||
+		option.stepNum < 1 || option.threadNum < 0) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// btAlignedAllocSetCustomɓnāAq[vĂ񂾉񐔂𐔂
+inline std::atomic<std::size_t> heap_allocation_num{};
+
+inline void* counting_heap_allocate(std::size_t size)
+{
+	heap_allocation_num.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(size);
+}
+
+inline void counting_heap_free(void* ptr)
+{
+	std::free(ptr);
+}
+
+// btCollisionDispatcherƓAv[sbtAlignedAlloc
+class FallbackPoolAllocator
+{
+	btPoolAllocator pool;
+
+public:
+	FallbackPoolAllocator(std::size_t elementSize, std::size_t)
+		: pool(static_cast<int>(elementSize), 4096)
+	{
+	}
+
+	void* allocate(std::size_t size)
+	{
+		auto const mem = pool.allocate(static_cast<int>(size));
+		return mem ? mem : btAlignedAlloc(size, 16);
+	}
+
+	void deallocate(void* ptr)
+	{
+		if (pool.validPtr(ptr))
+			pool.freeMemory(ptr);
+		else
+			btAlignedFree(ptr);
+	}
+};
+
+class SlabChurnAllocator
+{
+	SlabAllocator slab;
+
+public:
+	SlabChurnAllocator(std::size_t elementSize, std::size_t liveNum)
+		: slab(elementSize)
+	{
+		// mۂĂApileƈĐLѕ͑Ȃ
+		slab.reserve(liveNum);
+	}
+
+	void* allocate(std::size_t size)
+	{
+		return slab.allocate(size);
+	}
+
+	void deallocate(void* ptr)
+	{
+		SlabAllocator::deallocate(ptr);
+	}
+};
+
+struct ChurnResult
+{
+	// Ɗmۂ̑g1
+	double nsPerOperation{};
+	std::size_t heapAllocationNum{};
+};
+
+struct PileResult
+{
+	// 1Xebv
+	double stepTime{};
+	double heapAllocationNum{};
+	std::size_t maxManifoldNum{};
+	std::vector<btVector3> positions{};
+	SlabAllocatorStats manifoldStats{};
+	SlabAllocatorStats algorithmStats{};
+};
+
+// eXbh̗̕vfA_ɑIŉĂ͊mۂ
+template<class Allocator>
+ChurnResult run_churn(SlabBenchmarkOption const& option, int threadNum);
+
+template<class Dispatcher, bool Slab>
+PileResult run_pile(SlabBenchmarkOption const& option);
+
+//
+// ȉA
+//
+
+template<class Allocator>
+inline ChurnResult run_churn(SlabBenchmarkOption const& option, int threadNum)
+{
+	auto const elementSize = sizeof(btPersistentManifold);
+	ChurnResult result{};
+	result.nsPerOperation = std::numeric_limits<double>::max();
+
+	for (int r = 0; r < option.repeat; r++)
+	{
+		heap_allocation_num = 0;
+		Allocator allocator{ elementSize, option.liveNum };
+		std::vector<void*> live(option.liveNum);
+		for (auto& ptr : live)
+			ptr = allocator.allocate(elementSize);
+
+		auto const sliceNum = static_cast<std::size_t>(threadNum);
+		auto const churn = [&](int begin, int end) {
+			for (auto t = static_cast<std::size_t>(begin); t < static_cast<std::size_t>(end); t++)
+			{
+				auto const sliceBegin = live.size() * t / sliceNum;
+				auto const sliceSize = live.size() * (t + 1) / sliceNum - sliceBegin;
+				if (sliceSize == 0)
+					continue;
+				std::uint32_t seed = static_cast<std::uint32_t>(t) * 2654435761u + 1;
+				for (std::size_t i = 0; i < option.operationNum / sliceNum; i++)
+				{
+					seed ^= seed << 13;
+					seed ^= seed >> 17;
+					seed ^= seed << 5;
+					auto& ptr = live[sliceBegin + seed % sliceSize];
+					allocator.deallocate(ptr);
+					ptr = allocator.allocate(elementSize);
+					// }jtH[h̃RXgN^Ɠ
+					*static_cast<std::uint64_t*>(ptr) = i;
+				}
+			}
+		};
+		struct ChurnBody : public btIParallelForBody
+		{
+			decltype(churn) const& f;
+			ChurnBody(decltype(churn) const& f) : f(f) {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		};
+
+		auto const start = std::chrono::steady_clock::now();
+		btParallelFor(0, threadNum, 1, ChurnBody{ churn });
+		auto const time = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		result.nsPerOperation = std::min(result.nsPerOperation, time / static_cast<double>(option.operationNum / sliceNum * sliceNum));
+		result.heapAllocationNum = heap_allocation_num;
+
+		for (auto const ptr : live)
+			allocator.deallocate(ptr);
+	}
+
+	return result;
+}
+
+template<class Dispatcher, bool Slab>
+inline PileResult run_pile(SlabBenchmarkOption const& option)
+{
+	PileResult result{};
+	result.stepTime = std::numeric_limits<double>::max();
+
+	for (int r = 0; r < option.repeat; r++)
+	{
+		// SlabCollisionDispatcher̓v[gȂ
+		btDefaultCollisionConstructionInfo constructionInfo{};
+		if (Slab)
+		{
+			constructionInfo.m_defaultMaxPersistentManifoldPoolSize = 1;
+			constructionInfo.m_defaultMaxCollisionAlgorithmPoolSize = 1;
+		}
+		btDefaultCollisionConfiguration collisionConfiguration{ constructionInfo };
+		std::conditional_t<Slab, SlabCollisionDispatcher<Dispatcher>, Dispatcher> dispatcher{ &collisionConfiguration };
+		btDbvtBroadphase broadphase{};
+		btSequentialImpulseConstraintSolver solver{};
+		btDiscreteDynamicsWorld world{ &dispatcher, &broadphase, &solver, &collisionConfiguration };
+		world.setGravity(btVector3(0, -10, 0));
+
+		btBoxShape groundShape{ btVector3(btScalar(option.pileSide) + 10, 1, btScalar(option.pileSide) + 10) };
+		btBoxShape boxShape{ btVector3(0.5, 0.5, 0.5) };
+		std::vector<std::unique_ptr<btRigidBody>> bodies{};
+
+		auto const addBody = [&](btCollisionShape* shape, btScalar mass, btVector3 const& position) {
+			btVector3 inertia(0, 0, 0);
+			if (mass != btScalar(0.))
+				shape->calculateLocalInertia(mass, inertia);
+			btRigidBody::btRigidBodyConstructionInfo info{ mass, nullptr, shape, inertia };
+			info.m_startWorldTransform.setOrigin(position);
+			auto& body = bodies.emplace_back(std::make_unique<btRigidBody>(info));
+			// ʂׂ̂œrŎ~߂Ȃ
+			if (mass != btScalar(0.))
+				body->setActivationState(DISABLE_DEACTIVATION);
+			world.addRigidBody(body.get());
+		};
+
+		addBody(&groundShape, 0., btVector3(0, -1, 0));
+
+		// iƂɏ炵ėƂAڐG茸肷悤ɂ
+		auto const offset = (static_cast<btScalar>(option.pileSide) - 1) * btScalar(0.5);
+		for (std::size_t y = 0; y < option.pileHeight; y++)
+		{
+			auto const shift = static_cast<btScalar>(y % 2) * btScalar(0.5);
+			for (std::size_t x = 0; x < option.pileSide; x++)
+				for (std::size_t z = 0; z < option.pileSide; z++)
+					addBody(&boxShape, 1., btVector3(static_cast<btScalar>(x) * btScalar(1.02) - offset + shift, btScalar(0.5) + static_cast<btScalar>(y) * btScalar(1.5),
+						static_cast<btScalar>(z) * btScalar(1.02) - offset + shift));
+		}
+
+		heap_allocation_num = 0;
+		std::size_t maxManifoldNum{};
+		auto const start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < option.stepNum; i++)
+		{
+			world.stepSimulation(btScalar(1. / 60.), 0);
+			maxManifoldNum = std::max(maxManifoldNum, static_cast<std::size_t>(dispatcher.getNumManifolds()));
+		}
+		auto const stepTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		result.stepTime = std::min(result.stepTime, stepTime / static_cast<double>(option.stepNum));
+		result.heapAllocationNum = static_cast<double>(heap_allocation_num) / static_cast<double>(option.stepNum);
+		result.maxManifoldNum = maxManifoldNum;
+
+		result.positions.clear();
+		for (auto const& body : bodies)
+			result.positions.push_back(body->getWorldTransform().getOrigin());
+
+		if constexpr (Slab)
+		{
+			result.manifoldStats = dispatcher.getManifoldAllocator().getStats();
+			result.algorithmStats = dispatcher.getAlgorithmAllocator().getStats();
+		}
+
+		for (auto const& body : bodies)
+			world.removeRigidBody(body.get());
+	}
+
+	return result;
+}
+
+inline void write_slab_allocator_stats(JsonWriter& json, std::string_view key, SlabAllocatorStats const& stats)
+{
+	json.beginObject(key);
+	json.value("element_bytes", stats.elementSize);
+	json.value("chunks", stats.chunkNum);
+	json.value("capacity", stats.capacity);
+	json.value("high_water", stats.highWaterNum);
+	json.value("fallbacks", stats.fallbackNum);
+	json.value("refills", stats.refillNum);
+	json.endObject();
+}
+
+inline int run_slab_benchmark(int argc, char** argv)
+{
+	SlabBenchmarkOption option{};
+	if (!parse_slab_benchmark_option(argc, argv, option)) {
+		print_slab_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the slab benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+	scheduler->setNumThreads(threadNum);
+
+	btAlignedAllocSetCustom(counting_heap_allocate, counting_heap_free);
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "slab");
+	json.value("repeat", option.repeat);
+	json.value("threads", threadNum);
+
+	{
+		auto const bullet = run_churn<FallbackPoolAllocator>(option, threadNum);
+		auto const slab = run_churn<SlabChurnAllocator>(option, threadNum);
+
+		json.beginObject("churn");
+		json.value("live", option.liveNum);
+		json.value("operations", option.operationNum);
+		json.beginObject("ns_per_operation");
+		json.value("bullet_pool", bullet.nsPerOperation);
+		json.value("slab", slab.nsPerOperation);
+		json.endObject();
+		json.beginObject("heap_allocations");
+		json.value("bullet_pool", bullet.heapAllocationNum);
+		json.value("slab", slab.heapAllocationNum);
+		json.endObject();
+		json.endObject();
+	}
+
+	// mۂ̂Ōʂ͕ςȂ̂ŁA1XbhȂʒu͈v
+	auto correct = true;
+	auto const writePile = [&](std::string_view key, PileResult const& bullet, PileResult const& slab) {
+		btScalar maxPositionError = 0.;
+		for (std::size_t i = 0; i < bullet.positions.size(); i++)
+			maxPositionError = std::max(maxPositionError, (bullet.positions[i] - slab.positions[i]).length());
+		auto const pileCorrect = threadNum > 1 || maxPositionError == btScalar(0.);
+		correct = correct && pileCorrect;
+
+		json.beginObject(key);
+		json.value("bodies", bullet.positions.size() - 1);
+		json.value("max_manifolds", bullet.maxManifoldNum);
+		json.beginObject("step_ms");
+		json.value("bullet_pool", bullet.stepTime);
+		json.value("slab", slab.stepTime);
+		json.endObject();
+		json.beginObject("heap_allocations_per_step");
+		json.value("bullet_pool", bullet.heapAllocationNum);
+		json.value("slab", slab.heapAllocationNum);
+		json.endObject();
+		write_slab_allocator_stats(json, "manifold_slab", slab.manifoldStats);
+		write_slab_allocator_stats(json, "algorithm_slab", slab.algorithmStats);
+		json.value("max_position_error", maxPositionError);
+		json.value("correct", pileCorrect);
+		json.endObject();
+	};
+
+	writePile("pile", run_pile<btCollisionDispatcher, false>(option), run_pile<btCollisionDispatcher, true>(option));
+	writePile("pile_mt", run_pile<btCollisionDispatcherMt, false>(option), run_pile<btCollisionDispatcherMt, true>(option));
+
+	json.value("correct", correct);
+	json.endObject();
+
+	btAlignedAllocSetCustom(nullptr, nullptr);
+
+	return correct ? 0 : 1;
+}
@@ -0,0 +1,277 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/Scene.hpp"
+#include"../src/WorldSnapshot.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<iostream>
+#include<limits>
+#include<string_view>
+#include<vector>
+
+// WorldSnapshotterŕۑƕɂ鎞Ԃ𑪂A߂Đi߂Ȃʂƈv邩ׂ
+// ݂邵t[Ƃɓėׂ̍ƂԂ̂ŁA߂ԂɃyAƃ}jtH[ho肷
+// ׂ邽߂btDefaultSerializerŃ[hoԂ
+
+struct SnapshotBenchmarkOption
+{
+	int repeat = 5;
+	// 1Ń{fB4Ȃ̂ŁA1
+	std::size_t chainNum = 2500;
+	btScalar chainSpacing = 6.;
+	std::size_t warmupStepNum = 60;
+	// ߂t[
+	std::size_t rollbackStepNum = 30;
+	bool openAddressingPairCache = false;
+};
+
+inline void print_snapshot_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark snapshot [options]\n"
+		"  --repeat <n>             run n times and report the fastest (default 5)\n"
+		"  --chains <n>             number of chains, 4 bodies each (default 2500)\n"
+		"  --spacing <m>            distance between chains (default 6)\n"
+		"  --warmup <n>             steps before the snapshot (default 60)\n"
+		"  --rollback <n>           steps simulated again after each restore (default 30)\n"
+		"  --open-addressing-pairs  use OpenAddressingPairCache instead of btHashedOverlappingPairCache\n";
+}
+
+// sfalse
+inline bool parse_snapshot_benchmark_option(int argc, char** argv, SnapshotBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (name == "--open-addressing-pairs") {
+			option.openAddressingPairCache = true;
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--chains")
+			option.chainNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--spacing")
+			option.chainSpacing = static_cast<btScalar>(std::atof(value));
+		else if (name == "--warmup")
+			option.warmupStepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--rollback")
+			option.rollbackStepNum = std::strtoull(value, nullptr, 10);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.chainNum < 1 || !(option.chainSpacing > 0) || option.rollbackStepNum < 1) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// ׂ{fB̏
+struct SnapshotBodyState
+{
+	btVector3 origin{};
+	btVector3 basis[3]{};
+	btVector3 linearVelocity{};
+	btVector3 angularVelocity{};
+};
+
+// ͂̑ɁA݂邵t[Ƃɉ~`悤ɓ
+void drive_fix_boxes(Scene& scene, std::size_t frame);
+std::vector<SnapshotBodyState> collect_body_states(btDiscreteDynamicsWorld* world);
+// rbgPʂœ
+bool same_body_states(std::vector<SnapshotBodyState> const& a, std::vector<SnapshotBodyState> const& b) noexcept;
+
+//
+// ȉA
+//
+
+inline void drive_fix_boxes(Scene& scene, std::size_t frame)
+{
+	auto const t = static_cast<btScalar>(frame) / 60;
+	for (std::size_t i = 0; i < scene.getChainNum(); i++)
+	{
+		auto const angle = 2 * t + static_cast<btScalar>(i % 7);
+		scene.setFixBoxPosition(i, btVector3(-2 + 3 * std::cos(angle), 10, 3 * std::sin(angle)));
+	}
+}
+
+inline std::vector<SnapshotBodyState> collect_body_states(btDiscreteDynamicsWorld* world)
+{
+	std::vector<SnapshotBodyState> states{};
+	auto const& objects = world->getCollisionObjectArray();
+	for (int i = 0; i < objects.size(); i++)
+	{
+		auto const body = btRigidBody::upcast(objects[i]);
+		if (!body)
+			continue;
+		auto const& transform = body->getWorldTransform();
+		states.push_back({ transform.getOrigin(), { transform.getBasis()[0], transform.getBasis()[1], transform.getBasis()[2] },
+			body->getLinearVelocity(), body->getAngularVelocity() });
+	}
+	return states;
+}
+
+inline bool same_body_states(std::vector<SnapshotBodyState> const& a, std::vector<SnapshotBodyState> const& b) noexcept
+{
+	auto const same = [](btVector3 const& u, btVector3 const& v) {
+		return u.getX() == v.getX() && u.getY() == v.getY() && u.getZ() == v.getZ();
+	};
+
+	if (a.size() != b.size())
+		return false;
+	for (std::size_t i = 0; i < a.size(); i++)
+	{
+		if (!same(a[i].origin, b[i].origin) || !same(a[i].linearVelocity, b[i].linearVelocity) || !same(a[i].angularVelocity, b[i].angularVelocity))
+			return false;
+		for (int j = 0; j < 3; j++)
+		{
+			if (!same(a[i].basis[j], b[i].basis[j]))
+				return false;
+		}
+	}
+	return true;
+}
+
+inline int run_snapshot_benchmark(int argc, char** argv)
+{
+	SnapshotBenchmarkOption option{};
+	if (!parse_snapshot_benchmark_option(argc, argv, option)) {
+		print_snapshot_benchmark_usage();
+		return 1;
+	}
+
+	// 1Xbh̃[hłȂƃXebvIɂȂȂ
+	Scene scene{ {
+		.chainNum = option.chainNum,
+		.chainSpacing = option.chainSpacing,
+		.openAddressingPairCache = option.openAddressingPairCache,
+	} };
+	auto const world = scene.getDynamicsWorld();
+
+	std::size_t frame = 0;
+	auto const step = [&] {
+		drive_fix_boxes(scene, frame);
+		world->stepSimulation(btScalar(1. / 60.), 0);
+		frame++;
+	};
+	for (std::size_t i = 0; i < option.warmupStepNum; i++)
+		step();
+
+	WorldSnapshotter snapshotter{ world };
+	WorldSnapshot snapshot{};
+	if (!snapshotter.capture(snapshot)) {
+		std::cerr << "the scene cannot be captured\n";
+		return 1;
+	}
+	auto const header = snapshot.getHeader();
+	auto const snapshotFrame = frame;
+
+	auto const captureTime = measure_best(option.repeat, [&] { snapshotter.capture(snapshot); });
+
+	// Oobt@ɗ߂Ƃ̕
+	WorldSnapshot copy{};
+	auto const copyTime = measure_best(option.repeat, [&] { copy.assign(snapshot.getData()); });
+
+	Checksum checksum{};
+	auto const serializerTime = measure_best(option.repeat, [&] {
+		btDefaultSerializer serializer{};
+		world->serialize(&serializer);
+		checksum.add(serializer.getCurrentBufferSize());
+	});
+
+	// t[i߂ʂA߂ē͂Ői߂ȂʂƔׂ
+	for (std::size_t i = 0; i < option.rollbackStepNum; i++)
+		step();
+	auto const reference = collect_body_states(world);
+
+	auto correct = true;
+	auto restoreTime = std::numeric_limits<double>::max();
+	WorldSnapshotRestoreStats rollbackStats{};
+	for (int r = 0; r < option.repeat; r++)
+	{
+		auto const start = std::chrono::steady_clock::now();
+		auto const restored = snapshotter.restore(snapshot);
+		auto const end = std::chrono::steady_clock::now();
+		restoreTime = std::min(restoreTime, std::chrono::duration<double>(end - start).count());
+		if (r == 0)
+			rollbackStats = snapshotter.getRestoreStats();
+
+		frame = snapshotFrame;
+		for (std::size_t i = 0; i < option.rollbackStepNum; i++)
+			step();
+		correct = correct && restored && same_body_states(reference, collect_body_states(world));
+	}
+
+	// ߂ɂx߂AyA؂̐߂̂܂܎g
+	snapshotter.restore(snapshot);
+	auto const unchangedTime = measure_best(option.repeat, [&] { snapshotter.restore(snapshot); });
+	auto const unchangedStats = snapshotter.getRestoreStats();
+	frame = snapshotFrame;
+	for (std::size_t i = 0; i < option.rollbackStepNum; i++)
+		step();
+	auto const unchangedCorrect = same_body_states(reference, collect_body_states(world));
+	correct = correct && unchangedCorrect;
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "snapshot");
+	json.value("repeat", option.repeat);
+	json.value("pair_cache", option.openAddressingPairCache ? "open_addressing" : "hashed");
+	json.value("objects", header.objectNum);
+	json.value("constraints", header.constraintNum);
+	json.value("pairs", header.pairNum);
+	json.value("manifolds", header.manifoldNum);
+	json.value("contacts", header.pointNum);
+	json.value("snapshot_bytes", snapshot.getData().size());
+	json.value("rollback_steps", option.rollbackStepNum);
+
+	json.beginObject("ms");
+	json.value("capture", captureTime * 1e3);
+	json.value("copy", copyTime * 1e3);
+	json.value("restore_after_rollback", restoreTime * 1e3);
+	json.value("restore_unchanged", unchangedTime * 1e3);
+	json.value("bt_default_serializer", serializerTime * 1e3);
+	json.endObject();
+	json.value("serializer_bytes", checksum.value / option.repeat);
+
+	json.beginObject("rollback_restore");
+	json.value("pairs_rebuilt", rollbackStats.pairsRebuilt);
+	json.value("created_algorithms", rollbackStats.createdAlgorithmNum);
+	json.value("destroyed_algorithms", rollbackStats.destroyedAlgorithmNum);
+	json.value("exact_nodes", rollbackStats.exactNodes);
+	json.value("kept_pairs", rollbackStats.keptPairNum);
+	json.value("restored_objects", rollbackStats.restoredObjectNum);
+	json.value("restored_nodes", rollbackStats.restoredNodeNum);
+	json.endObject();
+	json.beginObject("unchanged_restore");
+	json.value("pairs_rebuilt", unchangedStats.pairsRebuilt);
+	json.value("exact_nodes", unchangedStats.exactNodes);
+	json.value("kept_pairs", unchangedStats.keptPairNum);
+	json.value("restored_objects", unchangedStats.restoredObjectNum);
+	json.value("restored_nodes", unchangedStats.restoredNodeNum);
+	json.endObject();
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
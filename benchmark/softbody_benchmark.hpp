@@ -0,0 +1,321 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/Scene.hpp"
+#include"../src/SoaSoftBody.hpp"
+#include"../external/bullet3/src/BulletSoftBody/btSoftBody.h"
+#include<algorithm>
+#include<array>
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+#include<iostream>
+#include<memory>
+#include<string>
+#include<string_view>
+#include<utility>
+#include<vector>
+
+// 2ӂŒ肵Đ炵zAbtSoftBodyŉꍇƁASoaSoftBodyXbhςĉꍇŔׂ
+// SoaSoftBody̌ʂXbhɂ炸rbgPʂœ𒲂ׂ
+// FtɒǉɉSoaSoftBodýAbtSoftBodyƃrbgPʂœɂȂ͂
+// FtƉႤ̂ŁAbtSoftBodyƂ͌ʂႤ
+
+struct SoftBodyBenchmarkOption
+{
+	int repeat = 3;
+	std::size_t stepNum = 30;
+	// 0Ȃ̑傫Ɏ
+	int size = 0;
+	int iterations = 4;
+	int grainSize = 256;
+	int threadNum = 0;
+};
+
+// z̈ӂ̐ߓ_̐
+constexpr int SOFT_BODY_BENCHMARK_SIZES[] = { 32, 64, 100, 200 };
+
+inline void print_soft_body_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark softbody [options]\n"
+		"  --repeat <n>      simulate n times and report the fastest (default 3)\n"
+		"  --steps <n>       steps per simulation (default 30)\n"
+		"  --size <n>        nodes on each side of the cloth (default 32, 64, 100 and 200)\n"
+		"  --iterations <n>  position iterations per step (default 4)\n"
+		"  --grain <n>       nodes or links per task (default 256)\n"
+		"  --threads <n>     largest thread count to try (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_soft_body_benchmark_option(int argc, char** argv, SoftBodyBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--size")
+			option.size = std::atoi(value);
+		else if (name == "--iterations")
+			option.iterations = std::atoi(value);
+		else if (name == "--grain")
+			option.grainSize = std::atoi(value);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.stepNum < 1 || (option.size != 0 && option.size < 3) || option.iterations < 1 || option.grainSize < 1 || option.threadNum < 0) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// bodyƓߓ_ƃN𓯂ɎbtSoftBodyAAJ[͎ʂȂ
+inline std::unique_ptr<btSoftBody> make_soft_body_benchmark_reference(btSoftBodyWorldInfo& worldInfo, SoaSoftBody const& body,
+	std::vector<std::pair<int, int>> const& linkNodes, std::vector<btScalar> const& masses)
+{
+	std::vector<btVector3> positions(body.getNodeNum());
+	for (int i = 0; i < body.getNodeNum(); i++)
+		positions[i] = body.getPosition(i);
+
+	auto const& config = body.getConfig();
+	worldInfo.m_gravity = config.gravity;
+	auto reference = std::make_unique<btSoftBody>(&worldInfo, body.getNodeNum(), positions.data(), masses.data());
+	reference->m_materials[0]->m_kLST = config.linearStiffness;
+	for (auto const& [a, b] : linkNodes)
+		reference->appendLink(a, b);
+	reference->m_cfg.kDP = config.damping;
+	reference->m_cfg.piterations = config.positionIterations;
+	return reference;
+}
+
+// btSoftRigidDynamicsWorldbtDefaultSoftBodySolverŐi߂̂Ɠ
+// predictMotion͐ߓ_btDbvt̍XV܂
+inline void step_soft_body_benchmark_reference(btSoftBody& body, btScalar dt)
+{
+	body.predictMotion(dt);
+	body.solveConstraints();
+	body.integrateMotion();
+}
+
+// size̕zA2̊pŒ肷
+inline void append_soft_body_benchmark_cloth(SoaSoftBody& body, int size)
+{
+	auto const extent = static_cast<btScalar>(size - 1) * btScalar(0.05);
+	append_soa_cloth(body, btVector3(-extent, 10, -extent), btVector3(extent, 10, -extent), btVector3(-extent, 10, extent), btVector3(extent, 10, extent),
+		size, size, 1 + 2, true, true);
+}
+
+// ԐLтN̐Lї
+inline btScalar max_soft_body_strain(std::vector<std::pair<int, int>> const& links, std::vector<btScalar> const& restLengths, auto const& getPosition)
+{
+	btScalar strain = 0;
+	for (std::size_t i = 0; i < links.size(); i++)
+	{
+		auto const length = getPosition(links[i].first).distance(getPosition(links[i].second));
+		strain = std::max(strain, std::abs(length - restLengths[i]) / restLengths[i]);
+	}
+	return strain;
+}
+
+inline int run_soft_body_benchmark(int argc, char** argv)
+{
+	SoftBodyBenchmarkOption option{};
+	if (!parse_soft_body_benchmark_option(argc, argv, option)) {
+		print_soft_body_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the softbody benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+
+	// 1{Xɑ₵AŌ͎w肵Xbh
+	std::vector<int> threadCounts{};
+	for (int t = 1; t < threadNum; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(threadNum);
+
+	std::vector<int> sizes{};
+	if (option.size > 0)
+		sizes.push_back(option.size);
+	else
+		sizes.assign(std::begin(SOFT_BODY_BENCHMARK_SIZES), std::end(SOFT_BODY_BENCHMARK_SIZES));
+
+	SoaSoftBodyConfig const config{
+		.positionIterations = option.iterations,
+		.grainSize = option.grainSize,
+	};
+	auto const dt = btScalar(1. / 60.);
+	auto const perStep = [&](double seconds) { return seconds * 1e3 / static_cast<double>(option.stepNum); };
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "softbody");
+	json.value("repeat", option.repeat);
+	json.value("steps", option.stepNum);
+	json.value("iterations", option.iterations);
+	json.value("grain", option.grainSize);
+	json.value("threads", threadNum);
+
+	auto correct = true;
+	json.beginArray("cloths");
+	for (auto const size : sizes)
+	{
+		// AoS̑ɓN邽߂ɁAߓ_̔ԍƎʂĂ
+		SoaSoftBody shape{ config };
+		append_soft_body_benchmark_cloth(shape, size);
+		std::vector<std::pair<int, int>> linkNodes{};
+		std::vector<btScalar> restLengths{};
+		{
+			// append_soa_clothƓɃNׂ
+			auto const index = [&](int x, int y) { return y * size + x; };
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					auto const mdx = x + 1 < size;
+					auto const mdy = y + 1 < size;
+					if (mdx) linkNodes.push_back({ index(x, y), index(x + 1, y) });
+					if (mdy) linkNodes.push_back({ index(x, y), index(x, y + 1) });
+					if (mdx && mdy)
+					{
+						if ((x + y) & 1)
+							linkNodes.push_back({ index(x, y), index(x + 1, y + 1) });
+						else
+							linkNodes.push_back({ index(x + 1, y), index(x, y + 1) });
+					}
+					if (x + 2 < size) linkNodes.push_back({ index(x, y), index(x + 2, y) });
+					if (y + 2 < size) linkNodes.push_back({ index(x, y), index(x, y + 2) });
+				}
+			}
+			for (auto const& [a, b] : linkNodes)
+				restLengths.push_back(shape.getPosition(a).distance(shape.getPosition(b)));
+		}
+		correct = correct && static_cast<int>(linkNodes.size()) == shape.getLinkNum();
+		std::vector<btScalar> masses(shape.getNodeNum(), 1);
+		masses[0] = 0;
+		masses[size - 1] = 0;
+
+		scheduler->setNumThreads(1);
+		btSoftBodyWorldInfo worldInfo{};
+		std::unique_ptr<btSoftBody> reference{};
+		auto const referenceTime = measure_best(option.repeat, [&] {
+			reference.reset();
+			reference = make_soft_body_benchmark_reference(worldInfo, shape, linkNodes, masses);
+		}, [&] {
+			for (std::size_t i = 0; i < option.stepNum; i++)
+				step_soft_body_benchmark_reference(*reference, dt);
+		});
+		auto const referencePosition = [&](int i) { return reference->m_nodes[i].m_x; };
+		auto const referenceStrain = max_soft_body_strain(linkNodes, restLengths, referencePosition);
+
+		// FtȂ΁AbtSoftBodyƓɓŉ
+		auto orderedConfig = config;
+		orderedConfig.coloredLinks = false;
+		std::unique_ptr<SoaSoftBody> ordered{};
+		auto const orderedTime = measure_best(option.repeat, [&] {
+			ordered = std::make_unique<SoaSoftBody>(orderedConfig);
+			append_soft_body_benchmark_cloth(*ordered, size);
+		}, [&] {
+			for (std::size_t i = 0; i < option.stepNum; i++)
+				ordered->step(dt);
+		});
+		auto identical = true;
+		for (int i = 0; i < ordered->getNodeNum(); i++)
+		{
+			auto const position = ordered->getPosition(i);
+			identical = identical && std::memcmp(&position, &reference->m_nodes[i].m_x, sizeof(btVector3)) == 0;
+		}
+
+		json.beginObject();
+		json.value("size", size);
+		json.value("nodes", shape.getNodeNum());
+		json.value("links", shape.getLinkNum());
+
+		std::array<std::vector<btScalar>, 3> firstPositions{};
+		auto deterministic = true;
+		btScalar soaStrain{};
+		btScalar maxDifference{};
+		int colorNum{};
+		json.beginObject("ms_per_step");
+		json.value("btsoftbody_serial", perStep(referenceTime));
+		json.value("soa_insertion_order", perStep(orderedTime));
+		double singleThreadTime{};
+		for (auto const threads : threadCounts)
+		{
+			scheduler->setNumThreads(threads);
+			std::unique_ptr<SoaSoftBody> body{};
+			auto const time = measure_best(option.repeat, [&] {
+				body = std::make_unique<SoaSoftBody>(config);
+				append_soft_body_benchmark_cloth(*body, size);
+			}, [&] {
+				for (std::size_t i = 0; i < option.stepNum; i++)
+					body->step(dt);
+			});
+			json.value("soa_threads_" + std::to_string(threads), perStep(time));
+			if (threads == 1)
+				singleThreadTime = time;
+
+			colorNum = body->getColorNum();
+			if (firstPositions[0].empty())
+			{
+				for (int axis = 0; axis < 3; axis++)
+					firstPositions[axis].assign(body->getPositions(axis).begin(), body->getPositions(axis).end());
+				soaStrain = max_soft_body_strain(linkNodes, restLengths, [&](int i) { return body->getPosition(i); });
+				for (int i = 0; i < body->getNodeNum(); i++)
+					maxDifference = std::max(maxDifference, body->getPosition(i).distance(referencePosition(i)));
+			}
+			else
+			{
+				for (int axis = 0; axis < 3; axis++)
+				{
+					auto const positions = body->getPositions(axis);
+					deterministic = deterministic && std::memcmp(positions.data(), firstPositions[axis].data(), positions.size() * sizeof(btScalar)) == 0;
+				}
+			}
+		}
+		json.endObject();
+		json.value("speedup_soa_serial", referenceTime / singleThreadTime);
+		json.value("colors", colorNum);
+		json.value("insertion_order_identical", identical);
+		json.value("max_strain_btsoftbody", referenceStrain);
+		json.value("max_strain_soa", soaStrain);
+		json.value("max_difference_from_btsoftbody", maxDifference);
+		json.value("deterministic", deterministic);
+		json.endObject();
+
+		// FtƉႤ̂ňʒu͈vȂAS̎c͓炢ɂȂ
+		correct = correct && identical && deterministic && std::isfinite(soaStrain) && soaStrain <= 2 * referenceStrain + btScalar(1e-3);
+	}
+	json.endArray();
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
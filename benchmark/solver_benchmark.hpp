@@ -0,0 +1,346 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/Scene.hpp"
+#include"../src/SoaContactSolver.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cstdlib>
+#include<iostream>
+#include<limits>
+#include<memory>
+#include<string_view>
+#include<type_traits>
+#include<vector>
+
+// ς񂾑傫1̃AChŁAbtSequentialImpulseConstraintSolverMtSoaContactSolverMtׂ
+// cɐς񂾒ׂ̂ƁA炵Đς񂾃s~bh2ʂ
+// ŉ̂ŁAXebvi߂̈ʒu͂قڈv
+
+struct SolverBenchmarkOption
+{
+	int repeat = 3;
+	std::size_t stepNum = 120;
+	// cɕׂ鐔ƍ
+	std::size_t stackNum = 16;
+	std::size_t stackHeight = 10;
+	// s~bḧԉ̒i̐
+	std::size_t pyramidBase = 40;
+	int iterationNum = 10;
+	// btSequentialImpulseConstraintSolverMt1ob`̍S
+	// قǃob`SoÃ[܂
+	int minBatchSize = 8;
+	int maxBatchSize = 16;
+	int threadNum = 0;
+};
+
+inline void print_solver_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark solver [options]\n"
+		"  --repeat <n>      simulate n times and report the fastest (default 3)\n"
+		"  --steps <n>       steps per simulation (default 120)\n"
+		"  --stacks <n>      stacks per side in the stack scene (default 16)\n"
+		"  --height <n>      boxes per stack (default 10)\n"
+		"  --pyramid <n>     boxes in the bottom row of the pyramid scene (default 40)\n"
+		"  --iterations <n>  solver iterations (default 10)\n"
+		"  --batch <min> <max>\n"
+		"                    constraints per batch (default 8 16)\n"
+		"  --threads <n>     threads for the solver (default all cores)\n";
+}
+
+// sfalse
+inline bool parse_solver_benchmark_option(int argc, char** argv, SolverBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (name == "--batch") {
+			if (i + 2 >= argc) {
+				std::cerr << "missing value for " << name << "\n";
+				return false;
+			}
+			option.minBatchSize = std::atoi(argv[++i]);
+			option.maxBatchSize = std::atoi(argv[++i]);
+			continue;
+		}
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--stacks")
+			option.stackNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--height")
+			option.stackHeight = std::strtoull(value, nullptr, 10);
+		else if (name == "--pyramid")
+			option.pyramidBase = std::strtoull(value, nullptr, 10);
+		else if (name == "--iterations")
+			option.iterationNum = std::atoi(value);
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.stepNum < 1 || option.stackNum < 1 || option.stackHeight < 1 || option.pyramidBase < 1 ||
+		option.iterationNum < 1 || option.minBatchSize < 1 || option.maxBatchSize < option.minBatchSize || option.threadNum < 0) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// ɂԂƉs̐𐔂
+template<class Solver>
+class TimedSolver : public Solver
+{
+public:
+	double iterationTime{};
+	std::size_t rowNum{};
+	// SoaContactSolverMt̃ubNŉsƋlߕ̐
+	std::size_t soaRowNum{};
+	std::size_t soaPaddingNum{};
+
+	btScalar solveGroupCacheFriendlyIterations(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds,
+		btTypedConstraint** constraints, int numConstraints, btContactSolverInfo const& infoGlobal, btIDebugDraw* debugDrawer) override
+	{
+		auto const start = std::chrono::steady_clock::now();
+		auto const result = Solver::solveGroupCacheFriendlyIterations(bodies, numBodies, manifoldPtr, numManifolds,
+			constraints, numConstraints, infoGlobal, debugDrawer);
+		iterationTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		rowNum += static_cast<std::size_t>(this->m_tmpSolverContactConstraintPool.size() + this->m_tmpSolverContactFrictionConstraintPool.size()) *
+			static_cast<std::size_t>(infoGlobal.m_numIterations);
+		// Ō̋solveGroupł̂ŁAv[邤ɐ
+		if constexpr (std::is_same_v<Solver, SoaContactSolverMt>)
+		{
+			if (this->isSoaUsed())
+			{
+				soaRowNum += this->getSoaRowNum();
+				soaPaddingNum += this->getSoaPaddingNum();
+			}
+		}
+		return result;
+	}
+};
+
+enum class SolverScene
+{
+	Stack,
+	Pyramid,
+};
+
+// ς񂾂̃[hAACh𕪂1ŉ
+struct SolverWorld
+{
+	std::unique_ptr<btDefaultCollisionConfiguration> collisionConfiguration{};
+	std::unique_ptr<btCollisionDispatcher> dispatcher{};
+	std::unique_ptr<btBroadphaseInterface> broadphase{};
+	std::unique_ptr<btDiscreteDynamicsWorld> world{};
+	std::unique_ptr<btCollisionShape> groundShape{};
+	std::unique_ptr<btCollisionShape> boxShape{};
+	std::vector<std::unique_ptr<btRigidBody>> bodies{};
+
+	SolverWorld(SolverScene scene, btConstraintSolver* solver, SolverBenchmarkOption const& option);
+	virtual ~SolverWorld();
+	SolverWorld(SolverWorld const&) = delete;
+	SolverWorld& operator=(SolverWorld const&) = delete;
+};
+
+struct SolverResult
+{
+	// 1Xebv
+	double iterationTime{};
+	double stepTime{};
+	double rowsPerSecond{};
+	std::size_t rowNum{};
+	std::vector<btVector3> positions{};
+	bool soaUsed = false;
+	// SoÃubN̋lߕ̊
+	double paddingRatio{};
+};
+
+template<class Solver>
+SolverResult run_solver(SolverScene scene, SolverBenchmarkOption const& option);
+
+//
+// ȉA
+//
+
+inline SolverWorld::SolverWorld(SolverScene scene, btConstraintSolver* solver, SolverBenchmarkOption const& option)
+{
+	collisionConfiguration = std::make_unique<btDefaultCollisionConfiguration>();
+	dispatcher = std::make_unique<btCollisionDispatcher>(collisionConfiguration.get());
+	broadphase = std::make_unique<btDbvtBroadphase>();
+	world = std::make_unique<btDiscreteDynamicsWorld>(dispatcher.get(), broadphase.get(), solver, collisionConfiguration.get());
+	world->setGravity(btVector3(0, -10, 0));
+	world->getSolverInfo().m_numIterations = option.iterationNum;
+	world->getSimulationIslandManager()->setSplitIslands(false);
+
+	groundShape = std::make_unique<btBoxShape>(btVector3(500, 1, 500));
+	boxShape = std::make_unique<btBoxShape>(btVector3(0.5, 0.5, 0.5));
+
+	auto const addBody = [&](btCollisionShape* shape, btScalar mass, btVector3 const& position) {
+		btVector3 inertia(0, 0, 0);
+		if (mass != btScalar(0.))
+			shape->calculateLocalInertia(mass, inertia);
+		btRigidBody::btRigidBodyConstructionInfo info{ mass, nullptr, shape, inertia };
+		info.m_startWorldTransform.setOrigin(position);
+		info.m_friction = 0.6;
+		auto& body = bodies.emplace_back(std::make_unique<btRigidBody>(info));
+		// ʂׂ̂œrŎ~߂Ȃ
+		if (mass != btScalar(0.))
+			body->setActivationState(DISABLE_DEACTIVATION);
+		world->addRigidBody(body.get());
+	};
+
+	addBody(groundShape.get(), 0., btVector3(0, -1, 0));
+
+	if (scene == SolverScene::Stack)
+	{
+		auto const offset = (static_cast<btScalar>(option.stackNum) - 1) * btScalar(0.75);
+		for (std::size_t x = 0; x < option.stackNum; x++)
+			for (std::size_t z = 0; z < option.stackNum; z++)
+				for (std::size_t y = 0; y < option.stackHeight; y++)
+					addBody(boxShape.get(), 1., btVector3(static_cast<btScalar>(x) * btScalar(1.5) - offset, btScalar(0.5) + static_cast<btScalar>(y), static_cast<btScalar>(z) * btScalar(1.5) - offset));
+	}
+	else
+	{
+		// s3ׂ
+		for (std::size_t y = 0; y < option.pyramidBase; y++)
+		{
+			auto const rowNum = option.pyramidBase - y;
+			auto const offset = (static_cast<btScalar>(rowNum) - 1) * btScalar(0.5);
+			for (std::size_t x = 0; x < rowNum; x++)
+				for (int z = -1; z <= 1; z++)
+					addBody(boxShape.get(), 1., btVector3(static_cast<btScalar>(x) - offset, btScalar(0.5) + static_cast<btScalar>(y), static_cast<btScalar>(z) * btScalar(1.02)));
+		}
+	}
+}
+
+inline SolverWorld::~SolverWorld()
+{
+	for (auto& body : bodies)
+		world->removeRigidBody(body.get());
+}
+
+template<class Solver>
+inline SolverResult run_solver(SolverScene scene, SolverBenchmarkOption const& option)
+{
+	SolverResult result{};
+	result.iterationTime = std::numeric_limits<double>::max();
+	result.stepTime = std::numeric_limits<double>::max();
+
+	for (int r = 0; r < option.repeat; r++)
+	{
+		TimedSolver<Solver> solver{};
+		SolverWorld world{ scene, &solver, option };
+
+		auto const start = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < option.stepNum; i++)
+			world.world->stepSimulation(btScalar(1. / 60.), 0);
+		auto const stepTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		result.iterationTime = std::min(result.iterationTime, solver.iterationTime / static_cast<double>(option.stepNum));
+		result.stepTime = std::min(result.stepTime, stepTime / static_cast<double>(option.stepNum));
+		result.rowNum = solver.rowNum;
+		result.rowsPerSecond = static_cast<double>(solver.rowNum) / static_cast<double>(option.stepNum) / (result.iterationTime * 1e-3);
+
+		result.positions.clear();
+		for (auto const& body : world.bodies)
+			result.positions.push_back(body->getWorldTransform().getOrigin());
+
+		result.soaUsed = solver.soaRowNum > 0;
+		result.paddingRatio = solver.soaRowNum > 0 ? static_cast<double>(solver.soaPaddingNum) / static_cast<double>(solver.soaRowNum) : 0.;
+	}
+
+	return result;
+}
+
+inline int run_solver_benchmark(int argc, char** argv)
+{
+	SolverBenchmarkOption option{};
+	if (!parse_solver_benchmark_option(argc, argv, option)) {
+		print_solver_benchmark_usage();
+		return 1;
+	}
+
+	auto const scheduler = get_task_scheduler();
+	if (!scheduler) {
+		std::cerr << "the solver benchmark needs BT_THREADSAFE\n";
+		return 1;
+	}
+	btSetTaskScheduler(scheduler);
+	auto const threadNum = option.threadNum > 0 ? std::min(option.threadNum, scheduler->getMaxNumThreads()) : scheduler->getMaxNumThreads();
+	scheduler->setNumThreads(threadNum);
+
+	btSequentialImpulseConstraintSolverMt::s_minBatchSize = option.minBatchSize;
+	btSequentialImpulseConstraintSolverMt::s_maxBatchSize = option.maxBatchSize;
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "solver");
+	json.value("repeat", option.repeat);
+	json.value("steps", option.stepNum);
+	json.value("iterations", option.iterationNum);
+	// 1ubN̍s̐ƁÂ1߂ŉ鐔
+	json.value("lanes", SoaSolverRowBlock::LANE_NUM);
+	json.value("simd_width", SoaSolverVector::WIDTH);
+	json.value("threads", threadNum);
+
+	auto correct = true;
+	for (auto const scene : { SolverScene::Stack, SolverScene::Pyramid })
+	{
+		auto const bullet = run_solver<btSequentialImpulseConstraintSolverMt>(scene, option);
+		auto const soa = run_solver<SoaContactSolverMt>(scene, option);
+
+		// ŉ̂ŁA͊ۂ߂̕
+		// }jtH[hs_minimumContactManifoldsForBatching菭ȂSoA͎gȂAʂ͓ɂȂ
+		btScalar maxPositionError = 0.;
+		for (std::size_t i = 0; i < bullet.positions.size(); i++)
+			maxPositionError = std::max(maxPositionError, (bullet.positions[i] - soa.positions[i]).length());
+		auto const sceneCorrect = maxPositionError < btScalar(1e-3);
+		correct = correct && sceneCorrect;
+
+		json.beginObject(scene == SolverScene::Stack ? "stack" : "pyramid");
+		json.value("bodies", bullet.positions.size() - 1);
+		json.value("rows_per_step", bullet.rowNum / option.stepNum / static_cast<std::size_t>(option.iterationNum));
+		json.beginObject("iteration_ms_per_step");
+		json.value("bullet_mt", bullet.iterationTime);
+		json.value("soa", soa.iterationTime);
+		json.endObject();
+		json.beginObject("step_ms");
+		json.value("bullet_mt", bullet.stepTime);
+		json.value("soa", soa.stepTime);
+		json.endObject();
+		json.beginObject("rows_per_second");
+		json.value("bullet_mt", bullet.rowsPerSecond);
+		json.value("soa", soa.rowsPerSecond);
+		json.endObject();
+		json.value("speedup", bullet.iterationTime / soa.iterationTime);
+		json.value("soa_faster", soa.iterationTime < bullet.iterationTime);
+		json.value("soa_used", soa.soaUsed);
+		json.value("padding_ratio", soa.paddingRatio);
+		json.value("max_position_error", maxPositionError);
+		json.value("correct", sceneCorrect);
+		json.endObject();
+	}
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
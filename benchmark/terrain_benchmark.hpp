@@ -0,0 +1,405 @@
+#pragma once
+#include"benchmark_utility.hpp"
+#include"../src/HeightfieldPyramid.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdint>
+#include<cstdlib>
+#include<iostream>
+#include<limits>
+#include<memory>
+#include<random>
+#include<string_view>
+#include<vector>
+
+// 傫Ȓn`ւAABB̏dȂAJvZ̐ڐGACAbtHeightfieldTerrainShapePyramidHeightfieldTerrainShapeŔׂ
+// CbuildAcceleratorgbtHeightfieldTerrainShapeƂׂ
+// Op`̏WƐڐG_Aqbg𒲂ׁAƂupdateHeights悤ɒׂ
+
+struct TerrainBenchmarkOption
+{
+	int repeat = 3;
+	// ӂ̊iq_̐
+	int size = 2049;
+	int leafSize = HEIGHTFIELD_PYRAMID_LEAF_SIZE;
+	// buildAccelerator̃`N̑傫
+	int chunkSize = 16;
+	std::size_t boxNum = 2000;
+	// Ԃ̑傫AABBAŕƍ͔Ō߂
+	btScalar boxLength = 12.;
+	std::size_t capsuleNum = 500;
+	std::size_t rayNum = 500;
+	// ͈͂̈ӂ̊iq_̐
+	int patchSize = 33;
+	std::size_t patchNum = 64;
+};
+
+inline void print_terrain_benchmark_usage()
+{
+	std::cerr <<
+		"usage: benchmark terrain [options]\n"
+		"  --repeat <n>             run n times and report the fastest (default 3)\n"
+		"  --size <n>               grid points on each side (default 2049)\n"
+		"  --leaf <n>               cells on each side of a pyramid leaf (default 8)\n"
+		"  --chunk <n>              chunk size of btHeightfieldTerrainShape::buildAccelerator (default 16)\n"
+		"  --boxes <n>              vehicle-sized AABB overlap queries (default 2000)\n"
+		"  --box-length <m>         length of the AABBs (default 12)\n"
+		"  --capsules <n>           capsule contact queries (default 500)\n"
+		"  --rays <n>               line-of-sight rays across the terrain (default 500)\n"
+		"  --patch <n>              grid points on each side of an edited patch (default 33)\n"
+		"  --patches <n>            edited patches (default 64)\n";
+}
+
+// sfalse
+inline bool parse_terrain_benchmark_option(int argc, char** argv, TerrainBenchmarkOption& option)
+{
+	for (int i = 0; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--repeat")
+			option.repeat = std::atoi(value);
+		else if (name == "--size")
+			option.size = std::atoi(value);
+		else if (name == "--leaf")
+			option.leafSize = std::atoi(value);
+		else if (name == "--chunk")
+			option.chunkSize = std::atoi(value);
+		else if (name == "--boxes")
+			option.boxNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--box-length")
+			option.boxLength = static_cast<btScalar>(std::atof(value));
+		else if (name == "--capsules")
+			option.capsuleNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--rays")
+			option.rayNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--patch")
+			option.patchSize = std::atoi(value);
+		else if (name == "--patches")
+			option.patchNum = std::strtoull(value, nullptr, 10);
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.repeat < 1 || option.size < 2 || option.leafSize < 1 || option.chunkSize < 1 || !(option.boxLength > 0) ||
+		option.patchSize < 1 || option.patchSize > option.size) {
+		std::cerr << "invalid option value\n";
+		return false;
+	}
+
+	return true;
+}
+
+// Op`̐ƁAԂɂȂnbV
+struct TerrainTriangleCounter : public btTriangleCallback
+{
+	std::size_t num{};
+	std::uint64_t hash{};
+
+	void processTriangle(btVector3* triangle, int partId, int triangleIndex) override
+	{
+		(void)triangle;
+		auto key = (static_cast<std::uint64_t>(static_cast<std::uint32_t>(partId)) << 32 | static_cast<std::uint32_t>(triangleIndex)) * 0x9E3779B97F4A7C15ull;
+		key ^= key >> 29;
+		num++;
+		hash += key;
+	}
+};
+
+// uƒJn`̍
+inline float terrain_height(int x, int y)
+{
+	auto const fx = static_cast<double>(x);
+	auto const fy = static_cast<double>(y);
+	auto const hills = 40. * std::sin(fx * 0.011) * std::cos(fy * 0.013) + 12. * std::sin(fx * 0.047 + fy * 0.031);
+	auto const bumps = 1.5 * std::sin(fx * 0.37) * std::sin(fy * 0.41);
+	return static_cast<float>(hills + bumps);
+}
+
+inline int run_terrain_benchmark(int argc, char** argv)
+{
+	TerrainBenchmarkOption option{};
+	if (!parse_terrain_benchmark_option(argc, argv, option)) {
+		print_terrain_benchmark_usage();
+		return 1;
+	}
+
+	auto const size = option.size;
+	std::vector<float> heights(static_cast<std::size_t>(size) * size);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+			heights[static_cast<std::size_t>(y) * size + x] = terrain_height(x, y);
+	}
+	auto const [minIt, maxIt] = std::minmax_element(heights.begin(), heights.end());
+	// Ō@[̕󂯂Ă
+	auto const minHeight = static_cast<btScalar>(*minIt) - 20;
+	auto const maxHeight = static_cast<btScalar>(*maxIt) + 20;
+
+	btHeightfieldTerrainShape plain{ size, size, heights.data(), minHeight, maxHeight, 1, false };
+	btHeightfieldTerrainShape accelerated{ size, size, heights.data(), minHeight, maxHeight, 1, false };
+	accelerated.buildAccelerator(option.chunkSize);
+
+	auto const buildStart = std::chrono::steady_clock::now();
+	PyramidHeightfieldTerrainShape pyramid{ size, size, heights.data(), minHeight, maxHeight, 1, false, option.leafSize };
+	auto const buildTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - buildStart).count();
+
+	// n`͌_ɒûŁA[JWƃ[hW
+	auto const half = static_cast<btScalar>(size - 1) / 2;
+	auto const surface = [&](btScalar x, btScalar z) {
+		auto const gx = std::clamp(static_cast<int>(std::lround(x + half)), 0, size - 1);
+		auto const gz = std::clamp(static_cast<int>(std::lround(z + half)), 0, size - 1);
+		return static_cast<btScalar>(heights[static_cast<std::size_t>(gz) * size + gx]) - (minHeight + maxHeight) / 2;
+	};
+
+	std::mt19937_64 random{ 1 };
+	std::uniform_real_distribution<btScalar> position{ -half * btScalar(0.95), half * btScalar(0.95) };
+	std::uniform_real_distribution<btScalar> unit{ 0, 1 };
+
+	// nʂ畂Ă̂A߂荞ł̂܂
+	struct Box
+	{
+		btVector3 aabbMin{};
+		btVector3 aabbMax{};
+	};
+	std::vector<Box> boxes(option.boxNum);
+	for (auto& box : boxes)
+	{
+		auto const x = position(random);
+		auto const z = position(random);
+		btVector3 const center{ x, surface(x, z) + unit(random) * 6 - 1, z };
+		btVector3 const extent{ option.boxLength * btScalar(0.2), option.boxLength * btScalar(0.15), option.boxLength / 2 };
+		box = { center - extent, center + extent };
+	}
+
+	auto const overlap = [&](btHeightfieldTerrainShape const& shape, std::vector<Box> const& queries) {
+		TerrainTriangleCounter counter{};
+		for (auto const& box : queries)
+			shape.processAllTriangles(&counter, box.aabbMin, box.aabbMax);
+		return counter;
+	};
+	TerrainTriangleCounter plainOverlap{};
+	TerrainTriangleCounter pyramidOverlap{};
+	auto const plainOverlapTime = measure_best(option.repeat, [&] { plainOverlap = overlap(plain, boxes); });
+	auto const pyramidOverlapTime = measure_best(option.repeat, [&] { pyramidOverlap = overlap(pyramid, boxes); });
+	auto correct = plainOverlap.num == pyramidOverlap.num && plainOverlap.hash == pyramidOverlap.hash;
+
+	// JvZbtCollisionWorld::contactPairTestœĂ
+	btDefaultCollisionConfiguration configuration{};
+	btCollisionDispatcher dispatcher{ &configuration };
+	btDbvtBroadphase broadphase{};
+	btCollisionWorld world{ &dispatcher, &broadphase, &configuration };
+
+	btCollisionObject plainObject{};
+	plainObject.setCollisionShape(&plain);
+	btCollisionObject pyramidObject{};
+	pyramidObject.setCollisionShape(&pyramid);
+	btCapsuleShape capsuleShape{ btScalar(0.5), btScalar(2.) };
+	btCollisionObject capsuleObject{};
+	capsuleObject.setCollisionShape(&capsuleShape);
+	world.addCollisionObject(&plainObject);
+	world.addCollisionObject(&pyramidObject);
+	world.addCollisionObject(&capsuleObject);
+
+	std::vector<btTransform> capsules(option.capsuleNum);
+	for (auto& transform : capsules)
+	{
+		auto const x = position(random);
+		auto const z = position(random);
+		btQuaternion const rotation{ btVector3{ unit(random) - btScalar(0.5), unit(random) - btScalar(0.5), unit(random) - btScalar(0.5) }.normalized(),
+			unit(random) * SIMD_2_PI };
+		transform = btTransform{ rotation, btVector3{ x, surface(x, z) + unit(random) * 2 - btScalar(0.5), z } };
+	}
+
+	struct ContactCounter : public btCollisionWorld::ContactResultCallback
+	{
+		std::size_t num{};
+		btScalar minDistance = BT_LARGE_FLOAT;
+		double distanceSum{};
+
+		btScalar addSingleResult(btManifoldPoint& cp, btCollisionObjectWrapper const*, int, int, btCollisionObjectWrapper const*, int, int) override
+		{
+			num++;
+			minDistance = std::min(minDistance, cp.getDistance());
+			distanceSum += cp.getDistance();
+			return 0;
+		}
+	};
+	auto const contact = [&](btCollisionObject& terrain) {
+		ContactCounter counter{};
+		for (auto const& transform : capsules)
+		{
+			capsuleObject.setWorldTransform(transform);
+			world.contactPairTest(&capsuleObject, &terrain, counter);
+		}
+		return counter;
+	};
+	ContactCounter plainContact{};
+	ContactCounter pyramidContact{};
+	auto const plainContactTime = measure_best(option.repeat, [&] { plainContact = contact(plainObject); });
+	auto const pyramidContactTime = measure_best(option.repeat, [&] { pyramidContact = contact(pyramidObject); });
+	correct = correct && plainContact.num == pyramidContact.num && plainContact.minDistance == pyramidContact.minDistance &&
+		std::abs(plainContact.distanceSum - pyramidContact.distanceSum) <= 1e-6 * (1 + std::abs(plainContact.distanceSum));
+
+	// nʂ班2_Ԍʂ̃CAuɓ̂Ɣ̂
+	struct Ray
+	{
+		btVector3 from{};
+		btVector3 to{};
+	};
+	std::vector<Ray> rays(option.rayNum);
+	for (auto& ray : rays)
+	{
+		auto const x0 = position(random);
+		auto const z0 = position(random);
+		auto const x1 = position(random);
+		auto const z1 = position(random);
+		ray = { { x0, surface(x0, z0) + 2 + unit(random) * 30, z0 }, { x1, surface(x1, z1) + 2 + unit(random) * 30, z1 } };
+	}
+
+	struct RayResult
+	{
+		std::size_t hitNum{};
+		std::vector<btScalar> fractions{};
+	};
+	btTransform const identity = btTransform::getIdentity();
+	auto const rayTest = [&](btCollisionObject const& terrain, bool usePyramid, unsigned int flags = 0) {
+		RayResult result{};
+		result.fractions.reserve(rays.size());
+		for (auto const& ray : rays)
+		{
+			btCollisionWorld::ClosestRayResultCallback callback{ ray.from, ray.to };
+			callback.m_flags = flags;
+			if (usePyramid)
+				ray_test_heightfield_pyramid(ray.from, ray.to, &terrain, &pyramid, identity, callback);
+			else
+				btCollisionWorld::rayTestSingle(btTransform{ btMatrix3x3::getIdentity(), ray.from }, btTransform{ btMatrix3x3::getIdentity(), ray.to },
+					const_cast<btCollisionObject*>(&terrain), terrain.getCollisionShape(), identity, callback);
+			result.hitNum += callback.hasHit() ? 1 : 0;
+			result.fractions.push_back(callback.hasHit() ? callback.m_closestHitFraction : btScalar(-1));
+		}
+		return result;
+	};
+
+	btCollisionObject acceleratedObject{};
+	acceleratedObject.setCollisionShape(&accelerated);
+	RayResult plainRay{};
+	RayResult acceleratedRay{};
+	RayResult pyramidRay{};
+	auto const plainRayTime = measure_best(option.repeat, [&] { plainRay = rayTest(plainObject, false); });
+	auto const acceleratedRayTime = measure_best(option.repeat, [&] { acceleratedRay = rayTest(acceleratedObject, false); });
+	auto const pyramidRayTime = measure_best(option.repeat, [&] { pyramidRay = rayTest(pyramidObject, true); });
+
+	auto const sameRays = [](RayResult const& a, RayResult const& b) {
+		if (a.hitNum != b.hitNum)
+			return false;
+		for (std::size_t i = 0; i < a.fractions.size(); i++)
+		{
+			if (std::abs(a.fractions[i] - b.fractions[i]) > btScalar(1e-9))
+				return false;
+		}
+		return true;
+	};
+	// l؂~߂CƂɓ
+	auto const disabledRay = rayTest(pyramidObject, true, btTriangleRaycastCallback::kF_DisableHeightfieldAccelerator);
+	correct = correct && sameRays(plainRay, acceleratedRay) && sameRays(plainRay, pyramidRay) && sameRays(plainRay, disabledRay);
+
+	// @āA͈͂߂Ȃ
+	std::uniform_int_distribution<int> patchPosition{ 0, size - option.patchSize };
+	std::vector<std::pair<int, int>> patches(option.patchNum);
+	for (auto& patch : patches)
+		patch = { patchPosition(random), patchPosition(random) };
+	for (auto const& [px, py] : patches)
+	{
+		for (int y = py; y < py + option.patchSize; y++)
+		{
+			for (int x = px; x < px + option.patchSize; x++)
+			{
+				auto const dx = static_cast<double>(x - px) / option.patchSize - 0.5;
+				auto const dy = static_cast<double>(y - py) / option.patchSize - 0.5;
+				heights[static_cast<std::size_t>(y) * size + x] -= static_cast<float>(std::max(0., 10. * (0.25 - dx * dx - dy * dy)));
+			}
+		}
+	}
+
+	double updateTime{};
+	for (auto const& [px, py] : patches)
+	{
+		auto const start = std::chrono::steady_clock::now();
+		pyramid.updateHeights(px, py, px + option.patchSize - 1, py + option.patchSize - 1);
+		updateTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	auto const rebuildTime = measure_best(1, [&] { pyramid.buildPyramid(); });
+	for (auto const& [px, py] : patches)
+		pyramid.updateHeights(px, py, px + option.patchSize - 1, py + option.patchSize - 1);
+
+	// @ꏊɒuAABBŁAƂOp`Ԃ
+	std::vector<Box> patchBoxes{};
+	for (auto const& [px, py] : patches)
+	{
+		auto const x = static_cast<btScalar>(px + option.patchSize / 2) - half;
+		auto const z = static_cast<btScalar>(py + option.patchSize / 2) - half;
+		for (auto const lift : { btScalar(-4), btScalar(-1), btScalar(2) })
+		{
+			btVector3 const center{ x, surface(x, z) + lift, z };
+			btVector3 const extent{ option.boxLength * btScalar(0.2), option.boxLength * btScalar(0.15), option.boxLength / 2 };
+			patchBoxes.push_back({ center - extent, center + extent });
+		}
+	}
+	auto const plainPatch = overlap(plain, patchBoxes);
+	auto const pyramidPatch = overlap(pyramid, patchBoxes);
+	correct = correct && plainPatch.num == pyramidPatch.num && plainPatch.hash == pyramidPatch.hash;
+
+	world.removeCollisionObject(&capsuleObject);
+	world.removeCollisionObject(&pyramidObject);
+	world.removeCollisionObject(&plainObject);
+
+	JsonWriter json{ std::cout };
+
+	json.beginObject();
+	json.value("benchmark", "terrain");
+	json.value("repeat", option.repeat);
+	json.value("grid_points", size);
+	json.value("leaf_size", option.leafSize);
+	json.value("chunk_size", option.chunkSize);
+	json.value("pyramid_levels", pyramid.getLevelNum());
+	json.value("pyramid_nodes", pyramid.getNodeNum());
+
+	json.beginObject("ms");
+	json.value("pyramid_build", buildTime * 1e3);
+	json.value("box_overlap_plain", plainOverlapTime * 1e3);
+	json.value("box_overlap_pyramid", pyramidOverlapTime * 1e3);
+	json.value("capsule_contact_plain", plainContactTime * 1e3);
+	json.value("capsule_contact_pyramid", pyramidContactTime * 1e3);
+	json.value("ray_plain", plainRayTime * 1e3);
+	json.value("ray_accelerator", acceleratedRayTime * 1e3);
+	json.value("ray_pyramid", pyramidRayTime * 1e3);
+	json.value("update_patches", updateTime * 1e3);
+	json.value("rebuild", rebuildTime * 1e3);
+	json.endObject();
+
+	json.value("boxes", boxes.size());
+	json.value("box_triangles", pyramidOverlap.num);
+	json.value("capsules", capsules.size());
+	json.value("capsule_contacts", pyramidContact.num);
+	json.value("rays", rays.size());
+	json.value("ray_hits", pyramidRay.hitNum);
+	json.value("patches", patches.size());
+
+	json.value("correct", correct);
+	json.endObject();
+
+	return correct ? 0 : 1;
+}
@@ -111,7 +111,15 @@ static inline __m128 btSimdDot3(__m128 vec0, __m128 vec1)
 }
 
 #if defined(BT_ALLOW_SSE4)
+#if defined(_MSC_VER)
 #include <intrin.h>
+#define BT_SSE4_1_FMA3_TARGET
+#else
+#include <immintrin.h>
+// GCC/Clang only emit SSE4.1/FMA3 instructions inside functions that ask for them,
+// the functions are only called when btCpuFeatureUtility reports both features
+#define BT_SSE4_1_FMA3_TARGET __attribute__((target("sse4.1,fma")))
+#endif
 
 #define USE_FMA 1
 #define USE_FMA3_INSTEAD_FMA4 1
@@ -178,6 +186,9 @@ static btScalar gResolveSingleConstraintRowGeneric_sse2(btSolverBody& bodyA, btS
 }
 
 // Enhanced version of gResolveSingleConstraintRowGeneric_sse2 with SSE4.1 and FMA3
+#if defined(BT_ALLOW_SSE4)
+BT_SSE4_1_FMA3_TARGET
+#endif
 static btScalar gResolveSingleConstraintRowGeneric_sse4_1_fma3(btSolverBody& bodyA, btSolverBody& bodyB, const btSolverConstraint& c)
 {
 #if defined(BT_ALLOW_SSE4)
@@ -233,6 +244,9 @@ static btScalar gResolveSingleConstraintRowLowerLimit_sse2(btSolverBody& bodyA,
 }
 
 // Enhanced version of gResolveSingleConstraintRowGeneric_sse2 with SSE4.1 and FMA3
+#if defined(BT_ALLOW_SSE4)
+BT_SSE4_1_FMA3_TARGET
+#endif
 static btScalar gResolveSingleConstraintRowLowerLimit_sse4_1_fma3(btSolverBody& bodyA, btSolverBody& bodyB, const btSolverConstraint& c)
 {
 #ifdef BT_ALLOW_SSE4
@@ -7,10 +7,16 @@
 #include <string.h>  //memset
 #ifdef USE_SIMD
 #include <emmintrin.h>
-#ifdef BT_ALLOW_SSE4
-#include <intrin.h>
-#endif  //BT_ALLOW_SSE4
 #endif  //USE_SIMD
+//cpuid is also queried in scalar builds so that benchmarks can report what the CPU supports
+#if defined(BT_ALLOW_SSE4) || (!defined(_M_ARM) && !defined(_M_ARM64) && (defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)))
+#define BT_CPU_FEATURE_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif  //BT_CPU_FEATURE_X86
 
 #if defined BT_USE_NEON
 #define ARM_NEON_GCC_COMPATIBILITY 1
@@ -19,16 +25,50 @@
 #include <sys/sysctl.h>  //for sysctlbyname
 #endif                   //BT_USE_NEON
 
-///Rudimentary btCpuFeatureUtility for CPU features: only report the features that Bullet actually uses (SSE4/FMA3, NEON_HPFP)
+///Rudimentary btCpuFeatureUtility for CPU features: only report the features that Bullet actually uses (SSE4/FMA3, AVX2, NEON_HPFP)
 ///We assume SSE2 in case BT_USE_SSE2 is defined in LinearMath/btScalar.h
 class btCpuFeatureUtility
 {
+	static void cpuid(int cpuInfo[4], int leaf)
+	{
+#if defined(BT_CPU_FEATURE_X86)
+#if defined(_MSC_VER)
+		__cpuidex(cpuInfo, leaf, 0);
+#else
+		unsigned int regs[4] = {0, 0, 0, 0};
+		__cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+		memcpy(cpuInfo, regs, sizeof(regs));
+#endif
+#else
+		(void)leaf;
+		memset(cpuInfo, 0, sizeof(int) * 4);
+#endif
+	}
+
+	static unsigned long long xgetbv()
+	{
+#if defined(BT_CPU_FEATURE_X86)
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__ __volatile__("xgetbv"
+							 : "=a"(eax), "=d"(edx)
+							 : "c"(0));
+		return ((unsigned long long)edx << 32) | eax;
+#endif
+#else
+		return 0;
+#endif
+	}
+
 public:
 	enum btCpuFeature
 	{
 		CPU_FEATURE_FMA3 = 1,
 		CPU_FEATURE_SSE4_1 = 2,
-		CPU_FEATURE_NEON_HPFP = 4
+		CPU_FEATURE_NEON_HPFP = 4,
+		CPU_FEATURE_AVX2 = 8
 	};
 
 	static int getCpuFeatures()
@@ -50,19 +90,21 @@ public:
 		}
 #endif  //BT_USE_NEON
 
-#ifdef BT_ALLOW_SSE4
+#ifdef BT_CPU_FEATURE_X86
 		{
 			int cpuInfo[4];
 			memset(cpuInfo, 0, sizeof(cpuInfo));
 			unsigned long long sseExt = 0;
-			__cpuid(cpuInfo, 1);
+			cpuid(cpuInfo, 0);
+			const int maxLeaf = cpuInfo[0];
+			cpuid(cpuInfo, 1);
 
 			bool osUsesXSAVE_XRSTORE = cpuInfo[2] & (1 << 27) || false;
 			bool cpuAVXSuport = cpuInfo[2] & (1 << 28) || false;
 
 			if (osUsesXSAVE_XRSTORE && cpuAVXSuport)
 			{
-				sseExt = _xgetbv(0);
+				sseExt = xgetbv();
 			}
 			const int OSXSAVEFlag = (1UL << 27);
 			const int AVXFlag = ((1UL << 28) | OSXSAVEFlag);
@@ -77,8 +119,20 @@ public:
 			{
 				capabilities |= btCpuFeatureUtility::CPU_FEATURE_SSE4_1;
 			}
+
+			// AVX2 needs the OS to save the YMM state as well
+			if (maxLeaf >= 7 && osUsesXSAVE_XRSTORE && cpuAVXSuport && (sseExt & 6) == 6)
+			{
+				int extendedInfo[4];
+				cpuid(extendedInfo, 7);
+				const int AVX2Flag = (1 << 5);
+				if (extendedInfo[1] & AVX2Flag)
+				{
+					capabilities |= btCpuFeatureUtility::CPU_FEATURE_AVX2;
+				}
+			}
 		}
-#endif  //BT_ALLOW_SSE4
+#endif  //BT_CPU_FEATURE_X86
 
 		testedCapabilities = true;
 		return capabilities;
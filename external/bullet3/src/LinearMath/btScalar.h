@@ -275,6 +275,39 @@ inline int btIsDoublePrecision()
 				#define btLikely(_c)  _c
 				#define btUnlikely(_c) _c
 
+			#elif (defined (__i386__) || defined (__x86_64__)) && defined (__SSE2__) && (defined (__GNUC__) || defined (__clang__)) && (!defined (BT_USE_DOUBLE_PRECISION)) && (!defined (__BT_DISABLE_SSE__))
+				//GCC and Clang on x86/x86-64 (Linux, BSD): same SSE path as MSVC on Windows
+				#define BT_USE_SIMD_VECTOR3
+				#define BT_USE_SSE
+				//BT_USE_SSE_IN_API stays disabled, like on Windows, so that Bullet structs can be embedded without 16-byte alignment
+				#if defined (__SSE4_1__)
+					#include <smmintrin.h>
+				#else
+					#include <emmintrin.h>
+				#endif
+				//the SSE4.1/FMA3 constraint row solvers are compiled with a function target attribute
+				//and selected at runtime through btCpuFeatureUtility, so -msse4.1/-mfma are not required
+				#define BT_ALLOW_SSE4
+
+				#define SIMD_FORCE_INLINE inline __attribute__ ((always_inline))
+				#define ATTRIBUTE_ALIGNED16(a) a __attribute__ ((aligned (16)))
+				#define ATTRIBUTE_ALIGNED64(a) a __attribute__ ((aligned (64)))
+				#define ATTRIBUTE_ALIGNED128(a) a __attribute__ ((aligned (128)))
+				#ifndef assert
+				#include <assert.h>
+				#endif
+
+				#if defined(DEBUG) || defined (_DEBUG)
+					#define btAssert assert
+				#else
+					#define btAssert(x)
+				#endif
+
+				//btFullAssert is optional, slows down a lot
+				#define btFullAssert(x)
+				#define btLikely(_c)   __builtin_expect((_c), 1)
+				#define btUnlikely(_c) __builtin_expect((_c), 0)
+
 			#else//__APPLE__
 
 				#define SIMD_FORCE_INLINE inline
@@ -0,0 +1,507 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include<Windows.h>
+#include<Psapi.h>
+#pragma comment(lib, "Psapi.lib")
+#else
+#include<sys/resource.h>
+#endif
+#include"../src/Profiler.hpp"
+#include"../src/Scene.hpp"
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<cstdlib>
+#include<fstream>
+#include<iostream>
+#include<numeric>
+#include<string>
+#include<string_view>
+#include<thread>
+#include<vector>
+
+// EBhE炸main.cppƓV[񂵁AvʂJSONŏo͂
+
+constexpr std::size_t MAX_CHAIN_NUM = 10000;
+
+struct HeadlessOption
+{
+	std::size_t chainNum = 1;
+	std::size_t stepNum = 1000;
+	std::size_t warmupStepNum = 60;
+	double timeStep = 1. / 60.;
+	int maxSubSteps = 1;
+	std::string outputFileName{};
+
+	// falseȂJvZƔGJKAEPAŉ
+	bool capsuleBoxAlgorithm = true;
+	// falseȂbtHashedOverlappingPairCache
+	bool openAddressingPairCache = false;
+	// 傫AChSoaContactSolverMtŉ
+	bool soaContactSolver = false;
+	// AChIncrementalIslandManagerŎ
+	bool incrementalIslands = false;
+	// }jtH[hƏՓ˃ASYSlabAllocator
+	bool slabAllocator = false;
+
+	bool multithread = false;
+	int threadNum = 0;
+	int dispatcherGrainSize = 40;
+	int minimumSolverBatchSize = 128;
+	int solverMinBatchSize = 50;
+	int solverMaxBatchSize = 100;
+	bool parallelBroadphase = false;
+
+	// 1XbhSRA܂ŃXbhςČv
+	bool scaling = false;
+
+	// łȂΌvXebṽg[Xo
+	std::string traceFileName{};
+};
+
+struct StepLatency
+{
+	double mean{};
+	double p50{};
+	double p90{};
+	double p99{};
+	double max{};
+};
+
+struct RunResult
+{
+	int threadNum{};
+	int rigidBodyNum{};
+	int constraintNum{};
+	double setupTime{};
+	StepLatency latency{};
+	double stepsPerSec{};
+	// --tracêƂASTEP_PROFILE_ZONESƂ1Xebv̕
+	std::vector<double> profileTimes{};
+	// --slab-allocator̂Ƃ
+	SlabAllocatorStats manifoldSlab{};
+	SlabAllocatorStats algorithmSlab{};
+};
+
+inline void print_usage()
+{
+	std::cerr <<
+		"usage: headless [options]\n"
+		"  --chains <n>             number of chains to copy (1-" << MAX_CHAIN_NUM << ", default 1)\n"
+		"  --steps <n>              number of measured steps (default 1000)\n"
+		"  --warmup <n>             number of steps before measuring (default 60)\n"
+		"  --dt <seconds>           time step passed to stepSimulation (default 1/60)\n"
+		"  --substeps <n>           maxSubSteps passed to stepSimulation (default 1)\n"
+		"  --output <file>          write the JSON report to a file instead of stdout\n"
+		"  --gjk-capsule-box        collide capsules and boxes with GJK/EPA instead of the analytic algorithm\n"
+		"  --open-addressing-pairs  use OpenAddressingPairCache instead of btHashedOverlappingPairCache\n"
+		"  --soa-solver             solve contacts of large islands with SoaContactSolverMt\n"
+		"  --incremental-islands    keep simulation islands across steps with IncrementalIslandManager\n"
+		"  --slab-allocator         allocate manifolds and collision algorithms from growable slabs\n"
+		"  --mt                     use the multithreaded world, dispatcher and solver\n"
+		"  --threads <n>            number of threads for --mt (default all cores)\n"
+		"  --dispatcher-grain <n>   pairs per task in btCollisionDispatcherMt (default 40)\n"
+		"  --island-batch <n>       minimum constraints per island batch (default 128)\n"
+		"  --solver-batch <min> <max>\n"
+		"                           constraints per batch in btSequentialImpulseConstraintSolverMt (default 50 100)\n"
+		"  --parallel-broadphase    update AABBs and find broadphase pairs in parallel with --mt\n"
+		"  --scaling                run --mt with 1, 2, 4, ... threads up to all cores\n"
+		"  --trace <file>           profile the measured steps and write a Chrome trace (chrome://tracing, Perfetto)\n";
+}
+
+// sfalse
+inline bool parse_option(int argc, char** argv, HeadlessOption& option)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+
+		if (name == "--help" || name == "-h")
+			return false;
+
+		// lȂIvV
+		if (name == "--mt") {
+			option.multithread = true;
+			continue;
+		}
+		if (name == "--gjk-capsule-box") {
+			option.capsuleBoxAlgorithm = false;
+			continue;
+		}
+		if (name == "--open-addressing-pairs") {
+			option.openAddressingPairCache = true;
+			continue;
+		}
+		if (name == "--soa-solver") {
+			option.soaContactSolver = true;
+			continue;
+		}
+		if (name == "--incremental-islands") {
+			option.incrementalIslands = true;
+			continue;
+		}
+		if (name == "--slab-allocator") {
+			option.slabAllocator = true;
+			continue;
+		}
+		if (name == "--parallel-broadphase") {
+			option.multithread = true;
+			option.parallelBroadphase = true;
+			continue;
+		}
+		if (name == "--scaling") {
+			option.multithread = true;
+			option.scaling = true;
+			continue;
+		}
+
+		if (i + 1 >= argc || (name == "--solver-batch" && i + 2 >= argc)) {
+			std::cerr << "missing value for " << name << "\n";
+			return false;
+		}
+		char const* value = argv[++i];
+
+		if (name == "--chains")
+			option.chainNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--steps")
+			option.stepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--warmup")
+			option.warmupStepNum = std::strtoull(value, nullptr, 10);
+		else if (name == "--dt")
+			option.timeStep = std::strtod(value, nullptr);
+		else if (name == "--substeps")
+			option.maxSubSteps = std::atoi(value);
+		else if (name == "--output")
+			option.outputFileName = value;
+		else if (name == "--trace")
+			option.traceFileName = value;
+		else if (name == "--threads")
+			option.threadNum = std::atoi(value);
+		else if (name == "--dispatcher-grain")
+			option.dispatcherGrainSize = std::atoi(value);
+		else if (name == "--island-batch")
+			option.minimumSolverBatchSize = std::atoi(value);
+		else if (name == "--solver-batch") {
+			option.solverMinBatchSize = std::atoi(value);
+			option.solverMaxBatchSize = std::atoi(argv[++i]);
+		}
+		else {
+			std::cerr << "unknown option " << name << "\n";
+			return false;
+		}
+	}
+
+	if (option.chainNum < 1 || option.chainNum > MAX_CHAIN_NUM) {
+		std::cerr << "--chains must be in [1, " << MAX_CHAIN_NUM << "]\n";
+		return false;
+	}
+	if (option.stepNum < 1 || option.timeStep <= 0. || option.maxSubSteps < 0) {
+		std::cerr << "invalid --steps, --dt or --substeps\n";
+		return false;
+	}
+	if (option.threadNum < 0 || option.dispatcherGrainSize < 1 || option.minimumSolverBatchSize < 1 ||
+		option.solverMinBatchSize < 1 || option.solverMaxBatchSize < option.solverMinBatchSize) {
+		std::cerr << "invalid --threads, --dispatcher-grain, --island-batch or --solver-batch\n";
+		return false;
+	}
+
+	return true;
+}
+
+// oCgP
+inline std::size_t get_peak_memory()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+	return 0;
+#endif
+}
+
+// ~bPʂ̊eXebv̎Ԃ
+inline StepLatency calc_latency(std::vector<double> latencies)
+{
+	std::sort(latencies.begin(), latencies.end());
+
+	auto percentile = [&latencies](double p) {
+		auto const index = static_cast<std::size_t>(p * static_cast<double>(latencies.size() - 1) + 0.5);
+		return latencies[std::min(index, latencies.size() - 1)];
+	};
+
+	return {
+		.mean = std::accumulate(latencies.begin(), latencies.end(), 0.) / static_cast<double>(latencies.size()),
+		.p50 = percentile(0.5),
+		.p90 = percentile(0.9),
+		.p99 = percentile(0.99),
+		.max = latencies.back(),
+	};
+}
+
+// threadNum--mt̂Ƃg
+// --tracêƂ͌vCxgtraceEventsɑ
+inline RunResult run(HeadlessOption const& option, int threadNum, std::vector<ProfileEvent>& traceEvents)
+{
+	auto const setupStart = std::chrono::steady_clock::now();
+	Scene scene{ {
+		.chainNum = option.chainNum,
+		.capsuleBoxAlgorithm = option.capsuleBoxAlgorithm,
+		.multithread = option.multithread,
+		.threadNum = threadNum,
+		.dispatcherGrainSize = option.dispatcherGrainSize,
+		.minimumSolverBatchSize = option.minimumSolverBatchSize,
+		.solverMinBatchSize = option.solverMinBatchSize,
+		.solverMaxBatchSize = option.solverMaxBatchSize,
+		.parallelBroadphase = option.parallelBroadphase,
+		.openAddressingPairCache = option.openAddressingPairCache,
+		.soaContactSolver = option.soaContactSolver,
+		.incrementalIslands = option.incrementalIslands,
+		.slabAllocator = option.slabAllocator,
+	} };
+	auto const setupTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setupStart).count();
+
+	auto dynamicsWorld = scene.getDynamicsWorld();
+
+	for (std::size_t i = 0; i < option.warmupStepNum; i++)
+		dynamicsWorld->stepSimulation(option.timeStep, option.maxSubSteps);
+
+	std::vector<double> latencies{};
+	latencies.reserve(option.stepNum);
+
+	// EH[Abv̌ォLɂ
+	auto const tracing = !option.traceFileName.empty();
+	ProfileFrameHistory profileHistory{ get_step_profile_zone_names(), option.stepNum };
+	if (tracing) {
+		get_profiler().setEnabled(true);
+		profileHistory.startCapture();
+	}
+
+	auto const runStart = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < option.stepNum; i++)
+	{
+		auto const stepStart = std::chrono::steady_clock::now();
+		dynamicsWorld->stepSimulation(option.timeStep, option.maxSubSteps);
+		latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count());
+
+		if (tracing) {
+			PROFILE_COUNTER("manifolds", dynamicsWorld->getDispatcher()->getNumManifolds());
+			profileHistory.endFrame(get_profiler());
+		}
+	}
+	auto const runTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+	std::vector<double> profileTimes{};
+	if (tracing)
+	{
+		get_profiler().setEnabled(false);
+		auto const events = profileHistory.getCapturedEvents();
+		traceEvents.insert(traceEvents.end(), events.begin(), events.end());
+
+		for (std::size_t i = 0; i < profileHistory.getZoneNames().size(); i++)
+			profileTimes.push_back(profileHistory.getAverageZoneTime(i));
+	}
+
+	SlabAllocatorStats manifoldSlab{};
+	SlabAllocatorStats algorithmSlab{};
+	if (option.slabAllocator) {
+		manifoldSlab = scene.getManifoldAllocator()->getStats();
+		algorithmSlab = scene.getAlgorithmAllocator()->getStats();
+	}
+
+	return {
+		.threadNum = scene.getThreadNum(),
+		.rigidBodyNum = dynamicsWorld->getNumCollisionObjects(),
+		.constraintNum = dynamicsWorld->getNumConstraints(),
+		.setupTime = setupTime,
+		.latency = calc_latency(latencies),
+		.stepsPerSec = static_cast<double>(option.stepNum) / runTime,
+		.profileTimes = std::move(profileTimes),
+		.manifoldSlab = manifoldSlab,
+		.algorithmSlab = algorithmSlab,
+	};
+}
+
+inline void write_step_ms(std::ostream& out, StepLatency const& latency, char const* indent)
+{
+	out << "{\n"
+		<< indent << "  \"mean\": " << latency.mean << ",\n"
+		<< indent << "  \"p50\": " << latency.p50 << ",\n"
+		<< indent << "  \"p90\": " << latency.p90 << ",\n"
+		<< indent << "  \"p99\": " << latency.p99 << ",\n"
+		<< indent << "  \"max\": " << latency.max << "\n"
+		<< indent << "}";
+}
+
+inline void write_profile_ms(std::ostream& out, std::vector<double> const& profileTimes, char const* indent)
+{
+	out << "{\n";
+	for (std::size_t i = 0; i < profileTimes.size(); i++)
+		out << indent << "  \"" << STEP_PROFILE_ZONES[i].label << "\": " << profileTimes[i] << (i + 1 < profileTimes.size() ? "," : "") << "\n";
+	out << indent << "}";
+}
+
+inline void write_slab_stats(std::ostream& out, SlabAllocatorStats const& stats, char const* indent)
+{
+	out << "{\n"
+		<< indent << "  \"element_bytes\": " << stats.elementSize << ",\n"
+		<< indent << "  \"chunks\": " << stats.chunkNum << ",\n"
+		<< indent << "  \"capacity\": " << stats.capacity << ",\n"
+		<< indent << "  \"reserved_bytes\": " << stats.reservedBytes << ",\n"
+		<< indent << "  \"used\": " << stats.usedNum << ",\n"
+		<< indent << "  \"high_water\": " << stats.highWaterNum << ",\n"
+		<< indent << "  \"allocations\": " << stats.allocateNum << ",\n"
+		<< indent << "  \"fallbacks\": " << stats.fallbackNum << ",\n"
+		<< indent << "  \"refills\": " << stats.refillNum << "\n"
+		<< indent << "}";
+}
+
+int main(int argc, char** argv)
+{
+	HeadlessOption option{};
+	if (!parse_option(argc, argv, option)) {
+		print_usage();
+		return 1;
+	}
+
+	if (option.multithread && !get_task_scheduler()) {
+		std::cerr << "--mt requires Bullet built with BT_THREADSAFE\n";
+		return 1;
+	}
+
+	get_profiler().setThreadName("main");
+	std::vector<ProfileEvent> traceEvents{};
+
+	std::vector<RunResult> results{};
+	if (option.scaling)
+	{
+		// 1, 2, 4, ... ƑSRA
+		auto const maxThreadNum = get_task_scheduler()->getMaxNumThreads();
+		for (int threadNum = 1; threadNum < maxThreadNum; threadNum *= 2)
+			results.push_back(run(option, threadNum, traceEvents));
+		results.push_back(run(option, maxThreadNum, traceEvents));
+	}
+	else
+	{
+		results.push_back(run(option, option.threadNum, traceEvents));
+	}
+
+	if (!option.traceFileName.empty())
+	{
+		std::ofstream traceFile{ option.traceFileName };
+		if (!traceFile) {
+			std::cerr << "failed to open " << option.traceFileName << "\n";
+			return 1;
+		}
+		write_chrome_trace(traceFile, traceEvents, get_profiler().getThreadNames());
+	}
+
+	std::ofstream file{};
+	if (!option.outputFileName.empty()) {
+		file.open(option.outputFileName);
+		if (!file) {
+			std::cerr << "failed to open " << option.outputFileName << "\n";
+			return 1;
+		}
+	}
+	std::ostream& out = option.outputFileName.empty() ? std::cout : file;
+
+	auto const& first = results.front();
+
+	out << "{\n"
+		<< "  \"chains\": " << option.chainNum << ",\n"
+		<< "  \"rigid_bodies\": " << first.rigidBodyNum << ",\n"
+		<< "  \"constraints\": " << first.constraintNum << ",\n"
+		<< "  \"steps\": " << option.stepNum << ",\n"
+		<< "  \"warmup_steps\": " << option.warmupStepNum << ",\n"
+		<< "  \"time_step\": " << option.timeStep << ",\n"
+		<< "  \"max_sub_steps\": " << option.maxSubSteps << ",\n"
+		<< "  \"capsule_box\": \"" << (option.capsuleBoxAlgorithm ? "analytic" : "gjk") << "\",\n"
+		<< "  \"pair_cache\": \"" << (option.openAddressingPairCache ? "open_addressing" : "hashed") << "\",\n"
+		<< "  \"contact_solver\": \"" << (option.soaContactSolver ? "soa" : "sequential_impulse") << "\",\n"
+		<< "  \"island_manager\": \"" << (option.incrementalIslands ? "incremental" : "union_find") << "\",\n"
+		<< "  \"allocator\": \"" << (option.slabAllocator ? "slab" : "pool") << "\",\n"
+		<< "  \"multithread\": " << (option.multithread ? "true" : "false") << ",\n";
+
+	if (option.multithread)
+	{
+		out << "  \"dispatcher_grain_size\": " << option.dispatcherGrainSize << ",\n"
+			<< "  \"minimum_solver_batch_size\": " << option.minimumSolverBatchSize << ",\n"
+			<< "  \"solver_batch_size\": [" << option.solverMinBatchSize << ", " << option.solverMaxBatchSize << "],\n"
+			<< "  \"parallel_broadphase\": " << (option.parallelBroadphase ? "true" : "false") << ",\n"
+			<< "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n";
+	}
+
+	if (option.scaling)
+	{
+		// 1Xbhɑ΂鑬x㗦ƁAXbhŊ
+		// 0.5ƂXP[ȂȂ_Ƃ݂Ȃ
+		int stopsScalingAt = 0;
+
+		out << "  \"runs\": [\n";
+		for (std::size_t i = 0; i < results.size(); i++)
+		{
+			auto const& result = results[i];
+			auto const speedup = result.stepsPerSec / first.stepsPerSec;
+			auto const efficiency = speedup / result.threadNum;
+			if (stopsScalingAt == 0 && i > 0 && efficiency < 0.5)
+				stopsScalingAt = result.threadNum;
+
+			out << "    {\n"
+				<< "      \"threads\": " << result.threadNum << ",\n"
+				<< "      \"setup_ms\": " << result.setupTime << ",\n"
+				<< "      \"step_ms\": ";
+			write_step_ms(out, result.latency, "      ");
+			out << ",\n";
+			if (!result.profileTimes.empty()) {
+				out << "      \"profile_ms\": ";
+				write_profile_ms(out, result.profileTimes, "      ");
+				out << ",\n";
+			}
+			out << "      \"steps_per_sec\": " << result.stepsPerSec << ",\n"
+				<< "      \"speedup\": " << speedup << ",\n"
+				<< "      \"efficiency\": " << efficiency << "\n"
+				<< "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+
+		auto const best = std::max_element(results.begin(), results.end(),
+			[](RunResult const& a, RunResult const& b) { return a.stepsPerSec < b.stepsPerSec; });
+
+		out << "  ],\n"
+			<< "  \"best_threads\": " << best->threadNum << ",\n"
+			<< "  \"stops_scaling_at\": " << stopsScalingAt << ",\n";
+	}
+	else
+	{
+		out << "  \"threads\": " << first.threadNum << ",\n"
+			<< "  \"setup_ms\": " << first.setupTime << ",\n"
+			<< "  \"step_ms\": ";
+		write_step_ms(out, first.latency, "  ");
+		out << ",\n";
+		if (!first.profileTimes.empty()) {
+			out << "  \"profile_ms\": ";
+			write_profile_ms(out, first.profileTimes, "  ");
+			out << ",\n";
+		}
+		out << "  \"steps_per_sec\": " << first.stepsPerSec << ",\n";
+	}
+
+	// v[̑傫߂邽߂̐A--scalingȂŏ̎s̕
+	if (option.slabAllocator)
+	{
+		out << "  \"manifold_slab\": ";
+		write_slab_stats(out, first.manifoldSlab, "  ");
+		out << ",\n  \"algorithm_slab\": ";
+		write_slab_stats(out, first.algorithmSlab, "  ");
+		out << ",\n";
+	}
+
+	out << "  \"peak_memory_bytes\": " << get_peak_memory() << "\n"
+		<< "}\n";
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include"../src/mesh_cache.hpp"
+#include<iostream>
+#include<string>
+#include<string_view>
+#include<vector>
+
+// OBJ烁bṼLbVOč
+// Av͋Nload_meshœLbVg
+
+inline void print_usage()
+{
+	std::cerr <<
+		"usage: meshcache [options] <obj file>...\n"
+		"  writes <obj file>" << MESH_CACHE_EXTENSION << " next to each file\n"
+		"  --force     rewrite the cache even if it is up to date\n"
+		"  --check     only report whether each cache is up to date, exit 1 if any is stale\n";
+}
+
+int main(int argc, char** argv)
+{
+	bool force = false;
+	bool check = false;
+	std::vector<char const*> fileNames{};
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view const name{ argv[i] };
+		if (name == "--help" || name == "-h") {
+			print_usage();
+			return 0;
+		}
+		else if (name == "--force")
+			force = true;
+		else if (name == "--check")
+			check = true;
+		else if (name.starts_with("--")) {
+			std::cerr << "unknown option " << name << "\n";
+			print_usage();
+			return 1;
+		}
+		else
+			fileNames.push_back(argv[i]);
+	}
+
+	if (fileNames.empty()) {
+		print_usage();
+		return 1;
+	}
+
+	int result = 0;
+	for (auto fileName : fileNames)
+	{
+		try {
+			MappedFile source{ fileName };
+			auto const sourceSize = static_cast<std::uint64_t>(source.getSize());
+			auto const sourceHash = hash_mesh_source(source.getView());
+			auto const cacheFileName = std::string{ fileName } + MESH_CACHE_EXTENSION;
+
+			bool const upToDate = open_mesh_cache(cacheFileName.c_str(), sourceSize, sourceHash).has_value();
+
+			if (check) {
+				std::cout << fileName << ": " << (upToDate ? "up to date" : "stale") << "\n";
+				if (!upToDate)
+					result = 1;
+				continue;
+			}
+
+			if (upToDate && !force) {
+				std::cout << fileName << ": up to date\n";
+				continue;
+			}
+
+			auto const mesh = parse_obj(source.getView());
+			write_mesh_cache(cacheFileName.c_str(), mesh, sourceSize, sourceHash);
+			std::cout << fileName << ": wrote " << cacheFileName << " (" << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles)\n";
+		}
+		catch (std::exception const& e) {
+			std::cerr << fileName << ": " << e.what() << "\n";
+			result = 1;
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,505 @@
+#pragma once
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include"HeightfieldPyramid.hpp"
+#include<algorithm>
+#include<bit>
+#include<cmath>
+#include<cstdint>
+#include<span>
+
+// 1{̃C
+// tB^btCollisionWorld::RayResultCallbackneedsCollisionƓ
+struct RayQuery
+{
+	btVector3 from{ 0,0,0 };
+	btVector3 to{ 0,0,0 };
+	int collisionFilterGroup = btBroadphaseProxy::DefaultFilter;
+	int collisionFilterMask = btBroadphaseProxy::AllFilter;
+};
+
+// ԋ߂qbgAcollisionObjectnullptrȂqbgȂ
+// btCollisionWorld::ClosestRayResultCallbackƓA@̓[hWAhitPointWorldfromto̕
+struct RayQueryHit
+{
+	btCollisionObject const* collisionObject = nullptr;
+	btScalar hitFraction = 1.;
+	btVector3 hitNormalWorld{ 0,0,0 };
+	btVector3 hitPointWorld{ 0,0,0 };
+};
+
+// PACKET_SIZE{̃CSoAŎ
+// e[̃[v͕ȂŏĂ̂ŁARpCSSE2AAVX2̃xNg߂ɂ
+// BulletSSE͒PxȂ̂ŁA{xłSIMDɂȂ悤intrinsics͎gȂ
+struct RayPacket
+{
+	static constexpr int PACKET_SIZE = 8;
+	using Mask = std::uint32_t;
+
+	alignas(32) btScalar fromX[PACKET_SIZE]{};
+	alignas(32) btScalar fromY[PACKET_SIZE]{};
+	alignas(32) btScalar fromZ[PACKET_SIZE]{};
+	alignas(32) btScalar dirX[PACKET_SIZE]{};
+	alignas(32) btScalar dirY[PACKET_SIZE]{};
+	alignas(32) btScalar dirZ[PACKET_SIZE]{};
+	alignas(32) btScalar invDirX[PACKET_SIZE]{};
+	alignas(32) btScalar invDirY[PACKET_SIZE]{};
+	alignas(32) btScalar invDirZ[PACKET_SIZE]{};
+	// ܂łňԋ߂qbghitFractionA艓߂͌Ȃ
+	alignas(32) btScalar maxFraction[PACKET_SIZE]{};
+	int collisionFilterGroup[PACKET_SIZE]{};
+	int collisionFilterMask[PACKET_SIZE]{};
+	int num = 0;
+};
+
+// [Ƃ̃qbgA[̃[vŏł߂̂RayQueryHitɈڂ
+struct RayPacketHits
+{
+	alignas(32) btScalar fraction[RayPacket::PACKET_SIZE]{};
+	alignas(32) btScalar normalX[RayPacket::PACKET_SIZE]{};
+	alignas(32) btScalar normalY[RayPacket::PACKET_SIZE]{};
+	alignas(32) btScalar normalZ[RayPacket::PACKET_SIZE]{};
+};
+
+// őPACKET_SIZE{̃CpPbgɂAinverseDirectionbtCollisionWorld::rayTestƓ0̐BT_LARGE_FLOATɂ
+void make_ray_packet(std::span<RayQuery const> queries, RayPacket& packet);
+
+// mask̃[̂A̐ςhitFraction܂ł̋ԂŌ郌[
+RayPacket::Mask intersect_ray_packet_aabb(RayPacket const& packet, btVector3 const& aabbMin, btVector3 const& aabbMax, RayPacket::Mask mask);
+
+// O狅AAJvZɓ[ԂAhitsɓ
+// fromɂ郌ChitFraction 0œAkF_UseGjkConvexCastRaytesttbtCollisionWorld::rayTestSingleƓ
+// ̂Ƃ̖@̓C̋t
+// ̓}[W܂߂傫Ap̓}[W̕ۂȂȂ
+RayPacket::Mask intersect_ray_packet_sphere(RayPacket const& packet, btVector3 const& center, btScalar radius, RayPacket::Mask mask, RayPacketHits& hits);
+RayPacket::Mask intersect_ray_packet_box(RayPacket const& packet, btTransform const& transform, btVector3 const& halfExtent, RayPacket::Mask mask, RayPacketHits& hits);
+RayPacket::Mask intersect_ray_packet_capsule(RayPacket const& packet, btTransform const& transform, int upAxis, btScalar halfHeight, btScalar radius,
+	RayPacket::Mask mask, RayPacketHits& hits);
+
+// [ĩqbgAinsideȂ0ƃC̋tɂ
+void write_ray_packet_hit(RayPacket const& packet, int i, bool inside, btScalar fraction, btVector3 const& normal, RayPacketHits& hits);
+
+// C܂Ƃ߂btDbvtBroadphase̖؂ɓAꂼԋ߂qbgԂ
+// ؂PACKET_SIZE{ǂ̂ŁAƎn_߂CłقǑ
+// AAJvZ͉͓IɃpPbĝ܂ܓāAȊObtCollisionWorld::rayTestSingle1{n
+// ^XNXPW[΃pPbgƂɕɂAʂ̓XbhɂȂ
+// u[htF[YbtDbvtBroadphasełȂbtCollisionWorld::rayTest1{Ă
+class BatchRayQuery
+{
+	btCollisionWorld* world = nullptr;
+	btDbvtBroadphase* broadphase = nullptr;
+
+	int grainSize = 16;
+
+public:
+	BatchRayQuery(btCollisionWorld* world);
+	virtual ~BatchRayQuery() = default;
+	BatchRayQuery(BatchRayQuery const&) = delete;
+	BatchRayQuery& operator=(BatchRayQuery const&) = delete;
+
+	// hitsqueriesƓ
+	void rayTest(std::span<RayQuery const> queries, std::span<RayQueryHit> hits) const;
+
+	// 1^XÑpPbg
+	void setGrainSize(int size) noexcept;
+
+private:
+	void rayTestPacket(std::span<RayQuery const> queries, std::span<RayQueryHit> hits, btAlignedObjectArray<std::pair<btDbvtNode const*, RayPacket::Mask>>& stack) const;
+	void rayTestLeaf(RayPacket& packet, btDbvtNode const* leaf, RayPacket::Mask mask, std::span<RayQuery const> queries, std::span<RayQueryHit> hits) const;
+};
+
+//
+// ȉA
+//
+
+inline void make_ray_packet(std::span<RayQuery const> queries, RayPacket& packet)
+{
+	packet.num = static_cast<int>(std::min<std::size_t>(queries.size(), RayPacket::PACKET_SIZE));
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+	{
+		// ][̓}XNŊÔŁA0̃CɂĂ
+		auto const& query = queries[std::min(i, packet.num - 1)];
+		auto const dir = query.to - query.from;
+		packet.fromX[i] = query.from.x();
+		packet.fromY[i] = query.from.y();
+		packet.fromZ[i] = query.from.z();
+		packet.dirX[i] = dir.x();
+		packet.dirY[i] = dir.y();
+		packet.dirZ[i] = dir.z();
+		packet.invDirX[i] = dir.x() == btScalar(0.) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.) / dir.x();
+		packet.invDirY[i] = dir.y() == btScalar(0.) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.) / dir.y();
+		packet.invDirZ[i] = dir.z() == btScalar(0.) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.) / dir.z();
+		packet.maxFraction[i] = btScalar(1.);
+		packet.collisionFilterGroup[i] = query.collisionFilterGroup;
+		packet.collisionFilterMask[i] = query.collisionFilterMask;
+	}
+}
+
+inline RayPacket::Mask intersect_ray_packet_aabb(RayPacket const& packet, btVector3 const& aabbMin, btVector3 const& aabbMax, RayPacket::Mask mask)
+{
+	bool hit[RayPacket::PACKET_SIZE];
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+	{
+		auto const x0 = (aabbMin.x() - packet.fromX[i]) * packet.invDirX[i];
+		auto const x1 = (aabbMax.x() - packet.fromX[i]) * packet.invDirX[i];
+		auto const y0 = (aabbMin.y() - packet.fromY[i]) * packet.invDirY[i];
+		auto const y1 = (aabbMax.y() - packet.fromY[i]) * packet.invDirY[i];
+		auto const z0 = (aabbMin.z() - packet.fromZ[i]) * packet.invDirZ[i];
+		auto const z1 = (aabbMax.z() - packet.fromZ[i]) * packet.invDirZ[i];
+		auto const tMin = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), btScalar(0.)));
+		auto const tMax = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), packet.maxFraction[i]));
+		hit[i] = tMin <= tMax;
+	}
+
+	RayPacket::Mask result = 0;
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+		result |= RayPacket::Mask{ hit[i] } << i;
+	return result & mask;
+}
+
+inline RayPacket::Mask intersect_ray_packet_sphere(RayPacket const& packet, btVector3 const& center, btScalar radius, RayPacket::Mask mask, RayPacketHits& hits)
+{
+	bool hit[RayPacket::PACKET_SIZE];
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+	{
+		auto const ox = packet.fromX[i] - center.x();
+		auto const oy = packet.fromY[i] - center.y();
+		auto const oz = packet.fromZ[i] - center.z();
+		auto const a = packet.dirX[i] * packet.dirX[i] + packet.dirY[i] * packet.dirY[i] + packet.dirZ[i] * packet.dirZ[i];
+		auto const b = ox * packet.dirX[i] + oy * packet.dirY[i] + oz * packet.dirZ[i];
+		auto const c = ox * ox + oy * oy + oz * oz - radius * radius;
+		auto const discriminant = b * b - a * c;
+		auto const t = (-b - std::sqrt(std::max(discriminant, btScalar(0.)))) / std::max(a, SIMD_EPSILON);
+		auto const inside = c <= btScalar(0.);
+		hit[i] = inside || (discriminant >= btScalar(0.) && t >= btScalar(0.) && t < packet.maxFraction[i]);
+
+		auto const invRadius = btScalar(1.) / radius;
+		btVector3 const normal{ (ox + t * packet.dirX[i]) * invRadius, (oy + t * packet.dirY[i]) * invRadius, (oz + t * packet.dirZ[i]) * invRadius };
+		write_ray_packet_hit(packet, i, inside, t, normal, hits);
+	}
+
+	RayPacket::Mask result = 0;
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+		result |= RayPacket::Mask{ hit[i] } << i;
+	return result & mask;
+}
+
+inline RayPacket::Mask intersect_ray_packet_box(RayPacket const& packet, btTransform const& transform, btVector3 const& halfExtent, RayPacket::Mask mask, RayPacketHits& hits)
+{
+	auto const& basis = transform.getBasis();
+	auto const& origin = transform.getOrigin();
+
+	bool hit[RayPacket::PACKET_SIZE];
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+	{
+		// ̃[JWɈڂA]̓]u
+		btScalar const o[3]{ packet.fromX[i] - origin.x(), packet.fromY[i] - origin.y(), packet.fromZ[i] - origin.z() };
+		btScalar const d[3]{ packet.dirX[i], packet.dirY[i], packet.dirZ[i] };
+		btScalar localFrom[3];
+		btScalar localDir[3];
+		for (int j = 0; j < 3; j++)
+		{
+			localFrom[j] = basis[0][j] * o[0] + basis[1][j] * o[1] + basis[2][j] * o[2];
+			localDir[j] = basis[0][j] * d[0] + basis[1][j] * d[1] + basis[2][j] * d[2];
+		}
+
+		// ʂ̎ƌꏏɋ߂
+		auto tEnter = -btScalar(BT_LARGE_FLOAT);
+		auto tExit = btScalar(BT_LARGE_FLOAT);
+		btScalar normal[3]{};
+		for (int j = 0; j < 3; j++)
+		{
+			auto const invDir = localDir[j] == btScalar(0.) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.) / localDir[j];
+			auto const t0 = (-halfExtent[j] - localFrom[j]) * invDir;
+			auto const t1 = (halfExtent[j] - localFrom[j]) * invDir;
+			auto const tNear = std::min(t0, t1);
+			auto const isEnter = tNear > tEnter;
+			tEnter = isEnter ? tNear : tEnter;
+			tExit = std::min(tExit, std::max(t0, t1));
+			for (int k = 0; k < 3; k++)
+				normal[k] = isEnter ? (k == j ? (localDir[j] > btScalar(0.) ? btScalar(-1.) : btScalar(1.)) : btScalar(0.)) : normal[k];
+		}
+		auto const inside = std::abs(localFrom[0]) <= halfExtent[0] && std::abs(localFrom[1]) <= halfExtent[1] && std::abs(localFrom[2]) <= halfExtent[2];
+		hit[i] = inside || (tEnter >= btScalar(0.) && tEnter <= tExit && tEnter < packet.maxFraction[i]);
+		write_ray_packet_hit(packet, i, inside, tEnter, basis * btVector3(normal[0], normal[1], normal[2]), hits);
+	}
+
+	RayPacket::Mask result = 0;
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+		result |= RayPacket::Mask{ hit[i] } << i;
+	return result & mask;
+}
+
+inline RayPacket::Mask intersect_ray_packet_capsule(RayPacket const& packet, btTransform const& transform, int upAxis, btScalar halfHeight, btScalar radius,
+	RayPacket::Mask mask, RayPacketHits& hits)
+{
+	auto const& basis = transform.getBasis();
+	auto const& origin = transform.getOrigin();
+	auto const radius2 = radius * radius;
+
+	bool hit[RayPacket::PACKET_SIZE];
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+	{
+		btScalar const o[3]{ packet.fromX[i] - origin.x(), packet.fromY[i] - origin.y(), packet.fromZ[i] - origin.z() };
+		btScalar const d[3]{ packet.dirX[i], packet.dirY[i], packet.dirZ[i] };
+		btScalar localFrom[3];
+		btScalar localDir[3];
+		for (int j = 0; j < 3; j++)
+		{
+			localFrom[j] = basis[0][j] * o[0] + basis[1][j] * o[1] + basis[2][j] * o[2];
+			localDir[j] = basis[0][j] * d[0] + basis[1][j] * d[1] + basis[2][j] * d[2];
+		}
+
+		// ƐȐŖ̉~ɓĂ
+		btScalar a{}, b{}, c{};
+		for (int j = 0; j < 3; j++)
+		{
+			auto const isRadial = j != upAxis;
+			a += isRadial ? localDir[j] * localDir[j] : btScalar(0.);
+			b += isRadial ? localFrom[j] * localDir[j] : btScalar(0.);
+			c += isRadial ? localFrom[j] * localFrom[j] : btScalar(0.);
+		}
+		c -= radius2;
+		auto const cylinderDiscriminant = b * b - a * c;
+		auto const tCylinder = (-b - std::sqrt(std::max(cylinderDiscriminant, btScalar(0.)))) / std::max(a, SIMD_EPSILON);
+		auto const axial = localFrom[upAxis] + tCylinder * localDir[upAxis];
+		auto const hitCylinder = a > SIMD_EPSILON && cylinderDiscriminant >= btScalar(0.) && std::abs(axial) <= halfHeight;
+
+		// [͉̔~ɓ鑤Ă΂悢AƕsȂiތ̎O
+		auto const parallelCap = localDir[upAxis] > btScalar(0.) ? -halfHeight : halfHeight;
+		auto const capCenter = a > SIMD_EPSILON ? std::clamp(axial, -halfHeight, halfHeight) : parallelCap;
+		btScalar oc[3];
+		for (int j = 0; j < 3; j++)
+			oc[j] = j == upAxis ? localFrom[j] - capCenter : localFrom[j];
+		auto const capA = localDir[0] * localDir[0] + localDir[1] * localDir[1] + localDir[2] * localDir[2];
+		auto const capB = oc[0] * localDir[0] + oc[1] * localDir[1] + oc[2] * localDir[2];
+		auto const capC = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - radius2;
+		auto const capDiscriminant = capB * capB - capA * capC;
+		auto const tCap = (-capB - std::sqrt(std::max(capDiscriminant, btScalar(0.)))) / std::max(capA, SIMD_EPSILON);
+		auto const hitCap = !hitCylinder && capDiscriminant >= btScalar(0.);
+
+		auto const nearest = std::clamp(localFrom[upAxis], -halfHeight, halfHeight);
+		auto const inside = c + (localFrom[upAxis] - nearest) * (localFrom[upAxis] - nearest) <= btScalar(0.);
+
+		auto const t = hitCylinder ? tCylinder : tCap;
+		hit[i] = inside || ((hitCylinder || hitCap) && t >= btScalar(0.) && t < packet.maxFraction[i]);
+
+		btScalar normal[3];
+		for (int j = 0; j < 3; j++)
+		{
+			auto const p = localFrom[j] + t * localDir[j];
+			normal[j] = (j == upAxis ? p - (hitCylinder ? p : capCenter) : p) / radius;
+		}
+		write_ray_packet_hit(packet, i, inside, t, basis * btVector3(normal[0], normal[1], normal[2]), hits);
+	}
+
+	RayPacket::Mask result = 0;
+	for (int i = 0; i < RayPacket::PACKET_SIZE; i++)
+		result |= RayPacket::Mask{ hit[i] } << i;
+	return result & mask;
+}
+
+inline void write_ray_packet_hit(RayPacket const& packet, int i, bool inside, btScalar fraction, btVector3 const& normal, RayPacketHits& hits)
+{
+	auto const backward = -btVector3(packet.dirX[i], packet.dirY[i], packet.dirZ[i]).safeNormalize();
+	hits.fraction[i] = inside ? btScalar(0.) : fraction;
+	hits.normalX[i] = inside ? backward.x() : normal.x();
+	hits.normalY[i] = inside ? backward.y() : normal.y();
+	hits.normalZ[i] = inside ? backward.z() : normal.z();
+}
+
+inline BatchRayQuery::BatchRayQuery(btCollisionWorld* world)
+	: world{ world },
+	broadphase{ dynamic_cast<btDbvtBroadphase*>(world->getBroadphase()) }
+{
+}
+
+inline void BatchRayQuery::rayTest(std::span<RayQuery const> queries, std::span<RayQueryHit> hits) const
+{
+	btAssert(queries.size() == hits.size());
+
+	if (!broadphase)
+	{
+		for (std::size_t i = 0; i < queries.size(); i++)
+		{
+			btCollisionWorld::ClosestRayResultCallback callback{ queries[i].from, queries[i].to };
+			callback.m_collisionFilterGroup = queries[i].collisionFilterGroup;
+			callback.m_collisionFilterMask = queries[i].collisionFilterMask;
+			world->rayTest(queries[i].from, queries[i].to, callback);
+			hits[i] = RayQueryHit{ callback.m_collisionObject, callback.m_closestHitFraction, callback.m_hitNormalWorld, callback.m_hitPointWorld };
+		}
+		return;
+	}
+
+	auto const rayTestPackets = [&](int begin, int end) {
+		btAlignedObjectArray<std::pair<btDbvtNode const*, RayPacket::Mask>> stack{};
+		for (int i = begin; i < end; i++)
+		{
+			auto const offset = static_cast<std::size_t>(i) * RayPacket::PACKET_SIZE;
+			auto const num = std::min<std::size_t>(queries.size() - offset, RayPacket::PACKET_SIZE);
+			rayTestPacket(queries.subspan(offset, num), hits.subspan(offset, num), stack);
+		}
+	};
+
+	auto const packetNum = static_cast<int>((queries.size() + RayPacket::PACKET_SIZE - 1) / RayPacket::PACKET_SIZE);
+	if (btGetTaskScheduler() && packetNum > grainSize)
+	{
+		struct RayTestBody : public btIParallelForBody
+		{
+			decltype(rayTestPackets) const& f;
+			RayTestBody(decltype(rayTestPackets) const& f) : f{ f } {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		} body{ rayTestPackets };
+		btParallelFor(0, packetNum, grainSize, body);
+	}
+	else
+	{
+		rayTestPackets(0, packetNum);
+	}
+}
+
+inline void BatchRayQuery::setGrainSize(int size) noexcept
+{
+	grainSize = std::max(size, 1);
+}
+
+inline void BatchRayQuery::rayTestPacket(std::span<RayQuery const> queries, std::span<RayQueryHit> hits,
+	btAlignedObjectArray<std::pair<btDbvtNode const*, RayPacket::Mask>>& stack) const
+{
+	RayPacket packet{};
+	make_ray_packet(queries, packet);
+	for (auto& hit : hits)
+		hit = RayQueryHit{};
+
+	auto const allLanes = static_cast<RayPacket::Mask>((std::uint64_t{ 1 } << packet.num) - 1);
+
+	// btDbvtBroadphase::rayTestƓ̖؁A~܂̖؂̏Ɍ
+	for (auto const& tree : broadphase->m_sets)
+	{
+		if (!tree.m_root)
+			continue;
+
+		stack.resize(0);
+		stack.push_back({ tree.m_root, allLanes });
+		while (stack.size() > 0)
+		{
+			auto const [node, parentMask] = stack[stack.size() - 1];
+			stack.pop_back();
+
+			// ς񂾌ɋ߂qbgĂΊO郌[
+			auto const mask = intersect_ray_packet_aabb(packet, node->volume.Mins(), node->volume.Maxs(), parentMask);
+			if (!mask)
+				continue;
+
+			if (node->isleaf())
+			{
+				rayTestLeaf(packet, node, mask, queries, hits);
+				continue;
+			}
+
+			// 1{ڂ̃Čŋ߂qɐςŐɌ
+			auto const first = packet.dirX[0] * (node->childs[1]->volume.Center().x() - node->childs[0]->volume.Center().x())
+				+ packet.dirY[0] * (node->childs[1]->volume.Center().y() - node->childs[0]->volume.Center().y())
+				+ packet.dirZ[0] * (node->childs[1]->volume.Center().z() - node->childs[0]->volume.Center().z()) < btScalar(0.) ? 1 : 0;
+			stack.push_back({ node->childs[1 - first], mask });
+			stack.push_back({ node->childs[first], mask });
+		}
+	}
+}
+
+inline void BatchRayQuery::rayTestLeaf(RayPacket& packet, btDbvtNode const* leaf, RayPacket::Mask mask, std::span<RayQuery const> queries, std::span<RayQueryHit> hits) const
+{
+	auto const proxy = static_cast<btBroadphaseProxy const*>(leaf->data);
+	auto const collisionObject = static_cast<btCollisionObject const*>(proxy->m_clientObject);
+
+	for (auto lanes = mask; lanes; lanes &= lanes - 1)
+	{
+		auto const i = std::countr_zero(lanes);
+		auto const needsCollision = (proxy->m_collisionFilterGroup & packet.collisionFilterMask[i]) != 0
+			&& (packet.collisionFilterGroup[i] & proxy->m_collisionFilterMask) != 0;
+		if (!needsCollision)
+			mask &= ~(RayPacket::Mask{ 1 } << i);
+	}
+	if (!mask)
+		return;
+
+	auto const shape = collisionObject->getCollisionShape();
+	auto const& transform = collisionObject->getWorldTransform();
+
+	RayPacketHits packetHits{};
+	RayPacket::Mask hitMask = 0;
+	switch (shape->getShapeType())
+	{
+	case SPHERE_SHAPE_PROXYTYPE:
+		hitMask = intersect_ray_packet_sphere(packet, transform.getOrigin(), static_cast<btSphereShape const*>(shape)->getRadius(), mask, packetHits);
+		break;
+	case BOX_SHAPE_PROXYTYPE:
+		hitMask = intersect_ray_packet_box(packet, transform, static_cast<btBoxShape const*>(shape)->getHalfExtentsWithMargin(), mask, packetHits);
+		break;
+	case CAPSULE_SHAPE_PROXYTYPE:
+	{
+		auto const capsule = static_cast<btCapsuleShape const*>(shape);
+		hitMask = intersect_ray_packet_capsule(packet, transform, capsule->getUpAxis(), capsule->getHalfHeight(), capsule->getRadius(), mask, packetHits);
+		break;
+	}
+	default:
+	{
+		// ̌`btCollisionWorld::ClosestRayResultCallbackƓ悤1{Ă
+		// ͓IɓĂ`ƍ킹āAʌ`ɂGJKg
+		struct LaneCallback : public btCollisionWorld::RayResultCallback
+		{
+			btVector3 hitNormalWorld{ 0,0,0 };
+
+			btScalar addSingleResult(btCollisionWorld::LocalRayResult& rayResult, bool normalInWorldSpace) override
+			{
+				m_closestHitFraction = rayResult.m_hitFraction;
+				m_collisionObject = rayResult.m_collisionObject;
+				hitNormalWorld = normalInWorldSpace ? rayResult.m_hitNormalLocal
+					: m_collisionObject->getWorldTransform().getBasis() * rayResult.m_hitNormalLocal;
+				return rayResult.m_hitFraction;
+			}
+		};
+
+		// l؂̂n`͊̔񉼑zperformRaycastʂɓĂ
+		auto const pyramid = shape->getShapeType() == TERRAIN_SHAPE_PROXYTYPE ? dynamic_cast<PyramidHeightfieldTerrainShape const*>(shape) : nullptr;
+
+		for (auto lanes = mask; lanes; lanes &= lanes - 1)
+		{
+			auto const i = std::countr_zero(lanes);
+			LaneCallback callback{};
+			callback.m_flags = btTriangleRaycastCallback::kF_UseGjkConvexCastRaytest;
+			callback.m_closestHitFraction = packet.maxFraction[i];
+			callback.m_collisionFilterGroup = packet.collisionFilterGroup[i];
+			callback.m_collisionFilterMask = packet.collisionFilterMask[i];
+
+			btTransform rayFrom{ btMatrix3x3::getIdentity(), queries[i].from };
+			btTransform rayTo{ btMatrix3x3::getIdentity(), queries[i].to };
+			if (pyramid)
+				ray_test_heightfield_pyramid(queries[i].from, queries[i].to, collisionObject, pyramid, transform, callback);
+			else
+				btCollisionWorld::rayTestSingle(rayFrom, rayTo, const_cast<btCollisionObject*>(collisionObject), shape, transform, callback);
+			if (!callback.hasHit())
+				continue;
+
+			hitMask |= RayPacket::Mask{ 1 } << i;
+			packetHits.fraction[i] = callback.m_closestHitFraction;
+			packetHits.normalX[i] = callback.hitNormalWorld.x();
+			packetHits.normalY[i] = callback.hitNormalWorld.y();
+			packetHits.normalZ[i] = callback.hitNormalWorld.z();
+		}
+		break;
+	}
+	}
+
+	for (auto lanes = hitMask; lanes; lanes &= lanes - 1)
+	{
+		auto const i = std::countr_zero(lanes);
+		packet.maxFraction[i] = packetHits.fraction[i];
+		auto& hit = hits[i];
+		hit.collisionObject = collisionObject;
+		hit.hitFraction = packetHits.fraction[i];
+		hit.hitNormalWorld = btVector3{ packetHits.normalX[i], packetHits.normalY[i], packetHits.normalZ[i] };
+		hit.hitPointWorld.setInterpolate3(queries[i].from, queries[i].to, packetHits.fraction[i]);
+	}
+}
@@ -0,0 +1,663 @@
+#pragma once
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/BulletCollision/BroadphaseCollision/btDbvt.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btCollisionCreateFunc.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btCompoundCompoundCollisionAlgorithm.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btHashedSimplePairCache.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btManifoldResult.h"
+#include"../external/bullet3/src/LinearMath/btAabbUtil2.h"
+#include"../external/bullet3/src/LinearMath/btQuickprof.h"
+#include<algorithm>
+#include<cstddef>
+#include<cstdint>
+#include<span>
+#include<vector>
+
+// qq̐̂̕1ȏȂAtH炸ɖ؂̓m[hSĒ
+constexpr std::size_t BATCHED_COMPOUND_FULL_REFIT_RATIO = 8;
+
+// ̎q𖈃t[btCompoundShape
+// btCompoundShape::updateChildTransform͗t1؂Oē꒼AłrecalculateLocalAabbőSĂ̎q̂ŁA
+// K̎qSēO(K^2)ɂȂ
+// updateChildTransforms͗tAABBĂA؂̌`ςɓm[hAABB1ŒA[JAABB͍
+// qƂɍŌɓԍABatchedCompoundCompoundCollisionAlgorithmĂȂq̃yA𒲂גȂ悤ɂ
+// btCompoundShape*ʂupdateChildTransformĂԂƓƂ킩Ȃ̂ŁAq͂̃NX̊֐œ
+// ؂̌`͍ŏ̔zû܂܂Ȃ̂ŁAq傫ւcreateAabbTreeFromChildrenō蒼
+class BatchedCompoundShape : public btCompoundShape
+{
+	// qƂɍŌɓƂmoveStampAxĂȂq0
+	std::vector<std::uint64_t> childMoveStamps{};
+	std::uint64_t moveStamp = 0;
+	// ؂̓m[heɂȂ悤ɕׂ
+	std::vector<btDbvtNode*> refitNodes{};
+
+	void setChildTransform(int childIndex, btTransform const& transform);
+	void refitAll();
+	void refitAncestors(btDbvtNode const* leaf);
+	void finishUpdate(bool shouldRecalculateLocalAabb);
+
+public:
+	explicit BatchedCompoundShape(bool enableDynamicAabbTree = true, int initialChildCapacity = 0);
+	virtual ~BatchedCompoundShape() = default;
+	BatchedCompoundShape(BatchedCompoundShape const&) = delete;
+	BatchedCompoundShape& operator=(BatchedCompoundShape const&) = delete;
+
+	// childIndices[i]̎q̕ϊtransforms[i]ɂ
+	// ؂΃[JAABB͍̂ŏɒA؂ȂshouldRecalculateLocalAabb̂Ƃ1񂾂SĂ̎q
+	void updateChildTransforms(std::span<int const> childIndices, std::span<btTransform const> transforms, bool shouldRecalculateLocalAabb = true);
+	// SĂ̎q̕ϊɒu
+	void updateChildTransforms(std::span<btTransform const> transforms, bool shouldRecalculateLocalAabb = true);
+	// btCompoundShape::updateChildTransformBāAƂL^
+	void updateChildTransform(int childIndex, btTransform const& newChildTransform, bool shouldRecalculateLocalAabb = true);
+
+	void setLocalScaling(btVector3 const& scaling) override;
+
+	// q𓮂тɑ
+	std::uint64_t getMoveStamp() const noexcept { return moveStamp; }
+	std::uint64_t getChildMoveStamp(int childIndex) const noexcept;
+	// ؂̗tAABBA؂Ƃg
+	btDbvtVolume const& getChildVolume(int childIndex) const { return m_children[childIndex].m_node->volume; }
+};
+
+// btCompoundCompoundCollisionAlgorithmƓq̃yAŐڐG邪AĂȂq̃yA͒גȂ
+// 2̂̕̕ϊƋ̂lOƓȂAO񂩂瓮ĂȂqǂ̏dȂ͕ςȂ̂ŁA
+// dȂȂȂyAOƂAABBvZȂ
+// ɂǂBatchedCompoundShapeȂA؂ǂH炸ɑO񏈗yÂ̎qĂȂ̂͂̂܂܏A
+// q̗tő̖؂𒲂ׂ
+// ʂbtCompoundShape̎q͖񓮂̂ƂĈ
+class BatchedCompoundCompoundCollisionAlgorithm : public btCompoundCollisionAlgorithm
+{
+	btHashedSimplePairCache* childAlgorithmCache = nullptr;
+	btSimplePairArray removePairs{};
+	int compoundShapeRevision0 = 0;
+	int compoundShapeRevision1 = 0;
+
+	// OyA𒲂ׂƂ̒u
+	bool validated = false;
+	btTransform lastTransform0{};
+	btTransform lastTransform1{};
+	btScalar lastThreshold{};
+	std::uint64_t lastMoveStamp0 = 0;
+	std::uint64_t lastMoveStamp1 = 0;
+
+	// O񏈗q̃yAALbVɎcĂ̂ŃASY͂̂܂܎g
+	struct ChildPair
+	{
+		int childIndex0 = 0;
+		int childIndex1 = 0;
+		btCollisionAlgorithm* algorithm = nullptr;
+	};
+	std::vector<ChildPair> processedPairs{};
+	std::vector<ChildPair> previousPairs{};
+	std::vector<int> movedChildren0{};
+	std::vector<int> movedChildren1{};
+
+	void removeChildPairs();
+	// ؂̗t̃yAAABB𒲂ׁAdȂĂΎq̃ASYď
+	void processLeafPair(btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, int childIndex0, int childIndex1,
+		btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut);
+	void processChildPair(btCollisionObjectWrapper const* childWrap0, btCollisionObjectWrapper const* childWrap1, int childIndex0, int childIndex1,
+		btCollisionAlgorithm* algorithm, btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut);
+
+public:
+	BatchedCompoundCompoundCollisionAlgorithm(btCollisionAlgorithmConstructionInfo const& ci, btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, bool isSwapped);
+	virtual ~BatchedCompoundCompoundCollisionAlgorithm();
+	BatchedCompoundCompoundCollisionAlgorithm(BatchedCompoundCompoundCollisionAlgorithm const&) = delete;
+	BatchedCompoundCompoundCollisionAlgorithm& operator=(BatchedCompoundCompoundCollisionAlgorithm const&) = delete;
+
+	void processCollision(btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut) override;
+	btScalar calculateTimeOfImpact(btCollisionObject* body0, btCollisionObject* body1, btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut) override;
+	void getAllContactManifolds(btManifoldArray& manifoldArray) override;
+
+	struct CreateFunc : public btCollisionAlgorithmCreateFunc
+	{
+		btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap) override;
+	};
+};
+
+// 1AABBxformŖ0̍WɈڂÂlL
+btDbvtVolume transform_compound_volume(btDbvtVolume const& volume, btTransform const& xform, btScalar distanceThreshold);
+
+// 2̖؂̗t̃yÂA1̗ttransform_compound_volumeňڂAABBdȂ̂processĂ
+// btCompoundCompoundCollisionAlgorithmMycollideTTƓɒH
+template<class F>
+void collide_compound_trees(btDbvtNode const* root0, btDbvtNode const* root1, btTransform const& xform, btScalar distanceThreshold, F&& process);
+
+// intersect^ɂȂm[hHAtprocessĂ
+// q1̗tƑ̖؂Acollide_compound_treesƓŒׂ̂Ɏg
+template<class Intersect, class F>
+void collide_compound_tree(btDbvtNode const* root, Intersect&& intersect, F&& process);
+
+// ASỸv[̗vfBatchedCompoundCompoundCollisionAlgorithm傫ɂ
+btDefaultCollisionConstructionInfo batched_compound_construction_info(btDefaultCollisionConstructionInfo constructionInfo);
+
+// `ǂ̃yABatchedCompoundCompoundCollisionAlgorithmg
+// ŋߓ_߂NGp̃ASY͊̂܂
+class BatchedCompoundCollisionConfiguration : public btDefaultCollisionConfiguration
+{
+	BatchedCompoundCompoundCollisionAlgorithm::CreateFunc compoundCompoundCreateFunc{};
+
+public:
+	BatchedCompoundCollisionConfiguration(btDefaultCollisionConstructionInfo const& constructionInfo = btDefaultCollisionConstructionInfo());
+	virtual ~BatchedCompoundCollisionConfiguration() = default;
+	BatchedCompoundCollisionConfiguration(BatchedCompoundCollisionConfiguration const&) = delete;
+	BatchedCompoundCollisionConfiguration& operator=(BatchedCompoundCollisionConfiguration const&) = delete;
+
+	btCollisionAlgorithmCreateFunc* getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1) override;
+};
+
+
+//
+// ȉA
+//
+
+
+inline BatchedCompoundShape::BatchedCompoundShape(bool enableDynamicAabbTree, int initialChildCapacity)
+	: btCompoundShape(enableDynamicAabbTree, initialChildCapacity)
+{
+}
+
+inline void BatchedCompoundShape::setChildTransform(int childIndex, btTransform const& transform)
+{
+	btAssert(0 <= childIndex && childIndex < m_children.size());
+	auto& child = m_children[childIndex];
+	child.m_transform = transform;
+	childMoveStamps[childIndex] = moveStamp;
+
+	// tAABBAm[h͌ł܂Ƃ߂Ē
+	if (m_dynamicAabbTree) {
+		btVector3 aabbMin{}, aabbMax{};
+		child.m_childShape->getAabb(transform, aabbMin, aabbMax);
+		child.m_node->volume = btDbvtVolume::FromMM(aabbMin, aabbMax);
+	}
+}
+
+inline void BatchedCompoundShape::refitAll()
+{
+	BT_PROFILE("BatchedCompoundShape::refitAll");
+	refitNodes.clear();
+	auto const root = m_dynamicAabbTree->m_root;
+	if (!root || root->isleaf())
+		return;
+
+	refitNodes.push_back(root);
+	for (std::size_t i = 0; i < refitNodes.size(); i++)
+	{
+		for (auto const child : refitNodes[i]->childs)
+		{
+			if (child->isinternal())
+				refitNodes.push_back(child);
+		}
+	}
+
+	// q͐eɂ̂ŁA납璼Ύqɒ
+	for (auto it = refitNodes.rbegin(); it != refitNodes.rend(); ++it)
+		Merge((*it)->childs[0]->volume, (*it)->childs[1]->volume, (*it)->volume);
+}
+
+inline void BatchedCompoundShape::refitAncestors(btDbvtNode const* leaf)
+{
+	// ςȂm[h́AOɒHtŒĂ
+	for (auto node = leaf->parent; node; node = node->parent)
+	{
+		auto const previous = node->volume;
+		Merge(node->childs[0]->volume, node->childs[1]->volume, node->volume);
+		if (!NotEqual(previous, node->volume))
+			break;
+	}
+}
+
+inline void BatchedCompoundShape::finishUpdate(bool shouldRecalculateLocalAabb)
+{
+	// m[h͎qAABB킹̂Ȃ̂ŁArecalculateLocalAabbŋ߂̂ƓɂȂ
+	if (m_dynamicAabbTree && m_dynamicAabbTree->m_root) {
+		m_localAabbMin = m_dynamicAabbTree->m_root->volume.Mins();
+		m_localAabbMax = m_dynamicAabbTree->m_root->volume.Maxs();
+	}
+	else if (shouldRecalculateLocalAabb) {
+		recalculateLocalAabb();
+	}
+}
+
+inline void BatchedCompoundShape::updateChildTransforms(std::span<int const> childIndices, std::span<btTransform const> transforms, bool shouldRecalculateLocalAabb)
+{
+	BT_PROFILE("BatchedCompoundShape::updateChildTransforms");
+	btAssert(childIndices.size() == transforms.size());
+	if (childIndices.empty())
+		return;
+
+	auto const childNum = static_cast<std::size_t>(m_children.size());
+	childMoveStamps.resize(childNum);
+	moveStamp++;
+	for (std::size_t i = 0; i < childIndices.size(); i++)
+		setChildTransform(childIndices[i], transforms[i]);
+
+	if (m_dynamicAabbTree) {
+		if (childIndices.size() * BATCHED_COMPOUND_FULL_REFIT_RATIO >= childNum) {
+			refitAll();
+		}
+		else {
+			for (auto const childIndex : childIndices)
+				refitAncestors(m_children[childIndex].m_node);
+		}
+	}
+	finishUpdate(shouldRecalculateLocalAabb);
+}
+
+inline void BatchedCompoundShape::updateChildTransforms(std::span<btTransform const> transforms, bool shouldRecalculateLocalAabb)
+{
+	BT_PROFILE("BatchedCompoundShape::updateChildTransforms");
+	btAssert(transforms.size() == static_cast<std::size_t>(m_children.size()));
+	if (transforms.empty())
+		return;
+
+	childMoveStamps.resize(transforms.size());
+	moveStamp++;
+	for (std::size_t i = 0; i < transforms.size(); i++)
+		setChildTransform(static_cast<int>(i), transforms[i]);
+
+	if (m_dynamicAabbTree)
+		refitAll();
+	finishUpdate(shouldRecalculateLocalAabb);
+}
+
+inline void BatchedCompoundShape::updateChildTransform(int childIndex, btTransform const& newChildTransform, bool shouldRecalculateLocalAabb)
+{
+	updateChildTransforms(std::span{ &childIndex, 1 }, std::span{ &newChildTransform, 1 }, shouldRecalculateLocalAabb);
+}
+
+inline void BatchedCompoundShape::setLocalScaling(btVector3 const& scaling)
+{
+	// SĂ̎q̕ϊς
+	btCompoundShape::setLocalScaling(scaling);
+	moveStamp++;
+	childMoveStamps.assign(static_cast<std::size_t>(m_children.size()), moveStamp);
+}
+
+inline std::uint64_t BatchedCompoundShape::getChildMoveStamp(int childIndex) const noexcept
+{
+	return static_cast<std::size_t>(childIndex) < childMoveStamps.size() ? childMoveStamps[childIndex] : 0;
+}
+
+
+inline btDbvtVolume transform_compound_volume(btDbvtVolume const& volume, btTransform const& xform, btScalar distanceThreshold)
+{
+	btVector3 const thresholdVec{ distanceThreshold, distanceThreshold, distanceThreshold };
+	btVector3 newMin{}, newMax{};
+	btTransformAabb(volume.Mins(), volume.Maxs(), 0, xform, newMin, newMax);
+	return btDbvtVolume::FromMM(newMin - thresholdVec, newMax + thresholdVec);
+}
+
+template<class F>
+inline void collide_compound_trees(btDbvtNode const* root0, btDbvtNode const* root1, btTransform const& xform, btScalar distanceThreshold, F&& process)
+{
+	if (!root0 || !root1)
+		return;
+
+	auto const intersect = [&](btDbvtVolume const& a, btDbvtVolume const& b) {
+		return Intersect(a, transform_compound_volume(b, xform, distanceThreshold));
+	};
+
+	// [̕ςނ̂ŁAقƂǂ̖؂͎茳̔ző
+	btAlignedObjectArray<btDbvt::sStkNN> stack{};
+	ATTRIBUTE_ALIGNED16(btDbvt::sStkNN localStack[btDbvt::DOUBLE_STACKSIZE]);
+	stack.initializeFromBuffer(&localStack, btDbvt::DOUBLE_STACKSIZE, btDbvt::DOUBLE_STACKSIZE);
+	int threshold = btDbvt::DOUBLE_STACKSIZE - 4;
+	int depth = 1;
+	stack[0] = btDbvt::sStkNN(root0, root1);
+	do
+	{
+		auto const p = stack[--depth];
+		if (!intersect(p.a->volume, p.b->volume))
+			continue;
+
+		if (depth > threshold) {
+			stack.resize(stack.size() * 2);
+			threshold = stack.size() - 4;
+		}
+		if (p.a->isinternal()) {
+			if (p.b->isinternal()) {
+				stack[depth++] = btDbvt::sStkNN(p.a->childs[0], p.b->childs[0]);
+				stack[depth++] = btDbvt::sStkNN(p.a->childs[1], p.b->childs[0]);
+				stack[depth++] = btDbvt::sStkNN(p.a->childs[0], p.b->childs[1]);
+				stack[depth++] = btDbvt::sStkNN(p.a->childs[1], p.b->childs[1]);
+			}
+			else {
+				stack[depth++] = btDbvt::sStkNN(p.a->childs[0], p.b);
+				stack[depth++] = btDbvt::sStkNN(p.a->childs[1], p.b);
+			}
+		}
+		else if (p.b->isinternal()) {
+			stack[depth++] = btDbvt::sStkNN(p.a, p.b->childs[0]);
+			stack[depth++] = btDbvt::sStkNN(p.a, p.b->childs[1]);
+		}
+		else {
+			process(p.a->dataAsInt, p.b->dataAsInt);
+		}
+	} while (depth);
+}
+
+
+template<class Intersect, class F>
+inline void collide_compound_tree(btDbvtNode const* root, Intersect&& intersect, F&& process)
+{
+	if (!root)
+		return;
+
+	btAlignedObjectArray<btDbvtNode const*> stack{};
+	btDbvtNode const* localStack[btDbvt::SIMPLE_STACKSIZE];
+	stack.initializeFromBuffer(&localStack, btDbvt::SIMPLE_STACKSIZE, btDbvt::SIMPLE_STACKSIZE);
+	int threshold = btDbvt::SIMPLE_STACKSIZE - 2;
+	int depth = 1;
+	stack[0] = root;
+	do
+	{
+		auto const node = stack[--depth];
+		if (!intersect(node->volume))
+			continue;
+
+		if (node->isleaf()) {
+			process(node->dataAsInt);
+			continue;
+		}
+		if (depth > threshold) {
+			stack.resize(stack.size() * 2);
+			threshold = stack.size() - 2;
+		}
+		stack[depth++] = node->childs[0];
+		stack[depth++] = node->childs[1];
+	} while (depth);
+}
+
+
+inline BatchedCompoundCompoundCollisionAlgorithm::BatchedCompoundCompoundCollisionAlgorithm(btCollisionAlgorithmConstructionInfo const& ci,
+	btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, bool isSwapped)
+	: btCompoundCollisionAlgorithm(ci, body0Wrap, body1Wrap, isSwapped)
+{
+	btAssert(body0Wrap->getCollisionShape()->isCompound() && body1Wrap->getCollisionShape()->isCompound());
+	childAlgorithmCache = new (btAlignedAlloc(sizeof(btHashedSimplePairCache), 16)) btHashedSimplePairCache();
+	compoundShapeRevision0 = static_cast<btCompoundShape const*>(body0Wrap->getCollisionShape())->getUpdateRevision();
+	compoundShapeRevision1 = static_cast<btCompoundShape const*>(body1Wrap->getCollisionShape())->getUpdateRevision();
+}
+
+inline BatchedCompoundCompoundCollisionAlgorithm::~BatchedCompoundCompoundCollisionAlgorithm()
+{
+	removeChildPairs();
+	childAlgorithmCache->~btHashedSimplePairCache();
+	btAlignedFree(childAlgorithmCache);
+}
+
+inline void BatchedCompoundCompoundCollisionAlgorithm::removeChildPairs()
+{
+	auto& pairs = childAlgorithmCache->getOverlappingPairArray();
+	for (int i = 0; i < pairs.size(); i++)
+	{
+		if (auto const algorithm = static_cast<btCollisionAlgorithm*>(pairs[i].m_userPointer)) {
+			algorithm->~btCollisionAlgorithm();
+			m_dispatcher->freeCollisionAlgorithm(algorithm);
+		}
+	}
+	childAlgorithmCache->removeAllPairs();
+	processedPairs.clear();
+	validated = false;
+}
+
+inline void BatchedCompoundCompoundCollisionAlgorithm::processChildPair(btCollisionObjectWrapper const* childWrap0, btCollisionObjectWrapper const* childWrap1, int childIndex0, int childIndex1,
+	btCollisionAlgorithm* algorithm, btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut)
+{
+	auto const wrap0 = resultOut->getBody0Wrap();
+	auto const wrap1 = resultOut->getBody1Wrap();
+	resultOut->setBody0Wrap(childWrap0);
+	resultOut->setBody1Wrap(childWrap1);
+	resultOut->setShapeIdentifiersA(-1, childIndex0);
+	resultOut->setShapeIdentifiersB(-1, childIndex1);
+	algorithm->processCollision(childWrap0, childWrap1, dispatchInfo, resultOut);
+	resultOut->setBody0Wrap(wrap0);
+	resultOut->setBody1Wrap(wrap1);
+}
+
+inline void BatchedCompoundCompoundCollisionAlgorithm::processLeafPair(btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, int childIndex0, int childIndex1,
+	btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut)
+{
+	auto const compoundShape0 = static_cast<btCompoundShape const*>(body0Wrap->getCollisionShape());
+	auto const compoundShape1 = static_cast<btCompoundShape const*>(body1Wrap->getCollisionShape());
+	btAssert(0 <= childIndex0 && childIndex0 < compoundShape0->getNumChildShapes());
+	btAssert(0 <= childIndex1 && childIndex1 < compoundShape1->getNumChildShapes());
+	auto const childShape0 = compoundShape0->getChildShape(childIndex0);
+	auto const childShape1 = compoundShape1->getChildShape(childIndex1);
+	if (gCompoundCompoundChildShapePairCallback && !gCompoundCompoundChildShapePairCallback(childShape0, childShape1))
+		return;
+
+	btTransform const childTransform0 = body0Wrap->getWorldTransform() * compoundShape0->getChildTransform(childIndex0);
+	btTransform const childTransform1 = body1Wrap->getWorldTransform() * compoundShape1->getChildTransform(childIndex1);
+	btVector3 aabbMin0{}, aabbMax0{}, aabbMin1{}, aabbMax1{};
+	childShape0->getAabb(childTransform0, aabbMin0, aabbMax0);
+	childShape1->getAabb(childTransform1, aabbMin1, aabbMax1);
+	auto const threshold = resultOut->m_closestPointDistanceThreshold;
+	btVector3 const thresholdVec{ threshold, threshold, threshold };
+	if (!TestAabbAgainstAabb2(aabbMin0 - thresholdVec, aabbMax0 + thresholdVec, aabbMin1, aabbMax1))
+		return;
+
+	btCollisionObjectWrapper const childWrap0{ body0Wrap, childShape0, body0Wrap->getCollisionObject(), childTransform0, -1, childIndex0 };
+	btCollisionObjectWrapper const childWrap1{ body1Wrap, childShape1, body1Wrap->getCollisionObject(), childTransform1, -1, childIndex1 };
+
+	// ŋߓ_̃NGł̓yAoȂ
+	if (threshold > 0) {
+		auto const algorithm = m_dispatcher->findAlgorithm(&childWrap0, &childWrap1, nullptr, BT_CLOSEST_POINT_ALGORITHMS);
+		processChildPair(&childWrap0, &childWrap1, childIndex0, childIndex1, algorithm, dispatchInfo, resultOut);
+		algorithm->~btCollisionAlgorithm();
+		m_dispatcher->freeCollisionAlgorithm(algorithm);
+		return;
+	}
+
+	auto pair = childAlgorithmCache->findPair(childIndex0, childIndex1);
+	if (!pair) {
+		auto const algorithm = m_dispatcher->findAlgorithm(&childWrap0, &childWrap1, m_sharedManifold, BT_CONTACT_POINT_ALGORITHMS);
+		pair = childAlgorithmCache->addOverlappingPair(childIndex0, childIndex1);
+		pair->m_userPointer = algorithm;
+	}
+	auto const algorithm = static_cast<btCollisionAlgorithm*>(pair->m_userPointer);
+	processChildPair(&childWrap0, &childWrap1, childIndex0, childIndex1, algorithm, dispatchInfo, resultOut);
+	processedPairs.push_back({ childIndex0, childIndex1, algorithm });
+}
+
+inline void BatchedCompoundCompoundCollisionAlgorithm::processCollision(btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut)
+{
+	BT_PROFILE("BatchedCompoundCompoundCollisionAlgorithm::processCollision");
+	auto const compoundShape0 = static_cast<btCompoundShape const*>(body0Wrap->getCollisionShape());
+	auto const compoundShape1 = static_cast<btCompoundShape const*>(body1Wrap->getCollisionShape());
+	auto const tree0 = compoundShape0->getDynamicAabbTree();
+	auto const tree1 = compoundShape1->getDynamicAabbTree();
+	if (!tree0 || !tree1)
+		return btCompoundCollisionAlgorithm::processCollision(body0Wrap, body1Wrap, dispatchInfo, resultOut);
+
+	// q𑫂O肵Aq̔ԍςĂ
+	if (compoundShape0->getUpdateRevision() != compoundShapeRevision0 || compoundShape1->getUpdateRevision() != compoundShapeRevision1) {
+		removeChildPairs();
+		compoundShapeRevision0 = compoundShape0->getUpdateRevision();
+		compoundShapeRevision1 = compoundShape1->getUpdateRevision();
+	}
+
+	auto& pairs = childAlgorithmCache->getOverlappingPairArray();
+
+	// q̃}jtH[h̐ڐG_̕ϊōXV
+	{
+		btManifoldArray manifoldArray{};
+		btPersistentManifold* localManifolds[4];
+		manifoldArray.initializeFromBuffer(&localManifolds, 0, 4);
+		for (int i = 0; i < pairs.size(); i++)
+		{
+			auto const algorithm = static_cast<btCollisionAlgorithm*>(pairs[i].m_userPointer);
+			if (!algorithm)
+				continue;
+
+			algorithm->getAllContactManifolds(manifoldArray);
+			for (int m = 0; m < manifoldArray.size(); m++)
+			{
+				if (manifoldArray[m]->getNumContacts()) {
+					resultOut->setPersistentManifold(manifoldArray[m]);
+					resultOut->refreshContactPoints();
+					resultOut->setPersistentManifold(nullptr);
+				}
+			}
+			manifoldArray.resize(0);
+		}
+	}
+
+	auto const& transform0 = body0Wrap->getWorldTransform();
+	auto const& transform1 = body1Wrap->getWorldTransform();
+	auto const threshold = resultOut->m_closestPointDistanceThreshold;
+	auto const batched0 = dynamic_cast<BatchedCompoundShape const*>(compoundShape0);
+	auto const batched1 = dynamic_cast<BatchedCompoundShape const*>(compoundShape1);
+	auto const moveStamp0 = batched0 ? batched0->getMoveStamp() : 0;
+	auto const moveStamp1 = batched1 ? batched1->getMoveStamp() : 0;
+
+	// [hAABBŔׂ̂ŁAΕϊłȂꂼ̕ϊƂɌ
+	auto const samePlacement = validated && threshold == lastThreshold && transform0 == lastTransform0 && transform1 == lastTransform1;
+	auto const childMoved0 = [&](int childIndex) { return !batched0 || batched0->getChildMoveStamp(childIndex) > lastMoveStamp0; };
+	auto const childMoved1 = [&](int childIndex) { return !batched1 || batched1->getChildMoveStamp(childIndex) > lastMoveStamp1; };
+
+	auto const xform = transform0.inverse() * transform1;
+	previousPairs.swap(processedPairs);
+	processedPairs.clear();
+
+	// OƓuŗ̎qĂȂ΁A؂HƂɓt̃yAAABB̔ɂȂ
+	// ̎qĂȂyA͑O񏈗̂̂܂܏Aq̗t̖؂H
+	// l0łȂ΁AyA𑫂ƂƊOƂAABB̔肪Ⴄ̂Ŗ؂ǂH
+	if (samePlacement && batched0 && batched1 && threshold == 0) {
+		BT_PROFILE("BatchedCompoundCompoundCollisionAlgorithm::processMovedChildren");
+		auto const collectMoved = [](BatchedCompoundShape const* shape, std::uint64_t lastMoveStamp, std::vector<int>& moved) {
+			moved.clear();
+			if (shape->getMoveStamp() == lastMoveStamp)
+				return;
+			for (int i = 0; i < shape->getNumChildShapes(); i++)
+			{
+				if (shape->getChildMoveStamp(i) > lastMoveStamp)
+					moved.push_back(i);
+			}
+		};
+		collectMoved(batched0, lastMoveStamp0, movedChildren0);
+		collectMoved(batched1, lastMoveStamp1, movedChildren1);
+
+		for (auto const& pair : previousPairs)
+		{
+			if (childMoved0(pair.childIndex0) || childMoved1(pair.childIndex1))
+				continue;
+
+			auto const childShape0 = compoundShape0->getChildShape(pair.childIndex0);
+			auto const childShape1 = compoundShape1->getChildShape(pair.childIndex1);
+			if (gCompoundCompoundChildShapePairCallback && !gCompoundCompoundChildShapePairCallback(childShape0, childShape1))
+				continue;
+
+			btTransform const childTransform0 = transform0 * compoundShape0->getChildTransform(pair.childIndex0);
+			btTransform const childTransform1 = transform1 * compoundShape1->getChildTransform(pair.childIndex1);
+			btCollisionObjectWrapper const childWrap0{ body0Wrap, childShape0, body0Wrap->getCollisionObject(), childTransform0, -1, pair.childIndex0 };
+			btCollisionObjectWrapper const childWrap1{ body1Wrap, childShape1, body1Wrap->getCollisionObject(), childTransform1, -1, pair.childIndex1 };
+			processChildPair(&childWrap0, &childWrap1, pair.childIndex0, pair.childIndex1, pair.algorithm, dispatchInfo, resultOut);
+			processedPairs.push_back(pair);
+		}
+
+		for (auto const childIndex0 : movedChildren0)
+		{
+			auto const& volume0 = batched0->getChildVolume(childIndex0);
+			collide_compound_tree(tree1->m_root, [&](btDbvtVolume const& volume1) { return Intersect(volume0, transform_compound_volume(volume1, xform, threshold)); }, [&](int childIndex1) {
+				processLeafPair(body0Wrap, body1Wrap, childIndex0, childIndex1, dispatchInfo, resultOut);
+			});
+		}
+		// ̎qyA͏ŏĂ
+		for (auto const childIndex1 : movedChildren1)
+		{
+			auto const volume1 = transform_compound_volume(batched1->getChildVolume(childIndex1), xform, threshold);
+			collide_compound_tree(tree0->m_root, [&](btDbvtVolume const& volume0) { return Intersect(volume0, volume1); }, [&](int childIndex0) {
+				if (!childMoved0(childIndex0))
+					processLeafPair(body0Wrap, body1Wrap, childIndex0, childIndex1, dispatchInfo, resultOut);
+			});
+		}
+	}
+	else {
+		collide_compound_trees(tree0->m_root, tree1->m_root, xform, threshold, [&](int childIndex0, int childIndex1) {
+			processLeafPair(body0Wrap, body1Wrap, childIndex0, childIndex1, dispatchInfo, resultOut);
+		});
+	}
+
+	// dȂȂȂyAOAOƓuŗ̎qĂȂyA͑Ǒʂ̂܂
+	{
+		BT_PROFILE("BatchedCompoundCompoundCollisionAlgorithm::removePairs");
+		btAssert(removePairs.size() == 0);
+		btVector3 const thresholdVec{ threshold, threshold, threshold };
+		for (int i = 0; i < pairs.size(); i++)
+		{
+			auto const algorithm = static_cast<btCollisionAlgorithm*>(pairs[i].m_userPointer);
+			if (!algorithm)
+				continue;
+
+			auto const childIndex0 = pairs[i].m_indexA, childIndex1 = pairs[i].m_indexB;
+			if (samePlacement && !childMoved0(childIndex0) && !childMoved1(childIndex1))
+				continue;
+
+			btVector3 aabbMin0{}, aabbMax0{}, aabbMin1{}, aabbMax1{};
+			compoundShape0->getChildShape(childIndex0)->getAabb(transform0 * compoundShape0->getChildTransform(childIndex0), aabbMin0, aabbMax0);
+			compoundShape1->getChildShape(childIndex1)->getAabb(transform1 * compoundShape1->getChildTransform(childIndex1), aabbMin1, aabbMax1);
+			if (!TestAabbAgainstAabb2(aabbMin0 - thresholdVec, aabbMax0 + thresholdVec, aabbMin1 - thresholdVec, aabbMax1 + thresholdVec)) {
+				algorithm->~btCollisionAlgorithm();
+				m_dispatcher->freeCollisionAlgorithm(algorithm);
+				removePairs.push_back(btSimplePair(childIndex0, childIndex1));
+			}
+		}
+		for (int i = 0; i < removePairs.size(); i++)
+			childAlgorithmCache->removeOverlappingPair(removePairs[i].m_indexA, removePairs[i].m_indexB);
+		removePairs.clear();
+	}
+
+	validated = true;
+	lastTransform0 = transform0;
+	lastTransform1 = transform1;
+	lastThreshold = threshold;
+	lastMoveStamp0 = moveStamp0;
+	lastMoveStamp1 = moveStamp1;
+}
+
+inline btScalar BatchedCompoundCompoundCollisionAlgorithm::calculateTimeOfImpact(btCollisionObject*, btCollisionObject*, btDispatcherInfo const&, btManifoldResult*)
+{
+	// btCompoundCompoundCollisionAlgorithmƓĂ΂Ȃ
+	btAssert(false);
+	return 0;
+}
+
+inline void BatchedCompoundCompoundCollisionAlgorithm::getAllContactManifolds(btManifoldArray& manifoldArray)
+{
+	auto& pairs = childAlgorithmCache->getOverlappingPairArray();
+	for (int i = 0; i < pairs.size(); i++)
+	{
+		if (auto const algorithm = static_cast<btCollisionAlgorithm*>(pairs[i].m_userPointer))
+			algorithm->getAllContactManifolds(manifoldArray);
+	}
+}
+
+inline btCollisionAlgorithm* BatchedCompoundCompoundCollisionAlgorithm::CreateFunc::CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap)
+{
+	void* mem = ci.m_dispatcher1->allocateCollisionAlgorithm(sizeof(BatchedCompoundCompoundCollisionAlgorithm));
+	return new (mem) BatchedCompoundCompoundCollisionAlgorithm(ci, body0Wrap, body1Wrap, m_swapped);
+}
+
+
+inline btDefaultCollisionConstructionInfo batched_compound_construction_info(btDefaultCollisionConstructionInfo constructionInfo)
+{
+	constructionInfo.m_customCollisionAlgorithmMaxElementSize = std::max(constructionInfo.m_customCollisionAlgorithmMaxElementSize,
+		static_cast<int>(sizeof(BatchedCompoundCompoundCollisionAlgorithm)));
+	return constructionInfo;
+}
+
+inline BatchedCompoundCollisionConfiguration::BatchedCompoundCollisionConfiguration(btDefaultCollisionConstructionInfo const& constructionInfo)
+	: btDefaultCollisionConfiguration(batched_compound_construction_info(constructionInfo))
+{
+}
+
+inline btCollisionAlgorithmCreateFunc* BatchedCompoundCollisionConfiguration::getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1)
+{
+	if (proxyType0 == COMPOUND_SHAPE_PROXYTYPE && proxyType1 == COMPOUND_SHAPE_PROXYTYPE)
+		return &compoundCompoundCreateFunc;
+
+	return btDefaultCollisionConfiguration::getCollisionAlgorithmCreateFunc(proxyType0, proxyType1);
+}
@@ -0,0 +1,446 @@
+#pragma once
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btActivatingCollisionAlgorithm.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btCollisionCreateFunc.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btConvexConvexAlgorithm.h"
+#include<algorithm>
+#include<array>
+#include<cmath>
+#include<limits>
+
+// ̃[JWł̐ڐG_
+// normal͔OApointOnBox̓}[W܂߂̕\
+// distance͕Ȃ߂荞
+struct CapsuleBoxContact
+{
+	btVector3 pointOnBox{ 0,0,0 };
+	btVector3 normal{ 0,0,0 };
+	btScalar distance{};
+};
+
+struct CapsuleBoxContacts
+{
+	std::array<CapsuleBoxContact, 2> contacts{};
+	int num = 0;
+};
+
+// ̃[JWŃJvZƔ̐ڐG߂
+// JvZ̎ʂƕsɋ߂Ƃ́AʂŐ؂̗[2_Ԃ̂1ŐQĂԂx
+// centerAaxis̓JvZ̒SƎ̒PʃxNgAhalfExtent̓}[W܂܂Ȃ̑傫
+// distancecontactThresholdȏ̓_͕ԂȂ
+CapsuleBoxContacts collide_capsule_box(btVector3 const& center, btVector3 const& axis, btScalar halfHeight, btScalar radius,
+	btVector3 const& halfExtent, btScalar margin, btScalar contactThreshold);
+
+// p0 + t * d (0 <= t <= 1)̂Ɉԋ߂_tԂ
+// Ƃ̋2distance2ɓ
+btScalar closest_segment_box(btVector3 const& p0, btVector3 const& d, btVector3 const& halfExtent, btScalar& distance2);
+
+// p0 + s * d0Ɛq0 + t * d1̍ŋߓ_sAt (ǂ01)
+void closest_segment_segment(btVector3 const& p0, btVector3 const& d0, btVector3 const& q0, btVector3 const& d1, btScalar& s, btScalar& t);
+
+// JvZƔ̃yAGJKAEPAg킸ɉ͓Iɉ
+// 1processCollisionŃ}jtH[h𖄂߂̂ŁA1t[1_܂̂҂ȂĂ悢
+class CapsuleBoxCollisionAlgorithm : public btActivatingCollisionAlgorithm
+{
+	bool ownManifold = false;
+	btPersistentManifold* manifold = nullptr;
+	// trueȂbody0
+	bool isSwapped = false;
+
+public:
+	CapsuleBoxCollisionAlgorithm(btPersistentManifold* manifold, btCollisionAlgorithmConstructionInfo const& ci,
+		btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, bool isSwapped);
+	virtual ~CapsuleBoxCollisionAlgorithm();
+	CapsuleBoxCollisionAlgorithm(CapsuleBoxCollisionAlgorithm const&) = delete;
+	CapsuleBoxCollisionAlgorithm& operator=(CapsuleBoxCollisionAlgorithm const&) = delete;
+
+	void processCollision(btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut) override;
+	btScalar calculateTimeOfImpact(btCollisionObject* body0, btCollisionObject* body1, btDispatcherInfo const& dispatchInfo, btManifoldResult* resultOut) override;
+	void getAllContactManifolds(btManifoldArray& manifoldArray) override;
+
+	struct CreateFunc : public btCollisionAlgorithmCreateFunc
+	{
+		btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap) override;
+	};
+};
+
+// fBXpb`̃v[̗vfbtConvexConvexAlgorithm̑傫ȏɂȂĂ
+static_assert(sizeof(CapsuleBoxCollisionAlgorithm) <= sizeof(btConvexConvexAlgorithm));
+
+// JvZƔ̃yACapsuleBoxCollisionAlgorithmg
+// ŋߓ_߂NGp̃ASY͊̂܂
+class CapsuleBoxCollisionConfiguration : public btDefaultCollisionConfiguration
+{
+	CapsuleBoxCollisionAlgorithm::CreateFunc capsuleBoxCreateFunc{};
+	CapsuleBoxCollisionAlgorithm::CreateFunc boxCapsuleCreateFunc{};
+
+public:
+	CapsuleBoxCollisionConfiguration(btDefaultCollisionConstructionInfo const& constructionInfo = btDefaultCollisionConstructionInfo());
+	virtual ~CapsuleBoxCollisionConfiguration() = default;
+	CapsuleBoxCollisionConfiguration(CapsuleBoxCollisionConfiguration const&) = delete;
+	CapsuleBoxCollisionConfiguration& operator=(CapsuleBoxCollisionConfiguration const&) = delete;
+
+	btCollisionAlgorithmCreateFunc* getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1) override;
+};
+
+
+//
+// ȉA
+//
+
+
+inline btScalar closest_segment_box(btVector3 const& p0, btVector3 const& d, btVector3 const& halfExtent, btScalar& distance2)
+{
+	// ̖ʂ̉؂tŋ؂ƁAԂ̒ł͋2悪t2ɂȂ
+	std::array<btScalar, 8> ts{};
+	int tNum = 0;
+	ts[tNum++] = 0;
+	ts[tNum++] = 1;
+	for (int i = 0; i < 3; i++)
+	{
+		if (d[i] == 0)
+			continue;
+		for (auto bound : { -halfExtent[i], halfExtent[i] })
+		{
+			auto const t = (bound - p0[i]) / d[i];
+			if (0 < t && t < 1)
+				ts[tNum++] = t;
+		}
+	}
+	std::sort(ts.begin(), ts.begin() + tNum);
+
+	auto const squaredDistance = [&](btScalar t) {
+		btScalar result = 0;
+		for (int i = 0; i < 3; i++) {
+			auto const p = p0[i] + d[i] * t;
+			auto const excess = std::max(std::abs(p) - halfExtent[i], btScalar(0));
+			result += excess * excess;
+		}
+		return result;
+	};
+
+	btScalar bestT = 0;
+	distance2 = std::numeric_limits<btScalar>::max();
+	for (int k = 0; k + 1 < tNum; k++)
+	{
+		auto const ta = ts[k];
+		auto const tb = ts[k + 1];
+		auto const mid = (ta + tb) / 2;
+
+		// Ԃ̒Ŕ̊Oɂ鎲Ɍ
+		btScalar numerator = 0;
+		btScalar denominator = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			auto const p = p0[i] + d[i] * mid;
+			btScalar bound{};
+			if (p > halfExtent[i])
+				bound = halfExtent[i];
+			else if (p < -halfExtent[i])
+				bound = -halfExtent[i];
+			else
+				continue;
+			numerator += d[i] * (bound - p0[i]);
+			denominator += d[i] * d[i];
+		}
+
+		auto const t = denominator > 0 ? std::clamp(numerator / denominator, ta, tb) : ta;
+		auto const dist2 = squaredDistance(t);
+		if (dist2 < distance2) {
+			distance2 = dist2;
+			bestT = t;
+		}
+	}
+
+	return bestT;
+}
+
+inline void closest_segment_segment(btVector3 const& p0, btVector3 const& d0, btVector3 const& q0, btVector3 const& d1, btScalar& s, btScalar& t)
+{
+	auto const r = p0 - q0;
+	auto const a = d0.dot(d0);
+	auto const e = d1.dot(d1);
+	auto const f = d1.dot(r);
+
+	if (a <= SIMD_EPSILON && e <= SIMD_EPSILON) {
+		s = t = 0;
+		return;
+	}
+	if (a <= SIMD_EPSILON) {
+		s = 0;
+		t = std::clamp(f / e, btScalar(0), btScalar(1));
+		return;
+	}
+
+	auto const c = d0.dot(r);
+	if (e <= SIMD_EPSILON) {
+		t = 0;
+		s = std::clamp(-c / a, btScalar(0), btScalar(1));
+		return;
+	}
+
+	// sȂ番ꂪ0ɂȂ̂ŁAǂł悢̂0n߂
+	auto const b = d0.dot(d1);
+	auto const denominator = a * e - b * b;
+	s = denominator > SIMD_EPSILON ? std::clamp((b * f - c * e) / denominator, btScalar(0), btScalar(1)) : btScalar(0);
+
+	t = (b * s + f) / e;
+	if (t < 0) {
+		t = 0;
+		s = std::clamp(-c / a, btScalar(0), btScalar(1));
+	}
+	else if (t > 1) {
+		t = 1;
+		s = std::clamp((b - c) / a, btScalar(0), btScalar(1));
+	}
+}
+
+// 𔠂k̖ʂŐ؂āA[ڐG_ɂ
+// clipfalseȂ؂炸ɁA[̓_ʂ͈̔͂Ɋ񂹂
+// ʂ͈̔͂ɂȂfalse
+inline bool add_capsule_box_face_contacts(CapsuleBoxContacts& result, btVector3 const& p0, btVector3 const& d, btVector3 const& halfExtent,
+	int k, btScalar sign, btScalar radius, btScalar margin, btScalar contactThreshold, bool clip)
+{
+	btScalar t0 = 0;
+	btScalar t1 = 1;
+	for (int j = 0; clip && j < 3; j++)
+	{
+		if (j == k)
+			continue;
+
+		if (std::abs(d[j]) <= SIMD_EPSILON) {
+			if (std::abs(p0[j]) > halfExtent[j])
+				return false;
+			continue;
+		}
+
+		auto ta = (-halfExtent[j] - p0[j]) / d[j];
+		auto tb = (halfExtent[j] - p0[j]) / d[j];
+		if (ta > tb)
+			std::swap(ta, tb);
+		t0 = std::max(t0, ta);
+		t1 = std::min(t1, tb);
+	}
+	if (t0 > t1)
+		return false;
+
+	btVector3 normal{ 0,0,0 };
+	normal[k] = sign;
+
+	// [قړȂ1_
+	auto const endNum = (t1 - t0) * d.length() > SIMD_EPSILON ? 2 : 1;
+	for (auto t : { t0, t1 })
+	{
+		if (result.num >= endNum)
+			break;
+
+		auto point = p0 + d * t;
+		auto const distance = sign * point[k] - halfExtent[k] - radius;
+		if (distance >= contactThreshold)
+			continue;
+
+		point[k] = sign * halfExtent[k];
+		point.setMax(-halfExtent);
+		point.setMin(halfExtent);
+		result.contacts[result.num++] = { point + normal * margin, normal, distance };
+	}
+
+	return true;
+}
+
+inline CapsuleBoxContacts collide_capsule_box(btVector3 const& center, btVector3 const& axis, btScalar halfHeight, btScalar radius,
+	btVector3 const& halfExtent, btScalar margin, btScalar contactThreshold)
+{
+	// ̓}[WcɁAJvZ̔aɂ̓}[W𑫂
+	auto const totalRadius = radius + margin;
+
+	auto const p0 = center - axis * halfHeight;
+	auto const d = axis * (halfHeight * 2);
+
+	CapsuleBoxContacts result{};
+
+	btScalar distance2{};
+	auto const t = closest_segment_box(p0, d, halfExtent, distance2);
+
+	// ĂƂ
+	if (distance2 > btScalar(1e-12))
+	{
+		auto const distance = std::sqrt(distance2);
+		if (distance - totalRadius >= contactThreshold)
+			return result;
+
+		auto const closestOnSegment = p0 + d * t;
+		auto closestOnBox = closestOnSegment;
+		closestOnBox.setMax(-halfExtent);
+		closestOnBox.setMin(halfExtent);
+		auto const normal = (closestOnSegment - closestOnBox) / distance;
+
+		// ʂ̓̏ɂΖʂŐ؂
+		auto const k = normal.absolute().maxAxis();
+		if (std::abs(normal[k]) > btScalar(1) - btScalar(1e-6)
+			&& add_capsule_box_face_contacts(result, p0, d, halfExtent, k, normal[k] > 0 ? btScalar(1) : btScalar(-1), totalRadius, margin, contactThreshold, true)
+			&& result.num > 0)
+			return result;
+
+		// ӂⒸ_
+		result.num = 0;
+		result.contacts[result.num++] = { closestOnBox + normal * margin, normal, distance - totalRadius };
+		return result;
+	}
+
+	// ̐cɎhĂƂ́A̖ʂ̖@ƕӂƎ̊OςŕT
+	btScalar bestOverlap = std::numeric_limits<btScalar>::max();
+	btVector3 bestAxis{ 0,1,0 };
+	int bestFace = -1;
+	int bestEdge = -1;
+
+	for (int k = 0; k < 3; k++)
+	{
+		auto const overlap = halfExtent[k] + halfHeight * std::abs(axis[k]) - std::abs(center[k]);
+		if (overlap < bestOverlap) {
+			bestOverlap = overlap;
+			bestAxis = btVector3(0, 0, 0);
+			bestAxis[k] = 1;
+			bestFace = k;
+		}
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		btVector3 edge{ 0,0,0 };
+		edge[i] = 1;
+		auto l = edge.cross(axis);
+		auto const length = l.length();
+		if (length < btScalar(1e-6))
+			continue;
+		l /= length;
+
+		// lƒ̂Ő1_ɓe
+		auto const overlap = halfExtent.dot(l.absolute()) - std::abs(center.dot(l));
+		// ʂ̂قڐG_肷̂ŁAӂ͏\󂢂ƂI
+		if (overlap * btScalar(1.05) + btScalar(1e-4) < bestOverlap) {
+			bestOverlap = overlap;
+			bestAxis = l;
+			bestFace = -1;
+			bestEdge = i;
+		}
+	}
+
+	auto const normal = center.dot(bestAxis) >= 0 ? bestAxis : -bestAxis;
+
+	// ߂荞łƂ́Aʂ牡ɂ͂ݏo[Ԑ[Ƃ̂Ő؂Ȃ
+	if (bestFace >= 0)
+	{
+		add_capsule_box_face_contacts(result, p0, d, halfExtent, bestFace, normal[bestFace], totalRadius, margin, contactThreshold, false);
+		return result;
+	}
+
+	// @̌ɂAbestEdgeɕsȕ
+	btVector3 edgeStart{ 0,0,0 };
+	for (int j = 0; j < 3; j++)
+		edgeStart[j] = j == bestEdge ? -halfExtent[j] : (normal[j] >= 0 ? halfExtent[j] : -halfExtent[j]);
+	btVector3 edgeDirection{ 0,0,0 };
+	edgeDirection[bestEdge] = halfExtent[bestEdge] * 2;
+
+	btScalar s{}, u{};
+	closest_segment_segment(p0, d, edgeStart, edgeDirection, s, u);
+	auto const closestOnBox = edgeStart + edgeDirection * u;
+	auto const distance = (p0 + d * s - closestOnBox).dot(normal) - totalRadius;
+	if (distance < contactThreshold)
+		result.contacts[result.num++] = { closestOnBox + normal * margin, normal, distance };
+
+	return result;
+}
+
+
+inline CapsuleBoxCollisionAlgorithm::CapsuleBoxCollisionAlgorithm(btPersistentManifold* mf, btCollisionAlgorithmConstructionInfo const& ci,
+	btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, bool swapped)
+	: btActivatingCollisionAlgorithm(ci, body0Wrap, body1Wrap)
+	, manifold{ mf }
+	, isSwapped{ swapped }
+{
+	auto const capsuleWrap = isSwapped ? body1Wrap : body0Wrap;
+	auto const boxWrap = isSwapped ? body0Wrap : body1Wrap;
+
+	// }jtH[h͏ɃJvZȀ
+	if (!manifold && m_dispatcher->needsCollision(capsuleWrap->getCollisionObject(), boxWrap->getCollisionObject()))
+	{
+		manifold = m_dispatcher->getNewManifold(capsuleWrap->getCollisionObject(), boxWrap->getCollisionObject());
+		ownManifold = true;
+	}
+}
+
+inline CapsuleBoxCollisionAlgorithm::~CapsuleBoxCollisionAlgorithm()
+{
+	if (ownManifold && manifold)
+		m_dispatcher->releaseManifold(manifold);
+}
+
+inline void CapsuleBoxCollisionAlgorithm::processCollision(btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap, btDispatcherInfo const&, btManifoldResult* resultOut)
+{
+	if (!manifold)
+		return;
+
+	auto const capsuleWrap = isSwapped ? body1Wrap : body0Wrap;
+	auto const boxWrap = isSwapped ? body0Wrap : body1Wrap;
+	auto const capsule = static_cast<btCapsuleShape const*>(capsuleWrap->getCollisionShape());
+	auto const box = static_cast<btBoxShape const*>(boxWrap->getCollisionShape());
+
+	resultOut->setPersistentManifold(manifold);
+
+	auto const& boxTransform = boxWrap->getWorldTransform();
+	auto const& capsuleTransform = capsuleWrap->getWorldTransform();
+	auto const& boxBasis = boxTransform.getBasis();
+
+	auto const contacts = collide_capsule_box(
+		boxTransform.invXform(capsuleTransform.getOrigin()),
+		boxBasis.transpose() * capsuleTransform.getBasis().getColumn(capsule->getUpAxis()),
+		capsule->getHalfHeight(), capsule->getRadius(),
+		box->getHalfExtentsWithoutMargin(), box->getMargin(),
+		manifold->getContactBreakingThreshold());
+
+	// ̓_Ɩ@œnAւĂĂ}jtH[h̏ň
+	for (int i = 0; i < contacts.num; i++)
+	{
+		auto const& contact = contacts.contacts[i];
+		resultOut->addContactPoint(boxBasis * contact.normal, boxTransform * contact.pointOnBox, contact.distance);
+	}
+
+	if (ownManifold && manifold->getNumContacts())
+		resultOut->refreshContactPoints();
+}
+
+inline btScalar CapsuleBoxCollisionAlgorithm::calculateTimeOfImpact(btCollisionObject*, btCollisionObject*, btDispatcherInfo const&, btManifoldResult*)
+{
+	// btSphereBoxCollisionAlgorithmƓAՓˌo͂Ȃ
+	return btScalar(1.);
+}
+
+inline void CapsuleBoxCollisionAlgorithm::getAllContactManifolds(btManifoldArray& manifoldArray)
+{
+	if (manifold && ownManifold)
+		manifoldArray.push_back(manifold);
+}
+
+inline btCollisionAlgorithm* CapsuleBoxCollisionAlgorithm::CreateFunc::CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, btCollisionObjectWrapper const* body0Wrap, btCollisionObjectWrapper const* body1Wrap)
+{
+	void* mem = ci.m_dispatcher1->allocateCollisionAlgorithm(sizeof(CapsuleBoxCollisionAlgorithm));
+	return new (mem) CapsuleBoxCollisionAlgorithm(nullptr, ci, body0Wrap, body1Wrap, m_swapped);
+}
+
+
+inline CapsuleBoxCollisionConfiguration::CapsuleBoxCollisionConfiguration(btDefaultCollisionConstructionInfo const& constructionInfo)
+	: btDefaultCollisionConfiguration(constructionInfo)
+{
+	boxCapsuleCreateFunc.m_swapped = true;
+}
+
+inline btCollisionAlgorithmCreateFunc* CapsuleBoxCollisionConfiguration::getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1)
+{
+	if (proxyType0 == CAPSULE_SHAPE_PROXYTYPE && proxyType1 == BOX_SHAPE_PROXYTYPE)
+		return &capsuleBoxCreateFunc;
+	if (proxyType0 == BOX_SHAPE_PROXYTYPE && proxyType1 == CAPSULE_SHAPE_PROXYTYPE)
+		return &boxCapsuleCreateFunc;
+
+	return btDefaultCollisionConfiguration::getCollisionAlgorithmCreateFunc(proxyType0, proxyType1);
+}
@@ -0,0 +1,1133 @@
+#pragma once
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include<algorithm>
+#include<cstddef>
+#include<vector>
+
+// btPersistentManifold.cppɂAwb_[ł͐錾ĂȂ
+extern bool gContactCalcArea3Points;
+
+// btContactPointFlagsɑtOAcombinedRollingFriction0傫
+// SƂɗ₽ɕł悤ɂ
+constexpr int COMPACT_CONTACT_FLAG_ROLLING_FRICTION = 1 << 16;
+
+// ڐG_̂ArefreshContactPointsƍSƂɖǂޒl
+// btVector3͔{x4vf̂ŁA3vf̔zŎ
+struct CompactContactPoint
+{
+	btScalar localPointA[3]{};
+	btScalar localPointB[3]{};
+	btScalar positionWorldOnA[3]{};
+	btScalar positionWorldOnB[3]{};
+	btScalar normalWorldOnB[3]{};
+	btScalar distance{};
+	btScalar appliedImpulse{};
+	btScalar combinedFriction{};
+	btScalar combinedRestitution{};
+	int lifeTime{};
+	// btContactPointFlagsCOMPACT_CONTACT_FLAG_ROLLING_FRICTION
+	int flags{};
+};
+
+// ڐG_̂AtOĂƂbtMultiBodyȂǂłǂ܂Ȃl
+struct CompactContactPointCold
+{
+	btVector3 lateralFrictionDir1{ 0, 0, 0 };
+	btVector3 lateralFrictionDir2{ 0, 0, 0 };
+	void* userPersistentData{};
+	btScalar prevRHS{};
+	btScalar appliedImpulseLateral1{};
+	btScalar appliedImpulseLateral2{};
+	btScalar contactMotion1{};
+	btScalar contactMotion2{};
+	// BT_CONTACT_FLAG_CONTACT_STIFFNESS_DAMPINGȂstiffnessdamping
+	btScalar contactCFM{};
+	btScalar contactERP{};
+	btScalar frictionCFM{};
+	btScalar combinedRollingFriction{};
+	btScalar combinedSpinningFriction{};
+	int partId0 = -1;
+	int partId1 = -1;
+	int index0 = -1;
+	int index1 = -1;
+};
+
+struct CompactManifold
+{
+	btCollisionObject const* body0{};
+	btCollisionObject const* body1{};
+	btScalar contactBreakingThreshold{};
+	btScalar contactProcessingThreshold{};
+	int pointNum{};
+};
+
+// btPersistentManifolďJo[̂AACh\o[̍Ɨp̒l
+struct CompactManifoldCold
+{
+	int companionIdA{};
+	int companionIdB{};
+	int index1a{};
+};
+
+// ڐG_̔MlƗ₽lʁX̔zɎ}jtH[h̓ꕨ
+// 1̃}jtH[hMANIFOLD_CACHE_SIZE̓_𑱂ĎA_̑AւAbtPersistentManifoldƓ
+// refreshContactPointsCompactContactSolveŕAtOĂȂΔMz񂾂ǂ
+// Bullet̏Փ˃ASYbtPersistentManifoldɒڏ̂ŁAfBXpb`̃}jtH[h̑ɂ͂ȂȂ
+// [h̃}jtH[hƂassignwriteToł肵ÅԂrefreshContactPointsƍSƂ낾󂯎
+// ʂԂ܂߂ƁA[h̃}jtH[ĥ܂܉x(manifoldx`}[Nstep_ms)
+// gContactProcessedCallbackbtManifoldPointČĂсA߂
+// gContactEndedCallbackbtPersistentManifoldȂ̂ŌĂ΂Ȃ
+class CompactManifoldStore
+{
+	std::vector<CompactManifold> manifolds{};
+	std::vector<CompactManifoldCold> coldManifolds{};
+	std::vector<CompactContactPoint> points{};
+	std::vector<CompactContactPointCold> coldPoints{};
+	int grainSize = 64;
+
+public:
+	CompactManifoldStore() = default;
+	virtual ~CompactManifoldStore() = default;
+	CompactManifoldStore(CompactManifoldStore const&) = delete;
+	CompactManifoldStore& operator=(CompactManifoldStore const&) = delete;
+
+	// }jtH[h̔ԍԂ
+	int addManifold(btCollisionObject const* body0, btCollisionObject const* body1, btScalar contactBreakingThreshold, btScalar contactProcessingThreshold);
+	// Ō̃}jtH[hmanifold̔ԍɈڂ
+	void removeManifold(int manifold);
+	void clear();
+	void reserve(int manifoldNum);
+
+	// }jtH[h𓯂ŎʂA܂ł̃}jtH[h͏
+	// ܂ł̓_̓[h̃}jtH[h̎ʂƂāAgContactDestroyedCallbackĂ΂Ɏ̂Ă
+	void assign(btPersistentManifold* const* manifoldPtr, int manifoldNum);
+	// assignƓœ̂̑g̃}jtH[hɏ߂
+	void writeTo(btPersistentManifold* const* manifoldPtr, int manifoldNum) const;
+
+	int getManifoldNum() const noexcept;
+	CompactManifold const& getManifold(int manifold) const noexcept;
+	CompactManifoldCold& getColdManifold(int manifold) noexcept;
+	int getNumContacts(int manifold) const noexcept;
+	CompactContactPoint& getContactPoint(int manifold, int index) noexcept;
+	CompactContactPoint const& getContactPoint(int manifold, int index) const noexcept;
+	CompactContactPointCold& getColdContactPoint(int manifold, int index) noexcept;
+	CompactContactPointCold const& getColdContactPoint(int manifold, int index) const noexcept;
+	// Mzł̔ԍ₽lACompactContactSolverg
+	CompactContactPointCold& getColdContactPoint(CompactContactPoint const& point) noexcept;
+
+	btManifoldPoint getManifoldPoint(int manifold, int index) const;
+	// pointׂ̂Ẵo[
+	void getManifoldPoint(int manifold, int index, btManifoldPoint& point) const;
+	void setManifoldPoint(int manifold, int index, btManifoldPoint const& point);
+
+	// btPersistentManifold̓O̊֐Ɠ
+	int getCacheEntry(int manifold, btManifoldPoint const& newPoint) const;
+	int addManifoldPoint(int manifold, btManifoldPoint const& newPoint, bool isPredictive = false);
+	void replaceContactPoint(int manifold, btManifoldPoint const& newPoint, int insertIndex);
+	void removeContactPoint(int manifold, int index);
+	void clearManifold(int manifold);
+	void refreshContactPoints(int manifold, btTransform const& trA, btTransform const& trB);
+	// S̃}jtH[hAꂼ̍̂̍̎pbtParallelForgčXV
+	void refreshContactPoints();
+
+	// refreshContactPoints()1^XÑ}jtH[h
+	void setGrainSize(int size) noexcept;
+
+	// l߂_̐
+	std::size_t getContactNum() const noexcept;
+	// gĂvf̑傫AM̓}jtH[h̓Ɠ_
+	std::size_t getHotBytes() const noexcept;
+	std::size_t getColdBytes() const noexcept;
+
+private:
+	int sortCachedPoints(int manifold, btManifoldPoint const& newPoint) const;
+	void clearUserCache(CompactContactPointCold& cold);
+};
+
+// CompactManifoldStore̐ڐGbtSequentialImpulseConstraintSolver
+// tÔȂ_͔Mz񂾂ǂ݁AbtSequentialImpulseConstraintSolver::convertContactƓōS
+// [OCAڐGƂCFMERPAC̃AJ[AcCbtManifoldPointČ̊֐ō
+// ͐ςbtManifoldPointł͂Ȃstoreɏ߂
+class CompactContactSolver : public btSequentialImpulseConstraintSolver
+{
+	CompactManifoldStore* currentStore = nullptr;
+	int const* currentManifolds = nullptr;
+	int currentManifoldNum{};
+
+public:
+	CompactContactSolver() = default;
+	virtual ~CompactContactSolver() = default;
+	CompactContactSolver(CompactContactSolver const&) = delete;
+	CompactContactSolver& operator=(CompactContactSolver const&) = delete;
+
+	// storemanifolds̔ԍ̃}jtH[hAmanifoldsnullptrȂ擪manifoldNum
+	btScalar solveCompactGroup(btCollisionObject** bodies, int numBodies, CompactManifoldStore& store, int const* manifolds, int manifoldNum,
+		btTypedConstraint** constraints, int numConstraints, btContactSolverInfo const& infoGlobal, btIDebugDraw* debugDrawer);
+
+protected:
+	void convertContacts(btPersistentManifold** manifoldPtr, int numManifolds, btContactSolverInfo const& infoGlobal) override;
+	btScalar solveGroupCacheFriendlyFinish(btCollisionObject** bodies, int numBodies, btContactSolverInfo const& infoGlobal) override;
+
+	void convertCompactContacts(CompactManifoldStore& store, int const* manifolds, int manifoldNum, btContactSolverInfo const& infoGlobal);
+	void convertCompactContact(CompactManifoldStore& store, int manifold, btContactSolverInfo const& infoGlobal);
+	void writeBackCompactContacts(CompactManifoldStore& store, btContactSolverInfo const& infoGlobal);
+
+private:
+	// tÔȂ_setupContactConstraint
+	void setupCompactContactConstraint(btSolverConstraint& solverConstraint, int solverBodyIdA, int solverBodyIdB, CompactContactPoint const& cp,
+		btVector3 const& normal, btContactSolverInfo const& infoGlobal, btScalar& relaxation, btVector3 const& rel_pos1, btVector3 const& rel_pos2);
+	// desiredVelocitycfmSlip0ŁAAJ[̂ȂaddFrictionConstraint
+	void addCompactFrictionConstraint(btVector3 const& normalAxis, int solverBodyIdA, int solverBodyIdB, int frictionIndex, btScalar friction,
+		btVector3 const& rel_pos1, btVector3 const& rel_pos2, btScalar relaxation);
+	// tÔ_btManifoldPointɂāAconvertContact1_Ɠ
+	void convertFlaggedContactPoint(CompactManifoldStore& store, int manifold, int index, btSolverConstraint& solverConstraint, int solverBodyIdA, int solverBodyIdB,
+		int frictionIndex, btVector3 const& rel_pos1, btVector3 const& rel_pos2, btVector3 const& vel, btScalar rel_vel, btContactSolverInfo const& infoGlobal);
+};
+
+btVector3 compact_load(btScalar const (&v)[3]) noexcept;
+void compact_store(btScalar (&v)[3], btVector3 const& a) noexcept;
+
+//
+// ȉA
+//
+
+inline btVector3 compact_load(btScalar const (&v)[3]) noexcept
+{
+	return btVector3(v[0], v[1], v[2]);
+}
+
+inline void compact_store(btScalar (&v)[3], btVector3 const& a) noexcept
+{
+	v[0] = a.getX();
+	v[1] = a.getY();
+	v[2] = a.getZ();
+}
+
+inline int CompactManifoldStore::addManifold(btCollisionObject const* body0, btCollisionObject const* body1,
+	btScalar contactBreakingThreshold, btScalar contactProcessingThreshold)
+{
+	auto const manifold = static_cast<int>(manifolds.size());
+	manifolds.push_back({ body0, body1, contactBreakingThreshold, contactProcessingThreshold, 0 });
+	coldManifolds.push_back({});
+	points.resize(points.size() + MANIFOLD_CACHE_SIZE);
+	coldPoints.resize(coldPoints.size() + MANIFOLD_CACHE_SIZE);
+	return manifold;
+}
+
+inline void CompactManifoldStore::removeManifold(int manifold)
+{
+	clearManifold(manifold);
+
+	auto const last = static_cast<int>(manifolds.size()) - 1;
+	if (manifold != last)
+	{
+		manifolds[manifold] = manifolds[last];
+		coldManifolds[manifold] = coldManifolds[last];
+		for (int i = 0; i < MANIFOLD_CACHE_SIZE; i++)
+		{
+			points[manifold * MANIFOLD_CACHE_SIZE + i] = points[last * MANIFOLD_CACHE_SIZE + i];
+			coldPoints[manifold * MANIFOLD_CACHE_SIZE + i] = coldPoints[last * MANIFOLD_CACHE_SIZE + i];
+		}
+	}
+
+	manifolds.pop_back();
+	coldManifolds.pop_back();
+	points.resize(points.size() - MANIFOLD_CACHE_SIZE);
+	coldPoints.resize(coldPoints.size() - MANIFOLD_CACHE_SIZE);
+}
+
+inline void CompactManifoldStore::clear()
+{
+	for (int i = 0; i < getManifoldNum(); i++)
+		clearManifold(i);
+
+	manifolds.clear();
+	coldManifolds.clear();
+	points.clear();
+	coldPoints.clear();
+}
+
+inline void CompactManifoldStore::reserve(int manifoldNum)
+{
+	auto const num = static_cast<std::size_t>(manifoldNum);
+	manifolds.reserve(num);
+	coldManifolds.reserve(num);
+	points.reserve(num * MANIFOLD_CACHE_SIZE);
+	coldPoints.reserve(num * MANIFOLD_CACHE_SIZE);
+}
+
+inline void CompactManifoldStore::assign(btPersistentManifold* const* manifoldPtr, int manifoldNum)
+{
+	// gȂ_͏㏑܂œǂ܂Ȃ̂ŁA߂ȂȂ
+	auto const num = static_cast<std::size_t>(manifoldNum);
+	manifolds.resize(num);
+	coldManifolds.resize(num);
+	points.resize(num * MANIFOLD_CACHE_SIZE);
+	coldPoints.resize(num * MANIFOLD_CACHE_SIZE);
+
+	for (int i = 0; i < manifoldNum; i++)
+	{
+		auto const source = manifoldPtr[i];
+		manifolds[i] = { source->getBody0(), source->getBody1(), source->getContactBreakingThreshold(), source->getContactProcessingThreshold(), source->getNumContacts() };
+		coldManifolds[i] = { source->m_companionIdA, source->m_companionIdB, source->m_index1a };
+		for (int j = 0; j < source->getNumContacts(); j++)
+			setManifoldPoint(i, j, source->getContactPoint(j));
+	}
+}
+
+inline void CompactManifoldStore::writeTo(btPersistentManifold* const* manifoldPtr, int manifoldNum) const
+{
+	btAssert(manifoldNum == getManifoldNum());
+
+	for (int i = 0; i < manifoldNum; i++)
+	{
+		auto const target = manifoldPtr[i];
+		btAssert(target->getBody0() == manifolds[i].body0 && target->getBody1() == manifolds[i].body1);
+		target->setContactBreakingThreshold(manifolds[i].contactBreakingThreshold);
+		target->setContactProcessingThreshold(manifolds[i].contactProcessingThreshold);
+		target->m_companionIdA = coldManifolds[i].companionIdA;
+		target->m_companionIdB = coldManifolds[i].companionIdB;
+		target->m_index1a = coldManifolds[i].index1a;
+		target->setNumContacts(manifolds[i].pointNum);
+		for (int j = 0; j < manifolds[i].pointNum; j++)
+			getManifoldPoint(i, j, target->getContactPoint(j));
+	}
+}
+
+inline int CompactManifoldStore::getManifoldNum() const noexcept
+{
+	return static_cast<int>(manifolds.size());
+}
+
+inline CompactManifold const& CompactManifoldStore::getManifold(int manifold) const noexcept
+{
+	return manifolds[manifold];
+}
+
+inline CompactManifoldCold& CompactManifoldStore::getColdManifold(int manifold) noexcept
+{
+	return coldManifolds[manifold];
+}
+
+inline int CompactManifoldStore::getNumContacts(int manifold) const noexcept
+{
+	return manifolds[manifold].pointNum;
+}
+
+inline CompactContactPoint& CompactManifoldStore::getContactPoint(int manifold, int index) noexcept
+{
+	return points[manifold * MANIFOLD_CACHE_SIZE + index];
+}
+
+inline CompactContactPoint const& CompactManifoldStore::getContactPoint(int manifold, int index) const noexcept
+{
+	return points[manifold * MANIFOLD_CACHE_SIZE + index];
+}
+
+inline CompactContactPointCold& CompactManifoldStore::getColdContactPoint(int manifold, int index) noexcept
+{
+	return coldPoints[manifold * MANIFOLD_CACHE_SIZE + index];
+}
+
+inline CompactContactPointCold const& CompactManifoldStore::getColdContactPoint(int manifold, int index) const noexcept
+{
+	return coldPoints[manifold * MANIFOLD_CACHE_SIZE + index];
+}
+
+inline CompactContactPointCold& CompactManifoldStore::getColdContactPoint(CompactContactPoint const& point) noexcept
+{
+	return coldPoints[static_cast<std::size_t>(&point - points.data())];
+}
+
+inline btManifoldPoint CompactManifoldStore::getManifoldPoint(int manifold, int index) const
+{
+	btManifoldPoint point{};
+	getManifoldPoint(manifold, index, point);
+	return point;
+}
+
+inline void CompactManifoldStore::getManifoldPoint(int manifold, int index, btManifoldPoint& point) const
+{
+	auto const& hot = getContactPoint(manifold, index);
+	auto const& cold = getColdContactPoint(manifold, index);
+
+	point.m_localPointA = compact_load(hot.localPointA);
+	point.m_localPointB = compact_load(hot.localPointB);
+	point.m_normalWorldOnB = compact_load(hot.normalWorldOnB);
+	point.m_distance1 = hot.distance;
+	point.m_positionWorldOnA = compact_load(hot.positionWorldOnA);
+	point.m_positionWorldOnB = compact_load(hot.positionWorldOnB);
+	point.m_combinedFriction = hot.combinedFriction;
+	point.m_combinedRollingFriction = cold.combinedRollingFriction;
+	point.m_combinedSpinningFriction = cold.combinedSpinningFriction;
+	point.m_combinedRestitution = hot.combinedRestitution;
+	point.m_partId0 = cold.partId0;
+	point.m_partId1 = cold.partId1;
+	point.m_index0 = cold.index0;
+	point.m_index1 = cold.index1;
+	point.m_userPersistentData = cold.userPersistentData;
+	point.m_contactPointFlags = hot.flags & ~COMPACT_CONTACT_FLAG_ROLLING_FRICTION;
+	point.m_appliedImpulse = hot.appliedImpulse;
+	point.m_prevRHS = cold.prevRHS;
+	point.m_appliedImpulseLateral1 = cold.appliedImpulseLateral1;
+	point.m_appliedImpulseLateral2 = cold.appliedImpulseLateral2;
+	point.m_contactMotion1 = cold.contactMotion1;
+	point.m_contactMotion2 = cold.contactMotion2;
+	point.m_contactCFM = cold.contactCFM;
+	point.m_contactERP = cold.contactERP;
+	point.m_frictionCFM = cold.frictionCFM;
+	point.m_lifeTime = hot.lifeTime;
+	point.m_lateralFrictionDir1 = cold.lateralFrictionDir1;
+	point.m_lateralFrictionDir2 = cold.lateralFrictionDir2;
+}
+
+inline void CompactManifoldStore::setManifoldPoint(int manifold, int index, btManifoldPoint const& point)
+{
+	auto& hot = getContactPoint(manifold, index);
+	auto& cold = getColdContactPoint(manifold, index);
+
+	compact_store(hot.localPointA, point.m_localPointA);
+	compact_store(hot.localPointB, point.m_localPointB);
+	compact_store(hot.positionWorldOnA, point.m_positionWorldOnA);
+	compact_store(hot.positionWorldOnB, point.m_positionWorldOnB);
+	compact_store(hot.normalWorldOnB, point.m_normalWorldOnB);
+	hot.distance = point.m_distance1;
+	hot.appliedImpulse = point.m_appliedImpulse;
+	hot.combinedFriction = point.m_combinedFriction;
+	hot.combinedRestitution = point.m_combinedRestitution;
+	hot.lifeTime = point.m_lifeTime;
+	hot.flags = point.m_contactPointFlags;
+	if (point.m_combinedRollingFriction > btScalar(0.))
+		hot.flags |= COMPACT_CONTACT_FLAG_ROLLING_FRICTION;
+
+	cold.lateralFrictionDir1 = point.m_lateralFrictionDir1;
+	cold.lateralFrictionDir2 = point.m_lateralFrictionDir2;
+	cold.userPersistentData = point.m_userPersistentData;
+	cold.prevRHS = point.m_prevRHS;
+	cold.appliedImpulseLateral1 = point.m_appliedImpulseLateral1;
+	cold.appliedImpulseLateral2 = point.m_appliedImpulseLateral2;
+	cold.contactMotion1 = point.m_contactMotion1;
+	cold.contactMotion2 = point.m_contactMotion2;
+	cold.contactCFM = point.m_contactCFM;
+	cold.contactERP = point.m_contactERP;
+	cold.frictionCFM = point.m_frictionCFM;
+	cold.combinedRollingFriction = point.m_combinedRollingFriction;
+	cold.combinedSpinningFriction = point.m_combinedSpinningFriction;
+	cold.partId0 = point.m_partId0;
+	cold.partId1 = point.m_partId1;
+	cold.index0 = point.m_index0;
+	cold.index1 = point.m_index1;
+}
+
+inline int CompactManifoldStore::getCacheEntry(int manifold, btManifoldPoint const& newPoint) const
+{
+	auto const threshold = manifolds[manifold].contactBreakingThreshold;
+	btScalar shortestDist = threshold * threshold;
+	int nearestPoint = -1;
+	for (int i = 0; i < manifolds[manifold].pointNum; i++)
+	{
+		auto const diffA = compact_load(getContactPoint(manifold, i).localPointA) - newPoint.m_localPointA;
+		btScalar const distToManiPoint = diffA.dot(diffA);
+		if (distToManiPoint < shortestDist)
+		{
+			shortestDist = distToManiPoint;
+			nearestPoint = i;
+		}
+	}
+	return nearestPoint;
+}
+
+inline int CompactManifoldStore::addManifoldPoint(int manifold, btManifoldPoint const& newPoint, bool isPredictive)
+{
+	btAssert(isPredictive || newPoint.m_distance1 <= manifolds[manifold].contactBreakingThreshold);
+	(void)isPredictive;
+
+	int insertIndex = manifolds[manifold].pointNum;
+	if (insertIndex == MANIFOLD_CACHE_SIZE)
+	{
+		insertIndex = sortCachedPoints(manifold, newPoint);
+		clearUserCache(getColdContactPoint(manifold, insertIndex));
+	}
+	else
+	{
+		manifolds[manifold].pointNum++;
+	}
+	if (insertIndex < 0)
+		insertIndex = 0;
+
+	setManifoldPoint(manifold, insertIndex, newPoint);
+	return insertIndex;
+}
+
+inline void CompactManifoldStore::replaceContactPoint(int manifold, btManifoldPoint const& newPoint, int insertIndex)
+{
+	auto& hot = getContactPoint(manifold, insertIndex);
+	auto& cold = getColdContactPoint(manifold, insertIndex);
+
+	auto const lifeTime = hot.lifeTime;
+	auto const appliedImpulse = hot.appliedImpulse;
+	auto const prevRHS = cold.prevRHS;
+	auto const appliedLateralImpulse1 = cold.appliedImpulseLateral1;
+	auto const appliedLateralImpulse2 = cold.appliedImpulseLateral2;
+
+	// C̃AJ[́AC͂C~Ɏ܂ĂΑO̓_c
+	bool replacePoint = true;
+	if (newPoint.m_contactPointFlags & BT_CONTACT_FLAG_FRICTION_ANCHOR)
+	{
+		btScalar const mu = hot.combinedFriction;
+		btScalar const eps = 0;
+		btScalar const a = appliedLateralImpulse1 * appliedLateralImpulse1 + appliedLateralImpulse2 * appliedLateralImpulse2;
+		btScalar b = eps + mu * appliedImpulse;
+		b = b * b;
+		replacePoint = a > b;
+	}
+
+	if (replacePoint)
+	{
+		auto const cache = cold.userPersistentData;
+		setManifoldPoint(manifold, insertIndex, newPoint);
+		cold.userPersistentData = cache;
+		hot.appliedImpulse = appliedImpulse;
+		cold.prevRHS = prevRHS;
+		cold.appliedImpulseLateral1 = appliedLateralImpulse1;
+		cold.appliedImpulseLateral2 = appliedLateralImpulse2;
+	}
+
+	hot.lifeTime = lifeTime;
+}
+
+inline void CompactManifoldStore::removeContactPoint(int manifold, int index)
+{
+	clearUserCache(getColdContactPoint(manifold, index));
+
+	auto const lastUsedIndex = manifolds[manifold].pointNum - 1;
+	if (index != lastUsedIndex)
+	{
+		auto& lastHot = getContactPoint(manifold, lastUsedIndex);
+		auto& lastCold = getColdContactPoint(manifold, lastUsedIndex);
+		getContactPoint(manifold, index) = lastHot;
+		getColdContactPoint(manifold, index) = lastCold;
+		// userPersistentData2cȂ悤ɂ
+		lastCold.userPersistentData = nullptr;
+		lastHot.appliedImpulse = 0.;
+		lastCold.prevRHS = 0.;
+		lastHot.flags = 0;
+		lastCold.appliedImpulseLateral1 = 0.;
+		lastCold.appliedImpulseLateral2 = 0.;
+		lastHot.lifeTime = 0;
+	}
+
+	manifolds[manifold].pointNum--;
+}
+
+inline void CompactManifoldStore::clearManifold(int manifold)
+{
+	for (int i = 0; i < manifolds[manifold].pointNum; i++)
+		clearUserCache(getColdContactPoint(manifold, i));
+	manifolds[manifold].pointNum = 0;
+}
+
+inline void CompactManifoldStore::refreshContactPoints(int manifold, btTransform const& trA, btTransform const& trB)
+{
+	auto const& header = manifolds[manifold];
+	auto const hot = &points[static_cast<std::size_t>(manifold) * MANIFOLD_CACHE_SIZE];
+
+	// ɑS̓_̐EWƋXV
+	for (int i = header.pointNum - 1; i >= 0; i--)
+	{
+		auto& point = hot[i];
+		auto const positionWorldOnA = trA(compact_load(point.localPointA));
+		auto const positionWorldOnB = trB(compact_load(point.localPointB));
+		compact_store(point.positionWorldOnA, positionWorldOnA);
+		compact_store(point.positionWorldOnB, positionWorldOnB);
+		point.distance = (positionWorldOnA - positionWorldOnB).dot(compact_load(point.normalWorldOnB));
+		point.lifeTime++;
+	}
+
+	// @ɗꂽA@Ɛɂꂽ_
+	auto const threshold = header.contactBreakingThreshold;
+	for (int i = header.pointNum - 1; i >= 0; i--)
+	{
+		auto const& point = hot[i];
+		if (!(point.distance <= threshold))
+		{
+			removeContactPoint(manifold, i);
+			continue;
+		}
+
+		auto const projectedPoint = compact_load(point.positionWorldOnA) - compact_load(point.normalWorldOnB) * point.distance;
+		auto const projectedDifference = compact_load(point.positionWorldOnB) - projectedPoint;
+		auto const distance2d = projectedDifference.dot(projectedDifference);
+		if (distance2d > threshold * threshold)
+		{
+			removeContactPoint(manifold, i);
+		}
+		else if (gContactProcessedCallback)
+		{
+			auto manifoldPoint = getManifoldPoint(manifold, i);
+			(*gContactProcessedCallback)(manifoldPoint, const_cast<btCollisionObject*>(header.body0), const_cast<btCollisionObject*>(header.body1));
+			setManifoldPoint(manifold, i, manifoldPoint);
+		}
+	}
+}
+
+inline void CompactManifoldStore::refreshContactPoints()
+{
+	auto const refresh = [this](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			if (manifolds[i].pointNum == 0)
+				continue;
+			refreshContactPoints(i, manifolds[i].body0->getWorldTransform(), manifolds[i].body1->getWorldTransform());
+		}
+	};
+	struct RefreshBody : public btIParallelForBody
+	{
+		decltype(refresh) const& f;
+		RefreshBody(decltype(refresh) const& f) : f(f) {}
+		void forLoop(int begin, int end) const override { f(begin, end); }
+	};
+	// ^XNXPW[Ȃ΂̃XbhōXV
+	if (btGetTaskScheduler())
+		btParallelFor(0, getManifoldNum(), grainSize, RefreshBody{ refresh });
+	else
+		refresh(0, getManifoldNum());
+}
+
+inline void CompactManifoldStore::setGrainSize(int size) noexcept
+{
+	grainSize = std::max(size, 1);
+}
+
+inline std::size_t CompactManifoldStore::getContactNum() const noexcept
+{
+	std::size_t num{};
+	for (auto const& manifold : manifolds)
+		num += static_cast<std::size_t>(manifold.pointNum);
+	return num;
+}
+
+inline std::size_t CompactManifoldStore::getHotBytes() const noexcept
+{
+	return manifolds.size() * sizeof(CompactManifold) + points.size() * sizeof(CompactContactPoint);
+}
+
+inline std::size_t CompactManifoldStore::getColdBytes() const noexcept
+{
+	return coldManifolds.size() * sizeof(CompactManifoldCold) + coldPoints.size() * sizeof(CompactContactPointCold);
+}
+
+inline int CompactManifoldStore::sortCachedPoints(int manifold, btManifoldPoint const& newPoint) const
+{
+	// Ԑ[_͎cAc4ʂňԖʐς傫Ȃ_Ɠւ
+	int maxPenetrationIndex = -1;
+	btScalar maxPenetration = newPoint.getDistance();
+	for (int i = 0; i < 4; i++)
+	{
+		if (getContactPoint(manifold, i).distance < maxPenetration)
+		{
+			maxPenetrationIndex = i;
+			maxPenetration = getContactPoint(manifold, i).distance;
+		}
+	}
+
+	btVector3 const p[4]{
+		compact_load(getContactPoint(manifold, 0).localPointA),
+		compact_load(getContactPoint(manifold, 1).localPointA),
+		compact_load(getContactPoint(manifold, 2).localPointA),
+		compact_load(getContactPoint(manifold, 3).localPointA),
+	};
+	auto const& pt = newPoint.m_localPointA;
+
+	btScalar res0(btScalar(0.)), res1(btScalar(0.)), res2(btScalar(0.)), res3(btScalar(0.));
+	if (gContactCalcArea3Points)
+	{
+		if (maxPenetrationIndex != 0)
+			res0 = (pt - p[1]).cross(p[3] - p[2]).length2();
+		if (maxPenetrationIndex != 1)
+			res1 = (pt - p[0]).cross(p[3] - p[2]).length2();
+		if (maxPenetrationIndex != 2)
+			res2 = (pt - p[0]).cross(p[3] - p[1]).length2();
+		if (maxPenetrationIndex != 3)
+			res3 = (pt - p[0]).cross(p[2] - p[1]).length2();
+	}
+	else
+	{
+		// btPersistentManifold.cppcalcArea4PointsƓ
+		auto const area = [](btVector3 const& p0, btVector3 const& p1, btVector3 const& p2, btVector3 const& p3) {
+			auto const tmp0 = (p0 - p1).cross(p2 - p3);
+			auto const tmp1 = (p0 - p2).cross(p1 - p3);
+			auto const tmp2 = (p0 - p3).cross(p1 - p2);
+			return btMax(btMax(tmp0.length2(), tmp1.length2()), tmp2.length2());
+		};
+		if (maxPenetrationIndex != 0)
+			res0 = area(pt, p[1], p[2], p[3]);
+		if (maxPenetrationIndex != 1)
+			res1 = area(pt, p[0], p[2], p[3]);
+		if (maxPenetrationIndex != 2)
+			res2 = area(pt, p[0], p[1], p[3]);
+		if (maxPenetrationIndex != 3)
+			res3 = area(pt, p[0], p[1], p[2]);
+	}
+
+	btVector4 const maxvec(res0, res1, res2, res3);
+	return maxvec.closestAxis4();
+}
+
+inline void CompactManifoldStore::clearUserCache(CompactContactPointCold& cold)
+{
+	if (cold.userPersistentData && gContactDestroyedCallback)
+	{
+		(*gContactDestroyedCallback)(cold.userPersistentData);
+		cold.userPersistentData = nullptr;
+	}
+}
+
+inline btScalar CompactContactSolver::solveCompactGroup(btCollisionObject** bodies, int numBodies, CompactManifoldStore& store, int const* manifolds, int manifoldNum,
+	btTypedConstraint** constraints, int numConstraints, btContactSolverInfo const& infoGlobal, btIDebugDraw* debugDrawer)
+{
+	currentStore = &store;
+	currentManifolds = manifolds;
+	currentManifoldNum = manifoldNum;
+	auto const result = solveGroup(bodies, numBodies, nullptr, 0, constraints, numConstraints, infoGlobal, debugDrawer, nullptr);
+	currentStore = nullptr;
+	currentManifolds = nullptr;
+	currentManifoldNum = 0;
+	return result;
+}
+
+inline void CompactContactSolver::convertContacts(btPersistentManifold** manifoldPtr, int numManifolds, btContactSolverInfo const& infoGlobal)
+{
+	btSequentialImpulseConstraintSolver::convertContacts(manifoldPtr, numManifolds, infoGlobal);
+	if (currentStore)
+		convertCompactContacts(*currentStore, currentManifolds, currentManifoldNum, infoGlobal);
+}
+
+inline btScalar CompactContactSolver::solveGroupCacheFriendlyFinish(btCollisionObject** bodies, int numBodies, btContactSolverInfo const& infoGlobal)
+{
+	if (currentStore && (infoGlobal.m_solverMode & SOLVER_USE_WARMSTARTING))
+	{
+		writeBackCompactContacts(*currentStore, infoGlobal);
+		// ̊֐btManifoldPointƂď߂Ȃ悤ɂ
+		m_tmpSolverContactConstraintPool.resizeNoInitialize(0);
+	}
+	return btSequentialImpulseConstraintSolver::solveGroupCacheFriendlyFinish(bodies, numBodies, infoGlobal);
+}
+
+inline void CompactContactSolver::convertCompactContacts(CompactManifoldStore& store, int const* manifolds, int manifoldNum, btContactSolverInfo const& infoGlobal)
+{
+	for (int i = 0; i < manifoldNum; i++)
+		convertCompactContact(store, manifolds ? manifolds[i] : i, infoGlobal);
+}
+
+inline void CompactContactSolver::convertCompactContact(CompactManifoldStore& store, int manifold, btContactSolverInfo const& infoGlobal)
+{
+	auto const& header = store.getManifold(manifold);
+	auto const colObj0 = const_cast<btCollisionObject*>(header.body0);
+	auto const colObj1 = const_cast<btCollisionObject*>(header.body1);
+
+	int const solverBodyIdA = getOrInitSolverBody(*colObj0, infoGlobal.m_timeStep);
+	int const solverBodyIdB = getOrInitSolverBody(*colObj1, infoGlobal.m_timeStep);
+	btSolverBody* solverBodyA = &m_tmpSolverBodyPool[solverBodyIdA];
+	btSolverBody* solverBodyB = &m_tmpSolverBodyPool[solverBodyIdB];
+
+	// ÓIȍ̂ǂ͉Ȃ
+	if (!solverBodyA || (solverBodyA->m_invMass.fuzzyZero() && (!solverBodyB || solverBodyB->m_invMass.fuzzyZero())))
+		return;
+
+	constexpr int flaggedMask = BT_CONTACT_FLAG_HAS_CONTACT_CFM | BT_CONTACT_FLAG_HAS_CONTACT_ERP | BT_CONTACT_FLAG_CONTACT_STIFFNESS_DAMPING |
+		BT_CONTACT_FLAG_FRICTION_ANCHOR | COMPACT_CONTACT_FLAG_ROLLING_FRICTION;
+	auto const frictionCaching = (infoGlobal.m_solverMode & SOLVER_ENABLE_FRICTION_DIRECTION_CACHING) != 0;
+	auto const twoFrictionDirections = (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) != 0;
+
+	for (int j = 0; j < header.pointNum; j++)
+	{
+		auto& cp = store.getContactPoint(manifold, j);
+		if (!(cp.distance <= header.contactProcessingThreshold))
+			continue;
+
+		int const frictionIndex = m_tmpSolverContactConstraintPool.size();
+		btSolverConstraint& solverConstraint = m_tmpSolverContactConstraintPool.expandNonInitializing();
+		solverConstraint.m_solverBodyIdA = solverBodyIdA;
+		solverConstraint.m_solverBodyIdB = solverBodyIdB;
+		solverConstraint.m_originalContactPoint = &cp;
+
+		auto const normal = compact_load(cp.normalWorldOnB);
+		btVector3 const rel_pos1 = compact_load(cp.positionWorldOnA) - colObj0->getWorldTransform().getOrigin();
+		btVector3 const rel_pos2 = compact_load(cp.positionWorldOnB) - colObj1->getWorldTransform().getOrigin();
+
+		btVector3 vel1;
+		btVector3 vel2;
+		solverBodyA->getVelocityInLocalPointNoDelta(rel_pos1, vel1);
+		solverBodyB->getVelocityInLocalPointNoDelta(rel_pos2, vel2);
+		btVector3 const vel = vel1 - vel2;
+		btScalar const rel_vel = normal.dot(vel);
+
+		if ((cp.flags & flaggedMask) || (frictionCaching && (cp.flags & BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED)))
+		{
+			convertFlaggedContactPoint(store, manifold, j, solverConstraint, solverBodyIdA, solverBodyIdB, frictionIndex, rel_pos1, rel_pos2, vel, rel_vel, infoGlobal);
+			continue;
+		}
+
+		btScalar relaxation;
+		setupCompactContactConstraint(solverConstraint, solverBodyIdA, solverBodyIdB, cp, normal, infoGlobal, relaxation, rel_pos1, rel_pos2);
+		solverConstraint.m_frictionIndex = m_tmpSolverContactFrictionConstraintPool.size();
+
+		// ČbtManifoldPointƓ₽Ɏc
+		auto& cold = store.getColdContactPoint(cp);
+		cold.lateralFrictionDir1 = vel - normal * rel_vel;
+		btScalar const lat_rel_vel = cold.lateralFrictionDir1.length2();
+		if (!(infoGlobal.m_solverMode & SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION) && lat_rel_vel > SIMD_EPSILON)
+		{
+			cold.lateralFrictionDir1 *= 1.f / btSqrt(lat_rel_vel);
+			applyAnisotropicFriction(colObj0, cold.lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			applyAnisotropicFriction(colObj1, cold.lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			addCompactFrictionConstraint(cold.lateralFrictionDir1, solverBodyIdA, solverBodyIdB, frictionIndex, cp.combinedFriction, rel_pos1, rel_pos2, relaxation);
+
+			if (twoFrictionDirections)
+			{
+				cold.lateralFrictionDir2 = cold.lateralFrictionDir1.cross(normal);
+				cold.lateralFrictionDir2.normalize();
+				applyAnisotropicFriction(colObj0, cold.lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				applyAnisotropicFriction(colObj1, cold.lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				addCompactFrictionConstraint(cold.lateralFrictionDir2, solverBodyIdA, solverBodyIdB, frictionIndex, cp.combinedFriction, rel_pos1, rel_pos2, relaxation);
+			}
+		}
+		else
+		{
+			btPlaneSpace1(normal, cold.lateralFrictionDir1, cold.lateralFrictionDir2);
+
+			applyAnisotropicFriction(colObj0, cold.lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			applyAnisotropicFriction(colObj1, cold.lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			addCompactFrictionConstraint(cold.lateralFrictionDir1, solverBodyIdA, solverBodyIdB, frictionIndex, cp.combinedFriction, rel_pos1, rel_pos2, relaxation);
+
+			if (twoFrictionDirections)
+			{
+				applyAnisotropicFriction(colObj0, cold.lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				applyAnisotropicFriction(colObj1, cold.lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				addCompactFrictionConstraint(cold.lateralFrictionDir2, solverBodyIdA, solverBodyIdB, frictionIndex, cp.combinedFriction, rel_pos1, rel_pos2, relaxation);
+			}
+
+			if (twoFrictionDirections && (infoGlobal.m_solverMode & SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION))
+				cp.flags |= BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED;
+		}
+
+		// setFrictionConstraintImpulseƓAC͑O̗͐ςn߂Ȃ
+		m_tmpSolverContactFrictionConstraintPool[solverConstraint.m_frictionIndex].m_appliedImpulse = 0.f;
+		if (twoFrictionDirections)
+			m_tmpSolverContactFrictionConstraintPool[solverConstraint.m_frictionIndex + 1].m_appliedImpulse = 0.f;
+	}
+}
+
+inline void CompactContactSolver::writeBackCompactContacts(CompactManifoldStore& store, btContactSolverInfo const& infoGlobal)
+{
+	for (int j = 0; j < m_tmpSolverContactConstraintPool.size(); j++)
+	{
+		auto const& solverConstraint = m_tmpSolverContactConstraintPool[j];
+		auto& cp = *static_cast<CompactContactPoint*>(solverConstraint.m_originalContactPoint);
+		auto& cold = store.getColdContactPoint(cp);
+		cp.appliedImpulse = solverConstraint.m_appliedImpulse;
+		cold.appliedImpulseLateral1 = m_tmpSolverContactFrictionConstraintPool[solverConstraint.m_frictionIndex].m_appliedImpulse;
+		if (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS)
+			cold.appliedImpulseLateral2 = m_tmpSolverContactFrictionConstraintPool[solverConstraint.m_frictionIndex + 1].m_appliedImpulse;
+	}
+}
+
+inline void CompactContactSolver::setupCompactContactConstraint(btSolverConstraint& solverConstraint, int solverBodyIdA, int solverBodyIdB, CompactContactPoint const& cp,
+	btVector3 const& normal, btContactSolverInfo const& infoGlobal, btScalar& relaxation, btVector3 const& rel_pos1, btVector3 const& rel_pos2)
+{
+	btSolverBody* bodyA = &m_tmpSolverBodyPool[solverBodyIdA];
+	btSolverBody* bodyB = &m_tmpSolverBodyPool[solverBodyIdB];
+	btRigidBody* rb0 = bodyA->m_originalBody;
+	btRigidBody* rb1 = bodyB->m_originalBody;
+
+	relaxation = infoGlobal.m_sor;
+	btScalar const invTimeStep = btScalar(1) / infoGlobal.m_timeStep;
+
+	// ڐGƂCFMERP̓tÔ_Ȃ̂ŁAł͑Ŝ̒l
+	btScalar cfm = infoGlobal.m_globalCfm;
+	btScalar const erp = infoGlobal.m_erp2;
+	cfm *= invTimeStep;
+
+	btVector3 const torqueAxis0 = rel_pos1.cross(normal);
+	solverConstraint.m_angularComponentA = rb0 ? rb0->getInvInertiaTensorWorld() * torqueAxis0 * rb0->getAngularFactor() : btVector3(0, 0, 0);
+	btVector3 const torqueAxis1 = rel_pos2.cross(normal);
+	solverConstraint.m_angularComponentB = rb1 ? rb1->getInvInertiaTensorWorld() * -torqueAxis1 * rb1->getAngularFactor() : btVector3(0, 0, 0);
+
+	{
+		btVector3 vec;
+		btScalar denom0 = 0.f;
+		btScalar denom1 = 0.f;
+		if (rb0)
+		{
+			vec = (solverConstraint.m_angularComponentA).cross(rel_pos1);
+			denom0 = rb0->getInvMass() + normal.dot(vec);
+		}
+		if (rb1)
+		{
+			vec = (-solverConstraint.m_angularComponentB).cross(rel_pos2);
+			denom1 = rb1->getInvMass() + normal.dot(vec);
+		}
+		btScalar const denom = relaxation / (denom0 + denom1 + cfm);
+		solverConstraint.m_jacDiagABInv = denom;
+	}
+
+	if (rb0)
+	{
+		solverConstraint.m_contactNormal1 = normal;
+		solverConstraint.m_relpos1CrossNormal = torqueAxis0;
+	}
+	else
+	{
+		solverConstraint.m_contactNormal1.setZero();
+		solverConstraint.m_relpos1CrossNormal.setZero();
+	}
+	if (rb1)
+	{
+		solverConstraint.m_contactNormal2 = -normal;
+		solverConstraint.m_relpos2CrossNormal = -torqueAxis1;
+	}
+	else
+	{
+		solverConstraint.m_contactNormal2.setZero();
+		solverConstraint.m_relpos2CrossNormal.setZero();
+	}
+
+	btScalar restitution = 0.f;
+	btScalar const penetration = cp.distance + infoGlobal.m_linearSlop;
+
+	{
+		btVector3 const vel1 = rb0 ? rb0->getVelocityInLocalPoint(rel_pos1) : btVector3(0, 0, 0);
+		btVector3 const vel2 = rb1 ? rb1->getVelocityInLocalPoint(rel_pos2) : btVector3(0, 0, 0);
+		btVector3 const vel = vel1 - vel2;
+		btScalar const rel_vel = normal.dot(vel);
+
+		solverConstraint.m_friction = cp.combinedFriction;
+
+		restitution = restitutionCurve(rel_vel, cp.combinedRestitution, infoGlobal.m_restitutionVelocityThreshold);
+		if (restitution <= btScalar(0.))
+			restitution = 0.f;
+	}
+
+	// ÕXebv̗͐ςn߂
+	if (infoGlobal.m_solverMode & SOLVER_USE_WARMSTARTING)
+	{
+		solverConstraint.m_appliedImpulse = cp.appliedImpulse * infoGlobal.m_warmstartingFactor;
+		if (rb0)
+			bodyA->internalApplyImpulse(solverConstraint.m_contactNormal1 * bodyA->internalGetInvMass(), solverConstraint.m_angularComponentA, solverConstraint.m_appliedImpulse);
+		if (rb1)
+			bodyB->internalApplyImpulse(-solverConstraint.m_contactNormal2 * bodyB->internalGetInvMass(), -solverConstraint.m_angularComponentB, -(btScalar)solverConstraint.m_appliedImpulse);
+	}
+	else
+	{
+		solverConstraint.m_appliedImpulse = 0.f;
+	}
+
+	solverConstraint.m_appliedPushImpulse = 0.f;
+
+	{
+		btVector3 const externalForceImpulseA = bodyA->m_originalBody ? bodyA->m_externalForceImpulse : btVector3(0, 0, 0);
+		btVector3 const externalTorqueImpulseA = bodyA->m_originalBody ? bodyA->m_externalTorqueImpulse : btVector3(0, 0, 0);
+		btVector3 const externalForceImpulseB = bodyB->m_originalBody ? bodyB->m_externalForceImpulse : btVector3(0, 0, 0);
+		btVector3 const externalTorqueImpulseB = bodyB->m_originalBody ? bodyB->m_externalTorqueImpulse : btVector3(0, 0, 0);
+
+		btScalar const vel1Dotn = solverConstraint.m_contactNormal1.dot(bodyA->m_linearVelocity + externalForceImpulseA) + solverConstraint.m_relpos1CrossNormal.dot(bodyA->m_angularVelocity + externalTorqueImpulseA);
+		btScalar const vel2Dotn = solverConstraint.m_contactNormal2.dot(bodyB->m_linearVelocity + externalForceImpulseB) + solverConstraint.m_relpos2CrossNormal.dot(bodyB->m_angularVelocity + externalTorqueImpulseB);
+		btScalar const rel_vel = vel1Dotn + vel2Dotn;
+
+		btScalar positionalError = 0.f;
+		btScalar velocityError = restitution - rel_vel;
+
+		if (penetration > 0)
+		{
+			positionalError = 0;
+			velocityError -= penetration * invTimeStep;
+		}
+		else
+		{
+			positionalError = -penetration * erp * invTimeStep;
+		}
+
+		btScalar const penetrationImpulse = positionalError * solverConstraint.m_jacDiagABInv;
+		btScalar const velocityImpulse = velocityError * solverConstraint.m_jacDiagABInv;
+
+		if (!infoGlobal.m_splitImpulse || (penetration > infoGlobal.m_splitImpulsePenetrationThreshold))
+		{
+			solverConstraint.m_rhs = penetrationImpulse + velocityImpulse;
+			solverConstraint.m_rhsPenetration = 0.f;
+		}
+		else
+		{
+			solverConstraint.m_rhs = velocityImpulse;
+			solverConstraint.m_rhsPenetration = penetrationImpulse;
+		}
+		solverConstraint.m_cfm = cfm * solverConstraint.m_jacDiagABInv;
+		solverConstraint.m_lowerLimit = 0;
+		solverConstraint.m_upperLimit = 1e10f;
+	}
+}
+
+inline void CompactContactSolver::addCompactFrictionConstraint(btVector3 const& normalAxis, int solverBodyIdA, int solverBodyIdB, int frictionIndex, btScalar friction,
+	btVector3 const& rel_pos1, btVector3 const& rel_pos2, btScalar relaxation)
+{
+	btSolverConstraint& solverConstraint = m_tmpSolverContactFrictionConstraintPool.expandNonInitializing();
+	solverConstraint.m_frictionIndex = frictionIndex;
+
+	btSolverBody& solverBodyA = m_tmpSolverBodyPool[solverBodyIdA];
+	btSolverBody& solverBodyB = m_tmpSolverBodyPool[solverBodyIdB];
+	btRigidBody* body0 = solverBodyA.m_originalBody;
+	btRigidBody* bodyA = solverBodyB.m_originalBody;
+
+	solverConstraint.m_solverBodyIdA = solverBodyIdA;
+	solverConstraint.m_solverBodyIdB = solverBodyIdB;
+	solverConstraint.m_friction = friction;
+	solverConstraint.m_originalContactPoint = 0;
+	solverConstraint.m_appliedImpulse = 0.f;
+	solverConstraint.m_appliedPushImpulse = 0.f;
+
+	if (body0)
+	{
+		solverConstraint.m_contactNormal1 = normalAxis;
+		btVector3 const ftorqueAxis1 = rel_pos1.cross(solverConstraint.m_contactNormal1);
+		solverConstraint.m_relpos1CrossNormal = ftorqueAxis1;
+		solverConstraint.m_angularComponentA = body0->getInvInertiaTensorWorld() * ftorqueAxis1 * body0->getAngularFactor();
+	}
+	else
+	{
+		solverConstraint.m_contactNormal1.setZero();
+		solverConstraint.m_relpos1CrossNormal.setZero();
+		solverConstraint.m_angularComponentA.setZero();
+	}
+
+	if (bodyA)
+	{
+		solverConstraint.m_contactNormal2 = -normalAxis;
+		btVector3 const ftorqueAxis1 = rel_pos2.cross(solverConstraint.m_contactNormal2);
+		solverConstraint.m_relpos2CrossNormal = ftorqueAxis1;
+		solverConstraint.m_angularComponentB = bodyA->getInvInertiaTensorWorld() * ftorqueAxis1 * bodyA->getAngularFactor();
+	}
+	else
+	{
+		solverConstraint.m_contactNormal2.setZero();
+		solverConstraint.m_relpos2CrossNormal.setZero();
+		solverConstraint.m_angularComponentB.setZero();
+	}
+
+	{
+		btVector3 vec;
+		btScalar denom0 = 0.f;
+		btScalar denom1 = 0.f;
+		if (body0)
+		{
+			vec = (solverConstraint.m_angularComponentA).cross(rel_pos1);
+			denom0 = body0->getInvMass() + normalAxis.dot(vec);
+		}
+		if (bodyA)
+		{
+			vec = (-solverConstraint.m_angularComponentB).cross(rel_pos2);
+			denom1 = bodyA->getInvMass() + normalAxis.dot(vec);
+		}
+		btScalar const denom = relaxation / (denom0 + denom1);
+		solverConstraint.m_jacDiagABInv = denom;
+	}
+
+	{
+		btScalar const vel1Dotn = solverConstraint.m_contactNormal1.dot(body0 ? solverBodyA.m_linearVelocity + solverBodyA.m_externalForceImpulse : btVector3(0, 0, 0)) + solverConstraint.m_relpos1CrossNormal.dot(body0 ? solverBodyA.m_angularVelocity : btVector3(0, 0, 0));
+		btScalar const vel2Dotn = solverConstraint.m_contactNormal2.dot(bodyA ? solverBodyB.m_linearVelocity + solverBodyB.m_externalForceImpulse : btVector3(0, 0, 0)) + solverConstraint.m_relpos2CrossNormal.dot(bodyA ? solverBodyB.m_angularVelocity : btVector3(0, 0, 0));
+		btScalar const rel_vel = vel1Dotn + vel2Dotn;
+
+		// ۂ߂-0̈̎Ɠɂ
+		btScalar const desiredVelocity = 0.;
+		btScalar const velocityError = desiredVelocity - rel_vel;
+		btScalar const velocityImpulse = velocityError * solverConstraint.m_jacDiagABInv;
+		btScalar const penetrationImpulse = btScalar(0);
+
+		solverConstraint.m_rhs = penetrationImpulse + velocityImpulse;
+		solverConstraint.m_rhsPenetration = 0.f;
+		solverConstraint.m_cfm = 0.;
+		solverConstraint.m_lowerLimit = -solverConstraint.m_friction;
+		solverConstraint.m_upperLimit = solverConstraint.m_friction;
+	}
+}
+
+inline void CompactContactSolver::convertFlaggedContactPoint(CompactManifoldStore& store, int manifold, int index, btSolverConstraint& solverConstraint, int solverBodyIdA, int solverBodyIdB,
+	int frictionIndex, btVector3 const& rel_pos1, btVector3 const& rel_pos2, btVector3 const& vel, btScalar rel_vel, btContactSolverInfo const& infoGlobal)
+{
+	auto const& header = store.getManifold(manifold);
+	auto const colObj0 = const_cast<btCollisionObject*>(header.body0);
+	auto const colObj1 = const_cast<btCollisionObject*>(header.body1);
+	auto cp = store.getManifoldPoint(manifold, index);
+
+	btScalar relaxation;
+	setupContactConstraint(solverConstraint, solverBodyIdA, solverBodyIdB, cp, infoGlobal, relaxation, rel_pos1, rel_pos2);
+	solverConstraint.m_frictionIndex = m_tmpSolverContactFrictionConstraintPool.size();
+
+	if (cp.m_combinedRollingFriction > 0.f)
+	{
+		addTorsionalFrictionConstraint(cp.m_normalWorldOnB, solverBodyIdA, solverBodyIdB, frictionIndex, cp, cp.m_combinedSpinningFriction, rel_pos1, rel_pos2, colObj0, colObj1, relaxation);
+		btVector3 axis0, axis1;
+		btPlaneSpace1(cp.m_normalWorldOnB, axis0, axis1);
+		axis0.normalize();
+		axis1.normalize();
+
+		applyAnisotropicFriction(colObj0, axis0, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+		applyAnisotropicFriction(colObj1, axis0, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+		applyAnisotropicFriction(colObj0, axis1, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+		applyAnisotropicFriction(colObj1, axis1, btCollisionObject::CF_ANISOTROPIC_ROLLING_FRICTION);
+		if (axis0.length() > 0.001)
+			addTorsionalFrictionConstraint(axis0, solverBodyIdA, solverBodyIdB, frictionIndex, cp, cp.m_combinedRollingFriction, rel_pos1, rel_pos2, colObj0, colObj1, relaxation);
+		if (axis1.length() > 0.001)
+			addTorsionalFrictionConstraint(axis1, solverBodyIdA, solverBodyIdB, frictionIndex, cp, cp.m_combinedRollingFriction, rel_pos1, rel_pos2, colObj0, colObj1, relaxation);
+	}
+
+	if (!(infoGlobal.m_solverMode & SOLVER_ENABLE_FRICTION_DIRECTION_CACHING) || !(cp.m_contactPointFlags & BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED))
+	{
+		cp.m_lateralFrictionDir1 = vel - cp.m_normalWorldOnB * rel_vel;
+		btScalar const lat_rel_vel = cp.m_lateralFrictionDir1.length2();
+		if (!(infoGlobal.m_solverMode & SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION) && lat_rel_vel > SIMD_EPSILON)
+		{
+			cp.m_lateralFrictionDir1 *= 1.f / btSqrt(lat_rel_vel);
+			applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			addFrictionConstraint(cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
+
+			if (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS)
+			{
+				cp.m_lateralFrictionDir2 = cp.m_lateralFrictionDir1.cross(cp.m_normalWorldOnB);
+				cp.m_lateralFrictionDir2.normalize();
+				applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				addFrictionConstraint(cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
+			}
+		}
+		else
+		{
+			btPlaneSpace1(cp.m_normalWorldOnB, cp.m_lateralFrictionDir1, cp.m_lateralFrictionDir2);
+
+			applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir1, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+			addFrictionConstraint(cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
+
+			if (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS)
+			{
+				applyAnisotropicFriction(colObj0, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				applyAnisotropicFriction(colObj1, cp.m_lateralFrictionDir2, btCollisionObject::CF_ANISOTROPIC_FRICTION);
+				addFrictionConstraint(cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal);
+			}
+
+			if ((infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS) && (infoGlobal.m_solverMode & SOLVER_DISABLE_VELOCITY_DEPENDENT_FRICTION_DIRECTION))
+				cp.m_contactPointFlags |= BT_CONTACT_FLAG_LATERAL_FRICTION_INITIALIZED;
+		}
+	}
+	else
+	{
+		addFrictionConstraint(cp.m_lateralFrictionDir1, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal, cp.m_contactMotion1, cp.m_frictionCFM);
+		if (infoGlobal.m_solverMode & SOLVER_USE_2_FRICTION_DIRECTIONS)
+			addFrictionConstraint(cp.m_lateralFrictionDir2, solverBodyIdA, solverBodyIdB, frictionIndex, cp, rel_pos1, rel_pos2, colObj0, colObj1, relaxation, infoGlobal, cp.m_contactMotion2, cp.m_frictionCFM);
+	}
+	setFrictionConstraintImpulse(solverConstraint, solverBodyIdA, solverBodyIdB, cp, infoGlobal);
+
+	// ČƃtO߂
+	store.setManifoldPoint(manifold, index, cp);
+}
@@ -0,0 +1,909 @@
+#pragma once
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"SoaSoftBody.hpp"
+#include<algorithm>
+#include<array>
+#include<cmath>
+#include<span>
+#include<vector>
+
+// ߓ_Ƃ3xNgƂ̔zŎ
+using DeformableVector = std::array<std::vector<btScalar>, 3>;
+
+// ͂̌W
+struct DeformableMaterial
+{
+	// btDeformableMassSpringForcem_elasticStiffnessm_dampingStiffness
+	btScalar springStiffness = 100;
+	btScalar springDamping = btScalar(0.1);
+	// btDeformableNeoHookeanForcem_muAm_lambdaAdamping
+	btScalar mu = 1;
+	btScalar lambda = 1;
+	btScalar neoHookeanDamping = btScalar(0.05);
+};
+
+// btDeformableNeoHookeanForce̎Ŏglʑ̂̕ό`
+struct NeoHookeanScratch
+{
+	btMatrix3x3 F{};
+	btMatrix3x3 cofF{};
+	btScalar J{};
+	btScalar trace{};
+};
+
+// lʑ̂(h^2 * df/dx + h * df/dv) * dxAstep̊Ԃ͕ςȂWɂ܂Ƃ߂
+// ̐ςhWɓĂ̂ŁAтɊZȂĂ悢
+struct NeoHookeanStiffness
+{
+	NeoHookeanScratch scratch{};
+	// dFAdF̓]uAFEdF{FAcofFEdF{cofFA]qs̔AdF̐Ք{̒PʍsɂW
+	btScalar dF{};
+	btScalar dFTranspose{};
+	btScalar F{};
+	btScalar cofF{};
+	btScalar cofactor{};
+	btScalar trace{};
+};
+
+// ΂˂̌ƁARLт
+struct SpringScratch
+{
+	btVector3 direction{ 0,0,0 };
+	btScalar stretch{};
+};
+
+NeoHookeanScratch make_neo_hookean_scratch(btMatrix3x3 const& F);
+// btDeformableNeoHookeanForce::firstPiolaAfirstPiolaDifferentialƓ
+btMatrix3x3 neo_hookean_piola(NeoHookeanScratch const& s, btScalar mu, btScalar lambda);
+btMatrix3x3 neo_hookean_piola_differential(NeoHookeanScratch const& s, btMatrix3x3 const& dF, btScalar mu, btScalar lambda);
+// btDeformableNeoHookeanForce::addScaledDampingForceƓ
+btMatrix3x3 neo_hookean_damping_piola(btMatrix3x3 const& dF, btScalar muDamp, btScalar lambdaDamp);
+// F̗]qśAdF̌̔
+btMatrix3x3 cofactor_differential(btMatrix3x3 const& F, btMatrix3x3 const& dF);
+NeoHookeanStiffness make_neo_hookean_stiffness(NeoHookeanScratch const& s, DeformableMaterial const& material, btScalar volume, btScalar h);
+// tetra_nodal_forces(neo_hookean_piola_differential * h^2 + neo_hookean_damping_piola * h)Ɠ̗͂Ԃ
+btMatrix3x3 neo_hookean_stiffness_forces(NeoHookeanStiffness const& k, btMatrix3x3 const& dF, btMatrix3x3 const& dmInverse);
+// x1 - x0Ax2 - x0Ax3 - x0ɂs
+btMatrix3x3 tetra_edge_matrix(btVector3 const& x0, btVector3 const& x1, btVector3 const& x2, btVector3 const& x3);
+// Plʑ̂1A2A3Ԃ̐ߓ_ɂ͂ɂsԂA0Ԃ̗͂3̘a̋t
+btMatrix3x3 tetra_nodal_forces(btMatrix3x3 const& P, btMatrix3x3 const& dmInverse, btScalar volume);
+// ΂˂0Ԃ̐ߓ_ɂ́Adx1 - x0Awv1 - v0A1Ԃ̐ߓ_ɂ͋tɂ
+btVector3 spring_force(btVector3 const& d, btVector3 const& w, btScalar restLength, btScalar stiffness, btScalar damping);
+// ߓ_dx0Adx1Ƃ0Ԃ̐ߓ_̗͂̕ωAdeltadx1 - dx0
+// kłƂ͉̍𗎂ƂāAs𔼐lɂ
+btVector3 spring_elastic_differential(btVector3 const& d, btScalar restLength, btScalar stiffness, btVector3 const& delta);
+// drestLengthɋ߂sœlԂAĂԂɈʒu͕ςȂ̂ŉxg
+SpringScratch make_spring_scratch(btVector3 const& d, btScalar restLength);
+btVector3 spring_elastic_differential(SpringScratch const& s, btScalar stiffness, btVector3 const& delta);
+
+// ΂˂Ǝlʑ̂̐ߓ_Ƃ̔zŎό`
+// ͂btDeformableMassSpringForcebtDeformableNeoHookeanForceƓŁADeformableKrylovSolverŉAIɐi߂
+class SoaDeformableBody
+{
+	friend class DeformableKrylovSolver;
+
+	DeformableMaterial material{};
+	btVector3 gravity{ 0, btScalar(-9.8), 0 };
+
+	DeformableVector position{};
+	DeformableVector velocity{};
+	std::vector<btScalar> mass{};
+	std::vector<btScalar> inverseMass{};
+
+	std::vector<int> springNode0{};
+	std::vector<int> springNode1{};
+	std::vector<btScalar> springRestLength{};
+
+	std::vector<std::array<int, 4>> tetraNode{};
+	std::vector<btMatrix3x3> tetraDmInverse{};
+	std::vector<btScalar> tetraVolume{};
+
+	// vfߓ_ɓnl̒uꏊ́A΂˂2AĎlʑ̂4
+	// ߓ_i̒uꏊincidenceSlotincidenceBegin[i]incidenceBegin[i + 1]܂
+	std::vector<int> incidenceBegin{};
+	std::vector<int> incidenceSlot{};
+	bool incidenceDirty = true;
+
+	void buildIncidence();
+
+public:
+	SoaDeformableBody(DeformableMaterial const& material = {});
+	virtual ~SoaDeformableBody() = default;
+	SoaDeformableBody(SoaDeformableBody const&) = delete;
+	SoaDeformableBody& operator=(SoaDeformableBody const&) = delete;
+
+	// mass0Ȃ瓮Ȃߓ_AԍԂ
+	int appendNode(btVector3 const& x, btScalar mass);
+	void setMass(int node, btScalar mass);
+	// R͍̐ߓ_̋
+	void appendSpring(int node0, int node1);
+	// ̌`RȌ`ɂAԂĂ2Ԃ3Ԃւ
+	void appendTetra(int node0, int node1, int node2, int node3);
+
+	DeformableMaterial const& getMaterial() const noexcept { return material; }
+	void setMaterial(DeformableMaterial const& material) noexcept { this->material = material; }
+	btVector3 const& getGravity() const noexcept { return gravity; }
+	void setGravity(btVector3 const& gravity) noexcept { this->gravity = gravity; }
+
+	int getNodeNum() const noexcept { return static_cast<int>(mass.size()); }
+	int getSpringNum() const noexcept { return static_cast<int>(springNode0.size()); }
+	int getTetraNum() const noexcept { return static_cast<int>(tetraNode.size()); }
+	int getSlotNum() const noexcept { return 2 * getSpringNum() + 4 * getTetraNum(); }
+	btScalar getMass(int node) const { return mass[node]; }
+	btVector3 getPosition(int node) const;
+	btVector3 getVelocity(int node) const;
+	std::span<btScalar const> getPositions(int axis) const noexcept { return position[axis]; }
+};
+
+enum class DeformableKrylovMethod
+{
+	// btConjugateGradient
+	ConjugateGradient,
+	// btConjugateResidual
+	ConjugateResidual,
+};
+
+struct DeformableKrylovConfig
+{
+	DeformableKrylovMethod method = DeformableKrylovMethod::ConjugateGradient;
+	// Eӂ̃mɑ΂c̃m̔
+	btScalar tolerance = btScalar(1e-5);
+	int maxIterations = 200;
+	// ߓ_Ɨvf𕪂傫Aς͂̐̐ߓ_ƂɑĂ܂Ƃ߂
+	int grainSize = 256;
+};
+
+struct DeformableKrylovStats
+{
+	int iterations{};
+	// Eӂ̃mɑ΂
+	btScalar residual{};
+	bool converged = false;
+};
+
+// btDeformableBackwardEulerObjectiveƓރIC[̘A
+//   (M - h * df/dv - h^2 * df/dx) dv = h * (f + h * df/dx * v)
+// As炸ɃNtԖ@ŉĐi߂
+// vfƂ̒l͗vf𕪂ĕɒuꏊ֏Aߓ_𕪂ĕɏW߂̂ŁA݂ԂȂ
+// 1XbĥƂ͒uꏊʂɗvf̏Őߓ_֒ڑAߓ_Ƃɑ͏W߂ƂƓȂ̂Ōʂ͕ςȂ
+// ς͌܂̐ߓ_ƂɑĂ珇ɂ܂Ƃ߂̂ŁAʂ̓XbhɂȂ
+// Ɨp̔z͎stepłgAߓ_vf̐ƂmۂȂ
+// ObtDeformableBackwardEulerObjective̊Ɠʂ̋t
+class DeformableKrylovSolver
+{
+	DeformableKrylovConfig config{};
+	DeformableKrylovStats stats{};
+
+	DeformableVector rhs{};
+	DeformableVector dv{};
+	DeformableVector r{};
+	DeformableVector z{};
+	DeformableVector p{};
+	DeformableVector ap{};
+	// ConjugateResidualŎg
+	DeformableVector az{};
+	DeformableVector q{};
+	// vfߓ_ɓnl
+	DeformableVector slots{};
+	// 1XbĥƂAuꏊg킸ɐߓ_֒ڑ
+	bool scatter = false;
+	std::vector<SpringScratch> springScratch{};
+	std::vector<NeoHookeanStiffness> tetraStiffness{};
+	// ߓ_̂܂Ƃ܂育Ƃ̓
+	std::vector<std::array<btScalar, 2>> partialSums{};
+	std::size_t reallocationNum{};
+
+	void resize(SoaDeformableBody const& body);
+	// vf̃[vAscatterȂvf̏1̃[vŉ
+	template<typename F>
+	void runElements(int num, F const& f);
+	void prepareSprings(SoaDeformableBody const& body);
+	void prepareTetras(SoaDeformableBody const& body, btScalar h);
+	// Eӂrhsɓ
+	void computeRhs(SoaDeformableBody const& body, btScalar h);
+	// out = A x߂āAxEoutԂ
+	btScalar multiply(SoaDeformableBody const& body, DeformableVector const& x, DeformableVector& out, btScalar h);
+	// f(begin, end)Ԃ2̒lAgrainSize̐ߓ_ƂɑĂ܂Ƃ߂
+	template<typename F>
+	std::array<btScalar, 2> reduceNodes(int nodeNum, F const& f);
+	void solveConjugateGradient(SoaDeformableBody const& body, btScalar h, btScalar rhsNorm2);
+	void solveConjugateResidual(SoaDeformableBody const& body, btScalar h, btScalar rhsNorm2);
+
+public:
+	DeformableKrylovSolver(DeformableKrylovConfig const& config = {});
+	virtual ~DeformableKrylovSolver() = default;
+	DeformableKrylovSolver(DeformableKrylovSolver const&) = delete;
+	DeformableKrylovSolver& operator=(DeformableKrylovSolver const&) = delete;
+
+	// x̕ωAxƈʒui߂
+	void step(SoaDeformableBody& body, btScalar dt);
+
+	DeformableKrylovConfig const& getConfig() const noexcept { return config; }
+	void setConfig(DeformableKrylovConfig const& config) noexcept;
+	// Ōstep̌
+	DeformableKrylovStats const& getStats() const noexcept { return stats; }
+	// Ɨp̔zmۂȂ
+	std::size_t getReallocationNum() const noexcept { return reallocationNum; }
+};
+
+//
+// ȉA
+//
+
+inline NeoHookeanScratch make_neo_hookean_scratch(btMatrix3x3 const& F)
+{
+	NeoHookeanScratch s{};
+	s.F = F;
+	s.J = F.determinant();
+	auto const C = F.transpose() * F;
+	s.trace = C[0].getX() + C[1].getY() + C[2].getZ();
+	s.cofF = F.adjoint().transpose();
+	return s;
+}
+
+inline btMatrix3x3 neo_hookean_piola(NeoHookeanScratch const& s, btScalar mu, btScalar lambda)
+{
+	auto const c1 = mu * (1 - 1 / (s.trace + 1));
+	auto const c2 = lambda * (s.J - 1) - btScalar(0.75) * mu;
+	return s.F * c1 + s.cofF * c2;
+}
+
+inline btMatrix3x3 neo_hookean_piola_differential(NeoHookeanScratch const& s, btMatrix3x3 const& dF, btScalar mu, btScalar lambda)
+{
+	auto const dot = [](btMatrix3x3 const& a, btMatrix3x3 const& b) { return a[0].dot(b[0]) + a[1].dot(b[1]) + a[2].dot(b[2]); };
+
+	auto const c1 = mu * (1 - 1 / (s.trace + 1));
+	auto const c2 = (2 * mu) * dot(s.F, dF) * (1 / ((1 + s.trace) * (1 + s.trace)));
+	auto const c3 = lambda * dot(s.cofF, dF);
+	btMatrix3x3 dP = dF * c1 + s.F * c2;
+
+	auto const scale = lambda * (s.J - 1) - btScalar(0.75) * mu;
+	dP += cofactor_differential(s.F, dF) * scale;
+
+	return dP + s.cofF * c3;
+}
+
+inline btMatrix3x3 cofactor_differential(btMatrix3x3 const& F, btMatrix3x3 const& dF)
+{
+	return {
+		dF[1][1] * F[2][2] + F[1][1] * dF[2][2] - dF[2][1] * F[1][2] - F[2][1] * dF[1][2],
+		dF[2][0] * F[1][2] + F[2][0] * dF[1][2] - dF[1][0] * F[2][2] - F[1][0] * dF[2][2],
+		dF[1][0] * F[2][1] + F[1][0] * dF[2][1] - dF[2][0] * F[1][1] - F[2][0] * dF[1][1],
+		dF[2][1] * F[0][2] + F[2][1] * dF[0][2] - dF[0][1] * F[2][2] - F[0][1] * dF[2][2],
+		dF[0][0] * F[2][2] + F[0][0] * dF[2][2] - dF[2][0] * F[0][2] - F[2][0] * dF[0][2],
+		dF[2][0] * F[0][1] + F[2][0] * dF[0][1] - dF[0][0] * F[2][1] - F[0][0] * dF[2][1],
+		dF[0][1] * F[1][2] + F[0][1] * dF[1][2] - dF[1][1] * F[0][2] - F[1][1] * dF[0][2],
+		dF[1][0] * F[0][2] + F[1][0] * dF[0][2] - dF[0][0] * F[1][2] - F[0][0] * dF[1][2],
+		dF[0][0] * F[1][1] + F[0][0] * dF[1][1] - dF[1][0] * F[0][1] - F[1][0] * dF[0][1],
+	};
+}
+
+inline NeoHookeanStiffness make_neo_hookean_stiffness(NeoHookeanScratch const& s, DeformableMaterial const& material, btScalar volume, btScalar h)
+{
+	auto const& mu = material.mu;
+	auto const& lambda = material.lambda;
+	auto const muDamp = material.neoHookeanDamping * mu;
+	auto const h2 = h * h;
+
+	NeoHookeanStiffness k{ .scratch = s };
+	k.dF = -volume * (h2 * mu * (1 - 1 / (s.trace + 1)) + h * muDamp);
+	k.dFTranspose = -volume * h * muDamp;
+	k.F = -volume * h2 * (2 * mu) / ((1 + s.trace) * (1 + s.trace));
+	k.cofF = -volume * h2 * lambda;
+	k.cofactor = -volume * h2 * (lambda * (s.J - 1) - btScalar(0.75) * mu);
+	k.trace = -volume * h * material.neoHookeanDamping * lambda;
+	return k;
+}
+
+inline btMatrix3x3 neo_hookean_stiffness_forces(NeoHookeanStiffness const& k, btMatrix3x3 const& dF, btMatrix3x3 const& dmInverse)
+{
+	auto const dot = [](btMatrix3x3 const& a, btMatrix3x3 const& b) { return a[0].dot(b[0]) + a[1].dot(b[1]) + a[2].dot(b[2]); };
+
+	auto const& s = k.scratch;
+	auto dP = dF * k.dF + dF.transpose() * k.dFTranspose + s.F * (k.F * dot(s.F, dF)) + s.cofF * (k.cofF * dot(s.cofF, dF)) +
+		cofactor_differential(s.F, dF) * k.cofactor;
+	auto const trace = k.trace * (dF[0][0] + dF[1][1] + dF[2][2]);
+	for (int i = 0; i < 3; i++)
+		dP[i][i] += trace;
+	return dP.timesTranspose(dmInverse);
+}
+
+inline btMatrix3x3 neo_hookean_damping_piola(btMatrix3x3 const& dF, btScalar muDamp, btScalar lambdaDamp)
+{
+	return (dF + dF.transpose()) * muDamp + btMatrix3x3::getIdentity() * ((dF[0][0] + dF[1][1] + dF[2][2]) * lambdaDamp);
+}
+
+inline btMatrix3x3 tetra_edge_matrix(btVector3 const& x0, btVector3 const& x1, btVector3 const& x2, btVector3 const& x3)
+{
+	auto const c1 = x1 - x0;
+	auto const c2 = x2 - x0;
+	auto const c3 = x3 - x0;
+	return {
+		c1.getX(), c2.getX(), c3.getX(),
+		c1.getY(), c2.getY(), c3.getY(),
+		c1.getZ(), c2.getZ(), c3.getZ(),
+	};
+}
+
+inline btMatrix3x3 tetra_nodal_forces(btMatrix3x3 const& P, btMatrix3x3 const& dmInverse, btScalar volume)
+{
+	return P.timesTranspose(dmInverse) * -volume;
+}
+
+inline btVector3 spring_force(btVector3 const& d, btVector3 const& w, btScalar restLength, btScalar stiffness, btScalar damping)
+{
+	auto const length = d.length();
+	auto const direction = length > SIMD_EPSILON ? d / length : btVector3(0, 0, 0);
+	return stiffness * (d - direction * restLength) + damping * w;
+}
+
+inline btVector3 spring_elastic_differential(btVector3 const& d, btScalar restLength, btScalar stiffness, btVector3 const& delta)
+{
+	return spring_elastic_differential(make_spring_scratch(d, restLength), stiffness, delta);
+}
+
+inline SpringScratch make_spring_scratch(btVector3 const& d, btScalar restLength)
+{
+	auto const length = d.length();
+	if (!(length > SIMD_EPSILON))
+		return {};
+	return { d / length, std::max((length - restLength) / length, btScalar(0)) };
+}
+
+inline btVector3 spring_elastic_differential(SpringScratch const& s, btScalar stiffness, btVector3 const& delta)
+{
+	auto const along = s.direction * s.direction.dot(delta);
+	return stiffness * (along + s.stretch * (delta - along));
+}
+
+inline SoaDeformableBody::SoaDeformableBody(DeformableMaterial const& material)
+	: material{ material }
+{
+}
+
+inline int SoaDeformableBody::appendNode(btVector3 const& x, btScalar mass)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		position[axis].push_back(x[axis]);
+		velocity[axis].push_back(0);
+	}
+	this->mass.push_back(std::max(mass, btScalar(0)));
+	inverseMass.push_back(mass > 0 ? 1 / mass : 0);
+	incidenceDirty = true;
+	return getNodeNum() - 1;
+}
+
+inline void SoaDeformableBody::setMass(int node, btScalar mass)
+{
+	this->mass[node] = std::max(mass, btScalar(0));
+	inverseMass[node] = mass > 0 ? 1 / mass : 0;
+}
+
+inline void SoaDeformableBody::appendSpring(int node0, int node1)
+{
+	springNode0.push_back(node0);
+	springNode1.push_back(node1);
+	springRestLength.push_back(getPosition(node0).distance(getPosition(node1)));
+	incidenceDirty = true;
+}
+
+inline void SoaDeformableBody::appendTetra(int node0, int node1, int node2, int node3)
+{
+	auto dm = tetra_edge_matrix(getPosition(node0), getPosition(node1), getPosition(node2), getPosition(node3));
+	if (dm.determinant() < 0)
+	{
+		std::swap(node2, node3);
+		dm = tetra_edge_matrix(getPosition(node0), getPosition(node1), getPosition(node2), getPosition(node3));
+	}
+	tetraNode.push_back({ node0, node1, node2, node3 });
+	tetraDmInverse.push_back(dm.inverse());
+	tetraVolume.push_back(dm.determinant() / 6);
+	incidenceDirty = true;
+}
+
+inline btVector3 SoaDeformableBody::getPosition(int node) const
+{
+	return { position[0][node], position[1][node], position[2][node] };
+}
+
+inline btVector3 SoaDeformableBody::getVelocity(int node) const
+{
+	return { velocity[0][node], velocity[1][node], velocity[2][node] };
+}
+
+inline void SoaDeformableBody::buildIncidence()
+{
+	auto const nodeNum = getNodeNum();
+	incidenceBegin.assign(nodeNum + 1, 0);
+	for (int s = 0; s < getSpringNum(); s++)
+	{
+		incidenceBegin[springNode0[s] + 1]++;
+		incidenceBegin[springNode1[s] + 1]++;
+	}
+	for (auto const& nodes : tetraNode)
+	{
+		for (auto const node : nodes)
+			incidenceBegin[node + 1]++;
+	}
+	for (int i = 0; i < nodeNum; i++)
+		incidenceBegin[i + 1] += incidenceBegin[i];
+
+	// vf̏ɕׂ
+	std::vector<int> cursor(incidenceBegin.begin(), incidenceBegin.end() - 1);
+	incidenceSlot.resize(incidenceBegin.back());
+	for (int s = 0; s < getSpringNum(); s++)
+	{
+		incidenceSlot[cursor[springNode0[s]]++] = 2 * s;
+		incidenceSlot[cursor[springNode1[s]]++] = 2 * s + 1;
+	}
+	auto const tetraBase = 2 * getSpringNum();
+	for (int t = 0; t < getTetraNum(); t++)
+	{
+		for (int k = 0; k < 4; k++)
+			incidenceSlot[cursor[tetraNode[t][k]]++] = tetraBase + 4 * t + k;
+	}
+
+	incidenceDirty = false;
+}
+
+inline DeformableKrylovSolver::DeformableKrylovSolver(DeformableKrylovConfig const& config)
+{
+	setConfig(config);
+}
+
+inline void DeformableKrylovSolver::setConfig(DeformableKrylovConfig const& config) noexcept
+{
+	this->config = config;
+	this->config.grainSize = std::max(this->config.grainSize, 1);
+	this->config.maxIterations = std::max(this->config.maxIterations, 1);
+}
+
+inline void DeformableKrylovSolver::resize(SoaDeformableBody const& body)
+{
+	auto const nodeNum = static_cast<std::size_t>(body.getNodeNum());
+	auto const slotNum = static_cast<std::size_t>(body.getSlotNum());
+	auto const chunkNum = (nodeNum + config.grainSize - 1) / config.grainSize;
+
+	auto grew = false;
+	auto const fit = [&](auto& v, std::size_t size) {
+		if (v.capacity() < size)
+			grew = true;
+		v.resize(size);
+	};
+	for (auto vector : { &rhs, &dv, &r, &z, &p, &ap, &az, &q })
+	{
+		for (auto& axis : *vector)
+			fit(axis, nodeNum);
+	}
+	for (auto& axis : slots)
+		fit(axis, slotNum);
+	fit(springScratch, static_cast<std::size_t>(body.getSpringNum()));
+	fit(tetraStiffness, static_cast<std::size_t>(body.getTetraNum()));
+	fit(partialSums, chunkNum);
+	if (grew)
+		reallocationNum++;
+}
+
+template<typename F>
+inline std::array<btScalar, 2> DeformableKrylovSolver::reduceNodes(int nodeNum, F const& f)
+{
+	auto const grainSize = config.grainSize;
+	auto const chunkNum = (nodeNum + grainSize - 1) / grainSize;
+	run_soa_soft_body_loop(chunkNum, 1, [&](int begin, int end) {
+		for (int chunk = begin; chunk < end; chunk++)
+			partialSums[chunk] = f(chunk * grainSize, std::min(chunk * grainSize + grainSize, nodeNum));
+	});
+
+	std::array<btScalar, 2> sum{};
+	for (int chunk = 0; chunk < chunkNum; chunk++)
+	{
+		sum[0] += partialSums[chunk][0];
+		sum[1] += partialSums[chunk][1];
+	}
+	return sum;
+}
+
+template<typename F>
+inline void DeformableKrylovSolver::runElements(int num, F const& f)
+{
+	if (!scatter)
+		run_soa_soft_body_loop(num, config.grainSize, f);
+	else if (num > 0)
+		f(0, num);
+}
+
+inline void DeformableKrylovSolver::prepareSprings(SoaDeformableBody const& body)
+{
+	BT_PROFILE("DeformableKrylovSolver::prepareSprings");
+
+	run_soa_soft_body_loop(body.getSpringNum(), config.grainSize, [&](int begin, int end) {
+		for (int s = begin; s < end; s++)
+		{
+			auto const d = body.getPosition(body.springNode1[s]) - body.getPosition(body.springNode0[s]);
+			springScratch[s] = make_spring_scratch(d, body.springRestLength[s]);
+		}
+	});
+}
+
+inline void DeformableKrylovSolver::prepareTetras(SoaDeformableBody const& body, btScalar h)
+{
+	BT_PROFILE("DeformableKrylovSolver::prepareTetras");
+
+	run_soa_soft_body_loop(body.getTetraNum(), config.grainSize, [&](int begin, int end) {
+		for (int t = begin; t < end; t++)
+		{
+			auto const& nodes = body.tetraNode[t];
+			auto const ds = tetra_edge_matrix(body.getPosition(nodes[0]), body.getPosition(nodes[1]), body.getPosition(nodes[2]), body.getPosition(nodes[3]));
+			tetraStiffness[t] = make_neo_hookean_stiffness(make_neo_hookean_scratch(ds * body.tetraDmInverse[t]), body.material, body.tetraVolume[t], h);
+		}
+	});
+}
+
+inline void DeformableKrylovSolver::computeRhs(SoaDeformableBody const& body, btScalar h)
+{
+	BT_PROFILE("DeformableKrylovSolver::computeRhs");
+
+	auto const& material = body.material;
+	auto const& x = body.position;
+	auto const& v = body.velocity;
+	auto const vector = [](DeformableVector const& a, int i) { return btVector3{ a[0][i], a[1][i], a[2][i] }; };
+	auto const write = [&](int slot, int node, btVector3 const& value) {
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (scatter)
+				rhs[axis][node] += value[axis];
+			else
+				slots[axis][slot] = value[axis];
+		}
+	};
+
+	// ߓ_֒ڑƂ́Ad͂ɓĂ
+	auto const gravity = body.gravity * h;
+	if (scatter)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = 0; i < body.getNodeNum(); i++)
+				rhs[axis][i] = body.mass[i] * gravity[axis];
+		}
+	}
+
+	// h * f + h^2 * df/dx * v
+	runElements(body.getSpringNum(), [&](int begin, int end) {
+		for (int s = begin; s < end; s++)
+		{
+			auto const a = body.springNode0[s];
+			auto const b = body.springNode1[s];
+			auto const d = vector(x, b) - vector(x, a);
+			auto const w = vector(v, b) - vector(v, a);
+			auto const rest = body.springRestLength[s];
+			auto const value = h * spring_force(d, w, rest, material.springStiffness, material.springDamping) +
+				(h * h) * spring_elastic_differential(springScratch[s], material.springStiffness, w);
+			write(2 * s, a, value);
+			write(2 * s + 1, b, -value);
+		}
+	});
+
+	auto const tetraBase = 2 * body.getSpringNum();
+	auto const muDamp = material.neoHookeanDamping * material.mu;
+	auto const lambdaDamp = material.neoHookeanDamping * material.lambda;
+	runElements(body.getTetraNum(), [&](int begin, int end) {
+		for (int t = begin; t < end; t++)
+		{
+			auto const& nodes = body.tetraNode[t];
+			auto const& dmInverse = body.tetraDmInverse[t];
+			auto const dFv = tetra_edge_matrix(vector(v, nodes[0]), vector(v, nodes[1]), vector(v, nodes[2]), vector(v, nodes[3])) * dmInverse;
+			auto const& s = tetraStiffness[t].scratch;
+			auto const P = (neo_hookean_piola(s, material.mu, material.lambda) + neo_hookean_damping_piola(dFv, muDamp, lambdaDamp)) * h +
+				neo_hookean_piola_differential(s, dFv, material.mu, material.lambda) * (h * h);
+			auto const forces = tetra_nodal_forces(P, dmInverse, body.tetraVolume[t]);
+			auto const slot = tetraBase + 4 * t;
+			write(slot, nodes[0], -(forces.getColumn(0) + forces.getColumn(1) + forces.getColumn(2)));
+			for (int k = 0; k < 3; k++)
+				write(slot + k + 1, nodes[k + 1], forces.getColumn(k));
+		}
+	});
+
+	// d͂𑫂Đߓ_ƂɏW߂AȂߓ_0
+	run_soa_soft_body_loop(body.getNodeNum(), config.grainSize, [&](int begin, int end) {
+		for (int axis = 0; axis < 3; axis++)
+		{
+			auto const slot = slots[axis].data();
+			for (int i = begin; i < end; i++)
+			{
+				auto sum = rhs[axis][i];
+				if (!scatter)
+				{
+					sum = body.mass[i] * gravity[axis];
+					for (int j = body.incidenceBegin[i]; j < body.incidenceBegin[i + 1]; j++)
+						sum += slot[body.incidenceSlot[j]];
+				}
+				rhs[axis][i] = body.inverseMass[i] > 0 ? sum : btScalar(0);
+			}
+		}
+	});
+}
+
+inline btScalar DeformableKrylovSolver::multiply(SoaDeformableBody const& body, DeformableVector const& x, DeformableVector& out, btScalar h)
+{
+	auto const& material = body.material;
+	auto const vector = [](DeformableVector const& a, int i) { return btVector3{ a[0][i], a[1][i], a[2][i] }; };
+	auto const write = [&](int slot, int node, btVector3 const& value) {
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (scatter)
+				out[axis][node] += value[axis];
+			else
+				slots[axis][slot] = value[axis];
+		}
+	};
+
+	// ߓ_֒ڑƂ́Aʂ̍ɓĂ
+	if (scatter)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = 0; i < body.getNodeNum(); i++)
+				out[axis][i] = body.mass[i] * x[axis][i];
+		}
+	}
+
+	// -(h^2 * df/dx + h * df/dv) * x
+	auto const h2 = h * h;
+	runElements(body.getSpringNum(), [&](int begin, int end) {
+		for (int s = begin; s < end; s++)
+		{
+			auto const a = body.springNode0[s];
+			auto const b = body.springNode1[s];
+			auto const delta = vector(x, b) - vector(x, a);
+			auto const value = -(h2 * spring_elastic_differential(springScratch[s], material.springStiffness, delta) +
+				(h * material.springDamping) * delta);
+			write(2 * s, a, value);
+			write(2 * s + 1, b, -value);
+		}
+	});
+
+	auto const tetraBase = 2 * body.getSpringNum();
+	runElements(body.getTetraNum(), [&](int begin, int end) {
+		for (int t = begin; t < end; t++)
+		{
+			auto const& nodes = body.tetraNode[t];
+			auto const& dmInverse = body.tetraDmInverse[t];
+			auto const dF = tetra_edge_matrix(vector(x, nodes[0]), vector(x, nodes[1]), vector(x, nodes[2]), vector(x, nodes[3])) * dmInverse;
+			auto const forces = neo_hookean_stiffness_forces(tetraStiffness[t], dF, dmInverse);
+			auto const slot = tetraBase + 4 * t;
+			write(slot, nodes[0], forces.getColumn(0) + forces.getColumn(1) + forces.getColumn(2));
+			for (int k = 0; k < 3; k++)
+				write(slot + k + 1, nodes[k + 1], -forces.getColumn(k));
+		}
+	});
+
+	// ʂ̍𑫂ďW߁A[vxEout߂
+	return reduceNodes(body.getNodeNum(), [&](int begin, int end) {
+		std::array<btScalar, 2> dot{};
+		for (int axis = 0; axis < 3; axis++)
+		{
+			auto const slot = slots[axis].data();
+			auto const in = x[axis].data();
+			auto const result = out[axis].data();
+			for (int i = begin; i < end; i++)
+			{
+				auto sum = result[i];
+				if (!scatter)
+				{
+					sum = body.mass[i] * in[i];
+					for (int j = body.incidenceBegin[i]; j < body.incidenceBegin[i + 1]; j++)
+						sum += slot[body.incidenceSlot[j]];
+				}
+				result[i] = body.inverseMass[i] > 0 ? sum : btScalar(0);
+				dot[0] += in[i] * result[i];
+			}
+		}
+		return dot;
+	})[0];
+}
+
+inline void DeformableKrylovSolver::solveConjugateGradient(SoaDeformableBody const& body, btScalar h, btScalar rhsNorm2)
+{
+	BT_PROFILE("DeformableKrylovSolver::solveConjugateGradient");
+
+	auto const nodeNum = body.getNodeNum();
+	auto const tolerance2 = config.tolerance * config.tolerance * rhsNorm2;
+
+	// dv0n߂̂ŁAr͉E
+	auto sums = reduceNodes(nodeNum, [&](int begin, int end) {
+		std::array<btScalar, 2> dot{};
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				dv[axis][i] = 0;
+				r[axis][i] = rhs[axis][i];
+				z[axis][i] = r[axis][i] * body.inverseMass[i];
+				p[axis][i] = z[axis][i];
+				dot[0] += r[axis][i] * r[axis][i];
+				dot[1] += r[axis][i] * z[axis][i];
+			}
+		}
+		return dot;
+	});
+	auto residual2 = sums[0];
+	auto rz = sums[1];
+
+	stats.iterations = 0;
+	while (residual2 > tolerance2 && stats.iterations < config.maxIterations)
+	{
+		auto const pAp = multiply(body, p, ap, h);
+		if (!(pAp > 0))
+			break;
+		auto const alpha = rz / pAp;
+
+		sums = reduceNodes(nodeNum, [&](int begin, int end) {
+			std::array<btScalar, 2> dot{};
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int i = begin; i < end; i++)
+				{
+					dv[axis][i] += alpha * p[axis][i];
+					r[axis][i] -= alpha * ap[axis][i];
+					z[axis][i] = r[axis][i] * body.inverseMass[i];
+					dot[0] += r[axis][i] * r[axis][i];
+					dot[1] += r[axis][i] * z[axis][i];
+				}
+			}
+			return dot;
+		});
+		residual2 = sums[0];
+		auto const beta = sums[1] / rz;
+		rz = sums[1];
+
+		run_soa_soft_body_loop(nodeNum, config.grainSize, [&](int begin, int end) {
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int i = begin; i < end; i++)
+					p[axis][i] = z[axis][i] + beta * p[axis][i];
+			}
+		});
+		stats.iterations++;
+	}
+
+	stats.residual = std::sqrt(residual2 / rhsNorm2);
+	stats.converged = residual2 <= tolerance2;
+}
+
+inline void DeformableKrylovSolver::solveConjugateResidual(SoaDeformableBody const& body, btScalar h, btScalar rhsNorm2)
+{
+	BT_PROFILE("DeformableKrylovSolver::solveConjugateResidual");
+
+	auto const nodeNum = body.getNodeNum();
+	auto const tolerance2 = config.tolerance * config.tolerance * rhsNorm2;
+
+	auto residual2 = reduceNodes(nodeNum, [&](int begin, int end) {
+		std::array<btScalar, 2> dot{};
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				dv[axis][i] = 0;
+				r[axis][i] = rhs[axis][i];
+				z[axis][i] = r[axis][i] * body.inverseMass[i];
+				p[axis][i] = z[axis][i];
+				dot[0] += r[axis][i] * r[axis][i];
+			}
+		}
+		return dot;
+	})[0];
+	auto zAz = multiply(body, z, az, h);
+	for (int axis = 0; axis < 3; axis++)
+		std::copy(az[axis].begin(), az[axis].end(), ap[axis].begin());
+
+	stats.iterations = 0;
+	while (residual2 > tolerance2 && stats.iterations < config.maxIterations)
+	{
+		// q = M^-1 * Ap
+		auto const apq = reduceNodes(nodeNum, [&](int begin, int end) {
+			std::array<btScalar, 2> dot{};
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int i = begin; i < end; i++)
+				{
+					q[axis][i] = ap[axis][i] * body.inverseMass[i];
+					dot[0] += ap[axis][i] * q[axis][i];
+				}
+			}
+			return dot;
+		})[0];
+		if (!(apq > 0))
+			break;
+		auto const alpha = zAz / apq;
+
+		residual2 = reduceNodes(nodeNum, [&](int begin, int end) {
+			std::array<btScalar, 2> dot{};
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int i = begin; i < end; i++)
+				{
+					dv[axis][i] += alpha * p[axis][i];
+					r[axis][i] -= alpha * ap[axis][i];
+					z[axis][i] -= alpha * q[axis][i];
+					dot[0] += r[axis][i] * r[axis][i];
+				}
+			}
+			return dot;
+		})[0];
+
+		auto const zAzNext = multiply(body, z, az, h);
+		auto const beta = zAzNext / zAz;
+		zAz = zAzNext;
+
+		run_soa_soft_body_loop(nodeNum, config.grainSize, [&](int begin, int end) {
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int i = begin; i < end; i++)
+				{
+					p[axis][i] = z[axis][i] + beta * p[axis][i];
+					ap[axis][i] = az[axis][i] + beta * ap[axis][i];
+				}
+			}
+		});
+		stats.iterations++;
+	}
+
+	stats.residual = std::sqrt(residual2 / rhsNorm2);
+	stats.converged = residual2 <= tolerance2;
+}
+
+inline void DeformableKrylovSolver::step(SoaDeformableBody& body, btScalar dt)
+{
+	BT_PROFILE("DeformableKrylovSolver::step");
+
+	if (body.incidenceDirty)
+		body.buildIncidence();
+	resize(body);
+	auto const scheduler = btGetTaskScheduler();
+	scatter = !scheduler || scheduler->getNumThreads() <= 1;
+	prepareSprings(body);
+	prepareTetras(body, dt);
+	computeRhs(body, dt);
+
+	auto const nodeNum = body.getNodeNum();
+	auto const rhsNorm2 = reduceNodes(nodeNum, [&](int begin, int end) {
+		std::array<btScalar, 2> dot{};
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int i = begin; i < end; i++)
+				dot[0] += rhs[axis][i] * rhs[axis][i];
+		}
+		return dot;
+	})[0];
+
+	stats = {};
+	if (rhsNorm2 > 0)
+	{
+		if (config.method == DeformableKrylovMethod::ConjugateResidual)
+			solveConjugateResidual(body, dt, rhsNorm2);
+		else
+			solveConjugateGradient(body, dt, rhsNorm2);
+	}
+	else
+	{
+		stats.converged = true;
+		for (auto& axis : dv)
+			std::fill(axis.begin(), axis.end(), btScalar(0));
+	}
+
+	run_soa_soft_body_loop(nodeNum, config.grainSize, [&](int begin, int end) {
+		for (int axis = 0; axis < 3; axis++)
+		{
+			auto const x = body.position[axis].data();
+			auto const v = body.velocity[axis].data();
+			auto const delta = dv[axis].data();
+			for (int i = begin; i < end; i++)
+			{
+				v[i] += delta[i];
+				x[i] += v[i] * dt;
+			}
+		}
+	});
+}
@@ -0,0 +1,261 @@
+#pragma once
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include<algorithm>
+#include<cstdint>
+#include<memory>
+#include<vector>
+
+struct FixedStepperConfig
+{
+	// bP
+	btScalar fixedTimeStep = btScalar(1.) / btScalar(60.);
+
+	// 1t[Ői߂ő̃Xebv
+	// ͎̃t[ȍ~Ɏz
+	int maxSubStepsPerFrame = 2;
+
+	// z鎞Ԃ̏
+	// ͎̂ĂdroppedTimeɐ
+	btScalar maxAccumulatedTime = btScalar(0.25);
+};
+
+struct FixedStepperCounter
+{
+	std::uint64_t frameNum{};
+	std::uint64_t stepNum{};
+
+	// maxSubStepsPerFrameőł؂t[
+	std::uint64_t budgetLimitedFrameNum{};
+	// Aőł؂t[AꂪLёȂ珈ǂĂȂ
+	std::uint64_t consecutiveBudgetLimitedFrameNum{};
+
+	// maxAccumulatedTimeŎԂ̂Ăt[ƁÂĂԂ̍v
+	std::uint64_t droppedFrameNum{};
+	double droppedTime{};
+
+	// t[̏IɎcĂԂ̍ől
+	double maxBacklog{};
+};
+
+// ŒXebvŃ[hi߂
+// `p̎pInterpolatedMotionStateԂĎo
+class FixedStepper
+{
+	FixedStepperConfig config{};
+
+	btScalar accumulatedTime{};
+	btScalar alpha{};
+
+	FixedStepperCounter counter{};
+
+public:
+	FixedStepper(FixedStepperConfig const& config = {});
+	virtual ~FixedStepper() = default;
+	FixedStepper(FixedStepper&) = delete;
+	FixedStepper& operator=(FixedStepper const&) = delete;
+	FixedStepper(FixedStepper&&) = default;
+	FixedStepper& operator=(FixedStepper&&) = default;
+
+	// frameTime͑Õt[̌oߎ(b)
+	// ۂɐi߂XebvԂ
+	int update(btDynamicsWorld* world, btScalar frameTime);
+
+	// Ō̃Xebv玟̃Xebv܂ł̊A[0,1]
+	btScalar getAlpha() const noexcept;
+	// ܂i߂ĂȂ
+	btScalar getBacklog() const noexcept;
+	std::uint64_t getStepNum() const noexcept;
+
+	FixedStepperConfig const& getConfig() const noexcept;
+	void setConfig(FixedStepperConfig const&) noexcept;
+
+	FixedStepperCounter const& getCounter() const noexcept;
+	void resetCounter() noexcept;
+};
+
+// O2Xebv̎pێāA`pɕԂ
+class InterpolatedMotionState : public btMotionState
+{
+	FixedStepper const* stepper = nullptr;
+
+	btTransform previousTransform{};
+	btTransform currentTransform{};
+
+	// ŌsetWorldTransformĂ΂ꂽXebv
+	std::uint64_t updatedStepNum{};
+
+	// QĂԂ̒ʒmApł͂Ȃ̂constݒł
+	mutable std::weak_ptr<std::vector<std::size_t>> wakeList{};
+	mutable std::size_t wakeIndex{};
+
+public:
+	InterpolatedMotionState(FixedStepper const* stepper, btTransform const& startTransform);
+
+	void getWorldTransform(btTransform& worldTransform) const override;
+	void setWorldTransform(btTransform const& worldTransform) override;
+
+	btTransform getRenderTransform() const;
+
+	// ŌsetWorldTransformĂ΂ꂽXebv
+	std::uint64_t getUpdatedStepNum() const noexcept;
+	// Ō̃Xebvœ̂getRenderTransformԂ
+	bool isInterpolating() const noexcept;
+	// getRenderTransformԂɎg
+	btScalar getAlpha() const noexcept;
+
+	// setWorldTransformĂ΂ꂽƂ(QĂ̂NƂ)listindexς
+	// ςނ̂1񂾂AlistɔjĂΉȂ
+	// setWorldTransformsynchronizeMotionStates1XbhŌĂ΂
+	void notifyOnWake(std::weak_ptr<std::vector<std::size_t>> list, std::size_t index) const;
+};
+
+
+//
+// ȉA
+//
+
+
+inline FixedStepper::FixedStepper(FixedStepperConfig const& config)
+	: config{ config }
+{
+}
+
+inline int FixedStepper::update(btDynamicsWorld* world, btScalar frameTime)
+{
+	counter.frameNum++;
+
+	accumulatedTime += std::max(frameTime, btScalar(0.));
+
+	if (accumulatedTime > config.maxAccumulatedTime)
+	{
+		counter.droppedFrameNum++;
+		counter.droppedTime += accumulatedTime - config.maxAccumulatedTime;
+		accumulatedTime = config.maxAccumulatedTime;
+	}
+
+	int stepNum = 0;
+	while (accumulatedTime >= config.fixedTimeStep && stepNum < config.maxSubStepsPerFrame)
+	{
+		// setWorldTransform̒QƂ̂Őɐi߂
+		counter.stepNum++;
+
+		// maxSubSteps0fixedTimeStep傤1i߂
+		world->stepSimulation(config.fixedTimeStep, 0);
+
+		accumulatedTime -= config.fixedTimeStep;
+		stepNum++;
+	}
+
+	if (accumulatedTime >= config.fixedTimeStep)
+	{
+		counter.budgetLimitedFrameNum++;
+		counter.consecutiveBudgetLimitedFrameNum++;
+	}
+	else
+	{
+		counter.consecutiveBudgetLimitedFrameNum = 0;
+	}
+
+	counter.maxBacklog = std::max<double>(counter.maxBacklog, accumulatedTime);
+
+	alpha = std::min(accumulatedTime / config.fixedTimeStep, btScalar(1.));
+
+	return stepNum;
+}
+
+inline btScalar FixedStepper::getAlpha() const noexcept
+{
+	return alpha;
+}
+
+inline btScalar FixedStepper::getBacklog() const noexcept
+{
+	return accumulatedTime;
+}
+
+inline std::uint64_t FixedStepper::getStepNum() const noexcept
+{
+	return counter.stepNum;
+}
+
+inline FixedStepperConfig const& FixedStepper::getConfig() const noexcept
+{
+	return config;
+}
+
+inline void FixedStepper::setConfig(FixedStepperConfig const& c) noexcept
+{
+	config = c;
+}
+
+inline FixedStepperCounter const& FixedStepper::getCounter() const noexcept
+{
+	return counter;
+}
+
+inline void FixedStepper::resetCounter() noexcept
+{
+	// stepNumInterpolatedMotionStateQƂĂ̂Ŏc
+	counter = { .stepNum = counter.stepNum };
+}
+
+
+inline InterpolatedMotionState::InterpolatedMotionState(FixedStepper const* stepper, btTransform const& startTransform)
+	: stepper{ stepper }
+	, previousTransform{ startTransform }
+	, currentTransform{ startTransform }
+{
+}
+
+inline void InterpolatedMotionState::getWorldTransform(btTransform& worldTransform) const
+{
+	worldTransform = currentTransform;
+}
+
+inline void InterpolatedMotionState::setWorldTransform(btTransform const& worldTransform)
+{
+	previousTransform = currentTransform;
+	currentTransform = worldTransform;
+	updatedStepNum = stepper->getStepNum();
+
+	if (auto list = wakeList.lock())
+	{
+		list->push_back(wakeIndex);
+		wakeList.reset();
+	}
+}
+
+inline btTransform InterpolatedMotionState::getRenderTransform() const
+{
+	// Ō̃XebvœĂȂ(QĂ)Ȃ炻̂܂
+	if (!isInterpolating())
+		return currentTransform;
+
+	auto const alpha = stepper->getAlpha();
+
+	return btTransform{
+		previousTransform.getRotation().slerp(currentTransform.getRotation(), alpha),
+		previousTransform.getOrigin().lerp(currentTransform.getOrigin(), alpha)
+	};
+}
+
+inline std::uint64_t InterpolatedMotionState::getUpdatedStepNum() const noexcept
+{
+	return updatedStepNum;
+}
+
+inline bool InterpolatedMotionState::isInterpolating() const noexcept
+{
+	return updatedStepNum == stepper->getStepNum();
+}
+
+inline btScalar InterpolatedMotionState::getAlpha() const noexcept
+{
+	return stepper->getAlpha();
+}
+
+inline void InterpolatedMotionState::notifyOnWake(std::weak_ptr<std::vector<std::size_t>> list, std::size_t index) const
+{
+	wakeList = std::move(list);
+	wakeIndex = index;
+}
@@ -0,0 +1,571 @@
+#pragma once
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btRaycastCallback.h"
+#include<algorithm>
+#include<array>
+#include<cmath>
+#include<vector>
+
+// t̃ubN̈ӂ̃Z
+constexpr int HEIGHTFIELD_PYRAMID_LEAF_SIZE = 8;
+// processAllTrianglesAABBt̃ubNȉȂAubNŏȂ̂̂Ŋ̃Z̑ɂ
+constexpr int HEIGHTFIELD_PYRAMID_CELL_WALK_BLOCK_NUM = 1;
+
+// ̍ŏőubNƂɎl؂btHeightfieldTerrainShape
+// processAllTrianglesperformRaycast́AȂubN܂Ƃ߂Ĕ΂
+// ԂOp`ƔԍbtHeightfieldTerrainShape::processAllTrianglesƓŁAԂႤ
+// performRaycast͉z֐ł͂Ȃ̂ŁAbtCollisionWorld::rayTestrayTestSingle͎l؂gȂ
+// l؂ŃC𓖂Ăɂ́Aray_test_heightfield_pyramidBatchRayQueryg
+// ̃f[^updateHeightsĂԁAbuildAcceleratorō̃`Nꏏɒ
+class PyramidHeightfieldTerrainShape : public btHeightfieldTerrainShape
+{
+	int leafSize = HEIGHTFIELD_PYRAMID_LEAF_SIZE;
+
+	struct Level
+	{
+		int width{};
+		int length{};
+		// m_localOriginAXP[O̒l
+		std::vector<Range> ranges{};
+	};
+	// 0tŁAŌオ1
+	std::vector<Level> levels{};
+
+	// Am_localOriginăXP[Ȍ̍W
+	btScalar getLocalHeight(int x, int y) const;
+	// t̃ubN͈̔͂𒸓_狁߂Ȃ
+	void buildLeaf(int bx, int by);
+	// e͈̔͂q狁߂ȂAxAylevel̃m[h
+	void buildParent(int level, int x, int y);
+	// buildAcceleratorƓ͈͂߂Ȃ
+	void buildChunk(int cx, int cz);
+	// btHeightfieldTerrainShape::processAllTriangles1ZAupRangenullptrȂ獂ŏȂȂ
+	void processCell(btTriangleCallback* callback, int x, int j, Range const* upRange) const;
+
+public:
+	PyramidHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, float const* heightfieldData,
+		btScalar minHeight, btScalar maxHeight, int upAxis, bool flipQuadEdges, int leafSize = HEIGHTFIELD_PYRAMID_LEAF_SIZE);
+	PyramidHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, double const* heightfieldData,
+		btScalar minHeight, btScalar maxHeight, int upAxis, bool flipQuadEdges, int leafSize = HEIGHTFIELD_PYRAMID_LEAF_SIZE);
+	PyramidHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, short const* heightfieldData, btScalar heightScale,
+		btScalar minHeight, btScalar maxHeight, int upAxis, bool flipQuadEdges, int leafSize = HEIGHTFIELD_PYRAMID_LEAF_SIZE);
+	PyramidHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, unsigned char const* heightfieldData, btScalar heightScale,
+		btScalar minHeight, btScalar maxHeight, int upAxis, bool flipQuadEdges, int leafSize = HEIGHTFIELD_PYRAMID_LEAF_SIZE);
+	virtual ~PyramidHeightfieldTerrainShape() = default;
+	PyramidHeightfieldTerrainShape(PyramidHeightfieldTerrainShape const&) = delete;
+	PyramidHeightfieldTerrainShape& operator=(PyramidHeightfieldTerrainShape const&) = delete;
+
+	// ŜȂ
+	void buildPyramid();
+	// iq_x0x1Ay0y1 ([܂) ̍ƂɌĂ
+	// ̓_܂ރubNƂ̐e߂Ȃ
+	void updateHeights(int x0, int y0, int x1, int y1);
+
+	void processAllTriangles(btTriangleCallback* callback, btVector3 const& aabbMin, btVector3 const& aabbMax) const override;
+	// performRaycastBŁAbtHeightfieldTerrainShapẽ|C^ĂԂƊ̂̂ɂȂ
+	// z֐ɂƁAexternal/bullet3/lib̃rhς݂̃CuƉz֐\ȂȂ
+	// raySourceArayTarget̓XP[[JW
+	// ߂ubN炽ǂAcallbackbtTriangleRaycastCallbackȂm_hitFraction艓ubN΂
+	// upAxis1ȊOłgAOp`processAllTrianglesƓƔԍœn
+	void performRaycast(btTriangleCallback* callback, btVector3 const& raySource, btVector3 const& rayTarget) const;
+
+	int getLeafSize() const noexcept { return leafSize; }
+	int getLevelNum() const noexcept { return static_cast<int>(levels.size()); }
+	std::size_t getNodeNum() const noexcept;
+};
+
+// btCollisionWorld::rayTestSingleŒn`ɓĂ̂ƓʂAl؂gĕԂ
+// resultCallbackm_flagskF_DisableHeightfieldAccelerator΁Al؂g킸ɊperformRaycastœĂ
+void ray_test_heightfield_pyramid(btVector3 const& rayFromWorld, btVector3 const& rayToWorld, btCollisionObject const* collisionObject,
+	PyramidHeightfieldTerrainShape const* shape, btTransform const& colObjWorldTransform, btCollisionWorld::RayResultCallback& resultCallback);
+
+//
+// ȉA
+//
+
+inline PyramidHeightfieldTerrainShape::PyramidHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, float const* heightfieldData,
+	btScalar minHeight, btScalar maxHeight, int upAxis, bool flipQuadEdges, int leafSize)
+	: btHeightfieldTerrainShape(heightStickWidth, heightStickLength, heightfieldData, minHeight, maxHeight, upAxis, flipQuadEdges)
+	, leafSize(std::max(leafSize, 1))
+{
+	buildPyramid();
+}
+
+inline PyramidHeightfieldTerrainShape::PyramidHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, double const* heightfieldData,
+	btScalar minHeight, btScalar maxHeight, int upAxis, bool flipQuadEdges, int leafSize)
+	: btHeightfieldTerrainShape(heightStickWidth, heightStickLength, heightfieldData, minHeight, maxHeight, upAxis, flipQuadEdges)
+	, leafSize(std::max(leafSize, 1))
+{
+	buildPyramid();
+}
+
+inline PyramidHeightfieldTerrainShape::PyramidHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, short const* heightfieldData, btScalar heightScale,
+	btScalar minHeight, btScalar maxHeight, int upAxis, bool flipQuadEdges, int leafSize)
+	: btHeightfieldTerrainShape(heightStickWidth, heightStickLength, heightfieldData, heightScale, minHeight, maxHeight, upAxis, flipQuadEdges)
+	, leafSize(std::max(leafSize, 1))
+{
+	buildPyramid();
+}
+
+inline PyramidHeightfieldTerrainShape::PyramidHeightfieldTerrainShape(int heightStickWidth, int heightStickLength, unsigned char const* heightfieldData, btScalar heightScale,
+	btScalar minHeight, btScalar maxHeight, int upAxis, bool flipQuadEdges, int leafSize)
+	: btHeightfieldTerrainShape(heightStickWidth, heightStickLength, heightfieldData, heightScale, minHeight, maxHeight, upAxis, flipQuadEdges)
+	, leafSize(std::max(leafSize, 1))
+{
+	buildPyramid();
+}
+
+inline btScalar PyramidHeightfieldTerrainShape::getLocalHeight(int x, int y) const
+{
+	// getVertexƓvZ
+	return getRawHeightFieldValue(x, y) - m_localOrigin[m_upAxis];
+}
+
+inline void PyramidHeightfieldTerrainShape::buildLeaf(int bx, int by)
+{
+	// ׂ̃ubNƋڂ̒_L
+	auto const x0 = bx * leafSize;
+	auto const y0 = by * leafSize;
+	auto const x1 = std::min(x0 + leafSize, m_heightStickWidth - 1);
+	auto const y1 = std::min(y0 + leafSize, m_heightStickLength - 1);
+
+	Range range{ getLocalHeight(x0, y0), getLocalHeight(x0, y0) };
+	for (int y = y0; y <= y1; y++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			auto const height = getLocalHeight(x, y);
+			range.min = std::min(range.min, height);
+			range.max = std::max(range.max, height);
+		}
+	}
+	auto& leaf = levels[0];
+	leaf.ranges[static_cast<std::size_t>(by) * leaf.width + bx] = range;
+}
+
+inline void PyramidHeightfieldTerrainShape::buildParent(int level, int x, int y)
+{
+	auto const& child = levels[level - 1];
+	auto& parent = levels[level];
+
+	Range range{ BT_LARGE_FLOAT, -BT_LARGE_FLOAT };
+	for (int cy = 2 * y; cy < std::min(2 * y + 2, child.length); cy++)
+	{
+		for (int cx = 2 * x; cx < std::min(2 * x + 2, child.width); cx++)
+		{
+			auto const& childRange = child.ranges[static_cast<std::size_t>(cy) * child.width + cx];
+			range.min = std::min(range.min, childRange.min);
+			range.max = std::max(range.max, childRange.max);
+		}
+	}
+	parent.ranges[static_cast<std::size_t>(y) * parent.width + x] = range;
+}
+
+inline void PyramidHeightfieldTerrainShape::buildChunk(int cx, int cz)
+{
+	auto const x0 = cx * m_vboundsChunkSize;
+	auto const z0 = cz * m_vboundsChunkSize;
+	auto const x1 = std::min(x0 + m_vboundsChunkSize, m_heightStickWidth - 1);
+	auto const z1 = std::min(z0 + m_vboundsChunkSize, m_heightStickLength - 1);
+
+	// ͐̍Ŏ
+	Range range{ getRawHeightFieldValue(x0, z0), getRawHeightFieldValue(x0, z0) };
+	for (int z = z0; z <= z1; z++)
+	{
+		for (int x = x0; x <= x1; x++)
+		{
+			auto const height = getRawHeightFieldValue(x, z);
+			range.min = std::min(range.min, height);
+			range.max = std::max(range.max, height);
+		}
+	}
+	m_vboundsGrid[cx + cz * m_vboundsGridWidth] = range;
+}
+
+inline void PyramidHeightfieldTerrainShape::buildPyramid()
+{
+	BT_PROFILE("PyramidHeightfieldTerrainShape::buildPyramid");
+
+	levels.clear();
+	if (m_heightStickWidth < 2 || m_heightStickLength < 2)
+		return;
+
+	auto width = (m_heightStickWidth - 1 + leafSize - 1) / leafSize;
+	auto length = (m_heightStickLength - 1 + leafSize - 1) / leafSize;
+	while (true)
+	{
+		levels.push_back({ width, length, std::vector<Range>(static_cast<std::size_t>(width) * length) });
+		if (width == 1 && length == 1)
+			break;
+		width = (width + 1) / 2;
+		length = (length + 1) / 2;
+	}
+
+	for (int by = 0; by < levels[0].length; by++)
+	{
+		for (int bx = 0; bx < levels[0].width; bx++)
+			buildLeaf(bx, by);
+	}
+	for (int level = 1; level < static_cast<int>(levels.size()); level++)
+	{
+		for (int y = 0; y < levels[level].length; y++)
+		{
+			for (int x = 0; x < levels[level].width; x++)
+				buildParent(level, x, y);
+		}
+	}
+}
+
+inline void PyramidHeightfieldTerrainShape::updateHeights(int x0, int y0, int x1, int y1)
+{
+	BT_PROFILE("PyramidHeightfieldTerrainShape::updateHeights");
+
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, m_heightStickWidth - 1);
+	y1 = std::min(y1, m_heightStickLength - 1);
+	if (levels.empty() || x0 > x1 || y0 > y1)
+		return;
+
+	// ڂ̒_͍̃ubNƂLĂ
+	auto bx0 = std::max(x0 - 1, 0) / leafSize;
+	auto by0 = std::max(y0 - 1, 0) / leafSize;
+	auto bx1 = std::min(x1 / leafSize, levels[0].width - 1);
+	auto by1 = std::min(y1 / leafSize, levels[0].length - 1);
+	for (int by = by0; by <= by1; by++)
+	{
+		for (int bx = bx0; bx <= bx1; bx++)
+			buildLeaf(bx, by);
+	}
+	for (int level = 1; level < static_cast<int>(levels.size()); level++)
+	{
+		bx0 /= 2;
+		by0 /= 2;
+		bx1 /= 2;
+		by1 /= 2;
+		for (int y = by0; y <= by1; y++)
+		{
+			for (int x = bx0; x <= bx1; x++)
+				buildParent(level, x, y);
+		}
+	}
+
+	if (m_vboundsGrid.size() > 0 && m_vboundsChunkSize > 0)
+	{
+		auto const cx1 = std::min(x1 / m_vboundsChunkSize, m_vboundsGridWidth - 1);
+		auto const cz1 = std::min(y1 / m_vboundsChunkSize, m_vboundsGridLength - 1);
+		for (int cz = std::max(y0 - 1, 0) / m_vboundsChunkSize; cz <= cz1; cz++)
+		{
+			for (int cx = std::max(x0 - 1, 0) / m_vboundsChunkSize; cx <= cx1; cx++)
+				buildChunk(cx, cz);
+		}
+	}
+}
+
+inline std::size_t PyramidHeightfieldTerrainShape::getNodeNum() const noexcept
+{
+	std::size_t num = 0;
+	for (auto const& level : levels)
+		num += level.ranges.size();
+	return num;
+}
+
+inline void PyramidHeightfieldTerrainShape::processCell(btTriangleCallback* callback, int x, int j, Range const* upRange) const
+{
+	btVector3 vertices[3];
+	int indices[3] = { 0, 1, 2 };
+	if (m_flipTriangleWinding)
+	{
+		indices[0] = 2;
+		indices[2] = 0;
+	}
+
+	auto const overlaps = [&](Range const& range) { return !upRange || range.overlaps(*upRange); };
+
+	if (m_flipQuadEdges || (m_useDiamondSubdivision && !((j + x) & 1)) || (m_useZigzagSubdivision && !(j & 1)))
+	{
+		getVertex(x, j, vertices[indices[0]]);
+		getVertex(x, j + 1, vertices[indices[1]]);
+		getVertex(x + 1, j + 1, vertices[indices[2]]);
+
+		Range range{ btMin(btMin(vertices[0][m_upAxis], vertices[1][m_upAxis]), vertices[2][m_upAxis]),
+			btMax(btMax(vertices[0][m_upAxis], vertices[1][m_upAxis]), vertices[2][m_upAxis]) };
+		if (overlaps(range))
+			callback->processTriangle(vertices, 2 * x, j);
+
+		vertices[indices[1]] = vertices[indices[2]];
+		getVertex(x + 1, j, vertices[indices[2]]);
+		range.min = btMin(range.min, vertices[indices[2]][m_upAxis]);
+		range.max = btMax(range.max, vertices[indices[2]][m_upAxis]);
+		if (overlaps(range))
+			callback->processTriangle(vertices, 2 * x + 1, j);
+	}
+	else
+	{
+		getVertex(x, j, vertices[indices[0]]);
+		getVertex(x, j + 1, vertices[indices[1]]);
+		getVertex(x + 1, j, vertices[indices[2]]);
+
+		Range range{ btMin(btMin(vertices[0][m_upAxis], vertices[1][m_upAxis]), vertices[2][m_upAxis]),
+			btMax(btMax(vertices[0][m_upAxis], vertices[1][m_upAxis]), vertices[2][m_upAxis]) };
+		if (overlaps(range))
+			callback->processTriangle(vertices, 2 * x, j);
+
+		vertices[indices[0]] = vertices[indices[2]];
+		getVertex(x + 1, j + 1, vertices[indices[2]]);
+		range.min = btMin(range.min, vertices[indices[2]][m_upAxis]);
+		range.max = btMax(range.max, vertices[indices[2]][m_upAxis]);
+		if (overlaps(range))
+			callback->processTriangle(vertices, 2 * x + 1, j);
+	}
+}
+
+inline void PyramidHeightfieldTerrainShape::processAllTriangles(btTriangleCallback* callback, btVector3 const& aabbMin, btVector3 const& aabbMax) const
+{
+	if (levels.empty())
+		return;
+
+	// Z͈̔͂͊Ɠ悤ɋ߂
+	auto localAabbMin = aabbMin * btVector3(1.f / m_localScaling[0], 1.f / m_localScaling[1], 1.f / m_localScaling[2]);
+	auto localAabbMax = aabbMax * btVector3(1.f / m_localScaling[0], 1.f / m_localScaling[1], 1.f / m_localScaling[2]);
+	localAabbMin += m_localOrigin;
+	localAabbMax += m_localOrigin;
+
+	int quantizedAabbMin[3];
+	int quantizedAabbMax[3];
+	quantizeWithClamp(quantizedAabbMin, localAabbMin, 0);
+	quantizeWithClamp(quantizedAabbMax, localAabbMax, 1);
+	for (int i = 0; i < 3; i++)
+	{
+		quantizedAabbMin[i]--;
+		quantizedAabbMax[i]++;
+	}
+
+	auto const xAxis = m_upAxis == 0 ? 1 : 0;
+	auto const jAxis = m_upAxis == 2 ? 1 : 2;
+	auto const startX = std::max(quantizedAabbMin[xAxis], 0);
+	auto const endX = std::min(quantizedAabbMax[xAxis], m_heightStickWidth - 1);
+	auto const startJ = std::max(quantizedAabbMin[jAxis], 0);
+	auto const endJ = std::min(quantizedAabbMax[jAxis], m_heightStickLength - 1);
+	if (startX >= endX || startJ >= endJ)
+		return;
+
+	// ubNŏȂȂ΁AƓZɌ邾ɂȂ
+	auto const bx0 = startX / leafSize;
+	auto const bx1 = (endX - 1) / leafSize;
+	auto const by0 = startJ / leafSize;
+	auto const by1 = (endJ - 1) / leafSize;
+	if ((bx1 - bx0 + 1) * (by1 - by0 + 1) <= HEIGHTFIELD_PYRAMID_CELL_WALK_BLOCK_NUM)
+	{
+		btHeightfieldTerrainShape::processAllTriangles(callback, aabbMin, aabbMax);
+		return;
+	}
+
+	Range const aabbUpRange{ aabbMin[m_upAxis], aabbMax[m_upAxis] };
+	auto const scale = m_localScaling[m_upAxis];
+
+	struct Node
+	{
+		int level{};
+		int x{};
+		int y{};
+	};
+	std::array<Node, 128> stack{};
+	int stackSize = 0;
+
+	// ł͂ȂAAABBe2ȉ̃m[hɂ܂in߂
+	auto level = 0;
+	while ((bx1 >> level) - (bx0 >> level) > 1 || (by1 >> level) - (by0 >> level) > 1)
+		level++;
+	for (int y = by1 >> level; y >= by0 >> level; y--)
+	{
+		for (int x = bx1 >> level; x >= bx0 >> level; x--)
+			stack[stackSize++] = { level, x, y };
+	}
+
+	while (stackSize > 0)
+	{
+		auto const node = stack[--stackSize];
+
+		// m[hZ
+		auto const cellSize = leafSize << node.level;
+		auto const x0 = std::max(node.x * cellSize, startX);
+		auto const x1 = std::min((node.x + 1) * cellSize, endX);
+		auto const y0 = std::max(node.y * cellSize, startJ);
+		auto const y1 = std::min((node.y + 1) * cellSize, endJ);
+		if (x0 >= x1 || y0 >= y1)
+			continue;
+
+		auto const& range = levels[node.level].ranges[static_cast<std::size_t>(node.y) * levels[node.level].width + node.x];
+		Range const scaledRange{ btMin(range.min * scale, range.max * scale), btMax(range.min * scale, range.max * scale) };
+		if (!scaledRange.overlaps(aabbUpRange))
+			continue;
+
+		if (node.level == 0)
+		{
+			for (int j = y0; j < y1; j++)
+			{
+				for (int x = x0; x < x1; x++)
+					processCell(callback, x, j, &aabbUpRange);
+			}
+			continue;
+		}
+
+		auto const& child = levels[node.level - 1];
+		for (int cy = std::min(2 * node.y + 1, child.length - 1); cy >= 2 * node.y; cy--)
+		{
+			for (int cx = std::min(2 * node.x + 1, child.width - 1); cx >= 2 * node.x; cx--)
+				stack[stackSize++] = { node.level - 1, cx, cy };
+		}
+	}
+}
+
+inline void PyramidHeightfieldTerrainShape::performRaycast(btTriangleCallback* callback, btVector3 const& raySource, btVector3 const& rayTarget) const
+{
+	BT_PROFILE("PyramidHeightfieldTerrainShape::performRaycast");
+
+	if (levels.empty())
+		return;
+
+	// qbg󂯕tȂȂA̐̃ubN͌ȂĂ悢
+	auto const triangleRaycast = dynamic_cast<btTriangleRaycastCallback*>(callback);
+	auto const limit = [&] { return triangleRaycast ? triangleRaycast->m_hitFraction : btScalar(1); };
+
+	// Z̊iq̍W (xAjA) ɂAgetLocalHeightƓ
+	auto const xAxis = m_upAxis == 0 ? 1 : 0;
+	auto const jAxis = m_upAxis == 2 ? 1 : 2;
+	auto const source = raySource / m_localScaling;
+	auto const target = rayTarget / m_localScaling;
+	btVector3 const begin{ source[xAxis] + m_width / 2, source[jAxis] + m_length / 2, source[m_upAxis] };
+	auto const direction = btVector3{ target[xAxis] + m_width / 2, target[jAxis] + m_length / 2, target[m_upAxis] } - begin;
+	btVector3 inverseDirection{};
+	for (int i = 0; i < 3; i++)
+		inverseDirection[i] = direction[i] == 0 ? btScalar(BT_LARGE_FLOAT) : 1 / direction[i];
+
+	// Op`̕ӂ̏ʂ郌C𗎂ƂȂ悤ɁAL
+	constexpr btScalar padding = btScalar(1e-4);
+
+	// ƌԂ̎n܂AȂΕ
+	auto const enter = [&](btScalar x0, btScalar x1, btScalar y0, btScalar y1, btScalar h0, btScalar h1, btScalar tMax) {
+		btVector3 const boxMin{ x0 - padding, y0 - padding, h0 - padding };
+		btVector3 const boxMax{ x1 + padding, y1 + padding, h1 + padding };
+		btScalar tEnter = 0;
+		btScalar tExit = tMax;
+		for (int i = 0; i < 3; i++)
+		{
+			auto t0 = (boxMin[i] - begin[i]) * inverseDirection[i];
+			auto t1 = (boxMax[i] - begin[i]) * inverseDirection[i];
+			if (t0 > t1)
+				std::swap(t0, t1);
+			tEnter = std::max(tEnter, t0);
+			tExit = std::min(tExit, t1);
+		}
+		return tEnter <= tExit ? tEnter : btScalar(-1);
+	};
+
+	struct Node
+	{
+		int level{};
+		int x{};
+		int y{};
+		btScalar enter{};
+	};
+	std::array<Node, 128> stack{};
+	int stackSize = 0;
+
+	auto const push = [&](int level, int x, int y) {
+		auto const cellSize = leafSize << level;
+		auto const x0 = x * cellSize;
+		auto const y0 = y * cellSize;
+		auto const x1 = std::min(x0 + cellSize, m_heightStickWidth - 1);
+		auto const y1 = std::min(y0 + cellSize, m_heightStickLength - 1);
+		auto const& range = levels[level].ranges[static_cast<std::size_t>(y) * levels[level].width + x];
+		auto const t = enter(btScalar(x0), btScalar(x1), btScalar(y0), btScalar(y1), range.min, range.max, limit());
+		if (t >= 0)
+			stack[stackSize++] = { level, x, y, t };
+	};
+
+	push(static_cast<int>(levels.size()) - 1, 0, 0);
+	while (stackSize > 0)
+	{
+		auto const node = stack[--stackSize];
+		if (node.enter > limit())
+			continue;
+
+		if (node.level > 0)
+		{
+			// ߂qƂɐς܂悤ɁAɕׂ
+			auto const first = stackSize;
+			auto const& child = levels[node.level - 1];
+			for (int cy = 2 * node.y; cy < std::min(2 * node.y + 2, child.length); cy++)
+			{
+				for (int cx = 2 * node.x; cx < std::min(2 * node.x + 2, child.width); cx++)
+					push(node.level - 1, cx, cy);
+			}
+			std::sort(stack.begin() + first, stack.begin() + stackSize, [](Node const& a, Node const& b) { return a.enter > b.enter; });
+			continue;
+		}
+
+		// t̓ZƂɁA4_̍̔ƌ邩
+		auto const x0 = node.x * leafSize;
+		auto const y0 = node.y * leafSize;
+		auto const x1 = std::min(x0 + leafSize, m_heightStickWidth - 1);
+		auto const y1 = std::min(y0 + leafSize, m_heightStickLength - 1);
+		for (int j = y0; j < y1; j++)
+		{
+			for (int x = x0; x < x1; x++)
+			{
+				auto const h00 = getLocalHeight(x, j);
+				auto const h10 = getLocalHeight(x + 1, j);
+				auto const h01 = getLocalHeight(x, j + 1);
+				auto const h11 = getLocalHeight(x + 1, j + 1);
+				auto const hMin = std::min(std::min(h00, h10), std::min(h01, h11));
+				auto const hMax = std::max(std::max(h00, h10), std::max(h01, h11));
+				if (enter(btScalar(x), btScalar(x + 1), btScalar(j), btScalar(j + 1), hMin, hMax, limit()) >= 0)
+					processCell(callback, x, j, nullptr);
+			}
+		}
+	}
+}
+
+inline void ray_test_heightfield_pyramid(btVector3 const& rayFromWorld, btVector3 const& rayToWorld, btCollisionObject const* collisionObject,
+	PyramidHeightfieldTerrainShape const* shape, btTransform const& colObjWorldTransform, btCollisionWorld::RayResultCallback& resultCallback)
+{
+	// btCollisionWorld::rayTestSingleInternalBridgeTriangleRaycastCallbackƓ
+	struct BridgeCallback : public btTriangleRaycastCallback
+	{
+		btCollisionWorld::RayResultCallback* resultCallback = nullptr;
+		btCollisionObject const* collisionObject = nullptr;
+		btMatrix3x3 basis{};
+
+		BridgeCallback(btVector3 const& from, btVector3 const& to, btCollisionWorld::RayResultCallback* resultCallback,
+			btCollisionObject const* collisionObject, btMatrix3x3 const& basis)
+			: btTriangleRaycastCallback(from, to, resultCallback->m_flags)
+			, resultCallback(resultCallback)
+			, collisionObject(collisionObject)
+			, basis(basis)
+		{
+		}
+
+		btScalar reportHit(btVector3 const& hitNormalLocal, btScalar hitFraction, int partId, int triangleIndex) override
+		{
+			btCollisionWorld::LocalShapeInfo shapeInfo{};
+			shapeInfo.m_shapePart = partId;
+			shapeInfo.m_triangleIndex = triangleIndex;
+			btCollisionWorld::LocalRayResult rayResult{ collisionObject, &shapeInfo, basis * hitNormalLocal, hitFraction };
+			return resultCallback->addSingleResult(rayResult, true);
+		}
+	};
+
+	auto const worldToObject = colObjWorldTransform.inverse();
+	auto const rayFromLocal = worldToObject * rayFromWorld;
+	auto const rayToLocal = worldToObject * rayToWorld;
+
+	BridgeCallback callback{ rayFromLocal, rayToLocal, &resultCallback, collisionObject, colObjWorldTransform.getBasis() };
+	callback.m_hitFraction = resultCallback.m_closestHitFraction;
+	if (resultCallback.m_flags & btTriangleRaycastCallback::kF_DisableHeightfieldAccelerator)
+		shape->btHeightfieldTerrainShape::performRaycast(&callback, rayFromLocal, rayToLocal);
+	else
+		shape->performRaycast(&callback, rayFromLocal, rayToLocal);
+}
@@ -0,0 +1,1134 @@
+#pragma once
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include"../external/bullet3/src/BulletDynamics/Dynamics/btSimulationIslandManagerMt.h"
+#include<cstdint>
+#include<new>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+enum class IslandNodeType : std::uint8_t
+{
+	Static,
+	Kinematic,
+	Dynamic,
+};
+
+// [h̃IuWFNgƂ̏AYgetWorldArrayIndexƓ
+struct IslandNode
+{
+	btCollisionObject* object = nullptr;
+	// DynamicȂACh̔ԍ
+	int island = -1;
+	// DynamicȂACh̒̈ʒuAKinematicȂkinematics̒̈ʒu
+	int position = -1;
+	// DynamicKinematicȂӂ̃Xg̐擪
+	int firstEdge = -1;
+	// ƂɒH
+	unsigned visit = 0;
+	IslandNodeType type = IslandNodeType::Static;
+	// mergesSimulationIslands̑O̒l
+	bool merges = false;
+};
+
+// dȂĂyASA[DynamicKinematic̃m[h̃XgɂȂ
+struct IslandEdge
+{
+	btCollisionObject* object[2]{};
+	// DynamicKinematicłȂ-1
+	int node[2]{ -1, -1 };
+	int next[2]{ -1, -1 };
+	int prev[2]{ -1, -1 };
+	// nullptrȂyA
+	btTypedConstraint* constraint = nullptr;
+	// isEnabled̑O̒l
+	bool enabled = false;
+};
+
+// Xebv܂ŎĂACh
+struct PersistentIsland
+{
+	std::vector<int> nodes{};
+	// awakeIslands̒̈ʒuAQĂ-1
+	int awakePosition = -1;
+	// Ȃłӂ̂ŁAĂ邩Ȃ
+	bool dirty = false;
+};
+
+// AChXebv܂ŎĂAyASȂA玟ɋNƂɕ
+// QĂAChɂ͐GȂ̂ŁA1Xebv̎Ԃ̓[h̑傫ł͂ȂNĂ{fB̐Ō܂
+// IuWFNgS̒ǉƍ폜AyȂSmKv̂ŁAIncrementalIslandWorldg
+class IncrementalIslandManager : public btSimulationIslandManagerMt
+{
+	// yALbVghostPairCallbackƂĕtāAyȂ󂯎
+	struct PairCallback : public btOverlappingPairCallback
+	{
+		IncrementalIslandManager* manager = nullptr;
+
+		btBroadphasePair* addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) override;
+		void* removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher) override;
+		void removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher) override;
+	};
+
+	PairCallback pairCallback{};
+	btOverlappingPairCallback* nextPairCallback = nullptr;
+
+	std::vector<IslandNode> nodes{};
+	std::vector<IslandEdge> edges{};
+	// 󂢂ӂnext[0]łȂ
+	int freeEdge = -1;
+	std::vector<PersistentIsland> islands{};
+	std::vector<int> freeIslands{};
+	std::vector<int> awakeIslands{};
+	std::vector<int> kinematics{};
+	unsigned visitStamp = 0;
+	// IuWFNg𑫂̂ŁAS̕ӂȂ
+	bool constraintsStale = false;
+
+	// buildAndProcessIslandső\̐ڐG
+	btAlignedObjectArray<btPersistentManifold*> const* predictiveManifolds = nullptr;
+
+	// Ɨp
+	std::vector<int> splitNodes{};
+	std::vector<int> stack{};
+	std::vector<int> pendingEdges{};
+	std::vector<int> islandSlots{};
+	btManifoldArray manifoldArray{};
+
+public:
+	IncrementalIslandManager();
+	virtual ~IncrementalIslandManager() = default;
+	IncrementalIslandManager(IncrementalIslandManager const&) = delete;
+	IncrementalIslandManager& operator=(IncrementalIslandManager const&) = delete;
+
+	// yALbVsetInternalGhostPairCallbackɓn
+	btOverlappingPairCallback* getPairCallback() noexcept;
+	// btGhostPairCallbackȂǂgƂ́AyALbVł͂Ȃɓn
+	void setNextPairCallback(btOverlappingPairCallback* callback) noexcept;
+	btOverlappingPairCallback* getNextPairCallback() const noexcept;
+
+	// [hɑOɌĂԁAY̓[h̔z̖ɂȂ
+	// statickinematic؂ւƂ́A[hOđ
+	void addObject(btCollisionObject* object);
+	// [hOOɌĂ
+	void detachObject(btCollisionObject* object);
+	// [hOɌĂԁAbtCollisionWorldƓindexɈڂ
+	void eraseObject(int index);
+
+	void addConstraint(btTypedConstraint* constraint);
+	void removeConstraint(btTypedConstraint* constraint);
+	// [h̍SnAIuWFNg𑫂ɁAOđ{fB{fBɑS̕ӂȂ
+	void linkConstraints(btAlignedObjectArray<btTypedConstraint*> const& constraints);
+
+	// Xebv̍ŏɋNĂ{fBĂԁAQĂAChN
+	void notifyActive(btCollisionObject* object);
+
+	// btDiscreteDynamicsWorld::calculateSimulationIslands̑
+	// NĂAChAĐQ邩N邩߂
+	void updateIslands(btCollisionWorld* collisionWorld, btAlignedObjectArray<btPersistentManifold*> const& predictive);
+
+	// NĂAChƂɁAӂ}jtH[hƍSW߂ĉ
+	// constraints͎gȂ
+	void buildAndProcessIslands(btDispatcher* dispatcher, btCollisionWorld* collisionWorld,
+		btAlignedObjectArray<btTypedConstraint*>& constraints, SolverParams const& solverParams) override;
+
+	std::size_t getIslandNum() const noexcept;
+	std::size_t getAwakeIslandNum() const noexcept;
+	std::size_t getAwakeBodyNum() const noexcept;
+
+private:
+	int findNode(btCollisionObject const* object) const noexcept;
+	// DynamicKinematicłȂ-1
+	int findLinkedNode(btCollisionObject const* object) const noexcept;
+	int edgeSlot(int edge, int node) const noexcept;
+	// 2̒[AChɓӂ
+	bool mergesEdge(IslandEdge const& edge) const noexcept;
+	// ӂ}jtH[hSƂďW߂m[hADynamic̕
+	int ownerNode(IslandEdge const& edge) const noexcept;
+
+	int allocateIsland(bool awake);
+	void freeIsland(int island);
+	void setAwake(int island, bool awake);
+	void addToIsland(int island, int node);
+	void removeFromIsland(int node);
+
+	int addEdge(btCollisionObject* object0, btCollisionObject* object1, btTypedConstraint* constraint);
+	void removeEdge(int edge);
+	int findEdge(btCollisionObject const* object0, btCollisionObject const* object1, btTypedConstraint const* constraint) const noexcept;
+
+	void addPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1);
+	void removePair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1);
+
+	void markDirty(IslandEdge const& edge);
+	void unite(int node0, int node1);
+	void wakeNode(int node);
+	void splitIsland(int island);
+	void refreshEdges();
+	void wakeByKinematics(btCollisionWorld* collisionWorld);
+	void updateActivation();
+	void collectManifolds(btCollisionWorld* collisionWorld, IslandEdge const& edge, Island& island);
+};
+
+// [h̃IuWFNgƍS̑IncrementalIslandManagerɓ`āAACȟvZC
+// WorldbtDiscreteDynamicsWorldbtDiscreteDynamicsWorldMtƂ̔hNXA͂̂܂ܓn
+template<class World>
+class IncrementalIslandWorld : public World
+{
+	static constexpr bool IS_MT = std::is_base_of_v<btDiscreteDynamicsWorldMt, World>;
+
+public:
+	template<class... Args>
+	IncrementalIslandWorld(Args&&... args);
+	virtual ~IncrementalIslandWorld();
+	IncrementalIslandWorld(IncrementalIslandWorld const&) = delete;
+	IncrementalIslandWorld& operator=(IncrementalIslandWorld const&) = delete;
+
+	IncrementalIslandManager* getIncrementalIslandManager() noexcept;
+
+	void addCollisionObject(btCollisionObject* collisionObject, int collisionFilterGroup = btBroadphaseProxy::StaticFilter,
+		int collisionFilterMask = btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter) override;
+	void removeCollisionObject(btCollisionObject* collisionObject) override;
+	void removeRigidBody(btRigidBody* body) override;
+	void addConstraint(btTypedConstraint* constraint, bool disableCollisionsBetweenLinkedBodies = false) override;
+	void removeConstraint(btTypedConstraint* constraint) override;
+
+	void applyGravity() override;
+	void solveConstraints(btContactSolverInfo& solverInfo) override;
+
+protected:
+	void calculateSimulationIslands() override;
+};
+
+
+//
+// ȉA
+//
+
+
+inline btBroadphasePair* IncrementalIslandManager::PairCallback::addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	manager->addPair(proxy0, proxy1);
+	if (manager->nextPairCallback)
+		return manager->nextPairCallback->addOverlappingPair(proxy0, proxy1);
+	return nullptr;
+}
+
+inline void* IncrementalIslandManager::PairCallback::removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher)
+{
+	manager->removePair(proxy0, proxy1);
+	if (manager->nextPairCallback)
+		return manager->nextPairCallback->removeOverlappingPair(proxy0, proxy1, dispatcher);
+	return nullptr;
+}
+
+inline void IncrementalIslandManager::PairCallback::removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	// yALbV̓yAƂremoveOverlappingPairĂԂ̂ŁAɂ͗Ȃ
+	if (manager->nextPairCallback)
+		manager->nextPairCallback->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+}
+
+inline IncrementalIslandManager::IncrementalIslandManager()
+{
+	pairCallback.manager = this;
+}
+
+inline btOverlappingPairCallback* IncrementalIslandManager::getPairCallback() noexcept
+{
+	return &pairCallback;
+}
+
+inline void IncrementalIslandManager::setNextPairCallback(btOverlappingPairCallback* callback) noexcept
+{
+	nextPairCallback = callback;
+}
+
+inline btOverlappingPairCallback* IncrementalIslandManager::getNextPairCallback() const noexcept
+{
+	return nextPairCallback;
+}
+
+inline void IncrementalIslandManager::addObject(btCollisionObject* object)
+{
+	auto const index = static_cast<int>(nodes.size());
+	auto& node = nodes.emplace_back();
+	node.object = object;
+	node.merges = object->mergesSimulationIslands();
+
+	if (!object->isStaticOrKinematicObject())
+	{
+		node.type = IslandNodeType::Dynamic;
+		addToIsland(allocateIsland(object->isActive()), index);
+	}
+	else
+	{
+		node.type = object->isKinematicObject() ? IslandNodeType::Kinematic : IslandNodeType::Static;
+		object->setIslandTag(-1);
+		if (node.type == IslandNodeType::Kinematic)
+		{
+			node.position = static_cast<int>(kinematics.size());
+			kinematics.push_back(index);
+		}
+	}
+	object->setCompanionId(-1);
+	// [h̔zɓ܂łfindNodeŌȂ̂ŁAS͎̃XebvłȂ
+	if (btRigidBody::upcast(object))
+		constraintsStale = true;
+}
+
+inline void IncrementalIslandManager::detachObject(btCollisionObject* object)
+{
+	auto const index = findNode(object);
+	if (index < 0)
+		return;
+
+	// ォ痈yA̍폜͕ӂȂ̂ŉȂ
+	while (nodes[index].firstEdge >= 0)
+	{
+		auto const edge = nodes[index].firstEdge;
+		markDirty(edges[edge]);
+		removeEdge(edge);
+	}
+
+	auto& node = nodes[index];
+	if (node.type == IslandNodeType::Dynamic)
+	{
+		removeFromIsland(index);
+	}
+	else if (node.type == IslandNodeType::Kinematic)
+	{
+		auto const last = kinematics.back();
+		kinematics[static_cast<std::size_t>(node.position)] = last;
+		nodes[last].position = node.position;
+		kinematics.pop_back();
+	}
+	node.type = IslandNodeType::Static;
+	node.position = -1;
+	object->setIslandTag(-1);
+}
+
+inline void IncrementalIslandManager::eraseObject(int index)
+{
+	if (index < 0 || index >= static_cast<int>(nodes.size()))
+		return;
+
+	auto const last = static_cast<int>(nodes.size()) - 1;
+	if (index != last)
+	{
+		// ̃m[hwĂƂ𒼂
+		nodes[index] = nodes[last];
+		auto const& node = nodes[index];
+		if (node.type == IslandNodeType::Dynamic)
+			islands[static_cast<std::size_t>(node.island)].nodes[static_cast<std::size_t>(node.position)] = index;
+		else if (node.type == IslandNodeType::Kinematic)
+			kinematics[static_cast<std::size_t>(node.position)] = index;
+
+		for (auto e = node.firstEdge; e >= 0;)
+		{
+			auto& edge = edges[e];
+			auto const slot = edgeSlot(e, last);
+			for (auto& n : edge.node)
+				if (n == last)
+					n = index;
+			e = edge.next[slot];
+		}
+	}
+	nodes.pop_back();
+}
+
+inline void IncrementalIslandManager::addConstraint(btTypedConstraint* constraint)
+{
+	auto const object0 = &constraint->getRigidBodyA();
+	auto const object1 = &constraint->getRigidBodyB();
+	auto const node0 = findLinkedNode(object0);
+	auto const node1 = findLinkedNode(object1);
+	if ((node0 < 0 || nodes[node0].type != IslandNodeType::Dynamic) && (node1 < 0 || nodes[node1].type != IslandNodeType::Dynamic))
+		return;
+
+	auto const edge = addEdge(object0, object1, constraint);
+	edges[edge].enabled = constraint->isEnabled();
+	if (mergesEdge(edges[edge]))
+		unite(edges[edge].node[0], edges[edge].node[1]);
+}
+
+inline void IncrementalIslandManager::linkConstraints(btAlignedObjectArray<btTypedConstraint*> const& constraints)
+{
+	if (!constraintsStale)
+		return;
+	constraintsStale = false;
+
+	BT_PROFILE("linkConstraints");
+	for (int i = 0; i < constraints.size(); i++)
+	{
+		auto const constraint = constraints[i];
+		auto const object0 = &constraint->getRigidBodyA();
+		auto const object1 = &constraint->getRigidBodyB();
+		auto const edge = findEdge(object0, object1, constraint);
+		if (edge >= 0)
+		{
+			// ƂɂȂ[΍蒼
+			if (edges[edge].node[0] == findLinkedNode(object0) && edges[edge].node[1] == findLinkedNode(object1))
+				continue;
+			markDirty(edges[edge]);
+			removeEdge(edge);
+		}
+		addConstraint(constraint);
+	}
+}
+
+inline void IncrementalIslandManager::removeConstraint(btTypedConstraint* constraint)
+{
+	auto const edge = findEdge(&constraint->getRigidBodyA(), &constraint->getRigidBodyB(), constraint);
+	if (edge < 0)
+		return;
+	markDirty(edges[edge]);
+	removeEdge(edge);
+}
+
+inline void IncrementalIslandManager::notifyActive(btCollisionObject* object)
+{
+	auto const index = findNode(object);
+	if (index >= 0 && nodes[index].type == IslandNodeType::Dynamic)
+		wakeNode(index);
+}
+
+inline void IncrementalIslandManager::updateIslands(btCollisionWorld* collisionWorld, btAlignedObjectArray<btPersistentManifold*> const& predictive)
+{
+	BT_PROFILE("updateIncrementalIslands");
+
+	refreshEdges();
+	wakeByKinematics(collisionWorld);
+
+	// NĂAChAACh͌ɑ
+	for (std::size_t i = 0; i < awakeIslands.size(); i++)
+		splitIsland(awakeIslands[i]);
+
+	// \̐ڐG͂̃XebvȂ̂ŁAɕ
+	predictiveManifolds = &predictive;
+	for (int i = 0; i < predictive.size(); i++)
+	{
+		auto const object0 = predictive[i]->getBody0();
+		auto const object1 = predictive[i]->getBody1();
+		if (!object0 || !object1 || object0->isStaticOrKinematicObject() || object1->isStaticOrKinematicObject())
+			continue;
+		auto const node0 = findNode(object0);
+		auto const node1 = findNode(object1);
+		if (node0 < 0 || node1 < 0)
+			continue;
+		unite(node0, node1);
+		islands[static_cast<std::size_t>(nodes[node0].island)].dirty = true;
+	}
+
+	updateActivation();
+}
+
+inline void IncrementalIslandManager::buildAndProcessIslands(btDispatcher* dispatcher, btCollisionWorld* collisionWorld,
+	btAlignedObjectArray<btTypedConstraint*>& /* constraints */, SolverParams const& solverParams)
+{
+	BT_PROFILE("buildAndProcessIslands");
+	auto const deterministic = collisionWorld->getDispatchInfo().m_deterministicOverlappingPairs;
+
+	m_activeIslands.resize(0);
+	islandSlots.resize(islands.size());
+	for (auto const id : awakeIslands)
+	{
+		// IslandbtSimulationIslandManagerMtƓg܂킷
+		auto const slot = m_activeIslands.size();
+		if (slot == m_allocatedIslands.size())
+			m_allocatedIslands.push_back(new Island());
+		auto& island = *m_allocatedIslands[slot];
+		island.bodyArray.resize(0);
+		island.manifoldArray.resize(0);
+		island.constraintArray.resize(0);
+		island.id = id;
+		island.isSleeping = false;
+		m_activeIslands.push_back(&island);
+		islandSlots[static_cast<std::size_t>(id)] = slot;
+
+		for (auto const n : islands[static_cast<std::size_t>(id)].nodes)
+		{
+			island.bodyArray.push_back(nodes[n].object);
+			for (auto e = nodes[n].firstEdge; e >= 0;)
+			{
+				auto const& edge = edges[e];
+				auto const next = edge.next[edgeSlot(e, n)];
+				if (ownerNode(edge) == n)
+				{
+					if (!edge.constraint)
+						collectManifolds(collisionWorld, edge, island);
+					else if (edge.enabled)
+						island.constraintArray.push_back(edge.constraint);
+				}
+				e = next;
+			}
+		}
+	}
+
+	// \̐ڐG̓yÃASYĂȂ̂ŁA̔ԍŐU蕪
+	if (predictiveManifolds)
+	{
+		for (int i = 0; i < predictiveManifolds->size(); i++)
+		{
+			auto const manifold = (*predictiveManifolds)[i];
+			if (deterministic && manifold->getNumContacts() == 0)
+				continue;
+			auto const object0 = manifold->getBody0();
+			auto const object1 = manifold->getBody1();
+			if (!dispatcher->needsResponse(object0, object1))
+				continue;
+			auto const id = object0->getIslandTag() >= 0 ? object0->getIslandTag() : object1->getIslandTag();
+			if (id < 0 || id >= static_cast<int>(islandSlots.size()))
+				continue;
+			auto const slot = islandSlots[static_cast<std::size_t>(id)];
+			if (slot < m_activeIslands.size() && m_activeIslands[slot]->id == id)
+				m_activeIslands[slot]->manifoldArray.push_back(manifold);
+		}
+		predictiveManifolds = nullptr;
+	}
+
+	if (m_activeIslands.size() == 0)
+		return;
+
+	if (!getSplitIslands())
+	{
+		// NĂ̂S1ɂ܂Ƃ߂ĉ
+		for (int i = 1; i < m_activeIslands.size(); i++)
+			m_activeIslands[0]->append(*m_activeIslands[i]);
+		m_activeIslands.resize(1);
+		serialIslandDispatch(&m_activeIslands, solverParams);
+		return;
+	}
+
+	if (m_minimumSolverBatchSize > 1)
+		mergeIslands();
+	m_islandDispatch(&m_activeIslands, solverParams);
+}
+
+inline std::size_t IncrementalIslandManager::getIslandNum() const noexcept
+{
+	return islands.size() - freeIslands.size();
+}
+
+inline std::size_t IncrementalIslandManager::getAwakeIslandNum() const noexcept
+{
+	return awakeIslands.size();
+}
+
+inline std::size_t IncrementalIslandManager::getAwakeBodyNum() const noexcept
+{
+	std::size_t num = 0;
+	for (auto const id : awakeIslands)
+		num += islands[static_cast<std::size_t>(id)].nodes.size();
+	return num;
+}
+
+inline int IncrementalIslandManager::findNode(btCollisionObject const* object) const noexcept
+{
+	if (!object)
+		return -1;
+	auto const index = object->getWorldArrayIndex();
+	if (index < 0 || index >= static_cast<int>(nodes.size()) || nodes[index].object != object)
+		return -1;
+	return index;
+}
+
+inline int IncrementalIslandManager::findLinkedNode(btCollisionObject const* object) const noexcept
+{
+	auto const index = findNode(object);
+	return index >= 0 && nodes[index].type != IslandNodeType::Static ? index : -1;
+}
+
+inline int IncrementalIslandManager::edgeSlot(int edge, int node) const noexcept
+{
+	return edges[edge].node[0] == node ? 0 : 1;
+}
+
+inline bool IncrementalIslandManager::mergesEdge(IslandEdge const& edge) const noexcept
+{
+	if (edge.node[0] < 0 || edge.node[1] < 0)
+		return false;
+	auto const& node0 = nodes[edge.node[0]];
+	auto const& node1 = nodes[edge.node[1]];
+	if (node0.type != IslandNodeType::Dynamic || node1.type != IslandNodeType::Dynamic)
+		return false;
+	// btDiscreteDynamicsWorldƓAScontact responseɂ炸Ȃ
+	if (edge.constraint)
+		return edge.enabled;
+	return node0.merges && node1.merges;
+}
+
+inline int IncrementalIslandManager::ownerNode(IslandEdge const& edge) const noexcept
+{
+	// getIslandIdbtGetConstraintIslandIdƓA̕DynamicȂ炻
+	if (edge.node[0] >= 0 && nodes[edge.node[0]].type == IslandNodeType::Dynamic)
+		return edge.node[0];
+	return edge.node[1];
+}
+
+inline int IncrementalIslandManager::allocateIsland(bool awake)
+{
+	int island{};
+	if (!freeIslands.empty())
+	{
+		island = freeIslands.back();
+		freeIslands.pop_back();
+	}
+	else
+	{
+		island = static_cast<int>(islands.size());
+		islands.emplace_back();
+	}
+	islands[static_cast<std::size_t>(island)].dirty = false;
+	setAwake(island, awake);
+	return island;
+}
+
+inline void IncrementalIslandManager::freeIsland(int island)
+{
+	setAwake(island, false);
+	islands[static_cast<std::size_t>(island)].nodes.clear();
+	islands[static_cast<std::size_t>(island)].dirty = false;
+	freeIslands.push_back(island);
+}
+
+inline void IncrementalIslandManager::setAwake(int island, bool awake)
+{
+	auto& target = islands[static_cast<std::size_t>(island)];
+	if (awake == (target.awakePosition >= 0))
+		return;
+
+	if (awake)
+	{
+		target.awakePosition = static_cast<int>(awakeIslands.size());
+		awakeIslands.push_back(island);
+	}
+	else
+	{
+		auto const last = awakeIslands.back();
+		awakeIslands[static_cast<std::size_t>(target.awakePosition)] = last;
+		islands[static_cast<std::size_t>(last)].awakePosition = target.awakePosition;
+		awakeIslands.pop_back();
+		target.awakePosition = -1;
+	}
+}
+
+inline void IncrementalIslandManager::addToIsland(int island, int node)
+{
+	auto& target = islands[static_cast<std::size_t>(island)];
+	nodes[node].island = island;
+	nodes[node].position = static_cast<int>(target.nodes.size());
+	target.nodes.push_back(node);
+	nodes[node].object->setIslandTag(island);
+}
+
+inline void IncrementalIslandManager::removeFromIsland(int node)
+{
+	auto const island = nodes[node].island;
+	auto& target = islands[static_cast<std::size_t>(island)];
+	auto const last = target.nodes.back();
+	target.nodes[static_cast<std::size_t>(nodes[node].position)] = last;
+	nodes[last].position = nodes[node].position;
+	target.nodes.pop_back();
+	nodes[node].island = -1;
+
+	if (target.nodes.empty())
+		freeIsland(island);
+}
+
+inline int IncrementalIslandManager::addEdge(btCollisionObject* object0, btCollisionObject* object1, btTypedConstraint* constraint)
+{
+	int index{};
+	if (freeEdge >= 0)
+	{
+		index = freeEdge;
+		freeEdge = edges[index].next[0];
+	}
+	else
+	{
+		index = static_cast<int>(edges.size());
+		edges.emplace_back();
+	}
+
+	auto& edge = edges[index];
+	edge = IslandEdge{};
+	edge.object[0] = object0;
+	edge.object[1] = object1;
+	edge.constraint = constraint;
+	edge.node[0] = findLinkedNode(object0);
+	edge.node[1] = findLinkedNode(object1);
+
+	for (int slot = 0; slot < 2; slot++)
+	{
+		auto const node = edge.node[slot];
+		// {fBǂ̍S1񂾂Ȃ
+		if (node < 0 || (slot == 1 && node == edge.node[0]))
+			continue;
+		auto const head = nodes[node].firstEdge;
+		edge.next[slot] = head;
+		if (head >= 0)
+			edges[head].prev[edgeSlot(head, node)] = index;
+		nodes[node].firstEdge = index;
+	}
+	return index;
+}
+
+inline void IncrementalIslandManager::removeEdge(int index)
+{
+	auto& edge = edges[index];
+	for (int slot = 0; slot < 2; slot++)
+	{
+		auto const node = edge.node[slot];
+		if (node < 0 || (slot == 1 && node == edge.node[0]))
+			continue;
+		auto const prev = edge.prev[slot];
+		auto const next = edge.next[slot];
+		if (prev >= 0)
+			edges[prev].next[edgeSlot(prev, node)] = next;
+		else
+			nodes[node].firstEdge = next;
+		if (next >= 0)
+			edges[next].prev[edgeSlot(next, node)] = prev;
+	}
+
+	edge = IslandEdge{};
+	edge.next[0] = freeEdge;
+	freeEdge = index;
+}
+
+inline int IncrementalIslandManager::findEdge(btCollisionObject const* object0, btCollisionObject const* object1, btTypedConstraint const* constraint) const noexcept
+{
+	// Dynamic̕ӂȂ
+	auto node = findLinkedNode(object0);
+	auto const node1 = findLinkedNode(object1);
+	if (node < 0 || (node1 >= 0 && nodes[node1].type == IslandNodeType::Dynamic))
+		node = node1;
+	if (node < 0)
+		return -1;
+
+	for (auto e = nodes[node].firstEdge; e >= 0; e = edges[e].next[edgeSlot(e, node)])
+	{
+		auto const& edge = edges[e];
+		if (edge.constraint != constraint)
+			continue;
+		if (constraint || (edge.object[0] == object0 && edge.object[1] == object1) || (edge.object[0] == object1 && edge.object[1] == object0))
+			return e;
+	}
+	return -1;
+}
+
+inline void IncrementalIslandManager::addPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	auto const object0 = static_cast<btCollisionObject*>(proxy0->m_clientObject);
+	auto const object1 = static_cast<btCollisionObject*>(proxy1->m_clientObject);
+	auto const node0 = findNode(object0);
+	auto const node1 = findNode(object1);
+	// }jtH[hW߂̂staticƂ̕ӂADynamiĉȂyA͗vȂ
+	if ((node0 < 0 || nodes[node0].type != IslandNodeType::Dynamic) && (node1 < 0 || nodes[node1].type != IslandNodeType::Dynamic))
+		return;
+
+	auto const edge = addEdge(object0, object1, nullptr);
+	if (mergesEdge(edges[edge]))
+		unite(node0, node1);
+}
+
+inline void IncrementalIslandManager::removePair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	auto const edge = findEdge(static_cast<btCollisionObject*>(proxy0->m_clientObject), static_cast<btCollisionObject*>(proxy1->m_clientObject), nullptr);
+	if (edge < 0)
+		return;
+	markDirty(edges[edge]);
+	removeEdge(edge);
+}
+
+inline void IncrementalIslandManager::markDirty(IslandEdge const& edge)
+{
+	if (mergesEdge(edge))
+		islands[static_cast<std::size_t>(nodes[edge.node[0]].island)].dirty = true;
+}
+
+inline void IncrementalIslandManager::unite(int node0, int node1)
+{
+	// QĂĕĂ邩ȂACh́AɕĂȂ镪N
+	for (auto const node : { node0, node1 })
+	{
+		auto const island = nodes[node].island;
+		if (islands[static_cast<std::size_t>(island)].dirty && islands[static_cast<std::size_t>(island)].awakePosition < 0)
+			splitIsland(island);
+	}
+
+	auto island0 = nodes[node0].island;
+	auto island1 = nodes[node1].island;
+	if (island0 == island1)
+		return;
+
+	// 傫Ɉڂ
+	if (islands[static_cast<std::size_t>(island0)].nodes.size() < islands[static_cast<std::size_t>(island1)].nodes.size())
+		std::swap(island0, island1);
+
+	auto const awake = islands[static_cast<std::size_t>(island0)].awakePosition >= 0 || islands[static_cast<std::size_t>(island1)].awakePosition >= 0;
+	auto const dirty = islands[static_cast<std::size_t>(island0)].dirty || islands[static_cast<std::size_t>(island1)].dirty;
+
+	splitNodes.swap(islands[static_cast<std::size_t>(island1)].nodes);
+	for (auto const node : splitNodes)
+		addToIsland(island0, node);
+	splitNodes.swap(islands[static_cast<std::size_t>(island1)].nodes);
+	freeIsland(island1);
+
+	islands[static_cast<std::size_t>(island0)].dirty = dirty;
+	setAwake(island0, awake);
+}
+
+inline void IncrementalIslandManager::wakeNode(int node)
+{
+	auto island = nodes[node].island;
+	if (islands[static_cast<std::size_t>(island)].awakePosition >= 0)
+		return;
+	if (islands[static_cast<std::size_t>(island)].dirty)
+	{
+		splitIsland(island);
+		island = nodes[node].island;
+	}
+	setAwake(island, true);
+}
+
+inline void IncrementalIslandManager::splitIsland(int island)
+{
+	auto& target = islands[static_cast<std::size_t>(island)];
+	if (!target.dirty)
+		return;
+	target.dirty = false;
+	if (target.nodes.size() <= 1)
+		return;
+
+	auto const awake = target.awakePosition >= 0;
+	splitNodes.clear();
+	splitNodes.swap(target.nodes);
+	visitStamp++;
+
+	// ŏɂȂ̂͌̃AChɎcAc͐VAChɂ
+	auto current = island;
+	for (auto const root : splitNodes)
+	{
+		if (nodes[root].visit == visitStamp)
+			continue;
+		if (current < 0)
+			current = allocateIsland(awake);
+
+		nodes[root].visit = visitStamp;
+		stack.clear();
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			auto const node = stack.back();
+			stack.pop_back();
+			addToIsland(current, node);
+
+			for (auto e = nodes[node].firstEdge; e >= 0; e = edges[e].next[edgeSlot(e, node)])
+			{
+				auto const& edge = edges[e];
+				if (!mergesEdge(edge))
+					continue;
+				auto const other = edge.node[0] == node ? edge.node[1] : edge.node[0];
+				if (nodes[other].visit == visitStamp)
+					continue;
+				nodes[other].visit = visitStamp;
+				stack.push_back(other);
+			}
+		}
+		current = -1;
+	}
+}
+
+inline void IncrementalIslandManager::refreshEdges()
+{
+	// contact responseS̗LςӂANĂACh̒
+	pendingEdges.clear();
+	for (auto const id : awakeIslands)
+	{
+		for (auto const n : islands[static_cast<std::size_t>(id)].nodes)
+		{
+			auto& node = nodes[n];
+			auto const merges = node.object->mergesSimulationIslands();
+			auto const mergesChanged = merges != node.merges;
+			if (mergesChanged)
+			{
+				node.merges = merges;
+				if (!merges)
+					islands[static_cast<std::size_t>(id)].dirty = true;
+			}
+
+			for (auto e = node.firstEdge; e >= 0; e = edges[e].next[edgeSlot(e, n)])
+			{
+				auto& edge = edges[e];
+				if (!edge.constraint)
+				{
+					if (mergesChanged && merges)
+						pendingEdges.push_back(e);
+					continue;
+				}
+
+				auto const enabled = edge.constraint->isEnabled();
+				if (enabled == edge.enabled)
+					continue;
+				if (enabled)
+				{
+					edge.enabled = true;
+					pendingEdges.push_back(e);
+				}
+				else
+				{
+					markDirty(edge);
+					edge.enabled = false;
+				}
+			}
+		}
+	}
+
+	// ȂawakeIslandsς̂Ōł܂Ƃ߂
+	for (auto const e : pendingEdges)
+		if (mergesEdge(edges[e]))
+			unite(edges[e].node[0], edges[e].node[1]);
+}
+
+inline void IncrementalIslandManager::wakeByKinematics(btCollisionWorld* collisionWorld)
+{
+	// btSimulationIslandManagerƓAĂkinematicƃ}jtH[ĥ{fBN
+	auto const pairCache = collisionWorld->getPairCache();
+	auto const deterministic = collisionWorld->getDispatchInfo().m_deterministicOverlappingPairs;
+	for (auto const k : kinematics)
+	{
+		auto const object = nodes[k].object;
+		if (object->getActivationState() == ISLAND_SLEEPING || !object->hasContactResponse())
+			continue;
+
+		for (auto e = nodes[k].firstEdge; e >= 0; e = edges[e].next[edgeSlot(e, k)])
+		{
+			auto const& edge = edges[e];
+			auto const other = edge.node[0] == k ? edge.node[1] : edge.node[0];
+			if (edge.constraint || other < 0 || nodes[other].type != IslandNodeType::Dynamic)
+				continue;
+
+			auto const pair = pairCache->findPair(edge.object[0]->getBroadphaseHandle(), edge.object[1]->getBroadphaseHandle());
+			if (!pair || !pair->m_algorithm)
+				continue;
+			manifoldArray.resize(0);
+			pair->m_algorithm->getAllContactManifolds(manifoldArray);
+			auto touching = false;
+			for (int i = 0; i < manifoldArray.size(); i++)
+				touching = touching || !deterministic || manifoldArray[i]->getNumContacts() > 0;
+			if (!touching)
+				continue;
+
+			nodes[other].object->activate();
+			wakeNode(other);
+		}
+	}
+}
+
+inline void IncrementalIslandManager::updateActivation()
+{
+	// btSimulationIslandManager::buildIslandsƓAQƊÔŌ납
+	for (auto i = awakeIslands.size(); i-- > 0;)
+	{
+		auto const id = awakeIslands[i];
+		auto const& island = islands[static_cast<std::size_t>(id)];
+
+		auto allSleeping = true;
+		for (auto const n : island.nodes)
+		{
+			auto const state = nodes[n].object->getActivationState();
+			if (state == ACTIVE_TAG || state == DISABLE_DEACTIVATION)
+			{
+				allSleeping = false;
+				break;
+			}
+		}
+
+		if (allSleeping)
+		{
+			for (auto const n : island.nodes)
+				nodes[n].object->setActivationState(ISLAND_SLEEPING);
+			setAwake(id, false);
+			continue;
+		}
+
+		for (auto const n : island.nodes)
+		{
+			auto const object = nodes[n].object;
+			object->setCompanionId(-1);
+			object->setHitFraction(btScalar(1.));
+			if (object->getActivationState() == ISLAND_SLEEPING)
+			{
+				object->setActivationState(WANTS_DEACTIVATION);
+				object->setDeactivationTime(btScalar(0.));
+			}
+		}
+	}
+}
+
+inline void IncrementalIslandManager::collectManifolds(btCollisionWorld* collisionWorld, IslandEdge const& edge, Island& island)
+{
+	auto const dispatcher = collisionWorld->getDispatcher();
+	if (!dispatcher->needsResponse(edge.object[0], edge.object[1]))
+		return;
+
+	auto const pair = collisionWorld->getPairCache()->findPair(edge.object[0]->getBroadphaseHandle(), edge.object[1]->getBroadphaseHandle());
+	if (!pair || !pair->m_algorithm)
+		return;
+
+	auto const deterministic = collisionWorld->getDispatchInfo().m_deterministicOverlappingPairs;
+	manifoldArray.resize(0);
+	pair->m_algorithm->getAllContactManifolds(manifoldArray);
+	for (int i = 0; i < manifoldArray.size(); i++)
+	{
+		if (deterministic && manifoldArray[i]->getNumContacts() == 0)
+			continue;
+		island.manifoldArray.push_back(manifoldArray[i]);
+	}
+}
+
+template<class World>
+template<class... Args>
+inline IncrementalIslandWorld<World>::IncrementalIslandWorld(Args&&... args)
+	: World(std::forward<Args>(args)...)
+{
+	// btDiscreteDynamicsWorldMtƓAꂽACh}l[Wւ
+	auto const previous = this->m_islandManager;
+	auto const manager = new (btAlignedAlloc(sizeof(IncrementalIslandManager), 16)) IncrementalIslandManager();
+	manager->setSplitIslands(previous->getSplitIslands());
+	if constexpr (IS_MT)
+	{
+		auto const previousMt = static_cast<btSimulationIslandManagerMt*>(previous);
+		manager->setMinimumSolverBatchSize(previousMt->getMinimumSolverBatchSize());
+		manager->setIslandDispatchFunction(previousMt->getIslandDispatchFunction());
+	}
+	else
+	{
+		// v[ł͂Ȃ[h̃\oŏɉ
+		manager->setIslandDispatchFunction(btSimulationIslandManagerMt::serialIslandDispatch);
+	}
+
+	if (this->m_ownsIslandManager)
+	{
+		previous->~btSimulationIslandManager();
+		btAlignedFree(previous);
+	}
+	this->m_islandManager = manager;
+	this->m_ownsIslandManager = true;
+
+	this->getPairCache()->setInternalGhostPairCallback(manager->getPairCallback());
+}
+
+template<class World>
+inline IncrementalIslandWorld<World>::~IncrementalIslandWorld()
+{
+	// }l[WbtCollisionWorld̃fXgN^yÂŁAR[obN߂Ă
+	this->getPairCache()->setInternalGhostPairCallback(getIncrementalIslandManager()->getNextPairCallback());
+}
+
+template<class World>
+inline IncrementalIslandManager* IncrementalIslandWorld<World>::getIncrementalIslandManager() noexcept
+{
+	return static_cast<IncrementalIslandManager*>(this->m_islandManager);
+}
+
+template<class World>
+inline void IncrementalIslandWorld<World>::addCollisionObject(btCollisionObject* collisionObject, int collisionFilterGroup, int collisionFilterMask)
+{
+	// vLVƂɃyÂŐɑ
+	getIncrementalIslandManager()->addObject(collisionObject);
+	World::addCollisionObject(collisionObject, collisionFilterGroup, collisionFilterMask);
+}
+
+template<class World>
+inline void IncrementalIslandWorld<World>::removeCollisionObject(btCollisionObject* collisionObject)
+{
+	// btDiscreteDynamicsWorldremoveRigidBodyɉ
+	if (auto const body = btRigidBody::upcast(collisionObject))
+	{
+		removeRigidBody(body);
+		return;
+	}
+
+	auto const index = collisionObject->getWorldArrayIndex();
+	getIncrementalIslandManager()->detachObject(collisionObject);
+	World::removeCollisionObject(collisionObject);
+	getIncrementalIslandManager()->eraseObject(index);
+}
+
+template<class World>
+inline void IncrementalIslandWorld<World>::removeRigidBody(btRigidBody* body)
+{
+	auto const index = body->getWorldArrayIndex();
+	getIncrementalIslandManager()->detachObject(body);
+	World::removeRigidBody(body);
+	getIncrementalIslandManager()->eraseObject(index);
+}
+
+template<class World>
+inline void IncrementalIslandWorld<World>::addConstraint(btTypedConstraint* constraint, bool disableCollisionsBetweenLinkedBodies)
+{
+	World::addConstraint(constraint, disableCollisionsBetweenLinkedBodies);
+	getIncrementalIslandManager()->addConstraint(constraint);
+}
+
+template<class World>
+inline void IncrementalIslandWorld<World>::removeConstraint(btTypedConstraint* constraint)
+{
+	getIncrementalIslandManager()->removeConstraint(constraint);
+	World::removeConstraint(constraint);
+}
+
+template<class World>
+inline void IncrementalIslandWorld<World>::applyGravity()
+{
+	// S̃{fB̂͂Ȃ̂ŁANꂽ{fBŏE
+	auto const manager = getIncrementalIslandManager();
+	for (int i = 0; i < this->m_nonStaticRigidBodies.size(); i++)
+	{
+		auto const body = this->m_nonStaticRigidBodies[i];
+		if (body->isActive())
+		{
+			body->applyGravity();
+			manager->notifyActive(body);
+		}
+	}
+}
+
+template<class World>
+inline void IncrementalIslandWorld<World>::solveConstraints(btContactSolverInfo& solverInfo)
+{
+	// btDiscreteDynamicsWorldMtbuildAndProcessIslandsĂԂ̂ł̂܂
+	if constexpr (IS_MT)
+	{
+		World::solveConstraints(solverInfo);
+	}
+	else
+	{
+		BT_PROFILE("solveConstraints");
+		auto const manager = getIncrementalIslandManager();
+		auto const dispatcher = this->getDispatcher();
+		manager->setMinimumSolverBatchSize(solverInfo.m_minimumSolverBatchSize);
+
+		this->m_constraintSolver->prepareSolve(this->getNumCollisionObjects(), dispatcher->getNumManifolds());
+
+		btSimulationIslandManagerMt::SolverParams solverParams{};
+		solverParams.m_solverPool = this->m_constraintSolver;
+		solverParams.m_solverMt = nullptr;
+		solverParams.m_solverInfo = &solverInfo;
+		solverParams.m_debugDrawer = this->m_debugDrawer;
+		solverParams.m_dispatcher = dispatcher;
+		manager->buildAndProcessIslands(dispatcher, this, this->m_constraints, solverParams);
+
+		this->m_constraintSolver->allSolved(solverInfo, this->m_debugDrawer);
+	}
+}
+
+template<class World>
+inline void IncrementalIslandWorld<World>::calculateSimulationIslands()
+{
+	BT_PROFILE("calculateSimulationIslands");
+	getIncrementalIslandManager()->linkConstraints(this->m_constraints);
+	getIncrementalIslandManager()->updateIslands(this, this->m_predictiveManifolds);
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include<algorithm>
+#include<array>
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+#include<memory>
+#include<new>
+#include<span>
+#include<vector>
+
+// VF[_StructuredBuffer<ShapeData>ƓCAEg
+// transformXMMATRIXƓsxNgp̍s
+struct alignas(16) InstanceData
+{
+	std::array<float, 16> transform{};
+	std::array<float, 3> color{};
+	float padding{};
+};
+static_assert(sizeof(InstanceData) == 80);
+
+// CX^Xރobt@pӂ
+// GPUĂ悤ɁAOobt@̊ǗƋlߍ݂番Ă
+class InstanceStreamBackend
+{
+public:
+	virtual ~InstanceStreamBackend() = default;
+
+	// frameIndexԖڂ̃obt@capacity̃CX^X傫ɍ蒼
+	// ݐ̐擪ԂAɍ蒼܂ŏ߂悤ɂĂ
+	// ȑÕobt@͎̂ĂĂ悢
+	virtual InstanceData* resize(std::size_t frameIndex, std::size_t capacity) = 0;
+};
+
+// CPŨɏ̃obNGh
+// x`}[NȂGPU̖Ŏg
+class NullInstanceStreamBackend : public InstanceStreamBackend
+{
+	struct AlignedDelete
+	{
+		void operator()(InstanceData* ptr) const noexcept;
+	};
+
+	std::vector<std::unique_ptr<InstanceData, AlignedDelete>> buffers{};
+	std::vector<std::size_t> capacities{};
+
+public:
+	NullInstanceStreamBackend() = default;
+	virtual ~NullInstanceStreamBackend() = default;
+	NullInstanceStreamBackend(NullInstanceStreamBackend const&) = delete;
+	NullInstanceStreamBackend& operator=(NullInstanceStreamBackend const&) = delete;
+	NullInstanceStreamBackend(NullInstanceStreamBackend&&) = default;
+	NullInstanceStreamBackend& operator=(NullInstanceStreamBackend&&) = default;
+
+	InstanceData* resize(std::size_t frameIndex, std::size_t capacity) override;
+
+	InstanceData const* getData(std::size_t frameIndex) const noexcept;
+	std::size_t getCapacity(std::size_t frameIndex) const noexcept;
+};
+
+struct InstanceStreamCounter
+{
+	std::uint64_t frameNum{};
+	std::uint64_t instanceNum{};
+	// obt@蒼
+	std::uint64_t resizeNum{};
+};
+
+// t[̃CX^XframeNum̃obt@ɏԂɏ
+// GPUǂłr̃obt@ɂ͏Ȃ̂ŁA
+// ĂяoframeNumt[O̕`悪Î҂Ăwrite
+// ȂȂobt@͔{̑傫ō蒼̂ŏ͖
+class InstanceStream
+{
+	struct Frame
+	{
+		InstanceData* data = nullptr;
+		std::size_t capacity{};
+	};
+
+	std::unique_ptr<InstanceStreamBackend> backend{};
+
+	std::vector<Frame> frames{};
+	std::size_t frameIndex{};
+	std::size_t instanceNum{};
+
+	InstanceStreamCounter counter{};
+
+public:
+	InstanceStream() = default;
+	// ׂẴobt@initialCapacityōĂ
+	InstanceStream(std::unique_ptr<InstanceStreamBackend>&& backend, std::size_t frameNum, std::size_t initialCapacity = 256);
+	virtual ~InstanceStream() = default;
+	InstanceStream(InstanceStream const&) = delete;
+	InstanceStream& operator=(InstanceStream const&) = delete;
+	InstanceStream(InstanceStream&&) = default;
+	InstanceStream& operator=(InstanceStream&&) = default;
+
+	// ̃obt@ɐiłlߍ
+	// CX^X̐Ԃ
+	std::size_t write(std::span<std::array<float, 16> const> transforms, std::span<std::array<float, 3> const> colors);
+
+	// Ōwriteobt@
+	std::size_t getFrameIndex() const noexcept;
+	std::size_t getFrameNum() const noexcept;
+	std::size_t getInstanceNum() const noexcept;
+	std::size_t getCapacity() const noexcept;
+	InstanceData const* getData() const noexcept;
+
+	InstanceStreamCounter const& getCounter() const noexcept;
+};
+
+
+//
+// ȉA
+//
+
+
+inline void NullInstanceStreamBackend::AlignedDelete::operator()(InstanceData* ptr) const noexcept
+{
+	::operator delete(ptr, std::align_val_t{ alignof(InstanceData) });
+}
+
+inline InstanceData* NullInstanceStreamBackend::resize(std::size_t frameIndex, std::size_t capacity)
+{
+	if (frameIndex >= buffers.size()) {
+		buffers.resize(frameIndex + 1);
+		capacities.resize(frameIndex + 1);
+	}
+
+	auto ptr = static_cast<InstanceData*>(::operator new(sizeof(InstanceData) * capacity, std::align_val_t{ alignof(InstanceData) }));
+	buffers[frameIndex].reset(ptr);
+	capacities[frameIndex] = capacity;
+
+	return ptr;
+}
+
+inline InstanceData const* NullInstanceStreamBackend::getData(std::size_t frameIndex) const noexcept
+{
+	return frameIndex < buffers.size() ? buffers[frameIndex].get() : nullptr;
+}
+
+inline std::size_t NullInstanceStreamBackend::getCapacity(std::size_t frameIndex) const noexcept
+{
+	return frameIndex < capacities.size() ? capacities[frameIndex] : 0;
+}
+
+
+inline InstanceStream::InstanceStream(std::unique_ptr<InstanceStreamBackend>&& b, std::size_t frameNum, std::size_t initialCapacity)
+	: backend{ std::move(b) }
+	, frames(std::max<std::size_t>(frameNum, 1))
+{
+	initialCapacity = std::max<std::size_t>(initialCapacity, 1);
+
+	// ŏwrite0Ԗڂɐi
+	frameIndex = frames.size() - 1;
+
+	for (std::size_t i = 0; i < frames.size(); i++)
+	{
+		frames[i].data = backend->resize(i, initialCapacity);
+		frames[i].capacity = initialCapacity;
+		counter.resizeNum++;
+	}
+}
+
+inline std::size_t InstanceStream::write(std::span<std::array<float, 16> const> transforms, std::span<std::array<float, 3> const> colors)
+{
+	frameIndex = (frameIndex + 1) % frames.size();
+	auto& frame = frames[frameIndex];
+
+	auto const num = std::min(transforms.size(), colors.size());
+	if (num > frame.capacity)
+	{
+		auto const capacity = std::max(num, frame.capacity * 2);
+		frame.data = backend->resize(frameIndex, capacity);
+		frame.capacity = capacity;
+		counter.resizeNum++;
+	}
+
+	// Abv[hq[v͏݌Ȃ̂ŁAǂ܂padding܂ł܂Ƃ߂ďԂɏ
+	for (std::size_t i = 0; i < num; i++)
+	{
+		InstanceData instance{};
+		instance.transform = transforms[i];
+		instance.color = colors[i];
+		std::memcpy(frame.data + i, &instance, sizeof(InstanceData));
+	}
+	instanceNum = num;
+
+	counter.frameNum++;
+	counter.instanceNum += num;
+
+	return num;
+}
+
+inline std::size_t InstanceStream::getFrameIndex() const noexcept
+{
+	return frameIndex;
+}
+
+inline std::size_t InstanceStream::getFrameNum() const noexcept
+{
+	return frames.size();
+}
+
+inline std::size_t InstanceStream::getInstanceNum() const noexcept
+{
+	return instanceNum;
+}
+
+inline std::size_t InstanceStream::getCapacity() const noexcept
+{
+	return frames[frameIndex].capacity;
+}
+
+inline InstanceData const* InstanceStream::getData() const noexcept
+{
+	return frames[frameIndex].data;
+}
+
+inline InstanceStreamCounter const& InstanceStream::getCounter() const noexcept
+{
+	return counter;
+}
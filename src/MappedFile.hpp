@@ -0,0 +1,147 @@
+#pragma once
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include<Windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+#include<cstddef>
+#include<stdexcept>
+#include<string>
+#include<string_view>
+#include<utility>
+
+// t@CŜǂݎpŃɃ}bv
+class MappedFile
+{
+	char const* data = nullptr;
+	std::size_t size{};
+
+	void unmap() noexcept;
+
+public:
+	MappedFile() = default;
+	// JȂstd::runtime_error
+	MappedFile(char const* fileName);
+	virtual ~MappedFile();
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+	MappedFile(MappedFile&&) noexcept;
+	MappedFile& operator=(MappedFile&&) noexcept;
+
+	char const* getData() const noexcept;
+	std::size_t getSize() const noexcept;
+	std::string_view getView() const noexcept;
+};
+
+
+//
+// ȉA
+//
+
+
+inline MappedFile::MappedFile(char const* fileName)
+{
+#ifdef _WIN32
+	auto file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error{ std::string{ "failed to open " } + fileName };
+
+	LARGE_INTEGER fileSize{};
+	GetFileSizeEx(file, &fileSize);
+	size = static_cast<std::size_t>(fileSize.QuadPart);
+
+	// ̃t@C̓}bvłȂ̂ŉȂ
+	if (size > 0)
+	{
+		auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping)
+		{
+			data = static_cast<char const*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			// r[cĂԂ̓}bsOc
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+#else
+	auto file = open(fileName, O_RDONLY);
+	if (file < 0)
+		throw std::runtime_error{ std::string{ "failed to open " } + fileName };
+
+	struct stat fileStat {};
+	fstat(file, &fileStat);
+	size = static_cast<std::size_t>(fileStat.st_size);
+
+	// ̃t@C̓}bvłȂ̂ŉȂ
+	if (size > 0)
+	{
+		auto ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (ptr != MAP_FAILED)
+		{
+			data = static_cast<char const*>(ptr);
+			madvise(ptr, size, MADV_SEQUENTIAL);
+		}
+	}
+	// }bv͕Ă悢
+	close(file);
+#endif
+
+	if (size > 0 && !data)
+		throw std::runtime_error{ std::string{ "failed to map " } + fileName };
+}
+
+inline MappedFile::~MappedFile()
+{
+	unmap();
+}
+
+inline MappedFile::MappedFile(MappedFile&& other) noexcept
+	: data{ std::exchange(other.data, nullptr) }
+	, size{ std::exchange(other.size, 0) }
+{
+}
+
+inline MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		unmap();
+		data = std::exchange(other.data, nullptr);
+		size = std::exchange(other.size, 0);
+	}
+	return *this;
+}
+
+inline void MappedFile::unmap() noexcept
+{
+	if (data)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+#else
+		munmap(const_cast<char*>(data), size);
+#endif
+	}
+	data = nullptr;
+	size = 0;
+}
+
+inline char const* MappedFile::getData() const noexcept
+{
+	return data;
+}
+
+inline std::size_t MappedFile::getSize() const noexcept
+{
+	return size;
+}
+
+inline std::string_view MappedFile::getView() const noexcept
+{
+	return { data, size };
+}
@@ -0,0 +1,381 @@
+#pragma once
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/BulletDynamics/Featherstone/btMultiBody.h"
+#include"../external/bullet3/src/BulletDynamics/Featherstone/btMultiBodyConstraintSolver.h"
+#include"../external/bullet3/src/BulletDynamics/Featherstone/btMultiBodyDynamicsWorld.h"
+#include"../external/bullet3/src/BulletDynamics/Featherstone/btMultiBodyInplaceSolverIslandCallback.h"
+#include"../external/bullet3/src/BulletDynamics/Featherstone/btMultiBodyLinkCollider.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include<algorithm>
+#include<memory>
+#include<numeric>
+#include<tuple>
+#include<utility>
+#include<vector>
+
+// N̂ǂꂩĂtrueAbtMultiBodyDynamicsWorldƓ
+bool is_multi_body_sleeping(btMultiBody const& body);
+
+// ̔ԍ̏ɕsortedAԍislandId͈̔͂̐擪ƐԂ
+template<typename T, typename GetIslandId>
+std::pair<int, int> find_island_range(btAlignedObjectArray<T*> const& sorted, int islandId, GetIslandId const& getIslandId);
+
+// ֐߂łȂ̂Ƃ̌vZƃAChƂ̍S̉ɂbtMultiBodyDynamicsWorld
+// forwardKinematicsAcomputeAccelerationsArticulatedBodyAlgorithmMultiDofAʒu̗\Ɛϕ͕̂Ƃɕĉ
+// Ɨp̔z̓XbhƂɎ
+// ACh͑傫ɕׂāAXbhƂbtMultiBodyConstraintSolver1
+// ACh̒gƉ̓XbhɂȂ̂ŁAʂ̓Xbhɂ炸
+// RK4Őϕ镨̂ƂƁA^XNXPW[ȂƂbtMultiBodyDynamicsWorldƓ
+class MultiBodyDynamicsWorldMt : public btMultiBodyDynamicsWorld
+{
+	// btMultiBodyDynamicsWorldm_scratch_*Ɠ
+	struct Scratch
+	{
+		btAlignedObjectArray<btScalar> r{};
+		btAlignedObjectArray<btVector3> v{};
+		btAlignedObjectArray<btMatrix3x3> m{};
+		btAlignedObjectArray<btQuaternion> worldToLocal{};
+		btAlignedObjectArray<btVector3> localOrigin{};
+	};
+
+	// 1̃AChŉ
+	// ̂ƐڐGislandBodiesAislandManifoldśASm_sortedConstraintsAm_sortedMultiBodyConstraints͈̔
+	struct Island
+	{
+		int bodyBegin{};
+		int bodyNum{};
+		int manifoldBegin{};
+		int manifoldNum{};
+		int constraintBegin{};
+		int constraintNum{};
+		int multiBodyConstraintBegin{};
+		int multiBodyConstraintNum{};
+	};
+
+	// buildAndProcessIslandsĂ΂āAislandsɐς
+	struct IslandCollector : public btSimulationIslandManager::IslandCallback
+	{
+		MultiBodyDynamicsWorldMt& world;
+		IslandCollector(MultiBodyDynamicsWorldMt& world) : world{ world } {}
+		void processIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, int islandId) override;
+	};
+
+	std::vector<Scratch> scratches{};
+	std::vector<std::unique_ptr<btMultiBodyConstraintSolver>> islandSolvers{};
+	std::vector<Island> islands{};
+	std::vector<int> islandOrder{};
+	btAlignedObjectArray<btCollisionObject*> islandBodies{};
+	btAlignedObjectArray<btPersistentManifold*> islandManifolds{};
+
+	int grainSize = 4;
+
+	// ^XNXPW[ARK4̂̕Ȃtrue
+	bool canRunParallel() const;
+	// f(body, scratch)𕨑̂ƂɕɌĂ
+	template<typename F>
+	void forEachMultiBody(F const& f);
+	// btMultiBodyDynamicsWorld::solveExternalForcesRK4łȂꍇƓ
+	void solveExternalForcesMt(btContactSolverInfo& solverInfo);
+	void collectIslands();
+	void solveIslandsMt(btContactSolverInfo& solverInfo);
+	// btMultiBodyDynamicsWorld::solveInternalConstraintš㔼Ɠ
+	void finishVelocitiesMt(btContactSolverInfo& solverInfo);
+
+public:
+	// constraintSolverRK4̂̕ƂɑŜ̂ƁAprepareSolveallSolvedɎg
+	MultiBodyDynamicsWorldMt(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btMultiBodyConstraintSolver* constraintSolver,
+		btCollisionConfiguration* collisionConfiguration);
+	virtual ~MultiBodyDynamicsWorldMt() = default;
+	MultiBodyDynamicsWorldMt(MultiBodyDynamicsWorldMt const&) = delete;
+	MultiBodyDynamicsWorldMt& operator=(MultiBodyDynamicsWorldMt const&) = delete;
+
+	void predictUnconstraintMotion(btScalar timeStep) override;
+	void solveConstraints(btContactSolverInfo& solverInfo) override;
+	void integrateTransforms(btScalar timeStep) override;
+
+	// 1^XNŌvZ镨̂̐
+	void setGrainSize(int size) noexcept;
+	// Ō̃XebvŉACh̐
+	int getIslandNum() const noexcept { return static_cast<int>(islands.size()); }
+};
+
+
+//
+// ȉA
+//
+
+
+inline bool is_multi_body_sleeping(btMultiBody const& body)
+{
+	if (body.getBaseCollider() && body.getBaseCollider()->getActivationState() == ISLAND_SLEEPING)
+		return true;
+	for (int i = 0; i < body.getNumLinks(); i++)
+	{
+		if (body.getLink(i).m_collider && body.getLink(i).m_collider->getActivationState() == ISLAND_SLEEPING)
+			return true;
+	}
+	return false;
+}
+
+template<typename T, typename GetIslandId>
+inline std::pair<int, int> find_island_range(btAlignedObjectArray<T*> const& sorted, int islandId, GetIslandId const& getIslandId)
+{
+	int begin = 0;
+	while (begin < sorted.size() && getIslandId(sorted[begin]) < islandId)
+		begin++;
+	int end = begin;
+	while (end < sorted.size() && getIslandId(sorted[end]) == islandId)
+		end++;
+	return { begin, end - begin };
+}
+
+inline MultiBodyDynamicsWorldMt::MultiBodyDynamicsWorldMt(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btMultiBodyConstraintSolver* constraintSolver,
+	btCollisionConfiguration* collisionConfiguration)
+	: btMultiBodyDynamicsWorld(dispatcher, pairCache, constraintSolver, collisionConfiguration)
+{
+	scratches.resize(BT_MAX_THREAD_COUNT);
+	islandSolvers.reserve(BT_MAX_THREAD_COUNT);
+	for (unsigned i = 0; i < BT_MAX_THREAD_COUNT; i++)
+		islandSolvers.push_back(std::make_unique<btMultiBodyConstraintSolver>());
+}
+
+inline void MultiBodyDynamicsWorldMt::setGrainSize(int size) noexcept
+{
+	grainSize = std::max(size, 1);
+}
+
+inline bool MultiBodyDynamicsWorldMt::canRunParallel() const
+{
+	if (!btGetTaskScheduler())
+		return false;
+	for (int i = 0; i < m_multiBodies.size(); i++)
+	{
+		if (m_multiBodies[i]->isUsingRK4Integration())
+			return false;
+	}
+	return true;
+}
+
+template<typename F>
+inline void MultiBodyDynamicsWorldMt::forEachMultiBody(F const& f)
+{
+	auto const run = [&](int begin, int end) {
+		auto& scratch = scratches[btGetCurrentThreadIndex()];
+		for (int i = begin; i < end; i++)
+			f(*m_multiBodies[i], scratch);
+	};
+
+	struct ForEachBody : public btIParallelForBody
+	{
+		decltype(run) const& f;
+		ForEachBody(decltype(run) const& f) : f{ f } {}
+		void forLoop(int begin, int end) const override { f(begin, end); }
+	} body{ run };
+	btParallelFor(0, m_multiBodies.size(), grainSize, body);
+}
+
+inline void MultiBodyDynamicsWorldMt::predictUnconstraintMotion(btScalar timeStep)
+{
+	if (!canRunParallel()) {
+		btMultiBodyDynamicsWorld::predictUnconstraintMotion(timeStep);
+		return;
+	}
+
+	btDiscreteDynamicsWorld::predictUnconstraintMotion(timeStep);
+
+	BT_PROFILE("btMultiBody stepPositions");
+	forEachMultiBody([&](btMultiBody& body, Scratch& scratch) {
+		if (is_multi_body_sleeping(body)) {
+			body.clearVelocities();
+			return;
+		}
+		body.predictPositionsMultiDof(timeStep);
+		scratch.worldToLocal.resize(body.getNumLinks() + 1);
+		scratch.localOrigin.resize(body.getNumLinks() + 1);
+		body.updateCollisionObjectInterpolationWorldTransforms(scratch.worldToLocal, scratch.localOrigin);
+	});
+}
+
+inline void MultiBodyDynamicsWorldMt::integrateTransforms(btScalar timeStep)
+{
+	if (!canRunParallel()) {
+		btMultiBodyDynamicsWorld::integrateTransforms(timeStep);
+		return;
+	}
+
+	btDiscreteDynamicsWorld::integrateTransforms(timeStep);
+
+	BT_PROFILE("btMultiBody stepPositions");
+	forEachMultiBody([&](btMultiBody& body, Scratch& scratch) {
+		if (is_multi_body_sleeping(body)) {
+			body.clearVelocities();
+			return;
+		}
+
+		body.addSplitV();
+		if (!body.isPosUpdated())
+			body.stepPositionsMultiDof(timeStep);
+		else
+		{
+			btScalar* pRealBuf = const_cast<btScalar*>(body.getVelocityVector());
+			pRealBuf += 6 + body.getNumDofs() + body.getNumDofs() * body.getNumDofs();
+			body.stepPositionsMultiDof(1, 0, pRealBuf);
+			body.setPosUpdated(false);
+		}
+
+		scratch.worldToLocal.resize(body.getNumLinks() + 1);
+		scratch.localOrigin.resize(body.getNumLinks() + 1);
+		body.updateCollisionObjectWorldTransforms(scratch.worldToLocal, scratch.localOrigin);
+		body.substractSplitV();
+	});
+}
+
+inline void MultiBodyDynamicsWorldMt::solveConstraints(btContactSolverInfo& solverInfo)
+{
+	if (!canRunParallel()) {
+		btMultiBodyDynamicsWorld::solveConstraints(solverInfo);
+		return;
+	}
+
+	solveExternalForcesMt(solverInfo);
+	collectIslands();
+	solveIslandsMt(solverInfo);
+	finishVelocitiesMt(solverInfo);
+}
+
+inline void MultiBodyDynamicsWorldMt::solveExternalForcesMt(btContactSolverInfo& solverInfo)
+{
+	{
+		BT_PROFILE("forwardKinematics");
+		forEachMultiBody([&](btMultiBody& body, Scratch& scratch) {
+			body.forwardKinematics(scratch.worldToLocal, scratch.localOrigin);
+		});
+	}
+
+	BT_PROFILE("solveConstraints");
+
+	clearMultiBodyConstraintForces();
+
+	// AChƂɍS͈̔͂T悤ɕׂ
+	m_sortedConstraints.resize(m_constraints.size());
+	for (int i = 0; i < m_constraints.size(); i++)
+		m_sortedConstraints[i] = m_constraints[i];
+	m_sortedConstraints.quickSort(btSortConstraintOnIslandPredicate2());
+
+	m_sortedMultiBodyConstraints.resize(m_multiBodyConstraints.size());
+	for (int i = 0; i < m_multiBodyConstraints.size(); i++)
+		m_sortedMultiBodyConstraints[i] = m_multiBodyConstraints[i];
+	m_sortedMultiBodyConstraints.quickSort(btSortMultiBodyConstraintOnIslandPredicate());
+
+	m_constraintSolver->prepareSolve(getCollisionWorld()->getNumCollisionObjects(), getCollisionWorld()->getDispatcher()->getNumManifolds());
+
+	{
+		BT_PROFILE("btMultiBody stepVelocities");
+		forEachMultiBody([&](btMultiBody& body, Scratch& scratch) {
+			if (is_multi_body_sleeping(body))
+				return;
+			scratch.r.resize(body.getNumLinks() + 1);
+			scratch.v.resize(body.getNumLinks() + 1);
+			scratch.m.resize(body.getNumLinks() + 1);
+			body.computeAccelerationsArticulatedBodyAlgorithmMultiDof(solverInfo.m_timeStep, scratch.r, scratch.v, scratch.m, false,
+				getSolverInfo().m_jointFeedbackInWorldSpace, getSolverInfo().m_jointFeedbackInJointFrame);
+		});
+	}
+}
+
+inline void MultiBodyDynamicsWorldMt::IslandCollector::processIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, int islandId)
+{
+	auto& island = world.islands.emplace_back();
+
+	island.bodyBegin = world.islandBodies.size();
+	for (int i = 0; i < numBodies; i++)
+	{
+		if (!(bodies[i]->getInternalType() & btCollisionObject::CO_SOFT_BODY))
+			world.islandBodies.push_back(bodies[i]);
+	}
+	island.bodyNum = world.islandBodies.size() - island.bodyBegin;
+
+	island.manifoldBegin = world.islandManifolds.size();
+	for (int i = 0; i < numManifolds; i++)
+		world.islandManifolds.push_back(manifolds[i]);
+	island.manifoldNum = numManifolds;
+
+	// ĂȂΑSAĂΓ̔ԍ͈
+	auto const& constraints = world.m_sortedConstraints;
+	auto const& multiBodyConstraints = world.m_sortedMultiBodyConstraints;
+	if (islandId < 0)
+	{
+		island.constraintNum = constraints.size();
+		island.multiBodyConstraintNum = multiBodyConstraints.size();
+		return;
+	}
+
+	std::tie(island.constraintBegin, island.constraintNum) = find_island_range(constraints, islandId, [](btTypedConstraint const* c) { return btGetConstraintIslandId2(c); });
+	std::tie(island.multiBodyConstraintBegin, island.multiBodyConstraintNum) = find_island_range(multiBodyConstraints, islandId, [](btMultiBodyConstraint const* c) { return btGetMultiBodyConstraintIslandId(c); });
+}
+
+inline void MultiBodyDynamicsWorldMt::collectIslands()
+{
+	BT_PROFILE("collectIslands");
+
+	islands.clear();
+	islandBodies.resize(0);
+	islandManifolds.resize(0);
+	IslandCollector collector{ *this };
+	m_islandManager->buildAndProcessIslands(getCollisionWorld()->getDispatcher(), getCollisionWorld(), &collector);
+
+	// 傫AChn߂
+	auto const cost = [&](int i) {
+		auto const& island = islands[i];
+		return island.bodyNum + island.manifoldNum + island.constraintNum + island.multiBodyConstraintNum;
+	};
+	islandOrder.resize(islands.size());
+	std::iota(islandOrder.begin(), islandOrder.end(), 0);
+	std::stable_sort(islandOrder.begin(), islandOrder.end(), [&](int a, int b) { return cost(a) > cost(b); });
+}
+
+inline void MultiBodyDynamicsWorldMt::solveIslandsMt(btContactSolverInfo& solverInfo)
+{
+	BT_PROFILE("solveIslands");
+
+	auto const solve = [&](int begin, int end) {
+		auto const solver = islandSolvers[btGetCurrentThreadIndex()].get();
+		for (int i = begin; i < end; i++)
+		{
+			auto const& island = islands[islandOrder[i]];
+			if (island.bodyNum == 0)
+				continue;
+			solver->solveMultiBodyGroup(&islandBodies[island.bodyBegin], island.bodyNum,
+				island.manifoldNum ? &islandManifolds[island.manifoldBegin] : nullptr, island.manifoldNum,
+				island.constraintNum ? &m_sortedConstraints[island.constraintBegin] : nullptr, island.constraintNum,
+				island.multiBodyConstraintNum ? &m_sortedMultiBodyConstraints[island.multiBodyConstraintBegin] : nullptr, island.multiBodyConstraintNum,
+				solverInfo, m_debugDrawer, getCollisionWorld()->getDispatcher());
+		}
+	};
+
+	struct SolveBody : public btIParallelForBody
+	{
+		decltype(solve) const& f;
+		SolveBody(decltype(solve) const& f) : f{ f } {}
+		void forLoop(int begin, int end) const override { f(begin, end); }
+	} body{ solve };
+	btParallelFor(0, static_cast<int>(islandOrder.size()), 1, body);
+}
+
+inline void MultiBodyDynamicsWorldMt::finishVelocitiesMt(btContactSolverInfo& solverInfo)
+{
+	m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
+
+	BT_PROFILE("btMultiBody stepVelocities");
+	forEachMultiBody([&](btMultiBody& body, Scratch& scratch) {
+		if (!is_multi_body_sleeping(body) && body.internalNeedsJointFeedback())
+		{
+			scratch.r.resize(body.getNumLinks() + 1);
+			scratch.v.resize(body.getNumLinks() + 1);
+			scratch.m.resize(body.getNumLinks() + 1);
+			body.computeAccelerationsArticulatedBodyAlgorithmMultiDof(solverInfo.m_timeStep, scratch.r, scratch.v, scratch.m, true,
+				getSolverInfo().m_jointFeedbackInWorldSpace, getSolverInfo().m_jointFeedbackInJointFrame);
+		}
+		body.processDeltaVeeMultiDof2();
+	});
+}
@@ -0,0 +1,687 @@
+#pragma once
+#include"../external/bullet3/src/BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include"../external/bullet3/src/BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include"../external/bullet3/src/BulletCollision/BroadphaseCollision/btDispatcher.h"
+#include"../external/bullet3/src/LinearMath/btQuickprof.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include<algorithm>
+#include<atomic>
+#include<bit>
+#include<climits>
+#include<cstdint>
+#include<cstdlib>
+#include<functional>
+#include<memory>
+#include<new>
+#include<span>
+#include<utility>
+#include<vector>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include<xmmintrin.h>
+#endif
+
+// 2̃vLVuidɋl߂L[Auid1ȏȂ̂0ɂ͂ȂȂ
+std::uint64_t make_pair_key(btBroadphaseProxy const* proxy0, btBroadphaseProxy const* proxy1) noexcept;
+
+// JԒn@̃nbV\ŃyAbtOverlappingPairCache
+// yA̔zbtHashedOverlappingPairCacheƓl߂ĎA\ɂ̓L[Ɣz̔ԍu
+// \傫Ƃ͐V\Aǉƍ폜̂тɌÂ\班ڂ
+// ڂOɂ܂傫AÂ\ɕׂĂČÂ̂ڂ
+// addOverlappingPairs͕XbhȂL[̎荇CASŌ߂ĕɖ߂
+// 1XbhȂ̃XbgǂłȂ珇ɑ
+// 1btHashedOverlappingPairCachex̂ŁA܂Ƃ߂đParallelDbvtBroadphaseƎg
+class OpenAddressingPairCache : public btOverlappingPairCache
+{
+public:
+	using ProxyPair = std::pair<btBroadphaseProxy*, btBroadphaseProxy*>;
+
+private:
+	static constexpr std::uint64_t EMPTY_KEY = 0;
+	// Â\ŏV\ɈڂXbg
+	static constexpr std::uint64_t REMOVED_KEY = ~std::uint64_t{ 0 };
+	static constexpr std::size_t NO_SLOT = ~std::size_t{ 0 };
+	static constexpr std::size_t MIN_TABLE_SIZE = 64;
+	// 1̒ǉA폜ŌÂ\ڂXbg̐
+	static constexpr std::size_t MIGRATE_SLOT_NUM = 16;
+	// ܂Ƃ߂đƂA̃Xbgǂł
+	static constexpr std::size_t PREFETCH_DISTANCE = 8;
+
+	// L[Ɣԍ𓯂LbVCɒu
+	struct Slot
+	{
+		std::atomic<std::uint64_t> key;
+		// z̔ԍ+1A0ȂԍȂ
+		// ȂaddOverlappingPairsŎ荇ĂrŁAINT_MIN+ob`̔ԍ
+		std::atomic<int> value;
+	};
+
+	// 0Ŗ߂̈OSgƂɗpӂ̂ŁA傫ƂɈxɐG炸ɍς
+	struct SlotDeleter
+	{
+		void operator()(Slot* slots) const noexcept { std::free(slots); }
+	};
+
+	struct Table
+	{
+		std::unique_ptr<Slot[], SlotDeleter> slots{};
+		std::size_t size{};
+		int shift{};
+	};
+
+	btBroadphasePairArray pairArray{};
+
+	Table table{};
+	// 傫ĂrȂڂĂȂyAcĂAÂ
+	std::vector<Table> previousTables{};
+	// previousTables̐擪̕\ŎɈڂXbg
+	std::size_t migrateCursor{};
+
+	btOverlapFilterCallback* overlapFilterCallback = nullptr;
+	btOverlappingPairCallback* ghostPairCallback = nullptr;
+
+	// addOverlappingPairsŊeyAXbg
+	std::vector<std::size_t> batchSlots{};
+	int grainSize = 256;
+
+public:
+	OpenAddressingPairCache();
+	virtual ~OpenAddressingPairCache() = default;
+	OpenAddressingPairCache(OpenAddressingPairCache const&) = delete;
+	OpenAddressingPairCache& operator=(OpenAddressingPairCache const&) = delete;
+
+	btBroadphasePair* addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) override;
+	void* removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher) override;
+	void removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher) override;
+
+	// ܂Ƃ߂đāAԂ
+	// yAxĂŏ̂̂̂ŁAXbhɂ炸z͓̏
+	int addOverlappingPairs(std::span<ProxyPair const> pairs);
+	// ܂Ƃ߂ďāAԂ
+	int removeOverlappingPairs(std::span<ProxyPair const> pairs, btDispatcher* dispatcher);
+
+	btBroadphasePair* getOverlappingPairArrayPtr() override;
+	btBroadphasePair const* getOverlappingPairArrayPtr() const override;
+	btBroadphasePairArray& getOverlappingPairArray() override;
+	int getNumOverlappingPairs() const override;
+
+	void cleanOverlappingPair(btBroadphasePair& pair, btDispatcher* dispatcher) override;
+	void cleanProxyFromPairs(btBroadphaseProxy* proxy, btDispatcher* dispatcher) override;
+
+	bool needsBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const override;
+	btOverlapFilterCallback* getOverlapFilterCallback() override;
+	void setOverlapFilterCallback(btOverlapFilterCallback* callback) override;
+
+	void processAllOverlappingPairs(btOverlapCallback* callback, btDispatcher* dispatcher) override;
+	void processAllOverlappingPairs(btOverlapCallback* callback, btDispatcher* dispatcher, btDispatcherInfo const& dispatchInfo) override;
+
+	// \ǂނȂ̂ŁAǉ폜ƓłȂΕXbhĂׂ
+	btBroadphasePair* findPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) override;
+
+	bool hasDeferredRemoval() override;
+	void setInternalGhostPairCallback(btOverlappingPairCallback* callback) override;
+	void sortOverlappingPairs(btDispatcher* dispatcher) override;
+
+	// addOverlappingPairs1^XÑyA
+	void setGrainSize(int size) noexcept;
+	std::size_t getTableSize() const noexcept;
+	bool isResizing() const noexcept;
+
+private:
+	static Table make_table(std::size_t size);
+	static std::size_t home_slot(Table const& t, std::uint64_t key) noexcept;
+	static std::size_t probe(Table const& t, std::uint64_t key) noexcept;
+	// keỹXbgAȂΓ󂫃Xbg
+	static std::size_t probe_or_empty(Table const& t, std::uint64_t key) noexcept;
+	static void prefetch(Table const& t, std::uint64_t key) noexcept;
+	static void insert_slot(Table& t, std::uint64_t key, int value) noexcept;
+	// ̃Xbgl߂ďAWcȂ
+	static void erase_slot(Table& t, std::size_t slot) noexcept;
+
+	// keỹXbgAL[荇claim̏(ob`̑O̕)c
+	// zɂyAȂNO_SLOT
+	std::size_t claimSlot(std::uint64_t key, int claim) noexcept;
+	// key̓Ă\ƃXbg
+	std::pair<Table*, std::size_t> locate(std::uint64_t key) noexcept;
+	// keyڂĂȂÂ\ɂ邩
+	bool isInPreviousTables(std::uint64_t key) const noexcept;
+
+	// numĂ\̔𒴂Ȃ悤ɂ
+	void reserve(std::size_t num);
+	// Â\ÂslotNum̃Xbgڂ
+	void migrate(std::size_t slotNum);
+	void rebuildTable();
+	btBroadphasePair* getPair(Slot const& slot) noexcept;
+	// reserveĂĂ
+	btBroadphasePair* insertPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, std::uint64_t key);
+	int addOverlappingPairsParallel(std::span<ProxyPair const> pairs);
+	void* removePair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher);
+};
+
+
+//
+// ȉA
+//
+
+
+inline std::uint64_t make_pair_key(btBroadphaseProxy const* proxy0, btBroadphaseProxy const* proxy1) noexcept
+{
+	auto uid0 = static_cast<std::uint32_t>(proxy0->getUid());
+	auto uid1 = static_cast<std::uint32_t>(proxy1->getUid());
+	if (uid0 > uid1)
+		std::swap(uid0, uid1);
+	return (static_cast<std::uint64_t>(uid0) << 32) | uid1;
+}
+
+inline OpenAddressingPairCache::OpenAddressingPairCache()
+	: table{ make_table(MIN_TABLE_SIZE) }
+{
+}
+
+inline OpenAddressingPairCache::Table OpenAddressingPairCache::make_table(std::size_t size)
+{
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<int>::is_always_lock_free);
+
+	size = std::bit_ceil(std::max(size, MIN_TABLE_SIZE));
+
+	Table t{};
+	t.slots.reset(static_cast<Slot*>(std::calloc(size, sizeof(Slot))));
+	if (!t.slots)
+		throw std::bad_alloc{};
+	t.size = size;
+	t.shift = 64 - std::countr_zero(size);
+	return t;
+}
+
+inline std::size_t OpenAddressingPairCache::home_slot(Table const& t, std::uint64_t key) noexcept
+{
+	// tB{ib`nbVAʃrbgg
+	return static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> t.shift);
+}
+
+inline std::size_t OpenAddressingPairCache::probe(Table const& t, std::uint64_t key) noexcept
+{
+	auto const mask = t.size - 1;
+	for (auto slot = home_slot(t, key);; slot = (slot + 1) & mask)
+	{
+		auto const k = t.slots[slot].key.load(std::memory_order_acquire);
+		if (k == key)
+			return slot;
+		if (k == EMPTY_KEY)
+			return NO_SLOT;
+	}
+}
+
+inline std::size_t OpenAddressingPairCache::probe_or_empty(Table const& t, std::uint64_t key) noexcept
+{
+	auto const mask = t.size - 1;
+	auto slot = home_slot(t, key);
+	while (true)
+	{
+		auto const k = t.slots[slot].key.load(std::memory_order_relaxed);
+		if (k == key || k == EMPTY_KEY)
+			return slot;
+		slot = (slot + 1) & mask;
+	}
+}
+
+inline void OpenAddressingPairCache::prefetch(Table const& t, std::uint64_t key) noexcept
+{
+	auto const p = &t.slots[home_slot(t, key)];
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(reinterpret_cast<char const*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(p);
+#else
+	(void)p;
+#endif
+}
+
+inline void OpenAddressingPairCache::insert_slot(Table& t, std::uint64_t key, int value) noexcept
+{
+	auto const mask = t.size - 1;
+	auto slot = home_slot(t, key);
+	while (t.slots[slot].key.load(std::memory_order_relaxed) != EMPTY_KEY)
+		slot = (slot + 1) & mask;
+	t.slots[slot].value.store(value, std::memory_order_relaxed);
+	t.slots[slot].key.store(key, std::memory_order_relaxed);
+}
+
+inline void OpenAddressingPairCache::erase_slot(Table& t, std::size_t slot) noexcept
+{
+	auto const mask = t.size - 1;
+	auto next = slot;
+	while (true)
+	{
+		next = (next + 1) & mask;
+		auto const key = t.slots[next].key.load(std::memory_order_relaxed);
+		if (key == EMPTY_KEY)
+			break;
+
+		// next̃L[{̈ʒuslotʂĂȂOɋl߂
+		auto const home = home_slot(t, key);
+		if (((next - home) & mask) >= ((next - slot) & mask))
+		{
+			t.slots[slot].key.store(key, std::memory_order_relaxed);
+			t.slots[slot].value.store(t.slots[next].value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			slot = next;
+		}
+	}
+	t.slots[slot].key.store(EMPTY_KEY, std::memory_order_relaxed);
+	t.slots[slot].value.store(0, std::memory_order_relaxed);
+}
+
+inline std::size_t OpenAddressingPairCache::claimSlot(std::uint64_t key, int claim) noexcept
+{
+	auto const mask = table.size - 1;
+	auto slot = home_slot(table, key);
+	while (true)
+	{
+		auto k = table.slots[slot].key.load(std::memory_order_acquire);
+		if (k == EMPTY_KEY)
+		{
+			if (table.slots[slot].key.compare_exchange_strong(k, key, std::memory_order_acq_rel))
+				break;
+			// ̃XbhɐɎꂽÃL[
+		}
+		if (k == key)
+			break;
+		slot = (slot + 1) & mask;
+	}
+
+	auto& value = table.slots[slot].value;
+	auto current = value.load(std::memory_order_acquire);
+	while ((current == 0 || (current < 0 && claim < current)) &&
+		!value.compare_exchange_weak(current, claim, std::memory_order_acq_rel))
+	{
+	}
+	return current > 0 ? NO_SLOT : slot;
+}
+
+inline std::pair<OpenAddressingPairCache::Table*, std::size_t> OpenAddressingPairCache::locate(std::uint64_t key) noexcept
+{
+	if (auto const slot = probe(table, key); slot != NO_SLOT)
+		return { &table, slot };
+	for (auto& t : previousTables)
+		if (auto const slot = probe(t, key); slot != NO_SLOT)
+			return { &t, slot };
+	return { nullptr, NO_SLOT };
+}
+
+inline bool OpenAddressingPairCache::isInPreviousTables(std::uint64_t key) const noexcept
+{
+	for (auto const& t : previousTables)
+		if (probe(t, key) != NO_SLOT)
+			return true;
+	return false;
+}
+
+inline btBroadphasePair* OpenAddressingPairCache::getPair(Slot const& slot) noexcept
+{
+	return &pairArray[slot.value.load(std::memory_order_relaxed) - 1];
+}
+
+inline void OpenAddressingPairCache::reserve(std::size_t num)
+{
+	auto const required = static_cast<std::size_t>(pairArray.size()) + num;
+	if (required * 2 <= table.size)
+		return;
+
+	// ɑ傫܂łɈڂ悤ɁA{numĂ41ɂȂ傫ɂ
+	// O̊gIĂȂ΁ǍÂ\c܂ܑňڂ
+	auto const size = std::max(table.size * 2, required * 4);
+	previousTables.push_back(std::move(table));
+	table = make_table(size);
+}
+
+inline void OpenAddressingPairCache::migrate(std::size_t slotNum)
+{
+	while (slotNum > 0 && !previousTables.empty())
+	{
+		auto& previousTable = previousTables.front();
+		auto const end = std::min(previousTable.size, migrateCursor + slotNum);
+		slotNum -= end - migrateCursor;
+		for (; migrateCursor < end; migrateCursor++)
+		{
+			auto& slot = previousTable.slots[migrateCursor];
+			auto const key = slot.key.load(std::memory_order_relaxed);
+			if (key == EMPTY_KEY || key == REMOVED_KEY)
+				continue;
+			insert_slot(table, key, slot.value.load(std::memory_order_relaxed));
+			// 󂫂ɂƒTr؂̂ŕWɂ
+			slot.key.store(REMOVED_KEY, std::memory_order_relaxed);
+		}
+
+		if (migrateCursor == previousTable.size)
+		{
+			previousTables.erase(previousTables.begin());
+			migrateCursor = 0;
+		}
+	}
+}
+
+inline void OpenAddressingPairCache::rebuildTable()
+{
+	previousTables.clear();
+	migrateCursor = 0;
+	table = make_table(static_cast<std::size_t>(pairArray.size()) * 4);
+	for (int i = 0; i < pairArray.size(); i++)
+		insert_slot(table, make_pair_key(pairArray[i].m_pProxy0, pairArray[i].m_pProxy1), i + 1);
+}
+
+inline btBroadphasePair* OpenAddressingPairCache::insertPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, std::uint64_t key)
+{
+	for (auto& t : previousTables)
+		if (auto const slot = probe(t, key); slot != NO_SLOT)
+			return getPair(t.slots[slot]);
+
+	auto& slot = table.slots[probe_or_empty(table, key)];
+	if (slot.key.load(std::memory_order_relaxed) == key)
+		return getPair(slot);
+
+	auto const index = pairArray.size();
+	slot.value.store(index + 1, std::memory_order_relaxed);
+	slot.key.store(key, std::memory_order_relaxed);
+
+	if (ghostPairCallback)
+		ghostPairCallback->addOverlappingPair(proxy0, proxy1);
+
+	pairArray.push_back(btBroadphasePair(*proxy0, *proxy1));
+	return &pairArray[index];
+}
+
+inline btBroadphasePair* OpenAddressingPairCache::addOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	if (!needsBroadphaseCollision(proxy0, proxy1))
+		return nullptr;
+
+	reserve(1);
+	auto const pair = insertPair(proxy0, proxy1, make_pair_key(proxy0, proxy1));
+	migrate(MIGRATE_SLOT_NUM);
+	return pair;
+}
+
+inline int OpenAddressingPairCache::addOverlappingPairs(std::span<ProxyPair const> pairs)
+{
+	if (pairs.empty())
+		return 0;
+
+	reserve(pairs.size());
+
+	auto const scheduler = btGetTaskScheduler();
+	if (scheduler && scheduler->getNumThreads() > 1 && pairs.size() > static_cast<std::size_t>(grainSize))
+		return addOverlappingPairsParallel(pairs);
+
+	// \͑傫ȂȂ̂ŁÃyÃXbgǂł
+	auto const num = pairArray.size();
+	for (std::size_t i = 0; i < pairs.size(); i++)
+	{
+		if (i + PREFETCH_DISTANCE < pairs.size())
+			prefetch(table, make_pair_key(pairs[i + PREFETCH_DISTANCE].first, pairs[i + PREFETCH_DISTANCE].second));
+
+		auto const [proxy0, proxy1] = pairs[i];
+		if (needsBroadphaseCollision(proxy0, proxy1))
+			insertPair(proxy0, proxy1, make_pair_key(proxy0, proxy1));
+	}
+
+	auto const added = pairArray.size() - num;
+	migrate(MIGRATE_SLOT_NUM * static_cast<std::size_t>(added));
+	return added;
+}
+
+inline int OpenAddressingPairCache::addOverlappingPairsParallel(std::span<ProxyPair const> pairs)
+{
+	batchSlots.resize(pairs.size());
+
+	// \ɃL[Ď荇߂Ƃ܂ł͕
+	auto const claim = [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			auto const [proxy0, proxy1] = pairs[i];
+			if (!needsBroadphaseCollision(proxy0, proxy1)) {
+				batchSlots[i] = NO_SLOT;
+				continue;
+			}
+
+			auto const key = make_pair_key(proxy0, proxy1);
+			if (isInPreviousTables(key)) {
+				batchSlots[i] = NO_SLOT;
+				continue;
+			}
+			batchSlots[i] = claimSlot(key, INT_MIN + i);
+		}
+	};
+
+	struct ClaimBody : public btIParallelForBody
+	{
+		decltype(claim) const& f;
+		ClaimBody(decltype(claim) const& f) : f{ f } {}
+		void forLoop(int begin, int end) const override { f(begin, end); }
+	} body{ claim };
+	auto const num = static_cast<int>(pairs.size());
+	btParallelFor(0, num, grainSize, body);
+
+	// 荇ɏ̂ob`̏ɔzɑ̂ŁA1XbĥƂƓɂȂ
+	int added = 0;
+	for (int i = 0; i < num; i++)
+	{
+		auto const slot = batchSlots[i];
+		if (slot == NO_SLOT || table.slots[slot].value.load(std::memory_order_relaxed) != INT_MIN + i)
+			continue;
+
+		auto const [proxy0, proxy1] = pairs[i];
+		table.slots[slot].value.store(pairArray.size() + 1, std::memory_order_relaxed);
+
+		if (ghostPairCallback)
+			ghostPairCallback->addOverlappingPair(proxy0, proxy1);
+
+		pairArray.push_back(btBroadphasePair(*proxy0, *proxy1));
+		added++;
+	}
+	migrate(MIGRATE_SLOT_NUM * static_cast<std::size_t>(added));
+
+	return added;
+}
+
+inline void* OpenAddressingPairCache::removePair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher)
+{
+	auto const [t, slot] = locate(make_pair_key(proxy0, proxy1));
+	if (!t)
+		return nullptr;
+
+	auto const index = t->slots[slot].value.load(std::memory_order_relaxed) - 1;
+	auto& pair = pairArray[index];
+	cleanOverlappingPair(pair, dispatcher);
+	auto const userData = pair.m_internalInfo1;
+
+	if (t == &table)
+		erase_slot(table, slot);
+	else
+		t->slots[slot].key.store(REMOVED_KEY, std::memory_order_relaxed);
+
+	if (ghostPairCallback)
+		ghostPairCallback->removeOverlappingPair(proxy0, proxy1, dispatcher);
+
+	// Ō̃yA󂢂ƂɈڂāA\̔ԍ
+	auto const last = pairArray.size() - 1;
+	if (index != last)
+	{
+		pairArray[index] = pairArray[last];
+		auto const [lastTable, lastSlot] = locate(make_pair_key(pairArray[index].m_pProxy0, pairArray[index].m_pProxy1));
+		lastTable->slots[lastSlot].value.store(index + 1, std::memory_order_relaxed);
+	}
+	pairArray.pop_back();
+
+	return userData;
+}
+
+inline void* OpenAddressingPairCache::removeOverlappingPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1, btDispatcher* dispatcher)
+{
+	auto const userData = removePair(proxy0, proxy1, dispatcher);
+	migrate(MIGRATE_SLOT_NUM);
+	return userData;
+}
+
+inline int OpenAddressingPairCache::removeOverlappingPairs(std::span<ProxyPair const> pairs, btDispatcher* dispatcher)
+{
+	auto const num = pairArray.size();
+	for (std::size_t i = 0; i < pairs.size(); i++)
+	{
+		if (i + PREFETCH_DISTANCE < pairs.size())
+			prefetch(table, make_pair_key(pairs[i + PREFETCH_DISTANCE].first, pairs[i + PREFETCH_DISTANCE].second));
+		removePair(pairs[i].first, pairs[i].second, dispatcher);
+	}
+
+	auto const removed = num - pairArray.size();
+	migrate(MIGRATE_SLOT_NUM * static_cast<std::size_t>(removed));
+	return removed;
+}
+
+inline void OpenAddressingPairCache::removeOverlappingPairsContainingProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	for (int i = 0; i < pairArray.size();)
+	{
+		auto const& pair = pairArray[i];
+		if (pair.m_pProxy0 == proxy || pair.m_pProxy1 == proxy)
+			removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1, dispatcher);
+		else
+			i++;
+	}
+}
+
+inline btBroadphasePair* OpenAddressingPairCache::getOverlappingPairArrayPtr()
+{
+	return &pairArray[0];
+}
+
+inline btBroadphasePair const* OpenAddressingPairCache::getOverlappingPairArrayPtr() const
+{
+	return &pairArray[0];
+}
+
+inline btBroadphasePairArray& OpenAddressingPairCache::getOverlappingPairArray()
+{
+	return pairArray;
+}
+
+inline int OpenAddressingPairCache::getNumOverlappingPairs() const
+{
+	return pairArray.size();
+}
+
+inline void OpenAddressingPairCache::cleanOverlappingPair(btBroadphasePair& pair, btDispatcher* dispatcher)
+{
+	if (pair.m_algorithm && dispatcher)
+	{
+		pair.m_algorithm->~btCollisionAlgorithm();
+		dispatcher->freeCollisionAlgorithm(pair.m_algorithm);
+		pair.m_algorithm = nullptr;
+	}
+}
+
+inline void OpenAddressingPairCache::cleanProxyFromPairs(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	for (int i = 0; i < pairArray.size(); i++)
+	{
+		auto& pair = pairArray[i];
+		if (pair.m_pProxy0 == proxy || pair.m_pProxy1 == proxy)
+			cleanOverlappingPair(pair, dispatcher);
+	}
+}
+
+inline bool OpenAddressingPairCache::needsBroadphaseCollision(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1) const
+{
+	if (overlapFilterCallback)
+		return overlapFilterCallback->needBroadphaseCollision(proxy0, proxy1);
+
+	return (proxy0->m_collisionFilterGroup & proxy1->m_collisionFilterMask) != 0 &&
+		(proxy1->m_collisionFilterGroup & proxy0->m_collisionFilterMask) != 0;
+}
+
+inline btOverlapFilterCallback* OpenAddressingPairCache::getOverlapFilterCallback()
+{
+	return overlapFilterCallback;
+}
+
+inline void OpenAddressingPairCache::setOverlapFilterCallback(btOverlapFilterCallback* callback)
+{
+	overlapFilterCallback = callback;
+}
+
+inline void OpenAddressingPairCache::processAllOverlappingPairs(btOverlapCallback* callback, btDispatcher* dispatcher)
+{
+	BT_PROFILE("OpenAddressingPairCache::processAllOverlappingPairs");
+
+	// ƍŌ̃yAiɗ̂ŁÂƂii߂Ȃ
+	for (int i = 0; i < pairArray.size();)
+	{
+		auto& pair = pairArray[i];
+		if (callback->processOverlap(pair))
+			removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1, dispatcher);
+		else
+			i++;
+	}
+}
+
+inline void OpenAddressingPairCache::processAllOverlappingPairs(btOverlapCallback* callback, btDispatcher* dispatcher, btDispatcherInfo const& dispatchInfo)
+{
+	if (!dispatchInfo.m_deterministicOverlappingPairs) {
+		processAllOverlappingPairs(callback, dispatcher);
+		return;
+	}
+
+	// btHashedOverlappingPairCacheƓuid̑傫ɉ
+	// Ɣz̈ʒuς̂ŃL[ňȂ
+	std::vector<std::uint64_t> keys(static_cast<std::size_t>(pairArray.size()));
+	for (int i = 0; i < pairArray.size(); i++)
+		keys[i] = make_pair_key(pairArray[i].m_pProxy0, pairArray[i].m_pProxy1);
+	std::sort(keys.begin(), keys.end(), std::greater<>{});
+
+	BT_PROFILE("OpenAddressingPairCache::processAllOverlappingPairs");
+	for (auto key : keys)
+	{
+		auto const [t, slot] = locate(key);
+		if (!t)
+			continue;
+		auto& pair = *getPair(t->slots[slot]);
+		if (callback->processOverlap(pair))
+			removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1, dispatcher);
+	}
+}
+
+inline btBroadphasePair* OpenAddressingPairCache::findPair(btBroadphaseProxy* proxy0, btBroadphaseProxy* proxy1)
+{
+	auto const [t, slot] = locate(make_pair_key(proxy0, proxy1));
+	return t ? getPair(t->slots[slot]) : nullptr;
+}
+
+inline bool OpenAddressingPairCache::hasDeferredRemoval()
+{
+	return false;
+}
+
+inline void OpenAddressingPairCache::setInternalGhostPairCallback(btOverlappingPairCallback* callback)
+{
+	ghostPairCallback = callback;
+}
+
+inline void OpenAddressingPairCache::sortOverlappingPairs(btDispatcher*)
+{
+	// ASY͎c܂ܕבւāA\Ȃ
+	pairArray.quickSort(btBroadphasePairSortPredicate());
+	rebuildTable();
+}
+
+inline void OpenAddressingPairCache::setGrainSize(int size) noexcept
+{
+	grainSize = std::max(size, 1);
+}
+
+inline std::size_t OpenAddressingPairCache::getTableSize() const noexcept
+{
+	return table.size;
+}
+
+inline bool OpenAddressingPairCache::isResizing() const noexcept
+{
+	return !previousTables.empty();
+}
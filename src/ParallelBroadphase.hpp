@@ -0,0 +1,679 @@
+#pragma once
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include"OpenAddressingPairCache.hpp"
+#include<algorithm>
+#include<cstdint>
+#include<span>
+#include<utility>
+#include<vector>
+
+// setAabbsɂ܂Ƃ߂ēnAABB
+struct BroadphaseAabb
+{
+	btBroadphaseProxy* proxy = nullptr;
+	btVector3 aabbMin{ 0,0,0 };
+	btVector3 aabbMax{ 0,0,0 };
+};
+
+struct ParallelBroadphaseCounter
+{
+	// ؂g݂ȂɗtL̐
+	std::uint64_t refitNum{};
+	// t𔲂đ}Ȃ
+	std::uint64_t reinsertNum{};
+	// yAT𕪂^XN̐
+	std::uint64_t taskNum{};
+	// yÂA܂LbVɂȂ
+	std::uint64_t newPairNum{};
+};
+
+// AABB̍XVƃyATɂbtDbvtBroadphase
+// setAabbsł́At͑̐ςL邾ɂāAȇ̐ς𕔕؂ƂɕɌvZȂ
+// ؂̌`Ȃ悤ɁAt[reinsertPercent̗̊t͍܂Œʂ}Ȃ
+// yAcalculateOverlappingPairsŖ؂ǂ𕔕؂̑gɕĕɒT
+// ^XN̓̕Xbhɂ炸A^XN̏ɃLbVɑ̂Ōʂ͌I
+// LbVOpenAddressingPairCacheȂAyAƂȂyA܂Ƃ߂đ
+// ^XNXPW[Ȃ1XbhœƂ
+class ParallelDbvtBroadphase : public btDbvtBroadphase
+{
+public:
+	using NodePair = std::pair<btDbvtNode const*, btDbvtNode const*>;
+	using ProxyPair = OpenAddressingPairCache::ProxyPair;
+
+private:
+	enum class UpdateType : std::uint8_t
+	{
+		// t̑̐ςɎ܂Ă
+		Keep,
+		// t̑̐ςL
+		Refit,
+		// ؂甲đ}Ȃ
+		Reinsert,
+	};
+
+	struct Update
+	{
+		UpdateType type = UpdateType::Keep;
+		btDbvtVolume volume{};
+	};
+
+	std::vector<Update> updates{};
+	std::size_t reinsertCursor{};
+
+	// ̐ςvZȂ؂̍ƁȀ̐
+	std::vector<btDbvtNode*> refitRoots{};
+	std::vector<btDbvtNode*> refitTopNodes{};
+
+	std::vector<NodePair> tasks{};
+	std::vector<std::vector<ProxyPair>> taskPairs{};
+	// LbVɂ̂܂߂dȂ̐
+	std::vector<int> taskOverlapNums{};
+
+	// OpenAddressingPairCachełȂnullptr
+	OpenAddressingPairCache* openPairCache = nullptr;
+	std::vector<ProxyPair> batchPairs{};
+	std::vector<std::uint8_t> cleanupFlags{};
+
+	int grainSize = 16;
+	int reinsertPercent = 5;
+	std::size_t taskNum = 256;
+
+	ParallelBroadphaseCounter counter{};
+
+public:
+	ParallelDbvtBroadphase(btOverlappingPairCache* pairCache = nullptr);
+	virtual ~ParallelDbvtBroadphase() = default;
+	ParallelDbvtBroadphase(ParallelDbvtBroadphase const&) = delete;
+	ParallelDbvtBroadphase& operator=(ParallelDbvtBroadphase const&) = delete;
+
+	// setAabbɌĂԂ̂ƓʂɂȂ
+	void setAabbs(std::span<BroadphaseAabb const> aabbs);
+
+	void calculateOverlappingPairs(btDispatcher* dispatcher) override;
+
+	void setGrainSize(int size) noexcept;
+	// 0Ȃ؂g݂ȂȂA100ȂsetAabbƓS}Ȃ
+	void setReinsertPercent(int percent) noexcept;
+	// yAT悻̐̃^XNɕ
+	void setTaskNum(std::size_t num) noexcept;
+
+	ParallelBroadphaseCounter const& getCounter() const noexcept;
+
+	// ɑ}ȂẗʒuAWorldSnapshotŕۑĖ߂
+	std::size_t getReinsertCursor() const noexcept;
+	void setReinsertCursor(std::size_t cursor) noexcept;
+
+private:
+	void refit();
+	void collideParallel();
+	// btDbvtBroadphase::collidȇ|Ɠ̃yAɒׂāAdȂȂȂ̂
+	void cleanupPairs(btDispatcher* dispatcher);
+};
+
+// ؂̑gnodePair1ioutɐς
+// btDbvt::collideTTƓA߂ǂȂqǂ̑gAdȂĂΎqƂ̑g
+// dȂĂʂ̗tǂȂfalse
+bool split_node_pair(ParallelDbvtBroadphase::NodePair const& nodePair, std::vector<ParallelDbvtBroadphase::NodePair>& out);
+
+// updateAabbsAABB̌vZɂāAParallelDbvtBroadphaseɂ܂Ƃ߂ēn
+// u[htF[YParallelDbvtBroadphasełȂbtCollisionWorldƓ
+class ParallelBroadphaseWorldMt : public btDiscreteDynamicsWorldMt
+{
+	enum class AabbState : std::uint8_t
+	{
+		Skip,
+		Update,
+		// 傫̂Ŏ~߂
+		Overflow,
+	};
+
+	std::vector<BroadphaseAabb> aabbs{};
+	std::vector<AabbState> aabbStates{};
+	std::vector<BroadphaseAabb> updatedAabbs{};
+
+	int grainSize = 64;
+
+public:
+	ParallelBroadphaseWorldMt(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btConstraintSolverPoolMt* solverPool,
+		btConstraintSolver* constraintSolverMt, btCollisionConfiguration* collisionConfiguration);
+	virtual ~ParallelBroadphaseWorldMt() = default;
+	ParallelBroadphaseWorldMt(ParallelBroadphaseWorldMt const&) = delete;
+	ParallelBroadphaseWorldMt& operator=(ParallelBroadphaseWorldMt const&) = delete;
+
+	void updateAabbs() override;
+
+	void setAabbGrainSize(int size) noexcept;
+};
+
+
+//
+// ȉA
+//
+
+
+inline ParallelDbvtBroadphase::ParallelDbvtBroadphase(btOverlappingPairCache* pairCache)
+	: btDbvtBroadphase(pairCache)
+	, openPairCache{ dynamic_cast<OpenAddressingPairCache*>(m_paircache) }
+{
+	// setAabb̒ł̓yATAcalculateOverlappingPairsł܂Ƃ߂ĒT
+	m_deferedcollide = true;
+}
+
+inline void ParallelDbvtBroadphase::setAabbs(std::span<BroadphaseAabb const> aabbs)
+{
+	auto const num = static_cast<int>(aabbs.size());
+	updates.resize(aabbs.size());
+
+	// ؂ɂ͐G炸ɁAǂXV邩߂
+	auto const classify = [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			auto const proxy = static_cast<btDbvtProxy*>(aabbs[i].proxy);
+			auto& update = updates[i];
+			update.volume = btDbvtVolume::FromMM(aabbs[i].aabbMin, aabbs[i].aabbMax);
+
+			if (proxy->stage == STAGECOUNT || !Intersect(proxy->leaf->volume, update.volume)) {
+				update.type = UpdateType::Reinsert;
+				continue;
+			}
+			if (proxy->leaf->volume.Contain(update.volume)) {
+				update.type = UpdateType::Keep;
+				continue;
+			}
+
+			// btDbvtBroadphase::setAabbƓ\xƃ}[WōL
+			btVector3 const delta = aabbs[i].aabbMin - proxy->m_aabbMin;
+			btVector3 velocity = ((proxy->m_aabbMax - proxy->m_aabbMin) / 2) * m_prediction;
+			for (int axis = 0; axis < 3; axis++)
+				if (delta[axis] < 0) velocity[axis] = -velocity[axis];
+			update.volume.Expand(btVector3(gDbvtMargin, gDbvtMargin, gDbvtMargin));
+			update.volume.SignedExpand(velocity);
+			update.type = UpdateType::Refit;
+		}
+	};
+
+	if (btGetTaskScheduler() && num > grainSize)
+	{
+		struct ClassifyBody : public btIParallelForBody
+		{
+			decltype(classify) const& f;
+			ClassifyBody(decltype(classify) const& f) : f{ f } {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		} body{ classify };
+		btParallelFor(0, num, grainSize, body);
+	}
+	else
+	{
+		classify(0, num);
+	}
+
+	// }Ȃt߂āAXe[W̕tւƈꏏ1XbhŔf
+	auto reinsertQuota = aabbs.empty() ? std::size_t{ 0 } : aabbs.size() * static_cast<std::size_t>(reinsertPercent) / 100;
+	if (reinsertCursor >= aabbs.size())
+		reinsertCursor = 0;
+
+	bool refitted = false;
+	for (std::size_t n = 0; n < aabbs.size(); n++)
+	{
+		// Õt[̑񂵂āAt΂}ȂȂ悤ɂ
+		auto const i = (reinsertCursor + n) % aabbs.size();
+		auto const proxy = static_cast<btDbvtProxy*>(aabbs[i].proxy);
+		auto& update = updates[i];
+
+		if (update.type == UpdateType::Refit && reinsertQuota > 0) {
+			update.type = UpdateType::Reinsert;
+			reinsertQuota--;
+		}
+
+		switch (update.type)
+		{
+		case UpdateType::Keep:
+			break;
+
+		case UpdateType::Refit:
+			proxy->leaf->volume = update.volume;
+			++m_updates_done;
+			counter.refitNum++;
+			refitted = true;
+			m_needcleanup = true;
+			break;
+
+		case UpdateType::Reinsert:
+			if (proxy->stage == STAGECOUNT) {
+				m_sets[1].remove(proxy->leaf);
+				proxy->leaf = m_sets[0].insert(update.volume, proxy);
+			}
+			else {
+				m_sets[0].update(proxy->leaf, update.volume);
+				++m_updates_done;
+			}
+			counter.reinsertNum++;
+			m_needcleanup = true;
+			break;
+		}
+
+		if (proxy->stage != STAGECOUNT)
+			++m_updates_call;
+
+		// listremoveAlistappendƓ
+		auto& oldRoot = m_stageRoots[proxy->stage];
+		if (proxy->links[0])
+			proxy->links[0]->links[1] = proxy->links[1];
+		else
+			oldRoot = proxy->links[1];
+		if (proxy->links[1])
+			proxy->links[1]->links[0] = proxy->links[0];
+
+		auto& newRoot = m_stageRoots[m_stageCurrent];
+		proxy->links[0] = nullptr;
+		proxy->links[1] = newRoot;
+		if (newRoot)
+			newRoot->links[0] = proxy;
+		newRoot = proxy;
+
+		proxy->m_aabbMin = aabbs[i].aabbMin;
+		proxy->m_aabbMax = aabbs[i].aabbMax;
+		proxy->stage = m_stageCurrent;
+	}
+	reinsertCursor += aabbs.size() * static_cast<std::size_t>(reinsertPercent) / 100;
+
+	if (refitted)
+		refit();
+}
+
+inline void ParallelDbvtBroadphase::refit()
+{
+	auto& tree = m_sets[0];
+	if (!tree.m_root)
+		return;
+
+	// 畝Dŕ؂taskNum炢ɂȂ܂ŕ
+	// t͌vZȂ̂Ȃ̂Ŏ̂Ă
+	refitTopNodes.clear();
+	refitRoots.clear();
+	refitRoots.push_back(tree.m_root);
+	std::size_t head = 0;
+	while (head < refitRoots.size() && refitRoots.size() - head < taskNum)
+	{
+		auto const node = refitRoots[head++];
+		if (node->isleaf())
+			continue;
+		refitTopNodes.push_back(node);
+		refitRoots.push_back(node->childs[0]);
+		refitRoots.push_back(node->childs[1]);
+	}
+	refitRoots.erase(refitRoots.begin(), refitRoots.begin() + static_cast<std::ptrdiff_t>(head));
+
+	// ؂̒͋A肪ŎqvZ
+	auto const refitSubtrees = [&](int begin, int end) {
+		btAlignedObjectArray<std::pair<btDbvtNode*, bool>> stack{};
+		for (int i = begin; i < end; i++)
+		{
+			stack.push_back({ refitRoots[i], false });
+			while (stack.size() > 0)
+			{
+				auto const [node, visited] = stack[stack.size() - 1];
+				stack.pop_back();
+				if (node->isleaf())
+					continue;
+				if (visited) {
+					Merge(node->childs[0]->volume, node->childs[1]->volume, node->volume);
+					continue;
+				}
+				stack.push_back({ node, true });
+				stack.push_back({ node->childs[0], false });
+				stack.push_back({ node->childs[1], false });
+			}
+		}
+	};
+
+	auto const num = static_cast<int>(refitRoots.size());
+	if (btGetTaskScheduler() && num > 1)
+	{
+		struct RefitBody : public btIParallelForBody
+		{
+			decltype(refitSubtrees) const& f;
+			RefitBody(decltype(refitSubtrees) const& f) : f{ f } {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		} body{ refitSubtrees };
+		btParallelFor(0, num, 1, body);
+	}
+	else
+	{
+		refitSubtrees(0, num);
+	}
+
+	// ̏͐eɗ̂ŋt
+	for (auto it = refitTopNodes.rbegin(); it != refitTopNodes.rend(); ++it)
+		Merge((*it)->childs[0]->volume, (*it)->childs[1]->volume, (*it)->volume);
+}
+
+inline bool split_node_pair(ParallelDbvtBroadphase::NodePair const& nodePair, std::vector<ParallelDbvtBroadphase::NodePair>& out)
+{
+	auto const [a, b] = nodePair;
+
+	if (a == b)
+	{
+		if (a->isinternal()) {
+			out.push_back({ a->childs[0], a->childs[0] });
+			out.push_back({ a->childs[1], a->childs[1] });
+			out.push_back({ a->childs[0], a->childs[1] });
+		}
+		return true;
+	}
+
+	if (!Intersect(a->volume, b->volume))
+		return true;
+
+	if (a->isinternal() && b->isinternal()) {
+		out.push_back({ a->childs[0], b->childs[0] });
+		out.push_back({ a->childs[1], b->childs[0] });
+		out.push_back({ a->childs[0], b->childs[1] });
+		out.push_back({ a->childs[1], b->childs[1] });
+	}
+	else if (a->isinternal()) {
+		out.push_back({ a->childs[0], b });
+		out.push_back({ a->childs[1], b });
+	}
+	else if (b->isinternal()) {
+		out.push_back({ a, b->childs[0] });
+		out.push_back({ a, b->childs[1] });
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+inline void ParallelDbvtBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	// œKƃXe[ẄړbtDbvtBroadphaseɔCāA؂ǂ̒TƑ|u
+	// collideŃXe[WڂƂ|
+	auto const needCleanup = m_needcleanup || m_stageRoots[(m_stageCurrent + 1) % STAGECOUNT];
+	// collide̓Xe[WڂƎł|̂ŁA鐔0ɂđ|1񂾂ɂ
+	auto const cupdates = m_cupdates;
+	m_cupdates = 0;
+	m_newpairs = 0;
+	m_deferedcollide = false;
+	m_needcleanup = false;
+	collide(dispatcher);
+	m_deferedcollide = true;
+	m_cupdates = cupdates;
+
+	collideParallel();
+
+	if (needCleanup)
+		cleanupPairs(dispatcher);
+	m_newpairs = 1;
+
+	performDeferredRemoval(dispatcher);
+}
+
+inline void ParallelDbvtBroadphase::collideParallel()
+{
+	// Ă؂Ǝ~܂Ă؁AĂ؂ǂ
+	tasks.clear();
+	if (m_sets[0].m_root) {
+		if (m_sets[1].m_root)
+			tasks.push_back({ m_sets[0].m_root, m_sets[1].m_root });
+		tasks.push_back({ m_sets[0].m_root, m_sets[0].m_root });
+	}
+
+	// 1iāA^XN\ȐɂȂ邩ȂȂ܂ő
+	std::vector<NodePair> next{};
+	while (!tasks.empty() && tasks.size() < taskNum)
+	{
+		next.clear();
+		bool split = false;
+		for (auto const& task : tasks)
+		{
+			if (split_node_pair(task, next))
+				split = true;
+			else
+				next.push_back(task);
+		}
+		tasks.swap(next);
+		if (!split)
+			break;
+	}
+
+	if (taskPairs.size() < tasks.size())
+		taskPairs.resize(tasks.size());
+	taskOverlapNums.resize(tasks.size());
+
+	auto const findPairs = [&](int begin, int end) {
+		std::vector<NodePair> stack{};
+		for (int i = begin; i < end; i++)
+		{
+			auto& pairs = taskPairs[i];
+			pairs.clear();
+			taskOverlapNums[i] = 0;
+
+			stack.clear();
+			stack.push_back(tasks[i]);
+			while (!stack.empty())
+			{
+				auto const nodePair = stack.back();
+				stack.pop_back();
+				if (split_node_pair(nodePair, stack))
+					continue;
+
+				// btDbvtTreeColliderƓŁALbVɂ̂͑Ȃ
+				auto pa = static_cast<btDbvtProxy*>(nodePair.first->data);
+				auto pb = static_cast<btDbvtProxy*>(nodePair.second->data);
+				taskOverlapNums[i]++;
+				if (!m_paircache->findPair(pa, pb))
+					pairs.push_back({ pa, pb });
+			}
+		}
+	};
+
+	auto const num = static_cast<int>(tasks.size());
+	if (btGetTaskScheduler() && num > 1)
+	{
+		struct FindPairsBody : public btIParallelForBody
+		{
+			decltype(findPairs) const& f;
+			FindPairsBody(decltype(findPairs) const& f) : f{ f } {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		} body{ findPairs };
+		btParallelFor(0, num, 1, body);
+	}
+	else
+	{
+		findPairs(0, num);
+	}
+
+	// ^XN̏ɑ̂ŃXbhɂ炸ɂȂ
+	// collideTTƓyA1񂵂Ȃ
+	if (openPairCache)
+	{
+		batchPairs.clear();
+		for (int i = 0; i < num; i++)
+			batchPairs.insert(batchPairs.end(), taskPairs[i].begin(), taskPairs[i].end());
+		counter.newPairNum += static_cast<std::uint64_t>(openPairCache->addOverlappingPairs(batchPairs));
+	}
+	else
+	{
+		for (int i = 0; i < num; i++)
+			for (auto const& [pa, pb] : taskPairs[i])
+				if (m_paircache->addOverlappingPair(pa, pb))
+					counter.newPairNum++;
+	}
+
+	// btDbvtTreeColliderƓdȂSāA|łꂾyAȂ
+	for (int i = 0; i < num; i++)
+		m_newpairs += taskOverlapNums[i];
+
+	counter.taskNum += static_cast<std::uint64_t>(num);
+}
+
+inline void ParallelDbvtBroadphase::cleanupPairs(btDispatcher* dispatcher)
+{
+	auto& pairs = m_paircache->getOverlappingPairArray();
+	auto const pairNum = pairs.size();
+	if (pairNum == 0) {
+		m_cid = 0;
+		return;
+	}
+
+	// ȎAVdȂ̐Ŝ̊̑
+	auto const checkNum = btMin(pairNum, btMax<int>(m_newpairs, (pairNum * m_cupdates) / 100));
+	cleanupFlags.resize(static_cast<std::size_t>(checkNum));
+
+	auto const check = [&](int begin, int end) {
+		for (int i = begin; i < end; i++)
+		{
+			auto const& pair = pairs[(m_cid + i) % pairNum];
+			auto const pa = static_cast<btDbvtProxy*>(pair.m_pProxy0);
+			auto const pb = static_cast<btDbvtProxy*>(pair.m_pProxy1);
+			cleanupFlags[i] = !Intersect(pa->leaf->volume, pb->leaf->volume);
+		}
+	};
+
+	if (btGetTaskScheduler() && checkNum > grainSize * 16)
+	{
+		struct CheckBody : public btIParallelForBody
+		{
+			decltype(check) const& f;
+			CheckBody(decltype(check) const& f) : f{ f } {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		} body{ check };
+		btParallelFor(0, checkNum, grainSize * 16, body);
+	}
+	else
+	{
+		check(0, checkNum);
+	}
+
+	batchPairs.clear();
+	for (int i = 0; i < checkNum; i++)
+		if (cleanupFlags[i]) {
+			auto const& pair = pairs[(m_cid + i) % pairNum];
+			batchPairs.push_back({ pair.m_pProxy0, pair.m_pProxy1 });
+		}
+
+	if (openPairCache)
+		openPairCache->removeOverlappingPairs(batchPairs, dispatcher);
+	else
+		for (auto const& [pa, pb] : batchPairs)
+			m_paircache->removeOverlappingPair(pa, pb, dispatcher);
+
+	// btDbvtBroadphase::collideƓAĎci߂
+	auto const remainNum = pairs.size();
+	m_cid = remainNum > 0 ? (m_cid + checkNum - static_cast<int>(batchPairs.size())) % remainNum : 0;
+}
+
+inline void ParallelDbvtBroadphase::setGrainSize(int size) noexcept
+{
+	grainSize = std::max(size, 1);
+}
+
+inline void ParallelDbvtBroadphase::setReinsertPercent(int percent) noexcept
+{
+	reinsertPercent = std::clamp(percent, 0, 100);
+}
+
+inline void ParallelDbvtBroadphase::setTaskNum(std::size_t num) noexcept
+{
+	taskNum = std::max<std::size_t>(num, 1);
+}
+
+inline ParallelBroadphaseCounter const& ParallelDbvtBroadphase::getCounter() const noexcept
+{
+	return counter;
+}
+
+inline std::size_t ParallelDbvtBroadphase::getReinsertCursor() const noexcept
+{
+	return reinsertCursor;
+}
+
+inline void ParallelDbvtBroadphase::setReinsertCursor(std::size_t cursor) noexcept
+{
+	reinsertCursor = cursor;
+}
+
+
+inline ParallelBroadphaseWorldMt::ParallelBroadphaseWorldMt(btDispatcher* dispatcher, btBroadphaseInterface* pairCache, btConstraintSolverPoolMt* solverPool,
+	btConstraintSolver* constraintSolverMt, btCollisionConfiguration* collisionConfiguration)
+	: btDiscreteDynamicsWorldMt(dispatcher, pairCache, solverPool, constraintSolverMt, collisionConfiguration)
+{
+}
+
+inline void ParallelBroadphaseWorldMt::updateAabbs()
+{
+	auto const broadphase = dynamic_cast<ParallelDbvtBroadphase*>(getBroadphase());
+	if (!broadphase) {
+		btDiscreteDynamicsWorldMt::updateAabbs();
+		return;
+	}
+
+	BT_PROFILE("updateAabbs");
+
+	auto const num = m_collisionObjects.size();
+	aabbs.resize(static_cast<std::size_t>(num));
+	aabbStates.resize(static_cast<std::size_t>(num));
+
+	// btCollisionWorld::updateSingleAabbƓAsetAabb̑aabbsɏ
+	auto const computeAabbs = [&](int begin, int end) {
+		btVector3 const contactThreshold{ gContactBreakingThreshold, gContactBreakingThreshold, gContactBreakingThreshold };
+		for (int i = begin; i < end; i++)
+		{
+			auto const colObj = m_collisionObjects[i];
+			if (!m_forceUpdateAllAabbs && !colObj->isActive()) {
+				aabbStates[i] = AabbState::Skip;
+				continue;
+			}
+
+			auto& aabb = aabbs[i];
+			aabb.proxy = colObj->getBroadphaseHandle();
+			colObj->getCollisionShape()->getAabb(colObj->getWorldTransform(), aabb.aabbMin, aabb.aabbMax);
+			aabb.aabbMin -= contactThreshold;
+			aabb.aabbMax += contactThreshold;
+
+			if (getDispatchInfo().m_useContinuous && colObj->getInternalType() == btCollisionObject::CO_RIGID_BODY && !colObj->isStaticOrKinematicObject())
+			{
+				btVector3 minAabb2, maxAabb2;
+				colObj->getCollisionShape()->getAabb(colObj->getInterpolationWorldTransform(), minAabb2, maxAabb2);
+				aabb.aabbMin.setMin(minAabb2 - contactThreshold);
+				aabb.aabbMax.setMax(maxAabb2 + contactThreshold);
+			}
+
+			aabbStates[i] = colObj->isStaticObject() || (aabb.aabbMax - aabb.aabbMin).length2() < btScalar(1e12) ? AabbState::Update : AabbState::Overflow;
+		}
+	};
+
+	if (btGetTaskScheduler() && num > grainSize)
+	{
+		struct ComputeAabbsBody : public btIParallelForBody
+		{
+			decltype(computeAabbs) const& f;
+			ComputeAabbsBody(decltype(computeAabbs) const& f) : f{ f } {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		} body{ computeAabbs };
+		btParallelFor(0, num, grainSize, body);
+	}
+	else
+	{
+		computeAabbs(0, num);
+	}
+
+	updatedAabbs.clear();
+	for (int i = 0; i < num; i++)
+	{
+		if (aabbStates[i] == AabbState::Update)
+			updatedAabbs.push_back(aabbs[i]);
+		else if (aabbStates[i] == AabbState::Overflow)
+			m_collisionObjects[i]->setActivationState(DISABLE_SIMULATION);
+	}
+
+	broadphase->setAabbs(updatedAabbs);
+}
+
+inline void ParallelBroadphaseWorldMt::setAabbGrainSize(int size) noexcept
+{
+	grainSize = std::max(size, 1);
+}
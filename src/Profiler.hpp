@@ -0,0 +1,601 @@
+#pragma once
+#include"../external/bullet3/src/LinearMath/btQuickprof.h"
+#include<algorithm>
+#include<array>
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+#include<cstring>
+#include<memory>
+#include<mutex>
+#include<ostream>
+#include<span>
+#include<string>
+#include<string_view>
+#include<utility>
+#include<vector>
+
+// BT_PROFILE̋ԂXbhƂɋL^vt@C
+// btSetCustomEnterProfileZoneFuncōނ̂ŁACProfileManager(BT_ENABLE_PROFILE)͂Ȃ
+// ̊Ԃ͗LɂO̊֐ɖ߂̂ŁABT_PROFILẼRXg͌Ɠ
+
+enum class ProfileEventType : std::uint8_t
+{
+	Zone,
+	Counter,
+};
+
+struct ProfileEvent
+{
+	// BT_PROFILEƓ񃊃ez肵āA|C^
+	char const* name = nullptr;
+	// vt@CẴimbACounterbeging
+	std::int64_t begin{};
+	std::int64_t end{};
+	double value{};
+	std::uint32_t threadIndex{};
+	std::uint16_t depth{};
+	ProfileEventType type{};
+};
+
+// 1Xbh߂Cxg̐AcollectɈꂽ͎̂Ă
+constexpr std::size_t PROFILER_THREAD_EVENT_NUM = 1 << 15;
+// [][͋L^Ȃ
+constexpr std::size_t PROFILER_MAX_DEPTH = 64;
+
+// vZX1Aget_profilerŎo
+class Profiler
+{
+	// ̂͂̃XbhAǂނ̂collectĂԃXbhȂ̂ŃbN͂Ȃ
+	struct ThreadBuffer
+	{
+		std::uint32_t threadIndex{};
+		std::string name{};
+
+		std::unique_ptr<ProfileEvent[]> events{};
+		alignas(64) std::atomic<std::uint64_t> writeNum{};
+		alignas(64) std::atomic<std::uint64_t> readNum{};
+		std::atomic<std::uint64_t> droppedNum{};
+
+		// JĂ][ÃXbhGȂ
+		std::array<std::pair<char const*, std::int64_t>, PROFILER_MAX_DEPTH> stack{};
+		std::size_t depth{};
+		// setEnabledŗLɂȂAȂ][̂Ă
+		std::uint64_t generation{};
+	};
+
+	std::chrono::steady_clock::time_point epoch{ std::chrono::steady_clock::now() };
+
+	std::atomic<bool> enabled = false;
+	std::atomic<std::uint64_t> generation{};
+	// LɂOBT_PROFILE̊֐Aɂ߂
+	btEnterProfileZoneFunc* previousEnterZone = nullptr;
+	btLeaveProfileZoneFunc* previousLeaveZone = nullptr;
+
+	// threads̒ǉcollect̊Ԃ
+	mutable std::mutex threadMutex{};
+	std::vector<std::unique_ptr<ThreadBuffer>> threads{};
+
+	ThreadBuffer& getThreadBuffer();
+	void push(ThreadBuffer& buffer, ProfileEvent const& event) noexcept;
+
+public:
+	Profiler() = default;
+	virtual ~Profiler();
+	Profiler(Profiler const&) = delete;
+	Profiler& operator=(Profiler const&) = delete;
+	Profiler(Profiler&&) = delete;
+	Profiler& operator=(Profiler&&) = delete;
+
+	// LɂBT_PROFILE̊֐ւAɂ邩󂷂ƍւO̊֐ɖ߂
+	// Bullet̊֐|C^̂܂܏̂ŁAstepSimulation̊OŌĂ
+	void setEnabled(bool enabled);
+	bool isEnabled() const noexcept;
+
+	// Ă񂾃Xbh̖OAg[Xɏo
+	void setThreadName(char const* name);
+
+	void enterZone(char const* name);
+	void leaveZone();
+	void counter(char const* name, double value);
+
+	// vt@CẴimb
+	std::int64_t now() const noexcept;
+
+	// ܂Cxgeventšɑ
+	// oCxg̐Ԃ
+	std::size_t collect(std::vector<ProfileEvent>& events);
+
+	// Ď̂ĂCxg̐
+	std::uint64_t getDroppedEventNum() const;
+	// threadIndex̏
+	std::vector<std::string> getThreadNames() const;
+};
+
+Profiler& get_profiler();
+
+// LȂƂ][J
+class ProfileScope
+{
+	bool active = false;
+
+public:
+	ProfileScope(char const* name);
+	virtual ~ProfileScope();
+	ProfileScope(ProfileScope const&) = delete;
+	ProfileScope& operator=(ProfileScope const&) = delete;
+	ProfileScope(ProfileScope&&) = delete;
+	ProfileScope& operator=(ProfileScope&&) = delete;
+};
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+// PRACTICE_BULLET_NO_PROFILER`ƃAv̌v
+#ifdef PRACTICE_BULLET_NO_PROFILER
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNTER(name, value)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILER_CONCAT(profileScope, __LINE__){ name }
+#define PROFILE_COUNTER(name, value) do { if (get_profiler().isEnabled()) get_profiler().counter(name, static_cast<double>(value)); } while (false)
+#endif
+
+struct ProfileZone
+{
+	char const* label;
+	char const* name;
+};
+
+// Xebv̓ƂČBullet̃][AMt̃[hłO
+constexpr ProfileZone STEP_PROFILE_ZONES[] = {
+	{ "step", "internalSingleStepSimulation" },
+	{ "aabb", "updateAabbs" },
+	{ "broadphase", "calculateOverlappingPairs" },
+	{ "narrowphase", "dispatchAllCollisionPairs" },
+	{ "solver", "solveConstraints" },
+	{ "integrate", "integrateTransforms" },
+};
+
+// t[̎ԂƁAw肵][̃t[Ƃ̍v
+struct ProfileFrame
+{
+	double frameTime{};
+	// ~bAProfileFrameHistoryzoneNames̏
+	std::vector<double> zoneTimes{};
+};
+
+// ߂frameCapacityt[c
+// Lv`̓Cxgcăg[Xɏo
+class ProfileFrameHistory
+{
+	std::vector<char const*> zoneNames{};
+
+	std::vector<ProfileFrame> frames{};
+	std::size_t frameCapacity{};
+	// ɏframes
+	std::size_t nextFrame{};
+	std::int64_t frameBegin{};
+
+	std::vector<ProfileEvent> events{};
+
+	bool capturing = false;
+	std::size_t maxCapturedEventNum{};
+	std::vector<ProfileEvent> capturedEvents{};
+
+public:
+	ProfileFrameHistory() = default;
+	// q̃][OȂ瑫̂ŁAqɂȂȂ][I
+	ProfileFrameHistory(std::vector<char const*> zoneNames, std::size_t frameCapacity = 120);
+	virtual ~ProfileFrameHistory() = default;
+	ProfileFrameHistory(ProfileFrameHistory const&) = delete;
+	ProfileFrameHistory& operator=(ProfileFrameHistory const&) = delete;
+	ProfileFrameHistory(ProfileFrameHistory&&) = default;
+	ProfileFrameHistory& operator=(ProfileFrameHistory&&) = default;
+
+	// t[̏IɌĂсA܂CxgWv
+	void endFrame(Profiler& profiler);
+
+	std::span<char const* const> getZoneNames() const noexcept;
+	std::size_t getFrameNum() const noexcept;
+	// 0ԌÂ
+	ProfileFrame const& getFrame(std::size_t i) const noexcept;
+	// cĂt[̕ρA~b
+	double getAverageFrameTime() const noexcept;
+	double getAverageZoneTime(std::size_t zoneIndex) const noexcept;
+
+	// maxEventNum𒴂~܂
+	void startCapture(std::size_t maxEventNum = 1 << 20);
+	void stopCapture() noexcept;
+	bool isCapturing() const noexcept;
+	std::span<ProfileEvent const> getCapturedEvents() const noexcept;
+};
+
+// STEP_PROFILE_ZONESnameׂ
+std::vector<char const*> get_step_profile_zone_names();
+
+// Chrome(chrome://tracing)Perfettoœǂ߂JSON
+// threadNamesProfiler::getThreadNames
+void write_chrome_trace(std::ostream& out, std::span<ProfileEvent const> events, std::span<std::string const> threadNames);
+
+
+//
+// ȉA
+//
+
+
+inline void profiler_enter_zone(char const* name)
+{
+	get_profiler().enterZone(name);
+}
+
+inline void profiler_leave_zone()
+{
+	get_profiler().leaveZone();
+}
+
+inline Profiler& get_profiler()
+{
+	static Profiler profiler{};
+	return profiler;
+}
+
+inline Profiler::~Profiler()
+{
+	setEnabled(false);
+}
+
+inline void Profiler::setEnabled(bool e)
+{
+	if (e == enabled.load())
+		return;
+
+	if (e)
+	{
+		// ̊ԂɊJ܂܂ɂȂ][̂Ă
+		generation++;
+		enabled = true;
+		previousEnterZone = btGetCurrentEnterProfileZoneFunc();
+		previousLeaveZone = btGetCurrentLeaveProfileZoneFunc();
+		btSetCustomEnterProfileZoneFunc(profiler_enter_zone);
+		btSetCustomLeaveProfileZoneFunc(profiler_leave_zone);
+	}
+	else
+	{
+		// CProfileManagerȂǁAOɕtĂ֐ɖ߂
+		btSetCustomEnterProfileZoneFunc(previousEnterZone);
+		btSetCustomLeaveProfileZoneFunc(previousLeaveZone);
+		previousEnterZone = nullptr;
+		previousLeaveZone = nullptr;
+		enabled = false;
+	}
+}
+
+inline bool Profiler::isEnabled() const noexcept
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+inline Profiler::ThreadBuffer& Profiler::getThreadBuffer()
+{
+	// ŏ1񂾂bNēo^
+	thread_local std::pair<Profiler const*, ThreadBuffer*> cache{};
+	if (cache.first == this)
+		return *cache.second;
+
+	std::lock_guard lock{ threadMutex };
+	auto& added = threads.emplace_back(std::make_unique<ThreadBuffer>());
+	added->threadIndex = static_cast<std::uint32_t>(threads.size() - 1);
+	added->name = "thread " + std::to_string(added->threadIndex);
+	added->events = std::make_unique<ProfileEvent[]>(PROFILER_THREAD_EVENT_NUM);
+	cache = { this, added.get() };
+
+	return *added;
+}
+
+inline void Profiler::push(ThreadBuffer& buffer, ProfileEvent const& event) noexcept
+{
+	auto const writeNum = buffer.writeNum.load(std::memory_order_relaxed);
+	if (writeNum - buffer.readNum.load(std::memory_order_acquire) >= PROFILER_THREAD_EVENT_NUM) {
+		buffer.droppedNum.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer.events[writeNum % PROFILER_THREAD_EVENT_NUM] = event;
+	buffer.writeNum.store(writeNum + 1, std::memory_order_release);
+}
+
+inline void Profiler::setThreadName(char const* name)
+{
+	auto& buffer = getThreadBuffer();
+	std::lock_guard lock{ threadMutex };
+	buffer.name = name;
+}
+
+inline void Profiler::enterZone(char const* name)
+{
+	auto& buffer = getThreadBuffer();
+
+	auto const currentGeneration = generation.load(std::memory_order_relaxed);
+	if (buffer.generation != currentGeneration) {
+		buffer.generation = currentGeneration;
+		buffer.depth = 0;
+	}
+
+	if (buffer.depth < PROFILER_MAX_DEPTH)
+		buffer.stack[buffer.depth] = { name, now() };
+	buffer.depth++;
+}
+
+inline void Profiler::leaveZone()
+{
+	auto const end = now();
+	auto& buffer = getThreadBuffer();
+
+	// LɂOɊJ][
+	if (buffer.generation != generation.load(std::memory_order_relaxed) || buffer.depth == 0)
+		return;
+
+	buffer.depth--;
+	if (buffer.depth >= PROFILER_MAX_DEPTH)
+		return;
+
+	auto const [name, begin] = buffer.stack[buffer.depth];
+	push(buffer, {
+		.name = name,
+		.begin = begin,
+		.end = end,
+		.threadIndex = buffer.threadIndex,
+		.depth = static_cast<std::uint16_t>(buffer.depth),
+		.type = ProfileEventType::Zone,
+	});
+}
+
+inline void Profiler::counter(char const* name, double value)
+{
+	auto& buffer = getThreadBuffer();
+	auto const time = now();
+	push(buffer, {
+		.name = name,
+		.begin = time,
+		.end = time,
+		.value = value,
+		.threadIndex = buffer.threadIndex,
+		.type = ProfileEventType::Counter,
+	});
+}
+
+inline std::int64_t Profiler::now() const noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+inline std::size_t Profiler::collect(std::vector<ProfileEvent>& events)
+{
+	std::lock_guard lock{ threadMutex };
+
+	std::size_t num = 0;
+	for (auto& buffer : threads)
+	{
+		auto const writeNum = buffer->writeNum.load(std::memory_order_acquire);
+		auto const readNum = buffer->readNum.load(std::memory_order_relaxed);
+		for (auto i = readNum; i != writeNum; i++)
+			events.push_back(buffer->events[i % PROFILER_THREAD_EVENT_NUM]);
+		num += static_cast<std::size_t>(writeNum - readNum);
+		// ǂݏIꏊXbhɒm点
+		buffer->readNum.store(writeNum, std::memory_order_release);
+	}
+
+	return num;
+}
+
+inline std::uint64_t Profiler::getDroppedEventNum() const
+{
+	std::lock_guard lock{ threadMutex };
+
+	std::uint64_t num = 0;
+	for (auto const& buffer : threads)
+		num += buffer->droppedNum.load(std::memory_order_relaxed);
+	return num;
+}
+
+inline std::vector<std::string> Profiler::getThreadNames() const
+{
+	std::lock_guard lock{ threadMutex };
+
+	std::vector<std::string> names{};
+	for (auto const& buffer : threads)
+		names.push_back(buffer->name);
+	return names;
+}
+
+
+inline ProfileScope::ProfileScope(char const* name)
+	: active{ get_profiler().isEnabled() }
+{
+	if (active)
+		get_profiler().enterZone(name);
+}
+
+inline ProfileScope::~ProfileScope()
+{
+	if (active)
+		get_profiler().leaveZone();
+}
+
+
+inline ProfileFrameHistory::ProfileFrameHistory(std::vector<char const*> zoneNames, std::size_t frameCapacity)
+	: zoneNames{ std::move(zoneNames) }
+	, frameCapacity{ std::max<std::size_t>(frameCapacity, 1) }
+{
+}
+
+inline void ProfileFrameHistory::endFrame(Profiler& profiler)
+{
+	auto const frameEnd = profiler.now();
+
+	events.clear();
+	profiler.collect(events);
+
+	ProfileFrame frame{
+		.frameTime = static_cast<double>(frameEnd - frameBegin) * 1e-6,
+		.zoneTimes = std::vector<double>(zoneNames.size()),
+	};
+	frameBegin = frameEnd;
+
+	for (auto const& event : events)
+	{
+		if (event.type != ProfileEventType::Zone)
+			continue;
+
+		for (std::size_t i = 0; i < zoneNames.size(); i++)
+		{
+			if (event.name == zoneNames[i] || std::strcmp(event.name, zoneNames[i]) == 0) {
+				frame.zoneTimes[i] += static_cast<double>(event.end - event.begin) * 1e-6;
+				break;
+			}
+		}
+	}
+
+	if (frames.size() < frameCapacity)
+		frames.push_back(std::move(frame));
+	else
+		frames[nextFrame] = std::move(frame);
+	nextFrame = (nextFrame + 1) % frameCapacity;
+
+	if (capturing)
+	{
+		auto const num = std::min(events.size(), maxCapturedEventNum - capturedEvents.size());
+		capturedEvents.insert(capturedEvents.end(), events.begin(), events.begin() + num);
+		if (capturedEvents.size() >= maxCapturedEventNum)
+			capturing = false;
+	}
+}
+
+inline std::span<char const* const> ProfileFrameHistory::getZoneNames() const noexcept
+{
+	return zoneNames;
+}
+
+inline std::size_t ProfileFrameHistory::getFrameNum() const noexcept
+{
+	return frames.size();
+}
+
+inline ProfileFrame const& ProfileFrameHistory::getFrame(std::size_t i) const noexcept
+{
+	// ܂܂łnextFrameȂ̂0
+	return frames.size() < frameCapacity ? frames[i] : frames[(nextFrame + i) % frameCapacity];
+}
+
+inline double ProfileFrameHistory::getAverageFrameTime() const noexcept
+{
+	double sum = 0.;
+	for (auto const& frame : frames)
+		sum += frame.frameTime;
+	return frames.empty() ? 0. : sum / static_cast<double>(frames.size());
+}
+
+inline double ProfileFrameHistory::getAverageZoneTime(std::size_t zoneIndex) const noexcept
+{
+	double sum = 0.;
+	for (auto const& frame : frames)
+		sum += frame.zoneTimes[zoneIndex];
+	return frames.empty() ? 0. : sum / static_cast<double>(frames.size());
+}
+
+inline void ProfileFrameHistory::startCapture(std::size_t maxEventNum)
+{
+	capturedEvents.clear();
+	maxCapturedEventNum = maxEventNum;
+	capturing = true;
+}
+
+inline void ProfileFrameHistory::stopCapture() noexcept
+{
+	capturing = false;
+}
+
+inline bool ProfileFrameHistory::isCapturing() const noexcept
+{
+	return capturing;
+}
+
+inline std::span<ProfileEvent const> ProfileFrameHistory::getCapturedEvents() const noexcept
+{
+	return capturedEvents;
+}
+
+
+inline std::vector<char const*> get_step_profile_zone_names()
+{
+	std::vector<char const*> names{};
+	for (auto const& zone : STEP_PROFILE_ZONES)
+		names.push_back(zone.name);
+	return names;
+}
+
+
+inline void write_chrome_trace_string(std::ostream& out, std::string_view str)
+{
+	out << '"';
+	for (auto c : str)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			out << ' ';
+		else
+			out << c;
+	}
+	out << '"';
+}
+
+inline void write_chrome_trace(std::ostream& out, std::span<ProfileEvent const> events, std::span<std::string const> threadNames)
+{
+	// tsdur̓}CNbȂ̂ŏŃimb܂ŏ
+	auto writeMicroseconds = [&out](std::int64_t ns) {
+		out << ns / 1000 << '.';
+		auto const fraction = ns % 1000;
+		out << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+	};
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+
+	bool first = true;
+	auto separator = [&] {
+		if (!first)
+			out << ",\n";
+		first = false;
+	};
+
+	for (std::size_t i = 0; i < threadNames.size(); i++)
+	{
+		separator();
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":";
+		write_chrome_trace_string(out, threadNames[i]);
+		out << "}}";
+	}
+
+	for (auto const& event : events)
+	{
+		separator();
+		out << "{\"name\":";
+		write_chrome_trace_string(out, event.name);
+		if (event.type == ProfileEventType::Zone)
+		{
+			out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadIndex << ",\"ts\":";
+			writeMicroseconds(event.begin);
+			out << ",\"dur\":";
+			writeMicroseconds(event.end - event.begin);
+			out << "}";
+		}
+		else
+		{
+			out << ",\"ph\":\"C\",\"pid\":1,\"tid\":" << event.threadIndex << ",\"ts\":";
+			writeMicroseconds(event.begin);
+			out << ",\"args\":{\"value\":" << event.value << "}}";
+		}
+	}
+
+	out << "\n]}\n";
+}
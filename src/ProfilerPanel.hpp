@@ -0,0 +1,67 @@
+#pragma once
+#include"../external/imgui/imgui.h"
+#include"Profiler.hpp"
+#include<algorithm>
+#include<cstdio>
+#include<fstream>
+#include<span>
+#include<vector>
+
+// ProfileFrameHistory̒߂̃t[̓ImGuiŕ\
+// labelshistoryzoneNamesƓ
+// Lv`CxgtraceFileNameɏo
+void draw_profiler_panel(Profiler& profiler, ProfileFrameHistory& history, std::span<char const* const> labels, char const* traceFileName);
+
+
+//
+// ȉA
+//
+
+
+inline void draw_profiler_panel(Profiler& profiler, ProfileFrameHistory& history, std::span<char const* const> labels, char const* traceFileName)
+{
+	if (!ImGui::CollapsingHeader("profiler"))
+		return;
+
+	bool enabled = profiler.isEnabled();
+	if (ImGui::Checkbox("enable", &enabled))
+		profiler.setEnabled(enabled);
+
+	if (!enabled)
+		return;
+
+	ImGui::Text("frame %.2f ms (last %zu frames), dropped events %llu",
+		history.getAverageFrameTime(), history.getFrameNum(), static_cast<unsigned long long>(profiler.getDroppedEventNum()));
+
+	std::vector<float> values(history.getFrameNum());
+	for (std::size_t zone = 0; zone < history.getZoneNames().size() && zone < labels.size(); zone++)
+	{
+		float maxValue = 0.f;
+		for (std::size_t i = 0; i < values.size(); i++) {
+			values[i] = static_cast<float>(history.getFrame(i).zoneTimes[zone]);
+			maxValue = std::max(maxValue, values[i]);
+		}
+
+		char overlay[64];
+		std::snprintf(overlay, sizeof(overlay), "%.3f ms (max %.3f)", history.getAverageZoneTime(zone), maxValue);
+		ImGui::PlotLines(labels[zone], values.data(), static_cast<int>(values.size()), 0, overlay, 0.f, maxValue * 1.2f + 0.001f, ImVec2(0.f, 40.f));
+	}
+
+	if (history.isCapturing())
+	{
+		ImGui::Text("capturing %zu events", history.getCapturedEvents().size());
+		if (ImGui::Button("write trace"))
+		{
+			history.stopCapture();
+			std::ofstream file{ traceFileName };
+			write_chrome_trace(file, history.getCapturedEvents(), profiler.getThreadNames());
+		}
+	}
+	else
+	{
+		if (ImGui::Button("capture trace"))
+			history.startCapture();
+		ImGui::SameLine();
+		ImGui::Text("writes %s", traceFileName);
+	}
+}
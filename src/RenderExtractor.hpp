@@ -0,0 +1,483 @@
+#pragma once
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include"FixedStepper.hpp"
+#include<algorithm>
+#include<array>
+#include<atomic>
+#include<cstdint>
+#include<memory>
+#include<vector>
+
+// `悷`̎
+enum class RenderShapeType
+{
+	Box,
+	Sphere,
+	Capsule,
+};
+
+constexpr std::size_t RENDER_SHAPE_TYPE_NUM = 3;
+
+// Ăяopӂ鏑ݐ
+// transformsXMMATRIXƓsxNgp̍s
+// capacity𒴂CX^X͏Ȃ
+struct RenderInstanceArrays
+{
+	std::array<float, 16>* transforms = nullptr;
+	std::array<float, 3>* colors = nullptr;
+	std::size_t capacity{};
+};
+
+// ̂̎pƐF`Ƃ̔zɒڏo
+// btIDebugDrawoRAO񂩂ςĂȂ̂͏Ȃ
+// ݐ̒g͎extract܂ŌĂяoێĂ
+// InterpolatedMotionState̍̂͐Q珑I_ŊOAN܂ŒׂȂ
+// QĂ鍄̂𒼐ړN肵ÃXebv̑OɌɂinvalidateĂ
+class RenderExtractor
+{
+	struct Record
+	{
+		btRigidBody const* body = nullptr;
+		InterpolatedMotionState const* motionState = nullptr;
+
+		RenderShapeType type{};
+		std::size_t slot{};
+
+		// `̑傫Ǝ̌AsxNgp3x3
+		std::array<float, 9> local{};
+
+		// ŌɏƂ̏
+		bool dirty = true;
+		int activationState{};
+		int updateRevision{};
+		std::uint64_t updatedStepNum{};
+		bool interpolating = false;
+		btScalar alpha{};
+		btTransform transform{};
+
+		// QĂ̂activeRecordsO
+		bool parked = false;
+	};
+
+	btCollisionWorld const* world = nullptr;
+
+	// 
+	std::vector<Record> dynamicRecords{};
+	// NĂ铮̂dynamicRecordsł̈ʒuAextract̂тɒׂ
+	std::vector<std::size_t> activeRecords{};
+	// QĂ̂NInterpolatedMotionState::setWorldTransformς
+	std::shared_ptr<std::vector<std::size_t>> wokenRecords = std::make_shared<std::vector<std::size_t>>();
+	// ÓIȍ́AupdateRevisionςƂ
+	std::vector<Record> staticRecords{};
+
+	std::array<std::size_t, RENDER_SHAPE_TYPE_NUM> instanceNums{};
+	std::array<RenderInstanceArrays, RENDER_SHAPE_TYPE_NUM> outputs{};
+
+	int grainSize = 64;
+
+	// true
+	bool extractRecord(Record& record) const;
+	// IĐQĂȂparkedɂāANm点Ă炤
+	void parkIfSleeping(Record& record, std::size_t index) const;
+	// ÔׂactiveRecordsɖ߂
+	void unparkAll();
+
+public:
+	RenderExtractor() = default;
+	virtual ~RenderExtractor() = default;
+	RenderExtractor(RenderExtractor const&) = delete;
+	RenderExtractor& operator=(RenderExtractor const&) = delete;
+	RenderExtractor(RenderExtractor&&) = default;
+	RenderExtractor& operator=(RenderExtractor&&) = default;
+
+	// ̂ǉA폜ĂтȂ
+	// AAJvZȊǑ`CF_DISABLE_VISUALIZE_OBJECT͖̍̂
+	void rebuild(btCollisionWorld const* world);
+
+	std::size_t getInstanceNum(RenderShapeType type) const noexcept;
+
+	// ݐςƂ̎ނׂ̍̂͂ďȂ
+	void setOutput(RenderShapeType type, RenderInstanceArrays const& arrays);
+
+	// extractłׂĂ̍̂Ȃ
+	void invalidate();
+
+	// 1^XN̍̂̐
+	void setGrainSize(int size) noexcept;
+
+	// NĂ铮̂btSetTaskSchedulerŐݒ肵^XNXPW[ŕɏ
+	// CX^X̐Ԃ
+	std::size_t extract();
+
+	// extractŒׂ铮̂̐
+	std::size_t getActiveNum() const noexcept;
+};
+
+// `Ƃ̍sADebugDrawXMMATRIX|ĂƂƓɂȂ
+// ΉĂȂ`Ȃfalse
+bool compute_render_local_matrix(btCollisionShape const* shape, RenderShapeType& type, std::array<float, 9>& local);
+
+// local|Ăpŉ񂵂Ĉړ
+void write_render_transform(std::array<float, 9> const& local, btTransform const& transform, std::array<float, 16>& out) noexcept;
+
+// debugDrawWorldƓԂƂ̐F
+btVector3 get_render_color(btCollisionObject const* obj);
+// getCustomDebugColorȂAL^ĐƂp
+btVector3 get_render_color(int activationState);
+
+
+//
+// ȉA
+//
+
+
+inline void RenderExtractor::rebuild(btCollisionWorld const* w)
+{
+	world = w;
+	dynamicRecords.clear();
+	activeRecords.clear();
+	staticRecords.clear();
+	instanceNums = {};
+
+	// O̍̂ς܂Ȃ悤ɍȂ
+	wokenRecords = std::make_shared<std::vector<std::size_t>>();
+
+	for (int i = 0; i < world->getNumCollisionObjects(); i++)
+	{
+		auto body = btRigidBody::upcast(world->getCollisionObjectArray()[i]);
+		if (!body || (body->getCollisionFlags() & btCollisionObject::CF_DISABLE_VISUALIZE_OBJECT))
+			continue;
+
+		Record record{ .body = body };
+		if (!compute_render_local_matrix(body->getCollisionShape(), record.type, record.local))
+			continue;
+
+		record.slot = instanceNums[static_cast<std::size_t>(record.type)]++;
+		// ÓIȍ͕̂ԂȂ
+		if (body->isStaticObject())
+			staticRecords.push_back(record);
+		else {
+			record.motionState = dynamic_cast<InterpolatedMotionState const*>(body->getMotionState());
+			activeRecords.push_back(dynamicRecords.size());
+			dynamicRecords.push_back(record);
+		}
+	}
+}
+
+inline std::size_t RenderExtractor::getInstanceNum(RenderShapeType type) const noexcept
+{
+	return instanceNums[static_cast<std::size_t>(type)];
+}
+
+inline void RenderExtractor::setOutput(RenderShapeType type, RenderInstanceArrays const& arrays)
+{
+	auto& output = outputs[static_cast<std::size_t>(type)];
+	if (output.transforms == arrays.transforms && output.colors == arrays.colors && output.capacity == arrays.capacity)
+		return;
+
+	output = arrays;
+	for (auto records : { &dynamicRecords, &staticRecords })
+	{
+		for (auto& record : *records)
+		{
+			if (record.type == type)
+				record.dirty = true;
+		}
+	}
+	unparkAll();
+}
+
+inline void RenderExtractor::invalidate()
+{
+	for (auto& record : dynamicRecords)
+		record.dirty = true;
+	for (auto& record : staticRecords)
+		record.dirty = true;
+	unparkAll();
+}
+
+inline void RenderExtractor::unparkAll()
+{
+	for (std::size_t i = 0; i < dynamicRecords.size(); i++)
+	{
+		if (dynamicRecords[i].parked)
+		{
+			dynamicRecords[i].parked = false;
+			activeRecords.push_back(i);
+		}
+	}
+}
+
+inline void RenderExtractor::setGrainSize(int size) noexcept
+{
+	grainSize = std::max(size, 1);
+}
+
+inline bool RenderExtractor::extractRecord(Record& record) const
+{
+	auto const& output = outputs[static_cast<std::size_t>(record.type)];
+	if (record.slot >= output.capacity)
+		return false;
+
+	auto const body = record.body;
+	auto const activationState = body->getActivationState();
+	auto const updateRevision = body->getUpdateRevisionInternal();
+
+	// setWorldTransform⊈Ԃ̕ω͎pׂȂĂ
+	bool dirty = record.dirty || activationState != record.activationState || updateRevision != record.updateRevision;
+
+	btTransform transform{};
+	if (record.motionState)
+	{
+		// ŌɏƂ畨̃XebvœAԂ̊ς
+		auto const updatedStepNum = record.motionState->getUpdatedStepNum();
+		auto const interpolating = record.motionState->isInterpolating();
+		auto const alpha = record.motionState->getAlpha();
+		dirty = dirty || interpolating != record.interpolating || updatedStepNum != record.updatedStepNum || (interpolating && alpha != record.alpha);
+		if (!dirty)
+			return false;
+
+		transform = record.motionState->getRenderTransform();
+		record.updatedStepNum = updatedStepNum;
+		record.interpolating = interpolating;
+		record.alpha = alpha;
+	}
+	else if (body->isStaticObject())
+	{
+		if (!dirty)
+			return false;
+		transform = body->getWorldTransform();
+	}
+	else
+	{
+		// QĂ鍄͓̂Ȃ
+		if (!dirty && (activationState == ISLAND_SLEEPING || activationState == DISABLE_SIMULATION))
+			return false;
+
+		transform = body->getWorldTransform();
+		if (!dirty && transform == record.transform)
+			return false;
+	}
+
+	write_render_transform(record.local, transform, output.transforms[record.slot]);
+
+	auto const color = get_render_color(body);
+	output.colors[record.slot] = { static_cast<float>(color.x()), static_cast<float>(color.y()), static_cast<float>(color.z()) };
+
+	record.dirty = false;
+	record.activationState = activationState;
+	record.updateRevision = updateRevision;
+	record.transform = transform;
+
+	return true;
+}
+
+inline void RenderExtractor::parkIfSleeping(Record& record, std::size_t index) const
+{
+	// NƂsetWorldTransformłȂ̂ŁAInterpolatedMotionState̍̂O
+	// Ll}eBbNȍ̂setWorldTransformĂ΂Ȃ
+	if (!record.motionState || record.dirty || record.interpolating || record.body->isKinematicObject())
+		return;
+
+	auto const activationState = record.body->getActivationState();
+	if (activationState != record.activationState || (activationState != ISLAND_SLEEPING && activationState != DISABLE_SIMULATION))
+		return;
+
+	record.parked = true;
+	record.motionState->notifyOnWake(wokenRecords, index);
+}
+
+inline std::size_t RenderExtractor::extract()
+{
+	BT_PROFILE("RenderExtractor::extract");
+
+	struct ExtractBody : public btIParallelForBody
+	{
+		RenderExtractor* extractor;
+		mutable std::atomic<std::size_t> writtenNum{};
+
+		ExtractBody(RenderExtractor* extractor)
+			: extractor{ extractor }
+		{
+		}
+
+		void forLoop(int iBegin, int iEnd) const override
+		{
+			std::size_t num = 0;
+			for (auto i = static_cast<std::size_t>(iBegin); i < static_cast<std::size_t>(iEnd); i++)
+			{
+				auto const index = extractor->activeRecords[i];
+				auto& record = extractor->dynamicRecords[index];
+				if (extractor->extractRecord(record))
+					num++;
+				extractor->parkIfSleeping(record, index);
+			}
+			writtenNum += num;
+		}
+	};
+
+	// QĂԂɋN̂߂
+	for (auto const index : *wokenRecords)
+	{
+		auto& record = dynamicRecords[index];
+		if (record.parked)
+		{
+			record.parked = false;
+			activeRecords.push_back(index);
+		}
+	}
+	wokenRecords->clear();
+
+	// RecordƂɏꏊႤ̂ŁARecord𕪂΃bN͂Ȃ
+	// ^XNXPW[΂̃Xbhŏ
+	ExtractBody body{ this };
+	if (btGetTaskScheduler())
+		btParallelFor(0, static_cast<int>(activeRecords.size()), grainSize, body);
+	else
+		body.forLoop(0, static_cast<int>(activeRecords.size()));
+
+	// Q܂܏Î͋N܂ŒׂȂ
+	std::erase_if(activeRecords, [this](std::size_t index) { return dynamicRecords[index].parked; });
+
+	// ÓIȍ̂͂قƂǏȂ̂1XbhŒׂ
+	std::size_t staticWrittenNum = 0;
+	for (auto& record : staticRecords)
+	{
+		if (extractRecord(record))
+			staticWrittenNum++;
+	}
+
+	return body.writtenNum + staticWrittenNum;
+}
+
+inline std::size_t RenderExtractor::getActiveNum() const noexcept
+{
+	return activeRecords.size();
+}
+
+
+inline bool compute_render_local_matrix(btCollisionShape const* shape, RenderShapeType& type, std::array<float, 9>& local)
+{
+	switch (shape->getShapeType())
+	{
+	case BOX_SHAPE_PROXYTYPE:
+	{
+		auto const halfExtents = static_cast<btBoxShape const*>(shape)->getHalfExtentsWithMargin();
+		type = RenderShapeType::Box;
+		local = {
+			static_cast<float>(halfExtents.x() * 2.), 0.f, 0.f,
+			0.f, static_cast<float>(halfExtents.y() * 2.), 0.f,
+			0.f, 0.f, static_cast<float>(halfExtents.z() * 2.),
+		};
+		return true;
+	}
+	case SPHERE_SHAPE_PROXYTYPE:
+	{
+		// a̓}[WɓĂ
+		auto const radius = static_cast<float>(shape->getMargin());
+		type = RenderShapeType::Sphere;
+		local = {
+			radius, 0.f, 0.f,
+			0.f, radius, 0.f,
+			0.f, 0.f, radius,
+		};
+		return true;
+	}
+	case CAPSULE_SHAPE_PROXYTYPE:
+	{
+		auto const capsule = static_cast<btCapsuleShape const*>(shape);
+		auto const radius = static_cast<float>(capsule->getRadius());
+		auto const height = (1.f + static_cast<float>(capsule->getHalfHeight())) / 2.f;
+		type = RenderShapeType::Capsule;
+
+		// g債Ă烂fyupAxisɌ
+		switch (capsule->getUpAxis())
+		{
+		// XMMatrixRotationZ(XM_PIDIV2)
+		case 0:
+			local = {
+				0.f, radius, 0.f,
+				-height, 0.f, 0.f,
+				0.f, 0.f, radius,
+			};
+			break;
+		// XMMatrixRotationX(XM_PIDIV2)
+		case 2:
+			local = {
+				radius, 0.f, 0.f,
+				0.f, 0.f, height,
+				0.f, -radius, 0.f,
+			};
+			break;
+		default:
+			local = {
+				radius, 0.f, 0.f,
+				0.f, height, 0.f,
+				0.f, 0.f, radius,
+			};
+			break;
+		}
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+inline void write_render_transform(std::array<float, 9> const& local, btTransform const& transform, std::array<float, 16>& out) noexcept
+{
+	// sxNgp̉]sbasis̓]u
+	auto const& basis = transform.getBasis();
+	for (std::size_t r = 0; r < 3; r++)
+	{
+		for (std::size_t c = 0; c < 3; c++)
+		{
+			out[r * 4 + c] = static_cast<float>(
+				local[r * 3] * basis[c][0] + local[r * 3 + 1] * basis[c][1] + local[r * 3 + 2] * basis[c][2]);
+		}
+		out[r * 4 + 3] = 0.f;
+	}
+
+	auto const& origin = transform.getOrigin();
+	out[12] = static_cast<float>(origin.x());
+	out[13] = static_cast<float>(origin.y());
+	out[14] = static_cast<float>(origin.z());
+	out[15] = 1.f;
+}
+
+inline btVector3 get_render_color(btCollisionObject const* obj)
+{
+	auto color = get_render_color(obj->getActivationState());
+	obj->getCustomDebugColor(color);
+
+	return color;
+}
+
+inline btVector3 get_render_color(int activationState)
+{
+	btIDebugDraw::DefaultColors const defaultColors{};
+
+	btVector3 color(btScalar(0.4), btScalar(0.4), btScalar(0.4));
+	switch (activationState)
+	{
+	case ACTIVE_TAG:
+		color = defaultColors.m_activeObject;
+		break;
+	case ISLAND_SLEEPING:
+		color = defaultColors.m_deactivatedObject;
+		break;
+	case WANTS_DEACTIVATION:
+		color = defaultColors.m_wantsDeactivationObject;
+		break;
+	case DISABLE_DEACTIVATION:
+		color = defaultColors.m_disabledDeactivationObject;
+		break;
+	case DISABLE_SIMULATION:
+		color = defaultColors.m_disabledSimulationObject;
+		break;
+	}
+
+	return color;
+}
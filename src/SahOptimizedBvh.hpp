@@ -0,0 +1,700 @@
+#pragma once
+#include"MappedFile.hpp"
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include<algorithm>
+#include<array>
+#include<cstdint>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<limits>
+#include<memory>
+#include<stdexcept>
+#include<string>
+#include<vector>
+
+// rSAHŕIbtOptimizedBvh
+// m[h̕тbtQuantizedBvh::buildTreeƓŁA̎q͎̃m[hAE̎q͍̕؂̌ɒu
+// Op`̐畔؂̃m[h܂̂ŁÂق1XbhŕƁAc̕؂ʁX̃^XNō
+// ̓XbhɂȂ̂ŁAł؂XbhɂȂ
+
+constexpr int SAH_BVH_BIN_NUM = 16;
+// [Ƃ͏dS̒ŕA΂čċA[ȂȂ悤
+constexpr int SAH_BVH_MAX_DEPTH = 48;
+
+struct SahBvhConfig
+{
+	// Op`ȉ̕؂1̃^XNō
+	int taskPrimitiveNum = 4096;
+	// Op`葽͈͂̓r̐btParallelForŕ
+	int binGrainSize = 16384;
+};
+
+// SahOptimizedBvh̃m[ĥ܂܂̃CAEgŕۑLbV
+// wb_Am[hA؂̃wb_̏ɕׂ̂ŁA}bvbtQuantizedBvh̔zƂĂ̂܂܎g
+// |C^Ȃ̂ŁAbtQuantizedBvh::deSerializeInPlacê悤ȓǂ񂾌͖̏
+constexpr char BVH_CACHE_MAGIC[8] = { 'P', 'B', 'B', 'V', 'H', '\0', '\0', '\0' };
+constexpr std::uint32_t BVH_CACHE_VERSION = 1;
+constexpr char const* BVH_CACHE_EXTENSION = ".bvhcache";
+
+struct BvhCacheHeader
+{
+	char magic[8]{};
+	std::uint32_t version{};
+	// btQuantizedBvhNodebtBvhSubtreeInfõoCg
+	std::uint32_t nodeStride{};
+	std::uint32_t subtreeStride{};
+	std::uint32_t traversalMode{};
+
+	// ؂bṼnbV
+	std::uint64_t meshHash{};
+
+	std::uint32_t nodeNum{};
+	std::uint32_t subtreeNum{};
+
+	// ʎq̒lAbtScalarɂ炸doubleŎ
+	std::array<double, 3> bvhAabbMin{};
+	std::array<double, 3> bvhAabbMax{};
+	std::array<double, 3> quantization{};
+};
+// m[h16oCgEɗ悤
+static_assert(sizeof(BvhCacheHeader) == 112);
+
+class SahOptimizedBvh : public btOptimizedBvh
+{
+	// ʎqWAABB
+	struct Bounds
+	{
+		std::array<unsigned short, 3> min{ 0xffff, 0xffff, 0xffff };
+		std::array<unsigned short, 3> max{ 0, 0, 0 };
+	};
+
+	// t[begin, end)̎Op`ƁA̕؂̍̃m[h
+	struct Range
+	{
+		int begin{};
+		int end{};
+		int nodeIndex{};
+		int depth{};
+		Bounds bounds{};
+	};
+
+	struct Bin
+	{
+		int count{};
+		Bounds bounds{};
+	};
+	// Ƃ̃r
+	using Bins = std::array<std::array<Bin, SAH_BVH_BIN_NUM>, 3>;
+
+	SahBvhConfig config{};
+	// ʎq̒ɖ߂Aʐςׂ邾Ȃ̂floatŎ
+	std::array<float, 3> extentScale{};
+
+	// open_bvh_cacheŊJƂ̃t@CAm[h͂̃w
+	MappedFile file{};
+	bool mapped = false;
+
+	static void mergeBounds(Bounds& bounds, Bounds const& other) noexcept;
+	static void mergeBounds(Bounds& bounds, btQuantizedBvhNode const& node) noexcept;
+	// dS͗ʎqAABBmin+maxŁÂ܂܈
+	static int computeCentroid(btQuantizedBvhNode const& node, int axis) noexcept;
+	// Op`Ȃ͈͂̓r炷
+	static int computeBinNum(Range const& range) noexcept;
+	// r̓m[hAABB𓙕AdS͈̔͂߂ȂԂ񑬂
+	// r̐AABB̒Ŋ́A0̎0
+	static std::array<float, 3> computeBinScale(Bounds const& bounds, int binNum) noexcept;
+	static int computeBin(Bounds const& bounds, std::array<float, 3> const& scale, int binNum, int axis, int centroid) noexcept;
+	float computeHalfArea(Bounds const& bounds) const noexcept;
+
+	// num傫^XNXPW[btParallelForŕAȂ΂̂܂܌Ă
+	template<typename F>
+	static void parallelFor(int num, int grainSize, F const& f);
+
+	Range makeRange(int begin, int end, int nodeIndex, int depth) const;
+	void binRange(Range const& range, int begin, int end, Bins& bins) const;
+	void setInternalNode(Range const& range);
+	// SAHŏɂȂr̋ڂŕăm[hAparallelȂrɂ
+	std::array<Range, 2> splitRange(Range const& range, bool parallel);
+	// AABBԒŁAdS̒ŕ
+	std::array<Range, 2> splitMedian(Range const& range);
+	void buildSubtree(Range const& range);
+	// btQuantizedBvh::buildTreeƓɕ؂̃wb_
+	void collectSubtreeHeaders(int nodeIndex);
+
+public:
+	SahOptimizedBvh() = default;
+	// open_bvh_cacheŒׂt@CAm[h̓Rs[}bvg
+	SahOptimizedBvh(MappedFile&& file);
+	virtual ~SahOptimizedBvh() = default;
+	SahOptimizedBvh(SahOptimizedBvh const&) = delete;
+	SahOptimizedBvh& operator=(SahOptimizedBvh const&) = delete;
+
+	// btOptimizedBvh::buildŗʎqƂƓt؂
+	// t1̎Op`Ȃ̂ŁAbtBvhTriangleMeshShape::setOptimizedBvhł̂܂܎g
+	void buildSah(btStridingMeshInterface* triangles, btVector3 const& bvhAabbMin, btVector3 const& bvhAabbMax, SahBvhConfig const& config = {});
+
+	// }bvt@C̃m[hgĂ邩
+	// ǂݎp̃Ȃ̂refitrefitPartial͌ĂׂȂ
+	bool isMapped() const noexcept;
+
+	int getNodeNum() const noexcept;
+	btQuantizedBvhNode const* getNodes() const noexcept;
+	int getSubtreeHeaderNum() const noexcept;
+	btBvhSubtreeInfo const* getSubtreeHeaders() const noexcept;
+	btVector3 const& getBvhAabbMin() const noexcept;
+	btVector3 const& getBvhAabbMax() const noexcept;
+	btVector3 const& getQuantization() const noexcept;
+	btTraversalMode getTraversalMode() const noexcept;
+};
+
+// wb_ĂȂAbVƍĂ邩𒲂ׂ
+// btBvhTriangleMeshShape|C^Ŏ̂Ńq[vɍAĂȂnullptr
+std::unique_ptr<SahOptimizedBvh> open_bvh_cache(char const* cacheFileName, std::uint64_t meshHash);
+
+// ꎞt@CɏĂûŁAr܂ł̃LbVǂނƂ͂Ȃ
+// Ȃstd::runtime_error
+void write_bvh_cache(char const* cacheFileName, SahOptimizedBvh const& bvh, std::uint64_t meshHash);
+
+
+//
+// ȉA
+//
+
+
+inline SahOptimizedBvh::SahOptimizedBvh(MappedFile&& f)
+	: file{ std::move(f) }
+	, mapped{ true }
+{
+	auto const header = reinterpret_cast<BvhCacheHeader const*>(file.getData());
+	// Ȃ̂œǂݎp̃̂܂ܔzɂ
+	auto const nodePtr = const_cast<btQuantizedBvhNode*>(reinterpret_cast<btQuantizedBvhNode const*>(file.getData() + sizeof(BvhCacheHeader)));
+	auto const subtreePtr = const_cast<btBvhSubtreeInfo*>(reinterpret_cast<btBvhSubtreeInfo const*>(nodePtr + header->nodeNum));
+	auto const nodeNum = static_cast<int>(header->nodeNum);
+	auto const subtreeNum = static_cast<int>(header->subtreeNum);
+
+	m_bvhAabbMin.setValue(btScalar(header->bvhAabbMin[0]), btScalar(header->bvhAabbMin[1]), btScalar(header->bvhAabbMin[2]));
+	m_bvhAabbMax.setValue(btScalar(header->bvhAabbMax[0]), btScalar(header->bvhAabbMax[1]), btScalar(header->bvhAabbMax[2]));
+	m_bvhQuantization.setValue(btScalar(header->quantization[0]), btScalar(header->quantization[1]), btScalar(header->quantization[2]));
+	m_useQuantization = true;
+	m_traversalMode = static_cast<btTraversalMode>(header->traversalMode);
+
+	m_quantizedContiguousNodes.initializeFromBuffer(nodePtr, nodeNum, nodeNum);
+	m_SubtreeHeaders.initializeFromBuffer(subtreePtr, subtreeNum, subtreeNum);
+	m_subtreeHeaderCount = subtreeNum;
+	m_curNodeIndex = nodeNum;
+}
+
+inline void SahOptimizedBvh::mergeBounds(Bounds& bounds, Bounds const& other) noexcept
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		bounds.min[axis] = std::min(bounds.min[axis], other.min[axis]);
+		bounds.max[axis] = std::max(bounds.max[axis], other.max[axis]);
+	}
+}
+
+inline void SahOptimizedBvh::mergeBounds(Bounds& bounds, btQuantizedBvhNode const& node) noexcept
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		bounds.min[axis] = std::min(bounds.min[axis], node.m_quantizedAabbMin[axis]);
+		bounds.max[axis] = std::max(bounds.max[axis], node.m_quantizedAabbMax[axis]);
+	}
+}
+
+inline int SahOptimizedBvh::computeCentroid(btQuantizedBvhNode const& node, int axis) noexcept
+{
+	return static_cast<int>(node.m_quantizedAabbMin[axis]) + static_cast<int>(node.m_quantizedAabbMax[axis]);
+}
+
+inline int SahOptimizedBvh::computeBinNum(Range const& range) noexcept
+{
+	return std::min(SAH_BVH_BIN_NUM, range.end - range.begin);
+}
+
+inline std::array<float, 3> SahOptimizedBvh::computeBinScale(Bounds const& bounds, int binNum) noexcept
+{
+	std::array<float, 3> scale{};
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (bounds.max[axis] > bounds.min[axis])
+			scale[axis] = static_cast<float>(binNum) / static_cast<float>(2 * (bounds.max[axis] - bounds.min[axis]));
+	}
+	return scale;
+}
+
+inline int SahOptimizedBvh::computeBin(Bounds const& bounds, std::array<float, 3> const& scale, int binNum, int axis, int centroid) noexcept
+{
+	auto const bin = static_cast<int>(static_cast<float>(centroid - 2 * bounds.min[axis]) * scale[axis]);
+	return std::min(bin, binNum - 1);
+}
+
+// ʎqW͎ƂɏkڂႤ̂ŁA̒ɖ߂Ėʐςׂ
+inline float SahOptimizedBvh::computeHalfArea(Bounds const& bounds) const noexcept
+{
+	std::array<float, 3> extent{};
+	for (int axis = 0; axis < 3; axis++)
+		extent[axis] = static_cast<float>(bounds.max[axis] - bounds.min[axis]) * extentScale[axis];
+	return extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0];
+}
+
+template<typename F>
+inline void SahOptimizedBvh::parallelFor(int num, int grainSize, F const& f)
+{
+	if (btGetTaskScheduler() && num > grainSize)
+	{
+		struct LoopBody : public btIParallelForBody
+		{
+			F const& f;
+			LoopBody(F const& f) : f{ f } {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		} body{ f };
+		btParallelFor(0, num, grainSize, body);
+	}
+	else if (num > 0)
+	{
+		f(0, num);
+	}
+}
+
+inline SahOptimizedBvh::Range SahOptimizedBvh::makeRange(int begin, int end, int nodeIndex, int depth) const
+{
+	Range range{ begin, end, nodeIndex, depth };
+	for (int i = begin; i < end; i++)
+	{
+		mergeBounds(range.bounds, m_quantizedLeafNodes[i]);
+	}
+	return range;
+}
+
+inline void SahOptimizedBvh::binRange(Range const& range, int begin, int end, Bins& bins) const
+{
+	auto const binNum = computeBinNum(range);
+	auto const scale = computeBinScale(range.bounds, binNum);
+	for (int i = begin; i < end; i++)
+	{
+		auto const& leaf = m_quantizedLeafNodes[i];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (scale[axis] == 0)
+				continue;
+
+			auto& bin = bins[axis][computeBin(range.bounds, scale, binNum, axis, computeCentroid(leaf, axis))];
+			bin.count++;
+			mergeBounds(bin.bounds, leaf);
+		}
+	}
+}
+
+inline void SahOptimizedBvh::setInternalNode(Range const& range)
+{
+	auto& node = m_quantizedContiguousNodes[range.nodeIndex];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		node.m_quantizedAabbMin[axis] = range.bounds.min[axis];
+		node.m_quantizedAabbMax[axis] = range.bounds.max[axis];
+	}
+	// ؂̃m[h𕉂ɂ̂GXP[vCfbNX
+	node.m_escapeIndexOrTriangleIndex = -(2 * (range.end - range.begin) - 1);
+}
+
+inline std::array<SahOptimizedBvh::Range, 2> SahOptimizedBvh::splitRange(Range const& range, bool parallel)
+{
+	if (range.depth >= SAH_BVH_MAX_DEPTH)
+		return splitMedian(range);
+
+	auto const count = range.end - range.begin;
+	auto const binNum = computeBinNum(range);
+	auto const scale = computeBinScale(range.bounds, binNum);
+
+	Bins bins{};
+	auto const chunkNum = (count + config.binGrainSize - 1) / config.binGrainSize;
+	if (parallel && chunkNum > 1)
+	{
+		// 򂲂ƂɃrĂ瑫Amin/maxȂ̂őɂȂ
+		std::vector<Bins> chunkBins(static_cast<std::size_t>(chunkNum));
+		parallelFor(chunkNum, 1, [&](int begin, int end) {
+			for (int chunk = begin; chunk < end; chunk++)
+			{
+				auto const first = range.begin + chunk * config.binGrainSize;
+				binRange(range, first, std::min(first + config.binGrainSize, range.end), chunkBins[chunk]);
+			}
+		});
+		for (auto const& chunk : chunkBins)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int b = 0; b < SAH_BVH_BIN_NUM; b++)
+				{
+					bins[axis][b].count += chunk[axis][b].count;
+					mergeBounds(bins[axis][b].bounds, chunk[axis][b].bounds);
+				}
+			}
+		}
+	}
+	else
+	{
+		binRange(range, range.begin, range.end, bins);
+	}
+
+	// b̍̓r0..bAE̓rb+1..
+	auto bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	int bestBin = -1;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (scale[axis] == 0)
+			continue;
+
+		std::array<float, SAH_BVH_BIN_NUM> rightCost;
+		std::array<int, SAH_BVH_BIN_NUM> rightCount;
+		Bounds right{};
+		int rightNum = 0;
+		for (int b = binNum - 1; b > 0; b--)
+		{
+			mergeBounds(right, bins[axis][b].bounds);
+			rightNum += bins[axis][b].count;
+			rightCount[b - 1] = rightNum;
+			rightCost[b - 1] = rightNum > 0 ? computeHalfArea(right) * static_cast<float>(rightNum) : 0.f;
+		}
+
+		Bounds left{};
+		int leftNum = 0;
+		for (int b = 0; b < binNum - 1; b++)
+		{
+			mergeBounds(left, bins[axis][b].bounds);
+			leftNum += bins[axis][b].count;
+			if (leftNum == 0 || rightCount[b] == 0)
+				continue;
+
+			auto const cost = computeHalfArea(left) * static_cast<float>(leftNum) + rightCost[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	// dSׂērɓƂ
+	if (bestAxis < 0)
+		return splitMedian(range);
+
+	// t̃m[ĥ܂ܕבւ
+	auto const first = &m_quantizedLeafNodes[0] + range.begin;
+	auto const middle = std::partition(first, &m_quantizedLeafNodes[0] + range.end, [&](btQuantizedBvhNode const& leaf) {
+		return computeBin(range.bounds, scale, binNum, bestAxis, computeCentroid(leaf, bestAxis)) <= bestBin;
+	});
+	auto const mid = range.begin + static_cast<int>(middle - first);
+
+	setInternalNode(range);
+
+	// qAABB̓r𑫂΋܂
+	Range left{ range.begin, mid, range.nodeIndex + 1, range.depth + 1 };
+	Range right{ mid, range.end, range.nodeIndex + 2 * (mid - range.begin), range.depth + 1 };
+	for (int b = 0; b < binNum; b++)
+	{
+		auto& child = b <= bestBin ? left : right;
+		mergeBounds(child.bounds, bins[bestAxis][b].bounds);
+	}
+	return { left, right };
+}
+
+inline std::array<SahOptimizedBvh::Range, 2> SahOptimizedBvh::splitMedian(Range const& range)
+{
+	int axis = 0;
+	for (int a = 1; a < 3; a++)
+	{
+		if (range.bounds.max[a] - range.bounds.min[a] > range.bounds.max[axis] - range.bounds.min[axis])
+			axis = a;
+	}
+
+	auto const mid = range.begin + (range.end - range.begin) / 2;
+	auto const leaves = &m_quantizedLeafNodes[0];
+	std::nth_element(leaves + range.begin, leaves + mid, leaves + range.end, [&](btQuantizedBvhNode const& a, btQuantizedBvhNode const& b) {
+		auto const ca = computeCentroid(a, axis), cb = computeCentroid(b, axis);
+		return ca < cb || (ca == cb && a.m_escapeIndexOrTriangleIndex < b.m_escapeIndexOrTriangleIndex);
+	});
+
+	setInternalNode(range);
+
+	return {
+		makeRange(range.begin, mid, range.nodeIndex + 1, range.depth + 1),
+		makeRange(mid, range.end, range.nodeIndex + 2 * (mid - range.begin), range.depth + 1),
+	};
+}
+
+inline void SahOptimizedBvh::buildSubtree(Range const& range)
+{
+	if (range.end - range.begin == 1)
+	{
+		m_quantizedContiguousNodes[range.nodeIndex] = m_quantizedLeafNodes[range.begin];
+		return;
+	}
+	// 2ȂǂĂ
+	if (range.end - range.begin == 2)
+	{
+		setInternalNode(range);
+		m_quantizedContiguousNodes[range.nodeIndex + 1] = m_quantizedLeafNodes[range.begin];
+		m_quantizedContiguousNodes[range.nodeIndex + 2] = m_quantizedLeafNodes[range.begin + 1];
+		return;
+	}
+
+	auto const children = splitRange(range, false);
+	buildSubtree(children[0]);
+	buildSubtree(children[1]);
+}
+
+inline void SahOptimizedBvh::collectSubtreeHeaders(int nodeIndex)
+{
+	auto const& node = m_quantizedContiguousNodes[nodeIndex];
+	// 菬؂̓wb_Ȃ
+	if (node.isLeafNode() || node.getEscapeIndex() * static_cast<int>(sizeof(btQuantizedBvhNode)) <= MAX_SUBTREE_SIZE_IN_BYTES)
+		return;
+
+	auto const leftIndex = nodeIndex + 1;
+	auto const& left = m_quantizedContiguousNodes[leftIndex];
+	auto const rightIndex = leftIndex + (left.isLeafNode() ? 1 : left.getEscapeIndex());
+
+	collectSubtreeHeaders(leftIndex);
+	collectSubtreeHeaders(rightIndex);
+	updateSubtreeHeaders(leftIndex, rightIndex);
+}
+
+inline void SahOptimizedBvh::buildSah(btStridingMeshInterface* triangles, btVector3 const& bvhAabbMin, btVector3 const& bvhAabbMax, SahBvhConfig const& c)
+{
+	BT_PROFILE("SahOptimizedBvh::buildSah");
+
+	config = c;
+	config.taskPrimitiveNum = std::max(config.taskPrimitiveNum, 1);
+	config.binGrainSize = std::max(config.binGrainSize, 1);
+
+	// }bvt@C蒼Ƃ́Azt@COĂ玝
+	m_quantizedContiguousNodes.clear();
+	m_SubtreeHeaders.clear();
+	m_quantizedLeafNodes.clear();
+	file = MappedFile{};
+	mapped = false;
+
+	setQuantizationValues(bvhAabbMin, bvhAabbMax);
+	for (int axis = 0; axis < 3; axis++)
+		extentScale[axis] = static_cast<float>(btScalar(1) / m_bvhQuantization[axis]);
+
+	// btOptimizedBvh::buildQuantizedNodeTriangleCallbackƓt
+	struct LeafCallback : public btInternalTriangleIndexCallback
+	{
+		SahOptimizedBvh& bvh;
+		LeafCallback(SahOptimizedBvh& bvh) : bvh{ bvh } {}
+
+		void internalProcessTriangleIndex(btVector3* triangle, int partId, int triangleIndex) override
+		{
+			btAssert(partId < (1 << MAX_NUM_PARTS_IN_BITS));
+			btAssert(triangleIndex < (1 << (31 - MAX_NUM_PARTS_IN_BITS)));
+			btAssert(triangleIndex >= 0);
+
+			btVector3 aabbMin = triangle[0];
+			btVector3 aabbMax = triangle[0];
+			aabbMin.setMin(triangle[1]);
+			aabbMax.setMax(triangle[1]);
+			aabbMin.setMin(triangle[2]);
+			aabbMax.setMax(triangle[2]);
+
+			// ݂̖͏L
+			constexpr btScalar MIN_AABB_DIMENSION = btScalar(0.002);
+			constexpr btScalar MIN_AABB_HALF_DIMENSION = btScalar(0.001);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (aabbMax[axis] - aabbMin[axis] < MIN_AABB_DIMENSION)
+				{
+					aabbMax[axis] += MIN_AABB_HALF_DIMENSION;
+					aabbMin[axis] -= MIN_AABB_HALF_DIMENSION;
+				}
+			}
+
+			btQuantizedBvhNode node{};
+			bvh.quantize(&node.m_quantizedAabbMin[0], aabbMin, 0);
+			bvh.quantize(&node.m_quantizedAabbMax[0], aabbMax, 1);
+			node.m_escapeIndexOrTriangleIndex = (partId << (31 - MAX_NUM_PARTS_IN_BITS)) | triangleIndex;
+			bvh.m_quantizedLeafNodes.push_back(node);
+		}
+	} callback{ *this };
+	triangles->InternalProcessAllTriangles(&callback, m_bvhAabbMin, m_bvhAabbMax);
+
+	auto const leafNum = m_quantizedLeafNodes.size();
+	auto const nodeNum = leafNum > 0 ? 2 * leafNum - 1 : 0;
+	m_quantizedContiguousNodes.resize(nodeNum);
+	m_curNodeIndex = nodeNum;
+
+	if (leafNum > 0)
+	{
+		// Ȃ܂1XbhŕArɂ
+		std::vector<Range> tasks{};
+		std::vector<Range> stack{ makeRange(0, leafNum, 0, 0) };
+		while (!stack.empty())
+		{
+			auto const range = stack.back();
+			stack.pop_back();
+
+			if (range.end - range.begin <= config.taskPrimitiveNum)
+			{
+				tasks.push_back(range);
+				continue;
+			}
+
+			auto const children = splitRange(range, true);
+			stack.push_back(children[1]);
+			stack.push_back(children[0]);
+		}
+
+		// 傫؂n߂
+		std::stable_sort(tasks.begin(), tasks.end(), [](Range const& a, Range const& b) {
+			return a.end - a.begin > b.end - b.begin;
+		});
+		parallelFor(static_cast<int>(tasks.size()), 1, [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+				buildSubtree(tasks[i]);
+		});
+
+		collectSubtreeHeaders(0);
+	}
+
+	// ؑŜƂ͑Ŝ1̕؂ɂ
+	if (nodeNum > 0 && m_SubtreeHeaders.size() == 0)
+	{
+		auto& subtree = m_SubtreeHeaders.expand();
+		subtree.setAabbFromQuantizeNode(m_quantizedContiguousNodes[0]);
+		subtree.m_rootNodeIndex = 0;
+		subtree.m_subtreeSize = m_quantizedContiguousNodes[0].isLeafNode() ? 1 : m_quantizedContiguousNodes[0].getEscapeIndex();
+	}
+	m_subtreeHeaderCount = m_SubtreeHeaders.size();
+
+	m_quantizedLeafNodes.clear();
+}
+
+inline bool SahOptimizedBvh::isMapped() const noexcept
+{
+	return mapped;
+}
+
+inline int SahOptimizedBvh::getNodeNum() const noexcept
+{
+	return m_curNodeIndex;
+}
+
+inline btQuantizedBvhNode const* SahOptimizedBvh::getNodes() const noexcept
+{
+	return m_quantizedContiguousNodes.size() > 0 ? &m_quantizedContiguousNodes[0] : nullptr;
+}
+
+inline int SahOptimizedBvh::getSubtreeHeaderNum() const noexcept
+{
+	return m_SubtreeHeaders.size();
+}
+
+inline btBvhSubtreeInfo const* SahOptimizedBvh::getSubtreeHeaders() const noexcept
+{
+	return m_SubtreeHeaders.size() > 0 ? &m_SubtreeHeaders[0] : nullptr;
+}
+
+inline btVector3 const& SahOptimizedBvh::getBvhAabbMin() const noexcept
+{
+	return m_bvhAabbMin;
+}
+
+inline btVector3 const& SahOptimizedBvh::getBvhAabbMax() const noexcept
+{
+	return m_bvhAabbMax;
+}
+
+inline btVector3 const& SahOptimizedBvh::getQuantization() const noexcept
+{
+	return m_bvhQuantization;
+}
+
+inline btQuantizedBvh::btTraversalMode SahOptimizedBvh::getTraversalMode() const noexcept
+{
+	return m_traversalMode;
+}
+
+
+inline std::unique_ptr<SahOptimizedBvh> open_bvh_cache(char const* cacheFileName, std::uint64_t meshHash)
+{
+	std::error_code ec{};
+	if (!std::filesystem::exists(cacheFileName, ec))
+		return nullptr;
+
+	MappedFile file{};
+	try {
+		file = MappedFile{ cacheFileName };
+	}
+	catch (std::runtime_error const&) {
+		return nullptr;
+	}
+
+	if (file.getSize() < sizeof(BvhCacheHeader))
+		return nullptr;
+
+	BvhCacheHeader header{};
+	std::memcpy(&header, file.getData(), sizeof(BvhCacheHeader));
+
+	if (std::memcmp(header.magic, BVH_CACHE_MAGIC, sizeof(BVH_CACHE_MAGIC)) != 0 ||
+		header.version != BVH_CACHE_VERSION ||
+		header.nodeStride != sizeof(btQuantizedBvhNode) ||
+		header.subtreeStride != sizeof(btBvhSubtreeInfo) ||
+		header.traversalMode > btQuantizedBvh::TRAVERSAL_RECURSIVE ||
+		header.meshHash != meshHash ||
+		header.nodeNum == 0 || header.nodeNum % 2 == 0 ||
+		header.subtreeNum == 0)
+		return nullptr;
+
+	auto const expectedSize = sizeof(BvhCacheHeader) +
+		static_cast<std::uint64_t>(header.nodeNum) * header.nodeStride +
+		static_cast<std::uint64_t>(header.subtreeNum) * header.subtreeStride;
+	if (file.getSize() != expectedSize)
+		return nullptr;
+
+	// ̃GXP[vCfbNXm[hƍĂȂΉĂ
+	btQuantizedBvhNode root{};
+	std::memcpy(&root, file.getData() + sizeof(BvhCacheHeader), sizeof(root));
+	if (header.nodeNum > 1 && (root.isLeafNode() || static_cast<std::uint32_t>(root.getEscapeIndex()) != header.nodeNum))
+		return nullptr;
+
+	return std::make_unique<SahOptimizedBvh>(std::move(file));
+}
+
+inline void write_bvh_cache(char const* cacheFileName, SahOptimizedBvh const& bvh, std::uint64_t meshHash)
+{
+	if (bvh.getNodeNum() == 0)
+		throw std::runtime_error{ std::string{ "empty bvh for " } + cacheFileName };
+
+	BvhCacheHeader header{};
+	std::memcpy(header.magic, BVH_CACHE_MAGIC, sizeof(BVH_CACHE_MAGIC));
+	header.version = BVH_CACHE_VERSION;
+	header.nodeStride = sizeof(btQuantizedBvhNode);
+	header.subtreeStride = sizeof(btBvhSubtreeInfo);
+	header.traversalMode = static_cast<std::uint32_t>(bvh.getTraversalMode());
+	header.meshHash = meshHash;
+	header.nodeNum = static_cast<std::uint32_t>(bvh.getNodeNum());
+	header.subtreeNum = static_cast<std::uint32_t>(bvh.getSubtreeHeaderNum());
+	for (int axis = 0; axis < 3; axis++)
+	{
+		header.bvhAabbMin[axis] = static_cast<double>(bvh.getBvhAabbMin()[axis]);
+		header.bvhAabbMax[axis] = static_cast<double>(bvh.getBvhAabbMax()[axis]);
+		header.quantization[axis] = static_cast<double>(bvh.getQuantization()[axis]);
+	}
+
+	auto const tmpFileName = std::string{ cacheFileName } + ".tmp";
+	{
+		std::ofstream out{ tmpFileName, std::ios::binary | std::ios::trunc };
+		out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		out.write(reinterpret_cast<char const*>(bvh.getNodes()), static_cast<std::streamsize>(header.nodeNum) * header.nodeStride);
+		out.write(reinterpret_cast<char const*>(bvh.getSubtreeHeaders()), static_cast<std::streamsize>(header.subtreeNum) * header.subtreeStride);
+		if (!out)
+			throw std::runtime_error{ "failed to write " + tmpFileName };
+	}
+
+	std::filesystem::rename(tmpFileName, cacheFileName);
+}
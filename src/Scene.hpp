@@ -0,0 +1,510 @@
+#pragma once
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include"../external/bullet3/src/BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include"../external/bullet3/src/BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include"CapsuleBoxCollisionAlgorithm.hpp"
+#include"FixedStepper.hpp"
+#include"IncrementalIslandManager.hpp"
+#include"OpenAddressingPairCache.hpp"
+#include"ParallelBroadphase.hpp"
+#include"SlabAllocator.hpp"
+#include"SoaContactSolver.hpp"
+#include<algorithm>
+#include<cmath>
+#include<memory>
+#include<utility>
+#include<vector>
+
+// fixBoxɒ݂邳ꂽJvZ3̍
+struct ChainBodies
+{
+	btRigidBody* fixBox = nullptr;
+	btRigidBody* body1 = nullptr;
+	btRigidBody* body2 = nullptr;
+	btRigidBody* body3 = nullptr;
+
+	// 0Ԗڂ̍̂
+	btVector3 offset{ 0,0,0 };
+};
+
+struct SceneConfig
+{
+	std::size_t chainNum = 1;
+	// ׂԊu
+	btScalar chainSpacing = 10.;
+
+	// w肷InterpolatedMotionStateg
+	FixedStepper const* stepper = nullptr;
+
+	// falseȂJvZƔGJKAEPAŉ
+	bool capsuleBoxAlgorithm = true;
+
+	// btDiscreteDynamicsWorldMtAbtCollisionDispatcherMtAbtSequentialImpulseConstraintSolverMtg
+	bool multithread = false;
+	// 0Ȃg邾g
+	int threadNum = 0;
+
+	// btCollisionDispatcherMt1^XÑyA
+	int dispatcherGrainSize = 40;
+	// ̐̍SɂȂ܂ŃACh܂Ƃ߂1^XNŉ
+	int minimumSolverBatchSize = 128;
+	// btSequentialImpulseConstraintSolverMt1ob`̍S
+	// \oŜŋLlȂ̂ōŌɍScene̒lg
+	int solverMinBatchSize = 50;
+	int solverMaxBatchSize = 100;
+	// ParallelDbvtBroadphaseAABB̍XVƃyATɂ
+	bool parallelBroadphase = false;
+
+	// falseȂbtHashedOverlappingPairCache
+	// 1ƒx̂ŁA1Xbh̃[hłu[htF[YParallelDbvtBroadphaseɂ
+	bool openAddressingPairCache = false;
+
+	// 傫ACh̐ڐGƖCSoaContactSolverMtŉ
+	// multithreadłȂĂ1̃AChob`ɕĉ
+	bool soaContactSolver = false;
+
+	// ACh𖈃Xebv蒼AIncrementalIslandManagerŎ
+	bool incrementalIslands = false;
+
+	// }jtH[hƏՓ˃ASYAȂȂLSlabAllocator
+	// falseȂbtDefaultCollisionConfiguration4096̃v[ŁAꂽbtAlignedAlloc
+	bool slabAllocator = false;
+};
+
+// Bullet̃^XNXPW[̓vZX1Ȃ̂Ŏg܂킷
+// BT_THREADSAFEłȂnullptr
+btITaskScheduler* get_task_scheduler();
+
+// nʂƍchainNumׂV[
+// `ɂ͈ˑȂ̂headlessg
+class Scene
+{
+	std::unique_ptr<btDefaultCollisionConfiguration> collisionConfiguration{};
+	std::unique_ptr<btCollisionDispatcher> dispatcher{};
+	// slabAllocator̂ƂAdispatcher
+	SlabAllocator* manifoldAllocator = nullptr;
+	SlabAllocator* algorithmAllocator = nullptr;
+	// u[htF[YɔjAnullptrȂu[htF[Y
+	std::unique_ptr<btOverlappingPairCache> pairCache{};
+	std::unique_ptr<btBroadphaseInterface> overlappingPairCache{};
+	std::unique_ptr<btConstraintSolver> solver{};
+	std::unique_ptr<btConstraintSolverPoolMt> solverPool{};
+	std::unique_ptr<btDiscreteDynamicsWorld> dynamicsWorld{};
+
+	btAlignedObjectArray<btCollisionShape*> collisionShapes{};
+
+	std::vector<ChainBodies> chains{};
+
+	FixedStepper const* stepper = nullptr;
+
+	// ƂɃ^XNXPW[ւA󂷂ƂɑÔ̂ɖ߂
+	btITaskScheduler* previousTaskScheduler = nullptr;
+	bool taskSchedulerChanged = false;
+
+public:
+	Scene(SceneConfig const& config = {});
+	virtual ~Scene();
+	Scene(Scene const&) = delete;
+	Scene& operator=(Scene const&) = delete;
+	Scene(Scene&&) = default;
+	Scene& operator=(Scene&&) = default;
+
+	btDiscreteDynamicsWorld* getDynamicsWorld() noexcept;
+	// VOXbhȂ1
+	int getThreadNum() const noexcept;
+	ChainBodies const& getChain(std::size_t i) const noexcept;
+	std::size_t getChainNum() const noexcept;
+	// slabAllocatorłȂnullptr
+	SlabAllocator const* getManifoldAllocator() const noexcept;
+	SlabAllocator const* getAlgorithmAllocator() const noexcept;
+
+	// iԖڂ̍fixBoxA̍̌_̈ʒuɓ
+	void setFixBoxPosition(std::size_t i, btVector3 const& position);
+
+private:
+	void initializeCollisionConfiguration(SceneConfig const& config);
+	template<class Dispatcher, class... Args>
+	void initializeDispatcher(SceneConfig const& config, Args&&... args);
+	void initializeBroadphase(SceneConfig const& config, bool parallel);
+	void initializeWorld(SceneConfig const& config);
+	void initializeWorldMt(SceneConfig const& config);
+	void setTaskScheduler(btITaskScheduler* scheduler);
+	btRigidBody* addRigidBody(btCollisionShape* shape, btScalar mass, btTransform const& transform, btScalar restitution = 0.);
+	btGeneric6DofSpringConstraint* addChainConstraint(btRigidBody& bodyA, btRigidBody& bodyB, btScalar originInA, btScalar originInB);
+	ChainBodies addChain(btVector3 const& offset, btCollisionShape* fixBoxShape, btCollisionShape* capsuleShape);
+};
+
+
+//
+// ȉA
+//
+
+
+inline btITaskScheduler* get_task_scheduler()
+{
+	static std::unique_ptr<btITaskScheduler> scheduler{ btCreateDefaultTaskScheduler() };
+	return scheduler.get();
+}
+
+inline Scene::Scene(SceneConfig const& config)
+	: stepper{ config.stepper }
+{
+	if (config.multithread && get_task_scheduler())
+		initializeWorldMt(config);
+	else
+		initializeWorld(config);
+
+	dynamicsWorld->setGravity(btVector3(0, -9.8, 0));
+
+	auto const chainNum = std::max<std::size_t>(config.chainNum, 1);
+	auto const chainSpacing = config.chainSpacing;
+
+	// x-zʏɐ`ɂȂ悤ɕׂ
+	auto const gridWidth = static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(chainNum))));
+
+	//the ground is a cube of side 100 at position y = -56.
+	//the sphere will hit it at y = -6, with center at -5
+	{
+		// ׂnʂL
+		auto const halfExtent = std::max(btScalar(50.), btScalar(gridWidth) * chainSpacing / 2 + chainSpacing);
+		btCollisionShape* groundShape = new btBoxShape(btVector3(halfExtent, btScalar(50.), halfExtent));
+		collisionShapes.push_back(groundShape);
+
+		auto const center = btScalar(gridWidth - 1) * chainSpacing / 2;
+
+		btTransform groundTransform;
+		groundTransform.setIdentity();
+		groundTransform.setOrigin(btVector3(center, -56, center));
+
+		addRigidBody(groundShape, 0., groundTransform);
+	}
+
+	btCollisionShape* fixBoxShape = new btBoxShape(btVector3(btScalar(1.), btScalar(1.), btScalar(1.)));
+	collisionShapes.push_back(fixBoxShape);
+
+	btCollisionShape* capsuleShape = new btCapsuleShape(btScalar(1.), btScalar(4.));
+	collisionShapes.push_back(capsuleShape);
+
+	chains.reserve(chainNum);
+	for (std::size_t i = 0; i < chainNum; i++)
+	{
+		btVector3 offset{ btScalar(i % gridWidth) * chainSpacing, 0, btScalar(i / gridWidth) * chainSpacing };
+		chains.push_back(addChain(offset, fixBoxShape, capsuleShape));
+	}
+}
+
+inline Scene::~Scene()
+{
+	if (!dynamicsWorld)
+		return;
+
+	//remove the constraints from the dynamics world and delete them
+	for (int i = dynamicsWorld->getNumConstraints() - 1; i >= 0; i--)
+	{
+		btTypedConstraint* constraint = dynamicsWorld->getConstraint(i);
+		dynamicsWorld->removeConstraint(constraint);
+		delete constraint;
+	}
+
+	//remove the rigidbodies from the dynamics world and delete them
+	for (int i = dynamicsWorld->getNumCollisionObjects() - 1; i >= 0; i--)
+	{
+		btCollisionObject* obj = dynamicsWorld->getCollisionObjectArray()[i];
+		btRigidBody* body = btRigidBody::upcast(obj);
+		if (body && body->getMotionState())
+		{
+			delete body->getMotionState();
+		}
+		dynamicsWorld->removeCollisionObject(obj);
+		delete obj;
+	}
+
+	//delete collision shapes
+	for (int i = 0; i < collisionShapes.size(); i++)
+	{
+		delete collisionShapes[i];
+	}
+
+	if (taskSchedulerChanged)
+		btSetTaskScheduler(previousTaskScheduler);
+}
+
+inline btDiscreteDynamicsWorld* Scene::getDynamicsWorld() noexcept
+{
+	return dynamicsWorld.get();
+}
+
+inline int Scene::getThreadNum() const noexcept
+{
+	if (!solverPool)
+		return 1;
+	return btGetTaskScheduler()->getNumThreads();
+}
+
+inline ChainBodies const& Scene::getChain(std::size_t i) const noexcept
+{
+	return chains[i];
+}
+
+inline std::size_t Scene::getChainNum() const noexcept
+{
+	return chains.size();
+}
+
+inline void Scene::setFixBoxPosition(std::size_t i, btVector3 const& position)
+{
+	auto const& chain = chains[i];
+
+	btTransform groundTransform;
+	groundTransform.setIdentity();
+	groundTransform.setOrigin(chain.offset + position);
+
+	chain.body3->activate(true);
+	chain.fixBox->setWorldTransform(groundTransform);
+}
+
+inline SlabAllocator const* Scene::getManifoldAllocator() const noexcept
+{
+	return manifoldAllocator;
+}
+
+inline SlabAllocator const* Scene::getAlgorithmAllocator() const noexcept
+{
+	return algorithmAllocator;
+}
+
+inline void Scene::initializeCollisionConfiguration(SceneConfig const& config)
+{
+	// SlabCollisionDispatcher̓v[gȂ̂ŁAvf̑傫܂΂悢
+	btDefaultCollisionConstructionInfo constructionInfo{};
+	if (config.slabAllocator)
+	{
+		constructionInfo.m_defaultMaxPersistentManifoldPoolSize = 1;
+		constructionInfo.m_defaultMaxCollisionAlgorithmPoolSize = 1;
+	}
+
+	if (config.capsuleBoxAlgorithm)
+		collisionConfiguration = std::make_unique<CapsuleBoxCollisionConfiguration>(constructionInfo);
+	else
+		collisionConfiguration = std::make_unique<btDefaultCollisionConfiguration>(constructionInfo);
+}
+
+template<class Dispatcher, class... Args>
+inline void Scene::initializeDispatcher(SceneConfig const& config, Args&&... args)
+{
+	if (!config.slabAllocator)
+	{
+		dispatcher = std::make_unique<Dispatcher>(collisionConfiguration.get(), std::forward<Args>(args)...);
+		return;
+	}
+
+	auto slabDispatcher = std::make_unique<SlabCollisionDispatcher<Dispatcher>>(collisionConfiguration.get(), std::forward<Args>(args)...);
+	manifoldAllocator = &slabDispatcher->getManifoldAllocator();
+	algorithmAllocator = &slabDispatcher->getAlgorithmAllocator();
+	dispatcher = std::move(slabDispatcher);
+}
+
+inline void Scene::initializeBroadphase(SceneConfig const& config, bool parallel)
+{
+	if (config.openAddressingPairCache)
+		pairCache = std::make_unique<OpenAddressingPairCache>();
+
+	// OpenAddressingPairCacheParallelDbvtBroadphase܂Ƃ߂đƂ
+	if (parallel || config.openAddressingPairCache)
+		overlappingPairCache = std::make_unique<ParallelDbvtBroadphase>(pairCache.get());
+	else
+		overlappingPairCache = std::make_unique<btDbvtBroadphase>(pairCache.get());
+}
+
+inline void Scene::initializeWorld(SceneConfig const& config)
+{
+	///collision configuration contains default setup for memory, collision setup. Advanced users can create their own configuration.
+	initializeCollisionConfiguration(config);
+
+	///use the default collision dispatcher. For parallel processing you can use a diffent dispatcher (see Extras/BulletMultiThreaded)
+	initializeDispatcher<btCollisionDispatcher>(config);
+
+	///btDbvtBroadphase is a good general purpose broadphase. You can also try out btAxis3Sweep.
+	initializeBroadphase(config, false);
+
+	///the default constraint solver. For parallel processing you can use a different solver (see Extras/BulletMultiThreaded)
+	if (config.soaContactSolver)
+	{
+		btSequentialImpulseConstraintSolverMt::s_minBatchSize = config.solverMinBatchSize;
+		btSequentialImpulseConstraintSolverMt::s_maxBatchSize = config.solverMaxBatchSize;
+		solver = std::make_unique<SoaContactSolverMt>();
+		// btParallelSumȂǂ̓XPW[ȂƓȂ
+		if (!btGetTaskScheduler())
+			setTaskScheduler(btGetSequentialTaskScheduler());
+	}
+	else
+		solver = std::make_unique<btSequentialImpulseConstraintSolver>();
+
+	if (config.incrementalIslands)
+		dynamicsWorld = std::make_unique<IncrementalIslandWorld<btDiscreteDynamicsWorld>>(dispatcher.get(), overlappingPairCache.get(), solver.get(), collisionConfiguration.get());
+	else
+		dynamicsWorld = std::make_unique<btDiscreteDynamicsWorld>(dispatcher.get(), overlappingPairCache.get(), solver.get(), collisionConfiguration.get());
+}
+
+inline void Scene::setTaskScheduler(btITaskScheduler* scheduler)
+{
+	if (!taskSchedulerChanged)
+	{
+		previousTaskScheduler = btGetTaskScheduler();
+		taskSchedulerChanged = true;
+	}
+	btSetTaskScheduler(scheduler);
+}
+
+inline void Scene::initializeWorldMt(SceneConfig const& config)
+{
+	auto scheduler = get_task_scheduler();
+	scheduler->setNumThreads(config.threadNum > 0 ? config.threadNum : scheduler->getMaxNumThreads());
+	setTaskScheduler(scheduler);
+
+	initializeCollisionConfiguration(config);
+
+	initializeDispatcher<btCollisionDispatcherMt>(config, config.dispatcherGrainSize);
+
+	initializeBroadphase(config, config.parallelBroadphase);
+
+	// ACh̓XbhƂɕʂ̃\oŉ
+	{
+		btConstraintSolver* solvers[BT_MAX_THREAD_COUNT];
+		for (unsigned i = 0; i < BT_MAX_THREAD_COUNT; i++)
+			solvers[i] = new btSequentialImpulseConstraintSolver();
+		solverPool = std::make_unique<btConstraintSolverPoolMt>(solvers, BT_MAX_THREAD_COUNT);
+	}
+
+	// 傫ACh͂ŕɉ
+	btSequentialImpulseConstraintSolverMt::s_minBatchSize = config.solverMinBatchSize;
+	btSequentialImpulseConstraintSolverMt::s_maxBatchSize = config.solverMaxBatchSize;
+	if (config.soaContactSolver)
+		solver = std::make_unique<SoaContactSolverMt>();
+	else
+		solver = std::make_unique<btSequentialImpulseConstraintSolverMt>();
+
+	// u[htF[YParallelDbvtBroadphasełȂbtDiscreteDynamicsWorldMtƓ
+	std::unique_ptr<ParallelBroadphaseWorldMt> worldMt{};
+	if (config.incrementalIslands)
+		worldMt = std::make_unique<IncrementalIslandWorld<ParallelBroadphaseWorldMt>>(dispatcher.get(), overlappingPairCache.get(), solverPool.get(), solver.get(), collisionConfiguration.get());
+	else
+		worldMt = std::make_unique<ParallelBroadphaseWorldMt>(dispatcher.get(), overlappingPairCache.get(), solverPool.get(), solver.get(), collisionConfiguration.get());
+
+	worldMt->getSolverInfo().m_minimumSolverBatchSize = config.minimumSolverBatchSize;
+	static_cast<btSimulationIslandManagerMt*>(worldMt->getSimulationIslandManager())->setMinimumSolverBatchSize(config.minimumSolverBatchSize);
+
+	dynamicsWorld = std::move(worldMt);
+}
+
+inline btRigidBody* Scene::addRigidBody(btCollisionShape* shape, btScalar mass, btTransform const& transform, btScalar restitution)
+{
+	btVector3 localInertia(0, 0, 0);
+	if (mass != 0.)
+		shape->calculateLocalInertia(mass, localInertia);
+
+	//using motionstate is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
+	btMotionState* myMotionState = nullptr;
+	if (stepper)
+		myMotionState = new InterpolatedMotionState(stepper, transform);
+	else
+		myMotionState = new btDefaultMotionState(transform);
+	btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, myMotionState, shape, localInertia);
+	rbInfo.m_restitution = restitution;
+	btRigidBody* body = new btRigidBody(rbInfo);
+
+	//add the body to the dynamics world
+	dynamicsWorld->addRigidBody(body);
+
+	return body;
+}
+
+inline btGeneric6DofSpringConstraint* Scene::addChainConstraint(btRigidBody& bodyA, btRigidBody& bodyB, btScalar originInA, btScalar originInB)
+{
+	btTransform frameInA, frameInB;
+	frameInA = btTransform::getIdentity();
+	frameInA.setOrigin(btVector3(btScalar(0.), originInA, btScalar(0.)));
+	frameInB = btTransform::getIdentity();
+	frameInB.setOrigin(btVector3(btScalar(0.), originInB, btScalar(0.)));
+
+	btGeneric6DofSpringConstraint* pGen6DOFSpring = new btGeneric6DofSpringConstraint(bodyA, bodyB, frameInA, frameInB, true);
+	pGen6DOFSpring->setLinearUpperLimit(btVector3(0., 1., 0.));
+	pGen6DOFSpring->setLinearLowerLimit(btVector3(0., -1., 0.));
+
+	dynamicsWorld->addConstraint(pGen6DOFSpring, true);
+	pGen6DOFSpring->setDbgDrawSize(btScalar(5.f));
+
+	return pGen6DOFSpring;
+}
+
+inline ChainBodies Scene::addChain(btVector3 const& offset, btCollisionShape* fixBoxShape, btCollisionShape* capsuleShape)
+{
+	ChainBodies result{};
+	result.offset = offset;
+
+	{
+		btTransform groundTransform;
+		groundTransform.setIdentity();
+		groundTransform.setOrigin(offset + btVector3(-2.f, 10.f, 0.f));
+
+		result.fixBox = addRigidBody(fixBoxShape, 0., groundTransform);
+	}
+
+	{
+		/// Create Dynamic Objects
+		btTransform startTransform;
+		startTransform.setIdentity();
+		startTransform.setRotation(btQuaternion(0.f, 0.f, 0.5f, 1.f));
+
+		startTransform.setOrigin(offset + btVector3(2, 18, 0));
+		result.body1 = addRigidBody(capsuleShape, 1.f, startTransform, 1.f);
+
+		startTransform.setOrigin(offset + btVector3(2, 10, 0));
+		result.body2 = addRigidBody(capsuleShape, 1.f, startTransform, 1.f);
+
+		startTransform.setOrigin(offset + btVector3(2, 2, 0));
+		result.body3 = addRigidBody(capsuleShape, 1.f, startTransform, 1.f);
+	}
+
+	{
+		auto pGen6DOFSpring = addChainConstraint(*result.body1, *result.body2, -3, 3);
+
+		pGen6DOFSpring->setAngularLowerLimit(btVector3(0.f, 0.f, -1.5f));
+		pGen6DOFSpring->setAngularUpperLimit(btVector3(0.f, 0.f, 1.5f));
+
+		pGen6DOFSpring->enableSpring(0, true);
+		pGen6DOFSpring->setStiffness(0, 39.478f);
+		pGen6DOFSpring->setDamping(0, 0.5f);
+		pGen6DOFSpring->setEquilibriumPoint();
+	}
+
+	{
+		auto pGen6DOFSpring = addChainConstraint(*result.body2, *result.body3, -1, 1);
+
+		pGen6DOFSpring->setAngularLowerLimit(btVector3(0.f, 0.f, -1.5f));
+		pGen6DOFSpring->setAngularUpperLimit(btVector3(0.f, 0.f, 1.5f));
+
+		for (int i = 0; i < 6; i++)
+		{
+			pGen6DOFSpring->enableSpring(i, true);
+			pGen6DOFSpring->setStiffness(i, 39.478f);
+		}
+
+		pGen6DOFSpring->setDamping(0, 0.5f);
+		pGen6DOFSpring->setEquilibriumPoint();
+	}
+
+	{
+		auto pGen6DOFSpring = addChainConstraint(*result.body3, *result.fixBox, -3, -3);
+
+		pGen6DOFSpring->enableSpring(0, true);
+		pGen6DOFSpring->setStiffness(0, 39.478f);
+		pGen6DOFSpring->setDamping(0, 0.5f);
+		pGen6DOFSpring->setEquilibriumPoint();
+	}
+
+	return result;
+}
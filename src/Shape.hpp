@@ -2,44 +2,67 @@
 #include"../external/directx12-wrapper/dx12w/dx12w.hpp"
 #include<DirectXMath.h>
 #include<fstream>
-#include"obj_loader.hpp"
+#include<span>
+#include"mesh_cache.hpp"
 #include"CameraData.hpp"
+#include"InstanceStream.hpp"
 
-constexpr std::size_t MAX_BOX_NUM = 256;
-
-struct ShapeData
+// Abv[hq[ṽobt@ă}bv܂܂ɂ
+// t[ƂStructuredBufferSRVfirstSRVHandle珇Ԃɍ
+class UploadInstanceStreamBackend : public InstanceStreamBackend
 {
-	DirectX::XMMATRIX transform{};
-	std::array<float, 3> color{};
+	ID3D12Device* device = nullptr;
+	D3D12_CPU_DESCRIPTOR_HANDLE firstSRVHandle{};
+	UINT descriptorHandleIncrementSize{};
+
+	std::vector<dx12w::resource_and_state> buffers{};
+
+public:
+	UploadInstanceStreamBackend(ID3D12Device*, D3D12_CPU_DESCRIPTOR_HANDLE firstSRVHandle);
+	virtual ~UploadInstanceStreamBackend();
+	UploadInstanceStreamBackend(UploadInstanceStreamBackend const&) = delete;
+	UploadInstanceStreamBackend& operator=(UploadInstanceStreamBackend const&) = delete;
+	UploadInstanceStreamBackend(UploadInstanceStreamBackend&&) = default;
+	UploadInstanceStreamBackend& operator=(UploadInstanceStreamBackend&&) = default;
+
+	InstanceData* resize(std::size_t frameIndex, std::size_t capacity) override;
 };
 
 class ShapeResource
 {
 	dx12w::resource_and_state vertexResource{};
 	D3D12_VERTEX_BUFFER_VIEW vertexBufferView{};
-	UINT vertexNum{};
 
-	dx12w::resource_and_state shapeDataConstantBuffer{};
+	dx12w::resource_and_state indexResource{};
+	D3D12_INDEX_BUFFER_VIEW indexBufferView{};
+	UINT indexNum{};
 
+	// 0ԖڂJCBVA1Ԗڂt[Ƃ̃CX^XSRV
 	dx12w::descriptor_heap descriptorHeapCBVSRVUAV{};
 
-	UINT shapeNum{};
+	InstanceStream instanceStream{};
 
 public:
-	ShapeResource(ID3D12Device*, char const* fileName, ID3D12Resource* cameraDataResource);
+	// frameNumt[̃CX^X̃obt@ԂɎg
+	ShapeResource(ID3D12Device*, char const* fileName, ID3D12Resource* cameraDataResource, std::size_t frameNum);
 	virtual ~ShapeResource() = default;
 	ShapeResource(ShapeResource&) = delete;
 	ShapeResource& operator=(ShapeResource const&) = delete;
 	ShapeResource(ShapeResource&&) = default;
 	ShapeResource& operator=(ShapeResource&&) = default;
 
-	template<typename Iter>
-	void setShapeData(Iter first, Iter last);
+	// RenderExtractorẑ܂ܓn
+	// frameNumt[O̕`悪IĂĂ
+	void setShapeData(std::span<std::array<float, 16> const> transforms, std::span<std::array<float, 3> const> colors);
 
 	D3D12_VERTEX_BUFFER_VIEW const& getVertexBufferView() noexcept;
-	UINT getVertexNum() const noexcept;
+	D3D12_INDEX_BUFFER_VIEW const& getIndexBufferView() noexcept;
+	UINT getIndexNum() const noexcept;
 	dx12w::descriptor_heap& getDescriptorHeap() noexcept;
+	// ŌsetShapeDataCX^XSRV
+	D3D12_GPU_DESCRIPTOR_HANDLE getShapeDataHandle() noexcept;
 	UINT getShapeNum() const noexcept;
+	InstanceStreamCounter const& getInstanceStreamCounter() const noexcept;
 };
 
 class ShapePipeline
@@ -69,12 +92,66 @@ public:
 //
 
 
-inline ShapeResource::ShapeResource(ID3D12Device* device, char const* fileName, ID3D12Resource* cameraDataResource)
+inline UploadInstanceStreamBackend::UploadInstanceStreamBackend(ID3D12Device* device, D3D12_CPU_DESCRIPTOR_HANDLE firstSRVHandle)
+	: device{ device }
+	, firstSRVHandle{ firstSRVHandle }
+	, descriptorHandleIncrementSize{ device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV) }
 {
-	// _f[^
+}
+
+inline UploadInstanceStreamBackend::~UploadInstanceStreamBackend()
+{
+	for (auto& buffer : buffers)
 	{
-		std::ifstream file{ fileName };
-		auto vertexData = load_obj(file);
+		if (buffer.first)
+			buffer.first->Unmap(0, nullptr);
+	}
+}
+
+inline InstanceData* UploadInstanceStreamBackend::resize(std::size_t frameIndex, std::size_t capacity)
+{
+	if (frameIndex >= buffers.size())
+		buffers.resize(frameIndex + 1);
+
+	auto& buffer = buffers[frameIndex];
+	if (buffer.first)
+		buffer.first->Unmap(0, nullptr);
+
+	buffer = dx12w::create_commited_upload_buffer_resource(device, dx12w::alignment<UINT64>(sizeof(InstanceData) * capacity, 256));
+
+	// Abv[hq[v̓}bv܂܂ł悢
+	// CPU͓ǂ܂Ȃ̂œǂޔ͈͂͋ɂ
+	D3D12_RANGE const readRange{ 0, 0 };
+	InstanceData* data = nullptr;
+	buffer.first->Map(0, &readRange, reinterpret_cast<void**>(&data));
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC const srvDesc{
+		.Format = DXGI_FORMAT_UNKNOWN,
+		.ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
+		.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+		.Buffer{
+			.FirstElement = 0,
+			.NumElements = static_cast<UINT>(capacity),
+			.StructureByteStride = sizeof(InstanceData),
+			.Flags = D3D12_BUFFER_SRV_FLAG_NONE,
+		},
+	};
+	auto handle = firstSRVHandle;
+	handle.ptr += static_cast<SIZE_T>(frameIndex) * descriptorHandleIncrementSize;
+	device->CreateShaderResourceView(buffer.first.get(), &srvDesc, handle);
+
+	return data;
+}
+
+
+inline ShapeResource::ShapeResource(ID3D12Device* device, char const* fileName, ID3D12Resource* cameraDataResource, std::size_t frameNum)
+{
+	// _f[^ƃCfbNX
+	{
+		// 2ڈȍ~OBJp[XɃLbV}bv
+		auto const mesh = load_mesh(fileName);
+		auto const vertexData = mesh.getVertices();
+		auto const indexData = mesh.getIndices();
 
 		vertexResource = dx12w::create_commited_upload_buffer_resource(device, sizeof(decltype(vertexData)::value_type) * vertexData.size());
 
@@ -89,31 +166,38 @@ inline ShapeResource::ShapeResource(ID3D12Device* device, char const* fileName,
 			.StrideInBytes = static_cast<UINT>(sizeof(decltype(vertexData)::value_type)),
 		};
 
-		vertexNum = vertexData.size();
-	}
+		indexResource = dx12w::create_commited_upload_buffer_resource(device, sizeof(std::uint32_t) * indexData.size());
 
-	// 萔obt@
-	{
-		shapeDataConstantBuffer = dx12w::create_commited_upload_buffer_resource(device, dx12w::alignment<UINT64>(sizeof(ShapeData), 256));
+		std::uint32_t* indexPtr = nullptr;
+		indexResource.first->Map(0, nullptr, reinterpret_cast<void**>(&indexPtr));
+		std::copy(indexData.begin(), indexData.end(), indexPtr);
+		indexResource.first->Unmap(0, nullptr);
+
+		indexBufferView = {
+			.BufferLocation = indexResource.first->GetGPUVirtualAddress(),
+			.SizeInBytes = static_cast<UINT>(sizeof(std::uint32_t) * indexData.size()),
+			.Format = DXGI_FORMAT_R32_UINT,
+		};
+
+		indexNum = static_cast<UINT>(indexData.size());
 	}
 
 	// fBXNv^q[v
 	{
-		descriptorHeapCBVSRVUAV.initialize(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 2);
+		descriptorHeapCBVSRVUAV.initialize(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1 + static_cast<UINT>(frameNum));
 
 		dx12w::create_CBV(device, descriptorHeapCBVSRVUAV.get_CPU_handle(0), cameraDataResource, dx12w::alignment<UINT64>(sizeof(CameraData), 256));
-		dx12w::create_CBV(device, descriptorHeapCBVSRVUAV.get_CPU_handle(1), shapeDataConstantBuffer.first.get(), dx12w::alignment<UINT64>(sizeof(ShapeData), 256));
+	}
+
+	// CX^X̃obt@ASRVō
+	{
+		instanceStream = InstanceStream{ std::make_unique<UploadInstanceStreamBackend>(device, descriptorHeapCBVSRVUAV.get_CPU_handle(1)), frameNum };
 	}
 }
 
-template<typename Iter>
-inline void ShapeResource::setShapeData(Iter first, Iter last)
+inline void ShapeResource::setShapeData(std::span<std::array<float, 16> const> transforms, std::span<std::array<float, 3> const> colors)
 {
-	ShapeData* shapeDataPtr = nullptr;
-	shapeDataConstantBuffer.first->Map(0, nullptr, reinterpret_cast<void**>(&shapeDataPtr));
-
-	std::copy(first, last, shapeDataPtr);
-	shapeNum = std::distance(first, last);
+	instanceStream.write(transforms, colors);
 }
 
 inline D3D12_VERTEX_BUFFER_VIEW const& ShapeResource::getVertexBufferView() noexcept
@@ -121,9 +205,14 @@ inline D3D12_VERTEX_BUFFER_VIEW const& ShapeResource::getVertexBufferView() noex
 	return vertexBufferView;
 }
 
-inline UINT ShapeResource::getVertexNum() const noexcept
+inline D3D12_INDEX_BUFFER_VIEW const& ShapeResource::getIndexBufferView() noexcept
 {
-	return vertexNum;
+	return indexBufferView;
+}
+
+inline UINT ShapeResource::getIndexNum() const noexcept
+{
+	return indexNum;
 }
 
 inline dx12w::descriptor_heap& ShapeResource::getDescriptorHeap() noexcept
@@ -131,9 +220,19 @@ inline dx12w::descriptor_heap& ShapeResource::getDescriptorHeap() noexcept
 	return descriptorHeapCBVSRVUAV;
 }
 
+inline D3D12_GPU_DESCRIPTOR_HANDLE ShapeResource::getShapeDataHandle() noexcept
+{
+	return descriptorHeapCBVSRVUAV.get_GPU_handle(1 + instanceStream.getFrameIndex());
+}
+
 inline UINT ShapeResource::getShapeNum() const noexcept
 {
-	return shapeNum;
+	return static_cast<UINT>(instanceStream.getInstanceNum());
+}
+
+inline InstanceStreamCounter const& ShapeResource::getInstanceStreamCounter() const noexcept
+{
+	return instanceStream.getCounter();
 }
 
 
@@ -154,7 +253,8 @@ inline ShapePipeline::ShapePipeline(ID3D12Device* device, DXGI_FORMAT rendererFo
 
 	// [gVOl`
 	{
-		rootSignature = dx12w::create_root_signature(device, { {{D3D12_DESCRIPTOR_RANGE_TYPE_CBV,2}} }, {});
+		// JCBVƁAt[Ƃɐ؂ւCX^XSRV
+		rootSignature = dx12w::create_root_signature(device, { {{D3D12_DESCRIPTOR_RANGE_TYPE_CBV,1}}, {{D3D12_DESCRIPTOR_RANGE_TYPE_SRV,1}} }, {});
 	}
 
 	// OtBbNXpCvC
@@ -177,7 +277,9 @@ inline void ShapePipeline::draw(ID3D12GraphicsCommandList* list, ShapeResource&
 		list->SetDescriptorHeaps(1, &tmp);
 	}
 	list->SetGraphicsRootDescriptorTable(0, shapeResource.getDescriptorHeap().get_GPU_handle(0));
+	list->SetGraphicsRootDescriptorTable(1, shapeResource.getShapeDataHandle());
 
 	list->IASetVertexBuffers(0, 1, &shapeResource.getVertexBufferView());
-	list->DrawInstanced(shapeResource.getVertexNum(), shapeResource.getShapeNum(), 0, 0);
+	list->IASetIndexBuffer(&shapeResource.getIndexBufferView());
+	list->DrawIndexedInstanced(shapeResource.getIndexNum(), shapeResource.getShapeNum(), 0, 0, 0);
 }
\ No newline at end of file
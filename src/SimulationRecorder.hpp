@@ -0,0 +1,853 @@
+#pragma once
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"MappedFile.hpp"
+#include"RenderExtractor.hpp"
+#include<algorithm>
+#include<array>
+#include<bit>
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+#include<deque>
+#include<fstream>
+#include<memory>
+#include<mutex>
+#include<span>
+#include<stdexcept>
+#include<string>
+#include<thread>
+#include<vector>
+
+// XebvƂ̍̂̎pƑxL^t@C
+// wb_Â̕\At[̃ubNAAtb^̏ɕׂ
+// L[t[̃ubN͑S̍̂̏ԂAԂ̃ubN͑Õt[ς̂O̒lƂXORŎ
+// ̓t[ƂɁÃubNƑkL[t[̃ubN̈ʒu
+// L^rŎ~܂ătb^΁AĐƂɃubNHč蒼
+
+constexpr char RECORDING_MAGIC[8] = { 'P', 'B', 'R', 'E', 'C', '\0', '\0', '\0' };
+constexpr std::uint32_t RECORDING_VERSION = 1;
+
+struct RecordingHeader
+{
+	char magic[8]{};
+	std::uint32_t version{};
+	std::uint32_t bodyNum{};
+	std::uint32_t keyframeInterval{};
+	// RecordedBodyStatẽoCg
+	std::uint32_t stateSize{};
+};
+static_assert(sizeof(RecordingHeader) == 24);
+
+// 1A[h̔z̏
+// `̊ĂRenderExtractor::rebuildƓ
+struct RecordedBody
+{
+	// RenderShapeTypeA`Ȃ̂-1
+	std::int32_t renderType{};
+	std::uint32_t slot{};
+	std::array<float, 9> local{};
+};
+static_assert(sizeof(RecordedBody) == 44);
+
+// `ƓfloatŎ
+struct RecordedBodyState
+{
+	std::array<float, 3> position{};
+	// x, y, z, w
+	std::array<float, 4> rotation{};
+	std::array<float, 3> linearVelocity{};
+	std::array<float, 3> angularVelocity{};
+	std::int32_t activationState{};
+};
+static_assert(sizeof(RecordedBodyState) == 56);
+
+constexpr std::size_t RECORDED_STATE_WORD_NUM = sizeof(RecordedBodyState) / sizeof(std::uint32_t);
+static_assert(RECORDED_STATE_WORD_NUM % 2 == 0);
+// ͌̉ʂ̃oCg珑Â܂memcpy
+static_assert(std::endian::native == std::endian::little);
+
+enum class RecordingFrameKind : std::uint32_t
+{
+	Keyframe = 1,
+	Delta = 2,
+};
+
+// ubN̐擪
+// L[t[ȂRecordedBodyStatebodyNum
+// Ȃ獄̂ƂɁAO̍̂̔ԍ̍-1LEB128AXORꂲƂ̉ʂ̃oCg2l߂7oCgAʂ̃oCg
+struct RecordingFrameHeader
+{
+	RecordingFrameKind kind{};
+	std::uint32_t bodyNum{};
+	std::uint64_t frame{};
+	std::uint64_t size{};
+};
+static_assert(sizeof(RecordingFrameHeader) == 24);
+
+// t[ƁÂĂt[ƓnȂt[͑Oɏt[Ɠʒuw
+struct RecordingIndexEntry
+{
+	std::uint64_t offset{};
+	std::uint64_t keyframeOffset{};
+};
+
+struct RecordingFooter
+{
+	std::uint64_t indexOffset{};
+	std::uint64_t frameNum{};
+	char magic[8]{};
+};
+static_assert(sizeof(RecordingFooter) == 24);
+
+struct SimulationRecorderConfig
+{
+	// ̃t[ƂɃL[t[AV[NŒHubN̐̏
+	std::uint32_t keyframeInterval = 60;
+	// ݃Xbhɓn܂܏IĂȂt[̏
+	// t[͎̂ĂāÃt[L[t[ɂ
+	std::size_t queueCapacity = 8;
+	// ݃Xbh́Ant[̍̂̐̍v𒴂邩Ant[queueCapacity̔ɂȂN
+	// t[1nƁANԂ̂قʂԂ傫
+	std::size_t writeBatchBodyNum = 16384;
+};
+
+struct SimulationRecorderCounter
+{
+	// recordĂ񂾉
+	std::uint64_t frameNum{};
+	std::uint64_t droppedFrameNum{};
+	// ݃Xbhɓn̂̐̍v
+	std::uint64_t capturedBodyNum{};
+	std::uint64_t keyframeNum{};
+	std::uint64_t writtenBytes{};
+	// ݃XbhNăt[܂Ƃ߂ď
+	std::uint64_t writeBatchNum{};
+};
+
+// [h̍̂̏ԂXebvƂɃt@C֏
+// Xebvi߂Xbhł͓̂̏ԂʂŁAď̂͏݃Xbh
+// ݃Xbh̓t[܂ĂNAǂ̍̂ςȂt[͓nȂ
+// ݂ǂȂ΃t[̂Ă̂ŁArecordI/O҂Ƃ͂Ȃ
+// ̂ǉA폜L^Ȃ
+class SimulationRecorder
+{
+	struct Capture
+	{
+		std::uint64_t frame{};
+		// S̍̂ʂ
+		bool full = false;
+		std::vector<std::uint32_t> indices{};
+		std::vector<RecordedBodyState> states{};
+	};
+
+	struct Body
+	{
+		btRigidBody const* body = nullptr;
+		int activationState{};
+		int updateRevision{};
+	};
+
+	SimulationRecorderConfig config{};
+
+	// recordĂԃXbhG
+	std::vector<Body> bodies{};
+	// Ɏ̂ĂȂt[őS̍̂ʂ
+	bool forceFull = true;
+	std::uint64_t nextFrame{};
+	// ̃t[ʂAnƂɎ̕Ă
+	std::unique_ptr<Capture> current{};
+
+	std::ofstream out{};
+	std::string fileName{};
+
+	// ݃XbhG
+	std::vector<RecordedBodyState> previousStates{};
+	std::vector<RecordingIndexEntry> index{};
+	std::vector<std::byte> block{};
+	// ܂Ƃ߂Ďot[
+	std::deque<std::unique_ptr<Capture>> writingCaptures{};
+	std::uint64_t offset{};
+	std::uint64_t lastKeyframe{};
+	std::uint64_t keyframeOffset{};
+
+	std::mutex mutex{};
+	std::condition_variable condition{};
+	std::vector<std::unique_ptr<Capture>> freeCaptures{};
+	std::deque<std::unique_ptr<Capture>> pendingCaptures{};
+	// pendingCaptures̍̂̐
+	std::size_t pendingBodyNum{};
+	bool stopping = false;
+	bool failed = false;
+	SimulationRecorderCounter counter{};
+
+	std::thread writer{};
+
+	// mutexČĂ
+	bool isBatchReady() const noexcept;
+	void writeLoop();
+	// Ȃfalse
+	bool writeCapture(Capture const& capture);
+	void writeBlock(RecordingFrameKind kind, std::uint64_t frame, std::uint32_t bodyNum);
+
+public:
+	// JȂstd::runtime_error
+	SimulationRecorder(btDynamicsWorld const* world, char const* fileName, SimulationRecorderConfig const& config = {});
+	// close
+	virtual ~SimulationRecorder();
+	SimulationRecorder(SimulationRecorder const&) = delete;
+	SimulationRecorder& operator=(SimulationRecorder const&) = delete;
+
+	// Xebv̌ɌĂԁÂĂ݂ɎsĂfalse
+	// ݃Xbhɓnt[́AɋNclose܂Ńt@CɏȂ
+	bool record();
+
+	// c̃t[čƃtb^A2ڂ͉Ȃ
+	// Ȃt[false
+	bool close();
+
+	bool isFailed();
+	SimulationRecorderCounter getCounter();
+};
+
+// L^t@C}bvāADȃt[̍̂̏Ԃo
+// `p̔zɂRenderExtractorƓĂŏ
+class SimulationReplay
+{
+	MappedFile file{};
+	RecordingHeader header{};
+	std::span<RecordedBody const> bodies{};
+	std::vector<RecordingIndexEntry> index{};
+	// ubNԔ͈͂̏IAtb^΍̐擪
+	std::uint64_t blockEnd{};
+	bool complete = false;
+
+	std::vector<RecordedBodyState> states{};
+	// Ōɓǂ񂾃ubNA܂0
+	std::uint64_t decodedOffset{};
+	std::uint64_t decodedKeyframeOffset{};
+	std::uint64_t frame{};
+
+	std::array<std::size_t, RENDER_SHAPE_TYPE_NUM> instanceNums{};
+	std::array<RenderInstanceArrays, RENDER_SHAPE_TYPE_NUM> outputs{};
+
+	// tb^ƂɃubNHč
+	void rebuildIndex();
+	// ubŇoƒgblockEndOɎ܂Ă邩
+	bool isBlockInRange(std::uint64_t blockOffset) const noexcept;
+	// Ăfalse
+	bool decodeBlock(std::uint64_t blockOffset);
+
+public:
+	// JȂAL^t@CłȂAt@C̊OwĂstd::runtime_error
+	SimulationReplay(char const* fileName);
+	virtual ~SimulationReplay() = default;
+	SimulationReplay(SimulationReplay const&) = delete;
+	SimulationReplay& operator=(SimulationReplay const&) = delete;
+
+	std::uint64_t getFrameNum() const noexcept;
+	std::size_t getBodyNum() const noexcept;
+	std::uint32_t getKeyframeInterval() const noexcept;
+	// falseȂtb^AubNHč
+	bool isComplete() const noexcept;
+
+	// L[t[ǂ݂Ȃ̂ŁA鎞Ԃ̓L[t[̊ԊuŌ܂
+	// ͈͊OĂfalse
+	bool seek(std::uint64_t frame);
+	std::uint64_t getFrame() const noexcept;
+	std::span<RecordedBodyState const> getStates() const noexcept;
+
+	std::size_t getInstanceNum(RenderShapeType type) const noexcept;
+	void setOutput(RenderShapeType type, RenderInstanceArrays const& arrays) noexcept;
+	// ̃t[̎pƐFSACX^X̐Ԃ
+	std::size_t extract() const;
+};
+
+RecordedBodyState make_recorded_body_state(btRigidBody const* body) noexcept;
+btTransform get_recorded_transform(RecordedBodyState const& state) noexcept;
+
+
+//
+// ȉA
+//
+
+
+inline SimulationRecorder::SimulationRecorder(btDynamicsWorld const* world, char const* name, SimulationRecorderConfig const& c)
+	: config{ c }
+	, fileName{ name }
+{
+	config.keyframeInterval = std::max<std::uint32_t>(config.keyframeInterval, 1);
+	config.queueCapacity = std::max<std::size_t>(config.queueCapacity, 1);
+
+	std::vector<RecordedBody> records{};
+	std::array<std::uint32_t, RENDER_SHAPE_TYPE_NUM> instanceNums{};
+	for (int i = 0; i < world->getNumCollisionObjects(); i++)
+	{
+		auto const body = btRigidBody::upcast(world->getCollisionObjectArray()[i]);
+		if (!body)
+			continue;
+
+		RecordedBody record{ .renderType = -1 };
+		RenderShapeType type{};
+		if (!(body->getCollisionFlags() & btCollisionObject::CF_DISABLE_VISUALIZE_OBJECT) &&
+			compute_render_local_matrix(body->getCollisionShape(), type, record.local))
+		{
+			record.renderType = static_cast<std::int32_t>(type);
+			record.slot = instanceNums[static_cast<std::size_t>(type)]++;
+		}
+		records.push_back(record);
+		bodies.push_back({ .body = body });
+	}
+
+	out.open(fileName, std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::runtime_error{ "failed to open " + fileName };
+
+	RecordingHeader header{};
+	std::memcpy(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+	header.version = RECORDING_VERSION;
+	header.bodyNum = static_cast<std::uint32_t>(bodies.size());
+	header.keyframeInterval = config.keyframeInterval;
+	header.stateSize = sizeof(RecordedBodyState);
+	out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+	out.write(reinterpret_cast<char const*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(RecordedBody)));
+	if (!out)
+		throw std::runtime_error{ "failed to write " + fileName };
+	offset = sizeof(header) + records.size() * sizeof(RecordedBody);
+	counter.writtenBytes = offset;
+
+	previousStates.resize(bodies.size());
+	for (std::size_t i = 0; i < config.queueCapacity; i++)
+	{
+		auto capture = std::make_unique<Capture>();
+		capture->indices.reserve(bodies.size());
+		capture->states.reserve(bodies.size());
+		freeCaptures.push_back(std::move(capture));
+	}
+
+	writer = std::thread{ [this] { writeLoop(); } };
+}
+
+inline SimulationRecorder::~SimulationRecorder()
+{
+	close();
+}
+
+inline bool SimulationRecorder::record()
+{
+	BT_PROFILE("SimulationRecorder::record");
+
+	auto const frame = nextFrame++;
+	if (!current)
+	{
+		std::lock_guard lock{ mutex };
+		counter.frameNum = nextFrame;
+		if (failed || stopping || freeCaptures.empty())
+		{
+			counter.droppedFrameNum++;
+			forceFull = true;
+			return false;
+		}
+		current = std::move(freeCaptures.back());
+		freeCaptures.pop_back();
+	}
+
+	// QĂ鍄̂ƐÓIȍ̂́AԂsetWorldTransformŕςƂʂ
+	auto& capture = *current;
+	capture.frame = frame;
+	capture.full = std::exchange(forceFull, false);
+	capture.indices.clear();
+	capture.states.clear();
+	for (std::size_t i = 0; i < bodies.size(); i++)
+	{
+		auto& body = bodies[i];
+		auto const activationState = body.body->getActivationState();
+		auto const updateRevision = body.body->getUpdateRevisionInternal();
+		auto const moving = !body.body->isStaticObject() && activationState != ISLAND_SLEEPING && activationState != DISABLE_SIMULATION;
+		if (!capture.full && !moving && activationState == body.activationState && updateRevision == body.updateRevision)
+			continue;
+
+		body.activationState = activationState;
+		body.updateRevision = updateRevision;
+		capture.indices.push_back(static_cast<std::uint32_t>(i));
+		capture.states.push_back(make_recorded_body_state(body.body));
+	}
+
+	auto wake = false;
+	{
+		std::lock_guard lock{ mutex };
+		counter.frameNum = nextFrame;
+		if (failed || stopping)
+		{
+			counter.droppedFrameNum++;
+			forceFull = true;
+			return false;
+		}
+
+		// ς̂ΓnȂAł͑Oɏt[w
+		if (capture.full || !capture.indices.empty())
+		{
+			counter.capturedBodyNum += capture.indices.size();
+			pendingBodyNum += capture.indices.size();
+			pendingCaptures.push_back(std::move(current));
+			if (!freeCaptures.empty())
+			{
+				current = std::move(freeCaptures.back());
+				freeCaptures.pop_back();
+			}
+			wake = isBatchReady();
+		}
+	}
+	if (wake)
+		condition.notify_one();
+	return true;
+}
+
+inline bool SimulationRecorder::close()
+{
+	{
+		std::lock_guard lock{ mutex };
+		if (stopping)
+			return !failed;
+		stopping = true;
+	}
+	condition.notify_one();
+	writer.join();
+
+	// ݃Xbh͏IĂ̂ŃbN͂Ȃ
+	index.resize(counter.frameNum, index.empty() ? RecordingIndexEntry{} : index.back());
+	RecordingFooter footer{ .indexOffset = offset, .frameNum = index.size() };
+	std::memcpy(footer.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+	out.write(reinterpret_cast<char const*>(index.data()), static_cast<std::streamsize>(index.size() * sizeof(RecordingIndexEntry)));
+	out.write(reinterpret_cast<char const*>(&footer), sizeof(footer));
+	out.close();
+	counter.writtenBytes += index.size() * sizeof(RecordingIndexEntry) + sizeof(footer);
+	failed = failed || !out;
+
+	return !failed;
+}
+
+inline bool SimulationRecorder::isFailed()
+{
+	std::lock_guard lock{ mutex };
+	return failed;
+}
+
+inline SimulationRecorderCounter SimulationRecorder::getCounter()
+{
+	std::lock_guard lock{ mutex };
+	return counter;
+}
+
+inline bool SimulationRecorder::isBatchReady() const noexcept
+{
+	return !pendingCaptures.empty() && (pendingBodyNum >= config.writeBatchBodyNum || pendingCaptures.size() * 2 >= config.queueCapacity);
+}
+
+inline void SimulationRecorder::writeLoop()
+{
+	while (true)
+	{
+		{
+			std::unique_lock lock{ mutex };
+			condition.wait(lock, [this] { return stopping || isBatchReady(); });
+			if (pendingCaptures.empty())
+				return;
+			std::swap(writingCaptures, pendingCaptures);
+			pendingBodyNum = 0;
+		}
+
+		auto written = true;
+		std::uint64_t keyframeNum = 0;
+		for (auto const& capture : writingCaptures)
+		{
+			written = written && !failed && writeCapture(*capture);
+			if (written && keyframeOffset == index.back().offset)
+				keyframeNum++;
+		}
+
+		std::lock_guard lock{ mutex };
+		failed = failed || !written;
+		counter.writtenBytes = offset;
+		counter.keyframeNum += keyframeNum;
+		counter.writeBatchNum++;
+		for (auto& capture : writingCaptures)
+			freeCaptures.push_back(std::move(capture));
+		writingCaptures.clear();
+	}
+}
+
+inline bool SimulationRecorder::writeCapture(Capture const& capture)
+{
+	auto const keyframe = capture.full || index.empty() || capture.frame - lastKeyframe >= config.keyframeInterval;
+
+	block.resize(sizeof(RecordingFrameHeader));
+	std::uint32_t bodyNum = 0;
+	if (keyframe)
+	{
+		for (std::size_t i = 0; i < capture.indices.size(); i++)
+			previousStates[capture.indices[i]] = capture.states[i];
+
+		auto const size = previousStates.size() * sizeof(RecordedBodyState);
+		block.resize(block.size() + size);
+		std::memcpy(block.data() + sizeof(RecordingFrameHeader), previousStates.data(), size);
+		bodyNum = static_cast<std::uint32_t>(previousStates.size());
+	}
+	else
+	{
+		// ̂ƂɈԒȂ镪ɎĂāA|C^ŏ
+		// 1oCgpush_backƁAoCg̐eʂm߂邱ƂɂȂ
+		constexpr std::size_t maxEncodedSize = 5 + RECORDED_STATE_WORD_NUM / 2 + sizeof(RecordedBodyState);
+		block.resize(sizeof(RecordingFrameHeader) + capture.indices.size() * maxEncodedSize);
+		auto p = block.data() + sizeof(RecordingFrameHeader);
+
+		std::uint32_t nextIndex = 0;
+		for (std::size_t i = 0; i < capture.indices.size(); i++)
+		{
+			std::array<std::uint32_t, RECORDED_STATE_WORD_NUM> words{};
+			std::array<std::uint32_t, RECORDED_STATE_WORD_NUM> previousWords{};
+			std::memcpy(words.data(), &capture.states[i], sizeof(RecordedBodyState));
+			std::memcpy(previousWords.data(), &previousStates[capture.indices[i]], sizeof(RecordedBodyState));
+
+			std::uint32_t changed = 0;
+			for (std::size_t w = 0; w < RECORDED_STATE_WORD_NUM; w++)
+			{
+				words[w] ^= previousWords[w];
+				changed |= words[w];
+			}
+			if (changed == 0)
+				continue;
+			previousStates[capture.indices[i]] = capture.states[i];
+
+			for (auto gap = capture.indices[i] - nextIndex; ; gap >>= 7)
+			{
+				*p++ = static_cast<std::byte>((gap & 0x7F) | (gap >= 0x80 ? 0x80 : 0));
+				if (gap < 0x80)
+					break;
+			}
+			nextIndex = capture.indices[i] + 1;
+
+			// l͕ƎwƉ̏ʂȂ̂ŁAXOȐʂ̃oCg0ɂȂ
+			// 4oCgƂĂAgoCg̐i߂
+			auto const control = p;
+			p += RECORDED_STATE_WORD_NUM / 2;
+			for (std::size_t w = 0; w < RECORDED_STATE_WORD_NUM; w += 2)
+			{
+				auto const byteNum0 = static_cast<std::uint32_t>(4 - std::countl_zero(words[w]) / 8);
+				auto const byteNum1 = static_cast<std::uint32_t>(4 - std::countl_zero(words[w + 1]) / 8);
+				control[w / 2] = static_cast<std::byte>(byteNum0 | byteNum1 << 4);
+				std::memcpy(p, &words[w], sizeof(std::uint32_t));
+				p += byteNum0;
+				std::memcpy(p, &words[w + 1], sizeof(std::uint32_t));
+				p += byteNum1;
+			}
+			bodyNum++;
+		}
+		block.resize(static_cast<std::size_t>(p - block.data()));
+	}
+
+	writeBlock(keyframe ? RecordingFrameKind::Keyframe : RecordingFrameKind::Delta, capture.frame, bodyNum);
+	if (!out)
+		return false;
+
+	if (keyframe)
+	{
+		lastKeyframe = capture.frame;
+		keyframeOffset = offset;
+	}
+
+	// ̂Ăt[ƓnȂt[͑Oɏt[w
+	index.resize(capture.frame, index.empty() ? RecordingIndexEntry{} : index.back());
+	index.push_back({ offset, keyframeOffset });
+	offset += block.size();
+	return true;
+}
+
+inline void SimulationRecorder::writeBlock(RecordingFrameKind kind, std::uint64_t frame, std::uint32_t bodyNum)
+{
+	RecordingFrameHeader const frameHeader{
+		.kind = kind,
+		.bodyNum = bodyNum,
+		.frame = frame,
+		.size = block.size() - sizeof(RecordingFrameHeader),
+	};
+	std::memcpy(block.data(), &frameHeader, sizeof(frameHeader));
+	out.write(reinterpret_cast<char const*>(block.data()), static_cast<std::streamsize>(block.size()));
+}
+
+
+inline SimulationReplay::SimulationReplay(char const* fileName)
+	: file{ fileName }
+{
+	if (file.getSize() < sizeof(RecordingHeader))
+		throw std::runtime_error{ std::string{ "not a recording " } + fileName };
+
+	std::memcpy(&header, file.getData(), sizeof(header));
+	auto const bodyEnd = sizeof(RecordingHeader) + static_cast<std::uint64_t>(header.bodyNum) * sizeof(RecordedBody);
+	if (std::memcmp(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) != 0 ||
+		header.version != RECORDING_VERSION ||
+		header.stateSize != sizeof(RecordedBodyState) ||
+		header.keyframeInterval == 0 ||
+		file.getSize() < bodyEnd)
+		throw std::runtime_error{ std::string{ "not a recording " } + fileName };
+
+	bodies = { reinterpret_cast<RecordedBody const*>(file.getData() + sizeof(RecordingHeader)), header.bodyNum };
+	for (auto const& body : bodies)
+	{
+		if (body.renderType >= 0 && static_cast<std::size_t>(body.renderType) < RENDER_SHAPE_TYPE_NUM)
+		{
+			auto& num = instanceNums[static_cast<std::size_t>(body.renderType)];
+			num = std::max<std::size_t>(num, body.slot + 1);
+		}
+	}
+	states.resize(header.bodyNum);
+
+	// tb^ƍĂ΂̂܂܎g
+	if (file.getSize() >= bodyEnd + sizeof(RecordingFooter))
+	{
+		RecordingFooter footer{};
+		std::memcpy(&footer, file.getData() + file.getSize() - sizeof(RecordingFooter), sizeof(footer));
+		if (std::memcmp(footer.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) == 0 &&
+			footer.indexOffset >= bodyEnd &&
+			footer.indexOffset + footer.frameNum * sizeof(RecordingIndexEntry) + sizeof(RecordingFooter) == file.getSize())
+		{
+			index.resize(footer.frameNum);
+			std::memcpy(index.data(), file.getData() + footer.indexOffset, index.size() * sizeof(RecordingIndexEntry));
+			blockEnd = footer.indexOffset;
+
+			// V[N͍MăubNǂނ̂ŁAőS̈ʒum߂
+			for (auto const& entry : index)
+			{
+				if (entry.offset != 0 && (entry.keyframeOffset < bodyEnd || entry.keyframeOffset > entry.offset ||
+					!isBlockInRange(entry.offset) || !isBlockInRange(entry.keyframeOffset)))
+					throw std::runtime_error{ std::string{ "broken recording index " } + fileName };
+			}
+			complete = true;
+			return;
+		}
+	}
+
+	blockEnd = file.getSize();
+	rebuildIndex();
+}
+
+inline void SimulationReplay::rebuildIndex()
+{
+	std::uint64_t blockOffset = sizeof(RecordingHeader) + static_cast<std::uint64_t>(header.bodyNum) * sizeof(RecordedBody);
+	std::uint64_t keyframeOffset{};
+	while (blockOffset + sizeof(RecordingFrameHeader) <= file.getSize())
+	{
+		RecordingFrameHeader frameHeader{};
+		std::memcpy(&frameHeader, file.getData() + blockOffset, sizeof(frameHeader));
+		auto const end = blockOffset + sizeof(RecordingFrameHeader) + frameHeader.size;
+		// ̃ubNAL[t[O̍
+		if (end > file.getSize() || frameHeader.frame < index.size() ||
+			(frameHeader.kind != RecordingFrameKind::Keyframe && (frameHeader.kind != RecordingFrameKind::Delta || keyframeOffset == 0)))
+			break;
+
+		if (frameHeader.kind == RecordingFrameKind::Keyframe)
+			keyframeOffset = blockOffset;
+		index.resize(frameHeader.frame, index.empty() ? RecordingIndexEntry{} : index.back());
+		index.push_back({ blockOffset, keyframeOffset });
+		blockOffset = end;
+	}
+}
+
+inline bool SimulationReplay::isBlockInRange(std::uint64_t blockOffset) const noexcept
+{
+	if (blockOffset > blockEnd || blockEnd - blockOffset < sizeof(RecordingFrameHeader))
+		return false;
+	RecordingFrameHeader frameHeader{};
+	std::memcpy(&frameHeader, file.getData() + blockOffset, sizeof(frameHeader));
+	return frameHeader.size <= blockEnd - blockOffset - sizeof(RecordingFrameHeader);
+}
+
+inline bool SimulationReplay::decodeBlock(std::uint64_t blockOffset)
+{
+	if (!isBlockInRange(blockOffset))
+		return false;
+
+	RecordingFrameHeader frameHeader{};
+	std::memcpy(&frameHeader, file.getData() + blockOffset, sizeof(frameHeader));
+	auto ptr = reinterpret_cast<std::uint8_t const*>(file.getData() + blockOffset + sizeof(RecordingFrameHeader));
+	auto const end = ptr + frameHeader.size;
+
+	if (frameHeader.kind == RecordingFrameKind::Keyframe)
+	{
+		if (frameHeader.bodyNum != header.bodyNum || frameHeader.size != states.size() * sizeof(RecordedBodyState))
+			return false;
+		std::memcpy(states.data(), ptr, static_cast<std::size_t>(frameHeader.size));
+		return true;
+	}
+
+	std::uint64_t bodyIndex = 0;
+	for (std::uint32_t i = 0; i < frameHeader.bodyNum; i++)
+	{
+		std::uint64_t gap = 0;
+		for (int shift = 0; ; shift += 7)
+		{
+			if (ptr == end || shift > 28)
+				return false;
+			auto const byte = *ptr++;
+			gap |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				break;
+		}
+		bodyIndex += gap;
+		if (bodyIndex >= states.size() || end - ptr < static_cast<std::ptrdiff_t>(RECORDED_STATE_WORD_NUM / 2))
+			return false;
+
+		auto const control = ptr;
+		ptr += RECORDED_STATE_WORD_NUM / 2;
+		std::array<std::uint32_t, RECORDED_STATE_WORD_NUM> words{};
+		std::memcpy(words.data(), &states[bodyIndex], sizeof(RecordedBodyState));
+		for (std::size_t w = 0; w < RECORDED_STATE_WORD_NUM; w++)
+		{
+			auto const byteNum = (control[w / 2] >> (w % 2 * 4)) & 0xF;
+			if (byteNum > 4 || end - ptr < byteNum)
+				return false;
+			for (int b = 0; b < byteNum; b++)
+				words[w] ^= static_cast<std::uint32_t>(*ptr++) << (b * 8);
+		}
+		std::memcpy(static_cast<void*>(&states[bodyIndex]), words.data(), sizeof(RecordedBodyState));
+		bodyIndex++;
+	}
+
+	return ptr == end;
+}
+
+inline std::uint64_t SimulationReplay::getFrameNum() const noexcept
+{
+	return index.size();
+}
+
+inline std::size_t SimulationReplay::getBodyNum() const noexcept
+{
+	return bodies.size();
+}
+
+inline std::uint32_t SimulationReplay::getKeyframeInterval() const noexcept
+{
+	return header.keyframeInterval;
+}
+
+inline bool SimulationReplay::isComplete() const noexcept
+{
+	return complete;
+}
+
+inline bool SimulationReplay::seek(std::uint64_t f)
+{
+	BT_PROFILE("SimulationReplay::seek");
+
+	if (f >= index.size() || index[f].offset == 0)
+		return false;
+
+	auto const& entry = index[f];
+	auto const next_block = [this](std::uint64_t blockOffset) {
+		RecordingFrameHeader frameHeader{};
+		std::memcpy(&frameHeader, file.getData() + blockOffset, sizeof(frameHeader));
+		return blockOffset + sizeof(RecordingFrameHeader) + frameHeader.size;
+	};
+
+	// L[t[̐̃t[Ȃǂ񂾂Ƃ납瑱
+	auto blockOffset = entry.keyframeOffset;
+	if (decodedOffset != 0 && decodedKeyframeOffset == entry.keyframeOffset && decodedOffset <= entry.offset)
+	{
+		if (decodedOffset == entry.offset)
+		{
+			frame = f;
+			return true;
+		}
+		blockOffset = next_block(decodedOffset);
+	}
+
+	// ubN͏ɌԂȂłāAƂɑ傫𒲂ׂĂ
+	decodedOffset = 0;
+	while (true)
+	{
+		if (!decodeBlock(blockOffset))
+			return false;
+		if (blockOffset == entry.offset)
+			break;
+		blockOffset = next_block(blockOffset);
+		if (blockOffset > entry.offset)
+			return false;
+	}
+
+	decodedOffset = entry.offset;
+	decodedKeyframeOffset = entry.keyframeOffset;
+	frame = f;
+	return true;
+}
+
+inline std::uint64_t SimulationReplay::getFrame() const noexcept
+{
+	return frame;
+}
+
+inline std::span<RecordedBodyState const> SimulationReplay::getStates() const noexcept
+{
+	return states;
+}
+
+inline std::size_t SimulationReplay::getInstanceNum(RenderShapeType type) const noexcept
+{
+	return instanceNums[static_cast<std::size_t>(type)];
+}
+
+inline void SimulationReplay::setOutput(RenderShapeType type, RenderInstanceArrays const& arrays) noexcept
+{
+	outputs[static_cast<std::size_t>(type)] = arrays;
+}
+
+inline std::size_t SimulationReplay::extract() const
+{
+	BT_PROFILE("SimulationReplay::extract");
+
+	std::size_t writtenNum = 0;
+	for (std::size_t i = 0; i < bodies.size(); i++)
+	{
+		auto const& body = bodies[i];
+		if (body.renderType < 0 || static_cast<std::size_t>(body.renderType) >= RENDER_SHAPE_TYPE_NUM)
+			continue;
+		auto const& output = outputs[static_cast<std::size_t>(body.renderType)];
+		if (body.slot >= output.capacity)
+			continue;
+
+		auto const& state = states[i];
+		write_render_transform(body.local, get_recorded_transform(state), output.transforms[body.slot]);
+
+		auto const color = get_render_color(state.activationState);
+		output.colors[body.slot] = { static_cast<float>(color.x()), static_cast<float>(color.y()), static_cast<float>(color.z()) };
+		writtenNum++;
+	}
+
+	return writtenNum;
+}
+
+
+inline RecordedBodyState make_recorded_body_state(btRigidBody const* body) noexcept
+{
+	auto const& transform = body->getWorldTransform();
+	auto const rotation = transform.getRotation();
+	auto const to_float3 = [](btVector3 const& v) {
+		return std::array<float, 3>{ static_cast<float>(v.x()), static_cast<float>(v.y()), static_cast<float>(v.z()) };
+	};
+
+	return {
+		.position = to_float3(transform.getOrigin()),
+		.rotation = { static_cast<float>(rotation.x()), static_cast<float>(rotation.y()), static_cast<float>(rotation.z()), static_cast<float>(rotation.w()) },
+		.linearVelocity = to_float3(body->getLinearVelocity()),
+		.angularVelocity = to_float3(body->getAngularVelocity()),
+		.activationState = body->getActivationState(),
+	};
+}
+
+inline btTransform get_recorded_transform(RecordedBodyState const& state) noexcept
+{
+	return btTransform{
+		btQuaternion(state.rotation[0], state.rotation[1], state.rotation[2], state.rotation[3]),
+		btVector3(state.position[0], state.position[1], state.position[2])
+	};
+}
@@ -0,0 +1,428 @@
+#pragma once
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btCollisionConfiguration.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btCollisionDispatcher.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include"../external/bullet3/src/BulletCollision/NarrowPhaseCollision/btPersistentManifold.h"
+#include"../external/bullet3/src/LinearMath/btAlignedAllocator.h"
+#include"../external/bullet3/src/LinearMath/btPoolAllocator.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include<algorithm>
+#include<cstddef>
+#include<new>
+#include<type_traits>
+#include<utility>
+#include<vector>
+
+struct SlabAllocatorStats
+{
+	std::size_t elementSize{};
+	std::size_t chunkNum{};
+	// mۂĂvf̐ƃoCg
+	std::size_t capacity{};
+	std::size_t reservedBytes{};
+	// gĂvf̐
+	std::size_t usedNum{};
+	// XbhƂ̋󂫃Xgɂ̂܂߂āAL̋󂫃XgoĂvf̍ő吔
+	// capacity̐ɂĂΑ
+	std::size_t highWaterNum{};
+	// ݌v
+	std::size_t allocateNum{};
+	// elementSize傫btAlignedAllocɉ񂵂
+	std::size_t fallbackNum{};
+	// XbhƂ̋󂫃XgɂȂāAL̋󂫃Xgɍs
+	std::size_t refillNum{};
+};
+
+// 傫̗vf؂oAP[^AbtPoolAllocatorƈđȂȂ`N𑫂
+// XbhƂɋ󂫃XgAɂȂ邩܂肷ƂbNċL̋󂫃XgƂ܂Ƃ߂ĂƂ肷
+// evf̑Oɂǂ̃AP[^̂̂ûŁAstaticdeallocateł悢
+class SlabAllocator
+{
+	struct alignas(16) Header
+	{
+		// btAlignedAllocɉ񂵂̂Ȃnullptr
+		SlabAllocator* owner = nullptr;
+	};
+	static constexpr std::size_t HEADER_SIZE = sizeof(Header);
+
+	struct FreeNode
+	{
+		FreeNode* next = nullptr;
+	};
+
+	struct Chunk
+	{
+		unsigned char* memory = nullptr;
+		std::size_t num{};
+	};
+
+	// LbVC𕪂āAق̃XbhƎ荇Ȃ悤ɂ
+	struct alignas(64) ThreadCache
+	{
+		FreeNode* head = nullptr;
+		std::size_t num{};
+		// XbhƂɐāAgetStatső
+		std::size_t allocateNum{};
+		std::size_t freeNum{};
+		std::size_t fallbackNum{};
+	};
+
+	std::size_t elementSize{};
+	std::size_t stride{};
+	std::size_t chunkElementNum{};
+	// XbhƂ̋󂫃XgƋL̋󂫃Xg̊ԂňxɈڂ
+	std::size_t batchNum{};
+
+	btSpinMutex mutex{};
+	std::vector<Chunk> chunks{};
+	FreeNode* sharedHead = nullptr;
+	std::size_t sharedNum{};
+	std::size_t capacity{};
+	std::size_t highWaterNum{};
+	std::size_t refillNum{};
+
+	ThreadCache caches[BT_MAX_THREAD_COUNT]{};
+
+public:
+	SlabAllocator(std::size_t elementSize, std::size_t chunkElementNum = 512);
+	virtual ~SlabAllocator();
+	SlabAllocator(SlabAllocator const&) = delete;
+	SlabAllocator& operator=(SlabAllocator const&) = delete;
+
+	// 16oCgEAsizeelementSize傫btAlignedAllocɉ
+	void* allocate(std::size_t size);
+	// ǂSlabAllocatorallocateŎ̂ł悢AnullptrȂ牽Ȃ
+	static void deallocate(void* ptr) noexcept;
+
+	// mۂĂvfnumȏɂ
+	void reserve(std::size_t num);
+	// 瑫`N̗vf
+	void setChunkElementNum(std::size_t num) noexcept;
+	std::size_t getElementSize() const noexcept;
+
+	// S̗vf󂫂ɖ߂AgĂvfĂ̂Ă
+	// Xebv̒gꎞIȃf[^ŁAXebv̏Iɂ܂Ƃ߂Ď̂Ă
+	// ق̃XbhgĂȂƂɌĂ
+	void reset();
+
+	// XbhƂ̐𑫂̂ŁAق̃XbhgĂȂƂɌĂ
+	SlabAllocatorStats getStats() const;
+	// highWaterNum̐ɖ߂āA݌v͍gĂ镪琔
+	void resetStats();
+
+private:
+	void release(void* ptr) noexcept;
+	// L̋󂫃XgXbh̋󂫃XgɈڂAȂ΃`N𑫂
+	void refill(ThreadCache& cache);
+	// mutexĂĂ
+	void addChunk(std::size_t num);
+	void pushChunk(Chunk const& chunk);
+};
+
+// ڐG̃}jtH[hƏՓ˃ASYSlabAllocatorfBXpb`
+// btDefaultCollisionConfiguratioñv[͎gȂ̂ŁAbtDefaultCollisionConstructionInfoŏĂĂ悢
+// DispatcherbtCollisionDispatcherbtCollisionDispatcherMtA͂̂܂ܓn
+template<class Dispatcher>
+class SlabCollisionDispatcher : public Dispatcher
+{
+	static constexpr bool IS_MT = std::is_base_of_v<btCollisionDispatcherMt, Dispatcher>;
+
+	SlabAllocator manifoldAllocator;
+	SlabAllocator algorithmAllocator;
+
+public:
+	template<class... Args>
+	SlabCollisionDispatcher(btCollisionConfiguration* collisionConfiguration, Args&&... args);
+	virtual ~SlabCollisionDispatcher() = default;
+	SlabCollisionDispatcher(SlabCollisionDispatcher const&) = delete;
+	SlabCollisionDispatcher& operator=(SlabCollisionDispatcher const&) = delete;
+
+	SlabAllocator& getManifoldAllocator() noexcept;
+	SlabAllocator& getAlgorithmAllocator() noexcept;
+
+	btPersistentManifold* getNewManifold(btCollisionObject const* body0, btCollisionObject const* body1) override;
+	void releaseManifold(btPersistentManifold* manifold) override;
+	void* allocateCollisionAlgorithm(int size) override;
+	void freeCollisionAlgorithm(void* ptr) override;
+};
+
+
+//
+// ȉA
+//
+
+
+inline SlabAllocator::SlabAllocator(std::size_t elementSize, std::size_t chunkElementNum)
+	: elementSize(std::max(elementSize, sizeof(FreeNode)))
+	, chunkElementNum(std::max<std::size_t>(chunkElementNum, 1))
+{
+	stride = HEADER_SIZE + (this->elementSize + 15) / 16 * 16;
+	// `N1/8AȂƂ16
+	batchNum = std::max<std::size_t>(this->chunkElementNum / 8, 16);
+}
+
+inline SlabAllocator::~SlabAllocator()
+{
+	for (auto const& chunk : chunks)
+		btAlignedFree(chunk.memory);
+}
+
+inline void* SlabAllocator::allocate(std::size_t size)
+{
+	auto& cache = caches[btGetCurrentThreadIndex()];
+
+	if (size > elementSize)
+	{
+		cache.fallbackNum++;
+		auto const header = new (btAlignedAlloc(HEADER_SIZE + size, 16)) Header{};
+		return reinterpret_cast<unsigned char*>(header) + HEADER_SIZE;
+	}
+
+	if (!cache.head)
+		refill(cache);
+	auto const node = cache.head;
+	cache.head = node->next;
+	cache.num--;
+	cache.allocateNum++;
+	return node;
+}
+
+inline void SlabAllocator::deallocate(void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+
+	auto const header = reinterpret_cast<Header*>(static_cast<unsigned char*>(ptr) - HEADER_SIZE);
+	if (header->owner)
+		header->owner->release(ptr);
+	else
+		btAlignedFree(header);
+}
+
+inline void SlabAllocator::reserve(std::size_t num)
+{
+	btMutexLock(&mutex);
+	if (num > capacity)
+		addChunk(num - capacity);
+	btMutexUnlock(&mutex);
+}
+
+inline void SlabAllocator::setChunkElementNum(std::size_t num) noexcept
+{
+	chunkElementNum = std::max<std::size_t>(num, 1);
+}
+
+inline std::size_t SlabAllocator::getElementSize() const noexcept
+{
+	return elementSize;
+}
+
+inline void SlabAllocator::reset()
+{
+	btMutexLock(&mutex);
+	std::size_t allocateNum{};
+	std::size_t freeNum{};
+	for (auto& cache : caches)
+	{
+		allocateNum += cache.allocateNum;
+		freeNum += cache.freeNum;
+		cache.head = nullptr;
+		cache.num = 0;
+	}
+	// ̂Ă͉Ƃɂ
+	caches[0].freeNum += allocateNum - freeNum;
+
+	sharedHead = nullptr;
+	sharedNum = 0;
+	for (auto const& chunk : chunks)
+		pushChunk(chunk);
+	btMutexUnlock(&mutex);
+}
+
+inline SlabAllocatorStats SlabAllocator::getStats() const
+{
+	SlabAllocatorStats stats{
+		.elementSize = elementSize,
+		.chunkNum = chunks.size(),
+		.capacity = capacity,
+		.reservedBytes = capacity * stride,
+		.highWaterNum = highWaterNum,
+		.refillNum = refillNum,
+	};
+	std::size_t freeNum{};
+	for (auto const& cache : caches)
+	{
+		stats.allocateNum += cache.allocateNum;
+		stats.fallbackNum += cache.fallbackNum;
+		freeNum += cache.freeNum;
+	}
+	stats.usedNum = stats.allocateNum - freeNum;
+	return stats;
+}
+
+inline void SlabAllocator::resetStats()
+{
+	btMutexLock(&mutex);
+	highWaterNum = capacity - sharedNum;
+	refillNum = 0;
+	std::size_t usedNum{};
+	for (auto& cache : caches)
+	{
+		usedNum += cache.allocateNum - cache.freeNum;
+		cache.allocateNum = 0;
+		cache.freeNum = 0;
+		cache.fallbackNum = 0;
+	}
+	// gĂ鐔͕ςȂ
+	caches[0].allocateNum = usedNum;
+	btMutexUnlock(&mutex);
+}
+
+inline void SlabAllocator::release(void* ptr) noexcept
+{
+	auto& cache = caches[btGetCurrentThreadIndex()];
+	auto const node = new (ptr) FreeNode{ cache.head };
+	cache.head = node;
+	cache.num++;
+	cache.freeNum++;
+
+	// ܂肷batchNumL̋󂫃XgɕԂ
+	if (cache.num <= batchNum * 2)
+		return;
+
+	auto first = cache.head;
+	auto last = first;
+	for (std::size_t i = 1; i < batchNum; i++)
+		last = last->next;
+	cache.head = last->next;
+	cache.num -= batchNum;
+
+	btMutexLock(&mutex);
+	last->next = sharedHead;
+	sharedHead = first;
+	sharedNum += batchNum;
+	btMutexUnlock(&mutex);
+}
+
+inline void SlabAllocator::refill(ThreadCache& cache)
+{
+	btMutexLock(&mutex);
+	if (sharedNum < batchNum)
+		addChunk(std::max(chunkElementNum, batchNum));
+
+	auto const first = sharedHead;
+	auto last = first;
+	for (std::size_t i = 1; i < batchNum; i++)
+		last = last->next;
+	sharedHead = last->next;
+	sharedNum -= batchNum;
+	refillNum++;
+	highWaterNum = std::max(highWaterNum, capacity - sharedNum);
+	btMutexUnlock(&mutex);
+
+	last->next = cache.head;
+	cache.head = first;
+	cache.num += batchNum;
+}
+
+inline void SlabAllocator::addChunk(std::size_t num)
+{
+	Chunk const chunk{ static_cast<unsigned char*>(btAlignedAlloc(num * stride, 64)), num };
+	chunks.push_back(chunk);
+	capacity += num;
+	pushChunk(chunk);
+}
+
+inline void SlabAllocator::pushChunk(Chunk const& chunk)
+{
+	// 납ςނƁAO珇ɏoĂ
+	for (auto i = chunk.num; i-- > 0;)
+	{
+		auto const slot = chunk.memory + i * stride;
+		new (slot) Header{ this };
+		sharedHead = new (slot + HEADER_SIZE) FreeNode{ sharedHead };
+	}
+	sharedNum += chunk.num;
+}
+
+template<class Dispatcher>
+template<class... Args>
+inline SlabCollisionDispatcher<Dispatcher>::SlabCollisionDispatcher(btCollisionConfiguration* collisionConfiguration, Args&&... args)
+	: Dispatcher(collisionConfiguration, std::forward<Args>(args)...)
+	, manifoldAllocator(sizeof(btPersistentManifold))
+	, algorithmAllocator(static_cast<std::size_t>(collisionConfiguration->getCollisionAlgorithmPool()->getElementSize()))
+{
+}
+
+template<class Dispatcher>
+inline SlabAllocator& SlabCollisionDispatcher<Dispatcher>::getManifoldAllocator() noexcept
+{
+	return manifoldAllocator;
+}
+
+template<class Dispatcher>
+inline SlabAllocator& SlabCollisionDispatcher<Dispatcher>::getAlgorithmAllocator() noexcept
+{
+	return algorithmAllocator;
+}
+
+template<class Dispatcher>
+inline btPersistentManifold* SlabCollisionDispatcher<Dispatcher>::getNewManifold(btCollisionObject const* body0, btCollisionObject const* body1)
+{
+	// btCollisionDispatcher::getNewManifoldƓAv[̑manifoldAllocator
+	auto const contactBreakingThreshold = (this->m_dispatcherFlags & btCollisionDispatcher::CD_USE_RELATIVE_CONTACT_BREAKING_THRESHOLD) ?
+		btMin(body0->getCollisionShape()->getContactBreakingThreshold(gContactBreakingThreshold), body1->getCollisionShape()->getContactBreakingThreshold(gContactBreakingThreshold)) :
+		gContactBreakingThreshold;
+	auto const contactProcessingThreshold = btMin(body0->getContactProcessingThreshold(), body1->getContactProcessingThreshold());
+
+	auto const manifold = new (manifoldAllocator.allocate(sizeof(btPersistentManifold)))
+		btPersistentManifold(body0, body1, 0, contactBreakingThreshold, contactProcessingThreshold);
+
+	// btCollisionDispatcherMt̓yAɉ񂵂ĂԂ̓XbhƂɗ߂āAł܂Ƃ߂đ
+	if constexpr (IS_MT)
+	{
+		if (this->m_batchUpdating)
+		{
+			this->m_batchManifoldsPtr[btGetCurrentThreadIndex()].push_back(manifold);
+			return manifold;
+		}
+	}
+	manifold->m_index1a = this->m_manifoldsPtr.size();
+	this->m_manifoldsPtr.push_back(manifold);
+	return manifold;
+}
+
+template<class Dispatcher>
+inline void SlabCollisionDispatcher<Dispatcher>::releaseManifold(btPersistentManifold* manifold)
+{
+	if constexpr (IS_MT)
+	{
+		if (this->m_batchUpdating)
+		{
+			this->m_batchReleasePtr[btGetCurrentThreadIndex()].push_back(manifold);
+			return;
+		}
+	}
+
+	this->clearManifold(manifold);
+	auto const index = manifold->m_index1a;
+	btAssert(index < this->m_manifoldsPtr.size());
+	this->m_manifoldsPtr.swap(index, this->m_manifoldsPtr.size() - 1);
+	this->m_manifoldsPtr[index]->m_index1a = index;
+	this->m_manifoldsPtr.pop_back();
+
+	manifold->~btPersistentManifold();
+	SlabAllocator::deallocate(manifold);
+}
+
+template<class Dispatcher>
+inline void* SlabCollisionDispatcher<Dispatcher>::allocateCollisionAlgorithm(int size)
+{
+	return algorithmAllocator.allocate(static_cast<std::size_t>(size));
+}
+
+template<class Dispatcher>
+inline void SlabCollisionDispatcher<Dispatcher>::freeCollisionAlgorithm(void* ptr)
+{
+	SlabAllocator::deallocate(ptr);
+}
@@ -0,0 +1,708 @@
+#pragma once
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include<algorithm>
+#include<array>
+#include<numeric>
+#include<vector>
+#if defined(__AVX__)
+#include<immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include<emmintrin.h>
+#endif
+
+// 1ubNœɉs̐
+// {xȂAVX2߁ASSE24ߕ
+constexpr int SOA_SOLVER_LANE_NUM = 8;
+
+// ubŇvZɎgSIMD̃xNg
+// RpC̎xNǵAۂ߂ςɕȂȂ̂őgݍ݊֐ŏ
+// x86łȂ1vfŌvZ
+struct SoaSolverVector
+{
+#if defined(BT_USE_DOUBLE_PRECISION) && defined(__AVX__)
+	static constexpr int WIDTH = 4;
+	__m256d v;
+#elif defined(BT_USE_DOUBLE_PRECISION) && (defined(__SSE2__) || defined(_M_X64))
+	static constexpr int WIDTH = 2;
+	__m128d v;
+#elif !defined(BT_USE_DOUBLE_PRECISION) && defined(__AVX__)
+	static constexpr int WIDTH = 8;
+	__m256 v;
+#elif !defined(BT_USE_DOUBLE_PRECISION) && (defined(__SSE2__) || defined(_M_X64))
+	static constexpr int WIDTH = 4;
+	__m128 v;
+#else
+	static constexpr int WIDTH = 1;
+	btScalar v;
+#endif
+};
+
+// řʁASIMDȂSrbg10̗vf
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+using SoaSolverMask = SoaSolverVector;
+#else
+using SoaSolverMask = bool;
+#endif
+
+SoaSolverVector soa_load(btScalar const* p) noexcept;
+void soa_store(btScalar* p, SoaSolverVector a) noexcept;
+SoaSolverVector soa_set(btScalar a) noexcept;
+SoaSolverVector operator+(SoaSolverVector a, SoaSolverVector b) noexcept;
+SoaSolverVector operator-(SoaSolverVector a, SoaSolverVector b) noexcept;
+SoaSolverVector operator*(SoaSolverVector a, SoaSolverVector b) noexcept;
+SoaSolverVector operator/(SoaSolverVector a, SoaSolverVector b) noexcept;
+// ]A-0
+SoaSolverVector operator-(SoaSolverVector a) noexcept;
+SoaSolverMask soa_less(SoaSolverVector a, SoaSolverVector b) noexcept;
+SoaSolverMask soa_greater(SoaSolverVector a, SoaSolverVector b) noexcept;
+// NaNtrueAbtScalar!=Ɠ
+SoaSolverMask soa_not_equal(SoaSolverVector a, SoaSolverVector b) noexcept;
+// maskĂaAłȂb
+SoaSolverVector soa_select(SoaSolverMask mask, SoaSolverVector a, SoaSolverVector b) noexcept;
+
+// ʁX̃ob`̍sLANE_NUM{ׂSoA
+// tF[Ỹob`ǂ͍̂LȂ̂ŁA[ǂ͊Ȃ
+// vZ̏btSequentialImpulseConstraintSolver1s֐ƓɂāAʂɂ
+// tʂƌŴ͍Ƃ̒lȂ̂ŁA[ɍ̂ǂݍނƂɎ
+struct SoaSolverRowBlock
+{
+	static constexpr int LANE_NUM = SOA_SOLVER_LANE_NUM;
+
+	alignas(64) btScalar normal1[3][LANE_NUM]{};
+	alignas(64) btScalar crossNormal1[3][LANE_NUM]{};
+	alignas(64) btScalar normal2[3][LANE_NUM]{};
+	alignas(64) btScalar crossNormal2[3][LANE_NUM]{};
+	alignas(64) btScalar angularA[3][LANE_NUM]{};
+	alignas(64) btScalar angularB[3][LANE_NUM]{};
+	alignas(64) btScalar rhs[LANE_NUM]{};
+	alignas(64) btScalar cfm[LANE_NUM]{};
+	alignas(64) btScalar jacDiagABInv[LANE_NUM]{};
+	alignas(64) btScalar lowerLimit[LANE_NUM]{};
+	alignas(64) btScalar upperLimit[LANE_NUM]{};
+	alignas(64) btScalar friction[LANE_NUM]{};
+	alignas(64) btScalar appliedImpulse[LANE_NUM]{};
+	int bodyA[LANE_NUM]{};
+	int bodyB[LANE_NUM]{};
+	// x̕ς鍄̂߂AÓIȍ̂͑S̃[ŋL
+	bool writeA[LANE_NUM]{};
+	bool writeB[LANE_NUM]{};
+	// s̃v[ł̔ԍA-1Ȃlߕ
+	int row[LANE_NUM]{};
+};
+
+// ォ珇ɉubN͈̔́A[Ƃɂ̃ob`𑱂ĉ
+struct SoaSolverLaneGroup
+{
+	int blockBegin{};
+	int blockEnd{};
+};
+
+// btBatchedConstraints̃tF[YƂ̉
+struct SoaSolverPhase
+{
+	int groupBegin{};
+	int groupEnd{};
+	// falseȂlߕ̂ŁÅ֐Ńob`Ƃɉ
+	bool soa = false;
+};
+
+// constraint̍sblocklaneɎʂAconstraintnullptrȂ牽Ȃlߕɂ
+void write_soa_solver_row(SoaSolverRowBlock& block, int lane, int row, btSolverConstraint const* constraint, btSolverBody const* bodies);
+
+// blockNum̃ubNォ珇1񂸂Ďc2aԂ
+// contactBlocksnƖC̍sƂāAʒu̐ڐG̗͐ςŏ㉺߁A͐ς0ȉ̃[͉Ȃ
+// ̂̑gԂ͑x̕ωʂ[Ɏ܂܂ɂ
+btScalar solve_soa_solver_blocks(SoaSolverRowBlock* blocks, int blockNum, btSolverBody* bodies, SoaSolverRowBlock const* contactBlocks);
+
+// ڐGƖC̍sSoÃubNɂLANE_NUM{btSequentialImpulseConstraintSolverMt
+// btBatchedConstraints̓tF[Ỹob`[Ɋ蓖āA[̒͌̃ob`Ɠŉ
+// tF[YƂɃXbh̐O[vAob`Z[ɋl߂Ă
+// ob`ă[܂ȂtF[Y͌̂܂܉
+// ob`[𖄂߂悤ɁASceneConfig::solverMinBatchSizeȂǂŃob`ĂƂ悢
+// ֐߁A[OCAXvbgCpX͌̂܂
+// ob`gȂƂAԂ_ɂƂAڐGƖC݂ɉƂAC2̂Ƃ̂܂
+class SoaContactSolverMt : public btSequentialImpulseConstraintSolverMt
+{
+	std::vector<SoaSolverRowBlock> contactBlocks{};
+	std::vector<SoaSolverRowBlock> frictionBlocks{};
+	std::vector<SoaSolverLaneGroup> laneGroups{};
+	std::vector<SoaSolverPhase> phases{};
+	// tF[YƂɃ[֋l߂Ƃ̍Ɨp
+	std::vector<int> batchOrder{};
+	std::vector<int> batchLane{};
+	std::vector<int> laneLength{};
+	std::vector<int> laneOffset{};
+	std::vector<int> laneRows{};
+
+	bool useSoa = false;
+	// [̖܂銄菬tF[Y͌̂܂܉
+	btScalar minLaneFill = 0.9;
+	std::size_t soaRowNum{};
+	std::size_t soaSlotNum{};
+
+public:
+	SoaContactSolverMt() = default;
+	virtual ~SoaContactSolverMt() = default;
+	SoaContactSolverMt(SoaContactSolverMt const&) = delete;
+	SoaContactSolverMt& operator=(SoaContactSolverMt const&) = delete;
+
+	btScalar solveGroupCacheFriendlySetup(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds,
+		btTypedConstraint** constraints, int numConstraints, btContactSolverInfo const& infoGlobal, btIDebugDraw* debugDrawer) override;
+	btScalar solveGroupCacheFriendlyIterations(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds,
+		btTypedConstraint** constraints, int numConstraints, btContactSolverInfo const& infoGlobal, btIDebugDraw* debugDrawer) override;
+
+	void setMinLaneFill(btScalar fill) noexcept;
+	btScalar getMinLaneFill() const noexcept;
+
+	// OsolveGroupSoÃubNg
+	bool isSoaUsed() const noexcept;
+	// OsolveGroupSoÃubNɂlߕ܂߂s̐A܂Ă銄
+	std::size_t getSoaRowNum() const noexcept;
+	std::size_t getSoaPaddingNum() const noexcept;
+
+protected:
+	btScalar resolveAllContactConstraints() override;
+	btScalar resolveAllContactFrictionConstraints() override;
+
+private:
+	void setupSoaBlocks();
+	// isFrictionȂfrictionBlocks
+	btScalar resolveSoaBlocks(bool isFriction);
+	// ubN̗͐ςv[ɏ߂
+	void writeBackSoaImpulses(bool isFriction, int groupBegin, int groupEnd);
+};
+
+//
+// ȉA
+//
+
+#if defined(BT_USE_DOUBLE_PRECISION) && defined(__AVX__)
+
+inline SoaSolverVector soa_load(btScalar const* p) noexcept { return { _mm256_load_pd(p) }; }
+inline void soa_store(btScalar* p, SoaSolverVector a) noexcept { _mm256_store_pd(p, a.v); }
+inline SoaSolverVector soa_set(btScalar a) noexcept { return { _mm256_set1_pd(a) }; }
+inline SoaSolverVector operator+(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_add_pd(a.v, b.v) }; }
+inline SoaSolverVector operator-(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_sub_pd(a.v, b.v) }; }
+inline SoaSolverVector operator*(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_mul_pd(a.v, b.v) }; }
+inline SoaSolverVector operator/(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_div_pd(a.v, b.v) }; }
+inline SoaSolverVector operator-(SoaSolverVector a) noexcept { return { _mm256_xor_pd(a.v, _mm256_set1_pd(-0.)) }; }
+inline SoaSolverMask soa_less(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ) }; }
+inline SoaSolverMask soa_greater(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ) }; }
+inline SoaSolverMask soa_not_equal(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_cmp_pd(a.v, b.v, _CMP_NEQ_UQ) }; }
+inline SoaSolverVector soa_select(SoaSolverMask mask, SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_blendv_pd(b.v, a.v, mask.v) }; }
+
+#elif defined(BT_USE_DOUBLE_PRECISION) && (defined(__SSE2__) || defined(_M_X64))
+
+inline SoaSolverVector soa_load(btScalar const* p) noexcept { return { _mm_load_pd(p) }; }
+inline void soa_store(btScalar* p, SoaSolverVector a) noexcept { _mm_store_pd(p, a.v); }
+inline SoaSolverVector soa_set(btScalar a) noexcept { return { _mm_set1_pd(a) }; }
+inline SoaSolverVector operator+(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_add_pd(a.v, b.v) }; }
+inline SoaSolverVector operator-(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_sub_pd(a.v, b.v) }; }
+inline SoaSolverVector operator*(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_mul_pd(a.v, b.v) }; }
+inline SoaSolverVector operator/(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_div_pd(a.v, b.v) }; }
+inline SoaSolverVector operator-(SoaSolverVector a) noexcept { return { _mm_xor_pd(a.v, _mm_set1_pd(-0.)) }; }
+inline SoaSolverMask soa_less(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_cmplt_pd(a.v, b.v) }; }
+inline SoaSolverMask soa_greater(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_cmpgt_pd(a.v, b.v) }; }
+inline SoaSolverMask soa_not_equal(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_cmpneq_pd(a.v, b.v) }; }
+inline SoaSolverVector soa_select(SoaSolverMask mask, SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_or_pd(_mm_and_pd(mask.v, a.v), _mm_andnot_pd(mask.v, b.v)) }; }
+
+#elif !defined(BT_USE_DOUBLE_PRECISION) && defined(__AVX__)
+
+inline SoaSolverVector soa_load(btScalar const* p) noexcept { return { _mm256_load_ps(p) }; }
+inline void soa_store(btScalar* p, SoaSolverVector a) noexcept { _mm256_store_ps(p, a.v); }
+inline SoaSolverVector soa_set(btScalar a) noexcept { return { _mm256_set1_ps(a) }; }
+inline SoaSolverVector operator+(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_add_ps(a.v, b.v) }; }
+inline SoaSolverVector operator-(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_sub_ps(a.v, b.v) }; }
+inline SoaSolverVector operator*(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_mul_ps(a.v, b.v) }; }
+inline SoaSolverVector operator/(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_div_ps(a.v, b.v) }; }
+inline SoaSolverVector operator-(SoaSolverVector a) noexcept { return { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.f)) }; }
+inline SoaSolverMask soa_less(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline SoaSolverMask soa_greater(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline SoaSolverMask soa_not_equal(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ) }; }
+inline SoaSolverVector soa_select(SoaSolverMask mask, SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+
+#elif !defined(BT_USE_DOUBLE_PRECISION) && (defined(__SSE2__) || defined(_M_X64))
+
+inline SoaSolverVector soa_load(btScalar const* p) noexcept { return { _mm_load_ps(p) }; }
+inline void soa_store(btScalar* p, SoaSolverVector a) noexcept { _mm_store_ps(p, a.v); }
+inline SoaSolverVector soa_set(btScalar a) noexcept { return { _mm_set1_ps(a) }; }
+inline SoaSolverVector operator+(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_add_ps(a.v, b.v) }; }
+inline SoaSolverVector operator-(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_sub_ps(a.v, b.v) }; }
+inline SoaSolverVector operator*(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_mul_ps(a.v, b.v) }; }
+inline SoaSolverVector operator/(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_div_ps(a.v, b.v) }; }
+inline SoaSolverVector operator-(SoaSolverVector a) noexcept { return { _mm_xor_ps(a.v, _mm_set1_ps(-0.f)) }; }
+inline SoaSolverMask soa_less(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline SoaSolverMask soa_greater(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline SoaSolverMask soa_not_equal(SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_cmpneq_ps(a.v, b.v) }; }
+inline SoaSolverVector soa_select(SoaSolverMask mask, SoaSolverVector a, SoaSolverVector b) noexcept { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+
+#else
+
+inline SoaSolverVector soa_load(btScalar const* p) noexcept { return { *p }; }
+inline void soa_store(btScalar* p, SoaSolverVector a) noexcept { *p = a.v; }
+inline SoaSolverVector soa_set(btScalar a) noexcept { return { a }; }
+inline SoaSolverVector operator+(SoaSolverVector a, SoaSolverVector b) noexcept { return { a.v + b.v }; }
+inline SoaSolverVector operator-(SoaSolverVector a, SoaSolverVector b) noexcept { return { a.v - b.v }; }
+inline SoaSolverVector operator*(SoaSolverVector a, SoaSolverVector b) noexcept { return { a.v * b.v }; }
+inline SoaSolverVector operator/(SoaSolverVector a, SoaSolverVector b) noexcept { return { a.v / b.v }; }
+inline SoaSolverVector operator-(SoaSolverVector a) noexcept { return { -a.v }; }
+inline SoaSolverMask soa_less(SoaSolverVector a, SoaSolverVector b) noexcept { return a.v < b.v; }
+inline SoaSolverMask soa_greater(SoaSolverVector a, SoaSolverVector b) noexcept { return a.v > b.v; }
+inline SoaSolverMask soa_not_equal(SoaSolverVector a, SoaSolverVector b) noexcept { return a.v != b.v; }
+inline SoaSolverVector soa_select(SoaSolverMask mask, SoaSolverVector a, SoaSolverVector b) noexcept { return mask ? a : b; }
+
+#endif
+
+inline void write_soa_solver_row(SoaSolverRowBlock& block, int lane, int row, btSolverConstraint const* constraint, btSolverBody const* bodies)
+{
+	block.row[lane] = constraint ? row : -1;
+	if (!constraint)
+	{
+		// ㉺0Ȃ̂ŗ͐ς0̂܂܁Ac0ɂȂ
+		for (int j = 0; j < 3; j++)
+		{
+			block.normal1[j][lane] = block.crossNormal1[j][lane] = block.normal2[j][lane] = block.crossNormal2[j][lane] = btScalar(0.);
+			block.angularA[j][lane] = block.angularB[j][lane] = btScalar(0.);
+		}
+		block.rhs[lane] = block.cfm[lane] = btScalar(0.);
+		block.jacDiagABInv[lane] = btScalar(1.);
+		block.lowerLimit[lane] = block.upperLimit[lane] = block.friction[lane] = block.appliedImpulse[lane] = btScalar(0.);
+		block.bodyA[lane] = block.bodyB[lane] = 0;
+		block.writeA[lane] = block.writeB[lane] = false;
+		return;
+	}
+
+	auto const& bodyA = bodies[constraint->m_solverBodyIdA];
+	auto const& bodyB = bodies[constraint->m_solverBodyIdB];
+
+	for (int j = 0; j < 3; j++)
+	{
+		block.normal1[j][lane] = constraint->m_contactNormal1[j];
+		block.crossNormal1[j][lane] = constraint->m_relpos1CrossNormal[j];
+		block.normal2[j][lane] = constraint->m_contactNormal2[j];
+		block.crossNormal2[j][lane] = constraint->m_relpos2CrossNormal[j];
+		block.angularA[j][lane] = constraint->m_angularComponentA[j];
+		block.angularB[j][lane] = constraint->m_angularComponentB[j];
+	}
+	block.rhs[lane] = constraint->m_rhs;
+	block.cfm[lane] = constraint->m_cfm;
+	block.jacDiagABInv[lane] = constraint->m_jacDiagABInv;
+	block.lowerLimit[lane] = constraint->m_lowerLimit;
+	block.upperLimit[lane] = constraint->m_upperLimit;
+	block.friction[lane] = constraint->m_friction;
+	block.appliedImpulse[lane] = constraint->m_appliedImpulse;
+	block.bodyA[lane] = constraint->m_solverBodyIdA;
+	block.bodyB[lane] = constraint->m_solverBodyIdB;
+	block.writeA[lane] = bodyA.m_originalBody && !bodyA.m_originalBody->isStaticOrKinematicObject();
+	block.writeB[lane] = bodyB.m_originalBody && !bodyB.m_originalBody->isStaticOrKinematicObject();
+}
+
+inline btScalar solve_soa_solver_blocks(SoaSolverRowBlock* blocks, int blockNum, btSolverBody* bodies, SoaSolverRowBlock const* contactBlocks)
+{
+	constexpr int LANE_NUM = SoaSolverRowBlock::LANE_NUM;
+
+	// [Ă鍄̂̑x̕ω
+	alignas(64) btScalar linearVelocityA[3][LANE_NUM];
+	alignas(64) btScalar angularVelocityA[3][LANE_NUM];
+	alignas(64) btScalar linearVelocityB[3][LANE_NUM];
+	alignas(64) btScalar angularVelocityB[3][LANE_NUM];
+	alignas(64) btScalar invMassA[3][LANE_NUM];
+	alignas(64) btScalar linearFactorA[3][LANE_NUM];
+	alignas(64) btScalar angularFactorA[3][LANE_NUM];
+	alignas(64) btScalar invMassB[3][LANE_NUM];
+	alignas(64) btScalar linearFactorB[3][LANE_NUM];
+	alignas(64) btScalar angularFactorB[3][LANE_NUM];
+	int bodyA[LANE_NUM];
+	int bodyB[LANE_NUM];
+	bool writeA[LANE_NUM]{};
+	bool writeB[LANE_NUM]{};
+	std::fill_n(bodyA, LANE_NUM, -1);
+	std::fill_n(bodyB, LANE_NUM, -1);
+
+	// ̂ĝ͓[̑O̍sȂ̂ŁÂςƂɏ߂΂悢
+	auto const store = [&](int i) {
+		if (writeA[i])
+		{
+			auto& body = bodies[bodyA[i]];
+			body.m_deltaLinearVelocity.setValue(linearVelocityA[0][i], linearVelocityA[1][i], linearVelocityA[2][i]);
+			body.m_deltaAngularVelocity.setValue(angularVelocityA[0][i], angularVelocityA[1][i], angularVelocityA[2][i]);
+		}
+		if (writeB[i])
+		{
+			auto& body = bodies[bodyB[i]];
+			body.m_deltaLinearVelocity.setValue(linearVelocityB[0][i], linearVelocityB[1][i], linearVelocityB[2][i]);
+			body.m_deltaAngularVelocity.setValue(angularVelocityB[0][i], angularVelocityB[1][i], angularVelocityB[2][i]);
+		}
+	};
+
+	// [ƂɑāAŌɂ܂Ƃ߂
+	alignas(64) btScalar residual[LANE_NUM]{};
+	for (int b = 0; b < blockNum; b++)
+	{
+		auto& block = blocks[b];
+		auto const contactBlock = contactBlocks ? &contactBlocks[b] : nullptr;
+
+		for (int i = 0; i < LANE_NUM; i++)
+		{
+			if (block.bodyA[i] == bodyA[i] && block.bodyB[i] == bodyB[i])
+				continue;
+			store(i);
+			bodyA[i] = block.bodyA[i];
+			bodyB[i] = block.bodyB[i];
+			writeA[i] = block.writeA[i];
+			writeB[i] = block.writeB[i];
+			// btSolverBody::internalApplyImpulseƓA̍̂ȂΑxςȂ
+			auto const& a = bodies[bodyA[i]];
+			auto const& c = bodies[bodyB[i]];
+			auto const scaleA = a.m_originalBody ? btScalar(1.) : btScalar(0.);
+			auto const scaleB = c.m_originalBody ? btScalar(1.) : btScalar(0.);
+			for (int j = 0; j < 3; j++)
+			{
+				linearVelocityA[j][i] = a.m_deltaLinearVelocity[j];
+				angularVelocityA[j][i] = a.m_deltaAngularVelocity[j];
+				invMassA[j][i] = a.m_invMass[j];
+				linearFactorA[j][i] = a.m_linearFactor[j] * scaleA;
+				angularFactorA[j][i] = a.m_angularFactor[j] * scaleA;
+				linearVelocityB[j][i] = c.m_deltaLinearVelocity[j];
+				angularVelocityB[j][i] = c.m_deltaAngularVelocity[j];
+				invMassB[j][i] = c.m_invMass[j];
+				linearFactorB[j][i] = c.m_linearFactor[j] * scaleB;
+				angularFactorB[j][i] = c.m_angularFactor[j] * scaleB;
+			}
+		}
+
+		for (int i = 0; i < LANE_NUM; i += SoaSolverVector::WIDTH)
+		{
+			auto const load3 = [i](btScalar const (&a)[3][LANE_NUM]) {
+				return std::array<SoaSolverVector, 3>{ soa_load(&a[0][i]), soa_load(&a[1][i]), soa_load(&a[2][i]) };
+			};
+			// btVector3::dotƓő
+			auto const dot = [](std::array<SoaSolverVector, 3> const& a, std::array<SoaSolverVector, 3> const& b) {
+				return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+			};
+			auto const normal1 = load3(block.normal1);
+			auto const normal2 = load3(block.normal2);
+			auto const linearA = load3(linearVelocityA);
+			auto const angularA = load3(angularVelocityA);
+			auto const linearB = load3(linearVelocityB);
+			auto const angularB = load3(angularVelocityB);
+			auto const jacDiagABInv = soa_load(&block.jacDiagABInv[i]);
+			auto const appliedImpulse = soa_load(&block.appliedImpulse[i]);
+
+			auto deltaImpulse = soa_load(&block.rhs[i]) - appliedImpulse * soa_load(&block.cfm[i]);
+			auto const deltaVel1Dotn = dot(normal1, linearA) + dot(load3(block.crossNormal1), angularA);
+			auto const deltaVel2Dotn = dot(normal2, linearB) + dot(load3(block.crossNormal2), angularB);
+			deltaImpulse = deltaImpulse - deltaVel1Dotn * jacDiagABInv;
+			deltaImpulse = deltaImpulse - deltaVel2Dotn * jacDiagABInv;
+
+			// CȂڐG̗͐ςŏ㉺߂
+			auto const totalImpulse = contactBlock ? soa_load(&contactBlock->appliedImpulse[i]) : soa_set(0.);
+			auto const upperLimit = contactBlock ? soa_load(&block.friction[i]) * totalImpulse : soa_load(&block.upperLimit[i]);
+			auto const lowerLimit = contactBlock ? -upperLimit : soa_load(&block.lowerLimit[i]);
+
+			auto const sum = appliedImpulse + deltaImpulse;
+			auto clamped = soa_select(soa_less(sum, lowerLimit), lowerLimit, soa_select(soa_greater(sum, upperLimit), upperLimit, sum));
+			deltaImpulse = soa_select(soa_not_equal(clamped, sum), clamped - appliedImpulse, deltaImpulse);
+
+			// ڐG̗͐ς0ȉ̖C͉Ȃ
+			if (contactBlock)
+			{
+				auto const active = soa_greater(totalImpulse, soa_set(0.));
+				deltaImpulse = soa_select(active, deltaImpulse, soa_set(0.));
+				clamped = soa_select(active, clamped, appliedImpulse);
+			}
+			soa_store(&block.appliedImpulse[i], clamped);
+
+			// btSolverBody::internalApplyImpulseƓł
+			for (int j = 0; j < 3; j++)
+			{
+				soa_store(&linearVelocityA[j][i], linearA[j] + normal1[j] * soa_load(&invMassA[j][i]) * deltaImpulse * soa_load(&linearFactorA[j][i]));
+				soa_store(&angularVelocityA[j][i], angularA[j] + soa_load(&block.angularA[j][i]) * (deltaImpulse * soa_load(&angularFactorA[j][i])));
+				soa_store(&linearVelocityB[j][i], linearB[j] + normal2[j] * soa_load(&invMassB[j][i]) * deltaImpulse * soa_load(&linearFactorB[j][i]));
+				soa_store(&angularVelocityB[j][i], angularB[j] + soa_load(&block.angularB[j][i]) * (deltaImpulse * soa_load(&angularFactorB[j][i])));
+			}
+
+			auto const scaled = deltaImpulse * (soa_set(1.) / jacDiagABInv);
+			soa_store(&residual[i], soa_load(&residual[i]) + scaled * scaled);
+		}
+	}
+
+	btScalar residualSum = 0.;
+	for (int i = 0; i < LANE_NUM; i++)
+	{
+		store(i);
+		residualSum += residual[i];
+	}
+	return residualSum;
+}
+
+inline btScalar SoaContactSolverMt::solveGroupCacheFriendlySetup(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds,
+	btTypedConstraint** constraints, int numConstraints, btContactSolverInfo const& infoGlobal, btIDebugDraw* debugDrawer)
+{
+	auto const result = btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlySetup(bodies, numBodies, manifoldPtr, numManifolds,
+		constraints, numConstraints, infoGlobal, debugDrawer);
+
+	// s̏Ԃ▀C̐ςݒł͌̂܂܉
+	auto const unsupportedMode = SOLVER_RANDMIZE_ORDER | SOLVER_INTERLEAVE_CONTACT_AND_FRICTION_CONSTRAINTS;
+	useSoa = m_useBatching && m_numFrictionDirections == 1 && (infoGlobal.m_solverMode & unsupportedMode) == 0;
+	if (useSoa)
+		setupSoaBlocks();
+
+	return result;
+}
+
+inline btScalar SoaContactSolverMt::solveGroupCacheFriendlyIterations(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifoldPtr, int numManifolds,
+	btTypedConstraint** constraints, int numConstraints, btContactSolverInfo const& infoGlobal, btIDebugDraw* debugDrawer)
+{
+	auto const result = btSequentialImpulseConstraintSolverMt::solveGroupCacheFriendlyIterations(bodies, numBodies, manifoldPtr, numManifolds,
+		constraints, numConstraints, infoGlobal, debugDrawer);
+
+	// solveGroupCacheFriendlyFinish̓v[̗͐ς
+	if (useSoa)
+	{
+		BT_PROFILE("writeBackSoaImpulses");
+		auto const groupNum = static_cast<int>(laneGroups.size());
+		writeBackSoaImpulses(false, 0, groupNum);
+		writeBackSoaImpulses(true, 0, groupNum);
+	}
+
+	return result;
+}
+
+inline void SoaContactSolverMt::setMinLaneFill(btScalar fill) noexcept
+{
+	minLaneFill = fill;
+}
+
+inline btScalar SoaContactSolverMt::getMinLaneFill() const noexcept
+{
+	return minLaneFill;
+}
+
+inline bool SoaContactSolverMt::isSoaUsed() const noexcept
+{
+	return useSoa && !laneGroups.empty();
+}
+
+inline std::size_t SoaContactSolverMt::getSoaRowNum() const noexcept
+{
+	return useSoa ? soaSlotNum : 0;
+}
+
+inline std::size_t SoaContactSolverMt::getSoaPaddingNum() const noexcept
+{
+	return useSoa ? soaSlotNum - soaRowNum : 0;
+}
+
+inline btScalar SoaContactSolverMt::resolveAllContactConstraints()
+{
+	if (!useSoa)
+		return btSequentialImpulseConstraintSolverMt::resolveAllContactConstraints();
+	BT_PROFILE("resolveAllContactConstraintsSoa");
+	return resolveSoaBlocks(false);
+}
+
+inline btScalar SoaContactSolverMt::resolveAllContactFrictionConstraints()
+{
+	if (!useSoa)
+		return btSequentialImpulseConstraintSolverMt::resolveAllContactFrictionConstraints();
+	BT_PROFILE("resolveAllContactFrictionConstraintsSoa");
+	return resolveSoaBlocks(true);
+}
+
+inline void SoaContactSolverMt::setupSoaBlocks()
+{
+	BT_PROFILE("setupSoaBlocks");
+	auto const& batched = m_batchedContactConstraints;
+	constexpr int LANE_NUM = SoaSolverRowBlock::LANE_NUM;
+	auto const bodies = &m_tmpSolverBodyPool[0];
+
+	// XbhɔzO[v̐A1XbhȂtF[YƂ1
+	auto const scheduler = btGetTaskScheduler();
+	auto const threadNum = scheduler ? std::max(scheduler->getNumThreads(), 1) : 1;
+
+	// ubN͑ŜŁA傫Ƃresize
+	auto blockNum = 0;
+	auto const reserveBlocks = [&](int stepNum) {
+		blockNum += stepNum;
+		if (contactBlocks.size() < static_cast<std::size_t>(blockNum))
+		{
+			contactBlocks.resize(static_cast<std::size_t>(blockNum));
+			frictionBlocks.resize(static_cast<std::size_t>(blockNum));
+		}
+	};
+	laneGroups.clear();
+	phases.clear();
+	soaRowNum = 0;
+	soaSlotNum = 0;
+
+	for (int phaseIndex = 0; phaseIndex < batched.m_phases.size(); phaseIndex++)
+	{
+		auto const& phase = batched.m_phases[phaseIndex];
+		auto const batchNum = phase.end - phase.begin;
+		auto const groupNum = std::min((batchNum + LANE_NUM - 1) / LANE_NUM, threadNum);
+		auto const laneNum = groupNum * LANE_NUM;
+		auto const batchLength = [&](int batch) { return batched.m_batches[batch].end - batched.m_batches[batch].begin; };
+
+		// ob`珇ɁAԒZ[̌ɕt
+		batchOrder.resize(static_cast<std::size_t>(batchNum));
+		std::iota(batchOrder.begin(), batchOrder.end(), phase.begin);
+		std::stable_sort(batchOrder.begin(), batchOrder.end(), [&](int a, int b) { return batchLength(a) > batchLength(b); });
+
+		batchLane.resize(static_cast<std::size_t>(batchNum));
+		laneLength.assign(static_cast<std::size_t>(laneNum), 0);
+		for (int i = 0; i < batchNum; i++)
+		{
+			auto const lane = static_cast<int>(std::min_element(laneLength.begin(), laneLength.end()) - laneLength.begin());
+			batchLane[static_cast<std::size_t>(i)] = lane;
+			laneLength[static_cast<std::size_t>(lane)] += batchLength(batchOrder[static_cast<std::size_t>(i)]);
+		}
+
+		// [Ƃɍsׂ
+		laneOffset.resize(static_cast<std::size_t>(laneNum) + 1);
+		laneOffset[0] = 0;
+		for (int lane = 0; lane < laneNum; lane++)
+			laneOffset[static_cast<std::size_t>(lane) + 1] = laneOffset[static_cast<std::size_t>(lane)] + laneLength[static_cast<std::size_t>(lane)];
+		laneRows.resize(static_cast<std::size_t>(laneOffset.back()));
+		laneLength.assign(static_cast<std::size_t>(laneNum), 0);
+		for (int i = 0; i < batchNum; i++)
+		{
+			auto const lane = static_cast<std::size_t>(batchLane[static_cast<std::size_t>(i)]);
+			auto const& batch = batched.m_batches[batchOrder[static_cast<std::size_t>(i)]];
+			for (int c = batch.begin; c < batch.end; c++)
+				laneRows[static_cast<std::size_t>(laneOffset[lane] + laneLength[lane]++)] = batched.m_constraintIndices[c];
+		}
+
+		// lߕ΂ɂȂtF[Y̓ubNɂȂ
+		auto const groupBegin = static_cast<int>(laneGroups.size());
+		auto const groupStepNum = [&](int group) {
+			auto const firstLane = laneLength.begin() + group * LANE_NUM;
+			return *std::max_element(firstLane, firstLane + LANE_NUM);
+		};
+		std::size_t slotNum = 0;
+		for (int group = 0; group < groupNum; group++)
+			slotNum += static_cast<std::size_t>(groupStepNum(group)) * LANE_NUM;
+		auto const rowNum = laneRows.size();
+		if (slotNum == 0 || static_cast<btScalar>(rowNum) < minLaneFill * static_cast<btScalar>(slotNum))
+		{
+			phases.push_back({ groupBegin, groupBegin, false });
+			continue;
+		}
+		soaRowNum += rowNum;
+		soaSlotNum += slotNum;
+
+		for (int group = 0; group < groupNum; group++)
+		{
+			auto const stepNum = groupStepNum(group);
+
+			auto const blockBegin = blockNum;
+			reserveBlocks(stepNum);
+			for (int step = 0; step < stepNum; step++)
+			{
+				auto& contactBlock = contactBlocks[static_cast<std::size_t>(blockBegin + step)];
+				auto& frictionBlock = frictionBlocks[static_cast<std::size_t>(blockBegin + step)];
+				for (int i = 0; i < LANE_NUM; i++)
+				{
+					auto const lane = static_cast<std::size_t>(group * LANE_NUM + i);
+					if (step >= laneLength[lane])
+					{
+						write_soa_solver_row(contactBlock, i, -1, nullptr, bodies);
+						write_soa_solver_row(frictionBlock, i, -1, nullptr, bodies);
+						continue;
+					}
+
+					// C1ȂڐGƓԍ
+					auto const row = laneRows[static_cast<std::size_t>(laneOffset[lane] + step)];
+					write_soa_solver_row(contactBlock, i, row, &m_tmpSolverContactConstraintPool[row], bodies);
+					write_soa_solver_row(frictionBlock, i, row, &m_tmpSolverContactFrictionConstraintPool[row], bodies);
+				}
+			}
+			laneGroups.push_back({ blockBegin, blockNum });
+		}
+		phases.push_back({ groupBegin, static_cast<int>(laneGroups.size()), true });
+	}
+}
+
+inline btScalar SoaContactSolverMt::resolveSoaBlocks(bool isFriction)
+{
+	auto& blocks = isFriction ? frictionBlocks : contactBlocks;
+	auto const bodies = &m_tmpSolverBodyPool[0];
+	// [OC̓v[̐ڐG̗͐ς
+	auto const writeBack = !isFriction && m_tmpSolverContactRollingFrictionConstraintPool.size() > 0;
+
+	auto const solveGroups = [&](int begin, int end) {
+		btScalar residual = 0.;
+		for (int i = begin; i < end; i++)
+		{
+			auto const& group = laneGroups[static_cast<std::size_t>(i)];
+			residual += solve_soa_solver_blocks(&blocks[static_cast<std::size_t>(group.blockBegin)], group.blockEnd - group.blockBegin, bodies,
+				isFriction ? &contactBlocks[static_cast<std::size_t>(group.blockBegin)] : nullptr);
+		}
+		if (writeBack)
+			writeBackSoaImpulses(isFriction, begin, end);
+		return residual;
+	};
+
+	struct SolveBody : public btIParallelSumBody
+	{
+		decltype(solveGroups) const& f;
+		SolveBody(decltype(solveGroups) const& f) : f{ f } {}
+		btScalar sumLoop(int begin, int end) const override { return f(begin, end); }
+	} body{ solveGroups };
+
+	// ubNɂȂtF[Y͌̊֐Ńob`Ƃɉ
+	auto const& batched = m_batchedContactConstraints;
+	auto const solveBatches = [&](int begin, int end) {
+		btScalar residual = 0.;
+		for (int i = begin; i < end; i++)
+		{
+			auto const& batch = batched.m_batches[i];
+			residual += isFriction ? resolveMultipleContactFrictionConstraints(batched.m_constraintIndices, batch.begin, batch.end)
+				: resolveMultipleContactConstraints(batched.m_constraintIndices, batch.begin, batch.end);
+		}
+		return residual;
+	};
+
+	struct BatchBody : public btIParallelSumBody
+	{
+		decltype(solveBatches) const& f;
+		BatchBody(decltype(solveBatches) const& f) : f{ f } {}
+		btScalar sumLoop(int begin, int end) const override { return f(begin, end); }
+	} batchBody{ solveBatches };
+
+	btScalar residual = 0.;
+	for (int i = 0; i < batched.m_phaseOrder.size(); i++)
+	{
+		auto const phaseIndex = batched.m_phaseOrder[i];
+		auto const& phase = phases[static_cast<std::size_t>(phaseIndex)];
+		if (!phase.soa)
+		{
+			auto const& range = batched.m_phases[phaseIndex];
+			residual += btParallelSum(range.begin, range.end, batched.m_phaseGrainSize[phaseIndex], batchBody);
+		}
+		else if (phase.groupEnd - phase.groupBegin > 1)
+			residual += btParallelSum(phase.groupBegin, phase.groupEnd, 1, body);
+		else
+			residual += solveGroups(phase.groupBegin, phase.groupEnd);
+	}
+	return residual;
+}
+
+inline void SoaContactSolverMt::writeBackSoaImpulses(bool isFriction, int groupBegin, int groupEnd)
+{
+	auto const& blocks = isFriction ? frictionBlocks : contactBlocks;
+	auto& pool = isFriction ? m_tmpSolverContactFrictionConstraintPool : m_tmpSolverContactConstraintPool;
+	auto const blockBegin = groupBegin < groupEnd ? laneGroups[static_cast<std::size_t>(groupBegin)].blockBegin : 0;
+	auto const blockEnd = groupBegin < groupEnd ? laneGroups[static_cast<std::size_t>(groupEnd - 1)].blockEnd : 0;
+	for (int b = blockBegin; b < blockEnd; b++)
+	{
+		auto const& block = blocks[static_cast<std::size_t>(b)];
+		for (int i = 0; i < SoaSolverRowBlock::LANE_NUM; i++)
+		{
+			if (block.row[i] >= 0)
+				pool[block.row[i]].m_appliedImpulse = block.appliedImpulse[i];
+		}
+	}
+}
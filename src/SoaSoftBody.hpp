@@ -0,0 +1,486 @@
+#pragma once
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/LinearMath/btThreads.h"
+#include<algorithm>
+#include<array>
+#include<bit>
+#include<cstdint>
+#include<span>
+#include<vector>
+
+// btSoftBodỹNƃAJ[Az⃍[v̈ʒux[X̃\tg{fB
+// btSoftBodypredictMotionAPSolve_LinksAintegrateMotionƓ
+struct SoaSoftBodyConfig
+{
+	btVector3 gravity{ 0, btScalar(-9.8), 0 };
+	// btSoftBody::Config::kDP
+	btScalar damping = 0;
+	// btSoftBody::Material::m_kLST
+	btScalar linearStiffness = 1;
+	// btSoftBody::Config::piterations
+	int positionIterations = 1;
+	// ߓ_̃[v𕪂傫AN͓F̃N̐
+	int grainSize = 256;
+	// falseȂ烊NɐFtAbtSoftBodyƓǉ1Xbhŉ
+	// AJ[΁Aߓ_ƃNbtSoftBodyƃrbgPʂœʂɂȂ
+	bool coloredLinks = true;
+};
+
+// ̂ɌŒ肵ߓ_
+struct SoaSoftBodyAnchor
+{
+	int node{};
+	btRigidBody* body = nullptr;
+	btVector3 local{ 0,0,0 };
+};
+
+// ߓ_ʒuAxAtʂ̎Ƃ̔zŎ\tg{fB
+// N͐ߓ_LȂ悤ɐFtĕׁAF̃NbtParallelForŕɉ
+// \ƐϕAAABBߓ_𕪂ĕɂ
+// F̏ƃN̏̓XbhɂȂ̂ŁAʂXbhɂȂ
+// AJ[̐ߓ_͍̂ɕtēŁÂԂȂ
+// ̂Ƃ̐ڐGƃNX^͈Ȃ
+class SoaSoftBody
+{
+	SoaSoftBodyConfig config{};
+
+	// btSoftBody::Nodem_xAm_qAm_vAm_im
+	std::array<std::vector<btScalar>, 3> position{};
+	std::array<std::vector<btScalar>, 3> previous{};
+	std::array<std::vector<btScalar>, 3> velocity{};
+	std::vector<btScalar> inverseMass{};
+
+	// ǉ̃N
+	struct Link
+	{
+		int node[2]{};
+		btScalar restLength{};
+	};
+	std::vector<Link> links{};
+	bool linksDirty = false;
+
+	// FƂɕׂNAc0c1btSoftBody::Linkm_c0m_c1
+	std::vector<int> linkNode0{};
+	std::vector<int> linkNode1{};
+	std::vector<btScalar> linkC0{};
+	std::vector<btScalar> linkC1{};
+	// Fc̃NcolorBegin[c]colorBegin[c + 1]܂
+	// Ō̐F64FőȂNŁA1Xbhŉ
+	std::vector<int> colorBegin{};
+	bool hasOverflowColor = false;
+
+	std::vector<SoaSoftBodyAnchor> anchors{};
+
+	btVector3 aabbMin{ 0,0,0 };
+	btVector3 aabbMax{ 0,0,0 };
+	// AABB߂Ƃ͈͂̕Ƃ̒l
+	std::vector<btVector3> partialAabbMin{};
+	std::vector<btVector3> partialAabbMax{};
+
+	void colorLinks();
+	void predictMotion(btScalar dt);
+	void solveAnchors();
+	void solveLinks(int begin, int end);
+	void integrateMotion(btScalar dt);
+	void updateBounds();
+
+public:
+	SoaSoftBody(SoaSoftBodyConfig const& config = {});
+	virtual ~SoaSoftBody() = default;
+	SoaSoftBody(SoaSoftBody const&) = delete;
+	SoaSoftBody& operator=(SoaSoftBody const&) = delete;
+
+	// mass0Ȃ瓮Ȃߓ_AԍԂ
+	int appendNode(btVector3 const& x, btScalar mass);
+	void setMass(int node, btScalar mass);
+	// R͍̐ߓ_̋
+	void appendLink(int node0, int node1);
+	// ߓ_̂̍̈ʒuɌŒ肷Aߓ_̋tʂ0ɂ
+	void appendAnchor(int node, btRigidBody* body);
+
+	// btSoftBody::predictMotionAsolveConstraintsAintegrateMotionAupdateBounds̏ɐi߂
+	void step(btScalar dt);
+
+	SoaSoftBodyConfig const& getConfig() const noexcept { return config; }
+	void setConfig(SoaSoftBodyConfig const& config) noexcept;
+
+	int getNodeNum() const noexcept { return static_cast<int>(inverseMass.size()); }
+	int getLinkNum() const noexcept { return static_cast<int>(links.size()); }
+	// Ft͎̂stepȂ̂ŁA܂ł0
+	int getColorNum() const noexcept { return colorBegin.empty() ? 0 : static_cast<int>(colorBegin.size()) - 1; }
+	btVector3 getPosition(int node) const;
+	btVector3 getVelocity(int node) const;
+	std::span<btScalar const> getPositions(int axis) const noexcept { return position[axis]; }
+	void getAabb(btVector3& aabbMin, btVector3& aabbMax) const;
+};
+
+// btSoftBodyHelpers::CreatePatchƓт̕zbodyɑ
+// fixeds1A2A4A800A10A01A11̊pŒ肷
+// bendingȂ1΂̐ߓ_NłȂAȂɂ
+void append_soa_cloth(SoaSoftBody& body, btVector3 const& corner00, btVector3 const& corner10, btVector3 const& corner01, btVector3 const& corner11,
+	int resolutionX, int resolutionY, int fixeds, bool diagonals, bool bending, btScalar nodeMass = 1);
+// btSoftBodyHelpers::CreateRopeƓAfromto܂resolution̐ߓ_񂾃[v
+// fixeds1A2Ŏn_ƏI_Œ肷
+void append_soa_rope(SoaSoftBody& body, btVector3 const& from, btVector3 const& to, int resolution, int fixeds, btScalar nodeMass = 1);
+
+// num傫^XNXPW[btParallelForŕAȂ΂̂܂܌Ă
+template<typename F>
+void run_soa_soft_body_loop(int num, int grainSize, F const& f);
+
+//
+// ȉA
+//
+
+template<typename F>
+inline void run_soa_soft_body_loop(int num, int grainSize, F const& f)
+{
+	if (btGetTaskScheduler() && num > grainSize)
+	{
+		struct LoopBody : public btIParallelForBody
+		{
+			F const& f;
+			LoopBody(F const& f) : f{ f } {}
+			void forLoop(int begin, int end) const override { f(begin, end); }
+		} body{ f };
+		btParallelFor(0, num, grainSize, body);
+	}
+	else if (num > 0)
+	{
+		f(0, num);
+	}
+}
+
+inline SoaSoftBody::SoaSoftBody(SoaSoftBodyConfig const& config)
+{
+	setConfig(config);
+}
+
+inline void SoaSoftBody::setConfig(SoaSoftBodyConfig const& config) noexcept
+{
+	this->config = config;
+	this->config.grainSize = std::max(this->config.grainSize, 1);
+	// c0͍Ō܂
+	linksDirty = true;
+}
+
+inline int SoaSoftBody::appendNode(btVector3 const& x, btScalar mass)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		position[axis].push_back(x[axis]);
+		previous[axis].push_back(x[axis]);
+		velocity[axis].push_back(0);
+	}
+	inverseMass.push_back(mass > 0 ? 1 / mass : 0);
+	return static_cast<int>(inverseMass.size()) - 1;
+}
+
+inline void SoaSoftBody::setMass(int node, btScalar mass)
+{
+	inverseMass[node] = mass > 0 ? 1 / mass : 0;
+	linksDirty = true;
+}
+
+inline void SoaSoftBody::appendLink(int node0, int node1)
+{
+	links.push_back({ { node0, node1 }, getPosition(node0).distance(getPosition(node1)) });
+	linksDirty = true;
+}
+
+inline void SoaSoftBody::appendAnchor(int node, btRigidBody* body)
+{
+	anchors.push_back({ node, body, body->getWorldTransform().invXform(getPosition(node)) });
+	setMass(node, 0);
+}
+
+inline btVector3 SoaSoftBody::getPosition(int node) const
+{
+	return { position[0][node], position[1][node], position[2][node] };
+}
+
+inline btVector3 SoaSoftBody::getVelocity(int node) const
+{
+	return { velocity[0][node], velocity[1][node], velocity[2][node] };
+}
+
+inline void SoaSoftBody::getAabb(btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = this->aabbMin;
+	aabbMax = this->aabbMax;
+}
+
+inline void SoaSoftBody::colorLinks()
+{
+	BT_PROFILE("SoaSoftBody::colorLinks");
+
+	// ǉɁA[̐ߓ_ł܂gĂȂԏFI
+	// FtȂƂ́ASŌ1XbhŉFɓ
+	constexpr int COLOR_LIMIT = 64;
+	std::vector<std::uint64_t> usedColors(inverseMass.size());
+	std::vector<int> colors(links.size());
+	std::array<int, COLOR_LIMIT + 1> colorCounts{};
+	for (std::size_t i = 0; i < links.size(); i++)
+	{
+		auto const used = usedColors[links[i].node[0]] | usedColors[links[i].node[1]];
+		auto const color = !config.coloredLinks || used == ~std::uint64_t{} ? COLOR_LIMIT : std::countr_one(used);
+		if (color < COLOR_LIMIT)
+		{
+			usedColors[links[i].node[0]] |= std::uint64_t{ 1 } << color;
+			usedColors[links[i].node[1]] |= std::uint64_t{ 1 } << color;
+		}
+		colors[i] = color;
+		colorCounts[color]++;
+	}
+
+	hasOverflowColor = colorCounts[COLOR_LIMIT] > 0;
+	auto colorNum = 0;
+	for (int c = 0; c < COLOR_LIMIT; c++)
+	{
+		if (colorCounts[c] > 0)
+			colorNum = c + 1;
+	}
+	colorBegin.assign(1, 0);
+	for (int c = 0; c < colorNum; c++)
+		colorBegin.push_back(colorBegin.back() + colorCounts[c]);
+	if (hasOverflowColor)
+		colorBegin.push_back(colorBegin.back() + colorCounts[COLOR_LIMIT]);
+
+	std::vector<int> offsets(colorBegin.begin(), colorBegin.end() - 1);
+	if (!hasOverflowColor)
+		offsets.push_back(0);
+	linkNode0.resize(links.size());
+	linkNode1.resize(links.size());
+	linkC0.resize(links.size());
+	linkC1.resize(links.size());
+	for (std::size_t i = 0; i < links.size(); i++)
+	{
+		auto const& link = links[i];
+		auto const slot = colors[i] < COLOR_LIMIT ? offsets[colors[i]]++ : offsets.back()++;
+		linkNode0[slot] = link.node[0];
+		linkNode1[slot] = link.node[1];
+		// btSoftBody::prepareLinksƓ
+		linkC0[slot] = (inverseMass[link.node[0]] + inverseMass[link.node[1]]) / config.linearStiffness;
+		linkC1[slot] = link.restLength * link.restLength;
+	}
+
+	linksDirty = false;
+}
+
+inline void SoaSoftBody::predictMotion(btScalar dt)
+{
+	BT_PROFILE("SoaSoftBody::predictMotion");
+
+	auto const gravity = config.gravity * dt;
+	run_soa_soft_body_loop(getNodeNum(), config.grainSize, [&](int begin, int end) {
+		for (int axis = 0; axis < 3; axis++)
+		{
+			auto const x = position[axis].data();
+			auto const q = previous[axis].data();
+			auto const v = velocity[axis].data();
+			auto const im = inverseMass.data();
+			auto const g = gravity[axis];
+			// d͓͂ߓ_ɂAȂăxNg
+			for (int i = begin; i < end; i++)
+			{
+				q[i] = x[i];
+				v[i] += im[i] > 0 ? g : btScalar(0);
+				x[i] += v[i] * dt;
+			}
+		}
+	});
+}
+
+inline void SoaSoftBody::solveAnchors()
+{
+	for (auto const& anchor : anchors)
+	{
+		auto const x = anchor.body->getWorldTransform() * anchor.local;
+		for (int axis = 0; axis < 3; axis++)
+			position[axis][anchor.node] = x[axis];
+	}
+}
+
+inline void SoaSoftBody::solveLinks(int begin, int end)
+{
+	auto const im = inverseMass.data();
+	for (int i = begin; i < end; i++)
+	{
+		auto const c0 = linkC0[i];
+		if (!(c0 > 0))
+			continue;
+
+		auto const a = linkNode0[i];
+		auto const b = linkNode1[i];
+		btVector3 const del{ position[0][b] - position[0][a], position[1][b] - position[1][a], position[2][b] - position[2][a] };
+		auto const len = del.length2();
+		auto const c1 = linkC1[i];
+		if (c1 + len > SIMD_EPSILON)
+		{
+			auto const k = (c1 - len) / (c0 * (c1 + len));
+			for (int axis = 0; axis < 3; axis++)
+			{
+				position[axis][a] -= del[axis] * (k * im[a]);
+				position[axis][b] += del[axis] * (k * im[b]);
+			}
+		}
+	}
+}
+
+inline void SoaSoftBody::integrateMotion(btScalar dt)
+{
+	BT_PROFILE("SoaSoftBody::integrateMotion");
+
+	// btSoftBody::solveConstraints̍ŌƓAۂ߂킹
+	auto const vc = (1 / dt) * (1 - config.damping);
+	run_soa_soft_body_loop(getNodeNum(), config.grainSize, [&](int begin, int end) {
+		for (int axis = 0; axis < 3; axis++)
+		{
+			auto const x = position[axis].data();
+			auto const q = previous[axis].data();
+			auto const v = velocity[axis].data();
+			for (int i = begin; i < end; i++)
+				v[i] = (x[i] - q[i]) * vc;
+		}
+	});
+}
+
+inline void SoaSoftBody::updateBounds()
+{
+	BT_PROFILE("SoaSoftBody::updateBounds");
+
+	auto const num = getNodeNum();
+	if (num == 0)
+	{
+		aabbMin.setZero();
+		aabbMax.setZero();
+		return;
+	}
+
+	// ͈͂Ƃɋ߂Ă1Xbhł܂Ƃ߂̂ŁAʂ͕ɂȂ
+	auto const grainSize = config.grainSize;
+	auto const partNum = (num + grainSize - 1) / grainSize;
+	partialAabbMin.resize(partNum);
+	partialAabbMax.resize(partNum);
+	run_soa_soft_body_loop(partNum, 1, [&](int begin, int end) {
+		for (int part = begin; part < end; part++)
+		{
+			auto const first = part * grainSize;
+			auto const last = std::min(first + grainSize, num);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				auto const x = position[axis].data();
+				auto lo = x[first];
+				auto hi = x[first];
+				for (int i = first + 1; i < last; i++)
+				{
+					lo = std::min(lo, x[i]);
+					hi = std::max(hi, x[i]);
+				}
+				partialAabbMin[part][axis] = lo;
+				partialAabbMax[part][axis] = hi;
+			}
+		}
+	});
+
+	aabbMin = partialAabbMin[0];
+	aabbMax = partialAabbMax[0];
+	for (int part = 1; part < partNum; part++)
+	{
+		aabbMin.setMin(partialAabbMin[part]);
+		aabbMax.setMax(partialAabbMax[part]);
+	}
+}
+
+inline void SoaSoftBody::step(btScalar dt)
+{
+	BT_PROFILE("SoaSoftBody::step");
+
+	if (linksDirty)
+		colorLinks();
+
+	predictMotion(dt);
+
+	{
+		BT_PROFILE("SoaSoftBody::solveConstraints");
+
+		auto const colorNum = getColorNum();
+		auto const parallelColorNum = hasOverflowColor ? colorNum - 1 : colorNum;
+		for (int iteration = 0; iteration < config.positionIterations; iteration++)
+		{
+			solveAnchors();
+
+			// F̃N͐ߓ_LȂ̂ŁAǂĂʂɂȂ
+			for (int c = 0; c < parallelColorNum; c++)
+			{
+				auto const begin = colorBegin[c];
+				run_soa_soft_body_loop(colorBegin[c + 1] - begin, config.grainSize, [&](int first, int last) {
+					solveLinks(begin + first, begin + last);
+				});
+			}
+			if (hasOverflowColor)
+				solveLinks(colorBegin[colorNum - 1], colorBegin[colorNum]);
+		}
+	}
+
+	integrateMotion(dt);
+	updateBounds();
+}
+
+inline void append_soa_cloth(SoaSoftBody& body, btVector3 const& corner00, btVector3 const& corner10, btVector3 const& corner01, btVector3 const& corner11,
+	int resolutionX, int resolutionY, int fixeds, bool diagonals, bool bending, btScalar nodeMass)
+{
+	if (resolutionX < 2 || resolutionY < 2)
+		return;
+
+	auto const first = body.getNodeNum();
+	auto const index = [&](int x, int y) { return first + y * resolutionX + x; };
+
+	for (int y = 0; y < resolutionY; y++)
+	{
+		auto const ty = static_cast<btScalar>(y) / static_cast<btScalar>(resolutionY - 1);
+		auto const py0 = lerp(corner00, corner01, ty);
+		auto const py1 = lerp(corner10, corner11, ty);
+		for (int x = 0; x < resolutionX; x++)
+		{
+			auto const tx = static_cast<btScalar>(x) / static_cast<btScalar>(resolutionX - 1);
+			body.appendNode(lerp(py0, py1, tx), nodeMass);
+		}
+	}
+	if (fixeds & 1) body.setMass(index(0, 0), 0);
+	if (fixeds & 2) body.setMass(index(resolutionX - 1, 0), 0);
+	if (fixeds & 4) body.setMass(index(0, resolutionY - 1), 0);
+	if (fixeds & 8) body.setMass(index(resolutionX - 1, resolutionY - 1), 0);
+
+	for (int y = 0; y < resolutionY; y++)
+	{
+		for (int x = 0; x < resolutionX; x++)
+		{
+			auto const mdx = x + 1 < resolutionX;
+			auto const mdy = y + 1 < resolutionY;
+			if (mdx) body.appendLink(index(x, y), index(x + 1, y));
+			if (mdy) body.appendLink(index(x, y), index(x, y + 1));
+			if (mdx && mdy && diagonals)
+			{
+				if ((x + y) & 1)
+					body.appendLink(index(x, y), index(x + 1, y + 1));
+				else
+					body.appendLink(index(x + 1, y), index(x, y + 1));
+			}
+			if (bending && x + 2 < resolutionX) body.appendLink(index(x, y), index(x + 2, y));
+			if (bending && y + 2 < resolutionY) body.appendLink(index(x, y), index(x, y + 2));
+		}
+	}
+}
+
+inline void append_soa_rope(SoaSoftBody& body, btVector3 const& from, btVector3 const& to, int resolution, int fixeds, btScalar nodeMass)
+{
+	auto const first = body.getNodeNum();
+	auto const num = resolution + 2;
+	for (int i = 0; i < num; i++)
+		body.appendNode(lerp(from, to, static_cast<btScalar>(i) / static_cast<btScalar>(num - 1)), nodeMass);
+	if (fixeds & 1) body.setMass(first, 0);
+	if (fixeds & 2) body.setMass(first + num - 1, 0);
+
+	for (int i = 1; i < num; i++)
+		body.appendLink(first + i - 1, first + i);
+}
@@ -0,0 +1,1108 @@
+#pragma once
+#include"../external/bullet3/src/btBulletCollisionCommon.h"
+#include"../external/bullet3/src/btBulletDynamicsCommon.h"
+#include"../external/bullet3/src/BulletCollision/CollisionDispatch/btManifoldResult.h"
+#include"CompactManifoldStore.hpp"
+#include"IncrementalIslandManager.hpp"
+#include"OpenAddressingPairCache.hpp"
+#include"ParallelBroadphase.hpp"
+#include<algorithm>
+#include<bit>
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+#include<new>
+#include<span>
+#include<type_traits>
+#include<utility>
+#include<vector>
+#include<xmmintrin.h>
+
+// WorldSnapshot̐擪ɒuAe̗vfƃu[htF[Y̐l
+struct WorldSnapshotHeader
+{
+	int objectNum{};
+	int constraintNum{};
+	int pairNum{};
+	int manifoldNum{};
+	int pointNum{};
+	int nodeNum[2]{};
+	// Xe[W̃Xg̐擪̃vLVuidAȂ-1
+	int stageRoots[btDbvtBroadphase::STAGECOUNT + 1]{};
+
+	// btDbvtBroadphase
+	int stageCurrent{};
+	int fupdates{};
+	int dupdates{};
+	int cupdates{};
+	int newpairs{};
+	int fixedleft{};
+	unsigned updatesCall{};
+	unsigned updatesDone{};
+	btScalar updatesRatio{};
+	int pid{};
+	int cid{};
+	// vLVuid̍ől
+	int gid{};
+	int needCleanup{};
+
+	// btDbvt
+	int lkhd[2]{};
+	int leaves[2]{};
+	unsigned opath[2]{};
+	// m_freẽAhXAȂ0
+	std::uintptr_t freeNode[2]{};
+
+	// ParallelDbvtBroadphasêƂ
+	std::uint64_t reinsertCursor{};
+};
+
+// Փ˃IuWFNg1A[h̔z̏
+// btVector3͔{x4vf̂ŁA3vf̔zŎ
+struct SnapshotObject
+{
+	// 3sƌ_
+	btScalar transform[4][3];
+	// btRigidBodyłȂ0
+	btScalar linearVelocity[3];
+	btScalar angularVelocity[3];
+	// u[htF[ỸvLVAABB
+	btScalar aabbMin[3];
+	btScalar aabbMax[3];
+	btScalar deactivationTime;
+	btScalar hitFraction;
+	int activationState;
+	// vLṼXe[WƁAXe[W̃XgŎ̃vLVuidAŌȂ-1
+	int stage;
+	int nextProxy;
+};
+
+// [h̍S̏
+struct SnapshotConstraint
+{
+	btScalar appliedImpulse;
+	int enabled;
+};
+
+// yALbV̔z̏
+struct SnapshotPair
+{
+	// vLVuid
+	int proxy0;
+	int proxy1;
+	// ASYȂ-1
+	int manifoldNum;
+	// yÃ}jtH[h̔ԍ̋ł̐擪
+	int manifoldBegin;
+};
+
+// fBXpb`̔z̏
+struct SnapshotManifold
+{
+	btScalar contactBreakingThreshold;
+	btScalar contactProcessingThreshold;
+	int pointBegin;
+	int pointNum;
+};
+
+// btDbvt̐߁A畝Dŕׂ
+struct SnapshotNode
+{
+	btScalar mins[3];
+	btScalar maxs[3];
+	// btDbvt͐߂̃AhXׂĕבւ̂ŁA߂Ƃɓ̃AhXɂ
+	std::uintptr_t address;
+	// q̐߂̔ԍAtȂ-1
+	int child[2];
+	// tȂvLVuidAłȂ-1
+	int proxy;
+};
+
+static_assert(std::is_trivially_copyable_v<WorldSnapshotHeader>);
+static_assert(std::is_trivially_copyable_v<SnapshotObject>);
+static_assert(std::is_trivially_copyable_v<SnapshotConstraint>);
+static_assert(std::is_trivially_copyable_v<SnapshotPair>);
+static_assert(std::is_trivially_copyable_v<SnapshotManifold>);
+static_assert(std::is_trivially_copyable_v<SnapshotNode>);
+static_assert(std::is_trivially_copyable_v<btManifoldPoint>);
+
+// obt@̒̊e̐擪Aǂ16oCgE
+struct WorldSnapshotLayout
+{
+	std::size_t objects{};
+	std::size_t constraints{};
+	std::size_t pairs{};
+	// yAƂ̃}jtH[h́AfBXpb`̔zł̔ԍ
+	std::size_t pairManifolds{};
+	std::size_t manifolds{};
+	std::size_t nodes[2]{};
+	// ڐG_̐̓yAH܂ł킩Ȃ̂ōŌɒu
+	std::size_t points{};
+	std::size_t size{};
+};
+
+WorldSnapshotLayout make_world_snapshot_layout(WorldSnapshotHeader const& header) noexcept;
+
+// [h̏Ԃl߂1̃oCg
+// g̓|C^ȂR[hȂ̂ŁAmemcpyŕăOobt@ɗ߂Ă
+// ߂̃AhX͕яׂ邽߂ɎĝŁA߂͎̂̂Ɠ[h
+class WorldSnapshot
+{
+	friend class WorldSnapshotter;
+
+	std::vector<std::byte> buffer{};
+
+public:
+	bool empty() const noexcept;
+	std::span<std::byte const> getData() const noexcept;
+	// getDataŎoCgʂAx傫ȂmۂȂȂ
+	void assign(std::span<std::byte const> data);
+
+	// emptyłȂƂ
+	WorldSnapshotHeader const& getHeader() const noexcept;
+
+private:
+	template<class T>
+	std::span<T> section(std::size_t offset, int num) noexcept;
+	template<class T>
+	std::span<T const> section(std::size_t offset, int num) const noexcept;
+};
+
+struct WorldSnapshotRestoreStats
+{
+	// yA̔z蒼AfalseȂ珇ԂASYƂ̂܂܂
+	bool pairsRebuilt = false;
+	// ɏyÃASY蒼ƁAɂłyÃASY
+	int createdAlgorithmNum{};
+	int destroyedAlgorithmNum{};
+	// ؂̐߂ƂƓAhXɖ߂
+	// falseȂ߂̐ςĂ̂ŁAAhX̑召̏킹
+	bool exactNodes = false;
+	// z̐擪Ƃ̂܂܎cyA̐
+	int keptPairNum{};
+	// ƂƈĂ̂ŏ߂Â͐GȂ
+	// ߂exactNodesłȂΑS
+	int restoredObjectNum{};
+	int restoredNodeNum{};
+};
+
+
+// btDiscreteDynamicsWorld̏ԂWorldSnapshotɕۑĖ߂
+// ߂̃XebvrbgPʂœɂȂ悤ɁA{fBƍŜقɃXebv܂ŎĉSۑ
+//   yA̔z̏ƃASY̗LAfBXpb`̃}jtH[h̏ƐڐG_(ÕXebv̗͐ς܂)
+//   btDbvtBroadphase2̖؂̌`Ƒ̐ρAXe[W̃XgƃJE^
+// IuWFNgƍS͖̑߂Ȃ̂ŁAcapturerestore̊Ԃœ̂[hɂ邱
+// ۑȂ
+//   stepSimulationmaxSubSteps1ȏ̂ƂɎzԁAFixedSteppermaxSubSteps=0Ői߂
+//   {fBɉ́AXebv̏Iɏ̂ŁA͖͂߂ɉȂ
+//   ԗp̎pƑxÃXebv̍ŏɏȂ̂ŁA̎pƑxɂĂ
+//   [VXe[gA߂̃Xebvŏ
+//   ڐG_m_userPersistentDataA߂ƂɏgContactDestroyedCallbackĂ
+// q̃ASYRpEhȂǂ́AɃyAƍ蒼Ăq̏Ԃ߂Ȃ
+// btDbvtBroadphaseParallelDbvtBroadphasẽ[hŁAIncrementalIslandManager͎gȂ
+// 1XbhŐi߂[hȂXebv͌IAbtCollisionDispatcherMt̓}jtH[h̏Xbhŕς
+class WorldSnapshotter
+{
+	// IuWFNgA߁AASYA}jtH[h͂΂΂ɊmۂĂ̂ŁAǂݍł
+	static constexpr int PREFETCH_DISTANCE = 8;
+
+	btDiscreteDynamicsWorld* world = nullptr;
+	btDbvtBroadphase* broadphase = nullptr;
+	// ParallelDbvtBroadphasełȂnullptr
+	ParallelDbvtBroadphase* parallelBroadphase = nullptr;
+
+	WorldSnapshotRestoreStats restoreStats{};
+
+	// Ɨp
+	// DŒH߁AR[hƓ
+	std::vector<btDbvtNode const*> nodeQueue{};
+	btManifoldArray manifoldArray{};
+	// yAHȂW߂ڐG_AŌɃobt@̖Ɏʂ
+	std::vector<btManifoldPoint> points{};
+	// uidvLV
+	std::vector<btDbvtProxy*> proxies{};
+	// ̖؂̐߂m_free
+	std::vector<btDbvtNode*> pool{};
+	// ۑ߂m_free߂
+	std::vector<btDbvtNode*> nodes{};
+	std::vector<std::uintptr_t> addressTable{};
+	std::vector<std::pair<std::uintptr_t, int>> addressOrder{};
+	// yA蒼ƂɊOĂASYAL[̏
+	std::vector<std::pair<std::uint64_t, btCollisionAlgorithm*>> algorithms{};
+	// Ƃ̓yAHA߂Ƃ̓fBXpb`̔z̏ɕׂ}jtH[h
+	std::vector<btPersistentManifold*> manifolds{};
+
+public:
+	WorldSnapshotter(btDiscreteDynamicsWorld* world);
+	virtual ~WorldSnapshotter() = default;
+	WorldSnapshotter(WorldSnapshotter const&) = delete;
+	WorldSnapshotter& operator=(WorldSnapshotter const&) = delete;
+
+	bool isSupported() const noexcept;
+
+	// Xebv̊ԂɌĂԁAgȂ[hAyÂ̂łȂ}jtH[hfalse
+	bool capture(WorldSnapshot& snapshot);
+	// [hŎ̂߂
+	// IuWFNgS̐ႤAɃvLVĂΉfalse
+	// ASY蒼Ă}jtH[h̐ȂfalseŁÂƂ[h͓r܂ŏĂ
+	bool restore(WorldSnapshot const& snapshot);
+
+	WorldSnapshotRestoreStats const& getRestoreStats() const noexcept;
+
+private:
+	static void prefetch(void const* p) noexcept;
+	// pƁÂȂ瑬x
+	static void prefetchObject(btCollisionObject const* object) noexcept;
+	// Xe[Ŵق
+	static void storeObject(btCollisionObject const* object, SnapshotObject& record) noexcept;
+	// ߂ĂR[hƓɂȂ邩
+	static bool isObjectUnchanged(btCollisionObject const* object, SnapshotObject const& record) noexcept;
+
+	// Ȃfalse
+	bool captureTree(int set, std::span<SnapshotNode> records);
+	// }jtH[hyÃASYHĕۑ
+	bool capturePairs(WorldSnapshot& snapshot, WorldSnapshotLayout const& layout);
+
+	void restoreObjects(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout);
+	void restoreConstraints(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout);
+	void restoreBroadphase(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout);
+	// nodesɖ߂̐߂ׂ
+	void collectNodes(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout);
+	bool restorePairs(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout);
+	// 擪restoreStats.keptPairNum̃yA͎cāA蒼
+	bool rebuildPairs(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout);
+	// ɏyÃASYA}jtH[hmanifoldNum
+	btCollisionAlgorithm* createAlgorithm(btBroadphasePair const& pair, int manifoldNum);
+	void destroyAlgorithm(btCollisionAlgorithm* algorithm);
+	// ASỸ}jtH[hmanifolds̕ۑʒuɒuAႦfalse
+	bool placeManifolds(btCollisionAlgorithm* algorithm, SnapshotPair const& record, std::span<int const> pairManifolds);
+};
+
+//
+// ȉA
+//
+
+inline WorldSnapshotLayout make_world_snapshot_layout(WorldSnapshotHeader const& header) noexcept
+{
+	WorldSnapshotLayout layout{};
+	auto offset = sizeof(WorldSnapshotHeader);
+	auto const place = [&](std::size_t elementSize, int num) {
+		offset = (offset + 15) & ~std::size_t{ 15 };
+		auto const begin = offset;
+		offset += elementSize * static_cast<std::size_t>(std::max(num, 0));
+		return begin;
+	};
+
+	layout.objects = place(sizeof(SnapshotObject), header.objectNum);
+	layout.constraints = place(sizeof(SnapshotConstraint), header.constraintNum);
+	layout.pairs = place(sizeof(SnapshotPair), header.pairNum);
+	layout.pairManifolds = place(sizeof(int), header.manifoldNum);
+	layout.manifolds = place(sizeof(SnapshotManifold), header.manifoldNum);
+	layout.nodes[0] = place(sizeof(SnapshotNode), header.nodeNum[0]);
+	layout.nodes[1] = place(sizeof(SnapshotNode), header.nodeNum[1]);
+	layout.points = place(sizeof(btManifoldPoint), header.pointNum);
+	layout.size = offset;
+	return layout;
+}
+
+inline bool WorldSnapshot::empty() const noexcept
+{
+	return buffer.empty();
+}
+
+inline std::span<std::byte const> WorldSnapshot::getData() const noexcept
+{
+	return buffer;
+}
+
+inline void WorldSnapshot::assign(std::span<std::byte const> data)
+{
+	buffer.resize(data.size());
+	if (!data.empty())
+		std::memcpy(buffer.data(), data.data(), data.size());
+}
+
+inline WorldSnapshotHeader const& WorldSnapshot::getHeader() const noexcept
+{
+	return *reinterpret_cast<WorldSnapshotHeader const*>(buffer.data());
+}
+
+template<class T>
+inline std::span<T> WorldSnapshot::section(std::size_t offset, int num) noexcept
+{
+	return { reinterpret_cast<T*>(buffer.data() + offset), static_cast<std::size_t>(num) };
+}
+
+template<class T>
+inline std::span<T const> WorldSnapshot::section(std::size_t offset, int num) const noexcept
+{
+	return { reinterpret_cast<T const*>(buffer.data() + offset), static_cast<std::size_t>(num) };
+}
+
+inline WorldSnapshotter::WorldSnapshotter(btDiscreteDynamicsWorld* world)
+	: world{ world }
+	, broadphase{ dynamic_cast<btDbvtBroadphase*>(world->getBroadphase()) }
+	, parallelBroadphase{ dynamic_cast<ParallelDbvtBroadphase*>(world->getBroadphase()) }
+{
+}
+
+inline bool WorldSnapshotter::isSupported() const noexcept
+{
+	return broadphase && !dynamic_cast<IncrementalIslandManager*>(world->getSimulationIslandManager());
+}
+
+inline WorldSnapshotRestoreStats const& WorldSnapshotter::getRestoreStats() const noexcept
+{
+	return restoreStats;
+}
+
+inline bool WorldSnapshotter::capture(WorldSnapshot& snapshot)
+{
+	if (!isSupported())
+		return false;
+
+	auto const& objects = world->getCollisionObjectArray();
+
+	WorldSnapshotHeader header{};
+	header.objectNum = objects.size();
+	header.constraintNum = world->getNumConstraints();
+	header.pairNum = world->getPairCache()->getNumOverlappingPairs();
+	header.manifoldNum = world->getDispatcher()->getNumManifolds();
+	for (int i = 0; i < 2; i++)
+	{
+		auto const& tree = broadphase->m_sets[i];
+		header.nodeNum[i] = tree.m_leaves > 0 ? tree.m_leaves * 2 - 1 : 0;
+		header.lkhd[i] = tree.m_lkhd;
+		header.leaves[i] = tree.m_leaves;
+		header.opath[i] = tree.m_opath;
+		header.freeNode[i] = reinterpret_cast<std::uintptr_t>(tree.m_free);
+	}
+
+	header.stageCurrent = broadphase->m_stageCurrent;
+	header.fupdates = broadphase->m_fupdates;
+	header.dupdates = broadphase->m_dupdates;
+	header.cupdates = broadphase->m_cupdates;
+	header.newpairs = broadphase->m_newpairs;
+	header.fixedleft = broadphase->m_fixedleft;
+	header.updatesCall = broadphase->m_updates_call;
+	header.updatesDone = broadphase->m_updates_done;
+	header.updatesRatio = broadphase->m_updates_ratio;
+	header.pid = broadphase->m_pid;
+	header.cid = broadphase->m_cid;
+	header.gid = broadphase->m_gid;
+	header.needCleanup = broadphase->m_needcleanup ? 1 : 0;
+	if (parallelBroadphase)
+		header.reinsertCursor = parallelBroadphase->getReinsertCursor();
+
+	// ڐG_͍̋ŌȂ̂ŁA킩ĂL
+	auto const layout = make_world_snapshot_layout(header);
+	snapshot.buffer.resize(layout.size);
+
+	// Xe[W̃Xg͂ǂ炸ɁAvLVƂɎ̃vLV
+	for (int stage = 0; stage <= btDbvtBroadphase::STAGECOUNT; stage++)
+	{
+		auto const root = broadphase->m_stageRoots[stage];
+		header.stageRoots[stage] = root ? root->m_uniqueId : -1;
+	}
+
+	auto const objectRecords = snapshot.section<SnapshotObject>(layout.objects, header.objectNum);
+	for (int i = 0; i < header.objectNum; i++)
+	{
+		// IuWFNgǂݍłÃvLVǂݍ
+		if (i + 2 * PREFETCH_DISTANCE < header.objectNum)
+			prefetchObject(objects[i + 2 * PREFETCH_DISTANCE]);
+		if (i + PREFETCH_DISTANCE < header.objectNum)
+			prefetch(objects[i + PREFETCH_DISTANCE]->getBroadphaseHandle());
+
+		auto const object = objects[i];
+		auto const proxy = static_cast<btDbvtProxy const*>(object->getBroadphaseHandle());
+		if (!proxy)
+			return false;
+		auto& record = objectRecords[i];
+		storeObject(object, record);
+		record.stage = proxy->stage;
+		record.nextProxy = proxy->links[1] ? proxy->links[1]->m_uniqueId : -1;
+	}
+
+	auto const constraintRecords = snapshot.section<SnapshotConstraint>(layout.constraints, header.constraintNum);
+	for (int i = 0; i < header.constraintNum; i++)
+	{
+		auto const constraint = world->getConstraint(i);
+		constraintRecords[i] = { constraint->getAppliedImpulse(), constraint->isEnabled() ? 1 : 0 };
+	}
+
+	for (int i = 0; i < 2; i++)
+	{
+		if (!captureTree(i, snapshot.section<SnapshotNode>(layout.nodes[i], header.nodeNum[i])))
+			return false;
+	}
+
+	std::memcpy(snapshot.buffer.data(), &header, sizeof(header));
+	if (!capturePairs(snapshot, layout))
+		return false;
+
+	header.pointNum = static_cast<int>(points.size());
+	auto const pointOffset = make_world_snapshot_layout(header).points;
+	snapshot.buffer.resize(pointOffset + sizeof(btManifoldPoint) * points.size());
+	if (!points.empty())
+		std::memcpy(snapshot.buffer.data() + pointOffset, points.data(), sizeof(btManifoldPoint) * points.size());
+	std::memcpy(snapshot.buffer.data(), &header, sizeof(header));
+
+	return true;
+}
+
+inline void WorldSnapshotter::prefetch(void const* p) noexcept
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_prefetch(reinterpret_cast<char const*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(p);
+#else
+	(void)p;
+#endif
+}
+
+inline void WorldSnapshotter::prefetchObject(btCollisionObject const* object) noexcept
+{
+	auto const transform = reinterpret_cast<char const*>(&object->getWorldTransform());
+	prefetch(transform);
+	prefetch(transform + 64);
+	prefetch(transform + 127);
+	if (auto const body = btRigidBody::upcast(object))
+	{
+		prefetch(&body->getLinearVelocity());
+		prefetch(&body->getAngularVelocity());
+	}
+}
+
+inline void WorldSnapshotter::storeObject(btCollisionObject const* object, SnapshotObject& record) noexcept
+{
+	auto const proxy = static_cast<btDbvtProxy const*>(object->getBroadphaseHandle());
+	auto const& transform = object->getWorldTransform();
+	for (int r = 0; r < 3; r++)
+		compact_store(record.transform[r], transform.getBasis()[r]);
+	compact_store(record.transform[3], transform.getOrigin());
+	if (auto const body = btRigidBody::upcast(object))
+	{
+		compact_store(record.linearVelocity, body->getLinearVelocity());
+		compact_store(record.angularVelocity, body->getAngularVelocity());
+	}
+	else
+	{
+		compact_store(record.linearVelocity, btVector3(0, 0, 0));
+		compact_store(record.angularVelocity, btVector3(0, 0, 0));
+	}
+	compact_store(record.aabbMin, proxy->m_aabbMin);
+	compact_store(record.aabbMax, proxy->m_aabbMax);
+	record.deactivationTime = object->getDeactivationTime();
+	record.hitFraction = object->getHitFraction();
+	record.activationState = object->getActivationState();
+}
+
+inline bool WorldSnapshotter::isObjectUnchanged(btCollisionObject const* object, SnapshotObject const& record) noexcept
+{
+	// p瓖̊܂łbtScalarԂȂł̂ŁA܂Ƃ߂Ĕׂ
+	SnapshotObject current;
+	storeObject(object, current);
+	if (std::memcmp(&current, &record, offsetof(SnapshotObject, activationState)) != 0 || current.activationState != record.activationState)
+		return false;
+
+	// ̂́Aԗp̎pƑx̂̂ŁA͂cĂȂΏ߂̂Ɠ
+	auto const body = btRigidBody::upcast(object);
+	if (!body || body->isKinematicObject())
+		return true;
+	return body->getInterpolationWorldTransform() == body->getWorldTransform() &&
+		body->getInterpolationLinearVelocity() == body->getLinearVelocity() &&
+		body->getInterpolationAngularVelocity() == body->getAngularVelocity() &&
+		body->getTotalForce().isZero() && body->getTotalTorque().isZero();
+}
+
+inline bool WorldSnapshotter::captureTree(int set, std::span<SnapshotNode> records)
+{
+	auto const root = broadphase->m_sets[set].m_root;
+	if (!root)
+		return records.empty();
+
+	// DȂqĂH܂łɊԂ̂ŁAꂽƂɓǂݍł΂悢
+	nodeQueue.clear();
+	nodeQueue.push_back(root);
+	for (std::size_t n = 0; n < nodeQueue.size(); n++)
+	{
+		if (n >= records.size())
+			return false;
+
+		auto const node = nodeQueue[n];
+		auto& record = records[n];
+		compact_store(record.mins, node->volume.Mins());
+		compact_store(record.maxs, node->volume.Maxs());
+		record.address = reinterpret_cast<std::uintptr_t>(node);
+		if (node->isleaf())
+		{
+			record.child[0] = record.child[1] = -1;
+			record.proxy = static_cast<btBroadphaseProxy*>(node->data)->m_uniqueId;
+		}
+		else
+		{
+			record.proxy = -1;
+			for (int c = 0; c < 2; c++)
+			{
+				record.child[c] = static_cast<int>(nodeQueue.size());
+				nodeQueue.push_back(node->childs[c]);
+				prefetch(node->childs[c]);
+			}
+		}
+	}
+
+	return nodeQueue.size() == records.size();
+}
+
+inline bool WorldSnapshotter::capturePairs(WorldSnapshot& snapshot, WorldSnapshotLayout const& layout)
+{
+	auto const& header = snapshot.getHeader();
+	auto const dispatcher = world->getDispatcher();
+	auto const& pairArray = world->getPairCache()->getOverlappingPairArray();
+	auto const pairRecords = snapshot.section<SnapshotPair>(layout.pairs, header.pairNum);
+	auto const pairManifolds = snapshot.section<int>(layout.pairManifolds, header.manifoldNum);
+	auto const manifoldRecords = snapshot.section<SnapshotManifold>(layout.manifolds, header.manifoldNum);
+	auto const manifoldNum = static_cast<std::size_t>(header.manifoldNum);
+
+	// ɃyÃASY}jtH[hW߁Ał܂Ƃ߂Ēgǂ
+	// ASŶȂyA̓vLV
+	manifolds.clear();
+	for (int i = 0; i < header.pairNum; i++)
+	{
+		if (i + PREFETCH_DISTANCE < header.pairNum && pairArray[i + PREFETCH_DISTANCE].m_algorithm)
+			prefetch(pairArray[i + PREFETCH_DISTANCE].m_algorithm);
+
+		auto const& pair = pairArray[i];
+		auto& record = pairRecords[i];
+		record.proxy0 = pair.m_pProxy0->m_uniqueId;
+		record.proxy1 = pair.m_pProxy1->m_uniqueId;
+		record.manifoldBegin = static_cast<int>(manifolds.size());
+		if (!pair.m_algorithm)
+		{
+			record.manifoldNum = -1;
+			continue;
+		}
+
+		manifoldArray.resizeNoInitialize(0);
+		pair.m_algorithm->getAllContactManifolds(manifoldArray);
+		record.manifoldNum = manifoldArray.size();
+		if (manifolds.size() + static_cast<std::size_t>(manifoldArray.size()) > manifoldNum)
+			return false;
+		for (int j = 0; j < manifoldArray.size(); j++)
+			manifolds.push_back(manifoldArray[j]);
+	}
+
+	// \̐ڐGȂǃyÂ̂łȂ}jtH[h͍蒼Ȃ
+	if (manifolds.size() != manifoldNum)
+		return false;
+
+	// }jtH[h̓fBXpb`̔zł̈ʒuɏAȂ臒l
+	points.clear();
+	for (std::size_t n = 0; n < manifoldNum; n++)
+	{
+		if (n + PREFETCH_DISTANCE < manifoldNum)
+			prefetch(&manifolds[n + PREFETCH_DISTANCE]->m_index1a);
+
+		auto const manifold = manifolds[n];
+		auto const index = manifold->m_index1a;
+		if (index < 0 || index >= header.manifoldNum || dispatcher->getManifoldByIndexInternal(index) != manifold)
+			return false;
+		pairManifolds[n] = index;
+
+		auto& manifoldRecord = manifoldRecords[index];
+		manifoldRecord.contactBreakingThreshold = manifold->getContactBreakingThreshold();
+		manifoldRecord.contactProcessingThreshold = manifold->getContactProcessingThreshold();
+		manifoldRecord.pointBegin = static_cast<int>(points.size());
+		manifoldRecord.pointNum = manifold->getNumContacts();
+		for (int k = 0; k < manifoldRecord.pointNum; k++)
+		{
+			auto& point = points.emplace_back(manifold->getContactPoint(k));
+			point.m_userPersistentData = nullptr;
+		}
+	}
+
+	return true;
+}
+
+inline bool WorldSnapshotter::restore(WorldSnapshot const& snapshot)
+{
+	restoreStats = {};
+	if (!isSupported() || snapshot.empty())
+		return false;
+
+	// uid͍邽тɑ̂ŁAȂvLV͎Ƃ̂܂
+	auto const& header = snapshot.getHeader();
+	auto const layout = make_world_snapshot_layout(header);
+	if (layout.size != snapshot.buffer.size() || header.objectNum != world->getNumCollisionObjects() || header.constraintNum != world->getNumConstraints() ||
+		header.gid != broadphase->m_gid)
+		return false;
+
+	auto const& objects = world->getCollisionObjectArray();
+	proxies.assign(static_cast<std::size_t>(header.gid) + 1, nullptr);
+	for (int i = 0; i < objects.size(); i++)
+	{
+		auto const proxy = static_cast<btDbvtProxy*>(objects[i]->getBroadphaseHandle());
+		if (!proxy || proxy->m_uniqueId < 0 || proxy->m_uniqueId > header.gid)
+			return false;
+		proxies[static_cast<std::size_t>(proxy->m_uniqueId)] = proxy;
+	}
+
+	// Xe[W̃XĝȂ悪[h̃vLV
+	auto const isProxy = [&](int uid) {
+		return uid == -1 || (uid >= 0 && uid <= header.gid && proxies[static_cast<std::size_t>(uid)]);
+	};
+	for (auto const root : header.stageRoots)
+	{
+		if (!isProxy(root))
+			return false;
+	}
+	for (auto const& record : snapshot.section<SnapshotObject>(layout.objects, header.objectNum))
+	{
+		if (record.stage < 0 || record.stage > btDbvtBroadphase::STAGECOUNT || !isProxy(record.nextProxy))
+			return false;
+	}
+
+	restoreObjects(snapshot, layout);
+	restoreConstraints(snapshot, layout);
+	restoreBroadphase(snapshot, layout);
+	return restorePairs(snapshot, layout);
+}
+
+inline void WorldSnapshotter::restoreObjects(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout)
+{
+	auto const& header = snapshot.getHeader();
+	auto const& objects = world->getCollisionObjectArray();
+	auto const objectRecords = snapshot.section<SnapshotObject>(layout.objects, header.objectNum);
+	for (int i = 0; i < header.objectNum; i++)
+	{
+		if (i + PREFETCH_DISTANCE < header.objectNum)
+			prefetchObject(objects[i + PREFETCH_DISTANCE]);
+
+		// ɓĂȂ́AĂ̂͐GȂ
+		auto const object = objects[i];
+		auto const& record = objectRecords[i];
+		if (isObjectUnchanged(object, record))
+			continue;
+		restoreStats.restoredObjectNum++;
+
+		auto const& t = record.transform;
+		btTransform const transform{ btMatrix3x3{ t[0][0], t[0][1], t[0][2], t[1][0], t[1][1], t[1][2], t[2][0], t[2][1], t[2][2] }, compact_load(t[3]) };
+
+		object->forceActivationState(record.activationState);
+		object->setDeactivationTime(record.deactivationTime);
+		object->setHitFraction(record.hitFraction);
+		auto const body = btRigidBody::upcast(object);
+		if (body && !body->isKinematicObject())
+		{
+			// ԗp̎pƑxAXebv̏IƓ̂̂ɂāAe\vZȂ
+			body->setLinearVelocity(compact_load(record.linearVelocity));
+			body->setAngularVelocity(compact_load(record.angularVelocity));
+			body->setCenterOfMassTransform(transform);
+			body->clearForces();
+		}
+		else
+			object->setWorldTransform(transform);
+
+		auto const proxy = object->getBroadphaseHandle();
+		proxy->m_aabbMin = compact_load(record.aabbMin);
+		proxy->m_aabbMax = compact_load(record.aabbMax);
+	}
+}
+
+inline void WorldSnapshotter::restoreConstraints(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout)
+{
+	auto const& header = snapshot.getHeader();
+	auto const constraintRecords = snapshot.section<SnapshotConstraint>(layout.constraints, header.constraintNum);
+	for (int i = 0; i < header.constraintNum; i++)
+	{
+		auto const constraint = world->getConstraint(i);
+		constraint->internalSetAppliedImpulse(constraintRecords[i].appliedImpulse);
+		constraint->setEnabled(constraintRecords[i].enabled != 0);
+	}
+}
+
+inline void WorldSnapshotter::restoreBroadphase(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout)
+{
+	auto const& header = snapshot.getHeader();
+
+	collectNodes(snapshot, layout);
+
+	// AhXɖ߂Ƃ́AƂƓ߂Ȃ
+	auto const exact = restoreStats.exactNodes;
+	auto const sameVolume = [](btDbvtNode const* node, SnapshotNode const& record) {
+		btScalar mins[3];
+		btScalar maxs[3];
+		compact_store(mins, node->volume.Mins());
+		compact_store(maxs, node->volume.Maxs());
+		return std::memcmp(mins, record.mins, sizeof(mins)) == 0 && std::memcmp(maxs, record.maxs, sizeof(maxs)) == 0;
+	};
+
+	// nodes0Ԗڂ̖؁A1Ԗڂ̖؁Am_freȅ
+	std::size_t base = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		auto& tree = broadphase->m_sets[i];
+		auto const records = snapshot.section<SnapshotNode>(layout.nodes[i], header.nodeNum[i]);
+		for (std::size_t n = 0; n < records.size(); n++)
+		{
+			if (n + PREFETCH_DISTANCE < records.size())
+				prefetch(nodes[base + n + PREFETCH_DISTANCE]);
+
+			auto const& record = records[n];
+			auto const node = nodes[base + n];
+			if (record.proxy >= 0)
+			{
+				auto const proxy = proxies[static_cast<std::size_t>(record.proxy)];
+				if (exact && node->data == proxy && !node->childs[1] && proxy->leaf == node && sameVolume(node, record))
+					continue;
+
+				node->childs[0] = node->childs[1] = nullptr;
+				node->data = proxy;
+				proxy->leaf = node;
+			}
+			else
+			{
+				auto const child0 = nodes[base + static_cast<std::size_t>(record.child[0])];
+				auto const child1 = nodes[base + static_cast<std::size_t>(record.child[1])];
+				if (exact && node->childs[0] == child0 && node->childs[1] == child1 && child0->parent == node && child1->parent == node && sameVolume(node, record))
+					continue;
+
+				node->childs[0] = child0;
+				node->childs[1] = child1;
+				child0->parent = node;
+				child1->parent = node;
+			}
+			node->volume = btDbvtVolume::FromMM(compact_load(record.mins), compact_load(record.maxs));
+			restoreStats.restoredNodeNum++;
+		}
+
+		tree.m_root = records.empty() ? nullptr : nodes[base];
+		if (tree.m_root)
+			tree.m_root->parent = nullptr;
+		tree.m_lkhd = header.lkhd[i];
+		tree.m_leaves = header.leaves[i];
+		tree.m_opath = header.opath[i];
+		base += records.size();
+	}
+	for (int i = 0; i < 2; i++)
+		broadphase->m_sets[i].m_free = header.freeNode[i] ? nodes[base++] : nullptr;
+
+	// Xe[W̃XgȂȂAÕvLṼ͎vLVȂƂɏ
+	auto const& objects = world->getCollisionObjectArray();
+	auto const objectRecords = snapshot.section<SnapshotObject>(layout.objects, header.objectNum);
+	for (int i = 0; i < header.objectNum; i++)
+	{
+		auto const& record = objectRecords[i];
+		auto const proxy = static_cast<btDbvtProxy*>(objects[i]->getBroadphaseHandle());
+		proxy->stage = record.stage;
+		proxy->links[1] = record.nextProxy >= 0 ? proxies[static_cast<std::size_t>(record.nextProxy)] : nullptr;
+		if (proxy->links[1])
+			proxy->links[1]->links[0] = proxy;
+	}
+	for (int stage = 0; stage <= btDbvtBroadphase::STAGECOUNT; stage++)
+	{
+		auto const root = header.stageRoots[stage];
+		broadphase->m_stageRoots[stage] = root >= 0 ? proxies[static_cast<std::size_t>(root)] : nullptr;
+		if (broadphase->m_stageRoots[stage])
+			broadphase->m_stageRoots[stage]->links[0] = nullptr;
+	}
+
+	broadphase->m_stageCurrent = header.stageCurrent;
+	broadphase->m_fupdates = header.fupdates;
+	broadphase->m_dupdates = header.dupdates;
+	broadphase->m_cupdates = header.cupdates;
+	broadphase->m_newpairs = header.newpairs;
+	broadphase->m_fixedleft = header.fixedleft;
+	broadphase->m_updates_call = header.updatesCall;
+	broadphase->m_updates_done = header.updatesDone;
+	broadphase->m_updates_ratio = header.updatesRatio;
+	broadphase->m_pid = header.pid;
+	broadphase->m_cid = header.cid;
+	broadphase->m_needcleanup = header.needCleanup != 0;
+	if (parallelBroadphase)
+		parallelBroadphase->setReinsertCursor(static_cast<std::size_t>(header.reinsertCursor));
+}
+
+inline void WorldSnapshotter::collectNodes(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout)
+{
+	auto const& header = snapshot.getHeader();
+
+	pool.clear();
+	for (int i = 0; i < 2; i++)
+	{
+		auto const& tree = broadphase->m_sets[i];
+		if (tree.m_free)
+			pool.push_back(tree.m_free);
+		if (!tree.m_root)
+			continue;
+
+		// pool̂܂ܕD̑҂sɂ
+		auto n = pool.size();
+		pool.push_back(tree.m_root);
+		for (; n < pool.size(); n++)
+		{
+			auto const node = pool[n];
+			if (node->isinternal())
+			{
+				for (auto const child : node->childs)
+				{
+					pool.push_back(child);
+					prefetch(child);
+				}
+			}
+		}
+	}
+
+	// ۑ߂̃AhXA0Ԗڂ̖؁A1Ԗڂ̖؁Am_freȅɕׂ
+	addressOrder.clear();
+	for (int i = 0; i < 2; i++)
+	{
+		for (auto const& record : snapshot.section<SnapshotNode>(layout.nodes[i], header.nodeNum[i]))
+			addressOrder.emplace_back(record.address, static_cast<int>(addressOrder.size()));
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		if (header.freeNode[i])
+			addressOrder.emplace_back(header.freeNode[i], static_cast<int>(addressOrder.size()));
+	}
+	nodes.resize(addressOrder.size());
+
+	// ߂ScĂ΁AAhXɖ߂
+	// Xebvŗt}ȂƂ͊Oe̐߂g܂킷̂ŁAvLVXe[WڂȂ΂Ȃ
+	restoreStats.exactNodes = false;
+	if (pool.size() == addressOrder.size())
+	{
+		auto const tableSize = std::bit_ceil(std::max<std::size_t>(pool.size() * 2, 16));
+		auto const shift = 64 - std::countr_zero(tableSize);
+		auto const home = [&](std::uintptr_t address) {
+			return static_cast<std::size_t>((static_cast<std::uint64_t>(address) * 0x9E3779B97F4A7C15ull) >> shift);
+		};
+		addressTable.assign(tableSize, 0);
+		for (auto const node : pool)
+		{
+			auto const address = reinterpret_cast<std::uintptr_t>(node);
+			auto slot = home(address);
+			while (addressTable[slot])
+				slot = (slot + 1) & (tableSize - 1);
+			addressTable[slot] = address;
+		}
+
+		restoreStats.exactNodes = true;
+		for (auto const& [address, index] : addressOrder)
+		{
+			auto slot = home(address);
+			while (addressTable[slot] && addressTable[slot] != address)
+				slot = (slot + 1) & (tableSize - 1);
+			if (addressTable[slot] != address)
+			{
+				restoreStats.exactNodes = false;
+				break;
+			}
+			nodes[static_cast<std::size_t>(index)] = reinterpret_cast<btDbvtNode*>(address);
+		}
+		if (restoreStats.exactNodes)
+			return;
+	}
+
+	// 킹āAۑAhX̑召̏ɍ̐߂蓖Ă
+	// ₵߂̃AhX͑IׂȂ̂ŁǍ̃XebvɂȂƂ͌Ȃ
+	while (pool.size() > addressOrder.size())
+	{
+		btAlignedFree(pool.back());
+		pool.pop_back();
+	}
+	while (pool.size() < addressOrder.size())
+		pool.push_back(new (btAlignedAlloc(sizeof(btDbvtNode), 16)) btDbvtNode());
+
+	std::sort(pool.begin(), pool.end());
+	std::sort(addressOrder.begin(), addressOrder.end());
+	for (std::size_t i = 0; i < pool.size(); i++)
+		nodes[static_cast<std::size_t>(addressOrder[i].second)] = pool[i];
+}
+
+inline bool WorldSnapshotter::restorePairs(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout)
+{
+	auto const& header = snapshot.getHeader();
+	auto const& pairArray = world->getPairCache()->getOverlappingPairArray();
+	auto const pairRecords = snapshot.section<SnapshotPair>(layout.pairs, header.pairNum);
+	auto const pairManifolds = snapshot.section<int>(layout.pairManifolds, header.manifoldNum);
+
+	manifolds.assign(static_cast<std::size_t>(header.manifoldNum), nullptr);
+
+	// 擪ƂƓyÁAzASŶ܂܎g
+	auto const pairNum = std::min(pairArray.size(), header.pairNum);
+	auto& kept = restoreStats.keptPairNum;
+	for (; kept < pairNum; kept++)
+	{
+		if (kept + PREFETCH_DISTANCE < pairNum && pairArray[kept + PREFETCH_DISTANCE].m_algorithm)
+			prefetch(pairArray[kept + PREFETCH_DISTANCE].m_algorithm);
+
+		auto const& pair = pairArray[kept];
+		auto const& record = pairRecords[kept];
+		auto const same = pair.m_pProxy0->m_uniqueId == record.proxy0 && pair.m_pProxy1->m_uniqueId == record.proxy1 &&
+			(pair.m_algorithm != nullptr) == (record.manifoldNum >= 0) &&
+			(!pair.m_algorithm || placeManifolds(pair.m_algorithm, record, pairManifolds));
+		if (!same)
+			break;
+	}
+
+	if ((kept != header.pairNum || pairArray.size() != header.pairNum) && !rebuildPairs(snapshot, layout))
+		return false;
+
+	// fBXpb`̔zƂ̏ɕׂȂāAg߂
+	auto const dispatcher = world->getDispatcher();
+	if (dispatcher->getNumManifolds() != header.manifoldNum)
+		return false;
+
+	auto const manifoldRecords = snapshot.section<SnapshotManifold>(layout.manifolds, header.manifoldNum);
+	auto const pointRecords = snapshot.section<btManifoldPoint>(layout.points, header.pointNum);
+	auto const manifoldPtr = dispatcher->getInternalManifoldPointer();
+	if (std::find(manifolds.begin(), manifolds.end(), nullptr) != manifolds.end())
+		return false;
+	for (int i = 0; i < header.manifoldNum; i++)
+	{
+		if (i + PREFETCH_DISTANCE < header.manifoldNum)
+			prefetch(&manifolds[static_cast<std::size_t>(i + PREFETCH_DISTANCE)]->m_index1a);
+
+		auto const manifold = manifolds[static_cast<std::size_t>(i)];
+		auto const& record = manifoldRecords[i];
+		manifoldPtr[i] = manifold;
+		manifold->m_index1a = i;
+		// ̂܂܂̃}jtH[h臒l߂
+		if (record.pointNum > 0 || manifold->getNumContacts() > 0)
+		{
+			manifold->clearManifold();
+			manifold->setNumContacts(record.pointNum);
+			for (int j = 0; j < record.pointNum; j++)
+				manifold->getContactPoint(j) = pointRecords[static_cast<std::size_t>(record.pointBegin + j)];
+		}
+		manifold->setContactBreakingThreshold(record.contactBreakingThreshold);
+		manifold->setContactProcessingThreshold(record.contactProcessingThreshold);
+	}
+
+	return true;
+}
+
+inline bool WorldSnapshotter::rebuildPairs(WorldSnapshot const& snapshot, WorldSnapshotLayout const& layout)
+{
+	auto const& header = snapshot.getHeader();
+	auto const dispatcher = world->getDispatcher();
+	auto const pairCache = world->getPairCache();
+	auto& pairArray = pairCache->getOverlappingPairArray();
+	auto const pairRecords = snapshot.section<SnapshotPair>(layout.pairs, header.pairNum);
+	auto const pairManifolds = snapshot.section<int>(layout.pairManifolds, header.manifoldNum);
+
+	restoreStats.pairsRebuilt = true;
+	auto const kept = restoreStats.keptPairNum;
+
+	// cyÃASYOĂyAA납ΎcyA͓Ȃ
+	algorithms.clear();
+	for (int i = kept; i < pairArray.size(); i++)
+	{
+		auto& pair = pairArray[i];
+		if (pair.m_algorithm)
+			algorithms.emplace_back(make_pair_key(pair.m_pProxy0, pair.m_pProxy1), pair.m_algorithm);
+		pair.m_algorithm = nullptr;
+	}
+	std::sort(algorithms.begin(), algorithms.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+
+	while (pairArray.size() > kept)
+	{
+		auto const& pair = pairArray[pairArray.size() - 1];
+		pairCache->removeOverlappingPair(pair.m_pProxy0, pair.m_pProxy1, dispatcher);
+	}
+
+	// Ƃ̏ɑȂāAcĂASYtȂ
+	auto result = true;
+	for (int i = kept; i < header.pairNum; i++)
+	{
+		auto const& record = pairRecords[i];
+		auto const proxy0 = proxies[static_cast<std::size_t>(record.proxy0)];
+		auto const proxy1 = proxies[static_cast<std::size_t>(record.proxy1)];
+		auto const pair = pairCache->addOverlappingPair(proxy0, proxy1);
+		if (!pair)
+		{
+			result = false;
+			continue;
+		}
+		if (record.manifoldNum < 0)
+			continue;
+
+		btCollisionAlgorithm* algorithm = nullptr;
+		auto const key = make_pair_key(proxy0, proxy1);
+		auto const it = std::lower_bound(algorithms.begin(), algorithms.end(), key, [](auto const& a, std::uint64_t k) { return a.first < k; });
+		if (it != algorithms.end() && it->first == key)
+		{
+			algorithm = std::exchange(it->second, nullptr);
+			if (!placeManifolds(algorithm, record, pairManifolds))
+			{
+				destroyAlgorithm(algorithm);
+				algorithm = nullptr;
+			}
+		}
+		if (!algorithm)
+		{
+			algorithm = createAlgorithm(*pair, record.manifoldNum);
+			if (!algorithm || !placeManifolds(algorithm, record, pairManifolds))
+				result = false;
+		}
+		pair->m_algorithm = algorithm;
+	}
+
+	// ɂłyÃASŶ͎Ă
+	for (auto const& [key, algorithm] : algorithms)
+	{
+		if (algorithm)
+			destroyAlgorithm(algorithm);
+	}
+
+	return result;
+}
+
+inline btCollisionAlgorithm* WorldSnapshotter::createAlgorithm(btBroadphasePair const& pair, int manifoldNum)
+{
+	auto const object0 = static_cast<btCollisionObject*>(pair.m_pProxy0->m_clientObject);
+	auto const object1 = static_cast<btCollisionObject*>(pair.m_pProxy1->m_clientObject);
+	btCollisionObjectWrapper wrap0{ nullptr, object0->getCollisionShape(), object0, object0->getWorldTransform(), -1, -1 };
+	btCollisionObjectWrapper wrap1{ nullptr, object1->getCollisionShape(), object1, object1->getWorldTransform(), -1, -1 };
+
+	auto const dispatcher = world->getDispatcher();
+	auto const algorithm = dispatcher->findAlgorithm(&wrap0, &wrap1, nullptr, BT_CONTACT_POINT_ALGORITHMS);
+	if (!algorithm)
+		return nullptr;
+	restoreStats.createdAlgorithmNum++;
+
+	// btConvexConvexAlgorithmȂǂ͍ŏprocessCollisionŃ}jtH[ĥŁAxĂō点
+	// ڐG_͌ŕۑ̂ŏ㏑
+	manifoldArray.resizeNoInitialize(0);
+	algorithm->getAllContactManifolds(manifoldArray);
+	if (manifoldArray.size() < manifoldNum)
+	{
+		btManifoldResult result{ &wrap0, &wrap1 };
+		algorithm->processCollision(&wrap0, &wrap1, world->getDispatchInfo(), &result);
+	}
+
+	return algorithm;
+}
+
+inline void WorldSnapshotter::destroyAlgorithm(btCollisionAlgorithm* algorithm)
+{
+	// btHashedOverlappingPairCache::cleanOverlappingPairƓ
+	algorithm->~btCollisionAlgorithm();
+	world->getDispatcher()->freeCollisionAlgorithm(algorithm);
+	restoreStats.destroyedAlgorithmNum++;
+}
+
+inline bool WorldSnapshotter::placeManifolds(btCollisionAlgorithm* algorithm, SnapshotPair const& record, std::span<int const> pairManifolds)
+{
+	manifoldArray.resizeNoInitialize(0);
+	algorithm->getAllContactManifolds(manifoldArray);
+	if (manifoldArray.size() != record.manifoldNum)
+		return false;
+
+	for (int i = 0; i < record.manifoldNum; i++)
+		manifolds[static_cast<std::size_t>(pairManifolds[static_cast<std::size_t>(record.manifoldBegin + i)])] = manifoldArray[i];
+	return true;
+}
@@ -9,7 +9,11 @@
 #include<chrono>
 #include"obj_loader.hpp"
 #include"Shape.hpp"
-#include"DebugDraw.hpp"
+#include"RenderExtractor.hpp"
+#include"FixedStepper.hpp"
+#include"Scene.hpp"
+#include"ProfilerPanel.hpp"
+#include"SimulationRecorder.hpp"
 
 #define _CRTDBG_MAP_ALLOC
 #include <cstdlib>
@@ -25,6 +29,8 @@ constexpr std::size_t FRAME_BUFFER_NUM = 2;
 
 constexpr DXGI_FORMAT DEPTH_BUFFER_FORMAT = DXGI_FORMAT_D32_FLOAT;
 
+constexpr char const* RECORDING_FILE_NAME = "recording.pbrec";
+
 
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
@@ -98,234 +104,57 @@ int main()
 	// Shape
 	//
 
-	auto box = std::make_unique<ShapeResource>(device.get(), "data/box.obj", cameraDataResource.first.get());
-	auto sphere = std::make_unique<ShapeResource>(device.get(), "data/sphere.obj", cameraDataResource.first.get());
-	auto capsule = std::make_unique<ShapeResource>(device.get(), "data/capsule.obj", cameraDataResource.first.get());
+	auto box = std::make_unique<ShapeResource>(device.get(), "data/box.obj", cameraDataResource.first.get(), FRAME_BUFFER_NUM);
+	auto sphere = std::make_unique<ShapeResource>(device.get(), "data/sphere.obj", cameraDataResource.first.get(), FRAME_BUFFER_NUM);
+	auto capsule = std::make_unique<ShapeResource>(device.get(), "data/capsule.obj", cameraDataResource.first.get(), FRAME_BUFFER_NUM);
 
 	auto shapePipeline = std::make_unique<ShapePipeline>(device.get(), FRAME_BUFFER_FORMAT);
 
-	DebugDraw debugDraw{};
-	debugDraw.setDebugMode(btIDebugDraw::DBG_DrawWireframe
-		| btIDebugDraw::DBG_DrawContactPoints
-		| btIDebugDraw::DBG_DrawConstraints);
-
 
 	//
 	// Bullet
 	//
 
-	///collision configuration contains default setup for memory, collision setup. Advanced users can create their own configuration.
-	btDefaultCollisionConfiguration* collisionConfiguration = new btDefaultCollisionConfiguration();
-
-	///use the default collision dispatcher. For parallel processing you can use a diffent dispatcher (see Extras/BulletMultiThreaded)
-	btCollisionDispatcher* dispatcher = new btCollisionDispatcher(collisionConfiguration);
-
-	///btDbvtBroadphase is a good general purpose broadphase. You can also try out btAxis3Sweep.
-	btBroadphaseInterface* overlappingPairCache = new btDbvtBroadphase();
-
-	///the default constraint solver. For parallel processing you can use a different solver (see Extras/BulletMultiThreaded)
-	btSequentialImpulseConstraintSolver* solver = new btSequentialImpulseConstraintSolver;
-
-	btDiscreteDynamicsWorld* dynamicsWorld = new btDiscreteDynamicsWorld(dispatcher, overlappingPairCache, solver, collisionConfiguration);
-
-	dynamicsWorld->setGravity(btVector3(0, -9.8, 0));
-
-	///-----initialization_end-----
-
-
-	//keep track of the shapes, we release memory at exit.
-	//make sure to re-use collision shapes among rigid bodies whenever possible!
-	btAlignedObjectArray<btCollisionShape*> collisionShapes;
-
-	///create a few basic rigid bodies
-
-	//the ground is a cube of side 100 at position y = -56.
-	//the sphere will hit it at y = -6, with center at -5
-	{
-		btCollisionShape* groundShape = new btBoxShape(btVector3(btScalar(50.), btScalar(50.), btScalar(50.)));
-		collisionShapes.push_back(groundShape);
-
-		btTransform groundTransform;
-		groundTransform.setIdentity();
-		groundTransform.setOrigin(btVector3(0, -56, 0));
-
-		btScalar mass(0.);
-		btVector3 localInertia(0, 0, 0);
-
-		//using motionstate is optional, it provides interpolation capabilities, and only synchronizes 'active' objects
-		btDefaultMotionState* myMotionState = new btDefaultMotionState(groundTransform);
-		btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, myMotionState, groundShape, localInertia);
-		btRigidBody* body = new btRigidBody(rbInfo);
-
-
-		//add the body to the dynamics world
-		dynamicsWorld->addRigidBody(body);
-	}
+	auto stepper = std::make_unique<FixedStepper>();
+	auto scene = std::make_unique<Scene>(SceneConfig{ .stepper = stepper.get() });
+	auto dynamicsWorld = scene->getDynamicsWorld();
+	auto const& chain = scene->getChain(0);
 
-	btRigidBody* fixBox;
 	float fixBoxX = -2.f;
 	float fixBoxY = 10.f;
 	float fixBoxZ = 0.f;
-	{
-		btCollisionShape* groundShape = new btBoxShape(btVector3(btScalar(1.), btScalar(1.), btScalar(1.)));
-		collisionShapes.push_back(groundShape);
-
-		btTransform groundTransform;
-		groundTransform.setIdentity();
-		groundTransform.setOrigin(btVector3(fixBoxX, fixBoxY, fixBoxZ));
-
-		btScalar mass(0.);
-		btVector3 localInertia(0, 0, 0);
-
-		//using motionstate is optional, it provides interpolation capabilities, and only synchronizes 'active' objects
-		btDefaultMotionState* myMotionState = new btDefaultMotionState(groundTransform);
-		btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, myMotionState, groundShape, localInertia);
-		fixBox = new btRigidBody(rbInfo);
-
-
-		//add the body to the dynamics world
-		dynamicsWorld->addRigidBody(fixBox);
-	}
-
-	btRigidBody* body1;
-	btRigidBody* body2;
-	btRigidBody* body3;
-	{
-		//create a dynamic rigidbody
-
-		//btCollisionShape* colShape = new btBoxShape(btVector3(1,1,1));
-		// btCollisionShape* colShape = new btSphereShape(btScalar(1.));
-		btCollisionShape* colShape = new btCapsuleShape(btScalar(1.), btScalar(4.));
-		collisionShapes.push_back(colShape);
 
-		/// Create Dynamic Objects
-		btTransform startTransform;
-		startTransform.setIdentity();
-		startTransform.setRotation(btQuaternion(0.f, 0.f, 0.5f, 1.f));
+	// `悷鍄̂̊
+	RenderExtractor renderExtractor{};
+	renderExtractor.rebuild(dynamicsWorld);
 
-		btScalar mass(1.f);
-		btVector3 localInertia(0, 0, 0);
-		colShape->calculateLocalInertia(mass, localInertia);
+	// `Ƃ̕`f[^Aς̂extract
+	std::array<std::vector<std::array<float, 16>>, RENDER_SHAPE_TYPE_NUM> renderTransforms{};
+	std::array<std::vector<std::array<float, 3>>, RENDER_SHAPE_TYPE_NUM> renderColors{};
 
+	// `f[^̑傫킹ďݐtւ
+	auto const bind_render_output = [&](auto& source) {
+		for (auto type : { RenderShapeType::Box, RenderShapeType::Sphere, RenderShapeType::Capsule })
 		{
-			startTransform.setOrigin(btVector3(2, 18, 0));
-
-			//using motionstate is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
-			btDefaultMotionState* myMotionState = new btDefaultMotionState(startTransform);
-			btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, myMotionState, colShape, localInertia);
-			rbInfo.m_restitution = 1.f;
-			body1 = new btRigidBody(rbInfo);
-
-			dynamicsWorld->addRigidBody(body1);
-		}
-
-		{
-			startTransform.setOrigin(btVector3(2, 10, 0));
-
-			//using motionstate is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
-			btDefaultMotionState* myMotionState = new btDefaultMotionState(startTransform);
-			btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, myMotionState, colShape, localInertia);
-			rbInfo.m_restitution = 1.f;
-			body2 = new btRigidBody(rbInfo);
-
-			dynamicsWorld->addRigidBody(body2);
-		}
-
-		{
-			startTransform.setOrigin(btVector3(2, 2, 0));
-
-			//using motionstate is recommended, it provides interpolation capabilities, and only synchronizes 'active' objects
-			btDefaultMotionState* myMotionState = new btDefaultMotionState(startTransform);
-			btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, myMotionState, colShape, localInertia);
-			rbInfo.m_restitution = 1.f;
-			body3 = new btRigidBody(rbInfo);
-
-			dynamicsWorld->addRigidBody(body3);
-		}
-
-		{
-			btTransform frameInA, frameInB;
-			frameInA = btTransform::getIdentity();
-			frameInA.setOrigin(btVector3(btScalar(0.), btScalar(-3), btScalar(0.)));
-			frameInB = btTransform::getIdentity();
-			frameInB.setOrigin(btVector3(btScalar(0.), btScalar(3), btScalar(0.)));
-
-			btGeneric6DofSpringConstraint* pGen6DOFSpring = new btGeneric6DofSpringConstraint(*body1, *body2, frameInA, frameInB, true);
-			pGen6DOFSpring->setLinearUpperLimit(btVector3(0., 1., 0.));
-			pGen6DOFSpring->setLinearLowerLimit(btVector3(0., -1., 0.));
-
-			pGen6DOFSpring->setAngularLowerLimit(btVector3(0.f, 0.f, -1.5f));
-			pGen6DOFSpring->setAngularUpperLimit(btVector3(0.f, 0.f, 1.5f));
-
-			dynamicsWorld->addConstraint(pGen6DOFSpring, true);
-			pGen6DOFSpring->setDbgDrawSize(btScalar(5.f));
-
-			pGen6DOFSpring->enableSpring(0, true);
-			pGen6DOFSpring->setStiffness(0, 39.478f);
-			pGen6DOFSpring->setDamping(0, 0.5f);
-			pGen6DOFSpring->setEquilibriumPoint();
-		}
-
-		{
-			btTransform frameInA, frameInB;
-			frameInA = btTransform::getIdentity();
-			frameInA.setOrigin(btVector3(btScalar(0.), btScalar(-1), btScalar(0.)));
-			frameInB = btTransform::getIdentity();
-			frameInB.setOrigin(btVector3(btScalar(0.), btScalar(1), btScalar(0.)));
-
-			btGeneric6DofSpringConstraint* pGen6DOFSpring = new btGeneric6DofSpringConstraint(*body2, *body3, frameInA, frameInB, true);
-			pGen6DOFSpring->setLinearUpperLimit(btVector3(0., 1., 0.));
-			pGen6DOFSpring->setLinearLowerLimit(btVector3(0., -1., 0.));
-
-			pGen6DOFSpring->setAngularLowerLimit(btVector3(0.f, 0.f, -1.5f));
-			pGen6DOFSpring->setAngularUpperLimit(btVector3(0.f, 0.f, 1.5f));
-
-			dynamicsWorld->addConstraint(pGen6DOFSpring, true);
-			pGen6DOFSpring->setDbgDrawSize(btScalar(5.f));
-
-			pGen6DOFSpring->enableSpring(0, true);
-			pGen6DOFSpring->setStiffness(0, 39.478f);
-			pGen6DOFSpring->enableSpring(1, true);
-			pGen6DOFSpring->setStiffness(1, 39.478f);
-			pGen6DOFSpring->enableSpring(2, true);
-			pGen6DOFSpring->setStiffness(2, 39.478f);
-			pGen6DOFSpring->enableSpring(3, true);
-			pGen6DOFSpring->setStiffness(3, 39.478f);
-			pGen6DOFSpring->enableSpring(4, true);
-			pGen6DOFSpring->setStiffness(4, 39.478f);
-			pGen6DOFSpring->enableSpring(5, true);
-			pGen6DOFSpring->setStiffness(5, 39.478f);
-
-			pGen6DOFSpring->setDamping(0, 0.5f);
-			pGen6DOFSpring->setEquilibriumPoint();
+			auto const i = static_cast<std::size_t>(type);
+			renderTransforms[i].resize(source.getInstanceNum(type));
+			renderColors[i].resize(source.getInstanceNum(type));
+			source.setOutput(type, { renderTransforms[i].data(), renderColors[i].data(), renderTransforms[i].size() });
 		}
+	};
+	bind_render_output(renderExtractor);
 
-		{
-			btTransform frameInA, frameInB;
-			frameInA = btTransform::getIdentity();
-			frameInA.setOrigin(btVector3(btScalar(0.), btScalar(-3), btScalar(0.)));
-			frameInB = btTransform::getIdentity();
-			frameInB.setOrigin(btVector3(btScalar(0.), btScalar(-3), btScalar(0.)));
-
-			btGeneric6DofSpringConstraint* pGen6DOFSpring = new btGeneric6DofSpringConstraint(*body3, *fixBox, frameInA, frameInB, true);
-			pGen6DOFSpring->setLinearUpperLimit(btVector3(0., 1., 0.));
-			pGen6DOFSpring->setLinearLowerLimit(btVector3(0., -1., 0.));
-
-			//pGen6DOFSpring->setAngularLowerLimit(btVector3(0.f, 0.f, -1.5f));
-			//pGen6DOFSpring->setAngularUpperLimit(btVector3(0.f, 0.f, 1.5f));
-
-			dynamicsWorld->addConstraint(pGen6DOFSpring, true);
-			pGen6DOFSpring->setDbgDrawSize(btScalar(5.f));
-
-			pGen6DOFSpring->enableSpring(0, true);
-			pGen6DOFSpring->setStiffness(0, 39.478f);
-			pGen6DOFSpring->setDamping(0, 0.5f);
-			pGen6DOFSpring->setEquilibriumPoint();
-		}
-	}
+	// Xebv̓AImGuĩplLɂ
+	get_profiler().setThreadName("main");
+	ProfileFrameHistory profileHistory{ get_step_profile_zone_names() };
+	std::vector<char const*> profileLabels{};
+	for (auto const& zone : STEP_PROFILE_ZONES)
+		profileLabels.push_back(zone.label);
 
-	// fobNp̃CX^X
-	dynamicsWorld->setDebugDrawer(&debugDraw);
+	// L^̓XebvƂɏԂAĐ̓V~[V~߂ċL^`
+	std::unique_ptr<SimulationRecorder> recorder{};
+	std::unique_ptr<SimulationReplay> replay{};
+	int replayFrame = 0;
 
 
 	//
@@ -379,7 +208,7 @@ int main()
 	float cameraNearZ = 0.01f;
 	float cameraFarZ = 1000.f;
 
-	auto prevTime = std::chrono::system_clock::now();
+	auto prevTime = std::chrono::steady_clock::now();
 
 	std::array<float, 3> power{ 0.f,2.f,0.f };
 
@@ -393,26 +222,33 @@ int main()
 		// GW̃V~[V
 		//
 
-		auto deltaTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - prevTime).count();
-		if (deltaTime >= 1.f / 60.f * 1000.f)
 		{
-			dynamicsWorld->stepSimulation(deltaTime, 10);
-			prevTime = std::chrono::system_clock::now();
+			auto const now = std::chrono::steady_clock::now();
+			auto const deltaTime = std::chrono::duration<btScalar>(now - prevTime).count();
+			prevTime = now;
+
+			if (!replay)
+				stepper->update(dynamicsWorld, deltaTime);
+			PROFILE_COUNTER("manifolds", dynamicsWorld->getDispatcher()->getNumManifolds());
 		}
 
 		//
 		// GW̌ʂ`悷邽߂ɏ
 		//
 
-		debugDraw.sphereData.clear();
-		debugDraw.boxData.clear();
-		debugDraw.capsuleData.clear();
-
-		dynamicsWorld->debugDrawWorld();
+		if (replay)
+		{
+			replay->seek(static_cast<std::uint64_t>(replayFrame));
+			replay->extract();
+		}
+		else
+			renderExtractor.extract();
 
-		sphere->setShapeData(debugDraw.sphereData.begin(), debugDraw.sphereData.end());
-		box->setShapeData(debugDraw.boxData.begin(), debugDraw.boxData.end());
-		capsule->setShapeData(debugDraw.capsuleData.begin(), debugDraw.capsuleData.end());
+		for (auto [type, shape] : { std::pair{ RenderShapeType::Sphere, sphere.get() }, std::pair{ RenderShapeType::Box, box.get() }, std::pair{ RenderShapeType::Capsule, capsule.get() } })
+		{
+			auto const i = static_cast<std::size_t>(type);
+			shape->setShapeData(renderTransforms[i], renderColors[i]);
+		}
 
 		//
 		// ImGUȈ
@@ -423,28 +259,81 @@ int main()
 		ImGui_ImplWin32_NewFrame();
 		ImGui::NewFrame();
 
+		{
+			auto const& counter = stepper->getCounter();
+			ImGui::Text("steps %llu, backlog %.1f ms", counter.stepNum, stepper->getBacklog() * 1000.);
+			ImGui::Text("budget limited frames %llu (consecutive %llu)", counter.budgetLimitedFrameNum, counter.consecutiveBudgetLimitedFrameNum);
+			ImGui::Text("dropped %.1f ms in %llu frames", counter.droppedTime * 1000., counter.droppedFrameNum);
+		}
+
+		if (replay)
+		{
+			ImGui::SliderInt("replay frame", &replayFrame, 0, static_cast<int>(replay->getFrameNum()) - 1);
+			if (ImGui::Button("stop replay")) {
+				replay.reset();
+				bind_render_output(renderExtractor);
+				renderExtractor.invalidate();
+				prevTime = std::chrono::steady_clock::now();
+			}
+		}
+		else
+		{
+			bool recording = recorder != nullptr;
+			if (ImGui::Checkbox("record", &recording)) {
+				if (recording) {
+					try {
+						recorder = std::make_unique<SimulationRecorder>(dynamicsWorld, RECORDING_FILE_NAME);
+						// FixedStepper1t[ɉi߂ĂAXebvƂɋL^
+						dynamicsWorld->setInternalTickCallback([](btDynamicsWorld* world, btScalar) {
+							static_cast<SimulationRecorder*>(world->getWorldUserInfo())->record();
+						}, recorder.get());
+					}
+					catch (std::runtime_error const&) {
+					}
+				}
+				else {
+					dynamicsWorld->setInternalTickCallback(nullptr);
+					recorder.reset();
+				}
+			}
+
+			if (recorder) {
+				auto const counter = recorder->getCounter();
+				ImGui::Text("recorded %llu frames (dropped %llu), %.1f MB", counter.frameNum, counter.droppedFrameNum, counter.writtenBytes / (1024. * 1024.));
+			}
+			else if (ImGui::Button("replay")) {
+				try {
+					replay = std::make_unique<SimulationReplay>(RECORDING_FILE_NAME);
+				}
+				catch (std::runtime_error const&) {
+				}
+				if (replay && replay->getFrameNum() == 0)
+					replay.reset();
+				if (replay) {
+					replayFrame = 0;
+					bind_render_output(*replay);
+				}
+			}
+		}
+
+		profileHistory.endFrame(get_profiler());
+		draw_profiler_panel(get_profiler(), profileHistory, profileLabels, "trace.json");
+
 		ImGui::InputFloat3("eye", &eye.x);
 		ImGui::InputFloat3("target", &target.x);
 
 		ImGui::InputFloat3("impulse power", &power[0]);
 
 		if (ImGui::Button("Impulse!")) {
-			body1->activate(true);
-			body1->applyCentralImpulse(btVector3(power[0], power[1], power[2]));
+			chain.body1->activate(true);
+			chain.body1->applyCentralImpulse(btVector3(power[0], power[1], power[2]));
 		}
 
 		ImGui::SliderFloat("fix box x", &fixBoxX, -10.f, 10.f);
 		ImGui::SliderFloat("fix box y", &fixBoxY, -10.f, 10.f);
 		ImGui::SliderFloat("fix box z", &fixBoxZ, -10.f, 10.f);
 
-		{
-			btTransform groundTransform;
-			groundTransform.setIdentity();
-			groundTransform.setOrigin(btVector3(fixBoxX, fixBoxY, fixBoxZ));
-
-			body3->activate(true);
-			fixBox->setWorldTransform(groundTransform);
-		}
+		scene->setFixBoxPosition(0, btVector3(fixBoxX, fixBoxY, fixBoxZ));
 
 		// Rendering
 		ImGui::Render();
@@ -514,6 +403,11 @@ int main()
 	}
 
 
+	if (recorder) {
+		dynamicsWorld->setInternalTickCallback(nullptr);
+		recorder.reset();
+	}
+
 	ImGui_ImplDX12_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
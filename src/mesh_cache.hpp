@@ -0,0 +1,267 @@
+#pragma once
+#include"MappedFile.hpp"
+#include"obj_loader.hpp"
+#include<algorithm>
+#include<array>
+#include<cstdint>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<optional>
+#include<span>
+#include<string>
+#include<string_view>
+
+// load_obǰʂ̂܂܂̃CAEgŃoCiɕۑLbV
+// wb_A_ACfbNX̏ɕׂ̂ŁA}bv𒼐ڎg
+// wb_Ɍ̃t@C̃TCYƃnbVÃt@Cς蒼
+
+constexpr char MESH_CACHE_MAGIC[8] = { 'P', 'B', 'M', 'E', 'S', 'H', '\0', '\0' };
+constexpr std::uint32_t MESH_CACHE_VERSION = 1;
+constexpr char const* MESH_CACHE_EXTENSION = ".meshcache";
+
+struct MeshCacheHeader
+{
+	char magic[8]{};
+	std::uint32_t version{};
+	// 1_̃oCgAObjMesh̒_Ɠ
+	std::uint32_t vertexStride{};
+
+	std::uint64_t sourceSize{};
+	std::uint64_t sourceHash{};
+
+	std::uint32_t vertexNum{};
+	std::uint32_t indexNum{};
+
+	std::array<float, 3> boundsMin{};
+	std::array<float, 3> boundsMax{};
+};
+static_assert(sizeof(MeshCacheHeader) == 64);
+
+// LbV}bv
+// LbVȂƂ̓p[Xʂ̂܂܎
+class CachedMesh
+{
+	MappedFile file{};
+	ObjMesh ownedMesh{};
+
+	std::span<std::array<float, 6> const> vertices{};
+	std::span<std::uint32_t const> indices{};
+	std::array<float, 3> boundsMin{};
+	std::array<float, 3> boundsMax{};
+
+	bool fromCache = false;
+
+public:
+	CachedMesh() = default;
+	CachedMesh(MappedFile&& file);
+	CachedMesh(ObjMesh&& mesh);
+	virtual ~CachedMesh() = default;
+	CachedMesh(CachedMesh const&) = delete;
+	CachedMesh& operator=(CachedMesh const&) = delete;
+	CachedMesh(CachedMesh&&) = default;
+	CachedMesh& operator=(CachedMesh&&) = default;
+
+	std::span<std::array<float, 6> const> getVertices() const noexcept;
+	std::span<std::uint32_t const> getIndices() const noexcept;
+	std::array<float, 3> const& getBoundsMin() const noexcept;
+	std::array<float, 3> const& getBoundsMax() const noexcept;
+
+	// LbVǂ񂾂ǂ
+	bool isFromCache() const noexcept;
+};
+
+// ̃t@C̒g̃nbV
+std::uint64_t hash_mesh_source(std::string_view data) noexcept;
+
+// _position͂AABBA_0
+void compute_mesh_bounds(std::span<std::array<float, 6> const> vertices, std::array<float, 3>& boundsMin, std::array<float, 3>& boundsMax) noexcept;
+
+// wb_ĂȂÃt@CƍĂ邩𒲂ׂ
+// ĂȂstd::nullopt
+std::optional<CachedMesh> open_mesh_cache(char const* cacheFileName, std::uint64_t sourceSize, std::uint64_t sourceHash);
+
+// ꎞt@CɏĂûŁAr܂ł̃LbVǂނƂ͂Ȃ
+// Ȃstd::runtime_error
+void write_mesh_cache(char const* cacheFileName, ObjMesh const& mesh, std::uint64_t sourceSize, std::uint64_t sourceHash);
+
+// fileName + MESH_CACHE_EXTENSIOÑLbVgΎgAOBJǂŃLbV
+CachedMesh load_mesh(char const* fileName);
+
+
+//
+// ȉA
+//
+
+
+inline CachedMesh::CachedMesh(MappedFile&& f)
+	: file{ std::move(f) }
+	, fromCache{ true }
+{
+	auto const header = reinterpret_cast<MeshCacheHeader const*>(file.getData());
+	auto const vertexPtr = reinterpret_cast<std::array<float, 6> const*>(file.getData() + sizeof(MeshCacheHeader));
+	auto const indexPtr = reinterpret_cast<std::uint32_t const*>(vertexPtr + header->vertexNum);
+
+	vertices = { vertexPtr, header->vertexNum };
+	indices = { indexPtr, header->indexNum };
+	boundsMin = header->boundsMin;
+	boundsMax = header->boundsMax;
+}
+
+inline CachedMesh::CachedMesh(ObjMesh&& mesh)
+	: ownedMesh{ std::move(mesh) }
+{
+	vertices = ownedMesh.vertices;
+	indices = ownedMesh.indices;
+	compute_mesh_bounds(vertices, boundsMin, boundsMax);
+}
+
+inline std::span<std::array<float, 6> const> CachedMesh::getVertices() const noexcept
+{
+	return vertices;
+}
+
+inline std::span<std::uint32_t const> CachedMesh::getIndices() const noexcept
+{
+	return indices;
+}
+
+inline std::array<float, 3> const& CachedMesh::getBoundsMin() const noexcept
+{
+	return boundsMin;
+}
+
+inline std::array<float, 3> const& CachedMesh::getBoundsMax() const noexcept
+{
+	return boundsMax;
+}
+
+inline bool CachedMesh::isFromCache() const noexcept
+{
+	return fromCache;
+}
+
+
+// 8oCgFNV-1a
+inline std::uint64_t hash_mesh_source(std::string_view data) noexcept
+{
+	constexpr std::uint64_t PRIME = 1099511628211ull;
+	std::uint64_t hash = 14695981039346656037ull;
+
+	std::size_t i = 0;
+	for (; i + 8 <= data.size(); i += 8)
+	{
+		std::uint64_t word{};
+		std::memcpy(&word, data.data() + i, 8);
+		hash = (hash ^ word) * PRIME;
+		hash ^= hash >> 32;
+	}
+	for (; i < data.size(); i++)
+		hash = (hash ^ static_cast<unsigned char>(data[i])) * PRIME;
+
+	return hash ^ data.size();
+}
+
+inline void compute_mesh_bounds(std::span<std::array<float, 6> const> vertices, std::array<float, 3>& boundsMin, std::array<float, 3>& boundsMax) noexcept
+{
+	boundsMin = {};
+	boundsMax = {};
+	if (vertices.empty())
+		return;
+
+	boundsMin = boundsMax = { vertices[0][0], vertices[0][1], vertices[0][2] };
+	for (auto const& v : vertices)
+	{
+		for (std::size_t i = 0; i < 3; i++) {
+			boundsMin[i] = std::min(boundsMin[i], v[i]);
+			boundsMax[i] = std::max(boundsMax[i], v[i]);
+		}
+	}
+}
+
+inline std::optional<CachedMesh> open_mesh_cache(char const* cacheFileName, std::uint64_t sourceSize, std::uint64_t sourceHash)
+{
+	std::error_code ec{};
+	if (!std::filesystem::exists(cacheFileName, ec))
+		return std::nullopt;
+
+	MappedFile file{};
+	try {
+		file = MappedFile{ cacheFileName };
+	}
+	catch (std::runtime_error const&) {
+		return std::nullopt;
+	}
+
+	if (file.getSize() < sizeof(MeshCacheHeader))
+		return std::nullopt;
+
+	MeshCacheHeader header{};
+	std::memcpy(&header, file.getData(), sizeof(MeshCacheHeader));
+
+	if (std::memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+		header.version != MESH_CACHE_VERSION ||
+		header.vertexStride != sizeof(std::array<float, 6>) ||
+		header.sourceSize != sourceSize ||
+		header.sourceHash != sourceHash)
+		return std::nullopt;
+
+	auto const expectedSize = sizeof(MeshCacheHeader) +
+		static_cast<std::uint64_t>(header.vertexNum) * header.vertexStride +
+		static_cast<std::uint64_t>(header.indexNum) * sizeof(std::uint32_t);
+	if (file.getSize() != expectedSize)
+		return std::nullopt;
+
+	return CachedMesh{ std::move(file) };
+}
+
+inline void write_mesh_cache(char const* cacheFileName, ObjMesh const& mesh, std::uint64_t sourceSize, std::uint64_t sourceHash)
+{
+	MeshCacheHeader header{};
+	std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version = MESH_CACHE_VERSION;
+	header.vertexStride = sizeof(std::array<float, 6>);
+	header.sourceSize = sourceSize;
+	header.sourceHash = sourceHash;
+	header.vertexNum = static_cast<std::uint32_t>(mesh.vertices.size());
+	header.indexNum = static_cast<std::uint32_t>(mesh.indices.size());
+
+	compute_mesh_bounds(mesh.vertices, header.boundsMin, header.boundsMax);
+
+	auto const tmpFileName = std::string{ cacheFileName } + ".tmp";
+	{
+		std::ofstream out{ tmpFileName, std::ios::binary | std::ios::trunc };
+		out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		out.write(reinterpret_cast<char const*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(std::array<float, 6>));
+		out.write(reinterpret_cast<char const*>(mesh.indices.data()), mesh.indices.size() * sizeof(std::uint32_t));
+		if (!out)
+			throw std::runtime_error{ "failed to write " + tmpFileName };
+	}
+
+	std::filesystem::rename(tmpFileName, cacheFileName);
+}
+
+inline CachedMesh load_mesh(char const* fileName)
+{
+	MappedFile source{ fileName };
+	auto const sourceSize = static_cast<std::uint64_t>(source.getSize());
+	auto const sourceHash = hash_mesh_source(source.getView());
+
+	auto const cacheFileName = std::string{ fileName } + MESH_CACHE_EXTENSION;
+
+	if (auto cache = open_mesh_cache(cacheFileName.c_str(), sourceSize, sourceHash))
+		return std::move(*cache);
+
+	auto mesh = parse_obj(source.getView());
+
+	// ߂ȂꏊȂLbVő
+	try {
+		write_mesh_cache(cacheFileName.c_str(), mesh, sourceSize, sourceHash);
+		if (auto cache = open_mesh_cache(cacheFileName.c_str(), sourceSize, sourceHash))
+			return std::move(*cache);
+	}
+	catch (std::exception const&) {
+	}
+
+	return CachedMesh{ std::move(mesh) };
+}
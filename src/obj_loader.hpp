@@ -1,92 +1,293 @@
 #pragma once
-#include<istream>
+#include"MappedFile.hpp"
+#include<algorithm>
 #include<array>
-#include<vector>
-#include<regex>
+#include<charconv>
+#include<cmath>
+#include<cstdint>
+#include<limits>
+#include<stdexcept>
 #include<string>
+#include<string_view>
+#include<system_error>
+#include<vector>
 
-// position, normal
-inline std::vector<std::array<float, 6>> load_obj(std::istream& in)
+// _position, normal
+// 3indicesŎOp`
+struct ObjMesh
 {
-	const std::regex commentout{ "(.*)#(.*)" };
-	const std::regex position{ "v\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)" };
-	const std::regex normal{ "vn\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)\\s([+-]?\\d+(?:\\.\\d+)?(?:[eE][+-]?\\d+)?)" };
-	const std::regex face{ "f\\s(\\d+)//(\\d+)\\s(\\d+)//(\\d+)\\s(\\d+)//(\\d+)" };
-	const std::regex face2{ "f\\s(\\d+)/(\\d+)/(\\d+)\\s(\\d+)/(\\d+)/(\\d+)\\s(\\d+)/(\\d+)/(\\d+)" };
+	std::vector<std::array<float, 6>> vertices{};
+	std::vector<std::uint32_t> indices{};
+};
+
+// ΉĂ̂vAvnAfŁAق̍s͓ǂݔ΂
+// position/normal̑g1̒_ɂ܂Ƃ߂
+// lp`ȏ̖ʂ͐`ɎOp`
+// @̖ʂɂ͖ʖ@g
+// ǂ߂Ȃsstd::runtime_error
+ObjMesh parse_obj(std::string_view text);
+
+// t@CɃ}bvparse_obj
+ObjMesh load_obj(char const* fileName);
 
-	std::vector<std::array<float, 3>> position_data{};
-	std::vector<std::array<float, 3>> normal_data{};
 
-	std::vector<std::array<float, 6>> result{};
+//
+// ȉA
+//
 
-	std::string buffer{};
-	std::smatch match{};
 
-	while (std::getline(in, buffer))
+[[noreturn]] inline void throw_obj_error(char const* message, std::size_t lineNum)
+{
+	throw std::runtime_error{ std::string{ "obj: " } + message + " at line " + std::to_string(lineNum) };
+}
+
+inline char const* skip_obj_space(char const* p, char const* end) noexcept
+{
+	while (p != end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p;
+}
+
+// from_chars͈͊OԂ̍ŏ0łȂ̈ʂAƎw狁߂
+// 0ȏȂ傫AȂ珬
+inline bool is_obj_float_overflow(char const* p, char const* end) noexcept
+{
+	auto const isDigit = [](char c) { return c >= '0' && c <= '9'; };
+	if (p != end && *p == '-')
+		p++;
+
+	long long order{};
+	auto nonzero = false;
+	for (; p != end && isDigit(*p); p++)
 	{
-		// RgAEg
-		if (std::regex_match(buffer, match, commentout))
+		if (nonzero)
+			order++;
+		else if (*p != '0')
+			nonzero = true;
+	}
+	if (p != end && *p == '.')
+	{
+		for (p++; p != end && isDigit(*p); p++)
 		{
-			buffer = match[1].str();
+			if (nonzero)
+				continue;
+			order--;
+			nonzero = *p != '0';
 		}
+	}
+
+	if (p != end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		auto const negative = p != end && *p == '-';
+		if (p != end && (*p == '-' || *p == '+'))
+			p++;
+		// ̑w͓rŎ~߂Ă͕ςȂ
+		long long exponent{};
+		for (; p != end && isDigit(*p); p++)
+			exponent = std::min(exponent * 10 + (*p - '0'), 1'000'000'000ll);
+		order += negative ? -exponent : exponent;
+	}
+	return nonzero && order >= 0;
+}
+
+inline char const* parse_obj_float(char const* p, char const* end, float& value, std::size_t lineNum)
+{
+	p = skip_obj_space(p, end);
+	// from_chars͐擪+󂯕tȂ
+	if (p != end && *p == '+')
+		p++;
+
+	auto const [ptr, ec] = std::from_chars(p, end, value);
+	if (ec == std::errc::invalid_argument)
+		throw_obj_error("invalid number", lineNum);
+	// \łȂقǑ傫l͍őlɁAl0ɂ
+	if (ec == std::errc::result_out_of_range)
+	{
+		auto const magnitude = is_obj_float_overflow(p, ptr) ? std::numeric_limits<float>::max() : 0.f;
+		value = *p == '-' ? -magnitude : magnitude;
+	}
+
+	return ptr;
+}
+
+// 1n܂̔ԍA̒l͖̔ԍ
+// 0n܂ɂĕԂ
+inline char const* parse_obj_index(char const* p, char const* end, std::size_t count, std::uint32_t& index, std::size_t lineNum)
+{
+	long long value{};
+	auto const [ptr, ec] = std::from_chars(p, end, value);
+	if (ec != std::errc{})
+		throw_obj_error("invalid index", lineNum);
+
+	auto const resolved = value > 0 ? value - 1 : static_cast<long long>(count) + value;
+	if (value == 0 || resolved < 0 || resolved >= static_cast<long long>(count))
+		throw_obj_error("index out of range", lineNum);
+
+	index = static_cast<std::uint32_t>(resolved);
+	return ptr;
+}
 
-		if (std::regex_match(buffer, match, position))
+inline ObjMesh parse_obj(std::string_view text)
+{
+	constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+	std::vector<std::array<float, 3>> positions{};
+	std::vector<std::array<float, 3>> normals{};
+
+	// positionƂɁApositiong_AXgłǂ
+	std::vector<std::uint32_t> firstVertex{};
+	std::vector<std::uint32_t> nextVertex{};
+	std::vector<std::uint32_t> vertexNormal{};
+
+	// 1̖ʂ̒_
+	std::vector<std::uint32_t> facePositions{};
+	std::vector<std::uint32_t> faceNormals{};
+
+	ObjMesh result{};
+
+	auto getVertex = [&](std::uint32_t position, std::uint32_t normal) {
+		for (auto v = firstVertex[position]; v != NONE; v = nextVertex[v])
 		{
-			position_data.push_back({ std::stof(match[1].str()), std::stof(match[2].str()), std::stof(match[3].str()) });
+			if (vertexNormal[v] == normal)
+				return v;
 		}
-		else if (std::regex_match(buffer, match, normal))
+
+		auto const v = static_cast<std::uint32_t>(result.vertices.size());
+		auto const& p = positions[position];
+		auto const& n = normals[normal];
+		result.vertices.push_back({ p[0], p[1], p[2], n[0], n[1], n[2] });
+		vertexNormal.push_back(normal);
+		nextVertex.push_back(firstVertex[position]);
+		firstVertex[position] = v;
+		return v;
+	};
+
+	char const* p = text.data();
+	char const* const end = text.data() + text.size();
+	std::size_t lineNum = 0;
+
+	while (p != end)
+	{
+		lineNum++;
+
+		auto const lineLength = std::string_view{ p, static_cast<std::size_t>(end - p) }.find('\n');
+		char const* const lineEnd = lineLength == std::string_view::npos ? end : p + lineLength;
+		char const* const nextLine = lineEnd == end ? end : lineEnd + 1;
+
+		// RgƉs
+		char const* contentEnd = lineEnd;
+		for (char const* c = p; c != lineEnd; c++)
 		{
-			normal_data.push_back({ std::stof(match[1].str()), std::stof(match[2].str()), std::stof(match[3].str()) });
+			if (*c == '#') {
+				contentEnd = c;
+				break;
+			}
 		}
-		else if (std::regex_match(buffer, match, face))
+		while (contentEnd != p && (contentEnd[-1] == '\r' || contentEnd[-1] == ' ' || contentEnd[-1] == '\t'))
+			contentEnd--;
+
+		p = skip_obj_space(p, contentEnd);
+		char const* keywordEnd = p;
+		while (keywordEnd != contentEnd && *keywordEnd != ' ' && *keywordEnd != '\t')
+			keywordEnd++;
+		std::string_view const keyword{ p, static_cast<std::size_t>(keywordEnd - p) };
+		p = keywordEnd;
+
+		if (keyword == "v" || keyword == "vn")
 		{
-			auto const& position1 = position_data[std::stoi(match[1].str()) - 1];
-			auto const& normal1 = normal_data[std::stoi(match[2].str()) - 1];
-			auto const& position2 = position_data[std::stoi(match[3].str()) - 1];
-			auto const& normal2 = normal_data[std::stoi(match[4].str()) - 1];
-			auto const& position3 = position_data[std::stoi(match[5].str()) - 1];
-			auto const& normal3 = normal_data[std::stoi(match[6].str()) - 1];
-
-			result.push_back({
-				position1[0], position1[1], position1[2],
-				normal1[0], normal1[1], normal1[2],
-				});
-
-			result.push_back({
-				position2[0], position2[1], position2[2],
-				normal2[0], normal2[1], normal2[2],
-				});
-
-			result.push_back({
-				position3[0], position3[1], position3[2],
-				normal3[0], normal3[1], normal3[2],
-				});
+			std::array<float, 3> value{};
+			for (auto& x : value)
+				p = parse_obj_float(p, contentEnd, x, lineNum);
+
+			if (keyword == "v") {
+				positions.push_back(value);
+				firstVertex.push_back(NONE);
+			}
+			else {
+				normals.push_back(value);
+			}
 		}
-		else if (std::regex_match(buffer, match, face2))
+		else if (keyword == "f")
 		{
-			auto const& position1 = position_data[std::stoi(match[1].str()) - 1];
-			auto const& normal1 = normal_data[std::stoi(match[3].str()) - 1];
-			auto const& position2 = position_data[std::stoi(match[4].str()) - 1];
-			auto const& normal2 = normal_data[std::stoi(match[6].str()) - 1];
-			auto const& position3 = position_data[std::stoi(match[7].str()) - 1];
-			auto const& normal3 = normal_data[std::stoi(match[9].str()) - 1];
-
-			result.push_back({
-				position1[0], position1[1], position1[2],
-				normal1[0], normal1[1], normal1[2],
-				});
-
-			result.push_back({
-				position2[0], position2[1], position2[2],
-				normal2[0], normal2[1], normal2[2],
-				});
-
-			result.push_back({
-				position3[0], position3[1], position3[2],
-				normal3[0], normal3[1], normal3[2],
-				});
+			facePositions.clear();
+			faceNormals.clear();
+			bool hasAllNormals = true;
+
+			// pAp/tAp//nAp/t/n
+			while ((p = skip_obj_space(p, contentEnd)) != contentEnd)
+			{
+				std::uint32_t position{};
+				std::uint32_t normal = NONE;
+				p = parse_obj_index(p, contentEnd, positions.size(), position, lineNum);
+
+				if (p != contentEnd && *p == '/')
+				{
+					p++;
+					// eNX`W͎gȂ
+					if (p != contentEnd && *p != '/' && *p != ' ' && *p != '\t')
+					{
+						long long texcoord{};
+						p = std::from_chars(p, contentEnd, texcoord).ptr;
+					}
+					if (p != contentEnd && *p == '/')
+					{
+						p++;
+						p = parse_obj_index(p, contentEnd, normals.size(), normal, lineNum);
+					}
+				}
+
+				facePositions.push_back(position);
+				faceNormals.push_back(normal);
+				hasAllNormals = hasAllNormals && normal != NONE;
+			}
+
+			if (facePositions.size() < 3)
+				throw_obj_error("face with less than 3 vertices", lineNum);
+
+			// @Newell̕@Ŗʖ@߂
+			if (!hasAllNormals)
+			{
+				std::array<float, 3> n{};
+				for (std::size_t i = 0; i < facePositions.size(); i++)
+				{
+					auto const& a = positions[facePositions[i]];
+					auto const& b = positions[facePositions[(i + 1) % facePositions.size()]];
+					n[0] += (a[1] - b[1]) * (a[2] + b[2]);
+					n[1] += (a[2] - b[2]) * (a[0] + b[0]);
+					n[2] += (a[0] - b[0]) * (a[1] + b[1]);
+				}
+				auto const length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (length > 0.f)
+					n = { n[0] / length, n[1] / length, n[2] / length };
+
+				auto const faceNormal = static_cast<std::uint32_t>(normals.size());
+				normals.push_back(n);
+				for (auto& normal : faceNormals)
+				{
+					if (normal == NONE)
+						normal = faceNormal;
+				}
+			}
+
+			auto const first = getVertex(facePositions[0], faceNormals[0]);
+			auto previous = getVertex(facePositions[1], faceNormals[1]);
+			for (std::size_t i = 2; i < facePositions.size(); i++)
+			{
+				auto const current = getVertex(facePositions[i], faceNormals[i]);
+				result.indices.insert(result.indices.end(), { first, previous, current });
+				previous = current;
+			}
 		}
+
+		p = nextLine;
 	}
 
 	return result;
-}
\ No newline at end of file
+}
+
+inline ObjMesh load_obj(char const* fileName)
+{
+	MappedFile file{ fileName };
+	return parse_obj(file.getView());
+}
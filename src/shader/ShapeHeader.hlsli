@@ -16,15 +16,11 @@ struct VSOutput
 	uint instanceId : INSTANCE_ID;
 };
 
-#define MAX_BOX_NUM 256
-
 struct ShapeData
 {
 	matrix transform;
 	float3 color;
+	float padding;
 };
 
-cbuffer BoxDataConstantBuffer : register(b1)
-{
-	ShapeData boxData[MAX_BOX_NUM];
-}
\ No newline at end of file
+StructuredBuffer<ShapeData> shapeData : register(t0);
\ No newline at end of file